@@ -0,0 +1,58 @@
+-- Copyright © 2008-2013 Pioneer Developers. See AUTHORS.txt for details
+-- Licensed under the terms of the GPL v3. See licenses/GPL-3.txt
+
+-- fills the running game with the sort of things a long game builds up, so
+-- the -savebenchmark mode has something worth saving: lots of ships, lots of
+-- missions that hold on to them, and a big log of places and times. only
+-- ever loaded by the benchmark
+
+local log = {}
+local contracts = {}
+
+local serialize = function ()
+	return { log = log, contracts = contracts }
+end
+
+local unserialize = function (data)
+	log = data.log
+	contracts = data.contracts
+end
+
+Serializer:Register("SaveBenchmark", serialize, unserialize)
+
+BenchmarkSaveGame = function (numShips, numMissions, numLogEntries)
+	local rand = Rand.New(0)
+
+	-- sorted, so the same seed spawns the same ships
+	local shipIds = {}
+	for id,def in pairs(ShipDef) do
+		if def.tag == 'SHIP' then table.insert(shipIds, id) end
+	end
+	table.sort(shipIds)
+
+	local ships = {}
+	for i = 1,numShips do
+		local ship = Space.SpawnShipNear(shipIds[rand:Integer(1,#shipIds)], Game.player, 10, 1000)
+		ship:AddEquip('HYDROGEN', rand:Integer(1,10))
+		table.insert(ships, ship)
+	end
+
+	for i = 1,numMissions do
+		local ship = #ships > 0 and ships[rand:Integer(1,#ships)] or nil
+		local mission = Mission.New({
+			type     = 'Delivery',
+			client   = Character.New(),
+			due      = Game.time + rand:Number(1,30)*24*60*60,
+			reward   = rand:Number(100,10000),
+			location = SystemPath.New(rand:Integer(-10,10), rand:Integer(-10,10), rand:Integer(-10,10), rand:Integer(0,3)),
+			status   = 'ACTIVE',
+		})
+		table.insert(contracts, { mission = mission, ship = ship, flavour = rand:Integer(1,10) })
+	end
+
+	for i = 1,numLogEntries do
+		local path = SystemPath.New(rand:Integer(-10,10), rand:Integer(-10,10), rand:Integer(-10,10), rand:Integer(0,3))
+		local arrived = rand:Number(0, Game.time + 1e8)
+		table.insert(log, { path, arrived, arrived + rand:Number(0,1e6), 'entry '..i })
+	end
+end
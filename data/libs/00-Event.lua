@@ -28,6 +28,10 @@ local pending = {}
 local callbacks = {}
 local do_callback = {}
 
+-- how many callbacks each event has. the C++ side looks here and doesn't
+-- queue events nobody is listening for
+local listeners = {}
+
 local do_callback_normal = function (cb, p)
 	cb(table.unpack(p.event))
 end
@@ -75,6 +79,7 @@ Event = {
 	--
 	Register = function (name, cb)
 		if not callbacks[name] then callbacks[name] = {} end
+		if not callbacks[name][cb] then listeners[name] = (listeners[name] or 0) + 1 end
 		callbacks[name][cb] = cb;
         if not do_callback[name] then do_callback[name] = do_callback_normal end
 	end,
@@ -105,8 +110,9 @@ Event = {
 	--   stable
 	--
 	Deregister = function (name, cb)
-		if not callbacks[name] then return end
+		if not callbacks[name] or not callbacks[name][cb] then return end
 		callbacks[name][cb] = nil
+		listeners[name] = listeners[name] > 1 and listeners[name] - 1 or nil
 	end,
 
     --
@@ -136,6 +142,7 @@ Event = {
 	--   stable
 	--
 	Queue = function (name, ...)
+		if not listeners[name] then return end
 		table.insert(pending, { name = name, event = {...} })
 	end,
 
@@ -168,6 +175,9 @@ Event = {
 		do_callback[name] = enabled and do_callback_timed or do_callback_normal
 	end,
 
+	-- internal, read from C++
+	_listeners = listeners,
+
 	-- internal method, called from C++
 	_Clear = function ()
 		pending = {}
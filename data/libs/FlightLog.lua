@@ -181,6 +181,7 @@ local AddSystemDepartureToLog = function (ship)
 	while #FlightLogSystem > FlightLogSystemQueueLength do
 		table.remove(FlightLogSystem,FlightLogSystemQueueLength + 1)
 	end
+	Serializer:Changed("FlightLog")
 end
 
 -- onEnterSystem
@@ -190,6 +191,7 @@ local AddSystemArrivalToLog = function (ship)
 	while #FlightLogSystem > FlightLogSystemQueueLength do
 		table.remove(FlightLogSystem,FlightLogSystemQueueLength + 1)
 	end
+	Serializer:Changed("FlightLog")
 end
 
 -- onShipUndocked
@@ -199,6 +201,7 @@ local AddStationToLog = function (ship, station)
 	while #FlightLogStation > FlightLogStationQueueLength do
 		table.remove(FlightLogStation,FlightLogStationQueueLength + 1)
 	end
+	Serializer:Changed("FlightLog")
 end
 
 -- LOADING AND SAVING
@@ -213,6 +216,7 @@ local onGameStart = function ()
 		table.insert(FlightLogSystem,1,{Game.system.path,nil,nil})
 	end
 	loaded_data = nil
+	Serializer:Changed("FlightLog")
 end
 
 local serialize = function ()
@@ -227,4 +231,5 @@ Event.Register("onEnterSystem", AddSystemArrivalToLog)
 Event.Register("onLeaveSystem", AddSystemDepartureToLog)
 Event.Register("onShipUndocked", AddStationToLog)
 Event.Register("onGameStart", onGameStart)
-Serializer:Register("FlightLog", serialize, unserialize)
+-- only pickled again after one of the loggers above has changed something
+Serializer:Register("FlightLog", serialize, unserialize, true)
@@ -317,7 +317,7 @@ local onShipUndocked = function (ship, station)
 	for ref,mission in pairs(missions) do
 		if mission.status == 'ACTIVE' and
 		   mission.ship == ship then
-			planets = Space.GetBodies(function (body) return body:isa("Planet") end)
+			planets = Space.GetBodies("Planet")
 			if #planets == 0 then
 				ship:AIFlyTo(station)
 				mission.shipstate = 'outbound'
@@ -350,7 +350,7 @@ local onAICompleted = function (ship, ai_error)
 			elseif ai_error == 'NONE' then
 				Timer:CallAt(Game.time + 60 * 60 * 8, function ()
 					if mission.ship:exists() then
-						local stations = Space.GetBodies(function (body) return body:isa("SpaceStation") end)
+						local stations = Space.GetBodies("SpaceStation")
 						if #stations == 0 then return end
 						local station = stations[Engine.rand:Integer(1,#stations)]
 
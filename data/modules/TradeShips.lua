@@ -322,10 +322,11 @@ local spawnInitialShips = function (game_start)
 
 	-- get a measure of the market size and build lists of imports and exports
 	local prices = Game.system:GetCommodityBasePriceAlterations()
+	local legal = Game.system:GetCommodityLegality()
 	local import_score, export_score = 0, 0
 	imports, exports = {}, {}
 	for k,v in pairs(prices) do
-		if k ~= 'RUBBISH' and k ~= 'RADIOACTIVES' and Game.system:IsCommodityLegal(k) then
+		if k ~= 'RUBBISH' and k ~= 'RADIOACTIVES' and legal[k] then
 			-- values from SystemInfoView::UpdateEconomyTab
 			if		v > 10	then
 				import_score = import_score + 2
@@ -854,8 +855,9 @@ local onGameStart = function ()
 			return
 		else
 			local prices = Game.system:GetCommodityBasePriceAlterations()
+			local legal = Game.system:GetCommodityLegality()
 			for k,v in pairs(prices) do
-				if k ~= 'RUBBISH' and k ~= 'RADIOACTIVES' and Game.system:IsCommodityLegal(k) then
+				if k ~= 'RUBBISH' and k ~= 'RADIOACTIVES' and legal[k] then
 					if v > 2 then
 						table.insert(imports, k)
 					elseif v < -2 then
@@ -10,12 +10,44 @@ varying vec4 varyingEmission;
 uniform Material material;
 #endif
 
+#ifdef TERRAIN_PACKED_NORMALS
+// w holds the normal as two bytes of octahedral coordinates, packed by
+// GeoPatch as u*256 + v - 32768
+vec3 unpackNormal(float w)
+{
+	float f = w + 32768.0;
+	float u = floor(f / 256.0);
+	vec2 e = vec2(u, f - u * 256.0) / 127.5 - 1.0;
+	vec3 n = vec3(e, 1.0 - abs(e.x) - abs(e.y));
+	if (n.z < 0.0) {
+		n.xy = (1.0 - abs(n.yx)) * vec2(e.x >= 0.0 ? 1.0 : -1.0, e.y >= 0.0 ? 1.0 : -1.0);
+	}
+	return normalize(n);
+}
+#endif
+
 void main(void)
 {
-	gl_Position = logarithmicTransform();
+#ifdef TERRAIN_PACKED_NORMALS
+	vec4 vertex = vec4(gl_Vertex.xyz, 1.0);
+	vec3 normal = unpackNormal(gl_Vertex.w);
+#else
+	vec4 vertex = gl_Vertex;
+	vec3 normal = gl_Normal;
+#endif
+
+#ifdef TERRAIN_GEOMORPH
+	// gl_MultiTexCoord0.x is how far the vertex is from the parent patch's
+	// mesh along the radius. gl_MultiTexCoord1 is the patch's centre in the
+	// same units, and how much of its own shape to show in w
+	vec3 radial = normalize(vertex.xyz + gl_MultiTexCoord1.xyz);
+	vertex.xyz += radial * (gl_MultiTexCoord0.x * (1.0 - gl_MultiTexCoord1.w));
+#endif
+
+	gl_Position = logarithmicTransform(vertex);
 	vertexColor = gl_Color;
-	varyingEyepos = vec3(gl_ModelViewMatrix * gl_Vertex);
-	varyingNormal = gl_NormalMatrix * gl_Normal;
+	varyingEyepos = vec3(gl_ModelViewMatrix * vertex);
+	varyingNormal = gl_NormalMatrix * normal;
 
 #ifdef TERRAIN_WITH_LAVA
 	varyingEmission = material.emission;
@@ -5,12 +5,17 @@ uniform float invLogZfarPlus1;
 varying float varLogDepth;
 
 #ifdef VERTEX_SHADER
-vec4 logarithmicTransform()
+vec4 logarithmicTransform(vec4 vertex)
 {
-	vec4 vertexPosClip = gl_ModelViewProjectionMatrix * gl_Vertex;
+	vec4 vertexPosClip = gl_ModelViewProjectionMatrix * vertex;
 	varLogDepth = vertexPosClip.z;
 	return vertexPosClip;
 }
+
+vec4 logarithmicTransform()
+{
+	return logarithmicTransform(gl_Vertex);
+}
 #else
 void SetFragDepth()
 {
@@ -8,10 +8,21 @@ varying vec4 vertexColor;
 varying vec3 eyePos;
 varying vec3 normal;
 #endif
+#ifdef INSTANCED
+//modelview matrix of each copy, which must not scale unevenly because
+//the normals are turned by it too
+uniform mat4 instanceTransforms[MAX_INSTANCES];
+#endif
 
 void main(void)
 {
+#ifdef INSTANCED
+	mat4 modelView = instanceTransforms[gl_InstanceIDARB];
+	gl_Position = gl_ProjectionMatrix * (modelView * gl_Vertex);
+	varLogDepth = gl_Position.z;
+#else
 	gl_Position = logarithmicTransform();
+#endif
 #ifdef VERTEXCOLOR
 	vertexColor = gl_Color;
 #endif
@@ -19,7 +30,12 @@ void main(void)
 	texCoord0 = gl_MultiTexCoord0.xy;
 #endif
 #if (NUM_LIGHTS > 0)
+#ifdef INSTANCED
+	eyePos = vec3(modelView * gl_Vertex);
+	normal = normalize(mat3(modelView[0].xyz, modelView[1].xyz, modelView[2].xyz) * gl_Normal);
+#else
 	eyePos = vec3(gl_ModelViewMatrix * gl_Vertex);
 	normal = normalize(gl_NormalMatrix * gl_Normal);
 #endif
+#endif
 }
@@ -66,6 +66,13 @@ static sigc::connection onChangeCamTypeConnection;
 void AmbientSounds::Init()
 {
 	onChangeCamTypeConnection = Pi::worldView->onChangeCamType.connect(sigc::ptr_fun(&AmbientSounds::UpdateForCamType));
+
+	// these all start together on entering an atmosphere, and docking
+	// starts a station one, so have them ready
+	for (int i = 0; i < eMaxNumAtmosphereSounds; i++)
+		Sound::Preload(s_airflowTable[i]);
+	for (Uint32 i = 0; i < NUM_STATION_SOUNDS; i++)
+		Sound::Preload(s_stationNoiseSounds[i]);
 }
 
 void AmbientSounds::Uninit()
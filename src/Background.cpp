@@ -4,6 +4,7 @@
 #include "Background.h"
 #include "Frame.h"
 #include "Game.h"
+#include "JobQueue.h"
 #include "perlin.h"
 #include "Pi.h"
 #include "Player.h"
@@ -12,9 +13,8 @@
 #include "graphics/Graphics.h"
 #include "graphics/Material.h"
 #include "graphics/Renderer.h"
-#include "graphics/StaticMesh.h"
-#include "graphics/Surface.h"
 #include "graphics/VertexArray.h"
+#include "graphics/VertexBuffer.h"
 
 using namespace Graphics;
 
@@ -26,6 +26,53 @@ void BackgroundElement::SetIntensity(float intensity)
 	m_material->emissive = Color(intensity);
 }
 
+// upload the vertices to a static buffer. null if the renderer doesn't
+// have them, the array is drawn directly then
+static VertexBuffer *create_buffer(Graphics::Renderer *r, const VertexArray &va)
+{
+	VertexBufferDesc desc;
+	desc.attribs = ATTRIB_POSITION | ATTRIB_DIFFUSE;
+	desc.numVertices = va.GetNumVerts();
+	desc.usage = BUFFER_USAGE_STATIC;
+	VertexBuffer *vb = r->CreateVertexBuffer(desc);
+	if (vb && !vb->Populate(va)) {
+		delete vb;
+		vb = 0;
+	}
+	return vb;
+}
+
+static void draw_buffer(Graphics::Renderer *r, VertexBuffer *vb, const VertexArray *va, Material *m, PrimitiveType type)
+{
+	if (vb)
+		r->DrawBuffer(vb, m, type);
+	else if (va)
+		r->DrawTriangles(va, m, type);
+}
+
+// generates the stars for a seed from a worker
+class Starfield::FillJob : public Job {
+public:
+	FillJob(Starfield *starfield, Uint32 seed) : m_starfield(starfield), m_seed(seed), m_stars(0) {}
+	virtual ~FillJob() { delete m_stars; }
+	virtual const char *GetName() const { return "Starfield::FillJob"; }
+
+	virtual void OnRun() {
+		m_stars = new VertexArray(ATTRIB_POSITION | ATTRIB_DIFFUSE, BG_STAR_MAX);
+		Starfield::Generate(m_seed, m_stars);
+	}
+
+	virtual void OnFinish() {
+		m_starfield->OnFilled(m_stars);
+		m_stars = 0;
+	}
+
+private:
+	Starfield *m_starfield;
+	Uint32 m_seed;
+	VertexArray *m_stars;
+};
+
 Starfield::Starfield(Graphics::Renderer *r)
 {
 	Init(r);
@@ -40,31 +87,40 @@ Starfield::Starfield(Graphics::Renderer *r, Uint32 seed)
 
 Starfield::~Starfield()
 {
-	delete m_model;
-	delete[] m_hyperVtx;
-	delete[] m_hyperCol;
+	if (m_jobGroup && Pi::Jobs())
+		Pi::Jobs()->CancelGroup(m_jobGroup);
 }
 
 void Starfield::Init(Graphics::Renderer *r)
 {
-	// reserve some space for positions, colours
-	VertexArray *stars = new VertexArray(ATTRIB_POSITION | ATTRIB_DIFFUSE, BG_STAR_MAX);
-	m_model = new StaticMesh(POINTS);
+	m_renderer = r;
+	m_jobGroup = Pi::Jobs() ? Pi::Jobs()->NewGroup() : 0;
+
 	Graphics::MaterialDescriptor desc;
 	desc.effect = Graphics::EFFECT_STARFIELD;
 	desc.vertexColors = true;
 	m_material.Reset(r->CreateMaterial(desc));
 	m_material->emissive = Color::WHITE;
-	m_model->AddSurface(RefCountedPtr<Surface>(new Surface(POINTS, stars, m_material)));
-
-	m_hyperVtx = 0;
-	m_hyperCol = 0;
 }
 
 void Starfield::Fill(Uint32 seed)
 {
-	VertexArray *va = m_model->GetSurface(0)->GetVertices();
-	va->Clear(); // clear if previously filled
+	if (m_jobGroup) {
+		// only the latest seed counts
+		Pi::Jobs()->CancelGroup(m_jobGroup);
+		FillJob *job = new FillJob(this, seed);
+		job->SetPriority(Job::PRIORITY_HIGH);
+		job->SetGroup(m_jobGroup);
+		Pi::Jobs()->Queue(job);
+	} else {
+		VertexArray *stars = new VertexArray(ATTRIB_POSITION | ATTRIB_DIFFUSE, BG_STAR_MAX);
+		Generate(seed, stars);
+		OnFilled(stars);
+	}
+}
+
+void Starfield::Generate(Uint32 seed, VertexArray *va)
+{
 	// Slight colour variation to stars based on seed
 	Random rand(seed);
 
@@ -85,11 +141,23 @@ void Starfield::Fill(Uint32 seed)
 	}
 }
 
-void Starfield::Draw(Graphics::Renderer *renderer)
+void Starfield::OnFilled(VertexArray *stars)
 {
+	m_stars.Reset(stars);
+	m_starBuffer.Reset(create_buffer(m_renderer, *m_stars));
+
+	m_hyperLines.Reset(0);
+	m_hyperBuffer.Reset(0);
+}
+
+void Starfield::Draw(Graphics::Renderer *renderer, const matrix4x4d &transform)
+{
+	if (!m_stars.Valid()) return;
+
 	// XXX would be nice to get rid of the Pi:: stuff here
 	if (!Pi::game || Pi::player->GetFlightState() != Ship::HYPERSPACE) {
-		renderer->DrawStaticMesh(m_model);
+		renderer->SetTransform(transform);
+		draw_buffer(renderer, m_starBuffer.Get(), m_stars.Get(), m_material.Get(), POINTS);
 	} else {
 		// roughly, the multiplier gets smaller as the duration gets larger.
 		// the time-looking bits in this are completely arbitrary - I figured
@@ -99,36 +167,26 @@ void Starfield::Draw(Graphics::Renderer *renderer)
 		double hyperspaceProgress = Pi::game->GetHyperspaceProgress();
 
 		//XXX this is a lot of lines
-		if (m_hyperVtx == 0) {
-			m_hyperVtx = new vector3f[BG_STAR_MAX * 2];
-			m_hyperCol = new Color[BG_STAR_MAX * 2];
+		if (!m_hyperLines.Valid()) {
+			m_hyperLines.Reset(new VertexArray(ATTRIB_POSITION | ATTRIB_DIFFUSE, BG_STAR_MAX * 2));
+			for (int i=0; i<BG_STAR_MAX; i++) {
+				m_hyperLines->Add(m_stars->position[i] * 2.f, m_stars->diffuse[i]);
+				m_hyperLines->Add(m_stars->position[i], m_stars->diffuse[i]);
+			}
+			m_hyperBuffer.Reset(create_buffer(renderer, *m_hyperLines));
 		}
-		VertexArray *va = m_model->GetSurface(0)->GetVertices();
-		vector3d pz = Pi::player->GetOrient().VectorZ();	//back vector
-		for (int i=0; i<BG_STAR_MAX; i++) {
 
-			vector3f v(va->position[i]);
-			v += vector3f(pz*hyperspaceProgress*mult);
-
-			m_hyperVtx[i*2] = va->position[i] + v;
-			m_hyperCol[i*2] = va->diffuse[i];
-
-			m_hyperVtx[i*2+1] = v;
-			m_hyperCol[i*2+1] = va->diffuse[i];
-		}
-		renderer->DrawLines(BG_STAR_MAX*2, m_hyperVtx, m_hyperCol);
+		vector3d pz = Pi::player->GetOrient().VectorZ();	//back vector
+		renderer->SetTransform(transform * matrix4x4d::Translation(pz*hyperspaceProgress*mult));
+		draw_buffer(renderer, m_hyperBuffer.Get(), m_hyperLines.Get(), m_material.Get(), LINES);
 	}
 }
 
 MilkyWay::MilkyWay(Graphics::Renderer *r)
 {
-	m_model = new StaticMesh(TRIANGLE_STRIP);
-
-	//build milky way model in two strips (about 256 verts)
-	//The model is built as a generic vertex array first. The renderer
-	//will reprocess this into buffered format as it sees fit. The old data is
-	//kept around as long as StaticMesh is alive (needed if the cache is to be regenerated)
-
+	//build milky way model in two strips (about 256 verts), joined
+	//into one by a degenerate pair so it's drawn in one go. the array is
+	//kept in case the renderer can't buffer it
 	VertexArray *bottom = new VertexArray(ATTRIB_POSITION | ATTRIB_DIFFUSE);
 	VertexArray *top = new VertexArray(ATTRIB_POSITION | ATTRIB_DIFFUSE);
 
@@ -175,19 +233,26 @@ MilkyWay::MilkyWay(Graphics::Renderer *r)
 	m_material.Reset(r->CreateMaterial(desc));
 	m_material->emissive = Color::WHITE;
 	//This doesn't fade. Could add a generic opacity/intensity value.
-	m_model->AddSurface(RefCountedPtr<Surface>(new Surface(TRIANGLE_STRIP, bottom, m_material)));
-	m_model->AddSurface(RefCountedPtr<Surface>(new Surface(TRIANGLE_STRIP, top, m_material)));
+
+	// both strips have an even number of vertices, so the join keeps the
+	// winding of the top one
+	m_vertices.Reset(bottom);
+	m_vertices->Add(bottom->position.back(), bottom->diffuse.back());
+	m_vertices->Add(top->position.front(), top->diffuse.front());
+	for (unsigned int i = 0; i < top->GetNumVerts(); i++)
+		m_vertices->Add(top->position[i], top->diffuse[i]);
+	delete top;
+
+	m_buffer.Reset(create_buffer(r, *m_vertices));
 }
 
 MilkyWay::~MilkyWay()
 {
-	delete m_model;
 }
 
 void MilkyWay::Draw(Graphics::Renderer *renderer)
 {
-	assert(m_model != 0);
-	renderer->DrawStaticMesh(m_model);
+	draw_buffer(renderer, m_buffer.Get(), m_vertices.Get(), m_material.Get(), TRIANGLE_STRIP);
 }
 
 Container::Container(Graphics::Renderer *r)
@@ -218,8 +283,7 @@ void Container::Draw(Graphics::Renderer *renderer, const matrix4x4d &transform)
 	const_cast<MilkyWay&>(m_milkyWay).Draw(renderer);
 	// squeeze the starfield a bit to get more density near horizon
 	matrix4x4d starTrans = transform * matrix4x4d::ScaleMatrix(1.0, 0.4, 1.0);
-	renderer->SetTransform(starTrans);
-	const_cast<Starfield&>(m_starField).Draw(renderer);
+	const_cast<Starfield&>(m_starField).Draw(renderer, starTrans);
 	renderer->SetDepthTest(true);
 }
 
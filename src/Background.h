@@ -8,8 +8,9 @@
 
 namespace Graphics {
 	class Renderer;
-	class StaticMesh;
 	class Material;
+	class VertexArray;
+	class VertexBuffer;
 }
 
 /*
@@ -34,20 +35,30 @@ namespace Background
 		Starfield(Graphics::Renderer *r);
 		Starfield(Graphics::Renderer *r, Uint32 seed);
 		~Starfield();
-		void Draw(Graphics::Renderer *r);
-		//create or recreate the starfield
+		void Draw(Graphics::Renderer *r, const matrix4x4d &transform);
+		//create or recreate the starfield. the stars are generated by a
+		//worker, the old ones (if any) are drawn until they are ready
 		void Fill(Uint32 seed);
 
 	private:
+		class FillJob;
+
 		void Init(Graphics::Renderer *);
+		static void Generate(Uint32 seed, Graphics::VertexArray *stars);
+		void OnFilled(Graphics::VertexArray *stars);
 		static const int BG_STAR_MAX = 10000;
-		Graphics::StaticMesh *m_model;
-
-		//hyperspace animation vertex data
-		//allocated when animation starts and thrown away
-		//when starfield is destroyed (on exiting hyperspace)
-		vector3f *m_hyperVtx;
-		Color *m_hyperCol;
+		Graphics::Renderer *m_renderer;
+		Uint32 m_jobGroup;
+		ScopedPtr<Graphics::VertexArray> m_stars;
+		RefCountedPtr<Graphics::VertexBuffer> m_starBuffer;
+
+		//hyperspace animation streaks, a line from twice the star position
+		//to the star position. they don't change during the animation, the
+		//offset is applied through the transform
+		//made when animation starts and thrown away on the next Fill
+		//(on exiting hyperspace)
+		ScopedPtr<Graphics::VertexArray> m_hyperLines;
+		RefCountedPtr<Graphics::VertexBuffer> m_hyperBuffer;
 	};
 
 	class MilkyWay : public BackgroundElement
@@ -58,7 +69,8 @@ namespace Background
 		void Draw(Graphics::Renderer *r);
 
 	private:
-		Graphics::StaticMesh *m_model;
+		ScopedPtr<Graphics::VertexArray> m_vertices;
+		RefCountedPtr<Graphics::VertexBuffer> m_buffer;
 	};
 
 	// contains starfield, milkyway, possibly other Background elements
@@ -0,0 +1,82 @@
+// Copyright © 2008-2013 Pioneer Developers. See AUTHORS.txt for details
+// Licensed under the terms of the GPL v3. See licenses/GPL-3.txt
+
+#include "BlockPool.h"
+#include <cassert>
+#include <algorithm>
+
+// every block is aligned for anything we're likely to put in it, including
+// the SSE types
+static const size_t BLOCK_ALIGNMENT = 16;
+
+BlockPoolBase::BlockPoolBase(size_t blockSize, size_t blocksPerSlab, bool threadSafe) :
+	m_blockSize(std::max(((blockSize + BLOCK_ALIGNMENT - 1) / BLOCK_ALIGNMENT) * BLOCK_ALIGNMENT, BLOCK_ALIGNMENT)),
+	m_blocksPerSlab(std::max(blocksPerSlab, size_t(1))),
+	m_freeList(0),
+	m_numAllocated(0),
+	m_lock(threadSafe ? SDL_CreateMutex() : 0),
+	m_memoryTag(MemoryStats::UNTRACKED)
+{
+}
+
+BlockPoolBase::~BlockPoolBase()
+{
+	for (std::vector<char*>::iterator i = m_slabs.begin(); i != m_slabs.end(); ++i)
+		delete [] (*i);
+	MemoryStats::Remove(m_memoryTag, m_slabs.size() * SlabBytes());
+	if (m_lock) SDL_DestroyMutex(m_lock);
+}
+
+void BlockPoolBase::SetMemoryTag(MemoryStats::Tag tag)
+{
+	assert(m_slabs.empty());
+	m_memoryTag = tag;
+}
+
+size_t BlockPoolBase::SlabBytes() const
+{
+	return m_blockSize * m_blocksPerSlab + BLOCK_ALIGNMENT;
+}
+
+void BlockPoolBase::AddSlab()
+{
+	// new[] gives us memory aligned for the largest fundamental type, and the
+	// block size is a multiple of BLOCK_ALIGNMENT, so we only need to shuffle
+	// the start along to keep every block aligned
+	char *slab = new char[SlabBytes()];
+	m_slabs.push_back(slab);
+	MemoryStats::Add(m_memoryTag, SlabBytes());
+
+	char *base = slab + ((BLOCK_ALIGNMENT - (reinterpret_cast<size_t>(slab) % BLOCK_ALIGNMENT)) % BLOCK_ALIGNMENT);
+
+	// thread the new blocks onto the free list, first block first
+	for (size_t i = m_blocksPerSlab; i > 0; i--) {
+		FreeNode *node = reinterpret_cast<FreeNode*>(base + (i-1) * m_blockSize);
+		node->next = m_freeList;
+		m_freeList = node;
+	}
+}
+
+void *BlockPoolBase::AllocBlock()
+{
+	if (m_lock) SDL_LockMutex(m_lock);
+	if (!m_freeList)
+		AddSlab();
+	FreeNode *node = m_freeList;
+	m_freeList = node->next;
+	m_numAllocated++;
+	if (m_lock) SDL_UnlockMutex(m_lock);
+	return node;
+}
+
+void BlockPoolBase::FreeBlock(void *p)
+{
+	assert(p);
+	FreeNode *node = static_cast<FreeNode*>(p);
+	if (m_lock) SDL_LockMutex(m_lock);
+	assert(m_numAllocated > 0);
+	node->next = m_freeList;
+	m_freeList = node;
+	m_numAllocated--;
+	if (m_lock) SDL_UnlockMutex(m_lock);
+}
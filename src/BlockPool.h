@@ -0,0 +1,74 @@
+// Copyright © 2008-2013 Pioneer Developers. See AUTHORS.txt for details
+// Licensed under the terms of the GPL v3. See licenses/GPL-3.txt
+
+#ifndef _BLOCKPOOL_H
+#define _BLOCKPOOL_H
+
+#include <SDL_stdinc.h>
+#include "SDL_thread.h"
+#include "MemoryStats.h"
+#include <cstddef>
+#include <vector>
+
+// a pool of fixed size blocks of memory. blocks are carved out of large slabs
+// and recycled through a free list, so allocating and freeing is just a
+// pointer swap and the heap doesn't fragment when lots of same-sized buffers
+// come and go. slabs are only returned to the system when the pool is
+// destroyed, so every block must be freed back to the pool it came from
+// before then.
+//
+// Alloc and Free are safe to call from any thread, unless the pool was made
+// without locking for use from only one
+class BlockPoolBase {
+public:
+	BlockPoolBase(size_t blockSize, size_t blocksPerSlab, bool threadSafe = true);
+	~BlockPoolBase();
+
+	void *AllocBlock();
+	void FreeBlock(void *p);
+
+	size_t GetBlockSize() const { return m_blockSize; }
+	size_t GetNumAllocated() const { return m_numAllocated; }
+	size_t GetNumSlabs() const { return m_slabs.size(); }
+
+	// slabs are charged to this tag as they're made. only before the first
+	// block is allocated
+	void SetMemoryTag(MemoryStats::Tag tag);
+
+private:
+	BlockPoolBase(const BlockPoolBase &);
+	BlockPoolBase &operator=(const BlockPoolBase &);
+
+	struct FreeNode { FreeNode *next; };
+
+	void AddSlab();
+	size_t SlabBytes() const;
+
+	const size_t m_blockSize;
+	const size_t m_blocksPerSlab;
+	std::vector<char*> m_slabs;
+	FreeNode *m_freeList;
+	size_t m_numAllocated;
+	SDL_mutex *m_lock; // 0 if the pool doesn't lock
+	MemoryStats::Tag m_memoryTag;
+};
+
+// a pool of arrays of numElements Ts. the memory is not constructed or
+// destructed, so T must be happy to live in raw memory (plain data, vectors
+// and colours, that sort of thing)
+template <typename T>
+class BlockPool : public BlockPoolBase {
+public:
+	BlockPool(size_t numElements, size_t blocksPerSlab = 64) :
+		BlockPoolBase(numElements * sizeof(T), blocksPerSlab), m_numElements(numElements) {}
+
+	T *Alloc() { return static_cast<T*>(AllocBlock()); }
+	void Free(T *p) { if (p) FreeBlock(p); }
+
+	size_t GetNumElements() const { return m_numElements; }
+
+private:
+	const size_t m_numElements;
+};
+
+#endif
@@ -28,6 +28,7 @@ Body::Body() : PropertiedObject(Lua::manager)
 	, m_dead(false)
 	, m_clipRadius(0.0)
 	, m_physRadius(0.0)
+	, m_spaceSlot(0)
 {
 	Properties().Set("label", m_label);
 }
@@ -36,16 +37,22 @@ Body::~Body()
 {
 }
 
+// position, orientation and the two radii
+static const size_t BODY_RECORD_SIZE = 3 + 9 + 2;
+
 void Body::Save(Serializer::Writer &wr, Space *space)
 {
 	wr.Int32(space->GetIndexForFrame(m_frame));
 	wr.String(m_label);
 	wr.Bool(m_dead);
 
-	wr.Vector3d(m_pos);
-	for (int i=0; i<9; i++) wr.Double(m_orient[i]);
-	wr.Double(m_physRadius);
-	wr.Double(m_clipRadius);
+	// the rest is a fixed record, written and read in one piece
+	double rec[BODY_RECORD_SIZE];
+	rec[0] = m_pos.x; rec[1] = m_pos.y; rec[2] = m_pos.z;
+	for (int i=0; i<9; i++) rec[3+i] = m_orient[i];
+	rec[12] = m_physRadius;
+	rec[13] = m_clipRadius;
+	wr.Doubles(rec, BODY_RECORD_SIZE);
 }
 
 void Body::Load(Serializer::Reader &rd, Space *space)
@@ -55,10 +62,12 @@ void Body::Load(Serializer::Reader &rd, Space *space)
 	Properties().Set("label", m_label);
 	m_dead = rd.Bool();
 
-	m_pos = rd.Vector3d();
-	for (int i=0; i<9; i++) m_orient[i] = rd.Double();
-	m_physRadius = rd.Double();
-	m_clipRadius = rd.Double();
+	double rec[BODY_RECORD_SIZE];
+	rd.Doubles(rec, BODY_RECORD_SIZE);
+	m_pos = vector3d(rec[0], rec[1], rec[2]);
+	for (int i=0; i<9; i++) m_orient[i] = rec[3+i];
+	m_physRadius = rec[12];
+	m_clipRadius = rec[13];
 }
 
 void Body::Serialize(Serializer::Writer &_wr, Space *space)
@@ -117,16 +126,12 @@ Body *Body::Unserialize(Serializer::Reader &_rd, Space *space)
 
 vector3d Body::GetPositionRelTo(const Frame *relTo) const
 {
-	vector3d fpos = m_frame->GetPositionRelTo(relTo);
-	matrix3x3d forient = m_frame->GetOrientRelTo(relTo);
-	return forient * GetPosition() + fpos;
+	return m_frame->RotateRelTo(GetPosition(), relTo) + m_frame->GetPositionRelTo(relTo);
 }
 
 vector3d Body::GetInterpPositionRelTo(const Frame *relTo) const
 {
-	vector3d fpos = m_frame->GetInterpPositionRelTo(relTo);
-	matrix3x3d forient = m_frame->GetInterpOrientRelTo(relTo);
-	return forient * GetInterpPosition() + fpos;
+	return m_frame->InterpRotateRelTo(GetInterpPosition(), relTo) + m_frame->GetInterpPositionRelTo(relTo);
 }
 
 vector3d Body::GetPositionRelTo(const Body *relTo) const
@@ -153,15 +158,15 @@ matrix3x3d Body::GetInterpOrientRelTo(const Frame *relTo) const
 
 vector3d Body::GetVelocityRelTo(const Frame *relTo) const
 {
-	matrix3x3d forient = m_frame->GetOrientRelTo(relTo);
 	vector3d vel = GetVelocity();
 	if (m_frame != relTo) vel -= m_frame->GetStasisVelocity(GetPosition());
-	return forient * vel + m_frame->GetVelocityRelTo(relTo);
+	return m_frame->RotateRelTo(vel, relTo) + m_frame->GetVelocityRelTo(relTo);
 }
 
 vector3d Body::GetVelocityRelTo(const Body *relTo) const
 {
-	return GetVelocityRelTo(relTo->m_frame) - relTo->GetVelocityRelTo(relTo->m_frame);
+	// a body's velocity relative to its own frame is just its velocity
+	return GetVelocityRelTo(relTo->m_frame) - relTo->GetVelocity();
 }
 
 void Body::OrientOnSurface(double radius, double latitude, double longitude)
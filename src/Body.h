@@ -43,14 +43,28 @@ public:
 	virtual bool OnCollision(Object *o, Uint32 flags, double relVel) { return false; }
 	// Attacker may be null
 	virtual bool OnDamage(Object *attacker, float kgDamage) { return false; }
-	// Override to clear any pointers you hold to the body
+	// Override to clear any pointers you hold to the body. only called if
+	// HoldsBodyReferences() returns true, which is checked once when the
+	// body is added to space
 	virtual void NotifyRemoved(const Body* const removedBody) {}
+	virtual bool HoldsBodyReferences() const { return false; }
+
+	// Space's bookkeeping, zero when the body isn't in space
+	void SetSpaceSlot(Uint32 slot) { m_spaceSlot = slot; }
+	Uint32 GetSpaceSlot() const { return m_spaceSlot; }
 
 	// before all bodies have had TimeStepUpdate (their moving step),
 	// StaticUpdate() is called. Good for special collision testing (Projectiles)
 	// as you can't test for collisions if different objects are on different 'steps'
 	virtual void StaticUpdate(const float timeStep) {}
 	virtual void TimeStepUpdate(const float timeStep) {}
+	// if HasParallelTimeStep() (checked on the main thread) is true,
+	// ParallelTimeStepUpdate is called before TimeStepUpdate, possibly on a
+	// worker thread alongside other bodies. it must only touch this body, so
+	// no spawning, killing, events, sounds or effects. TimeStepUpdate has to
+	// cope with it having been called or not
+	virtual bool HasParallelTimeStep() const { return false; }
+	virtual void ParallelTimeStepUpdate(const float timeStep) {}
 	virtual void Render(Graphics::Renderer *r, const Camera *camera, const vector3d &viewCoords, const matrix4x4d &viewTransform) = 0;
 
 	virtual void SetFrame(Frame *f) { m_frame = f; }
@@ -116,6 +130,7 @@ private:
 	bool m_dead;				// Checked in destructor to make sure body has been marked dead.
 	double m_clipRadius;
 	double m_physRadius;
+	Uint32 m_spaceSlot;
 };
 
 #endif /* _BODY_H */
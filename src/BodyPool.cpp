@@ -0,0 +1,28 @@
+// Copyright © 2008-2013 Pioneer Developers. See AUTHORS.txt for details
+// Licensed under the terms of the GPL v3. See licenses/GPL-3.txt
+
+#include "BodyPool.h"
+#include <algorithm>
+
+static std::vector<std::vector<void*>*> &free_lists()
+{
+	static std::vector<std::vector<void*>*> lists;
+	return lists;
+}
+
+void BodyPoolBase::Register(std::vector<void*> *freeList)
+{
+	std::vector<std::vector<void*>*> &lists = free_lists();
+	if (std::find(lists.begin(), lists.end(), freeList) == lists.end())
+		lists.push_back(freeList);
+}
+
+void BodyPoolBase::FreeAll()
+{
+	std::vector<std::vector<void*>*> &lists = free_lists();
+	for (std::vector<std::vector<void*>*>::iterator i = lists.begin(); i != lists.end(); ++i) {
+		for (std::vector<void*>::iterator j = (*i)->begin(); j != (*i)->end(); ++j)
+			::operator delete(*j);
+		(*i)->clear();
+	}
+}
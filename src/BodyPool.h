@@ -0,0 +1,58 @@
+// Copyright © 2008-2013 Pioneer Developers. See AUTHORS.txt for details
+// Licensed under the terms of the GPL v3. See licenses/GPL-3.txt
+
+#ifndef _BODYPOOL_H
+#define _BODYPOOL_H
+
+#include <vector>
+#include <cstddef>
+
+// memory for bodies that come and go all the time (projectiles, missiles,
+// cargo, clouds). a class gets it by deriving from BodyPool<itself>; a
+// deleted one keeps its memory for the next one of the same type instead
+// of giving it back to the heap. deleting through a Body * still comes
+// here, as the virtual destructor finds the operator delete of the class
+// the object really is. subclasses of a pooled class are a different size
+// and just use the heap
+class BodyPoolBase {
+public:
+	// give all the kept memory back to the heap. Space does this when it
+	// goes away, so one system's fight doesn't hold on to it forever
+	static void FreeAll();
+
+protected:
+	// more than this many free ones of a type go back to the heap
+	static const size_t MAX_FREE = 1024;
+
+	static void Register(std::vector<void*> *freeList);
+};
+
+template <typename T>
+class BodyPool : public BodyPoolBase {
+public:
+	static void *operator new(size_t size) {
+		if (size == sizeof(T) && !s_free.empty()) {
+			void *p = s_free.back();
+			s_free.pop_back();
+			return p;
+		}
+		return ::operator new(size);
+	}
+
+	static void operator delete(void *p, size_t size) {
+		if (!p) return;
+		if (size != sizeof(T) || s_free.size() >= MAX_FREE) {
+			::operator delete(p);
+			return;
+		}
+		if (s_free.capacity() == 0) Register(&s_free);
+		s_free.push_back(p);
+	}
+
+private:
+	static std::vector<void*> s_free;
+};
+
+template <typename T> std::vector<void*> BodyPool<T>::s_free;
+
+#endif /* _BODYPOOL_H */
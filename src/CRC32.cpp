@@ -6,7 +6,7 @@
 const Uint32 CRC32::s_polynomial = 0x04c11db7;
 
 bool CRC32::s_lookupTableGenerated;
-Uint32 CRC32::s_lookupTable[256];
+Uint32 CRC32::s_lookupTable[8][256];
 
 static Uint32 crc32_reflect(Uint32 v, const int bits)
 {
@@ -23,11 +23,15 @@ CRC32::CRC32() : m_checksum(0xffffffff)
 {
 	if (! s_lookupTableGenerated) {
 		for (int i = 0; i <= 0xff; i++) {
-			s_lookupTable[i] = crc32_reflect(i,8) << 24;
+			Uint32 &entry = s_lookupTable[0][i];
+			entry = crc32_reflect(i,8) << 24;
 			for (int j = 0; j < 8; j++)
-				s_lookupTable[i] = (s_lookupTable[i] << 1) ^ (s_lookupTable[i] & (1 << 31) ? s_polynomial : 0);
-			s_lookupTable[i] = crc32_reflect(s_lookupTable[i], 32);
+				entry = (entry << 1) ^ (entry & (1 << 31) ? s_polynomial : 0);
+			entry = crc32_reflect(entry, 32);
 		}
+		for (int i = 0; i <= 0xff; i++)
+			for (int n = 1; n < 8; n++)
+				s_lookupTable[n][i] = (s_lookupTable[n-1][i] >> 8) ^ s_lookupTable[0][s_lookupTable[n-1][i] & 0xff];
 
 		s_lookupTableGenerated = true;
 	}
@@ -36,6 +40,20 @@ CRC32::CRC32() : m_checksum(0xffffffff)
 void CRC32::AddData(const char *data, int length)
 {
 	const unsigned char *buf = reinterpret_cast<const unsigned char *>(data);
-	while (length--)
-		m_checksum = (m_checksum >> 8) ^ s_lookupTable[(m_checksum & 0xff) ^ *buf++];
+	const Uint32 (&t)[8][256] = s_lookupTable;
+	Uint32 crc = m_checksum;
+
+	// the bytes are put together by hand, so it comes out the same on any
+	// byte order and alignment
+	for (; length >= 8; length -= 8, buf += 8) {
+		const Uint32 lo = crc ^ (Uint32(buf[0]) | (Uint32(buf[1]) << 8) | (Uint32(buf[2]) << 16) | (Uint32(buf[3]) << 24));
+		const Uint32 hi = Uint32(buf[4]) | (Uint32(buf[5]) << 8) | (Uint32(buf[6]) << 16) | (Uint32(buf[7]) << 24);
+		crc = t[7][lo & 0xff] ^ t[6][(lo >> 8) & 0xff] ^ t[5][(lo >> 16) & 0xff] ^ t[4][lo >> 24]
+			^ t[3][hi & 0xff] ^ t[2][(hi >> 8) & 0xff] ^ t[1][(hi >> 16) & 0xff] ^ t[0][hi >> 24];
+	}
+
+	while (length-- > 0)
+		crc = (crc >> 8) ^ t[0][(crc & 0xff) ^ *buf++];
+
+	m_checksum = crc;
 }
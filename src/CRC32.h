@@ -7,6 +7,8 @@
 #include <SDL_stdinc.h>
 #include <vector>
 
+// the usual (zlib, png) CRC-32, without the final inversion. data is taken
+// eight bytes at a time with a table for each of them (slicing-by-8)
 class CRC32 {
 public:
 	CRC32();
@@ -19,7 +21,8 @@ private:
 
 	static const Uint32 s_polynomial;
 	static bool s_lookupTableGenerated;
-	static Uint32 s_lookupTable[256];
+	// [0] is the byte at a time table, [n] a byte followed by n zero bytes
+	static Uint32 s_lookupTable[8][256];
 };
 
 #endif
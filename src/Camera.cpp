@@ -9,14 +9,43 @@
 #include "Pi.h"
 #include "Sfx.h"
 #include "Game.h"
+#include "FrameProfiler.h"
+#include "Profiler.h"
 #include "Planet.h"
+#include "Projectile.h"
 #include "graphics/Graphics.h"
 #include "graphics/Renderer.h"
+#include "graphics/TextureGL.h"
 #include "graphics/VertexArray.h"
 #include "graphics/Material.h"
 
 using namespace Graphics;
 
+static int s_occlusionCulling = 0;
+
+// planets are drawn as a mesh between points on or above the surface, so
+// near the limb it can dip a little inside the sphere. as occluders they're
+// taken as a bit smaller to be on the safe side
+static const double OCCLUDER_RADIUS_SCALE = 0.99;
+
+// a planet or star as seen from the camera. a body is behind it if it's all
+// inside the cone the sphere makes, and no nearer than where the cone
+// touches the sphere, since every point in the cone past that is behind
+// the surface
+struct Occluder {
+	vector3d dir;
+	double angle;      // half the cone's angle
+	double tangentLen; // to where the cone touches the sphere
+};
+
+void Camera::SetOcclusionCulling(int level)
+{
+	// queries are core from GL 1.5
+	if (level >= 2 && !glewIsSupported("GL_VERSION_1_5"))
+		level = 1;
+	s_occlusionCulling = Clamp(level, 0, 2);
+}
+
 Camera::Camera(float width, float height, float fovY, float znear, float zfar) :
 	m_width(width),
 	m_height(height),
@@ -34,6 +63,9 @@ Camera::Camera(float width, float height, float fovY, float znear, float zfar) :
 
 Camera::~Camera()
 {
+	for (OcclusionQueryMap::iterator i = m_occlusionQueries.begin(); i != m_occlusionQueries.end(); ++i)
+		glDeleteQueries(1, &i->second.query);
+
 	if (m_camFrame) {
 		m_frame->RemoveChild(m_camFrame);
 		delete m_camFrame;
@@ -63,6 +95,15 @@ static void position_system_lights(Frame *camFrame, Frame *frame, std::vector<Ca
 	}
 }
 
+// the bits of a positive float sort the same as the float does, so farthest
+// first is the bits counting down
+static Uint64 sort_key(double dist, bool drawLast)
+{
+	union { float f; Uint32 u; } d;
+	d.f = float(dist);
+	return (Uint64(drawLast ? 1 : 0) << 32) | Uint64(0xffffffffu - d.u);
+}
+
 void Camera::Update()
 {
 	if (!m_frame) return;
@@ -78,27 +119,139 @@ void Camera::Update()
 	m_camFrame->ClearMovement();
 	m_camFrame->UpdateInterpTransform(1.0);			// update root-relative pos/orient
 
-	// evaluate each body and determine if/where/how to draw it
+	// evaluate each body and determine if/where/how to draw it. the vectors
+	// keep their memory from frame to frame
 	m_sortedBodies.clear();
+	m_sortedBodies.reserve(Pi::game->GetSpace()->GetNumBodies());
+	m_cullSpheres.Clear();
+	m_frameTransforms.clear();
 	for (Space::BodyIterator i = Pi::game->GetSpace()->BodiesBegin(); i != Pi::game->GetSpace()->BodiesEnd(); ++i) {
 		Body *b = *i;
 
 		// prepare attrs for sorting and drawing
 		BodyAttrs attrs;
 		attrs.body = b;
-		Frame::GetFrameRenderTransform(b->GetFrame(), m_camFrame, attrs.viewTransform);
+		attrs.viewTransform = GetFrameTransform(b->GetFrame());
 		attrs.viewCoords = attrs.viewTransform * b->GetInterpPosition();
-		attrs.camDist = attrs.viewCoords.Length();
-		attrs.bodyFlags = b->GetFlags();
 		m_sortedBodies.push_back(attrs);
+		m_cullSpheres.Add(attrs.viewCoords, b->GetClipRadius());
+	}
+
+	// cull them all in one go, and keep the ones that are left
+	m_frustum.TestSpheresInfinite(m_cullSpheres, m_cullVisible);
+	std::vector<BodyAttrs>::iterator out = m_sortedBodies.begin();
+	for (Uint32 i = 0; i < m_cullVisible.size(); i++) {
+		if (!m_cullVisible[i]) continue;
+
+		BodyAttrs &attrs = m_sortedBodies[i];
+		attrs.camDist = attrs.viewCoords.Length();
+		attrs.bodyFlags = attrs.body->GetFlags();
+		attrs.sortKey = sort_key(attrs.camDist, attrs.bodyFlags & Body::FLAG_DRAW_LAST);
+		attrs.occluded = false;
+		*out++ = attrs;
 	}
+	m_sortedBodies.erase(out, m_sortedBodies.end());
 
 	// depth sort
-	m_sortedBodies.sort();
+	std::sort(m_sortedBodies.begin(), m_sortedBodies.end());
+
+	CullOccluded();
+}
+
+void Camera::CullOccluded()
+{
+	if (!s_occlusionCulling) return;
+
+	// planets and stars as seen from here
+	std::vector<Occluder> occluders;
+	for (std::vector<BodyAttrs>::const_iterator i = m_sortedBodies.begin(); i != m_sortedBodies.end(); ++i) {
+		if (!i->body->IsType(Object::TERRAINBODY)) continue;
+		const double radius = i->body->GetSystemBody()->GetRadius() * OCCLUDER_RADIUS_SCALE;
+		if (i->camDist <= radius) continue;
+
+		Occluder o;
+		o.dir = i->viewCoords / i->camDist;
+		o.angle = asin(radius / i->camDist);
+		o.tangentLen = sqrt(i->camDist*i->camDist - radius*radius);
+		occluders.push_back(o);
+	}
+
+	if (!occluders.empty()) {
+		for (std::vector<BodyAttrs>::iterator i = m_sortedBodies.begin(); i != m_sortedBodies.end(); ++i) {
+			// planets have rings and atmospheres and stars have glows
+			// poking out past the sphere, so only the small stuff is culled
+			if (i->body->IsType(Object::TERRAINBODY)) continue;
+			const double rad = i->body->GetClipRadius();
+			if (i->camDist <= rad) continue;
+
+			const vector3d dir = i->viewCoords / i->camDist;
+			const double angle = asin(rad / i->camDist);
+			for (std::vector<Occluder>::const_iterator o = occluders.begin(); o != occluders.end(); ++o) {
+				if (i->camDist - rad < o->tangentLen) continue;
+				const double between = acos(Clamp(dir.Dot(o->dir), -1.0, 1.0));
+				if (between + angle <= o->angle) {
+					i->occluded = true;
+					break;
+				}
+			}
+		}
+	}
+
+	if (s_occlusionCulling < 2) return;
+
+	// pick up the answers to last frame's queries. one that isn't back yet
+	// leaves the answer before it standing
+	for (OcclusionQueryMap::iterator q = m_occlusionQueries.begin(); q != m_occlusionQueries.end(); ++q)
+		q->second.inView = false;
+	for (std::vector<BodyAttrs>::iterator i = m_sortedBodies.begin(); i != m_sortedBodies.end(); ++i) {
+		OcclusionQueryMap::iterator q = m_occlusionQueries.find(i->body);
+		if (q == m_occlusionQueries.end()) continue;
+
+		OcclusionQuery &oq = q->second;
+		oq.inView = true;
+		if (oq.pending) {
+			GLint available = 0;
+			glGetQueryObjectiv(oq.query, GL_QUERY_RESULT_AVAILABLE, &available);
+			if (available) {
+				GLuint samples = 0;
+				glGetQueryObjectuiv(oq.query, GL_QUERY_RESULT, &samples);
+				oq.hidden = (samples == 0);
+				oq.pending = false;
+			}
+		}
+		if (oq.hidden)
+			i->occluded = true;
+	}
+
+	// bodies that left the view, or the game, don't need theirs any more
+	for (OcclusionQueryMap::iterator q = m_occlusionQueries.begin(); q != m_occlusionQueries.end(); ) {
+		if (q->second.inView) {
+			++q;
+			continue;
+		}
+		glDeleteQueries(1, &q->second.query);
+		m_occlusionQueries.erase(q++);
+	}
+}
+
+const matrix4x4d &Camera::GetFrameTransform(const Frame *frame)
+{
+	// there are only a few frames, and most bodies are in one of them
+	for (std::vector<FrameTransform>::const_iterator i = m_frameTransforms.begin(); i != m_frameTransforms.end(); ++i)
+		if (i->frame == frame)
+			return i->transform;
+
+	m_frameTransforms.push_back(FrameTransform());
+	FrameTransform &ft = m_frameTransforms.back();
+	ft.frame = frame;
+	Frame::GetFrameRenderTransform(frame, m_camFrame, ft.transform);
+	return ft.transform;
 }
 
 void Camera::Draw(Renderer *renderer, const Body *excludeBody)
 {
+	PROFILE_ZONE("Camera::Draw");
+
 	if (!m_camFrame) return;
 	if (!renderer) return;
 
@@ -125,6 +278,8 @@ void Camera::Draw(Renderer *renderer, const Body *excludeBody)
 		m_lightSources.push_back(LightSource(0, Graphics::Light(Graphics::Light::LIGHT_DIRECTIONAL, vector3f(0.f), col, col)));
 	}
 
+	PrepareShadows();
+
 	//fade space background based on atmosphere thickness and light angle
 	float bgIntensity = 1.f;
 	if (m_camFrame->GetParent() && m_camFrame->GetParent()->IsRotFrame()) {
@@ -152,7 +307,10 @@ void Camera::Draw(Renderer *renderer, const Body *excludeBody)
 	}
 
 	Pi::game->GetSpace()->GetBackground().SetIntensity(bgIntensity);
-	Pi::game->GetSpace()->GetBackground().Draw(renderer, trans2bg);
+	{
+		FrameProfiler::ScopedPass pass(FrameProfiler::PASS_BACKGROUND);
+		Pi::game->GetSpace()->GetBackground().Draw(renderer, trans2bg);
+	}
 
 	{
 		std::vector<Graphics::Light> rendererLights;
@@ -161,17 +319,18 @@ void Camera::Draw(Renderer *renderer, const Body *excludeBody)
 		renderer->SetLights(rendererLights.size(), &rendererLights[0]);
 	}
 
-	for (std::list<BodyAttrs>::iterator i = m_sortedBodies.begin(); i != m_sortedBodies.end(); ++i) {
+	for (std::vector<BodyAttrs>::iterator i = m_sortedBodies.begin(); i != m_sortedBodies.end(); ++i) {
 		BodyAttrs *attrs = &(*i);
 
 		// explicitly exclude a single body if specified (eg player)
 		if (attrs->body == excludeBody)
 			continue;
 
-		double rad = attrs->body->GetClipRadius();
-		if (!m_frustum.TestPointInfinite((*i).viewCoords, rad))
+		if (attrs->occluded)
 			continue;
 
+		double rad = attrs->body->GetClipRadius();
+
 		// draw spikes for far objects
 		double screenrad = 500 * rad / attrs->camDist;      // approximate pixel size
 		if (attrs->body->IsType(Object::PLANET) && screenrad < 2) {
@@ -184,13 +343,94 @@ void Camera::Draw(Renderer *renderer, const Body *excludeBody)
 			attrs->body->Render(renderer, this, attrs->viewCoords, attrs->viewTransform);
 	}
 
-	Sfx::RenderAll(renderer, Pi::game->GetSpace()->GetRootFrame(), m_camFrame);
+	Projectile::RenderBatch(renderer);
+
+	{
+		FrameProfiler::ScopedPass pass(FrameProfiler::PASS_SFX);
+		Sfx::RenderAll(renderer, Pi::game->GetSpace()->GetRootFrame(), m_camFrame);
+	}
+
+	IssueOcclusionQueries(excludeBody);
 
 	m_frame->RemoveChild(m_camFrame);
 	delete m_camFrame;
 	m_camFrame = 0;
 
 	glPopAttrib();
+	Graphics::TextureGL::InvalidateBindings(); // glPopAttrib put back the old texture bindings
+}
+
+void Camera::IssueOcclusionQueries(const Body *excludeBody)
+{
+	if (s_occlusionCulling < 2) return;
+
+	// only a station is intricate enough to hide a ship the spheres in
+	// CullOccluded wouldn't have caught
+	bool stationInView = false;
+	for (std::vector<BodyAttrs>::const_iterator i = m_sortedBodies.begin(); i != m_sortedBodies.end(); ++i) {
+		if (!i->occluded && i->body->IsType(Object::SPACESTATION)) {
+			stationInView = true;
+			break;
+		}
+	}
+	if (!stationInView) return;
+
+	// a cube around the unit sphere
+	static VertexArray box(ATTRIB_POSITION | ATTRIB_DIFFUSE);
+	if (box.GetNumVerts() == 0) {
+		static const int faces[6][4] = {
+			{ 0, 1, 3, 2 }, { 4, 6, 7, 5 }, { 0, 4, 5, 1 },
+			{ 2, 3, 7, 6 }, { 0, 2, 6, 4 }, { 1, 5, 7, 3 }
+		};
+		vector3f corners[8];
+		for (int c = 0; c < 8; c++)
+			corners[c] = vector3f(c & 4 ? 1.f : -1.f, c & 2 ? 1.f : -1.f, c & 1 ? 1.f : -1.f);
+		for (int f = 0; f < 6; f++) {
+			const int *v = faces[f];
+			box.Add(corners[v[0]], Color::WHITE); box.Add(corners[v[1]], Color::WHITE); box.Add(corners[v[2]], Color::WHITE);
+			box.Add(corners[v[0]], Color::WHITE); box.Add(corners[v[2]], Color::WHITE); box.Add(corners[v[3]], Color::WHITE);
+		}
+	}
+
+	// tested against everything drawn, touching nothing
+	glColorMask(GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE);
+	glDisable(GL_CULL_FACE);
+	m_renderer->SetDepthWrite(false);
+	m_renderer->SetBlendMode(BLEND_SOLID);
+
+	for (std::vector<BodyAttrs>::const_iterator i = m_sortedBodies.begin(); i != m_sortedBodies.end(); ++i) {
+		if (i->body == excludeBody || !i->body->IsType(Object::SHIP))
+			continue;
+
+		// the near plane could cut into the box of one this close, and
+		// then too few samples would pass
+		const double rad = i->body->GetClipRadius();
+		if (i->camDist < 2.0*rad + m_zNear)
+			continue;
+
+		OcclusionQueryMap::iterator q = m_occlusionQueries.find(i->body);
+		if (q == m_occlusionQueries.end()) {
+			// behind a planet, which says all there is to say
+			if (i->occluded) continue;
+			OcclusionQuery oq;
+			glGenQueries(1, &oq.query);
+			oq.pending = oq.hidden = false;
+			oq.inView = true;
+			q = m_occlusionQueries.insert(std::make_pair(i->body, oq)).first;
+		}
+		OcclusionQuery &oq = q->second;
+		if (oq.pending) continue;
+
+		m_renderer->SetTransform(matrix4x4d::Translation(i->viewCoords) * matrix4x4d::ScaleMatrix(rad));
+		glBeginQuery(GL_SAMPLES_PASSED, oq.query);
+		m_renderer->DrawTriangles(&box, Graphics::vtxColorMaterial);
+		glEndQuery(GL_SAMPLES_PASSED);
+		oq.pending = true;
+	}
+
+	m_renderer->SetDepthWrite(true);
+	glEnable(GL_CULL_FACE);
+	glColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
 }
 
 void Camera::DrawSpike(double rad, const vector3d &viewCoords, const matrix4x4d &viewTransform)
@@ -269,14 +509,37 @@ void Camera::DrawSpike(double rad, const vector3d &viewCoords, const matrix4x4d
 	m_renderer->SetDepthTest(true);
 }
 
+void Camera::PrepareShadows()
+{
+	m_shadowCasters.clear();
+	for (Space::BodyIterator i = Pi::game->GetSpace()->BodiesBegin(); i != Pi::game->GetSpace()->BodiesEnd(); ++i) {
+		const Body *b = *i;
+		if (!(b->IsType(Object::PLANET) || b->IsType(Object::STAR)))
+			continue;
+
+		ShadowCaster caster;
+		caster.body = b;
+		caster.pos = b->GetPositionRelTo(m_camFrame);
+		caster.radius = b->GetSystemBody()->GetRadius();
+		m_shadowCasters.push_back(caster);
+	}
+
+	m_lightPositions.clear();
+	for (std::vector<LightSource>::const_iterator i = m_lightSources.begin(); i != m_lightSources.end(); ++i)
+		m_lightPositions.push_back(i->GetBody() ? i->GetBody()->GetPositionRelTo(m_camFrame) : vector3d(0.0));
+}
+
 void Camera::CalcShadows(const int lightNum, const Body *b, std::vector<Shadow> &shadowsOut) const {
 	// Set up data for eclipses. All bodies are assumed to be spheres.
 	const Body *lightBody = m_lightSources[lightNum].GetBody();
 	if (!lightBody)
 		return;
 
+	// positions relative to b, but in the camera frame's orientation
+	const vector3d bPos = b->GetPositionRelTo(m_camFrame);
+
 	const double lightRadius = lightBody->GetPhysRadius();
-	const vector3d bLightPos = lightBody->GetPositionRelTo(b);
+	const vector3d bLightPos = m_lightPositions[lightNum] - bPos;
 	const vector3d lightDir = bLightPos.Normalized();
 
 	double bRadius;
@@ -284,13 +547,13 @@ void Camera::CalcShadows(const int lightNum, const Body *b, std::vector<Shadow>
 	else bRadius = b->GetPhysRadius();
 
 	// Look for eclipsing third bodies:
-	for (Space::BodyIterator ib2 = Pi::game->GetSpace()->BodiesBegin(); ib2 != Pi::game->GetSpace()->BodiesEnd(); ++ib2) {
-		Body *b2 = *ib2;
-		if ( b2 == b || b2 == lightBody || !(b2->IsType(Object::PLANET) || b2->IsType(Object::STAR)))
+	for (std::vector<ShadowCaster>::const_iterator ib2 = m_shadowCasters.begin(); ib2 != m_shadowCasters.end(); ++ib2) {
+		const Body *b2 = ib2->body;
+		if ( b2 == b || b2 == lightBody )
 			continue;
 
-		double b2Radius = b2->GetSystemBody()->GetRadius();
-		vector3d b2pos = b2->GetPositionRelTo(b);
+		const double b2Radius = ib2->radius;
+		const vector3d b2pos = ib2->pos - bPos;
 		const double perpDist = lightDir.Dot(b2pos);
 
 		if ( perpDist <= 0 || perpDist > bLightPos.Length())
@@ -314,8 +577,9 @@ void Camera::CalcShadows(const int lightNum, const Body *b, std::vector<Shadow>
 		}
 		const vector3d projectedCentre = ( b2pos - perpDist*lightDir ) / bRadius;
 		if (projectedCentre.Length() < 1 + srad + lrad) {
-			// some part of b is (partially) eclipsed
-			Camera::Shadow shadow = { lightNum, projectedCentre, static_cast<float>(srad), static_cast<float>(lrad) };
+			// some part of b is (partially) eclipsed. the centre is wanted
+			// in b's frame, not the camera's
+			Camera::Shadow shadow = { lightNum, m_camFrame->RotateRelTo(projectedCentre, b->GetFrame()), static_cast<float>(srad), static_cast<float>(lrad) };
 			shadowsOut.push_back(shadow);
 		}
 	}
@@ -10,6 +10,8 @@
 #include "matrix4x4.h"
 #include "Background.h"
 #include "Body.h"
+#include <map>
+#include <vector>
 
 
 class Frame;
@@ -24,6 +26,14 @@ public:
 	void Update();
 	void Draw(Graphics::Renderer *r, const Body *excludeBody = 0);
 
+	// how hard Draw tries to skip bodies that can't be seen. 0 draws
+	// everything in the frustum, 1 skips ships, stations and the like that
+	// are behind a planet or star. 2 also has the GPU count how much of
+	// each ship showed last frame, for ones hidden behind or inside a
+	// station. the answer comes a frame late, so a ship coming out from
+	// behind one appears a frame late too. needs GL 1.5
+	static void SetOcclusionCulling(int level);
+
 	// frame to position the camera relative to
 	void SetFrame(Frame *frame) { m_frame = frame; }
 	Frame *GetFrame() const { return m_frame; }
@@ -72,24 +82,8 @@ public:
 	// get the frustum. use for projection
 	const Graphics::Frustum &GetFrustum() const { return m_frustum; }
 
-private:
-	void DrawSpike(double rad, const vector3d &viewCoords, const matrix4x4d &viewTransform);
-
-	float m_width;
-	float m_height;
-	float m_fovAng;
-	float m_zNear;
-	float m_zFar;
-
-	Graphics::Frustum m_frustum;
-
-	vector3d m_pos;
-	matrix3x3d m_orient;
-
-	Frame *m_frame;
-	Frame *m_camFrame;
-
-	// temp attrs for sorting and drawing
+	// temp attrs for sorting and drawing, worked out by Update() for every
+	// body that might be in view. valid until the next Update()
 	struct BodyAttrs {
 		Body *body;
 
@@ -103,28 +97,83 @@ private:
 		// body flags. DRAW_LAST is the interesting one
 		Uint32 bodyFlags;
 
-		// for sorting. "should a be drawn before b?"
-		friend bool operator<(const BodyAttrs &a, const BodyAttrs &b) {
-			// both drawing last; distance order
-			if (a.bodyFlags & Body::FLAG_DRAW_LAST && b.bodyFlags & Body::FLAG_DRAW_LAST)
-				return a.camDist > b.camDist;
-
-			// a drawing last; draw b first
-			if (a.bodyFlags & Body::FLAG_DRAW_LAST)
-				return false;
+		// draw order packed into one number, smallest first: DRAW_LAST in
+		// the top half, then the distance, farthest first
+		Uint64 sortKey;
 
-			// b drawing last; draw a first
-			if (b.bodyFlags & Body::FLAG_DRAW_LAST)
-				return true;
+		// in the frustum but certainly out of sight, so not drawn
+		bool occluded;
 
-			// both in normal draw; distance order
-			return a.camDist > b.camDist;
+		friend bool operator<(const BodyAttrs &a, const BodyAttrs &b) {
+			return a.sortKey < b.sortKey;
 		}
 	};
 
-	std::list<BodyAttrs> m_sortedBodies;
+	// in draw order, farthest first. bodies outside the frustum aren't
+	// here, occluded ones are
+	const std::vector<BodyAttrs> &GetSortedBodies() const { return m_sortedBodies; }
+
+private:
+	void DrawSpike(double rad, const vector3d &viewCoords, const matrix4x4d &viewTransform);
+
+	float m_width;
+	float m_height;
+	float m_fovAng;
+	float m_zNear;
+	float m_zFar;
+
+	Graphics::Frustum m_frustum;
+
+	vector3d m_pos;
+	matrix3x3d m_orient;
+
+	Frame *m_frame;
+	Frame *m_camFrame;
+
+	std::vector<BodyAttrs> m_sortedBodies;
 	std::vector<LightSource> m_lightSources;
 
+	// the view transform of each frame that has a body in it, worked out
+	// the first time a body in it is found each Update
+	struct FrameTransform {
+		const Frame *frame;
+		matrix4x4d transform;
+	};
+	const matrix4x4d &GetFrameTransform(const Frame *frame);
+	std::vector<FrameTransform> m_frameTransforms;
+
+	// every body's bounds, to frustum test them together
+	Graphics::SphereBatch m_cullSpheres;
+	std::vector<Uint8> m_cullVisible;
+
+	// planets and stars, the only bodies big enough to eclipse anything,
+	// and where they and the lights are in the camera frame. Draw() works
+	// them out once for every CalcShadows
+	struct ShadowCaster {
+		const Body *body;
+		vector3d pos;
+		double radius;
+	};
+	void PrepareShadows();
+	std::vector<ShadowCaster> m_shadowCasters;
+	std::vector<vector3d> m_lightPositions;
+
+	// marks the sorted bodies that are behind a planet or star, or that
+	// last frame's query found hidden
+	void CullOccluded();
+
+	// a GL_SAMPLES_PASSED query for a ship, counting what of the box around
+	// it passed the depth test once everything else was drawn
+	struct OcclusionQuery {
+		Uint32 query; // GLuint
+		bool pending; // issued, not read yet
+		bool hidden;  // the last result was no samples at all
+		bool inView;  // in this Update's bodies
+	};
+	typedef std::map<const Body*, OcclusionQuery> OcclusionQueryMap;
+	void IssueOcclusionQueries(const Body *excludeBody);
+	OcclusionQueryMap m_occlusionQueries;
+
 	Graphics::Renderer *m_renderer;
 };
 
@@ -6,11 +6,12 @@
 
 #include "libs.h"
 #include "DynamicBody.h"
+#include "BodyPool.h"
 #include "EquipType.h"
 
 namespace Graphics { class Renderer; }
 
-class CargoBody: public DynamicBody {
+class CargoBody: public DynamicBody, public BodyPool<CargoBody> {
 public:
 	OBJDEF(CargoBody, DynamicBody, CARGOBODY);
 	CargoBody(Equip::Type t);
@@ -21,9 +21,21 @@ static const unsigned int DEFAULT_NUM_BUILDINGS = 1000;
 static const double  START_SEG_SIZE = CITY_ON_PLANET_RADIUS;
 static const double MIN_SEG_SIZE = 50.0;
 static const unsigned int CITYFLAVOURS = 5;
+static const double CELL_SIZE = 1000.0;
 
 using SceneGraph::Model;
 
+struct CellCoord {
+	int x, y, z;
+	CellCoord(const vector3d &pos)
+		: x(int(floor(pos.x / CELL_SIZE))), y(int(floor(pos.y / CELL_SIZE))), z(int(floor(pos.z / CELL_SIZE))) {}
+	bool operator<(const CellCoord &o) const {
+		if (x != o.x) return x < o.x;
+		if (y != o.y) return y < o.y;
+		return z < o.z;
+	}
+};
+
 bool s_cityBuildingsInitted = false;
 struct citybuilding_t {
 	const char *modelname;
@@ -100,7 +112,8 @@ always_divide:
 		PutCityBit(rand, rot, d, e, c, p4);
 	} else {
 		cent = cent.Normalized();
-		double height = m_planet->GetTerrainHeight(cent);
+		// buildings are sunk into the ground a little anyway
+		double height = m_planet->GetTerrainHeight(cent, 1.0);
 		/* don't position below sealevel! */
 		if (height - m_planet->GetSystemBody()->GetRadius() <= 0.0) return;
 		cent = cent * height;
@@ -119,7 +132,7 @@ always_divide:
 
 void CityOnPlanet::AddStaticGeomsToCollisionSpace()
 {
-	m_enabledBuildings.clear();
+	m_cells.clear();
 	int skipMask;
 	switch (Pi::detail.cities) {
 		case 0: skipMask = 0xf; break;
@@ -129,28 +142,38 @@ void CityOnPlanet::AddStaticGeomsToCollisionSpace()
 		default:
 			skipMask = 0; break;
 	}
-	Uint32 numVisibleBuildings = 0;
-	for (unsigned int i=0; i<m_buildings.size(); i++) {
-		if (!(i&skipMask)) {
-			++numVisibleBuildings;
-		}
-	}
-
-	// we know how many building we'll be adding, reserve space up front
-	m_enabledBuildings.reserve(numVisibleBuildings);
+	std::map<CellCoord, unsigned int> cellIndex;
 	for (unsigned int i=0; i<m_buildings.size(); i++) {
 		if (i & skipMask) {
 		} else {
 			m_frame->AddStaticGeom(m_buildings[i].geom);
-			m_enabledBuildings.push_back(m_buildings[i]);
+
+			const CellCoord coord(m_buildings[i].pos);
+			std::map<CellCoord, unsigned int>::const_iterator it = cellIndex.find(coord);
+			if (it == cellIndex.end()) {
+				it = cellIndex.insert(std::make_pair(coord, unsigned(m_cells.size()))).first;
+				m_cells.push_back(Cell());
+			}
+			m_cells[it->second].buildings.push_back(m_buildings[i]);
 		}
 	}
+
+	// a sphere around each cell's buildings
+	for (std::vector<Cell>::iterator cell = m_cells.begin(); cell != m_cells.end(); ++cell) {
+		Aabb aabb;
+		for (std::vector<BuildingDef>::const_iterator b = cell->buildings.begin(); b != cell->buildings.end(); ++b)
+			aabb.Update(b->pos);
+		cell->centre = (aabb.min + aabb.max) * 0.5;
+		cell->clipRadius = 0.f;
+		for (std::vector<BuildingDef>::const_iterator b = cell->buildings.begin(); b != cell->buildings.end(); ++b)
+			cell->clipRadius = std::max(cell->clipRadius, float((b->pos - cell->centre).Length()) + b->clipRadius);
+	}
 	m_detailLevel = Pi::detail.cities;
 }
 
 void CityOnPlanet::RemoveStaticGeomsFromCollisionSpace()
 {
-	m_enabledBuildings.clear();
+	m_cells.clear();
 	for (unsigned int i=0; i<m_buildings.size(); i++) {
 		m_frame->RemoveStaticGeom(m_buildings[i].geom);
 	}
@@ -169,18 +192,21 @@ static void enumerateNewBuildings(std::vector<std::string> &filenames)
 	}
 }
 
+static std::vector<std::string> s_buildingNames;
+
 static void lookupBuildingListModels(citybuildinglist_t *list)
 {
 	std::vector<Model*> models;
 
 	//get test newmodels - to be replaced with building set definitions
 	{
-		std::vector<std::string> filenames;
-		enumerateNewBuildings(filenames);
-		for (std::vector<std::string>::const_iterator it = filenames.begin();
-			it != filenames.end(); ++it)
+		if (s_buildingNames.empty())
+			enumerateNewBuildings(s_buildingNames);
+		for (std::vector<std::string>::const_iterator it = s_buildingNames.begin();
+			it != s_buildingNames.end(); ++it)
 		{
 			Model *model = Pi::modelCache->FindModel(*it);
+			Pi::modelCache->Pin(model);
 			models.push_back(model);
 		}
 	}
@@ -203,20 +229,28 @@ static void lookupBuildingListModels(citybuildinglist_t *list)
 
 void CityOnPlanet::Init()
 {
-	/* Resolve city model numbers since it is a bit expensive */
-	if (!s_cityBuildingsInitted) {
-		s_cityBuildingsInitted = true;
-		for (unsigned int i=0; i<COUNTOF(s_buildingLists); i++) {
-			lookupBuildingListModels(&s_buildingLists[i]);
-		}
-	}
+	/* Only find out which buildings there are. The models themselves are
+	 * loaded when the first city is built */
+	s_buildingNames.clear();
+	enumerateNewBuildings(s_buildingNames);
+}
+
+void CityOnPlanet::RequestModels()
+{
+	if (s_cityBuildingsInitted) return;
+	for (std::vector<std::string>::const_iterator it = s_buildingNames.begin(); it != s_buildingNames.end(); ++it)
+		Pi::modelCache->RequestModel(*it);
 }
 
 void CityOnPlanet::Uninit()
 {
 	for (unsigned int list=0; list<COUNTOF(s_buildingLists); list++) {
 		delete[] s_buildingLists[list].buildings;
+		s_buildingLists[list].buildings = 0;
+		s_buildingLists[list].numBuildings = 0;
 	}
+	s_buildingNames.clear();
+	s_cityBuildingsInitted = false;
 }
 
 // Need a reliable way to sort the models rather than using there address in memory we use their name which should be unique.
@@ -380,16 +414,39 @@ void CityOnPlanet::Render(Graphics::Renderer *r, const Camera *camera, const Spa
 		}
 	}
 
-	for (std::vector<BuildingDef>::const_iterator iter=m_enabledBuildings.begin(), itEND=m_enabledBuildings.end(); iter != itEND; ++iter)
+	// draw every building in one queue, so all the copies of each one go
+	// out together
+	Graphics::Renderer::QueueTicket queue(r);
+
+	m_cullSpheres.Clear();
+	for (std::vector<Cell>::const_iterator cell=m_cells.begin(), cellEND=m_cells.end(); cell != cellEND; ++cell)
+		m_cullSpheres.Add(viewTransform * (*cell).centre, (*cell).clipRadius);
+	frustum.TestSpheres(m_cullSpheres, m_cullVisible);
+
+	m_cullSpheres.Clear();
+	m_cullBuildings.clear();
+	for (Uint32 i = 0; i < m_cells.size(); i++)
+	{
+		if (!m_cullVisible[i])
+			continue;
+
+		for (std::vector<BuildingDef>::const_iterator iter=m_cells[i].buildings.begin(), itEND=m_cells[i].buildings.end(); iter != itEND; ++iter)
+		{
+			m_cullSpheres.Add(viewTransform * (*iter).pos, (*iter).clipRadius);
+			m_cullBuildings.push_back(&(*iter));
+		}
+	}
+	frustum.TestSpheres(m_cullSpheres, m_cullVisible);
+
+	for (Uint32 i = 0; i < m_cullBuildings.size(); i++)
 	{
-		const vector3d pos = viewTransform * (*iter).pos;
-		const vector3f posf(pos);
-		if (!frustum.TestPoint(pos, (*iter).clipRadius))
+		if (!m_cullVisible[i])
 			continue;
 
-		matrix4x4f _rot(rotf[(*iter).rotation]);
-		_rot.SetTranslate(posf);
+		const BuildingDef &building = *m_cullBuildings[i];
+		matrix4x4f _rot(rotf[building.rotation]);
+		_rot.SetTranslate(vector3f(m_cullSpheres.x[i], m_cullSpheres.y[i], m_cullSpheres.z[i]));
 
-		(*iter).model->Render(_rot);
+		building.model->Render(_rot);
 	}
 }
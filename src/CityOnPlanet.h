@@ -8,6 +8,7 @@
 #include "Random.h"
 #include "Object.h"
 #include "galaxy/StarSystem.h"
+#include "graphics/Frustum.h"
 
 class Planet;
 class SpaceStation;
@@ -29,6 +30,9 @@ public:
 
 	static void Init();
 	static void Uninit();
+	// start loading the building models in the background, ahead of the
+	// first city
+	static void RequestModels();
 	static void SetCityModelPatterns(const SystemPath &path);
 private:
 	void PutCityBit(Random &rand, const matrix4x4d &rot, vector3d p1, vector3d p2, vector3d p3, vector3d p4);
@@ -43,13 +47,27 @@ private:
 		Geom *geom;
 	};
 
+	// enabled buildings, bucketed into a grid so whole cells can be
+	// frustum culled at once
+	struct Cell {
+		vector3d centre;
+		float clipRadius;
+		std::vector<BuildingDef> buildings;
+	};
+
 	Planet *m_planet;
 	Frame *m_frame;
 	std::vector<BuildingDef> m_buildings;
-	std::vector<BuildingDef> m_enabledBuildings;
+	std::vector<Cell> m_cells;
 	int m_detailLevel;
 	vector3d m_realCentre;
 	float m_clipRadius;
+
+	// cells, then the buildings in the cells that pass, packed to be
+	// frustum tested together. kept to reuse the memory
+	Graphics::SphereBatch m_cullSpheres;
+	std::vector<Uint8> m_cullVisible;
+	std::vector<const BuildingDef*> m_cullBuildings;
 };
 
 #endif /* _CITYONPLANET_H */
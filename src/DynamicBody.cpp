@@ -29,6 +29,10 @@ DynamicBody::DynamicBody(): ModelBody()
 	m_externalForce = vector3d(0.0);		// do external forces calc instead?
 	m_lastForce = vector3d(0.0);
 	m_lastTorque = vector3d(0.0);
+	m_parallelStepDone = false;
+	m_onRails = false;
+	m_railsTime = 0.0;
+	m_railsFrame = 0;
 }
 
 void DynamicBody::SetForce(const vector3d &f)
@@ -156,13 +160,94 @@ void DynamicBody::CalcExternalForce()
 	}
 }
 
+// steps at least this long (about 100x time accel and up) are coarse enough
+// that integrating an orbit goes badly wrong, so coasting bodies follow the
+// analytic orbit instead. below that the integrator does fine
+static const float RAILS_MIN_TIMESTEP = 1.0f;
+// Orbit's Kepler solver loses accuracy on very eccentric orbits and
+// doesn't handle escape trajectories well at all
+static const double RAILS_MAX_ECCENTRICITY = 0.9;
+// how closely the orbit has to reproduce the current state before we trust
+// it, relative to distance and speed
+static const double RAILS_POS_TOLERANCE = 1e-6;
+static const double RAILS_VEL_TOLERANCE = 1e-5;
+// for finding velocity along the orbit
+static const double RAILS_VEL_DT = 1.0;
+
+static vector3d orbital_vel_at_time(const Orbit &orbit, double t)
+{
+	return (orbit.OrbitalPosAtTime(t + RAILS_VEL_DT) - orbit.OrbitalPosAtTime(t - RAILS_VEL_DT)) / (2.0 * RAILS_VEL_DT);
+}
+
+// nothing but the frame body's gravity acting on us, so an orbit around it
+// is exactly what integration is trying to approximate
+bool DynamicBody::IsCoasting(float timeStep) const
+{
+	if (timeStep < RAILS_MIN_TIMESTEP) return false;
+	if (!m_force.ExactlyEqual(vector3d(0.0)) || !m_torque.ExactlyEqual(vector3d(0.0))) return false;
+	if (!m_atmosForce.ExactlyEqual(vector3d(0.0))) return false;
+
+	const Frame *frame = GetFrame();
+	if (!frame || frame->IsRotFrame()) return false;
+	const Body *body = frame->GetBody();
+	return body && !body->IsType(Object::SPACESTATION);
+}
+
+// moves the body along its orbit for one step. returns false (without
+// touching anything) if the orbit can't be trusted, in which case the caller
+// should integrate as usual
+bool DynamicBody::StepOnRails(float timeStep)
+{
+	// anything else moving us (collisions, frame changes, undone steps)
+	// invalidates the orbit
+	if (m_onRails && (GetFrame() != m_railsFrame || !GetPosition().ExactlyEqual(m_railsPos) || !m_vel.ExactlyEqual(m_railsVel)))
+		m_onRails = false;
+
+	if (!m_onRails) {
+		const Orbit orbit = Orbit::FromBodyState(GetPosition(), m_vel, GetFrame()->GetBody()->GetMass());
+		if (orbit.GetEccentricity() >= RAILS_MAX_ECCENTRICITY) return false;
+		if ((orbit.OrbitalPosAtTime(0.0) - GetPosition()).Length() > RAILS_POS_TOLERANCE * GetPosition().Length()) return false;
+		if ((orbital_vel_at_time(orbit, 0.0) - m_vel).Length() > RAILS_VEL_TOLERANCE * m_vel.Length()) return false;
+
+		m_onRails = true;
+		m_railsOrbit = orbit;
+		m_railsTime = 0.0;
+		m_railsFrame = GetFrame();
+	}
+
+	m_railsTime += timeStep;
+	m_vel = orbital_vel_at_time(m_railsOrbit, m_railsTime);
+	SetPosition(m_railsOrbit.OrbitalPosAtTime(m_railsTime));
+
+	m_railsPos = GetPosition();
+	m_railsVel = m_vel;
+	return true;
+}
+
+void DynamicBody::ParallelTimeStepUpdate(const float timeStep)
+{
+	Integrate(timeStep);
+	m_parallelStepDone = true;
+}
+
 void DynamicBody::TimeStepUpdate(const float timeStep)
+{
+	if (m_parallelStepDone)
+		m_parallelStepDone = false;
+	else
+		Integrate(timeStep);
+}
+
+void DynamicBody::Integrate(const float timeStep)
 {
 	m_oldPos = GetPosition();
 	if (m_isMoving) {
+		const bool railed = IsCoasting(timeStep) && StepOnRails(timeStep);
+		if (!railed) m_onRails = false;
+
 		m_force += m_externalForce;
 
-		m_vel += double(timeStep) * m_force * (1.0 / m_mass);
+		if (!railed) m_vel += double(timeStep) * m_force * (1.0 / m_mass);
 		m_angVel += double(timeStep) * m_torque * (1.0 / m_angInertia);
 
 		double len = m_angVel.Length();
@@ -173,7 +258,8 @@ void DynamicBody::TimeStepUpdate(const float timeStep)
 		}
 		m_oldAngDisplacement = m_angVel * timeStep;
 
-		SetPosition(GetPosition() + m_vel * double(timeStep));
+		if (!railed)
+			SetPosition(GetPosition() + m_vel * double(timeStep));
 
 //if (this->IsType(Object::PLAYER))
 //printf("pos = %.1f,%.1f,%.1f, vel = %.1f,%.1f,%.1f, force = %.1f,%.1f,%.1f, external = %.1f,%.1f,%.1f\n",
@@ -194,9 +280,11 @@ void DynamicBody::UpdateInterpTransform(double alpha)
 {
 	m_interpPos = alpha*GetPosition() + (1.0-alpha)*m_oldPos;
 
-	double len = m_oldAngDisplacement.Length() * (1.0-alpha);
+	// one square root, and only for bodies that are turning at all
+	const double angle = m_oldAngDisplacement.LengthSqr() > 0.0 ? m_oldAngDisplacement.Length() : 0.0;
+	const double len = angle * (1.0-alpha);
 	if (len > 1e-16) {
-		vector3d axis = m_oldAngDisplacement.Normalized();
+		const vector3d axis = m_oldAngDisplacement * (1.0/angle);
 		matrix3x3d rot = matrix3x3d::Rotate(-len, axis);		// rotate backwards
 		m_interpOrient = rot * GetOrient();
 	}
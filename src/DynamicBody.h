@@ -29,6 +29,10 @@ public:
 	bool IsMoving() const { return m_isMoving; }
 	virtual double GetMass() const { return m_mass; }	// XXX don't override this
 	virtual void TimeStepUpdate(const float timeStep);
+	// integration only touches this body, so any moving body can do it on a
+	// worker. TimeStepUpdate then skips it
+	virtual bool HasParallelTimeStep() const { return m_isMoving; }
+	virtual void ParallelTimeStepUpdate(const float timeStep);
 	void CalcExternalForce();
 	void UndoTimestep();
 
@@ -50,10 +54,19 @@ public:
 	virtual void PostLoadFixup(Space *space);
 
 	Orbit ComputeOrbit() const;
+
+	// true while the body is coasting along an orbit worked out analytically
+	// rather than being integrated (see StepOnRails)
+	bool IsOnRails() const { return m_onRails; }
 protected:
 	virtual void Save(Serializer::Writer &wr, Space *space);
 	virtual void Load(Serializer::Reader &rd, Space *space);
+	// true from ParallelTimeStepUpdate until the following TimeStepUpdate
+	bool IsParallelStepDone() const { return m_parallelStepDone; }
 private:
+	void Integrate(const float timeStep);
+	bool m_parallelStepDone;
+
 	vector3d m_oldPos;
 	vector3d m_oldAngDisplacement;
 
@@ -72,6 +85,16 @@ private:
 	// for time accel reduction fudge
 	vector3d m_lastForce;
 	vector3d m_lastTorque;
+
+	bool IsCoasting(float timeStep) const;
+	bool StepOnRails(float timeStep);
+
+	bool m_onRails;
+	Orbit m_railsOrbit;
+	double m_railsTime;		// since the orbit was worked out
+	const Frame *m_railsFrame;
+	vector3d m_railsPos;	// where the rails left us, so we can tell if
+	vector3d m_railsVel;	// something else moved us since
 };
 
 #endif /* _DYNAMICBODY_H */
@@ -13,8 +13,7 @@ class EquipSet {
 public:
 	EquipSet() {}
 
-	void InitSlotSizes(const ShipType::Id &t) {
-		const ShipType &st = ShipType::types[t];
+	void InitSlotSizes(const ShipType &st) {
 		for (int i=0; i<Equip::SLOT_MAX; i++) {
 			// vector swap idiom (de-allocates unneeded space)
 			std::vector<Equip::Type>(st.equipSlotCapacity[i], Equip::NONE).swap(equip[i]);
@@ -3,6 +3,7 @@
 
 #include "Factions.h"
 #include "galaxy/Sector.h"
+#include "galaxy/GalaxyIndex.h"
 #include "galaxy/SystemPath.h"
 
 #include "LuaUtils.h"
@@ -30,7 +31,7 @@ static Faction       s_no_faction;    // instead of answering null, we often wan
 static FactionList       s_factions;
 static FactionMap        s_factions_byName;
 static HomeSystemSet     s_homesystems;
-static FactionOctsapling s_spatial_index;
+static FactionSpatialIndex s_spatial_index;
 
 // ------- Lua Faction Builder --------
 
@@ -249,10 +250,14 @@ static int l_fac_add_to_factions(lua_State *L)
 		// add the faction to the various faction data structures
 		s_factions.push_back(facbld->fac);
 		s_factions_byName[facbld->fac->name] = facbld->fac;
-		s_spatial_index.Add(facbld->fac);
-
-		if (facbld->fac->hasHomeworld) s_homesystems.insert(facbld->fac->homeworld.SystemOnly());
 		facbld->fac->idx = s_factions.size()-1;
+		if (facbld->fac->hasHomeworld) {
+			const SystemPath &home = facbld->fac->homeworld;
+			const Sector homeSector(home.sectorX, home.sectorY, home.sectorZ);
+			s_spatial_index.Add(facbld->fac, &homeSector);
+			s_homesystems.insert(home.SystemOnly());
+		} else
+			s_spatial_index.Add(facbld->fac, 0);
 		facbld->registered = true;
 
 		return 0;
@@ -339,6 +344,25 @@ void Faction::Init()
 
 	printf("Number of factions added: " SIZET_FMT "\n", s_factions.size());
 	StarSystem::ShrinkCache();    // clear the star system cache of anything we used for faction generation
+	Sector::ShrinkCache();        // and the sector cache, its names and factions were assigned before every faction was in
+	GalaxyIndex::Clear();         // system positions depend on the names too
+	StarSystem::ClearSummaries(); // and summaries on the factions and home systems
+
+	// build the home sectors now that all the homeworlds are known. after
+	// this GetNearestFaction only reads, so sectors can be generated off
+	// the main thread
+	for (FactionIterator it = s_factions.begin(); it != s_factions.end(); ++it) {
+		Faction *fac = *it;
+		if (!fac->hasHomeworld) continue;
+		delete fac->m_homesector;
+		fac->m_homesector = new Sector(fac->homeworld.sectorX, fac->homeworld.sectorY, fac->homeworld.sectorZ);
+	}
+
+	// and index them again, as the home systems of factions added before
+	// the custom systems were in may only exist now
+	s_spatial_index.Clear();
+	for (FactionIterator it = s_factions.begin(); it != s_factions.end(); ++it)
+		s_spatial_index.Add(*it, (*it)->m_homesector);
 }
 
 void Faction::Uninit()
@@ -348,6 +372,7 @@ void Faction::Uninit()
 	}
 	s_factions.clear();
 	s_factions_byName.clear();
+	s_spatial_index.Clear();
 }
 
 // ------- Factions proper --------
@@ -367,6 +392,11 @@ Faction* Faction::GetFaction(const std::string factionName)
 	}
 }
 
+Faction* Faction::GetNoFaction()
+{
+	return &s_no_faction;
+}
+
 const Uint32 Faction::GetNumFactions()
 {
 	return s_factions.size();
@@ -378,7 +408,7 @@ const Uint32 Faction::GetNumFactions()
 	if it is, then the passed distance will also be updated to be the distance
 	from the factions homeworld to the sysPath.
 */
-const bool Faction::IsCloserAndContains(double& closestFactionDist, const Sector sec, Uint32 sysIndex)
+const bool Faction::IsCloserAndContains(double& closestFactionDist, const Sector &sec, Uint32 sysIndex)
 {
 	/*	Treat factions without homeworlds as if they are of effectively infinite radius,
 		so every world is potentially within their borders, but also treat them as if
@@ -415,7 +445,15 @@ const bool Faction::IsCloserAndContains(double& closestFactionDist, const Sector
 	}
 }
 
-Faction* Faction::GetNearestFaction(const Sector sec, Uint32 sysIndex)
+Faction* Faction::GetNearestFaction(const Sector &sec, Uint32 sysIndex)
+{
+	const Sector::System &sys = sec.m_systems[sysIndex];
+	FactionList candidates;
+	GetCandidateFactions(sys.sx, sys.sy, sys.sz, candidates);
+	return GetNearestFaction(sec, sysIndex, candidates);
+}
+
+Faction* Faction::GetNearestFaction(const Sector &sec, Uint32 sysIndex, const FactionList &candidates)
 {
 	/* firstly if this a custom StarSystem it may already have a faction assigned
 	*/
@@ -427,14 +465,18 @@ Faction* Faction::GetNearestFaction(const Sector sec, Uint32 sysIndex)
 	*/
 	Faction*    result             = &s_no_faction;
 	double      closestFactionDist = HUGE_VAL;
-	FactionList candidates         = s_spatial_index.CandidateFactions(sec, sysIndex);
 
-	for (FactionIterator it = candidates.begin(); it != candidates.end(); ++it) {
+	for (FactionList::const_iterator it = candidates.begin(); it != candidates.end(); ++it) {
 		if ((*it)->IsCloserAndContains(closestFactionDist, sec, sysIndex)) result = *it;
 	}
 	return result;
 }
 
+void Faction::GetCandidateFactions(int sx, int sy, int sz, FactionList &out)
+{
+	s_spatial_index.CandidateFactions(sx, sy, sz, out);
+}
+
 bool Faction::IsHomeSystem(const SystemPath& sysPath)
 {
 	return s_homesystems.find(sysPath.SystemOnly()) != s_homesystems.end();
@@ -524,94 +566,80 @@ Faction::~Faction()
 
 // ------ Factions Spatial Indexing ------
 
-void FactionOctsapling::Add(Faction* faction)
+void FactionSpatialIndex::Add(Faction* faction, const Sector *homeSector)
 {
-	/*  The general principle here is to put the faction in every octbox cell that a system
-	    that is a member of that faction could be in. This should let us cut the number
-		of factions that have to be checked by GetNearestFaction, by eliminating right off
-		all the those Factions that aren't in the same cell.
-
-		As I'm just going for the quick performance win, I'm being very sloppy and
-		treating a Faction as if it was a cube rather than a sphere. I'm also not even
-		attempting to work out real faction boundaries for this.
-
-		Obviously this all could be improved even without this Octsapling growing into
-		a full Octree.
-
-		This part happens at faction generation time so shouldn't be too performance
-		critical
+	/*  This part happens at faction generation time so shouldn't be too performance
+		critical. The box is generous: it takes in every sector that the faction's
+		sphere touches, so a sector outside it can never belong to the faction.
 	*/
-	Sector sec = Sector(faction->homeworld.sectorX, faction->homeworld.sectorY, faction->homeworld.sectorZ);
+	Entry entry;
+	entry.faction = faction;
+	entry.everywhere = true;
 
-	/* only factions with homeworlds that are available at faction generation time can
-	   be added to specific cells...
+	/* only factions with homeworlds that are available now can be put in specific
+	   cells...
 	*/
-	if (faction->hasHomeworld && (faction->homeworld.systemIndex < sec.m_systems.size())) {
-		/* calculate potential indexes for the octbox cells the faction needs to go into
-		*/
-		Sector::System sys = sec.m_systems[faction->homeworld.systemIndex];
-
-		int xmin = BoxIndex(Sint32(sys.FullPosition().x - float((faction->Radius()))));
-		int xmax = BoxIndex(Sint32(sys.FullPosition().x + float((faction->Radius()))));
-		int ymin = BoxIndex(Sint32(sys.FullPosition().y - float((faction->Radius()))));
-		int ymax = BoxIndex(Sint32(sys.FullPosition().y + float((faction->Radius()))));
-		int zmin = BoxIndex(Sint32(sys.FullPosition().z - float((faction->Radius()))));
-		int zmax = BoxIndex(Sint32(sys.FullPosition().z + float((faction->Radius()))));
-
-		/* put the faction in all the octbox cells needed in a hideously inexact way that
-		   will generate duplicates in each cell in many cases
-		*/
-		octbox[xmin][ymin][zmin].push_back(faction);  // 0,0,0
-		octbox[xmax][ymin][zmin].push_back(faction);  // 1,0,0
-		octbox[xmax][ymax][zmin].push_back(faction);  // 1,1,0
-		octbox[xmax][ymax][zmax].push_back(faction);  // 1,1,1
-
-		octbox[xmin][ymax][zmin].push_back(faction);  // 0,1,0
-		octbox[xmin][ymax][zmax].push_back(faction);  // 0,1,1
-		octbox[xmin][ymin][zmax].push_back(faction);  // 0,0,1
-		octbox[xmax][ymin][zmax].push_back(faction);  // 1,0,1
-
-		/* prune any duplicates from the octbox cells making things slightly saner
-		*/
-		PruneDuplicates(0,0,0);
-		PruneDuplicates(1,0,0);
-		PruneDuplicates(1,1,0);
-		PruneDuplicates(1,1,1);
+	if (faction->hasHomeworld && homeSector && (faction->homeworld.systemIndex < homeSector->m_systems.size())) {
+		Sector::System sys = homeSector->m_systems[faction->homeworld.systemIndex];
+		const vector3f pos = sys.FullPosition();
+		const float radius = std::max(float(faction->Radius()), 0.0f);
+
+		for (int i = 0; i < 3; i++) {
+			entry.min[i] = Sint32(floor((pos[i] - radius) / Sector::SIZE));
+			entry.max[i] = Sint32(floor((pos[i] + radius) / Sector::SIZE));
+		}
+		entry.everywhere =
+			(CellIndex(entry.max[0]) - CellIndex(entry.min[0]) >= MAX_CELLS_ACROSS) ||
+			(CellIndex(entry.max[1]) - CellIndex(entry.min[1]) >= MAX_CELLS_ACROSS) ||
+			(CellIndex(entry.max[2]) - CellIndex(entry.min[2]) >= MAX_CELLS_ACROSS);
+	}
 
-		PruneDuplicates(0,1,0);
-		PruneDuplicates(0,1,1);
-		PruneDuplicates(0,0,1);
-		PruneDuplicates(1,0,1);
+	const Uint32 index = m_entries.size();
+	m_entries.push_back(entry);
 
-	} else {
 	/* ...other factions, such as ones with no homeworlds, and more annoyingly ones
-	   whose homeworlds don't exist yet because they're custom systems have to go in
-	   *every* octbox cell
+	   whose homeworlds don't exist yet because they're custom systems, have to be
+	   checked everywhere
 	*/
-		octbox[0][0][0].push_back(faction);
-		octbox[1][0][0].push_back(faction);
-		octbox[1][1][0].push_back(faction);
-		octbox[1][1][1].push_back(faction);
-
-		octbox[0][1][0].push_back(faction);
-		octbox[0][1][1].push_back(faction);
-		octbox[0][0][1].push_back(faction);
-		octbox[1][0][1].push_back(faction);
+	if (entry.everywhere) {
+		m_everywhere.push_back(index);
+		return;
 	}
+
+	for (int cx = CellIndex(entry.min[0]); cx <= CellIndex(entry.max[0]); cx++)
+		for (int cy = CellIndex(entry.min[1]); cy <= CellIndex(entry.max[1]); cy++)
+			for (int cz = CellIndex(entry.min[2]); cz <= CellIndex(entry.max[2]); cz++)
+				m_cells[CellCoord(cx, cy, cz)].push_back(index);
 }
 
-void FactionOctsapling::PruneDuplicates(const int bx, const int by, const int bz)
+void FactionSpatialIndex::Clear()
 {
-	FactionList vec = octbox[bx][by][bz];
-	octbox[bx][by][bz].erase(std::unique( octbox[bx][by][bz].begin(), octbox[bx][by][bz].end() ), octbox[bx][by][bz].end() );
+	m_entries.clear();
+	m_everywhere.clear();
+	m_cells.clear();
 }
 
-std::vector<Faction*> FactionOctsapling::CandidateFactions(const Sector sec, Uint32 sysIndex)
+void FactionSpatialIndex::CandidateFactions(int sx, int sy, int sz, FactionList &out) const
 {
-	/* answer the factions that we've put in the same octobox cell as the one the
-	   system would go in. This part happens every time we do GetNearest faction
-	   so *is* performance criticale.e
+	/* This part happens for every sector generated, so *is* performance critical.
+	   The cell's factions and the everywhere ones are both in the order they were
+	   added, so merging them keeps that order
 	*/
-	Sector::System sys = sec.m_systems[sysIndex];
-	return octbox[BoxIndex(sys.sx)][BoxIndex(sys.sy)][BoxIndex(sys.sz)];
+	out.clear();
+
+	static const std::vector<Uint32> s_none;
+	std::map<CellCoord, std::vector<Uint32> >::const_iterator cell = m_cells.find(CellCoord(CellIndex(sx), CellIndex(sy), CellIndex(sz)));
+	const std::vector<Uint32> &local = cell != m_cells.end() ? cell->second : s_none;
+
+	std::vector<Uint32>::const_iterator a = local.begin(), b = m_everywhere.begin();
+	while (a != local.end() || b != m_everywhere.end()) {
+		const Uint32 index = (b == m_everywhere.end() || (a != local.end() && *a < *b)) ? *a++ : *b++;
+		const Entry &entry = m_entries[index];
+		if (!entry.everywhere && (
+			sx < entry.min[0] || sx > entry.max[0] ||
+			sy < entry.min[1] || sy > entry.max[1] ||
+			sz < entry.min[2] || sz > entry.max[2]))
+			continue;
+		out.push_back(entry.faction);
+	}
 }
@@ -22,7 +22,13 @@ public:
 	// XXX this is not as const-safe as it should be
 	static Faction *GetFaction       (const Uint32 index);
 	static Faction *GetFaction       (const std::string factionName);
-	static Faction *GetNearestFaction(const Sector sec, Uint32 sysIndex);
+	// the faction of systems that don't belong to any
+	static Faction *GetNoFaction     ();
+	static Faction *GetNearestFaction(const Sector &sec, Uint32 sysIndex);
+	// the same, choosing from candidates found with GetCandidateFactions for
+	// the sector. cheaper for many systems in one sector
+	static Faction *GetNearestFaction(const Sector &sec, Uint32 sysIndex, const std::vector<Faction*> &candidates);
+	static void     GetCandidateFactions(int sx, int sy, int sz, std::vector<Faction*> &out);
 	static bool     IsHomeSystem     (const SystemPath& sysPath);
 
 	static const Uint32 GetNumFactions();
@@ -77,24 +83,53 @@ private:
 	static const double FACTION_CURRENT_YEAR;	// used to calculate faction radius
 
 	Sector* m_homesector;						// cache of home sector to use in distance calculations
-	const bool IsCloserAndContains(double& closestFactionDist, const Sector sec, Uint32 sysIndex);
+	const bool IsCloserAndContains(double& closestFactionDist, const Sector &sec, Uint32 sysIndex);
 };
 
-/* One day it might grow up to become a full tree, on the  other hand it might be
-   cut down before it's full growth to be replaced by
-   a proper spatial data structure.
+/* Factions bucketed into a grid of cells CELL_SECTORS sectors a side, by the
+   box of sectors their home system and radius can reach. A sector then only
+   checks the factions in its own cell whose box takes it in, plus the ones
+   that could be anywhere: those without a home system, those whose home
+   system doesn't exist yet and those too big to be worth bucketing.
 */
-
-class FactionOctsapling {
+class FactionSpatialIndex {
 public:
-	void Add(Faction* faction);
-	std::vector<Faction*> CandidateFactions(const Sector sec, Uint32 sysIndex);
+	// homeSector may be null if the faction has no home system
+	void Add(Faction* faction, const Sector *homeSector);
+	void Clear();
+	// the factions that may own systems in the sector, in the order they were
+	// added, so the closest one wins ties the same way wherever it's asked
+	void CandidateFactions(int sx, int sy, int sz, std::vector<Faction*> &out) const;
 
 private:
-	std::vector<Faction*> octbox[2][2][2];
-	const int BoxIndex(Sint32 sectorIndex) { return sectorIndex < 0 ? 0: 1; };
-	void PruneDuplicates(const int bx, const int by, const int bz);
+	static const int CELL_SECTORS = 32;
+	// factions covering more cells than this across go everywhere instead
+	static const int MAX_CELLS_ACROSS = 8;
+
+	struct Entry {
+		Faction *faction;
+		bool everywhere;
+		Sint32 min[3], max[3]; // sectors
+	};
+
+	struct CellCoord {
+		CellCoord(int x_, int y_, int z_) : x(x_), y(y_), z(z_) {}
+		bool operator<(const CellCoord &o) const {
+			if (x != o.x) return x < o.x;
+			if (y != o.y) return y < o.y;
+			return z < o.z;
+		}
+		int x, y, z;
+	};
+
+	static int CellIndex(int sectorIndex) {
+		// rounds towards minus infinity, so cells don't double up around 0
+		return sectorIndex >= 0 ? sectorIndex / CELL_SECTORS : -((-sectorIndex - 1) / CELL_SECTORS) - 1;
+	}
+
+	std::vector<Entry> m_entries;
+	std::vector<Uint32> m_everywhere; // indexes into m_entries, ascending
+	std::map<CellCoord, std::vector<Uint32> > m_cells;
 };
 
-
 #endif /* _FACTIONS_H */
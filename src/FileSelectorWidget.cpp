@@ -6,6 +6,7 @@
 #include "utils.h"
 #include "Pi.h"
 #include "FileSystem.h"
+#include "StringF.h"
 
 class SimpleLabelButton: public Gui::LabelButton
 {
@@ -18,13 +19,44 @@ public:
 	}
 };
 
-FileSelectorWidget::FileSelectorWidget(Type type, const std::string &title) : Gui::VBox(), m_type(type), m_title(title)
+// reads the header of each save off the main thread, so a long list of saves
+// comes up straight away and the details follow
+class SaveInfoJob : public Job {
+public:
+	SaveInfoJob(FileSelectorWidget *widget, const std::vector<std::string> &files) :
+		m_widget(widget), m_files(files), m_infos(files.size()), m_found(files.size(), false) {}
+	virtual const char *GetName() const { return "SaveInfoJob"; }
+
+	virtual void OnRun() {
+		for (size_t i = 0; i < m_files.size() && !IsCancelled(); i++)
+			m_found[i] = Game::ReadSaveInfo(m_files[i], m_infos[i]);
+	}
+
+	virtual void OnFinish() {
+		for (size_t i = 0; i < m_files.size(); i++)
+			if (m_found[i]) m_widget->OnSaveInfo(m_files[i], m_infos[i]);
+	}
+
+private:
+	FileSelectorWidget *m_widget;
+	std::vector<std::string> m_files;
+	std::vector<Game::SaveInfo> m_infos;
+	std::vector<bool> m_found;
+};
+
+FileSelectorWidget::FileSelectorWidget(Type type, const std::string &title) : Gui::VBox(), m_type(type), m_title(title), m_jobGroup(Pi::Jobs()->NewGroup())
 {
 	SetTransparency(false);
 	SetSpacing(5.0f);
 	SetSizeRequest(FLT_MAX, FLT_MAX);
 }
 
+FileSelectorWidget::~FileSelectorWidget()
+{
+	// the job would be finishing into a widget that's gone
+	Pi::Jobs()->CancelGroup(m_jobGroup);
+}
+
 void FileSelectorWidget::ShowAll()
 {
 	DeleteAllChildren();
@@ -52,6 +84,10 @@ void FileSelectorWidget::ShowAll()
 	hbox->PackEnd(portal);
 	hbox->PackEnd(scroll);
 
+	Pi::Jobs()->CancelGroup(m_jobGroup);
+	m_infoLabels.clear();
+
+	std::vector<std::string> names;
 	Gui::Box *vbox = new Gui::VBox();
 	for (FileSystem::FileEnumerator files(FileSystem::userFiles, Pi::SAVE_DIR_NAME); !files.Finished(); files.Next())
 	{
@@ -59,12 +95,35 @@ void FileSelectorWidget::ShowAll()
 		b = new SimpleLabelButton(new Gui::Label(name));
 		b->onClick.connect(sigc::bind(sigc::mem_fun(this, &FileSelectorWidget::OnClickFile), name));
 		vbox->PackEnd(b);
+
+		if (m_type == LOAD) {
+			Gui::Label *info = new Gui::Label("");
+			info->Color(0.6f, 0.6f, 0.6f);
+			vbox->PackEnd(info);
+			m_infoLabels[name] = info;
+			names.push_back(name);
+		}
 	}
 	portal->Add(vbox);
 
+	if (!names.empty()) {
+		SaveInfoJob *job = new SaveInfoJob(this, names);
+		job->SetGroup(m_jobGroup);
+		Pi::Jobs()->Queue(job);
+	}
+
 	Gui::VBox::ShowAll();
 }
 
+void FileSelectorWidget::OnSaveInfo(const std::string &file, const Game::SaveInfo &info)
+{
+	std::map<std::string,Gui::Label*>::iterator i = m_infoLabels.find(file);
+	if (i == m_infoLabels.end()) return;
+
+	i->second->SetText(stringf("%0, %1\n%2 %3, %4",
+		info.system, format_date(info.time), info.shipType, info.shipLabel, format_money(info.money)));
+}
+
 void FileSelectorWidget::OnClickAction()
 {
 	onClickAction.emit(m_tentry->GetText());
@@ -121,8 +180,11 @@ bool FileSelectorDialog::run()
 
 	m_done = false;
 	m_filename.clear();
-	while (!m_done)
+	while (!m_done) {
 		Gui::MainLoopIteration();
+		// the save details come in through here
+		Pi::Jobs()->FinishJobs(Pi::config->Int("JobFinishBudget"));
+	}
 
 	Gui::Screen::RemoveBaseWidget(background);
 	delete background;
@@ -5,14 +5,20 @@
 #define _FILESELECTORWIDGET_H
 
 #include "gui/Gui.h"
+#include "Game.h"
+#include <map>
 
 class FileSelectorWidget: public Gui::VBox {
 public:
 	enum Type { LOAD, SAVE };
 
 	FileSelectorWidget(Type type, const std::string &title);
+	virtual ~FileSelectorWidget();
 	void ShowAll();
 
+	// from the job reading the save headers
+	void OnSaveInfo(const std::string &file, const Game::SaveInfo &info);
+
 	sigc::signal<void,std::string> onClickAction;
 	sigc::signal<void> onClickCancel;
 
@@ -24,6 +30,10 @@ private:
 	Type m_type;
 	std::string m_title;
 	Gui::TextEntry *m_tentry;
+
+	// the details under each save's name, filled in as the headers are read
+	std::map<std::string,Gui::Label*> m_infoLabels;
+	Uint32 m_jobGroup;
 };
 
 class FileSelectorDialog {
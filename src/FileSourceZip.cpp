@@ -14,13 +14,24 @@ extern "C" {
 
 namespace FileSystem {
 
+// a stored file, pointing straight into the archive
+class FileDataZipStored : public FileData {
+public:
+	FileDataZipStored(const FileInfo &info, size_t size, RefCountedPtr<FileData> archive, Uint64 offset) :
+		FileData(info, size, const_cast<char*>(archive->GetData()) + offset), m_archive(archive) {}
+
+private:
+	RefCountedPtr<FileData> m_archive;
+};
+
 FileSourceZip::FileSourceZip(FileSourceFS &fs, const std::string &zipPath) : FileSource(zipPath), m_archive(0)
 {
 	mz_zip_archive *zip = reinterpret_cast<mz_zip_archive*>(std::calloc(1, sizeof(mz_zip_archive)));
-	FILE *file = fs.OpenReadStream(zipPath);
-	if (!mz_zip_reader_init_file_stream(zip, file, 0)) {
+	m_archiveData = fs.ReadFile(zipPath);
+	if (!m_archiveData || !mz_zip_reader_init_mem(zip, m_archiveData->GetData(), m_archiveData->GetSize(), 0)) {
 		printf("FileSourceZip: unable to open '%s'\n", zipPath.c_str());
 		std::free(zip);
+		m_archiveData.Reset();
 		return;
 	}
 
@@ -35,8 +46,10 @@ FileSourceZip::FileSourceZip(FileSourceFS &fs, const std::string &zipPath) : Fil
 				if ((fname.size() > 1) && (fname[fname.size()-1] == '/')) {
 					fname.resize(fname.size() - 1);
 				}
+				const Uint64 storedOffset = (!is_dir && zipStat.m_method == 0) ?
+					FindStoredData(zipStat.m_local_header_ofs, zipStat.m_uncomp_size) : 0;
 				AddFile(zipStat.m_filename, FileStat(i, zipStat.m_uncomp_size,
-					MakeFileInfo(fname, is_dir ? FileInfo::FT_DIR : FileInfo::FT_FILE)));
+					MakeFileInfo(fname, is_dir ? FileInfo::FT_DIR : FileInfo::FT_FILE), storedOffset));
 			}
 		}
 	}
@@ -49,6 +62,30 @@ FileSourceZip::~FileSourceZip()
 	if (!m_archive) return;
 	mz_zip_archive *zip = reinterpret_cast<mz_zip_archive*>(m_archive);
 	mz_zip_reader_end(zip);
+	std::free(zip);
+}
+
+Uint64 FileSourceZip::FindStoredData(const Uint64 localHeaderOfs, const Uint64 size) const
+{
+	// local file header: 30 bytes, with the name and extra field lengths at
+	// 26 and 28, then the name and extra field, then the data
+	static const Uint64 LOCAL_HEADER_SIZE = 30;
+
+	const Uint64 archiveSize = m_archiveData->GetSize();
+	if (localHeaderOfs + LOCAL_HEADER_SIZE > archiveSize)
+		return 0;
+
+	const unsigned char *header = reinterpret_cast<const unsigned char*>(m_archiveData->GetData()) + localHeaderOfs;
+	if (header[0] != 'P' || header[1] != 'K' || header[2] != 3 || header[3] != 4)
+		return 0;
+
+	const Uint64 nameLen = header[26] | (header[27] << 8);
+	const Uint64 extraLen = header[28] | (header[29] << 8);
+	const Uint64 offset = localHeaderOfs + LOCAL_HEADER_SIZE + nameLen + extraLen;
+	if (offset + size > archiveSize)
+		return 0;
+
+	return offset;
 }
 
 static void SplitPath(const std::string &path, std::vector<std::string> &output)
@@ -77,10 +114,14 @@ bool FileSourceZip::FindDirectoryAndFile(const std::string &path, const Director
 	std::vector<std::string> fragments;
 	SplitPath(NormalisePath(path), fragments);
 
-	assert(fragments.size() > 0);
-
 	dir = &m_root;
 
+	// the root itself
+	if (fragments.empty()) {
+		filename.clear();
+		return true;
+	}
+
 	if (fragments.size() > 1) {
 		for (unsigned int i = 0; i < fragments.size()-1; i++) {
 			std::map<std::string,Directory>::const_iterator it = dir->subdirs.find(fragments[i]);
@@ -101,6 +142,9 @@ FileInfo FileSourceZip::Lookup(const std::string &path)
 	if (!FindDirectoryAndFile(path, dir, filename))
 		return MakeFileInfo(path, FileInfo::FT_NON_EXISTENT);
 
+	if (filename.empty())
+		return MakeFileInfo("", FileInfo::FT_DIR);
+
 	std::map<std::string,FileStat>::const_iterator i = dir->files.find(filename);
 	if (i == dir->files.end())
 		return MakeFileInfo(path, FileInfo::FT_NON_EXISTENT);
@@ -123,10 +167,18 @@ RefCountedPtr<FileData> FileSourceZip::ReadFile(const std::string &path)
 		return RefCountedPtr<FileData>();
 
 	const FileStat &st = (*i).second;
+	if (!st.info.IsFile())
+		return RefCountedPtr<FileData>();
+
+	if (st.storedOffset)
+		return RefCountedPtr<FileData>(new FileDataZipStored(st.info, st.size, m_archiveData, st.storedOffset));
 
+	// extracting from memory touches nothing in the archive state, so this
+	// is safe to do on more than one thread
 	char *data = reinterpret_cast<char*>(std::malloc(st.size));
 	if (!mz_zip_reader_extract_to_mem(zip, st.index, data, st.size, 0)) {
 		printf("FileSourceZip::ReadFile: couldn't extract '%s'\n", path.c_str());
+		std::free(data);
 		return RefCountedPtr<FileData>();
 	}
 
@@ -140,7 +192,7 @@ bool FileSourceZip::ReadDirectory(const std::string &path, std::vector<FileInfo>
 	if (!FindDirectoryAndFile(path, dir, filename))
 		return false;
 
-	{
+	if (!filename.empty()) {
 		std::map<std::string,Directory>::const_iterator i = dir->subdirs.find(filename);
 		if (i == dir->subdirs.end())
 			return false;
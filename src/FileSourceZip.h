@@ -13,8 +13,10 @@ namespace FileSystem {
 
 class FileSourceZip : public FileSource {
 public:
-	// for now this needs to be FileSourceFS rather than just FileSource,
-	// because we need a FILE* stream access to the .zip file
+	// the whole archive is read in (or mapped, if it's big enough; see
+	// FileSourceFS::MAP_MIN_SIZE) and extracted from memory, so ReadFile
+	// can be called from several threads at once. stored (uncompressed)
+	// files are handed out without copying
 	FileSourceZip(FileSourceFS &fs, const std::string &zipPath);
 	virtual ~FileSourceZip();
 
@@ -24,12 +26,17 @@ public:
 
 private:
 	void *m_archive;
+	RefCountedPtr<FileData> m_archiveData;
 
 	struct FileStat {
-		FileStat(Uint32 _index, Uint64 _size, FileInfo _info) : index(_index), size(_size), info(_info) {}
+		FileStat(Uint32 _index, Uint64 _size, FileInfo _info, Uint64 _storedOffset = 0) :
+			index(_index), size(_size), info(_info), storedOffset(_storedOffset) {}
 		const Uint32 index;
 		const Uint64 size;
 		const FileInfo info;
+		// where the contents of a stored file start in the archive, or 0
+		// if it has to be extracted
+		const Uint64 storedOffset;
 	};
 
 	struct Directory {
@@ -39,6 +46,7 @@ private:
 
 	Directory m_root;
 
+	Uint64 FindStoredData(const Uint64 localHeaderOfs, const Uint64 size) const;
 	bool FindDirectoryAndFile(const std::string &path, const Directory* &dir, std::string &filename);
 	void AddFile(const std::string &path, const FileStat &fileStat);
 };
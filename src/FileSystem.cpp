@@ -131,11 +131,12 @@ namespace FileSystem {
 	{
 	}
 
-	FileInfo::FileInfo(FileSource *source, const std::string &path, FileType type):
+	FileInfo::FileInfo(FileSource *source, const std::string &path, FileType type, Sint64 modTime):
 		m_source(source),
 		m_path(path),
 		m_dirLen(0),
-		m_type(type)
+		m_type(type),
+		m_modTime(modTime)
 	{
 		assert((m_path.size() <= 1) || (m_path[m_path.size()-1] != '/'));
 		std::size_t slashpos = m_path.rfind('/');
@@ -146,12 +147,12 @@ namespace FileSystem {
 		}
 	}
 
-	FileInfo FileSource::MakeFileInfo(const std::string &path, FileInfo::FileType fileType)
+	FileInfo FileSource::MakeFileInfo(const std::string &path, FileInfo::FileType fileType, Sint64 modTime)
 	{
-		return FileInfo(this, path, fileType);
+		return FileInfo(this, path, fileType, modTime);
 	}
 
-	FileSourceUnion::FileSourceUnion(): FileSource(":union:") {}
+	FileSourceUnion::FileSourceUnion(): FileSource(":union:"), m_indexed(false) {}
 	FileSourceUnion::~FileSourceUnion() {}
 
 	void FileSourceUnion::PrependSource(FileSource *fs)
@@ -159,6 +160,7 @@ namespace FileSystem {
 		assert(fs);
 		RemoveSource(fs);
 		m_sources.insert(m_sources.begin(), fs);
+		m_indexed = false;
 	}
 
 	void FileSourceUnion::AppendSource(FileSource *fs)
@@ -166,16 +168,55 @@ namespace FileSystem {
 		assert(fs);
 		RemoveSource(fs);
 		m_sources.push_back(fs);
+		m_indexed = false;
 	}
 
 	void FileSourceUnion::RemoveSource(FileSource *fs)
 	{
 		std::vector<FileSource*>::iterator nend = std::remove(m_sources.begin(), m_sources.end(), fs);
 		m_sources.erase(nend, m_sources.end());
+		m_indexed = false;
+		m_index.clear();
+	}
+
+	void FileSourceUnion::BuildIndex()
+	{
+		m_index.clear();
+		// earlier sources win, as they do when searching
+		for (std::vector<FileSource*>::const_iterator
+			it = m_sources.begin(); it != m_sources.end(); ++it)
+		{
+			for (FileEnumerator files(**it, "", FileEnumerator::IncludeDirs | FileEnumerator::Recurse); !files.Finished(); files.Next())
+				m_index.insert(std::make_pair(files.Current().GetPath(), *it));
+		}
+		m_indexed = true;
+	}
+
+	FileSource *FileSourceUnion::FindIndexed(const std::string &path, bool &found) const
+	{
+		found = false;
+		if (!m_indexed || path.empty()) return 0;
+		std::string normalised;
+		try {
+			normalised = NormalisePath(path);
+		} catch (std::invalid_argument &) {
+			return 0;
+		}
+		found = true;
+		std::map<std::string, FileSource*>::const_iterator it = m_index.find(normalised);
+		return (it != m_index.end()) ? it->second : 0;
 	}
 
 	FileInfo FileSourceUnion::Lookup(const std::string &path)
 	{
+		bool indexed;
+		if (FileSource *source = FindIndexed(path, indexed)) {
+			FileInfo info = source->Lookup(path);
+			// gone since indexing, look for it elsewhere
+			if (info.Exists()) { return info; }
+		} else if (indexed)
+			return MakeFileInfo(path, FileInfo::FT_NON_EXISTENT);
+
 		for (std::vector<FileSource*>::const_iterator
 			it = m_sources.begin(); it != m_sources.end(); ++it)
 		{
@@ -187,6 +228,13 @@ namespace FileSystem {
 
 	RefCountedPtr<FileData> FileSourceUnion::ReadFile(const std::string &path)
 	{
+		bool indexed;
+		if (FileSource *source = FindIndexed(path, indexed)) {
+			RefCountedPtr<FileData> data = source->ReadFile(path);
+			if (data) { return data; }
+		} else if (indexed)
+			return RefCountedPtr<FileData>();
+
 		for (std::vector<FileSource*>::const_iterator
 			it = m_sources.begin(); it != m_sources.end(); ++it)
 		{
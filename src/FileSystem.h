@@ -7,9 +7,11 @@
 #include "RefCounted.h"
 #include "StringRange.h"
 #include "ByteRange.h"
+#include <SDL_stdinc.h>
 #include <string>
 #include <vector>
 #include <deque>
+#include <map>
 #include <memory>
 
 /*
@@ -63,7 +65,7 @@ namespace FileSystem {
 	class FileInfo {
 		friend class FileSource;
 	public:
-		FileInfo(): m_source(0), m_dirLen(0), m_type(FT_NON_EXISTENT) {}
+		FileInfo(): m_source(0), m_dirLen(0), m_type(FT_NON_EXISTENT), m_modTime(0) {}
 
 		enum FileType {
 			// note: order here affects sort-order of FileInfo
@@ -87,6 +89,10 @@ namespace FileSystem {
 
 		const FileSource &GetSource() const { return *m_source; }
 
+		// last modification, in seconds since the epoch. 0 if the source
+		// doesn't know. only filled in by Lookup
+		Sint64 GetModificationTime() const { return m_modTime; }
+
 		RefCountedPtr<FileData> Read() const;
 
 		friend bool operator==(const FileInfo &a, const FileInfo &b)
@@ -112,12 +118,13 @@ namespace FileSystem {
 
 	private:
 		// use FileSource::MakeFileInfo to create your FileInfos
-		FileInfo(FileSource *source, const std::string &path, FileType type);
+		FileInfo(FileSource *source, const std::string &path, FileType type, Sint64 modTime);
 
 		FileSource *m_source;
 		std::string m_path;
 		int m_dirLen;
 		FileType m_type;
+		Sint64 m_modTime;
 	};
 
 	class FileData : public RefCounted {
@@ -163,7 +170,7 @@ namespace FileSystem {
 		bool IsTrusted() const { return m_trusted; }
 
 	protected:
-		FileInfo MakeFileInfo(const std::string &path, FileInfo::FileType entryType);
+		FileInfo MakeFileInfo(const std::string &path, FileInfo::FileType entryType, Sint64 modTime = 0);
 
 	private:
 		std::string m_root;
@@ -175,6 +182,11 @@ namespace FileSystem {
 		explicit FileSourceFS(const std::string &root, bool trusted = false);
 		~FileSourceFS();
 
+		// files this size or larger are mapped into memory rather than read
+		// in, so the pages only get loaded as they are used (and can be
+		// dropped again by the OS). don't change them while they're in use
+		static const size_t MAP_MIN_SIZE = 1024 * 1024;
+
 		virtual FileInfo Lookup(const std::string &path);
 		virtual RefCountedPtr<FileData> ReadFile(const std::string &path);
 		virtual bool ReadDirectory(const std::string &path, std::vector<FileInfo> &output);
@@ -203,12 +215,24 @@ namespace FileSystem {
 		void AppendSource(FileSource *fs);
 		void RemoveSource(FileSource *fs);
 
+		// note which source each path comes from, so Lookup and ReadFile
+		// go straight to it instead of trying every source in turn. paths
+		// that are not in the index are not found at all, so build it
+		// again after adding files. changing the sources drops it
+		void BuildIndex();
+
 		virtual FileInfo Lookup(const std::string &path);
 		virtual RefCountedPtr<FileData> ReadFile(const std::string &path);
 		virtual bool ReadDirectory(const std::string &path, std::vector<FileInfo> &output);
 
 	private:
+		// the source to use for path, or 0 if there is none. unindexed
+		// paths give found = false
+		FileSource *FindIndexed(const std::string &path, bool &found) const;
+
 		std::vector<FileSource*> m_sources;
+		std::map<std::string, FileSource*> m_index;
+		bool m_indexed;
 	};
 
 	class FileEnumerator {
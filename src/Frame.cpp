@@ -9,6 +9,8 @@
 #include "galaxy/StarSystem.h"
 #include "Pi.h"
 #include "Game.h"
+#include "Orbit.h"
+#include "MemoryStats.h"
 #include <algorithm>
 
 Frame::Frame()
@@ -92,7 +94,8 @@ void Frame::Init(Frame *parent, const char *label, unsigned int flags)
 
 Frame::~Frame()
 {
-	if (m_sfx) delete [] m_sfx;
+	if (m_sfx) MemoryStats::Remove(MemoryStats::SFX, m_sfx->capacity() * sizeof(Sfx));
+	delete m_sfx;
 	delete m_collisionSpace;
 	for (ChildIterator it = m_children.begin(); it != m_children.end(); ++it)
 		delete (*it);
@@ -150,15 +153,20 @@ vector3d Frame::GetInterpPositionRelTo(const Frame *relTo) const
 	else return diff;
 }
 
+// non-rotating frames only ever hang off other non-rotating frames, so their
+// root orient is always identity. the position functions above rely on that
+// too
 matrix3x3d Frame::GetOrientRelTo(const Frame *relTo) const
 {
 	if (this == relTo) return matrix3x3d::Identity();
+	if (!relTo->IsRotFrame()) return m_rootOrient;
 	return relTo->m_rootOrient.Transpose() * m_rootOrient;
 }
 
 matrix3x3d Frame::GetInterpOrientRelTo(const Frame *relTo) const
 {
 	if (this == relTo) return matrix3x3d::Identity();
+	if (!relTo->IsRotFrame()) return m_rootInterpOrient;
 	return relTo->m_rootInterpOrient.Transpose() * m_rootInterpOrient;
 /*	if (IsRotFrame()) {
 		if (relTo->IsRotFrame()) return m_interpOrient * relTo->m_interpOrient.Transpose();
@@ -169,6 +177,22 @@ matrix3x3d Frame::GetInterpOrientRelTo(const Frame *relTo) const
 */
 }
 
+vector3d Frame::RotateRelTo(const vector3d &v, const Frame *relTo) const
+{
+	if (this == relTo) return v;
+	const vector3d rootv = m_rootOrient * v;
+	if (relTo->IsRotFrame()) return rootv * relTo->m_rootOrient;
+	else return rootv;
+}
+
+vector3d Frame::InterpRotateRelTo(const vector3d &v, const Frame *relTo) const
+{
+	if (this == relTo) return v;
+	const vector3d rootv = m_rootInterpOrient * v;
+	if (relTo->IsRotFrame()) return rootv * relTo->m_rootInterpOrient;
+	else return rootv;
+}
+
 void Frame::UpdateInterpTransform(double alpha)
 {
 	m_interpPos = alpha*m_pos + (1.0-alpha)*m_oldPos;
@@ -215,15 +239,41 @@ void Frame::ClearMovement()
 	m_oldAngDisplacement = 0.0;
 }
 
+// only ever used from the main thread. kept around so its arrays don't have
+// to be reallocated every tick
+static OrbitBatch s_orbitBatch;
+
 void Frame::UpdateOrbitRails(double time, double timestep)
+{
+	s_orbitBatch.Clear();
+	AddOrbitsToBatch(s_orbitBatch, time, timestep);
+	s_orbitBatch.Solve();
+
+	size_t next = 0;
+	UpdateOrbitRails(timestep, s_orbitBatch, next);
+	assert(next == s_orbitBatch.GetSize());
+}
+
+void Frame::AddOrbitsToBatch(OrbitBatch &batch, double time, double timestep) const
+{
+	if (m_parent && m_sbody && !IsRotFrame()) {
+		batch.Add(m_sbody->orbit, time);
+		batch.Add(m_sbody->orbit, time+timestep);
+	}
+
+	for (ChildIterator it = m_children.begin(); it != m_children.end(); ++it)
+		(*it)->AddOrbitsToBatch(batch, time, timestep);
+}
+
+void Frame::UpdateOrbitRails(double timestep, const OrbitBatch &batch, size_t &next)
 {
 	m_oldPos = m_pos;
 	m_oldAngDisplacement = m_angSpeed * timestep;
 
 	// update frame position and velocity
 	if (m_parent && m_sbody && !IsRotFrame()) {
-		m_pos = m_sbody->orbit.OrbitalPosAtTime(time);
-		vector3d pos2 = m_sbody->orbit.OrbitalPosAtTime(time+timestep);
+		m_pos = batch.GetPosition(next++);
+		const vector3d &pos2 = batch.GetPosition(next++);
 		m_vel = (pos2 - m_pos) / timestep;
 	}
 	// temporary test thing
@@ -238,7 +288,7 @@ void Frame::UpdateOrbitRails(double time, double timestep)
 	UpdateRootRelativeVars();			// update root-relative pos/vel/orient
 
 	for (ChildIterator it = m_children.begin(); it != m_children.end(); ++it)
-		(*it)->UpdateOrbitRails(time, timestep);
+		(*it)->UpdateOrbitRails(timestep, batch, next);
 }
 
 void Frame::UpdateRootRelativeVars()
@@ -12,6 +12,7 @@
 class Body;
 class CollisionSpace;
 class Geom;
+class OrbitBatch;
 class SystemBody;
 class Sfx;
 class Space;
@@ -87,15 +88,24 @@ public:
 	vector3d GetInterpPositionRelTo(const Frame *relTo) const;
 	matrix3x3d GetInterpOrientRelTo(const Frame *relTo) const;
 
+	// GetOrientRelTo(relTo) * v, without building the matrix
+	vector3d RotateRelTo(const vector3d &v, const Frame *relTo) const;
+	vector3d InterpRotateRelTo(const vector3d &v, const Frame *relTo) const;
+
 	static void GetFrameTransform(const Frame *fFrom, const Frame *fTo, matrix4x4d &m);
 	static void GetFrameRenderTransform(const Frame *fFrom, const Frame *fTo, matrix4x4d &m);
 
-	Sfx *m_sfx;			// the last survivor. actually m_children is pretty grim too.
+	std::vector<Sfx> *m_sfx;	// only the live ones. the last survivor. actually m_children is pretty grim too.
 
 private:
 	void Init(Frame *parent, const char *label, unsigned int flags);
 	void UpdateRootRelativeVars();
 
+	// UpdateOrbitRails solves every orbit in the tree in one batch, then
+	// walks the tree in the same order handing out the positions
+	void AddOrbitsToBatch(OrbitBatch &batch, double time, double timestep) const;
+	void UpdateOrbitRails(double timestep, const OrbitBatch &batch, size_t &next);
+
 	Frame *m_parent;				// if parent is null then frame position is absolute
 	std::vector<Frame*> m_children;	// child frames, first may be rotating
 	SystemBody *m_sbody; 			// points to SBodies in Pi::current_system
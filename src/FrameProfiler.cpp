@@ -0,0 +1,257 @@
+// Copyright © 2008-2013 Pioneer Developers. See AUTHORS.txt for details
+// Licensed under the terms of the GPL v3. See licenses/GPL-3.txt
+
+#include "FrameProfiler.h"
+#include "OS.h"
+#include "StringF.h"
+#include <vector>
+
+namespace FrameProfiler {
+
+// frames between issuing queries and reading them back
+static const int FRAMES_IN_FLIGHT = 4;
+
+static const char *s_passNames[PASS_COUNT] = {
+	"background",
+	"terrain",
+	"models",
+	"sfx",
+	"ui",
+	"gui"
+};
+
+// a stretch of one pass with nothing nested in it
+struct Segment {
+	GLuint query;
+	Pass pass;
+};
+
+// everything recorded for one frame still waiting for its queries
+struct FrameRecord {
+	FrameRecord() : used(0), frame(0) {}
+	std::vector<Segment> segments; // queries are kept for reuse
+	unsigned int used;
+	Uint64 frame;
+	double cpu[PASS_COUNT]; // milliseconds
+};
+
+static bool s_running = false;
+static bool s_gpuTiming = false;
+static bool s_arbTimerQuery = false;
+static FILE *s_csv = 0;
+
+static std::vector<Pass> s_stack;
+static Uint64 s_segmentStart = 0; // HFTimer
+
+static FrameRecord s_frames[FRAMES_IN_FLIGHT];
+static int s_current = 0;
+static Uint64 s_frameCount = 0;
+
+// for Report
+static double s_cpuSum[PASS_COUNT];
+static double s_gpuSum[PASS_COUNT];
+static unsigned int s_cpuFrames = 0;
+static unsigned int s_gpuFrames = 0;
+
+const char *GetPassName(Pass pass)
+{
+	assert(pass >= 0 && pass < PASS_COUNT);
+	return s_passNames[pass];
+}
+
+static void clear_sums()
+{
+	for (int i = 0; i < PASS_COUNT; i++)
+		s_cpuSum[i] = s_gpuSum[i] = 0.0;
+	s_cpuFrames = s_gpuFrames = 0;
+}
+
+static void clear_record(FrameRecord &r)
+{
+	r.used = 0;
+	r.frame = s_frameCount;
+	for (int i = 0; i < PASS_COUNT; i++)
+		r.cpu[i] = 0.0;
+}
+
+void Start(FILE *csv)
+{
+	if (s_running) Stop();
+
+	s_arbTimerQuery = glewIsSupported("GL_ARB_timer_query");
+	s_gpuTiming = s_arbTimerQuery || glewIsSupported("GL_EXT_timer_query");
+
+	s_csv = csv;
+	if (s_csv) {
+		fputs("frame", s_csv);
+		for (int i = 0; i < PASS_COUNT; i++)
+			fprintf(s_csv, ",%s_cpu,%s_gpu", s_passNames[i], s_passNames[i]);
+		fputs("\n", s_csv);
+	}
+
+	s_stack.clear();
+	s_current = 0;
+	s_frameCount = 0;
+	for (int i = 0; i < FRAMES_IN_FLIGHT; i++)
+		clear_record(s_frames[i]);
+	clear_sums();
+
+	s_running = true;
+}
+
+void Stop()
+{
+	if (!s_running) return;
+
+	// an open query would make the next one fail
+	if (!s_stack.empty() && s_gpuTiming)
+		glEndQuery(GL_TIME_ELAPSED_EXT);
+	s_stack.clear();
+
+	for (int i = 0; i < FRAMES_IN_FLIGHT; i++) {
+		FrameRecord &r = s_frames[i];
+		for (std::vector<Segment>::iterator it = r.segments.begin(); it != r.segments.end(); ++it)
+			glDeleteQueries(1, &it->query);
+		r.segments.clear();
+		r.used = 0;
+	}
+
+	if (s_csv) {
+		fclose(s_csv);
+		s_csv = 0;
+	}
+
+	s_running = false;
+}
+
+bool IsRunning()
+{
+	return s_running;
+}
+
+static void begin_segment(Pass pass)
+{
+	s_segmentStart = OS::HFTimer();
+	if (!s_gpuTiming) return;
+
+	FrameRecord &r = s_frames[s_current];
+	if (r.used == r.segments.size()) {
+		Segment s;
+		glGenQueries(1, &s.query);
+		r.segments.push_back(s);
+	}
+	Segment &s = r.segments[r.used++];
+	s.pass = pass;
+	glBeginQuery(GL_TIME_ELAPSED_EXT, s.query);
+}
+
+static void end_segment(Pass pass)
+{
+	const Uint64 now = OS::HFTimer();
+	s_frames[s_current].cpu[pass] += double(now - s_segmentStart) * 1000.0 / double(OS::HFTimerFreq());
+	if (s_gpuTiming)
+		glEndQuery(GL_TIME_ELAPSED_EXT);
+}
+
+void Enter(Pass pass)
+{
+	assert(s_running);
+	if (!s_stack.empty())
+		end_segment(s_stack.back());
+	s_stack.push_back(pass);
+	begin_segment(pass);
+}
+
+void Leave()
+{
+	assert(s_running);
+	assert(!s_stack.empty());
+	end_segment(s_stack.back());
+	s_stack.pop_back();
+	if (!s_stack.empty())
+		begin_segment(s_stack.back());
+}
+
+static Uint64 query_result(GLuint query)
+{
+	if (s_arbTimerQuery) {
+		GLuint64 ns = 0;
+		glGetQueryObjectui64v(query, GL_QUERY_RESULT, &ns);
+		return ns;
+	}
+	GLuint64EXT ns = 0;
+	glGetQueryObjectui64vEXT(query, GL_QUERY_RESULT, &ns);
+	return ns;
+}
+
+// fold a frame old enough for its queries to be done into the sums, and
+// write it out
+static void collect(FrameRecord &r)
+{
+	double gpu[PASS_COUNT];
+	for (int i = 0; i < PASS_COUNT; i++)
+		gpu[i] = 0.0;
+
+	bool haveGpu = s_gpuTiming;
+	for (unsigned int i = 0; i < r.used && haveGpu; i++) {
+		GLint available = 0;
+		glGetQueryObjectiv(r.segments[i].query, GL_QUERY_RESULT_AVAILABLE, &available);
+		if (!available)
+			haveGpu = false;
+		else
+			gpu[r.segments[i].pass] += double(query_result(r.segments[i].query)) * 1e-6;
+	}
+
+	for (int i = 0; i < PASS_COUNT; i++)
+		s_cpuSum[i] += r.cpu[i];
+	s_cpuFrames++;
+	if (haveGpu) {
+		for (int i = 0; i < PASS_COUNT; i++)
+			s_gpuSum[i] += gpu[i];
+		s_gpuFrames++;
+	}
+
+	if (s_csv) {
+		fprintf(s_csv, "%llu", static_cast<unsigned long long>(r.frame));
+		for (int i = 0; i < PASS_COUNT; i++) {
+			if (haveGpu)
+				fprintf(s_csv, ",%.3f,%.3f", r.cpu[i], gpu[i]);
+			else
+				fprintf(s_csv, ",%.3f,", r.cpu[i]);
+		}
+		fputs("\n", s_csv);
+	}
+}
+
+void EndFrame()
+{
+	if (!s_running) return;
+	assert(s_stack.empty());
+
+	s_frameCount++;
+	s_current = (s_current + 1) % FRAMES_IN_FLIGHT;
+
+	// the record about to be reused is the oldest one
+	FrameRecord &r = s_frames[s_current];
+	if (s_frameCount >= FRAMES_IN_FLIGHT)
+		collect(r);
+	clear_record(r);
+}
+
+std::string Report()
+{
+	std::string out;
+	for (int i = 0; i < PASS_COUNT; i++) {
+		const double cpu = s_cpuFrames ? s_cpuSum[i] / s_cpuFrames : 0.0;
+		if (!out.empty()) out += ", ";
+		if (s_gpuFrames)
+			out += stringf("%0 %1{f.2}/%2{f.2}", s_passNames[i], cpu, s_gpuSum[i] / s_gpuFrames);
+		else
+			out += stringf("%0 %1{f.2}", s_passNames[i], cpu);
+	}
+	out += s_gpuFrames ? " (ms cpu/gpu)" : " (ms cpu)";
+	clear_sums();
+	return out;
+}
+
+}
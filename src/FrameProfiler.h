@@ -0,0 +1,60 @@
+// Copyright © 2008-2013 Pioneer Developers. See AUTHORS.txt for details
+// Licensed under the terms of the GPL v3. See licenses/GPL-3.txt
+
+#ifndef _FRAMEPROFILER_H
+#define _FRAMEPROFILER_H
+
+#include "libs.h"
+
+// times the passes that make up a frame, on the CPU with the high frequency
+// timer and on the GPU with GL_TIME_ELAPSED queries (where the driver has
+// ARB_timer_query or EXT_timer_query). passes can nest: time is always
+// charged to the innermost one, so the numbers add up to the frame.
+//
+// query results are read back several frames late so reading them never
+// stalls the pipeline. frames whose queries still aren't done by then are
+// left out of the GPU numbers.
+//
+// nothing is done while the profiler is stopped, apart from ScopedPass
+// checking that it is
+namespace FrameProfiler {
+
+	enum Pass {
+		PASS_BACKGROUND,
+		PASS_TERRAIN,
+		PASS_MODELS,
+		PASS_SFX,
+		PASS_UI,
+		PASS_GUI,
+		PASS_COUNT
+	};
+
+	const char *GetPassName(Pass pass);
+
+	// per frame times go to the csv file if one is given, and it is closed
+	// on Stop
+	void Start(FILE *csv = 0);
+	void Stop();
+	bool IsRunning();
+
+	// bracket a pass. Leave ends the one entered last
+	void Enter(Pass pass);
+	void Leave();
+
+	// call once per frame, after the buffers are swapped
+	void EndFrame();
+
+	// milliseconds per frame for each pass, cpu/gpu, averaged over the frames
+	// since the last report
+	std::string Report();
+
+	class ScopedPass {
+	public:
+		ScopedPass(Pass pass) : m_running(IsRunning()) { if (m_running) Enter(pass); }
+		~ScopedPass() { if (m_running) Leave(); }
+	private:
+		bool m_running;
+	};
+}
+
+#endif
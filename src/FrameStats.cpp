@@ -0,0 +1,97 @@
+// Copyright © 2008-2013 Pioneer Developers. See AUTHORS.txt for details
+// Licensed under the terms of the GPL v3. See licenses/GPL-3.txt
+
+#include "FrameStats.h"
+#include "StringF.h"
+
+namespace FrameStats {
+
+// tenth of a millisecond buckets up to a quarter second (the longest frame
+// the main loop simulates), then one for everything longer
+static const double BUCKET_MS = 0.1;
+static const int NUM_BUCKETS = 2500;
+
+static bool s_running = false;
+static double s_hitchMs = 0.0;
+static FILE *s_log = 0;
+
+static Uint32 s_buckets[NUM_BUCKETS + 1];
+static Uint64 s_frames = 0;
+static Uint32 s_hitches = 0;
+static double s_maxMs = 0.0;
+
+void Start(double hitchMs, FILE *log)
+{
+	if (s_running) Stop();
+
+	s_hitchMs = hitchMs;
+	s_log = log;
+
+	for (int i = 0; i <= NUM_BUCKETS; i++)
+		s_buckets[i] = 0;
+	s_frames = 0;
+	s_hitches = 0;
+	s_maxMs = 0.0;
+
+	s_running = true;
+}
+
+void Stop()
+{
+	if (!s_running) return;
+
+	if (s_log) {
+		fprintf(s_log, "%s\n", Report().c_str());
+		fclose(s_log);
+		s_log = 0;
+	}
+
+	s_running = false;
+}
+
+bool IsRunning()
+{
+	return s_running;
+}
+
+void EndFrame(double ms, const Work &work)
+{
+	if (!s_running) return;
+
+	s_buckets[std::min(int(ms / BUCKET_MS), NUM_BUCKETS)]++;
+	s_frames++;
+	s_maxMs = std::max(s_maxMs, ms);
+
+	if (s_hitchMs <= 0.0 || ms < s_hitchMs) return;
+
+	s_hitches++;
+	fprintf(s_log ? s_log : stderr,
+		"hitch: frame %llu took %.1f ms: %u jobs finished, %u Lua events, %u models loaded, %u textures loaded, %u GC steps\n",
+		static_cast<unsigned long long>(s_frames), ms,
+		work.jobsFinished, work.luaEvents, work.modelsLoaded, work.texturesLoaded, work.gcSteps);
+}
+
+// the top of the bucket the given fraction of frames fall in or below
+static double percentile(double fraction)
+{
+	const Uint64 want = Uint64(ceil(double(s_frames) * fraction));
+	Uint64 seen = 0;
+	for (int i = 0; i < NUM_BUCKETS; i++) {
+		seen += s_buckets[i];
+		if (seen >= want)
+			return std::min(double(i + 1) * BUCKET_MS, s_maxMs);
+	}
+	return s_maxMs;
+}
+
+std::string Report()
+{
+	if (!s_frames)
+		return "Frame times: no frames";
+
+	return stringf("Frame times: p50 %0{f.1} ms, p95 %1{f.1} ms, p99 %2{f.1} ms, max %3{f.1} ms, %4 hitches over %5{f.0} ms in %6 frames",
+		percentile(0.5), percentile(0.95), percentile(0.99), s_maxMs,
+		s_hitches, s_hitchMs, s_frames);
+}
+
+}
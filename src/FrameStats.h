@@ -0,0 +1,38 @@
+// Copyright © 2008-2013 Pioneer Developers. See AUTHORS.txt for details
+// Licensed under the terms of the GPL v3. See licenses/GPL-3.txt
+
+#ifndef _FRAMESTATS_H
+#define _FRAMESTATS_H
+
+#include "libs.h"
+
+// keeps a histogram of whole frame times, so the occasional long frame
+// shows up instead of vanishing into an average, and logs every frame over
+// a threshold (a hitch) with what the main loop did in it
+namespace FrameStats {
+
+	// what ran in a frame, besides drawing it
+	struct Work {
+		Work() : jobsFinished(0), luaEvents(0), modelsLoaded(0), texturesLoaded(0), gcSteps(0) {}
+		Uint32 jobsFinished;
+		Uint32 luaEvents;
+		Uint32 modelsLoaded;
+		Uint32 texturesLoaded;
+		Uint32 gcSteps;
+	};
+
+	// frames over hitchMs are logged, to the log file if one is given
+	// (closed on Stop) or else to stderr. 0 logs nothing
+	void Start(double hitchMs, FILE *log = 0);
+	// the summary goes to the log before it's closed
+	void Stop();
+	bool IsRunning();
+
+	// call once per frame with how long the whole frame took
+	void EndFrame(double ms, const Work &work);
+
+	// percentiles, max and hitches over every frame since Start
+	std::string Report();
+}
+
+#endif
@@ -5,6 +5,7 @@
 #include "Space.h"
 #include "Player.h"
 #include "Body.h"
+#include "CityOnPlanet.h"
 #include "SpaceStation.h"
 #include "HyperspaceCloud.h"
 #include "Pi.h"
@@ -20,18 +21,33 @@
 #include "SpaceStationView.h"
 #include "UIView.h"
 #include "LuaEvent.h"
+#include "Profiler.h"
 #include "ObjectViewerView.h"
 #include "FileSystem.h"
+#include "JobQueue.h"
+#include "MemoryStats.h"
+#include "ModelCache.h"
+#include "Lang.h"
+#include "StringF.h"
 #include "graphics/Renderer.h"
 
 static const int  s_saveVersion   = 68;
 static const char s_saveStart[]   = "PIONEER";
 static const char s_saveEnd[]     = "END";
 
+// the SaveInfo header. it's always the same size, names are cut to fit and
+// null padded, and numbers are little endian as the Serializer writes them
+static const char s_saveInfoMagic[] = "PIOH";
+static const size_t SAVE_INFO_MAGIC_LEN = 4;
+static const size_t SAVE_INFO_SIZE = 256;
+static const size_t SAVE_INFO_NAME_LEN = 64;
+static const size_t SAVE_INFO_LABEL_LEN = 32;
+
 Game::Game(const SystemPath &path) :
 	m_time(0),
 	m_state(STATE_NORMAL),
 	m_wantHyperspace(false),
+	m_arrivalPrepared(false),
 	m_timeAccel(TIMEACCEL_1X),
 	m_requestedTimeAccel(TIMEACCEL_1X),
 	m_forceTimeAccel(false)
@@ -56,6 +72,7 @@ Game::Game(const SystemPath &path, const vector3d &pos) :
 	m_time(0),
 	m_state(STATE_NORMAL),
 	m_wantHyperspace(false),
+	m_arrivalPrepared(false),
 	m_timeAccel(TIMEACCEL_1X),
 	m_requestedTimeAccel(TIMEACCEL_1X),
 	m_forceTimeAccel(false)
@@ -104,6 +121,7 @@ Game::~Game()
 }
 
 Game::Game(Serializer::Reader &rd) :
+	m_arrivalPrepared(false),
 	m_timeAccel(TIMEACCEL_PAUSED),
 	m_requestedTimeAccel(TIMEACCEL_PAUSED),
 	m_forceTimeAccel(false)
@@ -235,6 +253,8 @@ void Game::Serialize(Serializer::Writer &wr)
 
 void Game::TimeStep(float step)
 {
+	PROFILE_ZONE("Game::TimeStep");
+
 	m_time += step;			// otherwise planets lag time accel changes by a frame
 
 	m_space->TimeStep(step);
@@ -249,8 +269,11 @@ void Game::TimeStep(float step)
 			m_player->EnterSystem();
 			RequestTimeAccel(TIMEACCEL_1X);
 		}
-		else
+		else {
 			m_hyperspaceProgress += step;
+			if (!m_arrivalPrepared)
+				PrepareArrival();
+		}
 		return;
 	}
 
@@ -360,6 +383,9 @@ void Game::SwitchToHyperspace()
 
 	const SystemPath &dest = m_player->GetHyperspaceDest();
 
+	// have the destination made while we're in hyperspace
+	StarSystem::RequestBatch(std::vector<SystemPath>(1, dest), Job::PRIORITY_HIGH);
+
 	// find all the departure clouds, convert them to arrival clouds and store
 	// them for the next system
 	m_hyperspaceClouds.clear();
@@ -418,10 +444,32 @@ void Game::SwitchToHyperspace()
 
 	m_state = STATE_HYPERSPACE;
 	m_wantHyperspace = false;
+	m_arrivalPrepared = false;
 
 	printf("Started hyperspacing...\n");
 }
 
+void Game::PrepareArrival()
+{
+	// the system was asked for when the countdown started. once it's made,
+	// the station models (and the city buildings, for ground stations) can
+	// be read in the background too, rather than when the stations are
+	// put in the new space
+	const SystemPath &dest = m_player->GetHyperspaceDest();
+	if (!StarSystem::IsCached(dest))
+		return;
+	m_arrivalPrepared = true;
+
+	const RefCountedPtr<StarSystem> system = StarSystem::GetCached(dest);
+	for (std::vector<SystemBody*>::const_iterator i = system->m_spaceStations.begin(); i != system->m_spaceStations.end(); ++i) {
+		const SpaceStationType *type = SpaceStationType::ForSystemBody(*i);
+		if (!type->model)
+			Pi::modelCache->RequestModel(type->modelName);
+		if ((*i)->type == SystemBody::TYPE_STARPORT_SURFACE)
+			CityOnPlanet::RequestModels();
+	}
+}
+
 void Game::SwitchToNormalSpace()
 {
 	// remove the player from hyperspace
@@ -697,33 +745,228 @@ void Game::DestroyViews()
 	Pi::cpan = 0;
 }
 
-Game *Game::LoadGame(const std::string &filename)
+static void write_fixed_string(Serializer::Writer &wr, const std::string &str, size_t len)
+{
+	for (size_t i = 0; i < len; i++)
+		wr.Byte(i < str.size() && i < len-1 ? str[i] : 0);
+}
+
+static std::string read_fixed_string(Serializer::Reader &rd, size_t len)
+{
+	std::string str;
+	for (size_t i = 0; i < len; i++) {
+		const char c = rd.Byte();
+		if (c) str.push_back(c);
+	}
+	return str;
+}
+
+static std::string make_save_info(Game *game)
+{
+	const Player *player = game->GetPlayer();
+	const RefCountedPtr<StarSystem> system = game->GetSpace()->GetStarSystem();
+
+	Serializer::Writer wr;
+	for (size_t i = 0; i < SAVE_INFO_MAGIC_LEN; i++)
+		wr.Byte(s_saveInfoMagic[i]);
+	wr.Int32(SAVE_INFO_SIZE);
+	wr.Int32(s_saveVersion);
+	wr.Int32(0);
+	wr.Double(game->GetTime());
+	wr.Int64(player->GetMoney());
+	write_fixed_string(wr, system ? system->GetName() : std::string(), SAVE_INFO_NAME_LEN);
+	write_fixed_string(wr, player->GetShipType()->name, SAVE_INFO_NAME_LEN);
+	write_fixed_string(wr, player->GetLabel(), SAVE_INFO_LABEL_LEN);
+
+	std::string info = wr.GetData();
+	assert(info.size() <= SAVE_INFO_SIZE);
+	info.resize(SAVE_INFO_SIZE, 0);
+	return info;
+}
+
+// the size of the header in front of the game, 0 if there isn't one
+static size_t parse_save_info(const char *data, size_t size, Game::SaveInfo *info)
+{
+	if (size < SAVE_INFO_SIZE || memcmp(data, s_saveInfoMagic, SAVE_INFO_MAGIC_LEN) != 0)
+		return 0;
+
+	Serializer::Reader rd(std::string(data, SAVE_INFO_SIZE));
+	rd.Seek(SAVE_INFO_MAGIC_LEN);
+	const size_t headerSize = rd.Int32();
+	if (headerSize < SAVE_INFO_SIZE || headerSize > size)
+		return 0;
+	if (info) {
+		info->version = rd.Int32();
+		rd.Int32();
+		info->time = rd.Double();
+		info->money = Sint64(rd.Int64());
+		info->system = read_fixed_string(rd, SAVE_INFO_NAME_LEN);
+		info->shipType = read_fixed_string(rd, SAVE_INFO_NAME_LEN);
+		info->shipLabel = read_fixed_string(rd, SAVE_INFO_LABEL_LEN);
+	}
+	return headerSize;
+}
+
+bool Game::ReadSaveInfo(const std::string &filename, SaveInfo &info)
 {
-	printf("Game::LoadGame('%s')\n", filename.c_str());
 	FILE *f = FileSystem::userFiles.OpenReadStream(FileSystem::JoinPathBelow(Pi::SAVE_DIR_NAME, filename));
-	if (!f) throw CouldNotOpenFileException();
-	Serializer::Reader rd(f);
+	if (!f) return false;
+	char header[SAVE_INFO_SIZE];
+	const size_t got = fread(header, 1, sizeof(header), f);
 	fclose(f);
+	return parse_save_info(header, got, &info) != 0;
+}
+
+Game *Game::LoadGame(const std::string &filename)
+{
+	printf("Game::LoadGame('%s')\n", filename.c_str());
+	RefCountedPtr<FileSystem::FileData> data = FileSystem::userFiles.ReadFile(FileSystem::JoinPathBelow(Pi::SAVE_DIR_NAME, filename));
+	if (!data) throw CouldNotOpenFileException();
+	// older saves have no header and start straight off with the game
+	Serializer::Reader rd(data, parse_save_info(data->GetData(), data->GetSize(), 0));
+	MemoryStats::ScopedCharge charge(MemoryStats::SAVES, data->GetSize());
 	return new Game(rd);
 }
 
-void Game::SaveGame(const std::string &filename, Game *game)
+namespace {
+	// keeps a writer's output in the blocks it was flushed in, so they can
+	// go on to a FileSink later exactly as they would have
+	class SnapshotSink : public Serializer::Writer::Sink {
+	public:
+		SnapshotSink() : bytes(0) {}
+		virtual ~SnapshotSink() { MemoryStats::Remove(MemoryStats::SAVES, bytes); }
+		virtual void Write(const std::string &data) {
+			blocks.push_back(data);
+			bytes += data.size();
+			MemoryStats::Add(MemoryStats::SAVES, data.size());
+		}
+		std::vector<std::string> blocks;
+		size_t bytes;
+	};
+
+	class SaveGameJob : public Job {
+	public:
+		SaveGameJob(const std::string &filename, const std::string &info, bool compress, bool report) :
+			m_filename(filename), m_info(info), m_compress(compress), m_report(report), m_result(SAVE_OK) {}
+		virtual const char *GetName() const { return "SaveGameJob"; }
+
+		virtual void OnRun() {
+			FILE *f = FileSystem::userFiles.OpenWriteStream(FileSystem::JoinPathBelow(Pi::SAVE_DIR_NAME, m_filename));
+			if (!f) {
+				m_result = SAVE_COULD_NOT_OPEN;
+				return;
+			}
+
+			if (fwrite(m_info.data(), m_info.size(), 1, f) != 1) {
+				fclose(f);
+				m_result = SAVE_COULD_NOT_WRITE;
+				return;
+			}
+
+			Serializer::FileSink sink(f, m_compress);
+			for (std::vector<std::string>::const_iterator i = m_snapshot.blocks.begin(); i != m_snapshot.blocks.end(); ++i)
+				sink.Write(*i);
+			sink.Finish();
+
+			const bool failed = sink.Failed();
+			if (fclose(f) != 0 || failed)
+				m_result = SAVE_COULD_NOT_WRITE;
+		}
+
+		virtual void OnFinish() {
+			s_saveInProgress = false;
+
+			if (!Pi::cpan) return; // game's gone
+			const std::string path = FileSystem::JoinPath(Pi::GetSaveDir(), m_filename);
+			switch (m_result) {
+				case SAVE_OK:
+					if (m_report) Pi::cpan->MsgLog()->Message("", Lang::GAME_SAVED_TO + path);
+					break;
+				case SAVE_COULD_NOT_OPEN:
+					Pi::cpan->MsgLog()->Message("", stringf(Lang::COULD_NOT_OPEN_FILENAME, formatarg("path", path)));
+					break;
+				case SAVE_COULD_NOT_WRITE:
+					Pi::cpan->MsgLog()->Message("", Lang::GAME_SAVE_CANNOT_WRITE);
+					break;
+			}
+		}
+
+		virtual void OnCancel() {
+			s_saveInProgress = false;
+		}
+
+		SnapshotSink &GetSnapshot() { return m_snapshot; }
+
+		static bool s_saveInProgress;
+
+	private:
+		enum Result {
+			SAVE_OK,
+			SAVE_COULD_NOT_OPEN,
+			SAVE_COULD_NOT_WRITE
+		};
+
+		SnapshotSink m_snapshot;
+		std::string m_filename;
+		std::string m_info;
+		bool m_compress;
+		bool m_report;
+		Result m_result;
+	};
+
+	bool SaveGameJob::s_saveInProgress = false;
+}
+
+bool Game::SaveGameAsync(const std::string &filename, Game *game, bool report)
 {
 	assert(game);
+	if (SaveGameJob::s_saveInProgress) return false;
+
 	if (!FileSystem::userFiles.MakeDirectory(Pi::SAVE_DIR_NAME)) {
-		throw CouldNotOpenFileException();
+		Pi::cpan->MsgLog()->Message("", stringf(Lang::COULD_NOT_OPEN_FILENAME, formatarg("path", Pi::GetSaveDir())));
+		return true;
 	}
 
-	Serializer::Writer wr;
+	// the only part that holds up the main thread
+	SaveGameJob *job = new SaveGameJob(filename, make_save_info(game), Pi::config->Int("CompressSaves") != 0, report);
+	Serializer::Writer wr(&job->GetSnapshot());
 	game->Serialize(wr);
+	wr.Flush();
+
+	SaveGameJob::s_saveInProgress = true;
+	Pi::Jobs()->Queue(job);
+	return true;
+}
+
+void Game::SaveGame(const std::string &filename, Game *game)
+{
+	assert(game);
+	if (!FileSystem::userFiles.MakeDirectory(Pi::SAVE_DIR_NAME)) {
+		throw CouldNotOpenFileException();
+	}
 
-	const std::string data = wr.GetData();
+	const std::string info = make_save_info(game);
 
 	FILE *f = FileSystem::userFiles.OpenWriteStream(FileSystem::JoinPathBelow(Pi::SAVE_DIR_NAME, filename));
 	if (!f) throw CouldNotOpenFileException();
 
-	size_t nwritten = fwrite(data.data(), data.length(), 1, f);
-	fclose(f);
+	if (fwrite(info.data(), info.size(), 1, f) != 1) {
+		fclose(f);
+		throw CouldNotWriteToFileException();
+	}
+
+	// each section goes out to the file as soon as it's done
+	Serializer::FileSink sink(f, Pi::config->Int("CompressSaves") != 0);
+	try {
+		Serializer::Writer wr(&sink);
+		game->Serialize(wr);
+		wr.Flush();
+		sink.Finish();
+	} catch (...) {
+		fclose(f);
+		throw;
+	}
 
-	if (nwritten != 1) throw CouldNotWriteToFileException();
+	const bool failed = sink.Failed();
+	if (fclose(f) != 0 || failed) throw CouldNotWriteToFileException();
 }
@@ -21,6 +21,26 @@ public:
 	// XXX game arg should be const, and this should probably be a member function
 	// (or LoadGame/SaveGame should be somewhere else entirely)
 	static void SaveGame(const std::string &filename, Game *game);
+	// serialises the game now, then compresses and writes it on a worker.
+	// the outcome goes to the message log (failures only, unless report is
+	// set). returns false without saving if the last one is still going
+	static bool SaveGameAsync(const std::string &filename, Game *game, bool report);
+
+	// a few things about a save for the load menu. every save starts with
+	// them in a small fixed size header, written uncompressed ahead of the
+	// game itself, so they can be had without loading (or inflating) it
+	struct SaveInfo {
+		SaveInfo() : version(0), time(0.0), money(0) {}
+		int version;           // save format of the game behind the header
+		double time;           // game time
+		std::string system;    // where the player is
+		std::string shipType;
+		std::string shipLabel;
+		Sint64 money;
+	};
+	// reads just the header. false if the save has none (it's from before
+	// there were any) or it's damaged. safe to call from a job
+	static bool ReadSaveInfo(const std::string &filename, SaveInfo &info);
 
 	// start docked in station referenced by path
 	Game(const SystemPath &path);
@@ -89,6 +109,8 @@ private:
 
 	void SwitchToHyperspace();
 	void SwitchToNormalSpace();
+	// start loading what the destination system needs, once it's been made
+	void PrepareArrival();
 
 	ScopedPtr<Space> m_space;
 	double m_time;
@@ -108,6 +130,7 @@ private:
 	double m_hyperspaceProgress;
 	double m_hyperspaceDuration;
 	double m_hyperspaceEndTime;
+	bool m_arrivalPrepared; // not saved, it's just done again
 
 	TimeAccel m_timeAccel;
 	TimeAccel m_requestedTimeAccel;
@@ -31,13 +31,50 @@ GameConfig::GameConfig()
 	map["SectorViewZRotation"] = "0";
 	map["SectorViewZoom"] = "2.0";
 	map["MaxPhysicsCyclesPerRender"] = "4";
+	map["PhysicsBudget"] = "30000"; // microseconds per frame spent catching up on physics ticks, 0 for no limit
 	map["AntiAliasingMode"] = "2";
 	map["JoystickDeadzone"] = "0.1";
 	map["DefaultLowThrustPower"] = "0.25";
 	map["VSync"] = "0";
 	map["UseTextureCompression"] = "0";
+	map["TextureCache"] = "1"; // with texture compression, keep compressed copies of data/ textures on disk
 	map["CockpitCamera"] = "1";
+	map["OcclusionCulling"] = "1"; // skip ships and stations behind planets; 2 also uses GPU queries for ones hidden by stations
 	map["WorkerThreads"] = "0";
+	map["JobFinishBudget"] = "4000"; // microseconds per frame, 0 for no limit
+	map["FrameProfilerCSV"] = ""; // with dev keys, a file in the user directory to log frame pass timings to while debug info is shown
+	map["HitchThreshold"] = "100"; // milliseconds; longer frames are logged with what ran in them. 0 logs none
+	map["HitchLog"] = ""; // a file in the user directory for the hitches and frame time summary, instead of stderr
+	map["TextureBudgetMB"] = "0"; // video memory for textures, least recently used ones are dropped to stay within it. 0 for no limit
+	map["ModelBudgetMB"] = "0"; // memory for models, unused ones are dropped least recently used first to stay within it. 0 for no limit
+	map["TextureUploadBudget"] = "2000"; // microseconds per frame spent uploading background loaded textures, 0 for no limit
+	map["ModelCullPixels"] = "1"; // parts of models with a smaller radius on screen than this are not drawn, 0 to draw everything
+	map["ModelBenchShipTriangles"] = "0"; // -modelbenchmark flags ships drawing more triangles than this at any LOD. 0 for no limit
+	map["ModelBenchShipDrawCalls"] = "0"; // and more draw calls than this
+	map["ModelBenchStationTriangles"] = "0"; // the same for stations
+	map["ModelBenchStationDrawCalls"] = "0";
+	map["ModelBenchBuildingTriangles"] = "0"; // and buildings
+	map["ModelBenchBuildingDrawCalls"] = "0";
+	map["GeoPatchCache"] = "0"; // keep generated terrain patches on disk
+	map["TerrainGeomorph"] = "1"; // morph new terrain patches in from their parent's shape, with shaders
+	map["TerrainCompactVertices"] = "0"; // 1 for 16 byte terrain vertices instead of 32, 2 for 12 byte ones with shaders
+	map["ParallelBodyUpdates"] = "1"; // integrate moving bodies on the worker threads
+	map["SectorDatabase"] = "1"; // keep the sectors near the core on disk instead of generating them every time
+	map["StarSystemCacheSize"] = "64"; // generated systems kept after nothing uses them
+	map["StarSystemBudgetMB"] = "0"; // memory for cached star systems, unused ones are dropped sooner to stay within it. 0 for no limit
+	map["SectorBudgetMB"] = "0"; // memory for cached sectors, unused ones are dropped sooner to stay within it. 0 for no limit
+	map["CompressSaves"] = "1"; // deflate saved games. either kind loads
+	map["AutosaveInterval"] = "0"; // seconds between background saves, 0 for none
+	map["LuaGCBudget"] = "1000"; // microseconds of Lua collection per frame, 0 to let Lua pace itself
+	map["LuaGCPause"] = "200"; // percent growth in Lua memory before a new collection cycle
+	map["LuaGCStepMul"] = "200"; // how much collection each Lua step does, in percent
+	map["LuaTaskBudget"] = "2000"; // microseconds of Lua tasks per frame, 0 to run them all every frame
+	map["TerrainUpdateBudget"] = "2000"; // microseconds of terrain LOD updates per frame after the biggest planet on screen, 0 for no limit
+	map["LuaBytecodeCache"] = "1"; // keep compiled data/ scripts on disk
+	map["CustomSystemCache"] = "1"; // keep the systems made by data/systems on disk
+	map["ShaderBinaryCache"] = "1"; // keep linked shader programs on disk, and compile the ones used last time at startup
+	map["LuaMemorySoftLimit"] = "0"; // MB of Lua heap before warning about it, 0 for none
+	map["LuaMemoryHardLimit"] = "0"; // MB of Lua heap it can never go over, 0 for none
 
 #ifdef _WIN32
 	map["RedirectStdio"] = "1";
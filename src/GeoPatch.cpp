@@ -11,7 +11,6 @@
 #include "RefCounted.h"
 #include "graphics/Material.h"
 #include "graphics/Renderer.h"
-#include "graphics/Frustum.h"
 #include "graphics/Graphics.h"
 #include "graphics/VertexArray.h"
 #include "graphics/gl2/GeoSphereMaterial.h"
@@ -21,6 +20,12 @@
 
 // tri edge lengths
 static const double GEOPATCH_SUBDIVIDE_AT_CAMDIST = 5.0;
+// a patch isn't split if the most its mesh can be wrong by is smaller than
+// this many pixels on screen
+static const double GEOPATCH_MAX_PIXEL_ERROR = 1.0;
+// with geomorphing new patches fade in rather than pop, so more error can be
+// left on screen before splitting
+static const double GEOPATCH_MORPH_MAX_PIXEL_ERROR = 2.0;
 #define GEOPATCH_MAX_DEPTH  15 + (2*Pi::detail.fracmult) //15
 
 GeoPatch::GeoPatch(const RefCountedPtr<GeoPatchContext> &ctx_, GeoSphere *gs,
@@ -28,7 +33,7 @@ GeoPatch::GeoPatch(const RefCountedPtr<GeoPatchContext> &ctx_, GeoSphere *gs,
 	const int depth, const GeoPatchID &ID_)
 	: ctx(ctx_), v0(v0_), v1(v1_), v2(v2_), v3(v3_),
 	heights(NULL), normals(NULL), colors(NULL),
-	m_vbo(0), parent(NULL), geosphere(gs),
+	m_compactScale(1.0), parent(NULL), geosphere(gs),
 	m_depth(depth), mPatchID(ID_),
 	mHasJobRequest(false)
 {
@@ -50,6 +55,13 @@ GeoPatch::GeoPatch(const RefCountedPtr<GeoPatchContext> &ctx_, GeoSphere *gs,
  		distMult = 5.0 / Clamp(depth, 1, 5);
  	}
 	m_roughLength = GEOPATCH_SUBDIVIDE_AT_CAMDIST / pow(2.0, depth) * distMult;
+
+	// detail between the vertices can stick out by up to the vertex spacing
+	// on rough terrain, but no more than the tallest feature; on top of that
+	// the flat triangles cut inside the curve of the sphere
+	const double spacing = std::max((v1-v0).Length(), (v3-v0).Length()) / double(ctx->edgeLen-1);
+	m_geometricError = std::min(spacing, geosphere->GetMaxFeatureHeight()) + spacing*spacing*0.125;
+
 	m_needUpdateVBOs = false;
 }
 
@@ -62,20 +74,35 @@ GeoPatch::~GeoPatch() {
 	for (int i=0; i<NUM_KIDS; i++) {
 		kids[i].Reset();
 	}
-	heights.Reset();
-	normals.Reset();
-	colors.Reset();
-	glDeleteBuffersARB(1, &m_vbo);
+	ctx->heightsPool.Free(heights);
+	ctx->normalsPool.Free(normals);
+	ctx->colorsPool.Free(colors);
+	ctx->FreeVBOSlot(m_vboSlot);
+}
+
+// a unit normal as two bytes of octahedral coordinates, as the terrain
+// vertex shader unpacks them for VERTEX_FORMAT_PACKED
+static inline Sint16 pack_normal(const vector3f &n)
+{
+	const float s = fabs(n.x) + fabs(n.y) + fabs(n.z);
+	float px = n.x / s, py = n.y / s;
+	if (n.z < 0.0f) {
+		const float ox = (1.0f - fabs(py)) * (px >= 0.0f ? 1.0f : -1.0f);
+		const float oy = (1.0f - fabs(px)) * (py >= 0.0f ? 1.0f : -1.0f);
+		px = ox;
+		py = oy;
+	}
+	const int u = int(Clamp(roundf((px * 0.5f + 0.5f) * 255.0f), 0.0f, 255.0f));
+	const int v = int(Clamp(roundf((py * 0.5f + 0.5f) * 255.0f), 0.0f, 255.0f));
+	return Sint16(u*256 + v - 32768);
 }
 
 void GeoPatch::_UpdateVBOs() {
 	if (m_needUpdateVBOs) {
 		m_needUpdateVBOs = false;
-		if (!m_vbo) glGenBuffersARB(1, &m_vbo);
-		glBindBufferARB(GL_ARRAY_BUFFER, m_vbo);
-		glBufferDataARB(GL_ARRAY_BUFFER, sizeof(GeoPatchContext::VBOVertex)*ctx->NUMVERTICES(), 0, GL_DYNAMIC_DRAW);
+		if (!m_vboSlot.vbo) ctx->AllocVBOSlot(m_vboSlot);
 		double xfrac=0.0, yfrac=0.0;
-		double *pHts = heights.Get();
+		double *pHts = heights;
 		const vector3f *pNorm = &normals[0];
 		const Color3ub *pColr = &colors[0];
 		GeoPatchContext::VBOVertex *pData = ctx->vbotemp;
@@ -101,41 +128,218 @@ void GeoPatch::_UpdateVBOs() {
 				pData->col[3] = 255;
 				++pColr; // next colour
 
+				pData->morph = float(GetMorphHeight(x, y));
+
 				++pData; // next vertex
 
 				xfrac += ctx->frac;
 			}
 			yfrac += ctx->frac;
 		}
-		glBufferDataARB(GL_ARRAY_BUFFER, sizeof(GeoPatchContext::VBOVertex)*ctx->NUMVERTICES(), ctx->vbotemp, GL_DYNAMIC_DRAW);
+		const void *vertexData = ctx->vbotemp;
+		if (ctx->vertexFormat == GeoPatchContext::VERTEX_FORMAT_COMPACT) {
+			// every position is within clipRadius of the centroid, so that
+			// maps onto the full 16-bit range
+			m_compactScale = clipRadius / 32767.0;
+			const float toFixed = float(32767.0 / clipRadius);
+			const GeoPatchContext::VBOVertex *pIn = ctx->vbotemp;
+			GeoPatchContext::CompactVBOVertex *pOut = ctx->compactVbotemp;
+			for (int i=0; i<ctx->NUMVERTICES(); i++, pIn++, pOut++) {
+				pOut->x = Sint16(Clamp(roundf(pIn->x * toFixed), -32767.0f, 32767.0f));
+				pOut->y = Sint16(Clamp(roundf(pIn->y * toFixed), -32767.0f, 32767.0f));
+				pOut->z = Sint16(Clamp(roundf(pIn->z * toFixed), -32767.0f, 32767.0f));
+				pOut->morph = Sint16(Clamp(roundf(pIn->morph * toFixed), -32767.0f, 32767.0f));
+				pOut->nx = Sint8(Clamp(roundf(pIn->nx * 127.0f), -127.0f, 127.0f));
+				pOut->ny = Sint8(Clamp(roundf(pIn->ny * 127.0f), -127.0f, 127.0f));
+				pOut->nz = Sint8(Clamp(roundf(pIn->nz * 127.0f), -127.0f, 127.0f));
+				pOut->padding2 = 0;
+				memcpy(pOut->col, pIn->col, sizeof(pOut->col));
+			}
+			vertexData = ctx->compactVbotemp;
+		} else if (ctx->vertexFormat == GeoPatchContext::VERTEX_FORMAT_PACKED) {
+			// positions as for the compact format
+			m_compactScale = clipRadius / 32767.0;
+			const float toFixed = float(32767.0 / clipRadius);
+			const GeoPatchContext::VBOVertex *pIn = ctx->vbotemp;
+			GeoPatchContext::PackedVBOVertex *pOut = ctx->packedVbotemp;
+			for (int i=0; i<ctx->NUMVERTICES(); i++, pIn++, pOut++) {
+				pOut->x = Sint16(Clamp(roundf(pIn->x * toFixed), -32767.0f, 32767.0f));
+				pOut->y = Sint16(Clamp(roundf(pIn->y * toFixed), -32767.0f, 32767.0f));
+				pOut->z = Sint16(Clamp(roundf(pIn->z * toFixed), -32767.0f, 32767.0f));
+				pOut->normal = pack_normal(vector3f(pIn->nx, pIn->ny, pIn->nz));
+				memcpy(pOut->col, pIn->col, sizeof(pOut->col));
+			}
+			vertexData = ctx->packedVbotemp;
+		}
+		glBindBufferARB(GL_ARRAY_BUFFER, m_vboSlot.vbo);
+		glBufferSubDataARB(GL_ARRAY_BUFFER, m_vboSlot.offset, ctx->VertexSize()*ctx->NUMVERTICES(), vertexData);
+		Graphics::Stats::Add(Graphics::Stats::STAT_BUFFER_BYTES_UPLOADED, ctx->VertexSize()*ctx->NUMVERTICES());
+		Graphics::Stats::Add(Graphics::Stats::STAT_VERTICES_UPLOADED, ctx->NUMVERTICES());
 		glBindBufferARB(GL_ARRAY_BUFFER, 0);
+		ctx->boundVBO = 0;
 	}
 }
 
-void GeoPatch::Render(Graphics::Renderer *renderer, const vector3d &campos, const matrix4x4d &modelView, const Graphics::Frustum &frustum) {
+void GeoPatch::GatherLeaves(std::vector<GeoPatch*> &leaves) {
 	if (kids[0]) {
-		for (int i=0; i<NUM_KIDS; i++) kids[i]->Render(renderer, campos, modelView, frustum);
-	} else if (heights.Valid()) {
+		for (int i=0; i<NUM_KIDS; i++) kids[i]->GatherLeaves(leaves);
+	} else if (heights) {
 		_UpdateVBOs();
+		leaves.push_back(this);
+	}
+}
+
+void GeoPatch::Render(Graphics::Renderer *renderer, const vector3d &campos, const matrix4x4f &modelView) {
+	if (IsOverHorizon(campos))
+		return;
 
-		if (!frustum.TestPoint(clipCentroid, clipRadius))
-			return;
+	// the patch's own origin relative to the camera is worked out in
+	// doubles, and is small for the patches near the camera that need the
+	// precision. the rest can be floats
+	const vector3f relpos(clipCentroid - campos);
+	const bool packed = (ctx->vertexFormat == GeoPatchContext::VERTEX_FORMAT_PACKED);
+	const bool compact = packed || (ctx->vertexFormat == GeoPatchContext::VERTEX_FORMAT_COMPACT);
+	if (compact)
+		renderer->SetTransform(modelView * matrix4x4f::Translation(relpos) * matrix4x4f::ScaleMatrix(float(m_compactScale)));
+	else
+		renderer->SetTransform(modelView * matrix4x4f::Translation(relpos));
 
-		const vector3d relpos = clipCentroid - campos;
-		renderer->SetTransform(modelView * matrix4x4d::Translation(relpos));
+	// update the indices used for rendering
+	ctx->updateIndexBufferId(determineIndexbuffer());
 
-		Pi::statSceneTris += 2*(ctx->edgeLen-1)*(ctx->edgeLen-1);
+	if (ctx->boundVBO != m_vboSlot.vbo) {
+		glBindBufferARB(GL_ARRAY_BUFFER, m_vboSlot.vbo);
+		ctx->boundVBO = m_vboSlot.vbo;
+	}
+	const char *base = reinterpret_cast<const char *>(m_vboSlot.offset);
+	if (packed) {
+		// the normal rides in w, there's no normal array
+		const GLsizei stride = sizeof(GeoPatchContext::PackedVBOVertex);
+		glVertexPointer(4, GL_SHORT, stride, base);
+		glColorPointer(4, GL_UNSIGNED_BYTE, stride, base + offsetof(GeoPatchContext::PackedVBOVertex, col));
+	} else if (compact) {
+		const GLsizei stride = sizeof(GeoPatchContext::CompactVBOVertex);
+		glVertexPointer(3, GL_SHORT, stride, base);
+		glNormalPointer(GL_BYTE, stride, base + offsetof(GeoPatchContext::CompactVBOVertex, nx));
+		glColorPointer(4, GL_UNSIGNED_BYTE, stride, base + offsetof(GeoPatchContext::CompactVBOVertex, col));
+	} else {
+		glVertexPointer(3, GL_FLOAT, sizeof(GeoPatchContext::VBOVertex), base);
+		glNormalPointer(GL_FLOAT, sizeof(GeoPatchContext::VBOVertex), base + 3*sizeof(float));
+		glColorPointer(4, GL_UNSIGNED_BYTE, sizeof(GeoPatchContext::VBOVertex), base + 6*sizeof(float));
+	}
+	if (ctx->geomorph) {
+		// the morph heights are along the radius, which the shader works
+		// out from the patch's centre in the same units as the vertices
+		const vector3d centre = compact ? clipCentroid / m_compactScale : clipCentroid;
+		glMultiTexCoord4fARB(GL_TEXTURE1, float(centre.x), float(centre.y), float(centre.z), GetMorph(campos));
+		glTexCoordPointer(1, compact ? GL_SHORT : GL_FLOAT, GLsizei(ctx->VertexSize()),
+			base + (compact ? offsetof(GeoPatchContext::CompactVBOVertex, morph) : offsetof(GeoPatchContext::VBOVertex, morph)));
+	}
+	glBindBufferARB(GL_ELEMENT_ARRAY_BUFFER, ctx->indices_vbo);
+	glDrawElements(GL_TRIANGLES, ctx->indices_tri_count*3, GL_UNSIGNED_SHORT, 0);
+	Graphics::Stats::AddDraw(GL_TRIANGLES, ctx->indices_tri_count*3);
+}
 
-		// update the indices used for rendering
-		ctx->updateIndexBufferId(determineIndexbuffer());
+double GeoPatch::GetMorphHeight(int x, int y) const
+{
+	// the border is left alone so it always meets the neighbours
+	const int edgeLen = ctx->edgeLen;
+	if (x == 0 || y == 0 || x == edgeLen-1 || y == edgeLen-1)
+		return 0.0;
 
-		glBindBufferARB(GL_ARRAY_BUFFER, m_vbo);
-		glVertexPointer(3, GL_FLOAT, sizeof(GeoPatchContext::VBOVertex), 0);
-		glNormalPointer(GL_FLOAT, sizeof(GeoPatchContext::VBOVertex), reinterpret_cast<void *>(3*sizeof(float)));
-		glColorPointer(4, GL_UNSIGNED_BYTE, sizeof(GeoPatchContext::VBOVertex), reinterpret_cast<void *>(6*sizeof(float)));
-		glBindBufferARB(GL_ELEMENT_ARRAY_BUFFER, ctx->indices_vbo);
-		glDrawElements(GL_TRIANGLES, ctx->indices_tri_count*3, GL_UNSIGNED_SHORT, 0);
+	// the even vertices are the parent's. the others are on its triangles'
+	// edges, and the parent's quads are split along the same diagonal as
+	// the ones in the index lists
+	const double *h = heights;
+	double target;
+	if (!(x & 1) && !(y & 1))
+		return 0.0;
+	else if (!(y & 1))
+		target = 0.5 * (h[x-1 + y*edgeLen] + h[x+1 + y*edgeLen]);
+	else if (!(x & 1))
+		target = 0.5 * (h[x + (y-1)*edgeLen] + h[x + (y+1)*edgeLen]);
+	else
+		target = 0.5 * (h[x+1 + (y-1)*edgeLen] + h[x-1 + (y+1)*edgeLen]);
+	return target - h[x + y*edgeLen];
+}
+
+float GeoPatch::GetMorph(const vector3d &campos) const
+{
+	// the parent splits once its error passes the threshold, so the kids
+	// look just like it then, and all their own by twice that
+	const double pixelScale = geosphere->m_tempPixelScale;
+	if (!parent || pixelScale <= 0.0)
+		return 1.0f;
+	const double nearestDist = std::max((parent->clipCentroid - campos).Length() - parent->clipRadius, 1e-9);
+	const double error = parent->m_geometricError * pixelScale / nearestDist;
+	return float(Clamp((error - GEOPATCH_MORPH_MAX_PIXEL_ERROR) / GEOPATCH_MORPH_MAX_PIXEL_ERROR, 0.0, 1.0));
+}
+
+bool GeoPatch::Contains(const vector3d &p) const
+{
+	// the edges are great circle arcs, so the patch is what's on the inside
+	// of the four planes through them and the planet centre
+	const vector3d mid = v0 + v1 + v2 + v3;
+	const vector3d *corners[NUM_EDGES] = { &v0, &v1, &v2, &v3 };
+	for (int i=0; i<NUM_EDGES; i++) {
+		const vector3d n = corners[i]->Cross(*corners[(i+1)%NUM_EDGES]);
+		if (n.Dot(p) * n.Dot(mid) < 0.0) return false;
 	}
+	return true;
+}
+
+// the root of a*t^2 + b*t + c nearest the middle of [0,1], clamped to it
+static double patch_coord(const double a, const double b, const double c)
+{
+	const double disc = std::max(0.0, b*b - 4.0*a*c);
+	const double q = -0.5 * (b < 0.0 ? b - sqrt(disc) : b + sqrt(disc));
+	if (q == 0.0) return 0.5;
+	double t = c / q;
+	if (a != 0.0) {
+		const double t2 = q / a;
+		if (fabs(t2 - 0.5) < fabs(t - 0.5)) t = t2;
+	}
+	return Clamp(t, 0.0, 1.0);
+}
+
+double GeoPatch::GetMeshHeight(const vector3d &p) const
+{
+	assert(heights);
+
+	// before normalisation a patch point is v0 + x*e1 + y*e3 + x*y*e2, so
+	// the lines of constant x (or y) are straight. p is on the one whose
+	// plane through the centre contains it, which comes to a quadratic
+	const vector3d e1 = v1 - v0, e3 = v3 - v0, e2 = v2 - v1 - v3 + v0;
+	const double x = patch_coord(p.Dot(e1.Cross(e2)), p.Dot(v0.Cross(e2) + e1.Cross(e3)), p.Dot(v0.Cross(e3)));
+	const double y = patch_coord(p.Dot(e3.Cross(e2)), p.Dot(v0.Cross(e2) + e3.Cross(e1)), p.Dot(v0.Cross(e1)));
+
+	const int edgeLen = ctx->edgeLen;
+	const double fx = x * (edgeLen-1), fy = y * (edgeLen-1);
+	const int ix = std::min(int(fx), edgeLen-2), iy = std::min(int(fy), edgeLen-2);
+	const double u = fx - ix, w = fy - iy;
+
+	// on the same triangles as the mesh, split from (x+1,y) to (x,y+1)
+	const double *h = &heights[ix + iy*edgeLen];
+	if (u + w <= 1.0)
+		return h[0] + u*(h[1] - h[0]) + w*(h[edgeLen] - h[0]);
+	return h[edgeLen+1] + (1.0-u)*(h[edgeLen] - h[edgeLen+1]) + (1.0-w)*(h[1] - h[edgeLen+1]);
+}
+
+bool GeoPatch::IsOverHorizon(const vector3d &campos) const
+{
+	// the planet is at least a unit sphere, and nothing on it is higher than
+	// its tallest feature. a point at radius r can only be seen from the
+	// camera if it's nearer than the camera's horizon distance plus that
+	// point's own horizon distance, so if the nearest point of the patch's
+	// bounds is further than that for the highest possible terrain, none of
+	// the patch can be seen
+	const double camDistSqr = campos.LengthSqr();
+	if (camDistSqr <= 1.0)
+		return false;
+	const double maxRadius = 1.0 + geosphere->GetMaxFeatureHeight();
+	const double horizonDist = sqrt(camDistSqr - 1.0) + sqrt(maxRadius*maxRadius - 1.0);
+	const double nearestDist = (clipCentroid - campos).Length() - clipRadius;
+	return nearestDist > horizonDist;
 }
 
 void GeoPatch::LODUpdate(const vector3d &campos) {
@@ -158,8 +362,19 @@ void GeoPatch::LODUpdate(const vector3d &campos) {
 			}
 		}
 		const float centroidDist = (campos - centroid).Length();
-		const bool errorSplit = (centroidDist < m_roughLength);
-		if( !(canSplit && (m_depth < GEOPATCH_MAX_DEPTH) && errorSplit) ) {
+		bool errorSplit = (centroidDist < m_roughLength);
+		if (errorSplit) {
+			// only split if the extra detail would actually show up on screen
+			const double pixelScale = geosphere->m_tempPixelScale;
+			if (pixelScale > 0.0) {
+				const double nearestDist = std::max((clipCentroid - campos).Length() - clipRadius, 1e-9);
+				const double maxError = ctx->geomorph ? GEOPATCH_MORPH_MAX_PIXEL_ERROR : GEOPATCH_MAX_PIXEL_ERROR;
+				errorSplit = (m_geometricError * pixelScale / nearestDist) > maxError;
+			}
+		}
+		// nothing behind the horizon needs any more detail, and its kids
+		// can be merged away
+		if( !(canSplit && (m_depth < GEOPATCH_MAX_DEPTH) && errorSplit) || IsOverHorizon(campos) ) {
 			canSplit = false;
 		}
 	}
@@ -170,9 +385,9 @@ void GeoPatch::LODUpdate(const vector3d &campos) {
 			mHasJobRequest = true;
 
 			SQuadSplitRequest *ssrd = new SQuadSplitRequest(v0, v1, v2, v3, centroid.Normalized(), m_depth,
-						geosphere->m_sbody->path, mPatchID, ctx->edgeLen,
-						ctx->frac, Terrain::InstanceTerrain(geosphere->m_sbody));
-			Pi::Jobs()->Queue(new QuadPatchJob(ssrd));
+						geosphere->m_sbody->path, mPatchID, ctx, geosphere->m_cacheDir,
+						Terrain::InstanceTerrain(geosphere->m_sbody));
+			QuadPatchJob::QueueSplit(ssrd, campos, geosphere->GetJobGroup());
 		} else {
 			for (int i=0; i<NUM_KIDS; i++) {
 				kids[i]->LODUpdate(campos);
@@ -192,12 +407,14 @@ void GeoPatch::LODUpdate(const vector3d &campos) {
 
 void GeoPatch::RequestSinglePatch()
 {
-	if( !heights.Valid() ) {
+	if( !heights ) {
         assert(!mHasJobRequest);
 		mHasJobRequest = true;
 		SSingleSplitRequest *ssrd = new SSingleSplitRequest(v0, v1, v2, v3, centroid.Normalized(), m_depth,
-					geosphere->m_sbody->path, mPatchID, ctx->edgeLen, ctx->frac, Terrain::InstanceTerrain(geosphere->m_sbody));
-		Pi::Jobs()->Queue(new SinglePatchJob(ssrd));
+					geosphere->m_sbody->path, mPatchID, ctx, geosphere->m_cacheDir, Terrain::InstanceTerrain(geosphere->m_sbody));
+		SinglePatchJob *job = new SinglePatchJob(ssrd);
+		job->SetGroup(geosphere->GetJobGroup());
+		Pi::Jobs()->Queue(job);
 	}
 }
 
@@ -249,9 +466,9 @@ void GeoPatch::ReceiveHeightmaps(SQuadSplitResult *psr)
 		for (int i=0; i<NUM_KIDS; i++)
 		{
 			const SQuadSplitResult::SSplitResultData& data = psr->data(i);
-			kids[i]->heights.Reset(data.heights);
-			kids[i]->normals.Reset(data.normals);
-			kids[i]->colors.Reset(data.colors);
+			kids[i]->heights = data.heights;
+			kids[i]->normals = data.normals;
+			kids[i]->colors = data.colors;
 		}
 		for (int i=0; i<NUM_EDGES; i++) { if(edgeFriend[i]) edgeFriend[i]->NotifyEdgeFriendSplit(this); }
 		for (int i=0; i<NUM_KIDS; i++) {
@@ -268,9 +485,10 @@ void GeoPatch::ReceiveHeightmap(const SSingleSplitResult *psr)
 	assert(mHasJobRequest);
 	{
 		const SSingleSplitResult::SSplitResultData& data = psr->data();
-		heights.Reset(data.heights);
-		normals.Reset(data.normals);
-		colors.Reset(data.colors);
+		assert(!heights && !normals && !colors);
+		heights = data.heights;
+		normals = data.normals;
+		colors = data.colors;
 	}
 	mHasJobRequest = false;
 }
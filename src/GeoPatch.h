@@ -16,7 +16,7 @@
 
 #include <deque>
 
-namespace Graphics { class Renderer; class Frustum; }
+namespace Graphics { class Renderer; }
 class SystemBody;
 class GeoPatch;
 class GeoPatchContext;
@@ -32,15 +32,21 @@ public:
 
 	RefCountedPtr<GeoPatchContext> ctx;
 	const vector3d v0, v1, v2, v3;
-	ScopedArray<double> heights;
-	ScopedArray<vector3f> normals;
-	ScopedArray<Color3ub> colors;
-	GLuint m_vbo;
+	// allocated from, and freed back to, ctx's pools
+	double *heights;
+	vector3f *normals;
+	Color3ub *colors;
+	GeoPatchContext::VBOSlot m_vboSlot;
+	// fixed point to patch space, for VERTEX_FORMAT_COMPACT
+	double m_compactScale;
 	ScopedPtr<GeoPatch> kids[NUM_KIDS];
 	GeoPatch *parent;
 	GeoPatch *edgeFriend[NUM_EDGES]; // [0]=v01, [1]=v12, [2]=v20
 	GeoSphere *geosphere;
 	double m_roughLength;
+	// how far the surface inside this patch can be from its mesh, in
+	// planet radii. used for the screen-space error test
+	double m_geometricError;
 	vector3d clipCentroid, centroid;
 	double clipRadius;
 	int m_depth;
@@ -118,7 +124,13 @@ public:
 			(edgeFriend[3] ? 8u : 0u);
 	}
 
-	void Render(Graphics::Renderer *r, const vector3d &campos, const matrix4x4d &modelView, const Graphics::Frustum &frustum);
+	// the patches with meshes to draw, not split any further. their vbos
+	// are brought up to date
+	void GatherLeaves(std::vector<GeoPatch*> &leaves);
+	// draw a leaf patch, which has already been frustum tested. modelView
+	// is the planet's rotation and scale only, the translation comes from
+	// campos
+	void Render(Graphics::Renderer *r, const vector3d &campos, const matrix4x4f &modelView);
 
 	inline bool canBeMerged() const {
 		bool merge = true;
@@ -131,6 +143,20 @@ public:
 		return merge;
 	}
 
+	// for geomorphing. how far a vertex is from where the parent's mesh
+	// would have it, along the radius, and how far from the parent's shape
+	// to its own the patch should be drawn, 0 to 1
+	double GetMorphHeight(int x, int y) const;
+	float GetMorph(const vector3d &campos) const;
+
+	// for height queries. whether the unit vector p points into the patch,
+	// and the height of the patch's mesh there (only meaningful if it does)
+	bool Contains(const vector3d &p) const;
+	double GetMeshHeight(const vector3d &p) const;
+
+	// true if the whole patch is hidden behind the planet's horizon
+	bool IsOverHorizon(const vector3d &campos) const;
+
 	void LODUpdate(const vector3d &campos);
 
 	void RequestSinglePatch();
@@ -0,0 +1,131 @@
+// Copyright © 2008-2013 Pioneer Developers. See AUTHORS.txt for details
+// Licensed under the terms of the GPL v3. See licenses/GPL-3.txt
+
+#include "GeoPatchCache.h"
+#include "FileSystem.h"
+#include "GameConfig.h"
+#include "Pi.h"
+#include "galaxy/StarSystem.h"
+#include "miniz/miniz.h"
+#include <cstdio>
+#include <vector>
+
+namespace GeoPatchCache {
+
+static const char CACHE_DIR_NAME[] = "patchcache";
+
+// bump this when anything that feeds into patch generation changes
+static const Uint32 CACHE_VERSION = 1;
+
+struct FileHeader {
+	char magic[4];
+	Uint32 version;
+	Uint32 edgeLen;
+	Uint32 rawSize;
+	Uint32 compressedSize;
+};
+
+static const char CACHE_MAGIC[4] = { 'P', 'G', 'P', 'C' };
+
+static inline size_t RawSize(const int edgeLen)
+{
+	const size_t numVerts = size_t(edgeLen) * size_t(edgeLen);
+	return numVerts * (sizeof(double) + sizeof(vector3f) + sizeof(Color3ub));
+}
+
+static std::string PatchFileName(const std::string &dir, const uint64_t patchID, const int depth)
+{
+	char buf[64];
+	snprintf(buf, sizeof(buf), "%08x%08x_%d", Uint32(patchID >> 32), Uint32(patchID & 0xffffffff), depth);
+	return FileSystem::JoinPathBelow(dir, buf);
+}
+
+std::string GetDirectory(const SystemBody *body, const int edgeLen)
+{
+	if (!Pi::config->Int("GeoPatchCache"))
+		return std::string();
+
+	// everything the generated meshes depend on goes into the name, so a
+	// change of detail settings gets its own set of patches
+	const SystemPath &path = body->path;
+	char buf[128];
+	snprintf(buf, sizeof(buf), "%d_%d_%d_%u_%u_%u_%d_%d_%d", path.sectorX, path.sectorY, path.sectorZ,
+		path.systemIndex, path.bodyIndex, body->seed, edgeLen, Pi::detail.textures, Pi::detail.fracmult);
+
+	const std::string dir = FileSystem::JoinPathBelow(CACHE_DIR_NAME, buf);
+	if (!FileSystem::userFiles.MakeDirectory(CACHE_DIR_NAME) || !FileSystem::userFiles.MakeDirectory(dir))
+		return std::string();
+	return dir;
+}
+
+bool Load(const std::string &dir, const uint64_t patchID, const int depth, const int edgeLen,
+	double *heights, vector3f *normals, Color3ub *colors)
+{
+	assert(!dir.empty());
+
+	FILE *f = FileSystem::userFiles.OpenReadStream(PatchFileName(dir, patchID, depth));
+	if (!f) return false;
+
+	FileHeader header;
+	bool ok = (fread(&header, sizeof(header), 1, f) == 1) &&
+		(memcmp(header.magic, CACHE_MAGIC, sizeof(CACHE_MAGIC)) == 0) &&
+		header.version == CACHE_VERSION &&
+		header.edgeLen == Uint32(edgeLen) &&
+		header.rawSize == RawSize(edgeLen);
+
+	std::vector<unsigned char> compressed;
+	if (ok) {
+		compressed.resize(header.compressedSize);
+		ok = header.compressedSize > 0 && fread(&compressed[0], header.compressedSize, 1, f) == 1;
+	}
+	fclose(f);
+
+	if (!ok) return false;
+
+	std::vector<unsigned char> raw(header.rawSize);
+	mz_ulong rawSize = header.rawSize;
+	if (mz_uncompress(&raw[0], &rawSize, &compressed[0], header.compressedSize) != MZ_OK || rawSize != header.rawSize)
+		return false;
+
+	const size_t numVerts = size_t(edgeLen) * size_t(edgeLen);
+	const unsigned char *p = &raw[0];
+	memcpy(heights, p, numVerts * sizeof(double));    p += numVerts * sizeof(double);
+	memcpy(static_cast<void*>(normals), p, numVerts * sizeof(vector3f));  p += numVerts * sizeof(vector3f);
+	memcpy(static_cast<void*>(colors), p, numVerts * sizeof(Color3ub));
+	return true;
+}
+
+void Save(const std::string &dir, const uint64_t patchID, const int depth, const int edgeLen,
+	const double *heights, const vector3f *normals, const Color3ub *colors)
+{
+	assert(!dir.empty());
+
+	const size_t numVerts = size_t(edgeLen) * size_t(edgeLen);
+	std::vector<unsigned char> raw(RawSize(edgeLen));
+	unsigned char *p = &raw[0];
+	memcpy(p, heights, numVerts * sizeof(double));    p += numVerts * sizeof(double);
+	memcpy(p, normals, numVerts * sizeof(vector3f));  p += numVerts * sizeof(vector3f);
+	memcpy(p, colors, numVerts * sizeof(Color3ub));
+
+	mz_ulong compressedSize = mz_compressBound(raw.size());
+	std::vector<unsigned char> compressed(compressedSize);
+	if (mz_compress2(&compressed[0], &compressedSize, &raw[0], raw.size(), MZ_BEST_SPEED) != MZ_OK)
+		return;
+
+	FileHeader header;
+	memcpy(header.magic, CACHE_MAGIC, sizeof(CACHE_MAGIC));
+	header.version = CACHE_VERSION;
+	header.edgeLen = edgeLen;
+	header.rawSize = raw.size();
+	header.compressedSize = compressedSize;
+
+	// a short write leaves a file that fails the checks in Load, so the
+	// patch just gets generated again next time
+	FILE *f = FileSystem::userFiles.OpenWriteStream(PatchFileName(dir, patchID, depth));
+	if (!f) return;
+	fwrite(&header, sizeof(header), 1, f);
+	fwrite(&compressed[0], compressedSize, 1, f);
+	fclose(f);
+}
+
+}
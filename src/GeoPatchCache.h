@@ -0,0 +1,33 @@
+// Copyright © 2008-2013 Pioneer Developers. See AUTHORS.txt for details
+// Licensed under the terms of the GPL v3. See licenses/GPL-3.txt
+
+#ifndef _GEOPATCHCACHE_H
+#define _GEOPATCHCACHE_H
+
+#include "libs.h"
+#include <string>
+
+class SystemBody;
+
+// an on-disk cache of generated patch meshes, kept in the user dir. patches
+// are fully determined by the body, the patch, its depth and the detail
+// settings, so once one has been generated it never needs generating again.
+// files are written in native byte order; they're a local cache, not
+// something to share between machines
+namespace GeoPatchCache {
+
+	// the directory holding a body's patches at the current detail settings,
+	// creating it if needed. returns an empty string if the cache is turned
+	// off or the directory can't be made. main thread only
+	std::string GetDirectory(const SystemBody *body, const int edgeLen);
+
+	// these only touch the files in dir, so they're safe to call from the
+	// job threads. Load returns false if there's no usable cached patch
+	bool Load(const std::string &dir, const uint64_t patchID, const int depth, const int edgeLen,
+		double *heights, vector3f *normals, Color3ub *colors);
+	void Save(const std::string &dir, const uint64_t patchID, const int depth, const int edgeLen,
+		const double *heights, const vector3f *normals, const Color3ub *colors);
+
+}
+
+#endif
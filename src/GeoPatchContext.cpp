@@ -16,76 +16,29 @@
 #include <deque>
 #include <algorithm>
 
+// the index buffers for one edge length, for each edge configuration
+struct IndexLists {
+	GLuint vbo[NUM_INDEX_LISTS];
+	GLuint triCount[NUM_INDEX_LISTS];
+};
 
+// by edge length. every detail level's are built at startup and kept until
+// shutdown, so changing the detail level doesn't have to rebuild them
+static std::map<int, IndexLists> s_indexLists;
 
-void GeoPatchContext::Cleanup() {
-	midIndices.Reset();
-	for (int i=0; i<4; i++) {
-		loEdgeIndices[i].Reset();
-		hiEdgeIndices[i].Reset();
-	}
-	if (indices_vbo) {
-		indices_vbo = 0;
-	}
-	for (int i=0; i<NUM_INDEX_LISTS; i++) {
-		if (indices_list[i]) {
-			glDeleteBuffersARB(1, &indices_list[i]);
-		}
-	}
-	delete [] vbotemp;
-}
-
-void GeoPatchContext::updateIndexBufferId(const GLuint edge_hi_flags) {
-	assert(edge_hi_flags < GLuint(NUM_INDEX_LISTS));
-	indices_vbo = indices_list[edge_hi_flags];
-	indices_tri_count = indices_tri_counts[edge_hi_flags];
-}
-
-int GeoPatchContext::getIndices(std::vector<unsigned short> &pl, const unsigned int edge_hi_flags)
+static void build_index_lists(const int edgeLen, IndexLists &lists)
 {
-	// calculate how many tri's there are
-	int tri_count = (VBO_COUNT_MID_IDX() / 3);
-	for( int i=0; i<4; ++i ) {
-		if( edge_hi_flags & (1 << i) ) {
-			tri_count += (VBO_COUNT_HI_EDGE() / 3);
-		} else {
-			tri_count += (VBO_COUNT_LO_EDGE() / 3);
-		}
-	}
-
-	// pre-allocate enough space
-	pl.reserve(tri_count);
-
-	// add all of the middle indices
-	for(int i=0; i<VBO_COUNT_MID_IDX(); ++i) {
-		pl.push_back(midIndices[i]);
-	}
-	// selectively add the HI or LO detail indices
-	for (int i=0; i<4; i++) {
-		if( edge_hi_flags & (1 << i) ) {
-			for(int j=0; j<VBO_COUNT_HI_EDGE(); ++j) {
-				pl.push_back(hiEdgeIndices[i][j]);
-			}
-		} else {
-			for(int j=0; j<VBO_COUNT_LO_EDGE(); ++j) {
-				pl.push_back(loEdgeIndices[i][j]);
-			}
-		}
-	}
-
-	return tri_count;
-}
-
-void GeoPatchContext::Init() {
-	frac = 1.0 / double(edgeLen-1);
-
-	vbotemp = new VBOVertex[NUMVERTICES()];
+	const int loCount = 3*(edgeLen/2);
+	const int hiCount = 3*(edgeLen-1);
+	const int midCount = (4*3*(edgeLen-3)) + 2*(edgeLen-3)*(edgeLen-3)*3;
 
 	unsigned short *idx;
-	midIndices.Reset(new unsigned short[VBO_COUNT_MID_IDX()]);
+	ScopedArray<unsigned short> midIndices(new unsigned short[midCount]);
+	ScopedArray<unsigned short> loEdgeIndices[4];
+	ScopedArray<unsigned short> hiEdgeIndices[4];
 	for (int i=0; i<4; i++) {
-		loEdgeIndices[i].Reset(new unsigned short[VBO_COUNT_LO_EDGE()]);
-		hiEdgeIndices[i].Reset(new unsigned short[VBO_COUNT_HI_EDGE()]);
+		loEdgeIndices[i].Reset(new unsigned short[loCount]);
+		hiEdgeIndices[i].Reset(new unsigned short[hiCount]);
 	}
 	/* also want vtx indices for tris not touching edge of patch */
 	idx = midIndices.Get();
@@ -227,38 +180,137 @@ void GeoPatchContext::Init() {
 
 	// these will hold the optimised indices
 	std::vector<unsigned short> pl_short[NUM_INDEX_LISTS];
-	// populate the N indices lists from the arrays built during InitTerrainIndices()
+	// populate the N indices lists from the arrays built above
 	for( int i=0; i<NUM_INDEX_LISTS; ++i ) {
 		const unsigned int edge_hi_flags = i;
-		indices_tri_counts[i] = getIndices(pl_short[i], edge_hi_flags);
+		std::vector<unsigned short> &pl = pl_short[i];
+
+		// the middle indices, then selectively the HI or LO detail indices
+		pl.reserve(midCount + 4*hiCount);
+		pl.insert(pl.end(), midIndices.Get(), midIndices.Get() + midCount);
+		for (int j=0; j<4; j++) {
+			if( edge_hi_flags & (1 << j) )
+				pl.insert(pl.end(), hiEdgeIndices[j].Get(), hiEdgeIndices[j].Get() + hiCount);
+			else
+				pl.insert(pl.end(), loEdgeIndices[j].Get(), loEdgeIndices[j].Get() + loCount);
+		}
+		lists.triCount[i] = pl.size() / 3;
 	}
 
 	// iterate over each index list and optimize it
 	for( int i=0; i<NUM_INDEX_LISTS; ++i ) {
-		int tri_count = indices_tri_counts[i];
 		VertexCacheOptimizerUShort vco;
-		VertexCacheOptimizerUShort::Result res = vco.Optimize(&pl_short[i][0], tri_count);
+		VertexCacheOptimizerUShort::Result res = vco.Optimize(&pl_short[i][0], lists.triCount[i]);
 		assert(0 == res);
 	}
 
 	// everything should be hunky-dory for setting up as OpenGL index buffers now.
 	for( int i=0; i<NUM_INDEX_LISTS; ++i ) {
-		glGenBuffersARB(1, &indices_list[i]);
-		glBindBufferARB(GL_ELEMENT_ARRAY_BUFFER, indices_list[i]);
-		glBufferDataARB(GL_ELEMENT_ARRAY_BUFFER, sizeof(unsigned short)*indices_tri_counts[i]*3, &(pl_short[i][0]), GL_STATIC_DRAW);
+		glGenBuffersARB(1, &lists.vbo[i]);
+		glBindBufferARB(GL_ELEMENT_ARRAY_BUFFER, lists.vbo[i]);
+		glBufferDataARB(GL_ELEMENT_ARRAY_BUFFER, sizeof(unsigned short)*lists.triCount[i]*3, &(pl_short[i][0]), GL_STATIC_DRAW);
 		glBindBufferARB(GL_ELEMENT_ARRAY_BUFFER, 0);
 	}
+}
+
+void GeoPatchContext::Cleanup() {
+	// the index buffers are shared, and freed by UninitIndexLists
+	indices_vbo = 0;
+	delete [] vbotemp;
+	delete [] compactVbotemp;
+	delete [] packedVbotemp;
+}
+
+// each arena VBO holds this many patches
+static const int VBO_SLOTS_PER_BUFFER = 64;
+
+void GeoPatchContext::AllocVBOSlot(VBOSlot &slot)
+{
+	assert(!slot.vbo);
+	if (m_freeVBOSlots.empty()) {
+		const GLsizeiptrARB slotSize = VertexSize()*NUMVERTICES();
+		GLuint vbo;
+		glGenBuffersARB(1, &vbo);
+		glBindBufferARB(GL_ARRAY_BUFFER, vbo);
+		glBufferDataARB(GL_ARRAY_BUFFER, slotSize*VBO_SLOTS_PER_BUFFER, 0, GL_DYNAMIC_DRAW);
+		glBindBufferARB(GL_ARRAY_BUFFER, 0);
+		boundVBO = 0;
+		m_arenaVBOs.push_back(vbo);
+		m_arenaBytes += slotSize*VBO_SLOTS_PER_BUFFER;
+		MemoryStats::Add(MemoryStats::TERRAIN_VBO, slotSize*VBO_SLOTS_PER_BUFFER);
+
+		// hand them out lowest first
+		for (int i=VBO_SLOTS_PER_BUFFER-1; i>=0; i--) {
+			VBOSlot s;
+			s.vbo = vbo;
+			s.offset = slotSize*i;
+			m_freeVBOSlots.push_back(s);
+		}
+	}
+	slot = m_freeVBOSlots.back();
+	m_freeVBOSlots.pop_back();
+}
+
+void GeoPatchContext::FreeVBOSlot(VBOSlot &slot)
+{
+	if (!slot.vbo)
+		return;
+	m_freeVBOSlots.push_back(slot);
+	slot = VBOSlot();
+}
+
+void GeoPatchContext::DestroyVBOArena()
+{
+	if (!m_arenaVBOs.empty())
+		glDeleteBuffersARB(m_arenaVBOs.size(), &m_arenaVBOs[0]);
+	m_arenaVBOs.clear();
+	m_freeVBOSlots.clear();
+	MemoryStats::Remove(MemoryStats::TERRAIN_VBO, m_arenaBytes);
+	m_arenaBytes = 0;
+	boundVBO = 0;
+}
+
+void GeoPatchContext::updateIndexBufferId(const GLuint edge_hi_flags) {
+	assert(edge_hi_flags < GLuint(NUM_INDEX_LISTS));
+	indices_vbo = indices_list[edge_hi_flags];
+	indices_tri_count = indices_tri_counts[edge_hi_flags];
+}
+
+void GeoPatchContext::Init() {
+	frac = 1.0 / double(edgeLen-1);
+
+	vbotemp = new VBOVertex[NUMVERTICES()];
+	compactVbotemp = (vertexFormat == VERTEX_FORMAT_COMPACT) ? new CompactVBOVertex[NUMVERTICES()] : 0;
+	packedVbotemp = (vertexFormat == VERTEX_FORMAT_PACKED) ? new PackedVBOVertex[NUMVERTICES()] : 0;
+
+	// normally built at startup, but any edge length will do
+	std::map<int, IndexLists>::iterator lists = s_indexLists.find(edgeLen);
+	if (lists == s_indexLists.end()) {
+		lists = s_indexLists.insert(std::make_pair(edgeLen, IndexLists())).first;
+		build_index_lists(edgeLen, lists->second);
+	}
+	for (int i=0; i<NUM_INDEX_LISTS; i++) {
+		indices_list[i] = lists->second.vbo[i];
+		indices_tri_counts[i] = lists->second.triCount[i];
+	}
 
 	// default it to the last entry which uses the hi-res borders
 	indices_vbo			= indices_list[NUM_INDEX_LISTS-1];
 	indices_tri_count	= indices_tri_counts[NUM_INDEX_LISTS-1];
+}
 
-	if (midIndices) {
-		midIndices.Reset();
-		for (int i=0; i<4; i++) {
-			loEdgeIndices[i].Reset();
-			hiEdgeIndices[i].Reset();
-		}
+void GeoPatchContext::InitIndexLists(const int *edgeLens, int count)
+{
+	for (int i=0; i<count; i++) {
+		if (s_indexLists.count(edgeLens[i])) continue;
+		build_index_lists(edgeLens[i], s_indexLists[edgeLens[i]]);
 	}
 }
 
+void GeoPatchContext::UninitIndexLists()
+{
+	for (std::map<int, IndexLists>::iterator i = s_indexLists.begin(); i != s_indexLists.end(); ++i)
+		glDeleteBuffersARB(NUM_INDEX_LISTS, i->second.vbo);
+	s_indexLists.clear();
+}
+
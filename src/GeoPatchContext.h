@@ -12,6 +12,7 @@
 #include "graphics/Material.h"
 #include "terrain/Terrain.h"
 #include "GeoPatchID.h"
+#include "BlockPool.h"
 
 #include <deque>
 
@@ -34,11 +35,56 @@ public:
 		float x,y,z;
 		float nx,ny,nz;
 		unsigned char col[4];
-		float padding;
+		float morph; // height to the parent patch's mesh, for geomorphing
 	};
 	#pragma pack()
 
+	// half the size of VBOVertex. positions are 16-bit fixed point relative
+	// to the patch's centroid, scaled by the patch's modelview transform, as
+	// is morph; normals are signed bytes, which GL normalises on the way in
+	#pragma pack(4)
+	struct CompactVBOVertex
+	{
+		Sint16 x,y,z;
+		Sint16 morph;
+		Sint8 nx,ny,nz;
+		Sint8 padding2;
+		unsigned char col[4];
+	};
+	#pragma pack()
+
+	// 12 bytes, for the shader path only. positions as CompactVBOVertex,
+	// and the normal is packed into w as two bytes of octahedral
+	// coordinates, which the terrain vertex shader unpacks
+	#pragma pack(4)
+	struct PackedVBOVertex
+	{
+		Sint16 x,y,z;
+		Sint16 normal;
+		unsigned char col[4];
+	};
+	#pragma pack()
+
+	enum VertexFormat {
+		VERTEX_FORMAT_FULL,		// VBOVertex
+		VERTEX_FORMAT_COMPACT,	// CompactVBOVertex
+		VERTEX_FORMAT_PACKED	// PackedVBOVertex
+	};
+
 	int edgeLen;
+	const VertexFormat vertexFormat;
+	// new patches morph from their parent's shape in the terrain shader
+	// rather than popping in. not for VERTEX_FORMAT_PACKED, which has no
+	// room for the morph heights
+	const bool geomorph;
+
+	inline size_t VertexSize() const {
+		switch (vertexFormat) {
+			case VERTEX_FORMAT_COMPACT: return sizeof(CompactVBOVertex);
+			case VERTEX_FORMAT_PACKED: return sizeof(PackedVBOVertex);
+			default: return sizeof(VBOVertex);
+		}
+	}
 
 	inline int VBO_COUNT_LO_EDGE() const { return 3*(edgeLen/2); }
 	inline int VBO_COUNT_HI_EDGE() const { return 3*(edgeLen-1); }
@@ -54,21 +100,54 @@ public:
 
 	double frac;
 
-	ScopedArray<unsigned short> midIndices;
-	ScopedArray<unsigned short> loEdgeIndices[4];
-	ScopedArray<unsigned short> hiEdgeIndices[4];
+	// shared with every other context with the same edge length
 	GLuint indices_vbo;
 	GLuint indices_list[NUM_INDEX_LISTS];
 	GLuint indices_tri_count;
 	GLuint indices_tri_counts[NUM_INDEX_LISTS];
 	VBOVertex *vbotemp;
-
-	GeoPatchContext(int _edgeLen) : edgeLen(_edgeLen) {
+	CompactVBOVertex *compactVbotemp;	// only for VERTEX_FORMAT_COMPACT
+	PackedVBOVertex *packedVbotemp;	// only for VERTEX_FORMAT_PACKED
+
+	// every patch and split request has buffers of the same few sizes, so
+	// they're recycled here rather than churning the heap
+	BlockPool<double> heightsPool;
+	BlockPool<vector3f> normalsPool;
+	BlockPool<Color3ub> colorsPool;
+	BlockPool<double> borderHeightsPool;
+	BlockPool<vector3d> borderVertexsPool;
+
+	// patch vertex data lives in slots carved out of a few large VBOs, so
+	// patches coming and going don't churn buffer objects in the driver. all
+	// patches are the same size so any free slot will do
+	struct VBOSlot {
+		VBOSlot() : vbo(0), offset(0) {}
+		GLuint vbo;
+		GLintptrARB offset;
+	};
+	void AllocVBOSlot(VBOSlot &slot);
+	void FreeVBOSlot(VBOSlot &slot);
+
+	// the VBO currently bound for patch rendering, so runs of patches sharing
+	// a buffer only bind it once. zero when nothing's known to be bound
+	GLuint boundVBO;
+
+	GeoPatchContext(int _edgeLen, VertexFormat _vertexFormat = VERTEX_FORMAT_FULL, bool _geomorph = false) :
+		edgeLen(_edgeLen), vertexFormat(_vertexFormat), geomorph(_geomorph && _vertexFormat != VERTEX_FORMAT_PACKED),
+		heightsPool(_edgeLen*_edgeLen), normalsPool(_edgeLen*_edgeLen), colorsPool(_edgeLen*_edgeLen),
+		borderHeightsPool((_edgeLen+2)*(_edgeLen+2)), borderVertexsPool((_edgeLen+2)*(_edgeLen+2)),
+		boundVBO(0), m_arenaBytes(0) {
+		heightsPool.SetMemoryTag(MemoryStats::TERRAIN);
+		normalsPool.SetMemoryTag(MemoryStats::TERRAIN);
+		colorsPool.SetMemoryTag(MemoryStats::TERRAIN);
+		borderHeightsPool.SetMemoryTag(MemoryStats::TERRAIN);
+		borderVertexsPool.SetMemoryTag(MemoryStats::TERRAIN);
 		Init();
 	}
 
 	~GeoPatchContext() {
 		Cleanup();
+		DestroyVBOArena();
 	}
 
 	void Refresh() {
@@ -80,9 +159,19 @@ public:
 
 	void updateIndexBufferId(const GLuint edge_hi_flags);
 
-	int getIndices(std::vector<unsigned short> &pl, const unsigned int edge_hi_flags);
+	// build the index buffers for these edge lengths up front, so making a
+	// context for any of them later is quick. they're kept until Uninit
+	static void InitIndexLists(const int *edgeLens, int count);
+	static void UninitIndexLists();
 
 	void Init();
+
+private:
+	void DestroyVBOArena();
+
+	std::vector<GLuint> m_arenaVBOs;
+	std::vector<VBOSlot> m_freeVBOSlots;
+	size_t m_arenaBytes;
 };
 
 #endif /* _GEOPATCHCONTEXT_H */
@@ -4,6 +4,7 @@
 #include "libs.h"
 #include "GeoPatchJobs.h"
 #include "GeoSphere.h"
+#include "GeoPatchCache.h"
 #include "perlin.h"
 #include "Pi.h"
 #include "RefCounted.h"
@@ -20,6 +21,17 @@ inline void setColour(Color3ub &r, const vector3d &v) {
 uint32_t BasePatchJob::s_numActivePatchJobs = 0;
 bool BasePatchJob::s_abort = false;
 
+// static
+float BasePatchJob::CalcPriority(const vector3d &centroid, const uint32_t depth, const vector3d &campos)
+{
+	// each halving of the distance to the camera counts the same as one level
+	// of depth. both are kept well inside the normal priority class
+	const double dist = std::max((campos - centroid).Length(), 1e-9);
+	const double urgency = double(depth) - log(dist) / log(2.0);
+	const double span = double(PRIORITY_CLASS_SPAN - 1);
+	return float(PRIORITY_NORMAL) + float(Clamp(urgency, -span, span));
+}
+
 // Generates full-detail vertices, and also non-edge normals and colors 
 void BasePatchJob::GenerateMesh(double *heights, vector3f *normals, Color3ub *colors, 
 								double *borderHeights, vector3d *borderVertexs,
@@ -38,17 +50,20 @@ void BasePatchJob::GenerateMesh(double *heights, vector3f *normals, Color3ub *co
 	double *bhts = borderHeights;
 	vector3d *vrts = borderVertexs;
 	for (int y=-1; y<borderedEdgeLen-1; y++) {
+		// quit out
+		if( s_abort || IsCancelled() )
+			return;
+
+		// lay out the row's points, fetch all their heights in one go, then
+		// push the points out to the surface
 		const double yfrac = double(y) * fracStep;
 		for (int x=-1; x<borderedEdgeLen-1; x++) {
-			// quit out
-			if( s_abort) 
-				return;
-
 			const double xfrac = double(x) * fracStep;
-			const vector3d p = GetSpherePoint(v0, v1, v2, v3, xfrac, yfrac);
-			const double height = pTerrain->GetHeight(p);
-			*(bhts++) = height;
-			*(vrts++) = p * (height + 1.0);
+			vrts[x+1] = GetSpherePoint(v0, v1, v2, v3, xfrac, yfrac);
+		}
+		pTerrain->GetHeights(vrts, bhts, borderedEdgeLen);
+		for (int x=0; x<borderedEdgeLen; x++) {
+			*(vrts++) *= (*(bhts++) + 1.0);
 		}
 	}
 	assert(bhts==&borderHeights[numBorderedVerts]);
@@ -59,11 +74,11 @@ void BasePatchJob::GenerateMesh(double *heights, vector3f *normals, Color3ub *co
 	double *hts = heights;
 	vrts = borderVertexs;
 	for (int y=1; y<borderedEdgeLen-1; y++) {
-		for (int x=1; x<borderedEdgeLen-1; x++) {
-			// quit out
-			if( s_abort) 
-				return;
+		// quit out
+		if( s_abort || IsCancelled() )
+			return;
 
+		for (int x=1; x<borderedEdgeLen-1; x++) {
 			// height
 			const double height = borderHeights[x + y*borderedEdgeLen];
 			assert(hts!=&heights[edgeLen*edgeLen]);
@@ -90,30 +105,52 @@ void BasePatchJob::GenerateMesh(double *heights, vector3f *normals, Color3ub *co
 	assert(col==&colors[edgeLen*edgeLen]);
 }
 
+void BasePatchJob::GenerateCachedMesh(const SBaseRequest &req, const uint64_t patchID, const int depth,
+									  double *heights, vector3f *normals, Color3ub *colors,
+									  double *borderHeights, vector3d *borderVertexs,
+									  const vector3d &v0,
+									  const vector3d &v1,
+									  const vector3d &v2,
+									  const vector3d &v3) const
+{
+	if( !req.cacheDir.empty() && GeoPatchCache::Load(req.cacheDir, patchID, depth, req.edgeLen, heights, normals, colors) )
+		return;
+
+	GenerateMesh(heights, normals, colors, borderHeights, borderVertexs,
+		v0, v1, v2, v3, req.edgeLen, req.fracStep, req.pTerrain.Get());
+
+	// only complete meshes go in the cache
+	if( !req.cacheDir.empty() && !s_abort && !IsCancelled() )
+		GeoPatchCache::Save(req.cacheDir, patchID, depth, req.edgeLen, heights, normals, colors);
+}
+
 // ********************************************************************************
 // Overloaded PureJob class to handle generating the mesh for each patch
 // ********************************************************************************
 void SinglePatchJob::OnFinish()  // runs in primary thread of the context
 {
-	if(s_abort) {
-		if(mpResults) {
-			// clean up after ourselves
-			mpResults->OnCancel();
-			delete mpResults;
-		}
-	} else {
-		GeoSphere::OnAddSingleSplitResult( mData->sysPath, mpResults );
+	// the buffers only leave the request once the mesh is known to be complete
+	if(!s_abort && !IsCancelled()) {
+		SSingleSplitRequest &srd = (*mData.Get());
+
+		// add this patches data
+		SSingleSplitResult *sr = new SSingleSplitResult(srd.patchID.GetPatchFaceIdx(), srd.depth, srd.ctx);
+		sr->addResult(srd.heights, srd.normals, srd.colors, 
+			srd.v0, srd.v1, srd.v2, srd.v3, 
+			srd.patchID.NextPatchID(srd.depth+1, 0));
+		srd.heights = NULL;
+		srd.normals = NULL;
+		srd.colors = NULL;
+
+		GeoSphere::OnAddSingleSplitResult( srd.sysPath, sr );
 	}
 	BasePatchJob::OnFinish();
 }
 
 void SinglePatchJob::OnCancel()   // runs in primary thread of the context
 {
-	if(mpResults) {
-		mpResults->OnCancel();
-		delete mpResults;
-		mpResults = NULL;
-	}
+	// OnRun may still be going, so leave the buffers alone. they go back to
+	// the pools when the job and its request are deleted
 	BasePatchJob::OnCancel();
 }
 
@@ -127,45 +164,89 @@ void SinglePatchJob::OnRun()    // RUNS IN ANOTHER THREAD!! MUST BE THREAD SAFE!
 	const SSingleSplitRequest &srd = (*mData.Get());
 
 	// fill out the data
-	GenerateMesh(srd.heights, srd.normals, srd.colors, srd.borderHeights.Get(), srd.borderVertexs.Get(),
-		srd.v0, srd.v1, srd.v2, srd.v3, 
-		srd.edgeLen, srd.fracStep, srd.pTerrain.Get());
-	// add this patches data
-	SSingleSplitResult *sr = new SSingleSplitResult(srd.patchID.GetPatchFaceIdx(), srd.depth);
-	sr->addResult(srd.heights, srd.normals, srd.colors, 
-		srd.v0, srd.v1, srd.v2, srd.v3, 
-		srd.patchID.NextPatchID(srd.depth+1, 0));
-	// store the result
-	mpResults = sr;
+	GenerateCachedMesh(srd, srd.patchID.NextPatchID(srd.depth+1, 0), srd.depth,
+		srd.heights, srd.normals, srd.colors, srd.borderHeights, srd.borderVertexs,
+		srd.v0, srd.v1, srd.v2, srd.v3);
 }
 
 // ********************************************************************************
 // Overloaded PureJob class to handle generating the mesh for each patch
 // ********************************************************************************
+// static
+void QuadPatchJob::QueueSplit(SQuadSplitRequest *data, const vector3d &campos, const Uint32 group)
+{
+	RefCountedPtr<SQuadSplitTask> task(new SQuadSplitTask(data));
+	const int numJobs = (Pi::Jobs()->GetNumIdleRunners() > 0) ? 4 : 1;
+	for (int i=0; i<numJobs; i++) {
+		QuadPatchJob *job = new QuadPatchJob(task, i*4/numJobs, 4/numJobs, campos);
+		job->SetGroup(group);
+		Pi::Jobs()->Queue(job);
+	}
+}
+
+void QuadPatchJob::GetKidCorners(vector3d (&vecs)[4][4]) const
+{
+	const SQuadSplitRequest &srd = (*mTask->request.Get());
+	const vector3d v01	= (srd.v0+srd.v1).Normalized();
+	const vector3d v12	= (srd.v1+srd.v2).Normalized();
+	const vector3d v23	= (srd.v2+srd.v3).Normalized();
+	const vector3d v30	= (srd.v3+srd.v0).Normalized();
+	const vector3d cn	= (srd.centroid).Normalized();
+
+	// 
+	vecs[0][0] = srd.v0;	vecs[0][1] = v01;		vecs[0][2] = cn;		vecs[0][3] = v30;
+	vecs[1][0] = v01;		vecs[1][1] = srd.v1;	vecs[1][2] = v12;		vecs[1][3] = cn;
+	vecs[2][0] = cn;		vecs[2][1] = v12;		vecs[2][2] = srd.v2;	vecs[2][3] = v23;
+	vecs[3][0] = v30;		vecs[3][1] = cn;		vecs[3][2] = v23;		vecs[3][3] = srd.v3;
+}
+
 void QuadPatchJob::OnFinish()  // runs in primary thread of the context
 {
-	if(s_abort) {
-		// clean up after ourselves
-		if(mpResults) {
-			mpResults->OnCancel();
-			delete mpResults;
+	// the buffers only leave the request once all the meshes are known to be
+	// complete. a cancelled split never gets here for all of its kids
+	mTask->numKidsDone += mNumKids;
+	if(!s_abort && !IsCancelled() && mTask->numKidsDone == 4) {
+		SQuadSplitRequest &srd = (*mTask->request.Get());
+
+		vector3d vecs[4][4];
+		GetKidCorners(vecs);
+
+		SQuadSplitResult *sr = new SQuadSplitResult(srd.patchID.GetPatchFaceIdx(), srd.depth, srd.ctx);
+		for (int i=0; i<4; i++)
+		{
+			// add this patches data
+			sr->addResult(i, srd.heights[i], srd.normals[i], srd.colors[i], 
+				vecs[i][0], vecs[i][1], vecs[i][2], vecs[i][3], 
+				srd.patchID.NextPatchID(srd.depth+1, i));
+			srd.heights[i] = NULL;
+			srd.normals[i] = NULL;
+			srd.colors[i] = NULL;
 		}
-	} else {
-		GeoSphere::OnAddQuadSplitResult( mData->sysPath, mpResults );
+
+		GeoSphere::OnAddQuadSplitResult( srd.sysPath, sr );
 	}
 	BasePatchJob::OnFinish();
 }
 
 void QuadPatchJob::OnCancel()   // runs in primary thread of the context
 {
-	if(mpResults) {
-		mpResults->OnCancel();
-		delete mpResults;
-		mpResults = NULL;
-	}
+	// OnRun may still be going, so leave the buffers alone. they go back to
+	// the pools when the last job sharing the request is deleted
 	BasePatchJob::OnCancel();
 }
 
+bool QuadPatchJob::UpdatePriority()   // runs in primary thread of the context
+{
+	vector3d campos;
+	const SQuadSplitRequest &srd = (*mTask->request.Get());
+	if (!GeoSphere::GetLastCameraPosition(srd.sysPath, campos))
+		return false;
+
+	const float oldPriority = GetPriority();
+	SetPriority(CalcPriority(srd.centroid, srd.depth, campos));
+	return !is_equal_exact(GetPriority(), oldPriority);
+}
+
 void QuadPatchJob::OnRun()    // RUNS IN ANOTHER THREAD!! MUST BE THREAD SAFE!
 {
 	BasePatchJob::OnRun();
@@ -173,37 +254,19 @@ void QuadPatchJob::OnRun()    // RUNS IN ANOTHER THREAD!! MUST BE THREAD SAFE!
 	if(s_abort)
 		return;
 
-	const SQuadSplitRequest &srd = (*mData.Get());
-	const vector3d v01	= (srd.v0+srd.v1).Normalized();
-	const vector3d v12	= (srd.v1+srd.v2).Normalized();
-	const vector3d v23	= (srd.v2+srd.v3).Normalized();
-	const vector3d v30	= (srd.v3+srd.v0).Normalized();
-	const vector3d cn	= (srd.centroid).Normalized();
+	const SQuadSplitRequest &srd = (*mTask->request.Get());
 
-	// 
-	const vector3d vecs[4][4] = {
-		{srd.v0,	v01,		cn,			v30},
-		{v01,		srd.v1,		v12,		cn},
-		{cn,		v12,		srd.v2,		v23},
-		{v30,		cn,			v23,		srd.v3}
-	};
-
-	SQuadSplitResult *sr = new SQuadSplitResult(srd.patchID.GetPatchFaceIdx(), srd.depth);
-	for (int i=0; i<4; i++)
+	vector3d vecs[4][4];
+	GetKidCorners(vecs);
+
+	for (int i=mFirstKid; i<mFirstKid+mNumKids; i++)
 	{
-		if(s_abort) {
-			delete sr;
+		if(s_abort || IsCancelled())
 			return;
-		}
 
 		// fill out the data
-		GenerateMesh(srd.heights[i], srd.normals[i], srd.colors[i], srd.borderHeights[i].Get(), srd.borderVertexs[i].Get(),
-			vecs[i][0], vecs[i][1], vecs[i][2], vecs[i][3], 
-			srd.edgeLen, srd.fracStep, srd.pTerrain.Get());
-		// add this patches data
-		sr->addResult(i, srd.heights[i], srd.normals[i], srd.colors[i], 
-			vecs[i][0], vecs[i][1], vecs[i][2], vecs[i][3], 
-			srd.patchID.NextPatchID(srd.depth+1, i));
+		GenerateCachedMesh(srd, srd.patchID.NextPatchID(srd.depth+1, i), srd.depth+1,
+			srd.heights[i], srd.normals[i], srd.colors[i], srd.borderHeights[i], srd.borderVertexs[i],
+			vecs[i][0], vecs[i][1], vecs[i][2], vecs[i][3]);
 	}
-	mpResults = sr;
 }
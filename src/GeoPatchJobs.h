@@ -11,6 +11,7 @@
 #include "galaxy/StarSystem.h"
 #include "terrain/Terrain.h"
 #include "GeoPatchID.h"
+#include "GeoPatchContext.h"
 #include "JobQueue.h"
 
 class GeoSphere;
@@ -18,11 +19,11 @@ class GeoSphere;
 class SBaseRequest {
 public:
 	SBaseRequest(const vector3d &v0_, const vector3d &v1_, const vector3d &v2_, const vector3d &v3_, const vector3d &cn,
-		const uint32_t depth_, const SystemPath &sysPath_, const GeoPatchID &patchID_, const int edgeLen_, const double fracStep_,
-		Terrain *pTerrain_)
+		const uint32_t depth_, const SystemPath &sysPath_, const GeoPatchID &patchID_, const RefCountedPtr<GeoPatchContext> &ctx_,
+		const std::string &cacheDir_, Terrain *pTerrain_)
 		: v0(v0_), v1(v1_), v2(v2_), v3(v3_), centroid(cn), depth(depth_), 
-		sysPath(sysPath_), patchID(patchID_), edgeLen(edgeLen_), fracStep(fracStep_), 
-		pTerrain(pTerrain_)
+		sysPath(sysPath_), patchID(patchID_), ctx(ctx_), edgeLen(ctx_->edgeLen), fracStep(ctx_->frac), 
+		cacheDir(cacheDir_), pTerrain(pTerrain_)
 	{
 	}
 
@@ -34,8 +35,12 @@ public:
 	const uint32_t depth;
 	const SystemPath sysPath;
 	const GeoPatchID patchID;
+	// the buffers come from (and go back to) the context's pools
+	const RefCountedPtr<GeoPatchContext> ctx;
 	const int edgeLen;
 	const double fracStep;
+	// where generated meshes are cached on disk, empty if they aren't
+	const std::string cacheDir;
 	ScopedPtr<Terrain> pTerrain;
 
 protected:
@@ -47,31 +52,43 @@ protected:
 class SQuadSplitRequest : public SBaseRequest {
 public:
 	SQuadSplitRequest(const vector3d &v0_, const vector3d &v1_, const vector3d &v2_, const vector3d &v3_, const vector3d &cn,
-		const uint32_t depth_, const SystemPath &sysPath_, const GeoPatchID &patchID_, const int edgeLen_, const double fracStep_,
-		Terrain *pTerrain_)
-		: SBaseRequest(v0_, v1_, v2_, v3_, cn, depth_, sysPath_, patchID_, edgeLen_, fracStep_, pTerrain_)
+		const uint32_t depth_, const SystemPath &sysPath_, const GeoPatchID &patchID_, const RefCountedPtr<GeoPatchContext> &ctx_,
+		const std::string &cacheDir_, Terrain *pTerrain_)
+		: SBaseRequest(v0_, v1_, v2_, v3_, cn, depth_, sysPath_, patchID_, ctx_, cacheDir_, pTerrain_)
 	{
-		const int numVerts = NUMVERTICES(edgeLen_);
-		const int numBorderedVerts = NUMVERTICES(edgeLen_+2);
 		for( int i=0 ; i<4 ; ++i )
 		{
-			heights[i] = new double[numVerts];
-			normals[i] = new vector3f[numVerts];
-			colors[i] = new Color3ub[numVerts];
+			heights[i] = ctx->heightsPool.Alloc();
+			normals[i] = ctx->normalsPool.Alloc();
+			colors[i] = ctx->colorsPool.Alloc();
 
-			borderHeights[i].Reset(new double[numBorderedVerts]);
-			borderVertexs[i].Reset(new vector3d[numBorderedVerts]);
+			borderHeights[i] = ctx->borderHeightsPool.Alloc();
+			borderVertexs[i] = ctx->borderVertexsPool.Alloc();
 		}
 	}
 
-	// these are created with the request and are given to the resulting patches
+	~SQuadSplitRequest()
+	{
+		for( int i=0 ; i<4 ; ++i )
+		{
+			ctx->heightsPool.Free(heights[i]);
+			ctx->normalsPool.Free(normals[i]);
+			ctx->colorsPool.Free(colors[i]);
+
+			ctx->borderHeightsPool.Free(borderHeights[i]);
+			ctx->borderVertexsPool.Free(borderVertexs[i]);
+		}
+	}
+
+	// these are created with the request and are given to the resulting
+	// patches. they're set to NULL once handed over
 	vector3f *normals[4];
 	Color3ub *colors[4];
 	double *heights[4];
 
 	// these are created with the request but are destroyed when the request is finished
-	ScopedPtr<double> borderHeights[4];
-	ScopedPtr<vector3d> borderVertexs[4];
+	double *borderHeights[4];
+	vector3d *borderVertexs[4];
 
 protected:
 	// deliberately prevent copy constructor access
@@ -81,28 +98,37 @@ protected:
 class SSingleSplitRequest : public SBaseRequest {
 public:
 	SSingleSplitRequest(const vector3d &v0_, const vector3d &v1_, const vector3d &v2_, const vector3d &v3_, const vector3d &cn,
-		const uint32_t depth_, const SystemPath &sysPath_, const GeoPatchID &patchID_, const int edgeLen_, const double fracStep_,
-		Terrain *pTerrain_)
-		: SBaseRequest(v0_, v1_, v2_, v3_, cn, depth_, sysPath_, patchID_, edgeLen_, fracStep_, pTerrain_)
+		const uint32_t depth_, const SystemPath &sysPath_, const GeoPatchID &patchID_, const RefCountedPtr<GeoPatchContext> &ctx_,
+		const std::string &cacheDir_, Terrain *pTerrain_)
+		: SBaseRequest(v0_, v1_, v2_, v3_, cn, depth_, sysPath_, patchID_, ctx_, cacheDir_, pTerrain_)
 	{
-		const int numVerts = NUMVERTICES(edgeLen_);
-		heights = new double[numVerts];
-		normals = new vector3f[numVerts];
-		colors = new Color3ub[numVerts];
+		heights = ctx->heightsPool.Alloc();
+		normals = ctx->normalsPool.Alloc();
+		colors = ctx->colorsPool.Alloc();
 		
-		const int numBorderedVerts = NUMVERTICES(edgeLen_+2);
-		borderHeights.Reset(new double[numBorderedVerts]);
-		borderVertexs.Reset(new vector3d[numBorderedVerts]);
+		borderHeights = ctx->borderHeightsPool.Alloc();
+		borderVertexs = ctx->borderVertexsPool.Alloc();
+	}
+
+	~SSingleSplitRequest()
+	{
+		ctx->heightsPool.Free(heights);
+		ctx->normalsPool.Free(normals);
+		ctx->colorsPool.Free(colors);
+
+		ctx->borderHeightsPool.Free(borderHeights);
+		ctx->borderVertexsPool.Free(borderVertexs);
 	}
 
-	// these are created with the request and are given to the resulting patches
+	// these are created with the request and are given to the resulting
+	// patches. they're set to NULL once handed over
 	vector3f *normals;
 	Color3ub *colors;
 	double *heights;
 
 	// these are created with the request but are destroyed when the request is finished
-	ScopedPtr<double> borderHeights;
-	ScopedPtr<vector3d> borderVertexs;
+	double *borderHeights;
+	vector3d *borderVertexs;
 
 protected:
 	// deliberately prevent copy constructor access
@@ -112,12 +138,12 @@ protected:
 class SBaseSplitResult {
 public:
 	struct SSplitResultData {
-		SSplitResultData() : patchID(0) {}
+		SSplitResultData() : heights(NULL), normals(NULL), colors(NULL), patchID(0) {}
 		SSplitResultData(double *heights_, vector3f *n_, Color3ub *c_, const vector3d &v0_, const vector3d &v1_, const vector3d &v2_, const vector3d &v3_, const GeoPatchID &patchID_) :
 			heights(heights_), normals(n_), colors(c_), v0(v0_), v1(v1_), v2(v2_), v3(v3_), patchID(patchID_)
 		{}
 		SSplitResultData(const SSplitResultData &r) : 
-			normals(r.normals), colors(r.colors), v0(r.v0), v1(r.v1), v2(r.v2), v3(r.v3), patchID(r.patchID)
+			heights(r.heights), normals(r.normals), colors(r.colors), v0(r.v0), v1(r.v1), v2(r.v2), v3(r.v3), patchID(r.patchID)
 		{}
 
 		double *heights;
@@ -127,7 +153,7 @@ public:
 		GeoPatchID patchID;
 	};
 
-	SBaseSplitResult(const int32_t face_, const int32_t depth_) : mFace(face_), mDepth(depth_) {}
+	SBaseSplitResult(const int32_t face_, const int32_t depth_, const RefCountedPtr<GeoPatchContext> &ctx_) : mFace(face_), mDepth(depth_), mCtx(ctx_) {}
 	virtual ~SBaseSplitResult() {}
 
 	inline int32_t face() const { return mFace; }
@@ -139,14 +165,22 @@ protected:
 	// deliberately prevent copy constructor access
 	SBaseSplitResult(const SBaseSplitResult &r) : mFace(0), mDepth(0) {}
 
+	// return a result's buffers to the pools they came from
+	void FreeData(SSplitResultData &data) {
+		mCtx->heightsPool.Free(data.heights);		data.heights = NULL;
+		mCtx->normalsPool.Free(data.normals);		data.normals = NULL;
+		mCtx->colorsPool.Free(data.colors);		data.colors = NULL;
+	}
+
 	const int32_t mFace;
 	const int32_t mDepth;
+	const RefCountedPtr<GeoPatchContext> mCtx;
 };
 
 class SQuadSplitResult : public SBaseSplitResult {
 	static const int NUM_RESULT_DATA = 4;
 public:
-	SQuadSplitResult(const int32_t face_, const int32_t depth_) : SBaseSplitResult(face_, depth_)
+	SQuadSplitResult(const int32_t face_, const int32_t depth_, const RefCountedPtr<GeoPatchContext> &ctx_) : SBaseSplitResult(face_, depth_, ctx_)
 	{
 	}
 
@@ -161,9 +195,7 @@ public:
 	virtual void OnCancel()
 	{
 		for( int i=0; i<NUM_RESULT_DATA; ++i ) {
-			if( mData[i].heights ) {delete [] mData[i].heights;		mData[i].heights = NULL;}
-			if( mData[i].normals ) {delete [] mData[i].normals;		mData[i].normals = NULL;}
-			if( mData[i].colors ) {delete [] mData[i].colors;		mData[i].colors = NULL;}
+			FreeData(mData[i]);
 		}
 	}
 
@@ -176,7 +208,7 @@ protected:
 
 class SSingleSplitResult : public SBaseSplitResult {
 public:
-	SSingleSplitResult(const int32_t face_, const int32_t depth_) : SBaseSplitResult(face_, depth_)
+	SSingleSplitResult(const int32_t face_, const int32_t depth_, const RefCountedPtr<GeoPatchContext> &ctx_) : SBaseSplitResult(face_, depth_, ctx_)
 	{
 	}
 
@@ -189,11 +221,7 @@ public:
 
 	virtual void OnCancel()
 	{
-		{
-			if( mData.heights ) {delete [] mData.heights;	mData.heights = NULL;}
-			if( mData.normals ) {delete [] mData.normals;	mData.normals = NULL;}
-			if( mData.colors ) {delete [] mData.colors;		mData.colors = NULL;}
-		}
+		FreeData(mData);
 	}
 
 protected:
@@ -230,6 +258,10 @@ public:
 		--s_numActivePatchJobs;
 	}
 
+	// patches that are closer to the camera, and deeper in the tree, are more
+	// urgent. all positions are relative to a unit sphere
+	static float CalcPriority(const vector3d &centroid, const uint32_t depth, const vector3d &campos);
+
 	static uint32_t GetNumActivePatchJobs() { return s_numActivePatchJobs; };
 	static void CancelAllPatchJobs() { s_abort = true; }
 	static void ResetPatchJobCancel() { s_abort = false; }
@@ -245,6 +277,12 @@ protected:
 		const vector3d &v0, const vector3d &v1, const vector3d &v2, const vector3d &v3,
 		const int edgeLen, const double fracStep, const Terrain *pTerrain) const;
 
+	// as GenerateMesh, but loads the patch from the disk cache instead if
+	// it's there, and adds it to the cache if it isn't
+	void GenerateCachedMesh(const SBaseRequest &req, const uint64_t patchID, const int depth,
+		double *heights, vector3f *normals, Color3ub *colors, double *borderHeights, vector3d *borderVertexs,
+		const vector3d &v0, const vector3d &v1, const vector3d &v2, const vector3d &v3) const;
+
 	static uint32_t s_numActivePatchJobs;
 	static bool s_abort;
 };
@@ -255,15 +293,26 @@ protected:
 class SinglePatchJob : public BasePatchJob
 {
 public:
-	SinglePatchJob(SSingleSplitRequest *data) : BasePatchJob(), mData(data), mpResults(NULL)	{ /* empty */ }
+	// nothing can be drawn until the first patches are in, so they go first
+	SinglePatchJob(SSingleSplitRequest *data) : BasePatchJob(), mData(data)	{ SetPriority(PRIORITY_HIGH); }
 
 	virtual void OnRun();      // RUNS IN ANOTHER THREAD!! MUST BE THREAD SAFE!
 	virtual void OnFinish();   // runs in primary thread of the context
 	virtual void OnCancel();   // runs in primary thread of the context
+	virtual const char *GetName() const { return "SinglePatchJob"; }
 
 private:
 	ScopedPtr<SSingleSplitRequest> mData;
-	SSingleSplitResult *mpResults;
+};
+
+// a quad split request shared by the jobs generating its kids. each kid
+// writes only its own buffers, so they can run on different runners at once
+class SQuadSplitTask : public RefCounted {
+public:
+	SQuadSplitTask(SQuadSplitRequest *request_) : request(request_), numKidsDone(0) {}
+
+	ScopedPtr<SQuadSplitRequest> request;
+	int numKidsDone; // only touched from OnFinish, in the primary thread
 };
 
 // ********************************************************************************
@@ -272,15 +321,31 @@ private:
 class QuadPatchJob : public BasePatchJob
 {
 public:
-	QuadPatchJob(SQuadSplitRequest *data) : BasePatchJob(), mData(data), mpResults(NULL) { /* empty */ }
+	// generates numKids kids of the split, starting at firstKid. the one that
+	// completes the set hands the result over
+	QuadPatchJob(const RefCountedPtr<SQuadSplitTask> &task, const int firstKid, const int numKids, const vector3d &campos) :
+		BasePatchJob(), mTask(task), mFirstKid(firstKid), mNumKids(numKids) {
+		SetPriority(CalcPriority(task->request->centroid, task->request->depth, campos));
+	}
+
+	// queue the jobs for a split. with runners standing idle each kid gets a
+	// job of its own, so the split under the camera isn't left to one runner.
+	// otherwise one job does all four and the rest are free for other splits
+	static void QueueSplit(SQuadSplitRequest *data, const vector3d &campos, const Uint32 group);
 
 	virtual void OnRun();      // RUNS IN ANOTHER THREAD!! MUST BE THREAD SAFE!
 	virtual void OnFinish();   // runs in primary thread of the context
 	virtual void OnCancel();   // runs in primary thread of the context
+	virtual bool UpdatePriority();   // runs in primary thread of the context
+	virtual const char *GetName() const { return "QuadPatchJob"; }
 
 private:
-	ScopedPtr<SQuadSplitRequest> mData;
-	SQuadSplitResult *mpResults;
+	// the corners of the four kid patches
+	void GetKidCorners(vector3d (&vecs)[4][4]) const;
+
+	RefCountedPtr<SQuadSplitTask> mTask;
+	const int mFirstKid;
+	const int mNumKids;
 };
 
 #endif /* _GEOPATCHJOBS_H */
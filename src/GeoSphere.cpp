@@ -6,11 +6,16 @@
 #include "GeoPatchContext.h"
 #include "GeoPatch.h"
 #include "GeoPatchJobs.h"
+#include "GeoPatchCache.h"
+#include "FrameProfiler.h"
+#include "Profiler.h"
+#include "OS.h"
 #include "perlin.h"
 #include "Pi.h"
 #include "RefCounted.h"
 #include "graphics/Material.h"
 #include "graphics/Renderer.h"
+#include "graphics/Drawables.h"
 #include "graphics/Frustum.h"
 #include "graphics/Graphics.h"
 #include "graphics/VertexArray.h"
@@ -20,6 +25,7 @@
 #include <algorithm>
 
 int GeoSphere::s_vtxGenCount = 0;
+int GeoSphere::s_updateBudget = 0;
 RefCountedPtr<GeoPatchContext> GeoSphere::s_patchContext;
 
 // must be odd numbers
@@ -40,9 +46,27 @@ static const int geo_sphere_edge_friends[NUM_PATCHES][4] = {
 
 static std::vector<GeoSphere*> s_allGeospheres;
 
+static GeoPatchContext::VertexFormat GetPatchVertexFormat()
+{
+	switch (Pi::config->Int("TerrainCompactVertices")) {
+		case 0: return GeoPatchContext::VERTEX_FORMAT_FULL;
+		case 1: return GeoPatchContext::VERTEX_FORMAT_COMPACT;
+		// the packed normals need the terrain shader to unpack them
+		default: return Graphics::AreShadersEnabled() ? GeoPatchContext::VERTEX_FORMAT_PACKED : GeoPatchContext::VERTEX_FORMAT_COMPACT;
+	}
+}
+
+static bool GetPatchGeomorph()
+{
+	// the morphing is done by the terrain shader
+	return Pi::config->Int("TerrainGeomorph") && Graphics::AreShadersEnabled();
+}
+
 void GeoSphere::Init()
 {
-	s_patchContext.Reset(new GeoPatchContext(detail_edgeLen[Pi::detail.planets > 4 ? 4 : Pi::detail.planets]));
+	// every detail level's index buffers, so changing it doesn't stall
+	GeoPatchContext::InitIndexLists(detail_edgeLen, COUNTOF(detail_edgeLen));
+	s_patchContext.Reset(new GeoPatchContext(detail_edgeLen[Pi::detail.planets > 4 ? 4 : Pi::detail.planets], GetPatchVertexFormat(), GetPatchGeomorph()));
 	assert(s_patchContext->edgeLen <= GEOPATCH_MAX_EDGELEN);
 }
 
@@ -50,6 +74,7 @@ void GeoSphere::Uninit()
 {
 	assert (s_patchContext.Unique());
 	s_patchContext.Reset();
+	GeoPatchContext::UninitIndexLists();
 }
 
 static void print_info(const SystemBody *sbody, const Terrain *terrain)
@@ -62,13 +87,63 @@ static void print_info(const SystemBody *sbody, const Terrain *terrain)
 		sbody->name.c_str(), terrain->GetHeightFractalName(), terrain->GetColorFractalName(), sbody->seed);
 }
 
+// spheres smaller than this on screen (radius in pixels) can't show any
+// detail worth splitting for, and only get updated every FAR_UPDATE_FRAMES
+static const double FAR_PIXEL_RADIUS = 8.0;
+static const Uint32 FAR_UPDATE_FRAMES = 30;
+
+double GeoSphere::GetScreenRadius() const
+{
+	if (!m_hasTempCampos) return 0.0;
+	// inside the sphere's radius, it fills the view
+	const double dist = std::max(m_tempCampos.Length(), 1.0);
+	return m_tempPixelScale / dist;
+}
+
 // static
 void GeoSphere::UpdateAllGeoSpheres()
 {
+	PROFILE_ZONE("GeoSphere::UpdateAllGeoSpheres");
+
+	// the biggest on screen first, scaled up by how long they've waited so
+	// the small ones still get their turn
+	std::vector<std::pair<double, GeoSphere*> > queue;
+	queue.reserve(s_allGeospheres.size());
 	for(std::vector<GeoSphere*>::iterator i = s_allGeospheres.begin(); i != s_allGeospheres.end(); ++i)
 	{
-		(*i)->Update();
+		GeoSphere *g = *i;
+		g->m_framesSinceUpdate++;
+
+		// the first patches are wanted before anything can be drawn, and
+		// split results mustn't back up past MAX_SPLIT_OPERATIONS
+		const bool urgent = g->m_initStage != eDefaultUpdateState ||
+			std::max(g->mQuadSplitResults.size(), g->mSingleSplitResults.size()) >= MAX_SPLIT_OPERATIONS/2;
+		if (urgent) {
+			g->Update();
+			g->m_framesSinceUpdate = 0;
+			continue;
+		}
+		// nothing to do until it's been rendered
+		if (!g->m_hasTempCampos) continue;
+
+		const double radius = g->GetScreenRadius();
+		if (radius < FAR_PIXEL_RADIUS && g->m_framesSinceUpdate < FAR_UPDATE_FRAMES) continue;
+		queue.push_back(std::make_pair(std::max(radius, 1.0) * g->m_framesSinceUpdate, g));
 	}
+	std::sort(queue.begin(), queue.end(), IsHigherUpdatePriority);
+
+	const Uint64 budgetTicks = s_updateBudget ? Uint64(s_updateBudget) * OS::HFTimerFreq() / 1000000 : 0;
+	const Uint64 start = OS::HFTimer();
+	for (size_t i = 0; i < queue.size(); i++) {
+		// the first always runs, however long it takes
+		if (budgetTicks && i > 0 && OS::HFTimer() - start > budgetTicks) break;
+		queue[i].second->Update();
+		queue[i].second->m_framesSinceUpdate = 0;
+	}
+
+	// the camera has probably moved, so patches still waiting to be split
+	// need to be reordered by their new distance from it
+	Pi::Jobs()->UpdatePriorities();
 }
 
 // static
@@ -88,7 +163,7 @@ void GeoSphere::OnChangeDetailLevel()
 	BasePatchJob::ResetPatchJobCancel();
 #endif
 
-	s_patchContext.Reset(new GeoPatchContext(detail_edgeLen[Pi::detail.planets > 4 ? 4 : Pi::detail.planets]));
+	s_patchContext.Reset(new GeoPatchContext(detail_edgeLen[Pi::detail.planets > 4 ? 4 : Pi::detail.planets], GetPatchVertexFormat(), GetPatchGeomorph()));
 	assert(s_patchContext->edgeLen <= GEOPATCH_MAX_EDGELEN);
 
 	// reinit the geosphere terrain data
@@ -99,6 +174,8 @@ void GeoSphere::OnChangeDetailLevel()
 
 		// reinit the terrain with the new settings
 		(*i)->m_terrain.Reset(Terrain::InstanceTerrain((*i)->m_sbody));
+		(*i)->m_heightCache->Clear();
+		(*i)->m_cacheDir = GeoPatchCache::GetDirectory((*i)->m_sbody, s_patchContext->edgeLen);
 		print_info((*i)->m_sbody, (*i)->m_terrain.Get());
 	}
 }
@@ -139,8 +216,25 @@ bool GeoSphere::OnAddSingleSplitResult(const SystemPath &path, SSingleSplitResul
 	return false;
 }
 
+//static
+bool GeoSphere::GetLastCameraPosition(const SystemPath &path, vector3d &campos)
+{
+	for(std::vector<GeoSphere*>::iterator i=s_allGeospheres.begin(), iEnd=s_allGeospheres.end(); i!=iEnd; ++i) {
+		if( path == (*i)->m_sbody->path ) {
+			if( !(*i)->m_hasTempCampos )
+				return false;
+			campos = (*i)->m_tempCampos;
+			return true;
+		}
+	}
+	return false;
+}
+
 void GeoSphere::Reset()
 {
+	// nothing that's in flight is wanted any more
+	Pi::Jobs()->CancelGroup(m_jobGroup);
+
 	{
 		std::deque<SSingleSplitResult*>::iterator iter = mSingleSplitResults.begin();
 		while(iter!=mSingleSplitResults.end())
@@ -190,12 +284,29 @@ void GeoSphere::Reset()
 #define GEOSPHERE_TYPE	(m_sbody->type)
 
 GeoSphere::GeoSphere(const SystemBody *body) : m_sbody(body), m_terrain(Terrain::InstanceTerrain(body)),
-	m_hasTempCampos(false), m_tempCampos(0.0), mCurrentNumPatches(0), mCurrentMemAllocatedToPatches(0), m_initStage(eBuildFirstPatches)
+	m_heightCache(new TerrainHeightCache(this, body->GetRadius())),
+	m_jobGroup(Pi::Jobs()->NewGroup()), m_cacheDir(GeoPatchCache::GetDirectory(body, s_patchContext->edgeLen)), m_hasTempCampos(false), m_tempCampos(0.0), m_tempPixelScale(0.0), m_framesSinceUpdate(0), mCurrentNumPatches(0), mCurrentMemAllocatedToPatches(0), m_initStage(eBuildFirstPatches)
 {
 	print_info(body, m_terrain.Get());
 
 	s_allGeospheres.push_back(this);
 
+	// the root patches are made while the rest of the system is being set
+	// up, so they're usually in by the time anything is drawn
+	BuildFirstPatches();
+
+	// until then the planet is a plain sphere in roughly the right colour
+	static const vector3d faces[6] = {
+		vector3d( 1.0, 0.0, 0.0), vector3d(-1.0, 0.0, 0.0),
+		vector3d( 0.0, 1.0, 0.0), vector3d( 0.0,-1.0, 0.0),
+		vector3d( 0.0, 0.0, 1.0), vector3d( 0.0, 0.0,-1.0)
+	};
+	vector3d col(0.0);
+	for (int i=0; i<6; i++)
+		col += m_terrain->GetColor(faces[i], m_terrain->GetHeight(faces[i]), faces[i]);
+	col *= 1.0/6.0;
+	m_coarseColor = Color(float(col.x), float(col.y), float(col.z), 1.0f);
+
 	//SetUpMaterials is not called until first Render since light count is zero :)
 }
 
@@ -215,6 +326,9 @@ GeoSphere::~GeoSphere()
 	BasePatchJob::ResetPatchJobCancel();
 #endif
 
+	// our results aren't wanted by anyone now
+	Pi::Jobs()->CancelGroup(m_jobGroup);
+
 	// update thread should not be able to access us now, so we can safely continue to delete
 	assert(std::count(s_allGeospheres.begin(), s_allGeospheres.end(), this) == 1);
 	s_allGeospheres.erase(std::find(s_allGeospheres.begin(), s_allGeospheres.end(), this));
@@ -293,6 +407,49 @@ void GeoSphere::ProcessSplitResults()
 	}
 }
 
+double GeoSphere::GetCachedHeight(const vector3d &p)
+{
+	double height;
+	if (GetPatchHeight(p, m_heightCache->GetTolerance(), height))
+		return height;
+	return m_heightCache->GetHeight(p);
+}
+
+double GeoSphere::GetHeight(const vector3d &p, double tolerance) const
+{
+	double height;
+	if (GetPatchHeight(p, tolerance, height))
+		return height;
+	return GetHeight(p);
+}
+
+bool GeoSphere::GetPatchHeight(const vector3d &p, double tolerance, double &height) const
+{
+	// down from the root patch p is in to the first one that's precise
+	// enough. kids always arrive with their heights, but the roots may not
+	// have theirs yet
+	const GeoPatch *patch = 0;
+	for (int i=0; i<NUM_PATCHES && !patch; i++) {
+		if (m_patches[i].Valid() && m_patches[i]->heights && m_patches[i]->Contains(p))
+			patch = m_patches[i].Get();
+	}
+	while (patch) {
+		if (patch->m_geometricError <= tolerance) {
+			height = patch->GetMeshHeight(p);
+			return true;
+		}
+		if (!patch->kids[0].Valid())
+			break;
+		const GeoPatch *next = 0;
+		for (int i=0; i<GeoPatch::NUM_KIDS && !next; i++) {
+			if (patch->kids[i]->Contains(p))
+				next = patch->kids[i].Get();
+		}
+		patch = next;
+	}
+	return false;
+}
+
 void GeoSphere::BuildFirstPatches()
 {
 	assert(!m_patches[0].Valid());
@@ -397,7 +554,7 @@ void GeoSphere::Update()
 			ProcessSplitResults();
 			uint8_t numValidPatches = 0;
 			for (int i=0; i<NUM_PATCHES; i++) {
-				if(m_patches[i]->heights.Valid()) {
+				if(m_patches[i]->heights) {
 					++numValidPatches;
 				}
 			}
@@ -408,6 +565,7 @@ void GeoSphere::Update()
 			for (int i=0; i<NUM_PATCHES; i++) {
 				m_patches[i]->UpdateVBOs();
 			}
+			m_coarseSphere.Reset();
 			m_initStage = eDefaultUpdateState;
 		} break;
 	case eDefaultUpdateState:
@@ -423,18 +581,43 @@ void GeoSphere::Update()
 
 void GeoSphere::Render(Graphics::Renderer *renderer, const matrix4x4d &modelView, vector3d campos, const float radius, const float scale, const std::vector<Camera::Shadow> &shadows)
 {
+	FrameProfiler::ScopedPass pass(FrameProfiler::PASS_TERRAIN);
+
 	// store this for later usage in the update method.
 	m_tempCampos = campos;
 	m_hasTempCampos = true;
 
-	if(m_initStage < eDefaultUpdateState)
+	if(m_initStage < eDefaultUpdateState) {
+		if (!m_coarseSphere.Valid()) {
+			Graphics::MaterialDescriptor desc;
+			desc.lighting = true;
+			RefCountedPtr<Graphics::Material> mat(renderer->CreateMaterial(desc));
+			mat->diffuse = m_coarseColor;
+			m_coarseSphere.Reset(new Graphics::Drawables::Sphere3D(mat, 2));
+		}
+		matrix4x4d trans = modelView;
+		trans.Translate(-campos.x, -campos.y, -campos.z);
+		renderer->SetTransform(trans);
+		m_coarseSphere->Draw(renderer);
 		return;
+	}
 
 	matrix4x4d trans = modelView;
 	trans.Translate(-campos.x, -campos.y, -campos.z);
-	renderer->SetTransform(trans); //need to set this for the following line to work
+	// the patches are tested in floats, so the frustum is kept around the
+	// camera, not the planet's centre
+	renderer->SetTransform(modelView); //need to set this for the following line to work
 	Graphics::Frustum frustum = Graphics::Frustum::FromGLState();
 
+	// and this, for the screen-space error test when splitting patches
+	{
+		GLdouble proj[16];
+		GLint viewport[4];
+		glGetDoublev(GL_PROJECTION_MATRIX, proj);
+		glGetIntegerv(GL_VIEWPORT, viewport);
+		m_tempPixelScale = 0.5 * double(viewport[3]) * proj[5];
+	}
+
 	// no frustum test of entire geosphere, since Space::Render does this
 	// for each body using its GetBoundingRadius() value
 
@@ -506,17 +689,44 @@ void GeoSphere::Render(Graphics::Renderer *renderer, const matrix4x4d &modelView
 
 	renderer->SetTransform(modelView);
 
+	const bool normalArray = (s_patchContext->vertexFormat != GeoPatchContext::VERTEX_FORMAT_PACKED);
 	glEnableClientState(GL_VERTEX_ARRAY);
-	glEnableClientState(GL_NORMAL_ARRAY);
+	if (normalArray) glEnableClientState(GL_NORMAL_ARRAY);
 	glEnableClientState(GL_COLOR_ARRAY);
+	if (s_patchContext->geomorph) {
+		glClientActiveTextureARB(GL_TEXTURE0);
+		glEnableClientState(GL_TEXTURE_COORD_ARRAY);
+	}
 
+	m_renderPatches.clear();
 	for (int i=0; i<NUM_PATCHES; i++) {
-		m_patches[i]->Render(renderer, campos, modelView, frustum);
+		m_patches[i]->GatherLeaves(m_renderPatches);
+	}
+
+	m_cullSpheres.Clear();
+	for (std::vector<GeoPatch*>::const_iterator i = m_renderPatches.begin(); i != m_renderPatches.end(); ++i) {
+		m_cullSpheres.Add((*i)->clipCentroid - campos, (*i)->clipRadius);
+	}
+	frustum.TestSpheres(m_cullSpheres, m_cullVisible);
+
+	// modelView has no translation, so it's fine as floats. each patch
+	// adds its own offset from the camera
+	matrix4x4f modelViewf;
+	for (int i=0; i<16; i++) modelViewf[i] = float(modelView[i]);
+
+	// the patches bind their arena buffers as they go
+	s_patchContext->boundVBO = 0;
+	for (Uint32 i = 0; i < m_renderPatches.size(); i++) {
+		if (m_cullVisible[i])
+			m_renderPatches[i]->Render(renderer, campos, modelViewf);
 	}
+	s_patchContext->boundVBO = 0;
 
 	glDisableClientState(GL_VERTEX_ARRAY);
-	glDisableClientState(GL_NORMAL_ARRAY);
+	if (normalArray) glDisableClientState(GL_NORMAL_ARRAY);
 	glDisableClientState(GL_COLOR_ARRAY);
+	if (s_patchContext->geomorph)
+		glDisableClientState(GL_TEXTURE_COORD_ARRAY);
 
 	glBindBufferARB(GL_ARRAY_BUFFER_ARB, 0);
 	glBindBufferARB(GL_ELEMENT_ARRAY_BUFFER, 0);
@@ -558,6 +768,8 @@ void GeoSphere::SetUpMaterials()
 		surfDesc.lighting = true;
 		surfDesc.atmosphere = (ap.atmosDensity > 0.0);
 	}
+	surfDesc.packedNormals = (s_patchContext->vertexFormat == GeoPatchContext::VERTEX_FORMAT_PACKED);
+	surfDesc.geomorph = s_patchContext->geomorph;
 	m_surfaceMaterial.Reset(Pi::renderer->CreateMaterial(surfDesc));
 
 	//Shader-less atmosphere is drawn in Planet
@@ -13,10 +13,12 @@
 #include "graphics/Material.h"
 #include "terrain/Terrain.h"
 #include "GeoPatchID.h"
+#include "TerrainHeightCache.h"
 
 #include <deque>
+#include <algorithm>
 
-namespace Graphics { class Renderer; }
+namespace Graphics { class Renderer; namespace Drawables { class Sphere3D; } }
 class SystemBody;
 class GeoPatch;
 class GeoPatchContext;
@@ -50,13 +52,29 @@ public:
 #endif /* DEBUG */
 		return h;
 	}
+	// like GetHeight but served from a cache of nearby samples, which is
+	// much cheaper for repeated queries close to each other (a body sitting
+	// on or moving over the ground). within a fraction of a metre of the
+	// real height. main thread only
+	double GetCachedHeight(const vector3d &p);
+	// like GetHeight, but read off the mesh of a patch that's already been
+	// generated where one is within tolerance (in planet radii) of the real
+	// terrain. main thread only
+	double GetHeight(const vector3d &p, double tolerance) const;
 	friend class GeoPatch;
 	static void Init();
 	static void Uninit();
+	// once a frame. the spheres biggest on screen go first, within the
+	// budget (microseconds, 0 for no limit) after the first. spheres only
+	// a few pixels across are updated every so often
 	static void UpdateAllGeoSpheres();
+	static void SetUpdateBudget(int usecs) { s_updateBudget = std::max(usecs, 0); }
 	static void OnChangeDetailLevel();
 	static bool OnAddQuadSplitResult(const SystemPath &path, SQuadSplitResult *res);
 	static bool OnAddSingleSplitResult(const SystemPath &path, SSingleSplitResult *res);
+	// the camera position (in sbody radii) the GeoSphere was last rendered
+	// from. returns false if there isn't one yet
+	static bool GetLastCameraPosition(const SystemPath &path, vector3d &campos);
 	// in sbody radii
 	double GetMaxFeatureHeight() const { return m_terrain->GetMaxHeight(); }
 	static int GetVtxGenCount() { return s_vtxGenCount; }
@@ -73,20 +91,50 @@ public:
 
 	void Reset();
 
+	// all the patch jobs for this GeoSphere are queued in this group, so they
+	// can be cancelled together
+	Uint32 GetJobGroup() const { return m_jobGroup; }
+
 private:
 	void BuildFirstPatches();
+	// false if no patch covering p has heights that precise yet
+	bool GetPatchHeight(const vector3d &p, double tolerance, double &height) const;
 	ScopedPtr<GeoPatch> m_patches[6];
 	const SystemBody *m_sbody;
 
 	// all variables for GetHeight(), GetColor()
 	ScopedPtr<Terrain> m_terrain;
 
+	ScopedPtr<TerrainHeightCache> m_heightCache;
+
 	static const uint32_t MAX_SPLIT_OPERATIONS = 128;
 	std::deque<SQuadSplitResult*> mQuadSplitResults;
 	std::deque<SSingleSplitResult*> mSingleSplitResults;
 
+	Uint32 m_jobGroup;
+
+	// where this body's patches are cached on disk, empty if they aren't
+	std::string m_cacheDir;
+
 	bool m_hasTempCampos;
 	vector3d m_tempCampos;
+	// pixels covered by something one unit across at one unit away, for the
+	// last view rendered. zero until then
+	double m_tempPixelScale;
+	// UpdateAllGeoSpheres calls since Update last ran
+	Uint32 m_framesSinceUpdate;
+
+	// roughly, the sphere's radius on screen from the last view rendered
+	double GetScreenRadius() const;
+	static bool IsHigherUpdatePriority(const std::pair<double, GeoSphere*> &a, const std::pair<double, GeoSphere*> &b) {
+		return a.first > b.first;
+	}
+
+	// the leaf patches and their bounds, to frustum test them together.
+	// kept to reuse the memory
+	std::vector<GeoPatch*> m_renderPatches;
+	Graphics::SphereBatch m_cullSpheres;
+	std::vector<Uint8> m_cullVisible;
 
 	uint32_t mCurrentNumPatches;
 	uint64_t mCurrentMemAllocatedToPatches;
@@ -96,12 +144,16 @@ private:
 	}
 
 	static int s_vtxGenCount;
+	static int s_updateBudget;
 
 	static RefCountedPtr<GeoPatchContext> s_patchContext;
 
 	void SetUpMaterials();
 	ScopedPtr<Graphics::Material> m_surfaceMaterial;
 	ScopedPtr<Graphics::Material> m_atmosphereMaterial;
+	// drawn in the surface's average colour until the first patches arrive
+	ScopedPtr<Graphics::Drawables::Sphere3D> m_coarseSphere;
+	Color m_coarseColor;
 	//special parameters for shaders
 	MaterialParameters m_materialParameters;
 
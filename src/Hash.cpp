@@ -0,0 +1,46 @@
+// Copyright © 2008-2013 Pioneer Developers. See AUTHORS.txt for details
+// Licensed under the terms of the GPL v3. See licenses/GPL-3.txt
+
+#include "Hash.h"
+#include <SDL_endian.h>
+#include <cstring>
+
+// MurmurHash64A, by Austin Appleby, public domain
+static const Uint64 MURMUR_M = 0xc6a4a7935bd1e995ULL;
+static const int MURMUR_R = 47;
+
+Uint64 Hash64(const void *data, size_t length, Uint64 seed)
+{
+	const Uint8 *buf = static_cast<const Uint8*>(data);
+	Uint64 h = seed ^ (Uint64(length) * MURMUR_M);
+
+	for (const Uint8 *end = buf + (length & ~size_t(7)); buf != end; buf += 8) {
+		Uint64 k;
+		memcpy(&k, buf, sizeof(k));
+		k = SDL_SwapLE64(k);
+
+		k *= MURMUR_M;
+		k ^= k >> MURMUR_R;
+		k *= MURMUR_M;
+
+		h ^= k;
+		h *= MURMUR_M;
+	}
+
+	// the last few bytes, each case falling through to the next
+	switch (length & 7) {
+		case 7: h ^= Uint64(buf[6]) << 48;
+		case 6: h ^= Uint64(buf[5]) << 40;
+		case 5: h ^= Uint64(buf[4]) << 32;
+		case 4: h ^= Uint64(buf[3]) << 24;
+		case 3: h ^= Uint64(buf[2]) << 16;
+		case 2: h ^= Uint64(buf[1]) << 8;
+		case 1: h ^= Uint64(buf[0]);
+			h *= MURMUR_M;
+	}
+
+	h ^= h >> MURMUR_R;
+	h *= MURMUR_M;
+	h ^= h >> MURMUR_R;
+	return h;
+}
@@ -0,0 +1,16 @@
+// Copyright © 2008-2013 Pioneer Developers. See AUTHORS.txt for details
+// Licensed under the terms of the GPL v3. See licenses/GPL-3.txt
+
+#ifndef _HASH_H
+#define _HASH_H
+
+#include <SDL_stdinc.h>
+#include <cstddef>
+
+// a quick 64 bit hash for cache keys and checking that data hasn't changed,
+// eight bytes at a time (MurmurHash64A). not for anything that has to stand
+// up to someone trying to make it collide. the data is read as little
+// endian, so it comes out the same on every machine
+Uint64 Hash64(const void *data, size_t length, Uint64 seed = 0);
+
+#endif
@@ -5,6 +5,7 @@
 #define _HYPERSPACECLOUD_H
 
 #include "Body.h"
+#include "BodyPool.h"
 
 class Frame;
 class Ship;
@@ -17,7 +18,7 @@ namespace Graphics {
 /** XXX TODO XXX Not applied to yet... */
 #define HYPERCLOUD_DURATION (60.0*60.0*24.0*2.0)
 
-class HyperspaceCloud: public Body {
+class HyperspaceCloud: public Body, public BodyPool<HyperspaceCloud> {
 public:
 	OBJDEF(HyperspaceCloud, Body, HYPERSPACECLOUD);
 	HyperspaceCloud(Ship *, double dateDue, bool isArrival);
@@ -7,6 +7,7 @@
 #include "Easing.h"
 #include "graphics/Renderer.h"
 #include "graphics/TextureBuilder.h"
+#include "graphics/TextureGL.h"
 #include "graphics/Graphics.h"
 #include "scenegraph/SceneGraph.h"
 #include "scenegraph/ModelSkin.h"
@@ -36,7 +37,7 @@ Intro::Intro(Graphics::Renderer *r, int width, int height)
 	skin.SetLabel(Lang::PIONEER);
 
 	for (std::vector<ShipType::Id>::const_iterator i = ShipType::player_ships.begin(); i != ShipType::player_ships.end(); ++i) {
-		SceneGraph::Model *model = Pi::FindModel(ShipType::types[*i].modelName)->MakeInstance();
+		SceneGraph::Model *model = Pi::FindModel(ShipType::Get(*i)->modelName)->MakeInstance();
 		skin.SetRandomColors(Pi::rng);
 		skin.Apply(model);
 		model->SetThrust(vector3f(0.f, 0.f, -0.6f), vector3f(0.f));
@@ -125,4 +126,5 @@ void Intro::Draw(float _time)
 	m_renderer->SetViewport(0, 0, Graphics::GetScreenWidth(), Graphics::GetScreenHeight());
 
 	glPopAttrib();
+	Graphics::TextureGL::InvalidateBindings(); // glPopAttrib put back the old texture bindings
 }
@@ -2,11 +2,27 @@
 // Licensed under the terms of the GPL v3. See licenses/GPL-3.txt
 
 #include "JobQueue.h"
+#include "OS.h"
+#include "Profiler.h"
+#include "StringF.h"
+#include <algorithm>
+
+// heap ordering for the waiting queues. the most urgent job is the one with
+// the highest priority, then the one that was queued first
+bool JobQueue::IsLessUrgent(const Job *a, const Job *b)
+{
+	if (!is_equal_exact(a->GetPriority(), b->GetPriority()))
+		return a->GetPriority() < b->GetPriority();
+	return b->serial < a->serial;
+}
 
 JobRunner::JobRunner(JobQueue *jq, const uint8_t idx) :
 	m_jobQueue(jq),
 	m_job(0),
-	m_threadIdx(idx)
+	m_threadIdx(idx),
+	m_busyTicks(0),
+	m_idleTicks(0),
+	m_jobsRun(0)
 {
 	m_jobLock = SDL_CreateMutex();
 	m_threadId = SDL_CreateThread(&JobRunner::Trampoline, this);
@@ -21,10 +37,11 @@ JobRunner::~JobRunner()
 		m_job->OnCancel();
 	SDL_UnlockMutex(m_jobLock);
 
-	// XXX - AndyC(FluffyFreak) - I'd like to find a better answer for this but I can't see what purpose it serves.
-	//		- this is only called on shutting down the program, so there's no case now where we'd be restarting anything.
-	// kill the thread. this will block until the thread goes away
-	//SDL_KillThread(m_threadId);
+	// wait for the thread to go away. the queue has already flagged shutdown
+	// and woken everyone, so it'll be along as soon as its current job returns
+	SDL_WaitThread(m_threadId, 0);
+
+	SDL_DestroyMutex(m_jobLock);
 }
 
 // entry point for SDL thread. we simply get back onto a method. convenience mostly
@@ -37,53 +54,72 @@ int JobRunner::Trampoline(void *data)
 
 void JobRunner::Main()
 {
-	Job *job = m_jobQueue->GetJob();
+	// the queue records the job in m_job as it hands it over, so it can
+	// always be found for cancelling
+	Uint64 idleSince = OS::HFTimer();
+	Job *job = m_jobQueue->GetJob(this);
 	while (job) {
-		// record the job so we can cancel it in case of premature shutdown
-		SDL_LockMutex(m_jobLock);
-		m_job = job;
-		SDL_UnlockMutex(m_jobLock);
+		const Uint64 start = OS::HFTimer();
+		job->startedAt = start;
 
 		// run the thing
-		job->OnRun();
+		{
+			PROFILE_ZONE(job->GetName());
+			job->OnRun();
+		}
+
+		// the job is the main thread's once it's handed back
+		const Uint64 end = OS::HFTimer();
+		job->finishedAt = end;
 		m_jobQueue->Finish(job, m_threadIdx);
 
 		SDL_LockMutex(m_jobLock);
 		m_job = 0;
+		m_busyTicks += end - start;
+		m_idleTicks += start - idleSince;
+		m_jobsRun++;
 		SDL_UnlockMutex(m_jobLock);
+		idleSince = end;
 
 		// get a new job. this will block normally, or return null during
 		// shutdown
-		job = m_jobQueue->GetJob();
+		job = m_jobQueue->GetJob(this);
 	}
 }
 
 
 JobQueue::JobQueue(Uint32 numRunners) :
+	m_nextQueue(0),
+	m_nextSerial(0),
+	m_nextGroup(0),
+	m_nextFinished(0),
+	m_statsSince(OS::HFTimer()),
 	m_shutdown(false)
 {
 	// Want to limit this for now to the maximum number of threads defined in the class
 	numRunners = std::min( numRunners, MAX_THREADS );
 
-	m_queueLock = SDL_CreateMutex();
-	m_queueWaitCond = SDL_CreateCond();
-
+	// all the queues have to exist before the first runner starts, since it
+	// may go looking for work in any of them
+	m_numRunners = numRunners;
 	for (Uint32 i = 0; i < numRunners; i++) {
+		m_queueLock[i] = SDL_CreateMutex();
 		m_finishedLock[i] = SDL_CreateMutex();
-		m_runners.push_back(new JobRunner(this, i));
 	}
+	m_jobsAvailable = SDL_CreateSemaphore(0);
+
+	for (Uint32 i = 0; i < numRunners; i++)
+		m_runners.push_back(new JobRunner(this, i));
 }
 
 JobQueue::~JobQueue()
 {
-	// flag shutdown. protected by the queue lock for convenience in GetJob
-	SDL_LockMutex(m_queueLock);
+	// flag shutdown. GetJob checks it each time it wakes
 	m_shutdown = true;
-	SDL_UnlockMutex(m_queueLock);
 
-	// broadcast to any waiting runners that they should try (and fail) to get
-	// a new job right now
-	SDL_CondBroadcast(m_queueWaitCond);
+	// wake every runner so they can all try (and fail) to get a new job
+	for (Uint32 i = 0; i < m_numRunners; i++)
+		SDL_SemPost(m_jobsAvailable);
 
 	const uint32_t numThreads = m_runners.size();
 	// delete the runners. this will tear down their underlying threads
@@ -91,9 +127,9 @@ JobQueue::~JobQueue()
 		delete (*i);
 
 	// delete any remaining jobs
-	for (std::deque<Job*>::iterator i = m_queue.begin(); i != m_queue.end(); ++i)
-		delete (*i);
 	for (uint32_t threadIdx=0; threadIdx<numThreads; threadIdx++) {
+		for (std::vector<Job*>::iterator i = m_queue[threadIdx].begin(); i != m_queue[threadIdx].end(); ++i)
+			delete (*i);
 		for (std::deque<Job*>::iterator i = m_finished[threadIdx].begin(); i != m_finished[threadIdx].end(); ++i) {
 			delete (*i);
 		}
@@ -102,50 +138,85 @@ JobQueue::~JobQueue()
 	// only us left now, we can clean up and get out of here
 	for (uint32_t threadIdx=0; threadIdx<numThreads; threadIdx++) {
 		SDL_DestroyMutex(m_finishedLock[threadIdx]);
+		SDL_DestroyMutex(m_queueLock[threadIdx]);
 	}
-	SDL_DestroyCond(m_queueWaitCond);
-	SDL_DestroyMutex(m_queueLock);
+	SDL_DestroySemaphore(m_jobsAvailable);
 }
 
 void JobQueue::Queue(Job *job)
 {
-	// push the job onto the queue
-	SDL_LockMutex(m_queueLock);
-	m_queue.push_back(job);
-	SDL_UnlockMutex(m_queueLock);
+	// hand the job to the next runner queue in turn. if that runner is busy
+	// one of the others will steal it
+	const Uint32 idx = m_nextQueue;
+	m_nextQueue = (m_nextQueue + 1) % m_numRunners;
+
+	job->serial = m_nextSerial++;
+	job->queuedAt = OS::HFTimer();
+
+	SDL_LockMutex(m_queueLock[idx]);
+	m_queue[idx].push_back(job);
+	std::push_heap(m_queue[idx].begin(), m_queue[idx].end(), JobQueue::IsLessUrgent);
+	SDL_UnlockMutex(m_queueLock[idx]);
 
 	// and tell a waiting runner that there's one available
-	SDL_CondSignal(m_queueWaitCond);
+	SDL_SemPost(m_jobsAvailable);
 }
 
 // called by the runner to get a new job
-Job *JobQueue::GetJob()
+Job *JobQueue::GetJob(JobRunner *runner)
 {
-	SDL_LockMutex(m_queueLock);
-
 	// loop until a new job is available
 	Job *job = 0;
 	while (!job) {
+		// no jobs, go to sleep until one arrives
+		SDL_SemWait(m_jobsAvailable);
+
 		// we're shutting down, so just get out of here
-		if (m_shutdown) {
-			SDL_UnlockMutex(m_queueLock);
+		if (m_shutdown)
 			return 0;
-		}
 
-		if (!m_queue.size())
-			// no jobs, go to sleep until one arrives
-			SDL_CondWait(m_queueWaitCond, m_queueLock);
+		// a cancelled job can leave us awake with nothing to take, in which
+		// case we just go back to sleep
+		job = TakeJob(runner);
+	}
 
-		else {
-			// got one, pop it and return it
-			job = m_queue.front();
-			m_queue.pop_front();
-		}
+	return job;
+}
 
+// take the most urgent job from the runner's own queue, or failing that steal
+// one from another runner's queue
+Job *JobQueue::TakeJob(JobRunner *runner)
+{
+	Job *job = 0;
+
+	for (Uint32 i = 0; i < m_numRunners; i++) {
+		const Uint32 victim = (runner->m_threadIdx + i) % m_numRunners;
+		SDL_LockMutex(m_queueLock[victim]);
+		job = PopMostUrgent(m_queue[victim]);
+		if (job) {
+			// hand it over while the queue is still locked, so that anyone
+			// holding the queue locks can see every job, waiting or running
+			SDL_LockMutex(runner->m_jobLock);
+			runner->m_job = job;
+			SDL_UnlockMutex(runner->m_jobLock);
+		}
+		SDL_UnlockMutex(m_queueLock[victim]);
+		if (job)
+			return job;
 	}
 
-	SDL_UnlockMutex(m_queueLock);
+	return 0;
+}
 
+// remove and return the most urgent job from a waiting queue. the queue must
+// be locked
+Job *JobQueue::PopMostUrgent(std::vector<Job*> &queue)
+{
+	if (queue.empty())
+		return 0;
+	std::pop_heap(queue.begin(), queue.end(), JobQueue::IsLessUrgent);
+	Job *job = queue.back();
+	queue.pop_back();
 	return job;
 }
 
@@ -157,57 +228,116 @@ void JobQueue::Finish(Job *job, const uint8_t threadIdx)
 	SDL_UnlockMutex(m_finishedLock[threadIdx]);
 }
 
+void JobQueue::UpdatePriorities()
+{
+	for (Uint32 i = 0; i < m_numRunners; i++) {
+		SDL_LockMutex(m_queueLock[i]);
+		bool changed = false;
+		for (std::vector<Job*>::iterator j = m_queue[i].begin(); j != m_queue[i].end(); ++j)
+			changed |= (*j)->UpdatePriority();
+		if (changed)
+			std::make_heap(m_queue[i].begin(), m_queue[i].end(), JobQueue::IsLessUrgent);
+		SDL_UnlockMutex(m_queueLock[i]);
+	}
+}
+
 // call OnFinish methods for completed jobs, and clean up
-Uint32 JobQueue::FinishJobs()
+Uint32 JobQueue::FinishJobs(const Uint32 maxMicroseconds)
 {
 	Uint32 finished = 0;
 
+	const Uint64 freq = OS::HFTimerFreq();
+	const Uint64 budget = (Uint64(maxMicroseconds) * freq) / 1000000;
+	const Uint64 start = maxMicroseconds ? OS::HFTimer() : 0;
+
+	// take one job from each runner in turn until they're all empty, or until
+	// we run out of time
 	const uint32_t numRunners = m_runners.size();
-	for( uint32_t i=0; i<numRunners ; ++i) {
+	uint32_t numEmpty = 0;
+	while (numEmpty < numRunners) {
+		const uint32_t i = m_nextFinished;
+		m_nextFinished = (m_nextFinished + 1) % numRunners;
+
 		SDL_LockMutex(m_finishedLock[i]);
 		if( m_finished[i].empty() ) {
 			SDL_UnlockMutex(m_finishedLock[i]);
+			numEmpty++;
 			continue;
 		}
 		Job *job = m_finished[i].front();
 		m_finished[i].pop_front();
 		SDL_UnlockMutex(m_finishedLock[i]);
+		numEmpty = 0;
 
 		// if its already been cancelled then its taken care of, so we just forget about it
 		if (!job->cancelled) {
+			TypeStats &s = m_typeStats[job->GetName()];
+			const Uint64 wait = job->startedAt - job->queuedAt;
+			const Uint64 run = job->finishedAt - job->startedAt;
+			const Uint64 finish = OS::HFTimer() - job->finishedAt;
+			s.finished++;
+			s.waitTicks += wait;
+			s.runTicks += run;
+			s.finishTicks += finish;
+			s.maxWaitTicks = std::max(s.maxWaitTicks, wait);
+			s.maxRunTicks = std::max(s.maxRunTicks, run);
+			s.maxFinishTicks = std::max(s.maxFinishTicks, finish);
+
 			job->OnFinish();
 			finished++;
 		}
 
 		delete job;
+
+		if (maxMicroseconds && OS::HFTimer() - start >= budget)
+			break;
 	}
 
 	return finished;
 }
 
+Uint32 JobQueue::GetNumWaitingToFinish() const
+{
+	Uint32 waiting = 0;
+	const uint32_t numRunners = m_runners.size();
+	for( uint32_t i=0; i<numRunners ; ++i) {
+		SDL_LockMutex(m_finishedLock[i]);
+		waiting += m_finished[i].size();
+		SDL_UnlockMutex(m_finishedLock[i]);
+	}
+	return waiting;
+}
+
 void JobQueue::Cancel(Job *job) {
-	// lock both queues, so we know that all jobs will stay put
-	SDL_LockMutex(m_queueLock);
+	// lock all the queues, so we know that all jobs will stay put
 	const uint32_t numRunners = m_runners.size();
 	for( uint32_t i=0; i<numRunners ; ++i) {
+		SDL_LockMutex(m_queueLock[i]);
 		SDL_LockMutex(m_finishedLock[i]);
 	}
 
-	// check the waiting list. if its there then it hasn't run yet. just forget about it
-	for (std::deque<Job*>::iterator i = m_queue.begin(); i != m_queue.end(); ++i) {
-		if (*i == job) {
-			i = m_queue.erase(i);
-			delete job;
-			goto unlock;
+	// check the waiting lists. if its there then it hasn't run yet. just forget about it
+	for( uint32_t iRunner=0; iRunner<numRunners ; ++iRunner) {
+		for (std::vector<Job*>::iterator i = m_queue[iRunner].begin(); i != m_queue[iRunner].end(); ++i) {
+			if (*i == job) {
+				m_queue[iRunner].erase(i);
+				std::make_heap(m_queue[iRunner].begin(), m_queue[iRunner].end(), JobQueue::IsLessUrgent);
+				CountCancelled(job);
+				delete job;
+				// the job won't be taken now, so take its wakeup too
+				SDL_SemTryWait(m_jobsAvailable);
+				goto unlock;
+			}
 		}
 	}
 
 	// check the finshed list. if its there then it can't be cancelled, because
 	// its alread finished! we remove it because the caller is saying "I don't care"
 	for( uint32_t iRunner=0; iRunner<numRunners ; ++iRunner) {
-		for (std::deque<Job*>::iterator i = m_queue.begin(); i != m_queue.end(); ++i) {
+		for (std::deque<Job*>::iterator i = m_finished[iRunner].begin(); i != m_finished[iRunner].end(); ++i) {
 			if (*i == job) {
 				i = m_finished[iRunner].erase(i);
+				if (!job->cancelled) CountCancelled(job);
 				delete job;
 				goto unlock;
 			}
@@ -215,12 +345,145 @@ void JobQueue::Cancel(Job *job) {
 	}
 
 	// its running, so we have to tell it to cancel
+	if (!job->cancelled) CountCancelled(job);
 	job->cancelled = true;
 	job->OnCancel();
 
 unlock:
 	for( uint32_t i=0; i<numRunners ; ++i) {
 		SDL_UnlockMutex(m_finishedLock[i]);
+		SDL_UnlockMutex(m_queueLock[i]);
+	}
+}
+
+void JobQueue::CancelGroup(const Uint32 group) {
+	assert(group != 0);
+
+	// lock all the queues, so we know that all jobs will stay put
+	const uint32_t numRunners = m_runners.size();
+	for( uint32_t i=0; i<numRunners ; ++i) {
+		SDL_LockMutex(m_queueLock[i]);
+		SDL_LockMutex(m_finishedLock[i]);
+	}
+
+	// running jobs first. a job that has only just finished can still be
+	// recorded as running, and we're about to delete the finished ones
+	for( uint32_t iRunner=0; iRunner<numRunners ; ++iRunner) {
+		JobRunner *runner = m_runners[iRunner];
+		SDL_LockMutex(runner->m_jobLock);
+		Job *job = runner->m_job;
+		if (job && job->group == group && !job->cancelled) {
+			CountCancelled(job);
+			job->cancelled = true;
+			job->OnCancel();
+		}
+		SDL_UnlockMutex(runner->m_jobLock);
+	}
+
+	for( uint32_t iRunner=0; iRunner<numRunners ; ++iRunner) {
+		// waiting jobs will never run, just forget about them
+		std::vector<Job*> &queue = m_queue[iRunner];
+		std::vector<Job*>::iterator keep = queue.begin();
+		for (std::vector<Job*>::iterator i = queue.begin(); i != queue.end(); ++i) {
+			if ((*i)->group == group) {
+				CountCancelled(*i);
+				delete (*i);
+				// the job won't be taken now, so take its wakeup too
+				SDL_SemTryWait(m_jobsAvailable);
+			} else
+				*keep++ = *i;
+		}
+		if (keep != queue.end()) {
+			queue.erase(keep, queue.end());
+			std::make_heap(queue.begin(), queue.end(), JobQueue::IsLessUrgent);
+		}
+
+		// finished jobs are no longer wanted either
+		std::deque<Job*> &finished = m_finished[iRunner];
+		std::deque<Job*>::iterator keepFinished = finished.begin();
+		for (std::deque<Job*>::iterator i = finished.begin(); i != finished.end(); ++i) {
+			if ((*i)->group == group) {
+				if (!(*i)->cancelled) CountCancelled(*i);
+				delete (*i);
+			} else
+				*keepFinished++ = *i;
+		}
+		finished.erase(keepFinished, finished.end());
+	}
+
+	for( uint32_t i=0; i<numRunners ; ++i) {
+		SDL_UnlockMutex(m_finishedLock[i]);
+		SDL_UnlockMutex(m_queueLock[i]);
+	}
+}
+
+void JobQueue::CountCancelled(const Job *job)
+{
+	m_typeStats[job->GetName()].cancelled++;
+}
+
+Uint32 JobQueue::GetNumWaiting() const
+{
+	Uint32 waiting = 0;
+	for (Uint32 i = 0; i < m_numRunners; i++) {
+		SDL_LockMutex(m_queueLock[i]);
+		waiting += m_queue[i].size();
+		SDL_UnlockMutex(m_queueLock[i]);
+	}
+	return waiting;
+}
+
+Uint32 JobQueue::GetNumIdleRunners() const
+{
+	Uint32 idle = 0;
+	for (std::vector<JobRunner*>::const_iterator it = m_runners.begin(); it != m_runners.end(); ++it) {
+		SDL_LockMutex((*it)->m_jobLock);
+		if (!(*it)->m_job) idle++;
+		SDL_UnlockMutex((*it)->m_jobLock);
+	}
+	const Uint32 waiting = GetNumWaiting();
+	return idle > waiting ? idle - waiting : 0;
+}
+
+std::string JobQueue::GetStatsReport() const
+{
+	const double msPerTick = 1000.0 / double(OS::HFTimerFreq());
+	const double elapsed = std::max(double(OS::HFTimer() - m_statsSince), 1.0);
+
+	// busy%/idle% (jobs run) for each runner. idle is time spent waiting
+	// for a job, counted when the next one starts
+	std::string out = stringf("Jobs: %0 waiting, %1 to finish. runners:", GetNumWaiting(), GetNumWaitingToFinish());
+	for (std::vector<JobRunner*>::const_iterator it = m_runners.begin(); it != m_runners.end(); ++it) {
+		SDL_LockMutex((*it)->m_jobLock);
+		const Uint64 busy = (*it)->m_busyTicks;
+		const Uint64 idle = (*it)->m_idleTicks;
+		const Uint32 jobs = (*it)->m_jobsRun;
+		SDL_UnlockMutex((*it)->m_jobLock);
+		out += stringf(" %0{f.0}/%1{f.0}%% (%2)", 100.0 * double(busy) / elapsed, 100.0 * double(idle) / elapsed, jobs);
+	}
+
+	// avg/max milliseconds
+	for (std::map<const char*, TypeStats, NameLess>::const_iterator it = m_typeStats.begin(); it != m_typeStats.end(); ++it) {
+		const TypeStats &s = it->second;
+		const double n = double(std::max(s.finished, Uint32(1)));
+		out += stringf("\n  %0: %1 done, %2 cancelled, wait %3{f.1}/%4{f.1}, run %5{f.1}/%6{f.1}, finish %7{f.1}/%8{f.1} ms",
+			it->first, s.finished, s.cancelled,
+			double(s.waitTicks) * msPerTick / n, double(s.maxWaitTicks) * msPerTick,
+			double(s.runTicks) * msPerTick / n, double(s.maxRunTicks) * msPerTick,
+			double(s.finishTicks) * msPerTick / n, double(s.maxFinishTicks) * msPerTick);
+	}
+	return out;
+}
+
+void JobQueue::ResetStats()
+{
+	m_typeStats.clear();
+	for (std::vector<JobRunner*>::iterator it = m_runners.begin(); it != m_runners.end(); ++it) {
+		SDL_LockMutex((*it)->m_jobLock);
+		(*it)->m_busyTicks = 0;
+		(*it)->m_idleTicks = 0;
+		(*it)->m_jobsRun = 0;
+		SDL_UnlockMutex((*it)->m_jobLock);
 	}
-	SDL_UnlockMutex(m_queueLock);
+	m_statsSince = OS::HFTimer();
 }
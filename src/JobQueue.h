@@ -4,7 +4,10 @@
 #ifndef JOBQUEUE_H
 #define JOBQUEUE_H
 
+#include <cstring>
 #include <deque>
+#include <map>
+#include <string>
 #include <vector>
 #include "SDL_thread.h"
 
@@ -25,18 +28,62 @@ class JobRunner;
 // OnCancel: optional. called from the main thread to tell the job that its
 //           results are not wanted. it should arrange for OnRun to return
 //           as quickly as possible. OnFinish will not be called for the job
+//
+// UpdatePriority: optional. called from the main thread by
+//                 JobQueue::UpdatePriorities while the job is still waiting
+//                 to run. recalculate the priority with SetPriority and
+//                 return true if it changed, so the queue can reorder itself
+//
+// waiting jobs with a higher priority are run first. jobs of equal priority
+// run in the order they were queued. the priority classes are spaced widely
+// enough that a job can be ordered among its peers by adding a small
+// (less than PRIORITY_CLASS_SPAN) offset to the class value
+//
+// jobs can be tagged with a group (from JobQueue::NewGroup) so that everything
+// belonging to one owner can be cancelled with a single JobQueue::CancelGroup
+// call. long running jobs should poll IsCancelled from OnRun and return early
+//
+// GetName names the kind of job in the queue's statistics and in profiles.
+// it must return a literal
 class Job {
 public:
-	Job() : cancelled(false) {}
+	enum PriorityClass {
+		PRIORITY_LOW    = -1000,
+		PRIORITY_NORMAL = 0,
+		PRIORITY_HIGH   = 1000,
+		PRIORITY_CLASS_SPAN = 1000
+	};
+
+	Job() : cancelled(false), priority(PRIORITY_NORMAL), serial(0), group(0), queuedAt(0), startedAt(0), finishedAt(0) {}
 	virtual ~Job() {}
 
 	virtual void OnRun() = 0;
 	virtual void OnFinish() = 0;
 	virtual void OnCancel() {}
+	virtual bool UpdatePriority() { return false; }
+	virtual const char *GetName() const { return "Job"; }
+
+	void SetPriority(const float p) { priority = p; }
+	float GetPriority() const { return priority; }
+
+	// 0 is no group. set it before queueing the job
+	void SetGroup(const Uint32 g) { group = g; }
+	Uint32 GetGroup() const { return group; }
+
+protected:
+	// safe to call from OnRun
+	bool IsCancelled() const { return cancelled; }
 
 private:
 	friend class JobQueue;
-	bool cancelled;
+	volatile bool cancelled;
+	float priority;
+	Uint32 serial;
+	Uint32 group;
+	// HFTimer
+	Uint64 queuedAt;
+	Uint64 startedAt;
+	Uint64 finishedAt;
 };
 
 
@@ -48,6 +95,7 @@ public:
 	~JobRunner();
 
 private:
+	friend class JobQueue;
 	static int Trampoline(void *);
 	void Main();
 
@@ -59,11 +107,22 @@ private:
 	SDL_Thread *m_threadId;
 
 	uint8_t m_threadIdx;
+
+	// HFTimer ticks, since the last JobQueue::ResetStats. m_jobLock
+	// guards them
+	Uint64 m_busyTicks;
+	Uint64 m_idleTicks;
+	Uint32 m_jobsRun;
 };
 
 
 // the queue management class. create one from the main thread, and feed your
 // jobs do it. it will take care of the rest
+//
+// each runner has its own queue of waiting jobs. new jobs are handed out to
+// the runner queues in turn, and a runner that has emptied its own queue will
+// steal the most urgent job from one of the others. this keeps the runners
+// from all fighting over a single lock when lots of jobs arrive at once
 class JobQueue {
 public:
 	// numRunners is the number of jobs to run in parallel. right now its the
@@ -87,22 +146,95 @@ public:
 	// - the job is running. OnCancel will be called
 	void Cancel(Job *job);
 
+	// call from the main thread to get a new group id to tag jobs with
+	Uint32 NewGroup() { return ++m_nextGroup; }
+
+	// call from the main thread to cancel every job in a group. each job is
+	// treated as if Cancel had been called on it, but it's all done in a
+	// single pass over the queues
+	void CancelGroup(const Uint32 group);
+
+	// call from the main thread to have every waiting job recalculate its
+	// priority (see Job::UpdatePriority). jobs that are already running or
+	// finished are not affected
+	void UpdatePriorities();
+
 	// call from the main loop. this will call OnFinish for any finished jobs,
 	// and then delete all finished and cancelled jobs. returns the number of
 	// finished jobs (not cancelled)
-	Uint32 FinishJobs();
+	//
+	// if maxMicroseconds is non-zero, it stops once that much time has been
+	// spent and leaves the rest of the finished jobs for the next call. at
+	// least one job is always handled, so progress is guaranteed
+	Uint32 FinishJobs(const Uint32 maxMicroseconds = 0);
+
+	// the number of jobs that have finished running but haven't been through
+	// FinishJobs yet
+	Uint32 GetNumWaitingToFinish() const;
+
+	// the number of jobs waiting to run
+	Uint32 GetNumWaiting() const;
+
+	// the number of runners that would have nothing to do if no more jobs
+	// were queued: the ones not running a job, less the jobs waiting. only a
+	// hint, it's out of date as soon as it's returned
+	Uint32 GetNumIdleRunners() const;
+
+	// for each job type, times are from being queued to starting, from
+	// starting to finishing on the runner, and from that to FinishJobs
+	// handling it. all of them HFTimer ticks
+	struct TypeStats {
+		TypeStats() : finished(0), cancelled(0), waitTicks(0), runTicks(0), finishTicks(0), maxWaitTicks(0), maxRunTicks(0), maxFinishTicks(0) {}
+		Uint32 finished;
+		Uint32 cancelled;
+		Uint64 waitTicks;
+		Uint64 runTicks;
+		Uint64 finishTicks;
+		Uint64 maxWaitTicks;
+		Uint64 maxRunTicks;
+		Uint64 maxFinishTicks;
+	};
+
+	// call from the main thread. how busy each runner has been and what the
+	// jobs of each type have been doing since the last ResetStats
+	std::string GetStatsReport() const;
+	void ResetStats();
 
 private:
 	friend class JobRunner;
-	Job *GetJob();
+	Job *GetJob(JobRunner *runner);
+	Job *TakeJob(JobRunner *runner);
+	static Job *PopMostUrgent(std::vector<Job*> &queue);
+	static bool IsLessUrgent(const Job *a, const Job *b);
 	void Finish(Job *job, const uint8_t threadIdx);
+	void CountCancelled(const Job *job);
+
+	struct NameLess {
+		bool operator()(const char *a, const char *b) const { return strcmp(a, b) < 0; }
+	};
+	// only touched from the main thread
+	std::map<const char*, TypeStats, NameLess> m_typeStats;
+	Uint64 m_statsSince; // HFTimer
+
+	Uint32 m_numRunners;
+	Uint32 m_nextQueue;
+	Uint32 m_nextSerial;
+	Uint32 m_nextGroup;
+
+	// waiting jobs for each runner, kept as a heap with the most urgent job
+	// at the front
+	std::vector<Job*> m_queue[MAX_THREADS];
+	SDL_mutex *m_queueLock[MAX_THREADS];
 
-	std::deque<Job*> m_queue;
-	SDL_mutex *m_queueLock;
-	SDL_cond *m_queueWaitCond;
+	// counts jobs waiting in the runner queues. runners sleep on this when
+	// there's nothing for them to do
+	SDL_sem *m_jobsAvailable;
 
 	std::deque<Job*> m_finished[MAX_THREADS];
 	SDL_mutex *m_finishedLock[MAX_THREADS];
+	// the finished list FinishJobs starts from, so that a budgeted run
+	// doesn't always favour the first runners
+	Uint32 m_nextFinished;
 
 	std::vector<JobRunner*> m_runners;
 
@@ -0,0 +1,186 @@
+// Copyright © 2008-2013 Pioneer Developers. See AUTHORS.txt for details
+// Licensed under the terms of the GPL v3. See licenses/GPL-3.txt
+
+#include "LuaAllocator.h"
+#include "LuaMemoryTracker.h"
+#include <cassert>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <algorithm>
+#include <new>
+
+// roughly how much each pool takes from the system at a time
+static const size_t SLAB_SIZE = 16384;
+
+LuaAllocator::LuaAllocator() :
+	m_softLimit(0),
+	m_hardLimit(0),
+	m_overSoftLimit(false),
+	m_hitHardLimit(false),
+	m_tracking(false)
+{
+	for (size_t i = 0; i < NUM_SIZE_CLASSES; i++) {
+		const size_t blockSize = (i+1) * SIZE_CLASS_STEP;
+		m_pools[i] = new BlockPoolBase(blockSize, SLAB_SIZE / blockSize, false);
+	}
+	memset(&m_stats, 0, sizeof(m_stats));
+}
+
+LuaAllocator::~LuaAllocator()
+{
+	// the Lua state must be gone by now, or it's about to use freed memory
+	for (size_t i = 0; i < NUM_SIZE_CLASSES; i++) {
+		assert(m_pools[i]->GetNumAllocated() == 0);
+		delete m_pools[i];
+	}
+}
+
+void *LuaAllocator::Alloc(void *ud, void *ptr, size_t osize, size_t nsize)
+{
+	LuaAllocator *a = static_cast<LuaAllocator*>(ud);
+
+	// without a block, osize tells us what Lua wants it for, not its size
+	if (!ptr) return nsize ? a->Allocate(nsize) : 0;
+
+	if (nsize == 0) {
+		a->Free(ptr, osize);
+		return 0;
+	}
+
+	return a->Reallocate(ptr, osize, nsize);
+}
+
+bool LuaAllocator::CheckLimits(size_t growth)
+{
+	const size_t total = m_stats.bytesInUse + growth;
+
+	// each limit warns once on the way up. it has to drop back a little
+	// before it can warn again, so hovering around a limit doesn't spam
+	if (m_hardLimit) {
+		if (total > m_hardLimit) {
+			if (!m_hitHardLimit) {
+				m_hitHardLimit = true;
+				fprintf(stderr, "Lua heap hit its hard limit of %u KB, refusing allocations\n", Uint32(m_hardLimit / 1024));
+			}
+			return false;
+		}
+		if (m_hitHardLimit && total < m_hardLimit - m_hardLimit / 8)
+			m_hitHardLimit = false;
+	}
+
+	if (m_softLimit) {
+		if (!m_overSoftLimit && total > m_softLimit) {
+			m_overSoftLimit = true;
+			fprintf(stderr, "Lua heap is over its soft limit of %u KB\n", Uint32(m_softLimit / 1024));
+		}
+		else if (m_overSoftLimit && total < m_softLimit - m_softLimit / 8)
+			m_overSoftLimit = false;
+	}
+
+	return true;
+}
+
+void *LuaAllocator::Allocate(size_t size)
+{
+	if ((m_softLimit || m_hardLimit) && !CheckLimits(size))
+		return 0;
+
+	void *p = AllocateBlock(size);
+	if (p && m_tracking) LuaMemoryTracker::Allocated(p, size);
+	return p;
+}
+
+void LuaAllocator::Free(void *ptr, size_t size)
+{
+	FreeBlock(ptr, size);
+	if (m_tracking) LuaMemoryTracker::Freed(ptr);
+}
+
+void *LuaAllocator::AllocateBlock(size_t size)
+{
+	void *p;
+	if (size <= MAX_POOLED_SIZE) {
+		// Lua wants a null rather than an exception when memory runs out
+		try {
+			p = m_pools[SizeClass(size)]->AllocBlock();
+		} catch (std::bad_alloc &) {
+			return 0;
+		}
+		m_stats.pooledAllocs++;
+	}
+	else {
+		p = malloc(size);
+		if (!p) return 0;
+	}
+
+	m_stats.allocs++;
+	m_stats.bytesInUse += size;
+	return p;
+}
+
+void LuaAllocator::FreeBlock(void *ptr, size_t size)
+{
+	if (size <= MAX_POOLED_SIZE)
+		m_pools[SizeClass(size)]->FreeBlock(ptr);
+	else
+		free(ptr);
+
+	m_stats.frees++;
+	m_stats.bytesInUse -= size;
+}
+
+void *LuaAllocator::Reallocate(void *ptr, size_t osize, size_t nsize)
+{
+	const bool oldPooled = osize <= MAX_POOLED_SIZE;
+	const bool newPooled = nsize <= MAX_POOLED_SIZE;
+
+	// only growth is limited, so Lua can always give memory back
+	if (nsize > osize && (m_softLimit || m_hardLimit) && !CheckLimits(nsize - osize))
+		return 0;
+
+	void *p;
+
+	// still fits the block it's in
+	if (oldPooled && newPooled && SizeClass(osize) == SizeClass(nsize)) {
+		m_stats.bytesInUse += nsize;
+		m_stats.bytesInUse -= osize;
+		p = ptr;
+	}
+
+	else if (!oldPooled && !newPooled) {
+		p = realloc(ptr, nsize);
+		if (!p) return 0;
+		m_stats.bytesInUse += nsize;
+		m_stats.bytesInUse -= osize;
+	}
+
+	// moving between the pools and the system. a failure here leaves the
+	// old block alone, as Lua expects
+	else {
+		p = AllocateBlock(nsize);
+		if (!p) return 0;
+		memcpy(p, ptr, std::min(osize, nsize));
+		FreeBlock(ptr, osize);
+	}
+
+	// it's the same block as far as the tracker is concerned, so it stays
+	// charged to the line that first allocated it
+	if (m_tracking) LuaMemoryTracker::Resized(ptr, p, nsize);
+	return p;
+}
+
+const LuaAllocator::Stats &LuaAllocator::GetStats()
+{
+	m_stats.poolBytes = 0;
+	for (size_t i = 0; i < NUM_SIZE_CLASSES; i++)
+		m_stats.poolBytes += m_pools[i]->GetNumSlabs() * m_pools[i]->GetBlockSize() * (SLAB_SIZE / m_pools[i]->GetBlockSize());
+	return m_stats;
+}
+
+void LuaAllocator::ResetCounts()
+{
+	m_stats.allocs = 0;
+	m_stats.pooledAllocs = 0;
+	m_stats.frees = 0;
+}
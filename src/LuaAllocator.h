@@ -0,0 +1,79 @@
+// Copyright © 2008-2013 Pioneer Developers. See AUTHORS.txt for details
+// Licensed under the terms of the GPL v3. See licenses/GPL-3.txt
+
+#ifndef _LUAALLOCATOR_H
+#define _LUAALLOCATOR_H
+
+#include "BlockPool.h"
+#include <SDL_stdinc.h>
+#include <cstddef>
+
+// the allocator for our Lua state. nearly everything Lua allocates is small
+// (strings, table parts, closures, and the userdata every PushToLua makes)
+// and comes and goes constantly, so blocks up to MAX_POOLED_SIZE come from a
+// pool for their size class. anything bigger goes to the system.
+//
+// Lua only ever runs on the main thread, so the pools don't lock.
+//
+// there can be a soft and a hard limit on what Lua holds. going over the
+// soft one gets a warning on stderr; the hard one is enforced by failing the
+// allocation, so Lua collects everything it can and raises a memory error if
+// that isn't enough
+class LuaAllocator {
+public:
+	struct Stats {
+		Uint32 allocs;       // blocks handed out since the last reset
+		Uint32 pooledAllocs; // how many of those came from the pools
+		Uint32 frees;        // blocks given back since the last reset
+		size_t bytesInUse;   // everything Lua holds right now
+		size_t poolBytes;    // slab memory held by the pools, used or not
+	};
+
+	LuaAllocator();
+	~LuaAllocator();
+
+	// the lua_Alloc. ud is the LuaAllocator
+	static void *Alloc(void *ud, void *ptr, size_t osize, size_t nsize);
+
+	// poolBytes is worked out when this is called
+	const Stats &GetStats();
+	void ResetCounts();
+
+	// in bytes, 0 for no limit
+	void SetLimits(size_t soft, size_t hard) { m_softLimit = soft; m_hardLimit = hard; m_overSoftLimit = m_hitHardLimit = false; }
+
+	// report every block to LuaMemoryTracker
+	void SetTracking(bool tracking) { m_tracking = tracking; }
+
+private:
+	LuaAllocator(const LuaAllocator &);
+	LuaAllocator &operator=(const LuaAllocator &);
+
+	static const size_t SIZE_CLASS_STEP = 16;
+	static const size_t MAX_POOLED_SIZE = 256;
+	static const size_t NUM_SIZE_CLASSES = MAX_POOLED_SIZE / SIZE_CLASS_STEP;
+
+	static size_t SizeClass(size_t size) { return (size - 1) / SIZE_CLASS_STEP; }
+
+	void *Allocate(size_t size);
+	void Free(void *ptr, size_t size);
+	void *Reallocate(void *ptr, size_t osize, size_t nsize);
+
+	// the blocks themselves, without the limits or the tracker
+	void *AllocateBlock(size_t size);
+	void FreeBlock(void *ptr, size_t size);
+
+	// whether Lua may have this much more
+	bool CheckLimits(size_t growth);
+
+	BlockPoolBase *m_pools[NUM_SIZE_CLASSES];
+	Stats m_stats;
+
+	size_t m_softLimit;
+	size_t m_hardLimit;
+	bool m_overSoftLimit; // warned, and not yet back under
+	bool m_hitHardLimit;  // likewise
+	bool m_tracking;
+};
+
+#endif
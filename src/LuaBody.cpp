@@ -332,7 +332,7 @@ static int l_body_get_ground_position(lua_State *l)
 	lua_pushnumber(l, longitude);
 	Body *astro = f->GetBody();
 	if (astro->IsType(Object::TERRAINBODY)) {
-		double radius = static_cast<TerrainBody*>(astro)->GetTerrainHeight(pos.Normalized());
+		double radius = static_cast<TerrainBody*>(astro)->GetTerrainHeight(pos.Normalized(), 1.0);
 		double altitude = pos.Length() - radius;
 		lua_pushnumber(l, altitude);
 	} else {
@@ -0,0 +1,146 @@
+// Copyright © 2008-2013 Pioneer Developers. See AUTHORS.txt for details
+// Licensed under the terms of the GPL v3. See licenses/GPL-3.txt
+
+#include "LuaBytecodeCache.h"
+#include "FileSystem.h"
+#include "libs.h"
+#include <cstdio>
+#include <vector>
+
+extern "C" {
+#include "jenkins/lookup3.h"
+}
+
+namespace LuaBytecodeCache {
+
+static const char CACHE_DIR_NAME[] = "luacache";
+
+// bump this if the header layout changes
+static const Uint32 CACHE_VERSION = 1;
+
+struct FileHeader {
+	char magic[4];
+	Uint32 version;
+	Uint32 luaVersion;
+	Uint32 sourceSize;
+	Uint32 sourceHashA;
+	Uint32 sourceHashB;
+	Uint32 nameSize;
+	Uint32 codeSize;
+};
+
+static const char CACHE_MAGIC[4] = { 'P', 'L', 'B', 'C' };
+
+static bool s_enabled = false;
+
+void SetEnabled(bool enabled)
+{
+	s_enabled = enabled && FileSystem::userFiles.MakeDirectory(CACHE_DIR_NAME);
+}
+
+static std::string CacheFileName(const std::string &chunkName)
+{
+	Uint32 a = 0, b = 0;
+	lookup3_hashlittle2(chunkName.c_str(), chunkName.size(), &a, &b);
+	char buf[32];
+	snprintf(buf, sizeof(buf), "%08x%08x", a, b);
+	return FileSystem::JoinPathBelow(CACHE_DIR_NAME, buf);
+}
+
+// the header that a cache file for this source has to have
+static FileHeader MakeHeader(const char *source, size_t size, const std::string &chunkName)
+{
+	FileHeader header;
+	memcpy(header.magic, CACHE_MAGIC, sizeof(CACHE_MAGIC));
+	header.version = CACHE_VERSION;
+	header.luaVersion = LUA_VERSION_NUM;
+	header.sourceSize = size;
+	header.sourceHashA = header.sourceHashB = 0;
+	lookup3_hashlittle2(source, size, &header.sourceHashA, &header.sourceHashB);
+	header.nameSize = chunkName.size();
+	header.codeSize = 0;
+	return header;
+}
+
+// read the cached code into out if the file was made from this source
+static bool ReadCached(const std::string &filename, const FileHeader &want, const std::string &chunkName, std::vector<char> &out)
+{
+	FILE *f = FileSystem::userFiles.OpenReadStream(filename);
+	if (!f) return false;
+
+	FileHeader header;
+	bool ok = (fread(&header, sizeof(header), 1, f) == 1) &&
+		(memcmp(header.magic, want.magic, sizeof(want.magic)) == 0) &&
+		header.version == want.version &&
+		header.luaVersion == want.luaVersion &&
+		header.sourceSize == want.sourceSize &&
+		header.sourceHashA == want.sourceHashA &&
+		header.sourceHashB == want.sourceHashB &&
+		header.nameSize == want.nameSize &&
+		header.codeSize > 0;
+
+	// the name is kept too, so two scripts whose names hash the same can't
+	// pick up each other's code
+	if (ok) {
+		std::vector<char> name(header.nameSize);
+		ok = header.nameSize == 0 || (fread(&name[0], header.nameSize, 1, f) == 1 &&
+			chunkName.compare(0, std::string::npos, &name[0], header.nameSize) == 0);
+	}
+	if (ok) {
+		out.resize(header.codeSize);
+		ok = fread(&out[0], header.codeSize, 1, f) == 1;
+	}
+	fclose(f);
+	return ok;
+}
+
+static int dump_writer(lua_State *l, const void *p, size_t sz, void *ud)
+{
+	std::vector<char> *out = static_cast<std::vector<char>*>(ud);
+	const char *bytes = static_cast<const char*>(p);
+	out->insert(out->end(), bytes, bytes + sz);
+	return 0;
+}
+
+// the compiled chunk is on the top of the stack
+static void WriteCached(lua_State *l, const std::string &filename, FileHeader header, const std::string &chunkName)
+{
+	std::vector<char> code;
+	if (lua_dump(l, dump_writer, &code) != 0 || code.empty())
+		return;
+	header.codeSize = code.size();
+
+	// a short write leaves a file that fails the checks in ReadCached, so
+	// the script just gets compiled again next time
+	FILE *f = FileSystem::userFiles.OpenWriteStream(filename);
+	if (!f) return;
+	fwrite(&header, sizeof(header), 1, f);
+	fwrite(chunkName.c_str(), chunkName.size(), 1, f);
+	fwrite(&code[0], code.size(), 1, f);
+	fclose(f);
+}
+
+int Load(lua_State *l, const char *source, size_t size, const std::string &chunkName)
+{
+	if (!s_enabled)
+		return luaL_loadbuffer(l, source, size, chunkName.c_str());
+
+	const std::string filename = CacheFileName(chunkName);
+	const FileHeader header = MakeHeader(source, size, chunkName);
+
+	std::vector<char> code;
+	if (ReadCached(filename, header, chunkName, code)) {
+		// binary only, so a damaged file can't be taken for source. if the
+		// loader doesn't like it we fall back to compiling
+		if (luaL_loadbufferx(l, &code[0], code.size(), chunkName.c_str(), "b") == LUA_OK)
+			return LUA_OK;
+		lua_pop(l, 1);
+	}
+
+	const int ret = luaL_loadbuffer(l, source, size, chunkName.c_str());
+	if (ret == LUA_OK)
+		WriteCached(l, filename, header, chunkName);
+	return ret;
+}
+
+}
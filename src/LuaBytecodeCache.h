@@ -0,0 +1,28 @@
+// Copyright © 2008-2013 Pioneer Developers. See AUTHORS.txt for details
+// Licensed under the terms of the GPL v3. See licenses/GPL-3.txt
+
+#ifndef _LUABYTECODECACHE_H
+#define _LUABYTECODECACHE_H
+
+#include "lua/lua.hpp"
+#include <string>
+
+// compiled data/ scripts, kept in the user dir so they don't have to be
+// parsed again every startup. each file is keyed by its chunk name and
+// checked against the size and hash of the source it was compiled from, so
+// an edited script (or a mod replacing one) is just compiled again. the
+// files are whatever lua_dump produced, so like the patch cache they're
+// for this machine and this build only
+namespace LuaBytecodeCache {
+
+	// off until this is called. main thread only
+	void SetEnabled(bool enabled);
+
+	// luaL_loadbuffer, going through the cache when it's enabled. pushes the
+	// compiled chunk (or an error message) and returns the luaL_loadbuffer
+	// status
+	int Load(lua_State *l, const char *source, size_t size, const std::string &chunkName);
+
+}
+
+#endif
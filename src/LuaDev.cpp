@@ -3,6 +3,8 @@
 
 #include "LuaDev.h"
 #include "LuaObject.h"
+#include "LuaNative.h"
+#include "OS.h"
 #include "Pi.h"
 #include "WorldView.h"
 
@@ -29,6 +31,47 @@ static int l_dev_set_camera_offset(lua_State *l)
 	return 0;
 }
 
+// milliseconds taken to call func iterations times
+static double time_calls(lua_State *l, int func, int iterations, int firstArg, int numArgs)
+{
+	const Uint64 start = OS::HFTimer();
+	for (int i = 0; i < iterations; i++) {
+		lua_pushvalue(l, func);
+		for (int a = 0; a < numArgs; a++)
+			lua_pushvalue(l, firstArg + a);
+		lua_call(l, numArgs, 0);
+	}
+	return double(OS::HFTimer() - start) * 1000.0 / double(OS::HFTimerFreq());
+}
+
+/*
+ * Time the Lua and native versions of a function that LuaNative has
+ * replaced, calling each iterations times with the remaining arguments.
+ * Returns the milliseconds each took, Lua first
+ *
+ * lua_ms, native_ms = Dev.BenchmarkNative("string.interp", 100000, "{a} {b}", { a = 1, b = 2 })
+ */
+static int l_dev_benchmark_native(lua_State *l)
+{
+	const char *name = luaL_checkstring(l, 1);
+	const int iterations = luaL_checkinteger(l, 2);
+	const int numArgs = lua_gettop(l) - 2;
+
+	LuaNative::PushOriginal(l, name);
+	if (lua_isnil(l, -1))
+		return luaL_error(l, "Dev.BenchmarkNative: '%s' has no native replacement installed", name);
+	const int original = lua_gettop(l);
+	LuaNative::PushNative(l, name);
+	const int native = lua_gettop(l);
+
+	const double luaTime = time_calls(l, original, iterations, 3, numArgs);
+	const double nativeTime = time_calls(l, native, iterations, 3, numArgs);
+
+	lua_pushnumber(l, luaTime);
+	lua_pushnumber(l, nativeTime);
+	return 2;
+}
+
 void LuaDev::Register()
 {
 	lua_State *l = Lua::manager->GetLuaState();
@@ -37,6 +80,7 @@ void LuaDev::Register()
 
 	static const luaL_Reg methods[]= {
 		{ "SetCameraOffset", l_dev_set_camera_offset },
+		{ "BenchmarkNative", l_dev_benchmark_native },
 		{ 0, 0 }
 	};
 
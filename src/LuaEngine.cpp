@@ -10,6 +10,11 @@
 #include "FileSystem.h"
 #include "ui/Context.h"
 #include "GameMenuView.h"
+#include "LuaProfiler.h"
+#include "Profiler.h"
+#include "LuaMemoryTracker.h"
+#include "MemoryStats.h"
+#include "graphics/Renderer.h"
 
 /*
  * Interface: Engine
@@ -125,6 +130,400 @@ static int l_engine_quit(lua_State *l)
 	return 0;
 }
 
+/*
+ * Function: StartProfiler
+ *
+ * Start sampling the Lua stack to see where script time goes. Anything
+ * already recorded is kept; see <ResetProfiler>.
+ *
+ * > Engine.StartProfiler(interval)
+ *
+ * Parameters:
+ *
+ *   interval - optional. the number of Lua VM instructions between samples.
+ *              The default is 1000. Smaller is more precise and slower.
+ *
+ * Availability:
+ *
+ *   alpha 34
+ *
+ * Status:
+ *
+ *   debug
+ */
+static int l_engine_start_profiler(lua_State *l)
+{
+	const int interval = luaL_optinteger(l, 1, LuaProfiler::DEFAULT_SAMPLE_INTERVAL);
+	LuaProfiler::Start(Lua::manager->GetLuaState(), interval);
+	return 0;
+}
+
+/*
+ * Function: StopProfiler
+ *
+ * Stop sampling. What was recorded is kept for <ProfilerReport> and
+ * <DumpProfile>.
+ *
+ * > Engine.StopProfiler()
+ *
+ * Availability:
+ *
+ *   alpha 34
+ *
+ * Status:
+ *
+ *   debug
+ */
+static int l_engine_stop_profiler(lua_State *l)
+{
+	LuaProfiler::Stop(Lua::manager->GetLuaState());
+	return 0;
+}
+
+/*
+ * Function: ResetProfiler
+ *
+ * Forget everything the profiler has recorded.
+ *
+ * > Engine.ResetProfiler()
+ *
+ * Availability:
+ *
+ *   alpha 34
+ *
+ * Status:
+ *
+ *   debug
+ */
+static int l_engine_reset_profiler(lua_State *l)
+{
+	LuaProfiler::Reset();
+	return 0;
+}
+
+/*
+ * Function: ProfilerReport
+ *
+ * Get the functions that took the most time, with their inclusive and
+ * exclusive times, followed by the same for every source file.
+ *
+ * > print(Engine.ProfilerReport(lines))
+ *
+ * Parameters:
+ *
+ *   lines - optional. the number of functions to list. The default is 20.
+ *
+ * Return:
+ *
+ *   report - the report as a string
+ *
+ * Availability:
+ *
+ *   alpha 34
+ *
+ * Status:
+ *
+ *   debug
+ */
+static int l_engine_profiler_report(lua_State *l)
+{
+	const int lines = luaL_optinteger(l, 1, 20);
+	const std::string report = LuaProfiler::Report(std::max(lines, 0));
+	lua_pushlstring(l, report.c_str(), report.size());
+	return 1;
+}
+
+/*
+ * Function: DumpProfile
+ *
+ * Write every stack the profiler has seen to a file in the user directory,
+ * in the collapsed format flame graph tools read.
+ *
+ * > Engine.DumpProfile(filename)
+ *
+ * Parameters:
+ *
+ *   filename - the file to write, relative to the user directory
+ *
+ * Return:
+ *
+ *   success - true if the file was written
+ *
+ * Availability:
+ *
+ *   alpha 34
+ *
+ * Status:
+ *
+ *   debug
+ */
+static int l_engine_dump_profile(lua_State *l)
+{
+	const std::string filename = luaL_checkstring(l, 1);
+	FILE *f = FileSystem::userFiles.OpenWriteStream(filename);
+	if (!f) {
+		lua_pushboolean(l, false);
+		return 1;
+	}
+	const bool ok = LuaProfiler::WriteCollapsed(f);
+	fclose(f);
+	lua_pushboolean(l, ok);
+	return 1;
+}
+
+/*
+ * Function: DumpTrace
+ *
+ * Write the engine's profiler zones, from every thread, to a file in the
+ * user directory as a Chrome trace (load it in chrome://tracing). Zones are
+ * only recorded while the debug info is shown, and only the latest few
+ * thousand of each thread are kept.
+ *
+ * > Engine.DumpTrace(filename)
+ *
+ * Parameters:
+ *
+ *   filename - the file to write, relative to the user directory
+ *
+ * Return:
+ *
+ *   success - true if the file was written
+ *
+ * Availability:
+ *
+ *   alpha 34
+ *
+ * Status:
+ *
+ *   debug
+ */
+static int l_engine_dump_trace(lua_State *l)
+{
+	const std::string filename = luaL_checkstring(l, 1);
+	FILE *f = FileSystem::userFiles.OpenWriteStream(filename);
+	if (!f) {
+		lua_pushboolean(l, false);
+		return 1;
+	}
+	const bool ok = Profiler::WriteTrace(f);
+	fclose(f);
+	lua_pushboolean(l, ok);
+	return 1;
+}
+
+/*
+ * Function: StartMemoryTracker
+ *
+ * Start charging every new Lua allocation to the line of Lua that made it,
+ * so <MemoryReport> can show what's holding on to memory. This slows
+ * everything down a lot. Only blocks allocated after it starts are seen.
+ *
+ * > Engine.StartMemoryTracker()
+ *
+ * Availability:
+ *
+ *   alpha 34
+ *
+ * Status:
+ *
+ *   debug
+ */
+static int l_engine_start_memory_tracker(lua_State *l)
+{
+	LuaMemoryTracker::Start(Lua::manager->GetLuaState());
+	return 0;
+}
+
+/*
+ * Function: StopMemoryTracker
+ *
+ * Stop tracking allocations. What was recorded is kept for <MemoryReport>,
+ * but blocks freed from now on aren't noticed.
+ *
+ * > Engine.StopMemoryTracker()
+ *
+ * Availability:
+ *
+ *   alpha 34
+ *
+ * Status:
+ *
+ *   debug
+ */
+static int l_engine_stop_memory_tracker(lua_State *l)
+{
+	LuaMemoryTracker::Stop(Lua::manager->GetLuaState());
+	return 0;
+}
+
+/*
+ * Function: MemorySnapshot
+ *
+ * Remember how much each line is holding right now. <MemoryReport> sorts
+ * by growth since the last snapshot.
+ *
+ * > Engine.MemorySnapshot()
+ *
+ * Availability:
+ *
+ *   alpha 34
+ *
+ * Status:
+ *
+ *   debug
+ */
+static int l_engine_memory_snapshot(lua_State *l)
+{
+	LuaMemoryTracker::Snapshot();
+	return 0;
+}
+
+/*
+ * Function: ResetMemoryTracker
+ *
+ * Forget every block and line the tracker knows about.
+ *
+ * > Engine.ResetMemoryTracker()
+ *
+ * Availability:
+ *
+ *   alpha 34
+ *
+ * Status:
+ *
+ *   debug
+ */
+static int l_engine_reset_memory_tracker(lua_State *l)
+{
+	LuaMemoryTracker::Reset();
+	return 0;
+}
+
+/*
+ * Function: MemoryReport
+ *
+ * Get the lines of Lua whose live allocations have grown the most since the
+ * last <MemorySnapshot>, with what they hold now, followed by the same for
+ * every source file.
+ *
+ * > print(Engine.MemoryReport(lines))
+ *
+ * Parameters:
+ *
+ *   lines - optional. the number of lines to list. The default is 20.
+ *
+ * Return:
+ *
+ *   report - the report as a string
+ *
+ * Availability:
+ *
+ *   alpha 34
+ *
+ * Status:
+ *
+ *   debug
+ */
+static int l_engine_memory_report(lua_State *l)
+{
+	const int lines = luaL_optinteger(l, 1, 20);
+	const std::string report = LuaMemoryTracker::Report(std::max(lines, 0));
+	lua_pushlstring(l, report.c_str(), report.size());
+	return 1;
+}
+
+/*
+ * Function: GetRendererStats
+ *
+ * Get what the renderer did in the last frame it finished.
+ *
+ * > local stats = Engine.GetRendererStats()
+ * > print(stats.draw_calls, stats.triangles)
+ *
+ * Return:
+ *
+ *   stats - a table of counts, keyed draw_calls, triangles,
+ *           vertices_uploaded, buffer_bytes_uploaded, texture_bytes_uploaded,
+ *           program_switches, texture_binds, state_changes and
+ *           render_target_switches
+ *
+ * Availability:
+ *
+ *   alpha 34
+ *
+ * Status:
+ *
+ *   debug
+ */
+static int l_engine_get_renderer_stats(lua_State *l)
+{
+	const Graphics::Stats &stats = Pi::renderer->GetStats();
+	lua_newtable(l);
+	for (int i = 0; i < Graphics::Stats::MAX_STAT; i++) {
+		const Graphics::Stats::StatType type = Graphics::Stats::StatType(i);
+		lua_pushstring(l, Graphics::Stats::GetName(type));
+		lua_pushinteger(l, stats.Get(type));
+		lua_rawset(l, -3);
+	}
+	return 1;
+}
+
+static void push_memory_stat(lua_State *l, const char *name, size_t current, size_t peak, size_t budget)
+{
+	lua_pushstring(l, name);
+	lua_newtable(l);
+	lua_pushnumber(l, double(current));
+	lua_setfield(l, -2, "current");
+	lua_pushnumber(l, double(peak));
+	lua_setfield(l, -2, "peak");
+	lua_pushnumber(l, double(budget));
+	lua_setfield(l, -2, "budget");
+	lua_rawset(l, -3);
+}
+
+/*
+ * Function: GetMemoryStats
+ *
+ * Get the bytes held by each of the engine's big memory users, and the most
+ * each has held since the peaks were last reset.
+ *
+ * > local mem = Engine.GetMemoryStats()
+ * > print(mem.textures.current, mem.textures.peak, mem.total.current)
+ *
+ * Parameters:
+ *
+ *   reset_peaks - optional. if true, the peaks start again from what's held
+ *                 now, after the stats are read
+ *
+ * Return:
+ *
+ *   stats - a table keyed terrain, terrain_vbo, models, textures,
+ *           star_systems, sectors, sfx, sound, saves and total, each a table
+ *           with current, peak and budget, in bytes. a budget of 0 is none
+ *
+ * Availability:
+ *
+ *   alpha 34
+ *
+ * Status:
+ *
+ *   debug
+ */
+static int l_engine_get_memory_stats(lua_State *l)
+{
+	const bool resetPeaks = lua_toboolean(l, 1);
+	lua_newtable(l);
+	for (int i = 0; i < MemoryStats::NUM_TAGS; i++) {
+		const MemoryStats::Tag tag = MemoryStats::Tag(i);
+		push_memory_stat(l, MemoryStats::GetName(tag),
+			MemoryStats::GetCurrent(tag), MemoryStats::GetPeak(tag), MemoryStats::GetBudget(tag));
+	}
+	push_memory_stat(l, "total", MemoryStats::GetTotal(), MemoryStats::GetTotalPeak(), 0);
+	if (resetPeaks)
+		MemoryStats::ResetPeaks();
+	return 1;
+}
+
 // XXX hack to allow the new UI to activate the old settings view
 //     remove once its been converted
 static int l_engine_settings_view(lua_State *l)
@@ -142,6 +541,19 @@ void LuaEngine::Register()
 	static const luaL_Reg l_methods[] = {
 		{ "Quit", l_engine_quit },
 		{ "SettingsView", l_engine_settings_view },
+		{ "StartProfiler",  l_engine_start_profiler  },
+		{ "StopProfiler",   l_engine_stop_profiler   },
+		{ "ResetProfiler",  l_engine_reset_profiler  },
+		{ "ProfilerReport", l_engine_profiler_report },
+		{ "DumpProfile",    l_engine_dump_profile    },
+		{ "DumpTrace",      l_engine_dump_trace      },
+		{ "StartMemoryTracker", l_engine_start_memory_tracker },
+		{ "StopMemoryTracker",  l_engine_stop_memory_tracker  },
+		{ "MemorySnapshot",     l_engine_memory_snapshot      },
+		{ "ResetMemoryTracker", l_engine_reset_memory_tracker },
+		{ "MemoryReport",       l_engine_memory_report        },
+		{ "GetRendererStats", l_engine_get_renderer_stats },
+		{ "GetMemoryStats",   l_engine_get_memory_stats   },
 		{ 0, 0 }
 	};
 
@@ -6,9 +6,25 @@
 #include "LuaManager.h"
 #include "LuaObject.h"
 #include "LuaUtils.h"
+#include "Profiler.h"
+#include <set>
 
 namespace LuaEvent {
 
+// only ever describe the state of something right now, so if one is still
+// waiting when the same one comes along there's no need for the second
+static const char *s_coalescedEvents[] = {
+	"onFrameChanged",
+	"onShipAlertChanged",
+	"onShipFuelChanged",
+	0
+};
+
+// the coalesced events queued since the last Emit, by name and arguments
+static std::set<std::string> s_pendingCoalesced;
+
+static Uint32 s_queuedCount = 0;
+
 static void _get_method_onto_stack(lua_State *l, const char *method) {
 	LUA_DEBUG_START(l);
 
@@ -29,8 +45,48 @@ static void _get_method_onto_stack(lua_State *l, const char *method) {
 	LUA_DEBUG_END(l, 1);
 }
 
+static bool _is_coalesced(const char *event)
+{
+	for (const char **e = s_coalescedEvents; *e; e++)
+		if (strcmp(*e, event) == 0) return true;
+	return false;
+}
+
+// Event._listeners counts the callbacks registered for each event. it's the
+// same table for as long as the state lives, so a reference is kept
+static bool _has_listeners(lua_State *l, const char *event)
+{
+	LUA_DEBUG_START(l);
+
+	lua_getfield(l, LUA_REGISTRYINDEX, "PiEventListeners");
+	if (lua_isnil(l, -1)) {
+		lua_pop(l, 1);
+		lua_rawgeti(l, LUA_REGISTRYINDEX, LUA_RIDX_GLOBALS);
+		lua_pushstring(l, "Event");
+		lua_rawget(l, -2);
+		assert(lua_istable(l, -1));
+		lua_pushstring(l, "_listeners");
+		lua_rawget(l, -2);
+		assert(lua_istable(l, -1));
+		lua_insert(l, -3);
+		lua_pop(l, 2);
+		lua_pushvalue(l, -1);
+		lua_setfield(l, LUA_REGISTRYINDEX, "PiEventListeners");
+	}
+
+	lua_getfield(l, -1, event);
+	const bool listened = !lua_isnil(l, -1);
+	lua_pop(l, 2);
+
+	LUA_DEBUG_END(l, 0);
+
+	return listened;
+}
+
 void Clear()
 {
+	s_pendingCoalesced.clear();
+
 	lua_State *l = Lua::manager->GetLuaState();
 
 	LUA_DEBUG_START(l);
@@ -41,6 +97,11 @@ void Clear()
 
 void Emit()
 {
+	PROFILE_ZONE("LuaEvent::Emit");
+
+	// anything queued while the handlers run is a new event
+	s_pendingCoalesced.clear();
+
 	lua_State *l = Lua::manager->GetLuaState();
 
 	LUA_DEBUG_START(l);
@@ -49,10 +110,28 @@ void Emit()
 	LUA_DEBUG_END(l, 0);
 }
 
+Uint32 GetQueuedCount()
+{
+	return s_queuedCount;
+}
+
 void Queue(const char *event, const ArgsBase &args)
 {
 	lua_State *l = Lua::manager->GetLuaState();
 
+	if (!_has_listeners(l, event))
+		return;
+
+	if (_is_coalesced(event)) {
+		std::string key(event);
+		key.push_back('\0');
+		args.AppendKey(key);
+		if (!s_pendingCoalesced.insert(key).second)
+			return;
+	}
+
+	s_queuedCount++;
+
 	LUA_DEBUG_START(l);
 	_get_method_onto_stack(l, "Queue");
 
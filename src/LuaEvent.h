@@ -8,7 +8,12 @@
 #include "LuaObject.h"
 #include "DeleteEmitter.h"
 #include "Pi.h"
+#include <string>
 
+// events are only queued if some script has registered for them, so the
+// arguments are never pushed into Lua for events nobody hears. a few events
+// that say "this is how things are now" are coalesced: queueing one that's
+// already waiting with the same arguments does nothing
 namespace LuaEvent {
 
 	class ArgsBase {
@@ -16,6 +21,19 @@ namespace LuaEvent {
 		virtual ~ArgsBase() {}
 
 		virtual void PrepareStack() const = 0;
+
+		// something that's the same for the same arguments, to find
+		// duplicates of coalesced events
+		virtual void AppendKey(std::string &key) const = 0;
+
+	protected:
+		static void AppendPointer(std::string &key, const void *p) {
+			key.append(reinterpret_cast<const char*>(&p), sizeof(p));
+		}
+		static void AppendString(std::string &key, const char *s) {
+			if (s) key.append(s);
+			key.push_back('\0');
+		}
 	};
 
 	template <typename T0=void, typename T1=void>
@@ -31,6 +49,11 @@ namespace LuaEvent {
 			LuaObject<T0>::PushToLua(arg0);
 			LuaObject<T1>::PushToLua(arg1);
 		}
+
+		void AppendKey(std::string &key) const {
+			AppendPointer(key, arg0);
+			AppendPointer(key, arg1);
+		}
 	};
 
 	template <typename T0>
@@ -44,6 +67,10 @@ namespace LuaEvent {
 		inline void PrepareStack() const {
 			LuaObject<T0>::PushToLua(arg0);
 		}
+
+		void AppendKey(std::string &key) const {
+			AppendPointer(key, arg0);
+		}
 	};
 
 	template <typename T0>
@@ -59,6 +86,11 @@ namespace LuaEvent {
 			LuaObject<T0>::PushToLua(arg0);
 			lua_pushstring(Lua::manager->GetLuaState(), arg1);
 		}
+
+		void AppendKey(std::string &key) const {
+			AppendPointer(key, arg0);
+			AppendString(key, arg1);
+		}
 	};
 
 	template <>
@@ -68,11 +100,16 @@ namespace LuaEvent {
 		virtual ~Args() {}
 
 		inline void PrepareStack() const {}
+
+		void AppendKey(std::string &) const {}
 	};
 
 	void Clear();
 	void Emit();
 
+	// events queued, ever. repeats of coalesced ones are left out
+	Uint32 GetQueuedCount();
+
 	void Queue(const char *event, const ArgsBase &args);
 
 	template <typename T0, typename T1>
@@ -3,17 +3,36 @@
 
 #include "LuaManager.h"
 #include "FileSystem.h"
+#include "LuaMemoryTracker.h"
+#include "OS.h"
 #include <cstdlib>
 
 bool instantiated = false;
 
-LuaManager::LuaManager() : m_lua(0) {
+// Lua's defaults
+static const int DEFAULT_GC_PAUSE = 200;
+
+// past this many times the threshold the budget is ignored and the cycle
+// finished, so a burst of garbage can't outrun the collector for good
+static const size_t GC_RUNAWAY_FACTOR = 2;
+
+LuaManager::LuaManager() :
+	m_allocator(0),
+	m_lua(0),
+	m_gcBudget(0),
+	m_gcPause(DEFAULT_GC_PAUSE),
+	m_gcInCycle(false),
+	m_gcThreshold(0),
+	m_gcTime(0),
+	m_gcSteps(0)
+{
 	if (instantiated) {
 		fprintf(stderr, "Can't instantiate more than one LuaManager");
 		abort();
 	}
 
-	m_lua = luaL_newstate();
+	m_allocator = new LuaAllocator;
+	m_lua = lua_newstate(LuaAllocator::Alloc, m_allocator);
 	pi_lua_open_standard_base(m_lua);
 	lua_atpanic(m_lua, pi_lua_panic);
 
@@ -21,7 +40,12 @@ LuaManager::LuaManager() : m_lua(0) {
 }
 
 LuaManager::~LuaManager() {
+	if (LuaMemoryTracker::IsRunning()) {
+		LuaMemoryTracker::Stop(m_lua);
+		LuaMemoryTracker::Reset();
+	}
 	lua_close(m_lua);
+	delete m_allocator;
 
 	instantiated = false;
 }
@@ -34,4 +58,56 @@ size_t LuaManager::GetMemoryUsage() const {
 
 void LuaManager::CollectGarbage() {
 	lua_gc(m_lua, LUA_GCCOLLECT, 0);
+	EndGCCycle();
+}
+
+void LuaManager::SetGCPacing(int pause, int stepMul) {
+	m_gcPause = pause;
+	lua_gc(m_lua, LUA_GCSETPAUSE, pause);
+	lua_gc(m_lua, LUA_GCSETSTEPMUL, stepMul);
+}
+
+void LuaManager::SetGCBudget(Uint32 maxMicroseconds) {
+	m_gcBudget = maxMicroseconds;
+	if (m_gcBudget) {
+		lua_gc(m_lua, LUA_GCSTOP, 0);
+		EndGCCycle();
+	}
+	else
+		lua_gc(m_lua, LUA_GCRESTART, 0);
+}
+
+void LuaManager::EndGCCycle() {
+	m_gcInCycle = false;
+	m_gcThreshold = (GetMemoryUsage() / 100) * m_gcPause;
+}
+
+void LuaManager::StepGarbage() {
+	if (!m_gcBudget) return;
+
+	// nothing to do until there's been enough allocation since the last
+	// cycle, same as Lua's own pause
+	if (!m_gcInCycle && GetMemoryUsage() < m_gcThreshold)
+		return;
+	m_gcInCycle = true;
+
+	const Uint64 freq = OS::HFTimerFreq();
+	const Uint64 budget = (Uint64(m_gcBudget) * freq) / 1000000;
+	const Uint64 start = OS::HFTimer();
+
+	const bool runaway = GetMemoryUsage() > m_gcThreshold * GC_RUNAWAY_FACTOR;
+
+	// a step with size 0 is the smallest amount of work Lua will do, scaled
+	// by the step multiplier. at least one is always done
+	Uint64 elapsed;
+	do {
+		m_gcSteps++;
+		if (lua_gc(m_lua, LUA_GCSTEP, 0)) {
+			EndGCCycle();
+			break;
+		}
+		elapsed = OS::HFTimer() - start;
+	} while (runaway || elapsed < budget);
+
+	m_gcTime += ((OS::HFTimer() - start) * 1000000) / freq;
 }
@@ -5,6 +5,7 @@
 #define _LUAMANAGER_H
 
 #include "LuaUtils.h"
+#include "LuaAllocator.h"
 
 class LuaManager {
 public:
@@ -15,11 +16,43 @@ public:
 	size_t GetMemoryUsage() const;
 	void CollectGarbage();
 
+	const LuaAllocator::Stats &GetAllocStats() { return m_allocator->GetStats(); }
+	void ResetAllocCounts() { m_allocator->ResetCounts(); }
+
+	// in bytes, 0 for no limit. see LuaAllocator
+	void SetMemoryLimits(size_t soft, size_t hard) { m_allocator->SetLimits(soft, hard); }
+
+	// pause and step multiplier as Lua has them, in percent. with a budget
+	// the pause is applied here instead, between the cycles StepGarbage runs
+	void SetGCPacing(int pause, int stepMul);
+	// microseconds of collection each StepGarbage call may do. with a budget
+	// Lua's own collector is stopped and only runs from StepGarbage, so it
+	// has to be called every frame. 0 hands the pacing back to Lua
+	void SetGCBudget(Uint32 maxMicroseconds);
+	void StepGarbage();
+
+	// microseconds spent in StepGarbage since the last reset
+	Uint64 GetGCTime() const { return m_gcTime; }
+	void ResetGCTime() { m_gcTime = 0; }
+
+	// collector steps StepGarbage has run, ever
+	Uint32 GetGCSteps() const { return m_gcSteps; }
+
 private:
 	LuaManager(const LuaManager &);
 	LuaManager &operator=(const LuaManager &);
 
+	void EndGCCycle();
+
+	LuaAllocator *m_allocator; // outlives m_lua
 	lua_State *m_lua;
+
+	Uint32 m_gcBudget;
+	int m_gcPause;
+	bool m_gcInCycle;
+	size_t m_gcThreshold; // memory use that starts the next cycle
+	Uint64 m_gcTime;
+	Uint32 m_gcSteps;
 };
 
 #endif
@@ -0,0 +1,234 @@
+// Copyright © 2008-2013 Pioneer Developers. See AUTHORS.txt for details
+// Licensed under the terms of the GPL v3. See licenses/GPL-3.txt
+
+#include "libs.h"
+#include "LuaMemoryTracker.h"
+#include "LuaAllocator.h"
+#include <map>
+#include <vector>
+#include <algorithm>
+
+namespace LuaMemoryTracker {
+
+struct Site {
+	Site(const std::string &_name, const std::string &_file) : name(_name), file(_file), bytes(0), blocks(0), snapshot(0) {}
+	std::string name; // "file:line"
+	std::string file;
+	size_t bytes;     // held right now
+	Uint32 blocks;
+	size_t snapshot;  // bytes at the last snapshot
+};
+
+struct Block {
+	Uint32 site;
+	size_t size;
+};
+
+// far enough up the stack to get out of any C functions in the way
+static const int MAX_SEARCH_LEVELS = 8;
+
+static bool s_running = false;
+static lua_State *s_lua = 0;
+static lua_State *s_thread = 0;
+
+static std::vector<Site> s_sites;
+static std::map<std::string,Uint32> s_siteIndex;
+static std::map<const void*,Block> s_blocks;
+
+static void set_tracking(lua_State *l, bool tracking)
+{
+	void *ud;
+	if (lua_getallocf(l, &ud) == LuaAllocator::Alloc)
+		static_cast<LuaAllocator*>(ud)->SetTracking(tracking);
+}
+
+void Start(lua_State *l)
+{
+	s_lua = l;
+	s_thread = 0;
+	s_running = true;
+	set_tracking(l, true);
+}
+
+void Stop(lua_State *l)
+{
+	set_tracking(l, false);
+	s_running = false;
+	s_lua = s_thread = 0;
+}
+
+bool IsRunning()
+{
+	return s_running;
+}
+
+void SetThread(lua_State *thread)
+{
+	s_thread = thread;
+}
+
+void Snapshot()
+{
+	for (std::vector<Site>::iterator i = s_sites.begin(); i != s_sites.end(); ++i)
+		(*i).snapshot = (*i).bytes;
+}
+
+void Reset()
+{
+	s_sites.clear();
+	s_siteIndex.clear();
+	s_blocks.clear();
+}
+
+static std::string source_file(const char *source)
+{
+	if (strncmp(source, "[T] ", 4) == 0) source += 4;
+	if (source[0] == '@') return std::string(source+1);
+	return std::string("[string]");
+}
+
+// the line that wants memory right now. nothing here allocates from Lua;
+// lua_getstack and lua_getinfo without '>', 'f' or 'L' only read
+static Uint32 current_site()
+{
+	lua_State *l = s_thread ? s_thread : s_lua;
+
+	std::string file("[C]");
+	int line = -1;
+
+	lua_Debug ar;
+	for (int level = 0; level < MAX_SEARCH_LEVELS && lua_getstack(l, level, &ar); level++) {
+		lua_getinfo(l, "Sl", &ar);
+		if (ar.currentline >= 0) {
+			file = source_file(ar.source);
+			line = ar.currentline;
+			break;
+		}
+	}
+
+	char buf[16];
+	snprintf(buf, sizeof(buf), ":%d", line);
+	const std::string name = file + buf;
+
+	std::map<std::string,Uint32>::iterator i = s_siteIndex.find(name);
+	if (i != s_siteIndex.end())
+		return (*i).second;
+
+	s_sites.push_back(Site(name, file));
+	s_siteIndex.insert(std::make_pair(name, Uint32(s_sites.size()-1)));
+	return s_sites.size()-1;
+}
+
+void Allocated(const void *p, size_t size)
+{
+	Block b;
+	b.site = current_site();
+	b.size = size;
+	s_blocks[p] = b;
+
+	s_sites[b.site].bytes += size;
+	s_sites[b.site].blocks++;
+}
+
+void Resized(const void *oldPtr, const void *newPtr, size_t size)
+{
+	std::map<const void*,Block>::iterator i = s_blocks.find(oldPtr);
+	if (i == s_blocks.end()) {
+		// from before we started, so we've no idea whose it was
+		Allocated(newPtr, size);
+		return;
+	}
+
+	Block b = (*i).second;
+	Site &site = s_sites[b.site];
+	site.bytes -= b.size;
+	site.bytes += size;
+	b.size = size;
+
+	if (oldPtr != newPtr) {
+		s_blocks.erase(i);
+		s_blocks[newPtr] = b;
+	}
+	else
+		(*i).second = b;
+}
+
+void Freed(const void *p)
+{
+	std::map<const void*,Block>::iterator i = s_blocks.find(p);
+	if (i == s_blocks.end())
+		return;
+
+	Site &site = s_sites[(*i).second.site];
+	site.bytes -= (*i).second.size;
+	site.blocks--;
+	s_blocks.erase(i);
+}
+
+struct Growth {
+	Growth(const std::string &_name) : name(_name), bytes(0), blocks(0), growth(0) {}
+	std::string name;
+	size_t bytes;
+	Uint32 blocks;
+	Sint64 growth;
+
+	bool operator<(const Growth &a) const { return growth > a.growth || (growth == a.growth && bytes > a.bytes); }
+};
+
+static void report_section(std::string &out, const char *title, std::vector<Growth> &entries, unsigned int maxLines)
+{
+	std::sort(entries.begin(), entries.end());
+
+	char buf[64];
+	snprintf(buf, sizeof(buf), "%10s %10s %8s  %s\n", "held KB", "growth KB", "blocks", title);
+	out += buf;
+	for (size_t i = 0; i < entries.size() && i < maxLines; i++) {
+		snprintf(buf, sizeof(buf), "%10.1f %+10.1f %8u  ", entries[i].bytes / 1024.0, entries[i].growth / 1024.0, entries[i].blocks);
+		out += buf;
+		out += entries[i].name;
+		out += '\n';
+	}
+}
+
+std::string Report(unsigned int maxLines)
+{
+	std::vector<Growth> lines;
+	std::map<std::string,Growth> files;
+	size_t total = 0;
+	Sint64 totalGrowth = 0;
+
+	for (std::vector<Site>::const_iterator i = s_sites.begin(); i != s_sites.end(); ++i) {
+		const Sint64 growth = Sint64((*i).bytes) - Sint64((*i).snapshot);
+		if (!(*i).bytes && !growth) continue;
+
+		lines.push_back(Growth((*i).name));
+		lines.back().bytes = (*i).bytes;
+		lines.back().blocks = (*i).blocks;
+		lines.back().growth = growth;
+
+		Growth &file = files.insert(std::make_pair((*i).file, Growth((*i).file))).first->second;
+		file.bytes += (*i).bytes;
+		file.blocks += (*i).blocks;
+		file.growth += growth;
+
+		total += (*i).bytes;
+		totalGrowth += growth;
+	}
+
+	char buf[96];
+	snprintf(buf, sizeof(buf), "%.1f KB held by tracked blocks, %+.1f KB since the snapshot%s\n\n",
+		total / 1024.0, totalGrowth / 1024.0, s_running ? "" : " (stopped)");
+	std::string out(buf);
+
+	report_section(out, "line", lines, maxLines);
+	out += '\n';
+
+	std::vector<Growth> fileList;
+	for (std::map<std::string,Growth>::const_iterator i = files.begin(); i != files.end(); ++i)
+		fileList.push_back((*i).second);
+	report_section(out, "file", fileList, ~0u);
+
+	return out;
+}
+
+}
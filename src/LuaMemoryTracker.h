@@ -0,0 +1,49 @@
+// Copyright © 2008-2013 Pioneer Developers. See AUTHORS.txt for details
+// Licensed under the terms of the GPL v3. See licenses/GPL-3.txt
+
+#ifndef _LUAMEMORYTRACKER_H
+#define _LUAMEMORYTRACKER_H
+
+#include "lua/lua.hpp"
+#include <string>
+
+// finds out where the Lua heap is going. while it runs, LuaAllocator tells
+// it about every block, and each new block is charged to the Lua line that
+// asked for it (the nearest Lua function on the stack, so a string.rep is
+// charged to whoever called it). blocks keep their line when they're
+// resized, and give their bytes back when they're freed, so what's left is
+// what each line is holding on to. a snapshot remembers where everything
+// stood, and the report sorts lines by how much they've grown since.
+//
+// it's slow (every allocation looks at the Lua stack and goes in a map) and
+// only knows about blocks allocated since it was started, so it's for
+// hunting leaks, not for leaving on
+namespace LuaMemoryTracker {
+
+	void Start(lua_State *l);
+	void Stop(lua_State *l);
+	bool IsRunning();
+
+	// the thread whose stack new blocks are charged to. normally the main
+	// state; LuaTimer points it at each task while it runs. 0 for the main
+	// state
+	void SetThread(lua_State *thread);
+
+	// remember the current bytes held by each line, for the report's growth
+	void Snapshot();
+
+	// forget every block and line. the next report only sees blocks
+	// allocated after this
+	void Reset();
+
+	// the lines that have grown the most since the last snapshot, and every
+	// source file, as text for the console
+	std::string Report(unsigned int maxLines);
+
+	// from LuaAllocator
+	void Allocated(const void *p, size_t size);
+	void Resized(const void *oldPtr, const void *newPtr, size_t size);
+	void Freed(const void *p);
+}
+
+#endif
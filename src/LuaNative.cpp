@@ -0,0 +1,234 @@
+// Copyright © 2008-2013 Pioneer Developers. See AUTHORS.txt for details
+// Licensed under the terms of the GPL v3. See licenses/GPL-3.txt
+
+#include "LuaNative.h"
+#include "LuaUtils.h"
+#include <cstring>
+
+// string.interp (StringInterp.lua)
+//
+//   s:gsub('(%b{})', function(w) return t[w:sub(2,-2)] or w end)
+//
+// matched the same way %b{} matches: an unbalanced { is copied through and
+// the scan carries on from the next character. lookups go through the
+// usual metamethods, and replacement values are treated as gsub treats
+// them, so false/nil keeps the original text and numbers are stringified
+static int l_string_interp(lua_State *l)
+{
+	size_t len;
+	const char *s = luaL_checklstring(l, 1, &len);
+	const char *end = s + len;
+	lua_settop(l, 2);
+
+	luaL_Buffer b;
+	luaL_buffinit(l, &b);
+
+	const char *p = s;
+	while (p < end) {
+		if (*p != '{') {
+			const char *next = static_cast<const char*>(memchr(p, '{', end - p));
+			if (!next) next = end;
+			luaL_addlstring(&b, p, next - p);
+			p = next;
+			continue;
+		}
+
+		const char *close = 0;
+		int depth = 1;
+		for (const char *q = p+1; q < end; q++) {
+			if (*q == '}') {
+				if (--depth == 0) { close = q; break; }
+			}
+			else if (*q == '{')
+				depth++;
+		}
+
+		if (!close) {
+			luaL_addchar(&b, *p);
+			p++;
+			continue;
+		}
+
+		lua_pushlstring(l, p+1, close-p-1);
+		lua_gettable(l, 2);
+		if (lua_isstring(l, -1))
+			luaL_addvalue(&b);
+		else if (!lua_toboolean(l, -1)) {
+			lua_pop(l, 1);
+			luaL_addlstring(&b, p, close-p+1);
+		}
+		else
+			return luaL_error(l, "invalid replacement value (a %s)", luaL_typename(l, -1));
+
+		p = close+1;
+	}
+
+	luaL_pushresult(&b);
+	return 1;
+}
+
+// build_array (00-utils.lua)
+//
+//   while true do
+//     k, v = f(s, k)
+//     if k == nil then break end
+//     table.insert(t, v)
+//   end
+//
+// table.insert with a nil value is a no-op, so a nil doesn't take a slot
+static int l_build_array(lua_State *l)
+{
+	lua_settop(l, 3);
+	lua_newtable(l);
+	int n = 0;
+	while (true) {
+		lua_pushvalue(l, 1);
+		lua_pushvalue(l, 2);
+		lua_pushvalue(l, 3);
+		lua_call(l, 2, 2);
+		if (lua_isnil(l, -2)) {
+			lua_pop(l, 2);
+			break;
+		}
+		if (lua_isnil(l, -1))
+			lua_pop(l, 1);
+		else
+			lua_rawseti(l, 4, ++n);
+		lua_replace(l, 3);
+	}
+	return 1;
+}
+
+// dictionary[lang] and dictionary[lang][token], or nothing if either is
+// false/nil. leaves one value on the stack
+static void push_translation(lua_State *l, int dictionary, int lang, int token)
+{
+	lua_pushvalue(l, lang);
+	lua_gettable(l, dictionary);
+	if (lua_toboolean(l, -1)) {
+		lua_pushvalue(l, token);
+		lua_gettable(l, -2);
+		lua_remove(l, -2);
+	}
+}
+
+// the function Translate:GetTranslator hands back
+//
+//   (self.dictionary[self.language] and self.dictionary[self.language][token]) or
+//   (self.dictionary.English and self.dictionary.English[token]) or
+//   token
+static int l_translate_lookup(lua_State *l)
+{
+	lua_settop(l, 1);
+	const int self = lua_upvalueindex(1);
+
+	lua_getfield(l, self, "dictionary");  // 2
+	lua_getfield(l, self, "language");    // 3
+	push_translation(l, 2, 3, 1);
+	if (lua_toboolean(l, -1))
+		return 1;
+	lua_pop(l, 1);
+
+	lua_pushstring(l, "English");
+	push_translation(l, 2, lua_gettop(l), 1);
+	if (lua_toboolean(l, -1))
+		return 1;
+
+	lua_pushvalue(l, 1);
+	return 1;
+}
+
+// Translate:GetTranslator (Translate.lua)
+static int l_translate_get_translator(lua_State *l)
+{
+	lua_settop(l, 1);
+	lua_pushcclosure(l, l_translate_lookup, 1);
+	return 1;
+}
+
+struct NativeFunction {
+	const char *name;
+	lua_CFunction func;
+};
+
+static const NativeFunction s_natives[] = {
+	{ "string.interp",            l_string_interp },
+	{ "build_array",              l_build_array },
+	{ "Translate.GetTranslator",  l_translate_get_translator },
+	{ 0, 0 }
+};
+
+static const char *ORIGINALS = "PiNativeOriginals";
+
+// push the table at the end of a dotted path and return the last part of
+// the name, or push nothing and return 0 if some part of it isn't a table
+static const char *push_owner(lua_State *l, const char *name)
+{
+	lua_rawgeti(l, LUA_REGISTRYINDEX, LUA_RIDX_GLOBALS);
+	const char *part = name;
+	const char *dot;
+	while ((dot = strchr(part, '.'))) {
+		lua_pushlstring(l, part, dot-part);
+		lua_rawget(l, -2);
+		lua_remove(l, -2);
+		if (!lua_istable(l, -1)) {
+			lua_pop(l, 1);
+			return 0;
+		}
+		part = dot+1;
+	}
+	return part;
+}
+
+void LuaNative::Install(lua_State *l)
+{
+	LUA_DEBUG_START(l);
+
+	lua_getfield(l, LUA_REGISTRYINDEX, ORIGINALS);
+	if (lua_isnil(l, -1)) {
+		lua_pop(l, 1);
+		lua_newtable(l);
+		lua_pushvalue(l, -1);
+		lua_setfield(l, LUA_REGISTRYINDEX, ORIGINALS);
+	}
+
+	for (const NativeFunction *n = s_natives; n->name; n++) {
+		const char *field = push_owner(l, n->name);
+		if (!field) continue;
+
+		lua_getfield(l, -1, field);
+		if (!lua_isfunction(l, -1) || lua_iscfunction(l, -1)) {
+			// not defined, or already replaced
+			lua_pop(l, 2);
+			continue;
+		}
+		lua_setfield(l, -3, n->name);
+
+		lua_pushcfunction(l, n->func);
+		lua_setfield(l, -2, field);
+		lua_pop(l, 1);
+	}
+
+	lua_pop(l, 1);
+
+	LUA_DEBUG_END(l, 0);
+}
+
+void LuaNative::PushOriginal(lua_State *l, const char *name)
+{
+	lua_getfield(l, LUA_REGISTRYINDEX, ORIGINALS);
+	if (lua_isnil(l, -1))
+		return;
+	lua_getfield(l, -1, name);
+	lua_remove(l, -2);
+}
+
+void LuaNative::PushNative(lua_State *l, const char *name)
+{
+	for (const NativeFunction *n = s_natives; n->name; n++)
+		if (strcmp(n->name, name) == 0) {
+			lua_pushcfunction(l, n->func);
+			return;
+		}
+	lua_pushnil(l);
+}
@@ -0,0 +1,28 @@
+// Copyright © 2008-2013 Pioneer Developers. See AUTHORS.txt for details
+// Licensed under the terms of the GPL v3. See licenses/GPL-3.txt
+
+#ifndef _LUANATIVE_H
+#define _LUANATIVE_H
+
+#include "lua/lua.hpp"
+
+// native versions of hot functions from data/libs. each one does exactly
+// what the Lua definition does, just without the interpreter overhead.
+// they're swapped in over the top of the Lua ones once the libs have
+// loaded, and the Lua ones are kept so they can be compared (see
+// Dev.BenchmarkNative)
+namespace LuaNative {
+	// replace every function we have a native version of. names are
+	// dotted paths from the globals table (eg "string.interp"). anything
+	// the libs didn't define is left alone
+	void Install(lua_State *l);
+
+	// push the original Lua definition of a replaced function, or nil if
+	// it wasn't replaced
+	void PushOriginal(lua_State *l, const char *name);
+
+	// push the native version of a function, or nil if there isn't one
+	void PushNative(lua_State *l, const char *name);
+}
+
+#endif
@@ -99,6 +99,16 @@ static void _teardown() {
 	delete promotions;
 }
 
+// a reference to LuaObjectRegistry, so the per-push lookup of it is an array
+// index instead of a string lookup in the registry
+static int s_objectRegistryRef = LUA_NOREF;
+
+static inline void _push_object_registry(lua_State *l) {
+	assert(s_objectRegistryRef != LUA_NOREF);
+	lua_rawgeti(l, LUA_REGISTRYINDEX, s_objectRegistryRef);
+	assert(lua_istable(l, -1));
+}
+
 static inline void _instantiate() {
 	if (!instantiated) {
 		promotions = new std::map< std::string, std::map<std::string,PromotionTest> >;
@@ -295,6 +305,7 @@ int LuaObjectBase::l_dispatch_index(lua_State *l)
 
 		// first check properties. we don't need to drill through lua if the
 		// property is already available
+		if (PropertyMap::HaveUnsynced()) PropertyMap::SyncAll();
 		lua_getuservalue(l, 1);
 		if (!lua_isnil(l, -1)) {
 			lua_pushvalue(l, 2);
@@ -419,6 +430,7 @@ void LuaObjectBase::GetNames(std::vector<std::string> &names, const std::string
 
 	// properties
 	if (!methodsOnly) {
+		if (PropertyMap::HaveUnsynced()) PropertyMap::SyncAll();
 		lua_getuservalue(l, -1);
 		if (!lua_isnil(l, -1))
 			get_names_from_table(l, names, prefix, false);
@@ -546,7 +558,13 @@ void LuaObjectBase::CreateClass(const char *type, const char *parent, const luaL
 		lua_rawset(l, -3);
 		lua_setmetatable(l, -2);
 
+		lua_pushvalue(l, -1);
 		lua_setfield(l, LUA_REGISTRYINDEX, "LuaObjectRegistry");
+		s_objectRegistryRef = LUA_NOREF;
+	}
+	if (s_objectRegistryRef == LUA_NOREF) {
+		lua_pushvalue(l, -1);
+		s_objectRegistryRef = luaL_ref(l, LUA_REGISTRYINDEX);
 	}
 	lua_pop(l, 1);
 
@@ -638,11 +656,10 @@ bool LuaObjectBase::PushRegistered(LuaWrappable *o)
 		return true;
 	}
 
-	lua_getfield(l, LUA_REGISTRYINDEX, "LuaObjectRegistry");
-	assert(lua_istable(l, -1));
+	_push_object_registry(l);
 
 	lua_pushlightuserdata(l, o);
-	lua_gettable(l, -2);
+	lua_rawget(l, -2);
 
 	if (lua_isuserdata(l, -1)) {
 		lua_insert(l, -2);
@@ -661,7 +678,7 @@ bool LuaObjectBase::PushRegistered(LuaWrappable *o)
 	return false;
 }
 
-void LuaObjectBase::Register(LuaObjectBase *lo)
+void LuaObjectBase::Register(LuaObjectBase *lo, bool mapObject)
 {
 	assert(instantiated);
 	assert(lo->GetObject());
@@ -695,14 +712,15 @@ void LuaObjectBase::Register(LuaObjectBase *lo)
 
 	LUA_DEBUG_START(l);                                         // lo userdata
 
-	lua_getfield(l, LUA_REGISTRYINDEX, "LuaObjectRegistry");    // lo userdata, registry table
-	assert(lua_istable(l, -1));
+	if (mapObject) {
+		_push_object_registry(l);                               // lo userdata, registry table
 
-	lua_pushlightuserdata(l, lo->GetObject());                  // lo userdata, registry table, o lightuserdata
-	lua_pushvalue(l, -3);                                       // lo userdata, registry table, o lightuserdata, lo userdata
-	lua_settable(l, -3);                                        // lo userdata, registry table
+		lua_pushlightuserdata(l, lo->GetObject());              // lo userdata, registry table, o lightuserdata
+		lua_pushvalue(l, -3);                                   // lo userdata, registry table, o lightuserdata, lo userdata
+		lua_rawset(l, -3);                                      // lo userdata, registry table
 
-	lua_pop(l, 1);                                              // lo userdata
+		lua_pop(l, 1);                                          // lo userdata
+	}
 
 	luaL_getmetatable(l, lo->m_type);                           // lo userdata, lo metatable
 	lua_setmetatable(l, -2);                                    // lo userdata
@@ -725,12 +743,21 @@ void LuaObjectBase::Deregister(LuaObjectBase *lo)
 
 	LUA_DEBUG_START(l);
 
-	lua_getfield(l, LUA_REGISTRYINDEX, "LuaObjectRegistry");
-	assert(lua_istable(l, -1));
+	_push_object_registry(l);
 
+	// only if it's still ours. the object might have been deleted and its
+	// memory reused for something with a wrapper of its own, and copies are
+	// never in here at all
 	lua_pushlightuserdata(l, o);
-	lua_pushnil(l);
-	lua_rawset(l, -3);
+	lua_rawget(l, -2);
+	const bool ours = lua_touserdata(l, -1) == lo;
+	lua_pop(l, 1);
+
+	if (ours) {
+		lua_pushlightuserdata(l, o);
+		lua_pushnil(l);
+		lua_rawset(l, -3);
+	}
 
 	lua_pop(l, 1);
 
@@ -101,8 +101,9 @@ protected:
 
 	// adds an object->wrapper mapping to the registry for the given wrapper
 	// object. the wrapper's corresponding userdata should be on the top of
-	// the stack
-	static void Register(LuaObjectBase *lo);
+	// the stack. copies are never looked up, so they skip the mapping and
+	// just get their metatable
+	static void Register(LuaObjectBase *lo, bool mapObject = true);
 
 	// remove the object->wrapper from the registry. checks to make sure the
 	// the mapping matches first, to protect against memory being reused
@@ -249,29 +250,19 @@ private:
 
 // wrapper for a "copied" object. a new one is created via the copy
 // constructor and fully owned by Lua. good for lightweight POD-style objects
-// (eg SystemPath)
+// (eg SystemPath). the copy lives inside the wrapper, so each push is one
+// userdata and nothing else
 template <typename T>
 class LuaCopyObject : public LuaObject<T> {
 public:
-	LuaCopyObject(const T &o) {
-		lua_State *l = Lua::manager->GetLuaState();
-		m_object = new (LuaObjectBase::Allocate(sizeof(T))) T(o);
-		m_ref = LuaRef(l, -1);
-		lua_pop(l, 1);
-	}
-
-	~LuaCopyObject() {
-		m_object->~T();
-		m_object = 0;
-	}
+	LuaCopyObject(const T &o) : m_object(o) {}
 
 	LuaWrappable *GetObject() const {
-		return m_object;
+		return const_cast<T*>(&m_object);
 	}
 
 private:
-	T *m_object;
-	LuaRef m_ref;
+	T m_object;
 };
 
 
@@ -288,7 +279,7 @@ template <typename T> inline void LuaObject<T>::PushToLua(RefCounted *o) {
 }
 
 template <typename T> inline void LuaObject<T>::PushToLua(const T &o) {
-	Register(new (LuaObjectBase::Allocate(sizeof(LuaCopyObject<T>))) LuaCopyObject<T>(o));
+	Register(new (LuaObjectBase::Allocate(sizeof(LuaCopyObject<T>))) LuaCopyObject<T>(o), false);
 }
 
 #endif
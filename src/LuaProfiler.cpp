@@ -0,0 +1,206 @@
+// Copyright © 2008-2013 Pioneer Developers. See AUTHORS.txt for details
+// Licensed under the terms of the GPL v3. See licenses/GPL-3.txt
+
+#include "libs.h"
+#include "LuaProfiler.h"
+#include "OS.h"
+#include "StringF.h"
+#include <map>
+#include <vector>
+#include <algorithm>
+
+namespace LuaProfiler {
+
+struct Times {
+	Times() : inclusive(0), exclusive(0) {}
+	Uint64 inclusive; // microseconds
+	Uint64 exclusive;
+};
+
+struct Frame {
+	std::string function; // "name (file:line)"
+	std::string file;
+};
+
+static bool s_running = false;
+static int s_depth = 0;      // nested protected calls
+static Uint64 s_last = 0;    // timer at the last sample or the outermost Enter
+static Uint64 s_total = 0;   // microseconds recorded
+
+// the stack at the last sample in the current call, or the called function
+// if nothing has been sampled yet
+static std::vector<Frame> s_stack;
+
+static std::map<std::string,Times> s_functions;
+static std::map<std::string,Times> s_files;
+static std::map<std::string,Uint64> s_collapsed;
+
+static std::string source_file(const char *source)
+{
+	if (strncmp(source, "[T] ", 4) == 0) source += 4;
+	if (source[0] == '@') return std::string(source+1);
+	return std::string("[string]");
+}
+
+static void describe(const lua_Debug &ar, Frame &frame)
+{
+	const bool isC = (strcmp(ar.what, "C") == 0);
+	frame.file = isC ? std::string("[C]") : source_file(ar.source);
+	frame.function = ar.name ? ar.name : "?";
+	if (!isC)
+		frame.function += stringf(" (%0:%1)", frame.file, ar.linedefined);
+}
+
+static Uint64 elapsed_since_last()
+{
+	const Uint64 now = OS::HFTimer();
+	const Uint64 us = ((now - s_last) * 1000000) / OS::HFTimerFreq();
+	s_last = now;
+	return us;
+}
+
+static void record(Uint64 us)
+{
+	if (s_stack.empty()) return;
+
+	s_total += us;
+
+	s_functions[s_stack[0].function].exclusive += us;
+	s_files[s_stack[0].file].exclusive += us;
+
+	// inclusive time goes to each function and file once, however many
+	// times it's on the stack
+	std::string collapsed;
+	for (size_t i = 0; i < s_stack.size(); i++) {
+		bool seenFunction = false, seenFile = false;
+		for (size_t j = 0; j < i; j++) {
+			if (s_stack[j].function == s_stack[i].function) seenFunction = true;
+			if (s_stack[j].file == s_stack[i].file) seenFile = true;
+		}
+		if (!seenFunction) s_functions[s_stack[i].function].inclusive += us;
+		if (!seenFile) s_files[s_stack[i].file].inclusive += us;
+
+		// outermost first
+		const Frame &f = s_stack[s_stack.size()-1-i];
+		if (i) collapsed += ';';
+		collapsed += f.function;
+	}
+	s_collapsed[collapsed] += us;
+}
+
+static void hook(lua_State *l, lua_Debug *ar)
+{
+	if (ar->event != LUA_HOOKCOUNT) return;
+
+	// running outside of any call we bracketed, eg a script being loaded.
+	// there's nothing to measure from
+	if (!s_depth) return;
+
+	const Uint64 us = elapsed_since_last();
+
+	// the time since the last sample goes to the stack as it is now
+	s_stack.clear();
+	lua_Debug frameInfo;
+	for (int level = 0; lua_getstack(l, level, &frameInfo); level++) {
+		lua_getinfo(l, "Sn", &frameInfo);
+		s_stack.push_back(Frame());
+		describe(frameInfo, s_stack.back());
+	}
+
+	record(us);
+}
+
+void Start(lua_State *l, int sampleInterval)
+{
+	s_running = true;
+	s_depth = 0;
+	lua_sethook(l, hook, LUA_MASKCOUNT, std::max(sampleInterval, 1));
+}
+
+void Stop(lua_State *l)
+{
+	lua_sethook(l, 0, 0, 0);
+	s_running = false;
+	s_depth = 0;
+}
+
+bool IsRunning()
+{
+	return s_running;
+}
+
+void Reset()
+{
+	s_functions.clear();
+	s_files.clear();
+	s_collapsed.clear();
+	s_total = 0;
+}
+
+void Enter(lua_State *l, int funcIndex)
+{
+	if (!s_running) return;
+	if (s_depth++) return;
+
+	s_last = OS::HFTimer();
+
+	lua_Debug ar;
+	lua_pushvalue(l, funcIndex);
+	lua_getinfo(l, ">S", &ar);
+	ar.name = 0;
+
+	s_stack.clear();
+	s_stack.push_back(Frame());
+	describe(ar, s_stack.back());
+}
+
+void Leave()
+{
+	if (!s_running || !s_depth) return;
+	if (--s_depth) return;
+
+	// whatever ran since the last sample
+	record(elapsed_since_last());
+}
+
+struct CompareExclusive {
+	bool operator()(const std::pair<std::string,Times> &a, const std::pair<std::string,Times> &b) const {
+		return a.second.exclusive > b.second.exclusive;
+	}
+};
+
+static void report_section(std::string &out, const char *title, const std::map<std::string,Times> &entries, unsigned int maxLines)
+{
+	std::vector< std::pair<std::string,Times> > sorted(entries.begin(), entries.end());
+	std::sort(sorted.begin(), sorted.end(), CompareExclusive());
+
+	char buf[64];
+	snprintf(buf, sizeof(buf), "%10s %10s  %s\n", "incl ms", "excl ms", title);
+	out += buf;
+	for (size_t i = 0; i < sorted.size() && i < maxLines; i++) {
+		snprintf(buf, sizeof(buf), "%10.1f %10.1f  ", sorted[i].second.inclusive * 1e-3, sorted[i].second.exclusive * 1e-3);
+		out += buf;
+		out += sorted[i].first;
+		out += '\n';
+	}
+}
+
+std::string Report(unsigned int maxFunctions)
+{
+	char buf[64];
+	snprintf(buf, sizeof(buf), "%.1f ms of Lua sampled%s\n\n", s_total * 1e-3, s_running ? "" : " (stopped)");
+	std::string out(buf);
+	report_section(out, "function", s_functions, maxFunctions);
+	out += '\n';
+	report_section(out, "file", s_files, ~0u);
+	return out;
+}
+
+bool WriteCollapsed(FILE *f)
+{
+	for (std::map<std::string,Uint64>::const_iterator i = s_collapsed.begin(); i != s_collapsed.end(); ++i)
+		fprintf(f, "%s %llu\n", i->first.c_str(), (unsigned long long)(i->second));
+	return !ferror(f);
+}
+
+}
@@ -0,0 +1,44 @@
+// Copyright © 2008-2013 Pioneer Developers. See AUTHORS.txt for details
+// Licensed under the terms of the GPL v3. See licenses/GPL-3.txt
+
+#ifndef _LUAPROFILER_H
+#define _LUAPROFILER_H
+
+#include "lua/lua.hpp"
+#include <string>
+
+// a sampling profiler for our Lua. while it runs a count hook takes the Lua
+// stack every so many VM instructions and charges the time since the last
+// sample to it, so it sees whatever was running, C++ called from Lua
+// included. time is only counted inside pi_lua_protected_call, which is how
+// the engine calls into Lua, so time between frames isn't charged to
+// anything. calls too short to be sampled are charged to the function that
+// was called.
+//
+// the hook only exists while the profiler runs, so it costs nothing when
+// it's stopped
+namespace LuaProfiler {
+
+	static const int DEFAULT_SAMPLE_INTERVAL = 1000; // VM instructions
+
+	void Start(lua_State *l, int sampleInterval = DEFAULT_SAMPLE_INTERVAL);
+	void Stop(lua_State *l);
+	bool IsRunning();
+
+	// forget everything recorded so far
+	void Reset();
+
+	// bracket a call into Lua. the function to be called is at funcIndex
+	void Enter(lua_State *l, int funcIndex);
+	void Leave();
+
+	// the most expensive functions by exclusive time, and every source file,
+	// as text for the console
+	std::string Report(unsigned int maxFunctions);
+
+	// one line per distinct stack, "outer;...;inner microseconds", which is
+	// the collapsed format flame graph tools take
+	bool WriteCollapsed(FILE *f);
+}
+
+#endif
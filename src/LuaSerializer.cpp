@@ -12,6 +12,7 @@
 #include "Player.h"
 #include "Pi.h"
 #include "Game.h"
+#include <map>
 
 // every module can save one object. that will usually be a table.  we call
 // each serializer in turn and capture its return value we build a table like
@@ -21,23 +22,49 @@
 //   'DeliverPackage' = { ... },
 //   ...
 // }
-// entire table then gets pickled and handed to the writer
+// each module's entry is pickled separately and the lot handed to the writer
 //
 // on load, we unpickle the table then call the registered unserialize
 // function for each module with its table
 //
-// we keep a copy of this table around. next time we save we overwrite the
-// each individual module's data. that way if a player loads a game with dat
-// for a module that is not currently loaded, we don't lose its data in the
-// next save
+// a module that registers with trackChanges set promises to call
+// Serializer:Changed(name) whenever its data changes. until it does, its
+// last pickle is written again without calling its serializer at all. we
+// also keep the pickles of modules that were in the loaded game but aren't
+// registered now, so they don't lose their data in the next save
 
 
 // pickler can handle simple types (boolean, number, string) and will drill
 // down into tables. it can do userdata for a specific set of types - Body and
 // its kids and SystemPath. anything else will cause a lua error
 //
-// pickle format is newline-seperated. each line begins with a type value,
-// followed by data for that type as follows
+// pickles are binary. they start with a four byte header, "\0LP" and a
+// version byte. in version 1 the header is followed by one item, the table
+// of every module's data. in version 2 each module is pickled on its own so
+// it can be reused from one save to the next, and the header is followed by
+//   varint name length, the name, varint pickle length, the pickle
+// for each module, then a zero name length. each module's pickle is one
+// item, with its own string and table numbering.
+//
+// each item is a tag byte followed by data for that tag as follows. varints are unsigned LEB128; signed values are zigzag
+// encoded first
+//   NIL                - nothing
+//   NUMBER             - double, 8 bytes in native order like Serializer
+//   FALSE, TRUE        - nothing
+//   STRING             - varint length, then the bytes. strings are numbered
+//                        from 0 in the order they first appear
+//   STRING_REF         - varint number of an earlier string
+//   TABLE              - pairs of items (key, value) until a TABLE_END.
+//                        tables are also numbered from 0 as they appear
+//   TABLE_REF          - varint number of an earlier table
+//   SYSTEMPATH         - zigzag varint sector x, y, z, then varint system
+//                        index and body index
+//   BODY               - varint index for Space::GetBodyByIndex
+//   OBJECT             - STRING or STRING_REF class name, then one item
+//
+// saves from before this have a newline-separated text format that we can
+// still read. each line begins with a type value, followed by data for that
+// type as follows
 //   fNNN.nnn - number (float)
 //   bN       - boolean. N is 0 or 1 for true/false
 //   sNNN     - string. number is length, followed by newline, then string of bytes
@@ -60,10 +87,168 @@
 // "Deserialize" function under that namespace. that data returned will be
 // given back to the module
 
-void LuaSerializer::pickle(lua_State *l, int idx, std::string &out, const char *key = 0)
+static const char s_pickleMagic[] = { '\0', 'L', 'P' };
+static const size_t PICKLE_MAGIC_LEN = 3;
+static const char PICKLE_VERSION = 2;
+
+enum PickleTag {
+	PICKLE_NIL = 1,
+	PICKLE_NUMBER,
+	PICKLE_FALSE,
+	PICKLE_TRUE,
+	PICKLE_STRING,
+	PICKLE_STRING_REF,
+	PICKLE_TABLE,
+	PICKLE_TABLE_REF,
+	PICKLE_TABLE_END,
+	PICKLE_SYSTEMPATH,
+	PICKLE_BODY,
+	PICKLE_OBJECT
+};
+
+struct LuaSerializer::PickleState {
+	PickleState(std::string &out_) : out(out_), numTables(0), hasBodies(false) {}
+	std::string &out;
+	std::map<std::string,Uint32> strings;
+	Uint32 numTables;
+	bool hasBodies;
+};
+
+struct LuaSerializer::UnpickleState {
+	UnpickleState(const char *end_) : end(end_), numTables(0), hasBodies(false) {}
+	const char *end;
+	std::vector< std::pair<const char*,size_t> > strings;
+	Uint32 numTables;
+	bool hasBodies;
+};
+
+static void put_varint(std::string &out, Uint32 x)
+{
+	while (x >= 0x80) {
+		out.push_back(char((x & 0x7f) | 0x80));
+		x >>= 7;
+	}
+	out.push_back(char(x));
+}
+
+static void put_svarint(std::string &out, Sint32 x)
+{
+	put_varint(out, (Uint32(x) << 1) ^ Uint32(x >> 31));
+}
+
+static Uint32 get_varint(const char *&pos, const char *end)
+{
+	Uint32 x = 0;
+	for (int shift = 0; shift < 35; shift += 7) {
+		if (pos >= end) throw SavedGameCorruptException();
+		const Uint8 b = Uint8(*pos++);
+		x |= Uint32(b & 0x7f) << shift;
+		if (!(b & 0x80)) return x;
+	}
+	throw SavedGameCorruptException();
+}
+
+static Sint32 get_svarint(const char *&pos, const char *end)
+{
+	const Uint32 x = get_varint(pos, end);
+	return Sint32(x >> 1) ^ -Sint32(x & 1);
+}
+
+static void put_string(std::string &out, std::map<std::string,Uint32> &strings, const char *str, size_t len)
+{
+	const std::string s(str, len);
+	std::map<std::string,Uint32>::const_iterator i = strings.find(s);
+	if (i != strings.end()) {
+		out.push_back(char(PICKLE_STRING_REF));
+		put_varint(out, i->second);
+		return;
+	}
+
+	const Uint32 n = strings.size();
+	strings.insert(std::make_pair(s, n));
+	out.push_back(char(PICKLE_STRING));
+	put_varint(out, len);
+	out.append(str, len);
+}
+
+// reads a STRING or STRING_REF item straight out of the buffer
+static const char *get_string(const char *pos, const char *end, std::vector< std::pair<const char*,size_t> > &strings, const char *&outStr, size_t &outLen)
+{
+	if (pos >= end) throw SavedGameCorruptException();
+	const char tag = *pos++;
+
+	if (tag == PICKLE_STRING_REF) {
+		const Uint32 n = get_varint(pos, end);
+		if (n >= strings.size()) throw SavedGameCorruptException();
+		outStr = strings[n].first;
+		outLen = strings[n].second;
+		return pos;
+	}
+
+	if (tag != PICKLE_STRING) throw SavedGameCorruptException();
+	const Uint32 len = get_varint(pos, end);
+	if (Uint32(end - pos) < len) throw SavedGameCorruptException();
+	outStr = pos;
+	outLen = len;
+	strings.push_back(std::make_pair(outStr, outLen));
+	return pos + len;
+}
+
+static void push_body(lua_State *l, Body *body)
+{
+	switch (body->GetType()) {
+		case Object::BODY:
+			LuaObject<Body>::PushToLua(body);
+			break;
+		case Object::SHIP:
+			LuaObject<Ship>::PushToLua(dynamic_cast<Ship*>(body));
+			break;
+		case Object::SPACESTATION:
+			LuaObject<SpaceStation>::PushToLua(dynamic_cast<SpaceStation*>(body));
+			break;
+		case Object::PLANET:
+			LuaObject<Planet>::PushToLua(dynamic_cast<Planet*>(body));
+			break;
+		case Object::STAR:
+			LuaObject<Star>::PushToLua(dynamic_cast<Star*>(body));
+			break;
+		case Object::PLAYER:
+			LuaObject<Player>::PushToLua(dynamic_cast<Player*>(body));
+			break;
+		default:
+			throw SavedGameCorruptException();
+	}
+}
+
+// replaces the unpickled data on top of the stack with what the class's
+// Unserialize makes of it. if the class doesn't exist the data is left
+static void unserialize_object(lua_State *l, const char *cl, size_t len)
 {
-	static char buf[256];
+	// get _G[typename]
+	lua_rawgeti(l, LUA_REGISTRYINDEX, LUA_RIDX_GLOBALS);
+	lua_pushlstring(l, cl, len);
+	lua_gettable(l, -2);
+	lua_remove(l, -2);
+
+	if (lua_isnil(l, -1)) {
+		lua_pop(l, 1);
+		return;
+	}
+
+	lua_getfield(l, -1, "Unserialize");
+	if (lua_isnil(l, -1)) {
+		lua_pushlstring(l, cl, len);
+		luaL_error(l, "No Unserialize method found for class '%s'\n", lua_tostring(l, -1));
+	}
+
+	lua_insert(l, -3);
+	lua_pop(l, 1);
+
+	pi_lua_protected_call(l, 1, 1);
+}
 
+void LuaSerializer::pickle(lua_State *l, int idx, PickleState &st, const char *key = 0)
+{
 	LUA_DEBUG_START(l);
 
 	idx = lua_absindex(l, idx);
@@ -74,16 +259,15 @@ void LuaSerializer::pickle(lua_State *l, int idx, std::string &out, const char *
 			lua_pop(l, 2);
 
 		else {
-			const char *cl = lua_tostring(l, -1);
-			snprintf(buf, sizeof(buf), "o%s\n", cl);
+			const std::string cl = lua_tostring(l, -1);
 
-			lua_getglobal(l, cl);
+			lua_getglobal(l, cl.c_str());
 			if (lua_isnil(l, -1))
-				luaL_error(l, "No Serialize method found for class '%s'\n", cl);
+				luaL_error(l, "No Serialize method found for class '%s'\n", cl.c_str());
 
 			lua_getfield(l, -1, "Serialize");
 			if (lua_isnil(l, -1))
-				luaL_error(l, "No Serialize method found for class '%s'\n", cl);
+				luaL_error(l, "No Serialize method found for class '%s'\n", cl.c_str());
 
 			lua_pushvalue(l, idx);
 			pi_lua_protected_call(l, 1, 1);
@@ -94,88 +278,90 @@ void LuaSerializer::pickle(lua_State *l, int idx, std::string &out, const char *
 			lua_pop(l, 3);
 
 			if (lua_isnil(l, idx)) {
+				st.out.push_back(char(PICKLE_NIL));
 				LUA_DEBUG_END(l, 0);
 				return;
 			}
 
-			out += buf;
+			st.out.push_back(char(PICKLE_OBJECT));
+			put_string(st.out, st.strings, cl.c_str(), cl.size());
 		}
 	}
 
 	switch (lua_type(l, idx)) {
 		case LUA_TNIL:
+			st.out.push_back(char(PICKLE_NIL));
 			break;
 
 		case LUA_TNUMBER: {
-			snprintf(buf, sizeof(buf), "f%f\n", lua_tonumber(l, idx));
-			out += buf;
+			const double f = lua_tonumber(l, idx);
+			char buf[sizeof(double)];
+			memcpy(buf, &f, sizeof(double));
+			st.out.push_back(char(PICKLE_NUMBER));
+			st.out.append(buf, sizeof(double));
 			break;
 		}
 
-		case LUA_TBOOLEAN: {
-			snprintf(buf, sizeof(buf), "b%d", lua_toboolean(l, idx) ? 1 : 0);
-			out += buf;
+		case LUA_TBOOLEAN:
+			st.out.push_back(char(lua_toboolean(l, idx) ? PICKLE_TRUE : PICKLE_FALSE));
 			break;
-		}
 
 		case LUA_TSTRING: {
-			lua_pushvalue(l, idx);
-			const char *str = lua_tostring(l, -1);
-			snprintf(buf, sizeof(buf), "s" SIZET_FMT "\n", strlen(str));
-			out += buf;
-			out += str;
-			lua_pop(l, 1);
+			size_t len;
+			const char *str = lua_tolstring(l, idx, &len);
+			put_string(st.out, st.strings, str, len);
 			break;
 		}
 
 		case LUA_TTABLE: {
-			lua_pushinteger(l, lua_Integer(lua_topointer(l, idx)));         // ptr
-
-			lua_getfield(l, LUA_REGISTRYINDEX, "PiSerializerTableRefs");    // ptr reftable
-			lua_pushvalue(l, -2);                                           // ptr reftable ptr
-			lua_rawget(l, -2);                                              // ptr reftable ???
+			// the ref table holds every table seen so far, which also keeps
+			// anything made by a Serialize method alive until we're done
+			lua_getfield(l, LUA_REGISTRYINDEX, "PiSerializerTableRefs");    // reftable
+			lua_pushvalue(l, idx);                                          // reftable table
+			lua_rawget(l, -2);                                              // reftable ???
 
 			if (!lua_isnil(l, -1)) {
-				out += "r";
-				pickle(l, -3, out, key);
-				lua_pop(l, 3);                                              // [empty]
+				st.out.push_back(char(PICKLE_TABLE_REF));
+				put_varint(st.out, Uint32(lua_tointeger(l, -1)));
+				lua_pop(l, 2);                                              // [empty]
+				break;
 			}
 
-			else {
-				out += "t";
-
-				lua_pushvalue(l, -3);                                       // ptr reftable nil ptr
-				lua_pushvalue(l, idx);                                      // ptr reftable nil ptr table
-				lua_rawset(l, -4);                                          // ptr reftable nil
-				pickle(l, -3, out, key);
-				lua_pop(l, 3);                                              // [empty]
-
-				lua_pushvalue(l, idx);
-				lua_pushnil(l);
-				while (lua_next(l, -2)) {
-					if (key) {
-						pickle(l, -2, out, key);
-						pickle(l, -1, out, key);
-					}
-					else {
-						lua_pushvalue(l, -2);
-						const char *k = lua_tostring(l, -1);
-						pickle(l, -3, out, k);
-						pickle(l, -2, out, k);
-						lua_pop(l, 1);
-					}
+			lua_pop(l, 1);                                                  // reftable
+			lua_pushvalue(l, idx);                                          // reftable table
+			lua_pushinteger(l, st.numTables++);                             // reftable table n
+			lua_rawset(l, -3);                                              // reftable
+			lua_pop(l, 1);                                                  // [empty]
+
+			st.out.push_back(char(PICKLE_TABLE));
+
+			lua_pushnil(l);
+			while (lua_next(l, idx)) {
+				// the top level keys are the module names, which make the
+				// most useful error context
+				std::string k;
+				if (!key) {
+					lua_pushvalue(l, -2);
+					const char *ks = lua_tostring(l, -1);
+					if (ks) k = ks;
 					lua_pop(l, 1);
 				}
+				const char *context = key ? key : k.c_str();
+
+				// pickle a copy of the key, lua_next needs the original
+				lua_pushvalue(l, -2);
+				pickle(l, -1, st, context);
+				lua_pop(l, 1);
+
+				pickle(l, -1, st, context);
 				lua_pop(l, 1);
-				out += "n";
 			}
 
+			st.out.push_back(char(PICKLE_TABLE_END));
 			break;
 		}
 
 		case LUA_TUSERDATA: {
-			out += "u";
-
 			LuaObjectBase *lo = static_cast<LuaObjectBase*>(lua_touserdata(l, idx));
 			void *o = lo->GetObject();
 			if (!o)
@@ -185,16 +371,20 @@ void LuaSerializer::pickle(lua_State *l, int idx, std::string &out, const char *
 			// methods to deal with this
 			if (lo->Isa("SystemPath")) {
 				SystemPath *sbp = static_cast<SystemPath*>(o);
-				snprintf(buf, sizeof(buf), "SystemPath\n%d\n%d\n%d\n%u\n%u\n",
-					sbp->sectorX, sbp->sectorY, sbp->sectorZ, sbp->systemIndex, sbp->bodyIndex);
-				out += buf;
+				st.out.push_back(char(PICKLE_SYSTEMPATH));
+				put_svarint(st.out, sbp->sectorX);
+				put_svarint(st.out, sbp->sectorY);
+				put_svarint(st.out, sbp->sectorZ);
+				put_varint(st.out, sbp->systemIndex);
+				put_varint(st.out, sbp->bodyIndex);
 				break;
 			}
 
 			if (lo->Isa("Body")) {
 				Body *b = static_cast<Body*>(o);
-				snprintf(buf, sizeof(buf), "Body\n%u\n", Pi::game->GetSpace()->GetIndexForBody(b));
-				out += buf;
+				st.out.push_back(char(PICKLE_BODY));
+				put_varint(st.out, Pi::game->GetSpace()->GetIndexForBody(b));
+				st.hasBodies = true;
 				break;
 			}
 
@@ -210,7 +400,127 @@ void LuaSerializer::pickle(lua_State *l, int idx, std::string &out, const char *
 	LUA_DEBUG_END(l, 0);
 }
 
-const char *LuaSerializer::unpickle(lua_State *l, const char *pos)
+const char *LuaSerializer::unpickle(lua_State *l, const char *pos, UnpickleState &st)
+{
+	LUA_DEBUG_START(l);
+
+	if (pos >= st.end) throw SavedGameCorruptException();
+	const char tag = *pos;
+
+	switch (tag) {
+		case PICKLE_NIL:
+			lua_pushnil(l);
+			pos++;
+			break;
+
+		case PICKLE_NUMBER: {
+			pos++;
+			if (size_t(st.end - pos) < sizeof(double)) throw SavedGameCorruptException();
+			double f;
+			memcpy(&f, pos, sizeof(double));
+			lua_pushnumber(l, f);
+			pos += sizeof(double);
+			break;
+		}
+
+		case PICKLE_FALSE:
+		case PICKLE_TRUE:
+			lua_pushboolean(l, tag == PICKLE_TRUE);
+			pos++;
+			break;
+
+		case PICKLE_STRING:
+		case PICKLE_STRING_REF: {
+			const char *str;
+			size_t len;
+			pos = get_string(pos, st.end, st.strings, str, len);
+			lua_pushlstring(l, str, len);
+			break;
+		}
+
+		case PICKLE_TABLE: {
+			pos++;
+			lua_newtable(l);
+
+			lua_getfield(l, LUA_REGISTRYINDEX, "PiSerializerTableRefs");
+			lua_pushvalue(l, -2);
+			lua_rawseti(l, -2, st.numTables++);
+			lua_pop(l, 1);
+
+			for (;;) {
+				if (pos >= st.end) throw SavedGameCorruptException();
+				if (*pos == PICKLE_TABLE_END) {
+					pos++;
+					break;
+				}
+				pos = unpickle(l, pos, st);
+				pos = unpickle(l, pos, st);
+				// a nil key can only come from an object whose Serialize
+				// gave nothing back. drop the pair
+				if (lua_isnil(l, -2))
+					lua_pop(l, 2);
+				else
+					lua_rawset(l, -3);
+			}
+			break;
+		}
+
+		case PICKLE_TABLE_REF: {
+			pos++;
+			const Uint32 n = get_varint(pos, st.end);
+
+			lua_getfield(l, LUA_REGISTRYINDEX, "PiSerializerTableRefs");
+			lua_rawgeti(l, -1, n);
+			if (lua_isnil(l, -1))
+				throw SavedGameCorruptException();
+			lua_remove(l, -2);
+			break;
+		}
+
+		case PICKLE_SYSTEMPATH: {
+			pos++;
+			const Sint32 sectorX = get_svarint(pos, st.end);
+			const Sint32 sectorY = get_svarint(pos, st.end);
+			const Sint32 sectorZ = get_svarint(pos, st.end);
+			const Uint32 systemNum = get_varint(pos, st.end);
+			const Uint32 sbodyId = get_varint(pos, st.end);
+
+			const SystemPath sbp(sectorX, sectorY, sectorZ, systemNum, sbodyId);
+			LuaObject<SystemPath>::PushToLua(sbp);
+			break;
+		}
+
+		case PICKLE_BODY: {
+			pos++;
+			const Uint32 n = get_varint(pos, st.end);
+			Body *body = Pi::game->GetSpace()->GetBodyByIndex(n);
+			if (!body) throw SavedGameCorruptException();
+			push_body(l, body);
+			st.hasBodies = true;
+			break;
+		}
+
+		case PICKLE_OBJECT: {
+			pos++;
+			const char *cl;
+			size_t len;
+			pos = get_string(pos, st.end, st.strings, cl, len);
+
+			pos = unpickle(l, pos, st);
+			unserialize_object(l, cl, len);
+			break;
+		}
+
+		default:
+			throw SavedGameCorruptException();
+	}
+
+	LUA_DEBUG_END(l, 1);
+
+	return pos;
+}
+
+const char *LuaSerializer::unpickle_text(lua_State *l, const char *pos)
 {
 	LUA_DEBUG_START(l);
 
@@ -249,14 +559,14 @@ const char *LuaSerializer::unpickle(lua_State *l, const char *pos)
 			lua_newtable(l);
 
 			lua_getfield(l, LUA_REGISTRYINDEX, "PiSerializerTableRefs");
-			pos = unpickle(l, pos);
+			pos = unpickle_text(l, pos);
 			lua_pushvalue(l, -3);
 			lua_rawset(l, -3);
 			lua_pop(l, 1);
 
 			while (*pos != 'n') {
-				pos = unpickle(l, pos);
-				pos = unpickle(l, pos);
+				pos = unpickle_text(l, pos);
+				pos = unpickle_text(l, pos);
 				lua_rawset(l, -3);
 			}
 			pos++;
@@ -265,7 +575,7 @@ const char *LuaSerializer::unpickle(lua_State *l, const char *pos)
 		}
 
 		case 'r': {
-			pos = unpickle(l, pos);
+			pos = unpickle_text(l, pos);
 
 			lua_getfield(l, LUA_REGISTRYINDEX, "PiSerializerTableRefs");
 			lua_pushvalue(l, -2);
@@ -325,28 +635,7 @@ const char *LuaSerializer::unpickle(lua_State *l, const char *pos)
 				Body *body = Pi::game->GetSpace()->GetBodyByIndex(n);
 				if (pos == end) throw SavedGameCorruptException();
 
-				switch (body->GetType()) {
-					case Object::BODY:
-						LuaObject<Body>::PushToLua(body);
-						break;
-					case Object::SHIP:
-						LuaObject<Ship>::PushToLua(dynamic_cast<Ship*>(body));
-						break;
-					case Object::SPACESTATION:
-						LuaObject<SpaceStation>::PushToLua(dynamic_cast<SpaceStation*>(body));
-						break;
-					case Object::PLANET:
-						LuaObject<Planet>::PushToLua(dynamic_cast<Planet*>(body));
-						break;
-					case Object::STAR:
-						LuaObject<Star>::PushToLua(dynamic_cast<Star*>(body));
-						break;
-					case Object::PLAYER:
-						LuaObject<Player>::PushToLua(dynamic_cast<Player*>(body));
-						break;
-					default:
-						throw SavedGameCorruptException();
-				}
+				push_body(l, body);
 
 				break;
 			}
@@ -363,30 +652,9 @@ const char *LuaSerializer::unpickle(lua_State *l, const char *pos)
 			const char *cl = pos;
 
 			// unpickle the object, and insert it beneath the method table value
-			pos = unpickle(l, end);
-
-			// get _G[typename]
-			lua_rawgeti(l, LUA_REGISTRYINDEX, LUA_RIDX_GLOBALS);
-			lua_pushlstring(l, cl, len);
-			lua_gettable(l, -2);
-			lua_remove(l, -2);
-
-			if (lua_isnil(l, -1)) {
-				lua_pop(l, 2);
-				break;
-			}
-
-			lua_getfield(l, -1, "Unserialize");
-			if (lua_isnil(l, -1)) {
-				lua_pushlstring(l, cl, len);
-				luaL_error(l, "No Unserialize method found for class '%s'\n", lua_tostring(l, -1));
-			}
-
-			lua_insert(l, -3);
-			lua_pop(l, 1);
-
-			pi_lua_protected_call(l, 1, 1);
+			pos = unpickle_text(l, end);
 
+			unserialize_object(l, cl, len);
 			break;
 		}
 
@@ -399,14 +667,36 @@ const char *LuaSerializer::unpickle(lua_State *l, const char *pos)
 	return pos;
 }
 
+static void put_module(std::string &out, const std::string &name, const std::string &pickled)
+{
+	put_varint(out, name.size());
+	out += name;
+	put_varint(out, pickled.size());
+	out += pickled;
+}
+
+bool LuaSerializer::pickle_module(lua_State *l, int idx, const std::string &name, std::string &out)
+{
+	lua_newtable(l);
+	lua_setfield(l, LUA_REGISTRYINDEX, "PiSerializerTableRefs");
+
+	PickleState st(out);
+	pickle(l, idx, st, name.c_str());
+
+	lua_pushnil(l);
+	lua_setfield(l, LUA_REGISTRYINDEX, "PiSerializerTableRefs");
+
+	return st.hasBodies;
+}
+
 void LuaSerializer::Serialize(Serializer::Writer &wr)
 {
 	lua_State *l = Lua::manager->GetLuaState();
 
 	LUA_DEBUG_START(l);
 
-	lua_newtable(l);
-	int savetable = lua_gettop(l);
+	std::string pickled(s_pickleMagic, PICKLE_MAGIC_LEN);
+	pickled.push_back(PICKLE_VERSION);
 
 	lua_getfield(l, LUA_REGISTRYINDEX, "PiSerializerCallbacks");
 	if (lua_isnil(l, -1)) {
@@ -418,29 +708,46 @@ void LuaSerializer::Serialize(Serializer::Writer &wr)
 
 	lua_pushnil(l);
 	while (lua_next(l, -2) != 0) {
-		lua_pushinteger(l, 1);
-		lua_gettable(l, -2);
-		pi_lua_protected_call(l, 0, 1);
-		lua_pushvalue(l, -3);
-		lua_insert(l, -2);
-		lua_settable(l, savetable);
+		const std::string name = lua_tostring(l, -2);
+
+		lua_rawgeti(l, -1, 3);
+		const bool tracked = lua_toboolean(l, -1);
 		lua_pop(l, 1);
-	}
 
-	lua_pop(l, 1);
+		std::map<std::string,std::string>::const_iterator cached = m_cache.find(name);
+		if (tracked && cached != m_cache.end())
+			put_module(pickled, name, cached->second);
 
-	lua_newtable(l);
-	lua_setfield(l, LUA_REGISTRYINDEX, "PiSerializerTableRefs");
+		else {
+			lua_rawgeti(l, -1, 1);
+			pi_lua_protected_call(l, 0, 1);
 
-	std::string pickled;
-	pickle(l, savetable, pickled);
+			std::string module;
+			const bool hasBodies = pickle_module(l, -1, name, module);
+			lua_pop(l, 1);
 
-	wr.String(pickled);
+			put_module(pickled, name, module);
+			if (tracked && !hasBodies)
+				m_cache[name].swap(module);
+			else
+				m_cache.erase(name);
+		}
+
+		lua_pop(l, 1);
+	}
+
+	// whatever was loaded for modules we don't have
+	for (std::map<std::string,std::string>::const_iterator i = m_cache.begin(); i != m_cache.end(); ++i) {
+		lua_getfield(l, -1, i->first.c_str());
+		if (lua_isnil(l, -1))
+			put_module(pickled, i->first, i->second);
+		lua_pop(l, 1);
+	}
 
 	lua_pop(l, 1);
 
-	lua_pushnil(l);
-	lua_setfield(l, LUA_REGISTRYINDEX, "PiSerializerTableRefs");
+	put_varint(pickled, 0);
+	wr.String(pickled);
 
 	LUA_DEBUG_END(l, 0);
 }
@@ -451,14 +758,64 @@ void LuaSerializer::Unserialize(Serializer::Reader &rd)
 
 	LUA_DEBUG_START(l);
 
-	lua_newtable(l);
-	lua_setfield(l, LUA_REGISTRYINDEX, "PiSerializerTableRefs");
+	m_cache.clear();
+
+	// unpickled in place. the pickle can be most of the save
+	const StringRange pickled = rd.StringView();
+	const char *start = pickled.begin;
+	const char *end = pickled.end;
+
+	if (pickled.Size() > PICKLE_MAGIC_LEN && memcmp(start, s_pickleMagic, PICKLE_MAGIC_LEN) == 0) {
+		const char version = start[PICKLE_MAGIC_LEN];
+		const char *pos = start + PICKLE_MAGIC_LEN + 1;
+
+		if (version == 1) {
+			// one table for everything
+			lua_newtable(l);
+			lua_setfield(l, LUA_REGISTRYINDEX, "PiSerializerTableRefs");
+			UnpickleState st(end);
+			pos = unpickle(l, pos, st);
+			if (!lua_istable(l, -1)) throw SavedGameCorruptException();
+		}
+
+		else if (version == PICKLE_VERSION) {
+			lua_newtable(l);
+			for (;;) {
+				const Uint32 nameLen = get_varint(pos, end);
+				if (nameLen == 0) break;
+				if (Uint32(end - pos) < nameLen) throw SavedGameCorruptException();
+				const std::string name(pos, nameLen);
+				pos += nameLen;
+
+				const Uint32 len = get_varint(pos, end);
+				if (Uint32(end - pos) < len) throw SavedGameCorruptException();
+				const char *moduleEnd = pos + len;
+
+				lua_newtable(l);
+				lua_setfield(l, LUA_REGISTRYINDEX, "PiSerializerTableRefs");
+				UnpickleState st(moduleEnd);
+				if (unpickle(l, pos, st) != moduleEnd) throw SavedGameCorruptException();
+				lua_setfield(l, -2, name.c_str());
+
+				if (!st.hasBodies)
+					m_cache[name] = std::string(pos, len);
+				pos = moduleEnd;
+			}
+		}
+
+		else
+			throw SavedGameCorruptException();
+
+		if (pos != end) throw SavedGameCorruptException();
+	}
+
+	else {
+		lua_newtable(l);
+		lua_setfield(l, LUA_REGISTRYINDEX, "PiSerializerTableRefs");
+		if (unpickle_text(l, start) != end) throw SavedGameCorruptException();
+		if (!lua_istable(l, -1)) throw SavedGameCorruptException();
+	}
 
-	std::string pickled = rd.String();
-	const char *start = pickled.c_str();
-	const char *end = unpickle(l, start);
-	if (size_t(end - start) != pickled.length()) throw SavedGameCorruptException();
-	if (!lua_istable(l, -1)) throw SavedGameCorruptException();
 	int savetable = lua_gettop(l);
 
 	lua_pushnil(l);
@@ -499,6 +856,7 @@ int LuaSerializer::l_register(lua_State *l)
 
 	luaL_checktype(l, 3, LUA_TFUNCTION); // any type of function
 	luaL_checktype(l, 4, LUA_TFUNCTION); // any type of function
+	const bool trackChanges = lua_toboolean(l, 5);
 
 	lua_getfield(l, LUA_REGISTRYINDEX, "PiSerializerCallbacks");
 	if (lua_isnil(l, -1)) {
@@ -521,6 +879,9 @@ int LuaSerializer::l_register(lua_State *l)
 	lua_pushinteger(l, 2);
 	lua_pushvalue(l, 4);
 	lua_rawset(l, -3);
+	lua_pushinteger(l, 3);
+	lua_pushboolean(l, trackChanges);
+	lua_rawset(l, -3);
 
 	lua_pushstring(l, key.c_str());
 	lua_pushvalue(l, -2);
@@ -533,12 +894,23 @@ int LuaSerializer::l_register(lua_State *l)
 	return 0;
 }
 
+// a module registered with trackChanges calls this whenever its data changes,
+// so the next save asks it for its data again
+int LuaSerializer::l_changed(lua_State *l)
+{
+	LuaSerializer *serializer = LuaObject<LuaSerializer>::CheckFromLua(1);
+	std::string key = luaL_checkstring(l, 2);
+	serializer->m_cache.erase(key);
+	return 0;
+}
+
 template <> const char *LuaObject<LuaSerializer>::s_type = "Serializer";
 
 template <> void LuaObject<LuaSerializer>::RegisterClass()
 {
 	static const luaL_Reg l_methods[] = {
 		{ "Register", LuaSerializer::l_register },
+		{ "Changed",  LuaSerializer::l_changed },
 		{ 0, 0 }
 	};
 
@@ -8,6 +8,8 @@
 #include "LuaObject.h"
 #include "DeleteEmitter.h"
 #include "Serializer.h"
+#include <map>
+#include <string>
 
 class LuaSerializer : public DeleteEmitter {
 	friend class LuaObject<LuaSerializer>;
@@ -16,11 +18,30 @@ public:
 	void Serialize(Serializer::Writer &wr);
 	void Unserialize(Serializer::Reader &rd);
 
+	// forget every module's last pickle. call when the game they came
+	// from goes away
+	void ClearCache() { m_cache.clear(); }
+
 private:
 	static int l_register(lua_State *l);
+	static int l_changed(lua_State *l);
+
+	// the last pickle of a module that tells us when it changes, or of a
+	// module that was in the loaded game but isn't registered now. only kept
+	// while it holds no Body references, because body indices don't last
+	// from one save to the next
+	std::map<std::string,std::string> m_cache;
+
+	struct PickleState;
+	struct UnpickleState;
+
+	static void pickle(lua_State *l, int idx, PickleState &st, const char *key);
+	static const char *unpickle(lua_State *l, const char *pos, UnpickleState &st);
+
+	static bool pickle_module(lua_State *l, int idx, const std::string &name, std::string &out);
 
-	static void pickle(lua_State *l, int idx, std::string &out, const char *key);
-	static const char *unpickle(lua_State *l, const char *pos);
+	// the old text format, for games saved before the binary one
+	static const char *unpickle_text(lua_State *l, const char *pos);
 };
 
 #endif
@@ -171,12 +171,12 @@ void LuaShipDef::Register()
 
 	lua_newtable(l);
 
-	for (std::map<ShipType::Id,ShipType>::const_iterator i = ShipType::types.begin(); i != ShipType::types.end(); ++i)
+	for (std::vector<ShipType>::const_iterator i = ShipType::types.begin(); i != ShipType::types.end(); ++i)
 	{
-		const ShipType &st = (*i).second;
+		const ShipType &st = *i;
 		lua_newtable(l);
 
-		pi_lua_settable(l, "id",                (*i).first.c_str());
+		pi_lua_settable(l, "id",                st.id.c_str());
 		pi_lua_settable(l, "name",              st.name.c_str());
 		pi_lua_settable(l, "modelName",         st.modelName.c_str());
 		pi_lua_settable(l, "tag",               EnumStrings::GetString("ShipTypeTag", st.tag));
@@ -203,7 +203,7 @@ void LuaShipDef::Register()
 		lua_pop(l, 1);
 
 		pi_lua_readonly_table_proxy(l, -1);
-		lua_setfield(l, -3, (*i).first.c_str());
+		lua_setfield(l, -3, st.id.c_str());
 		lua_pop(l, 1);
 	}
 
@@ -577,15 +577,66 @@ static int l_space_get_body(lua_State *l)
 	return 1;
 }
 
+// the Lua class names that can be asked for by type, as <Object.isa> knows them
+static const struct {
+	const char *name;
+	Object::Type type;
+} s_bodyTypes[] = {
+	{ "Body",         Object::BODY         },
+	{ "CargoBody",    Object::CARGOBODY    },
+	{ "Missile",      Object::MISSILE      },
+	{ "Planet",       Object::PLANET       },
+	{ "Player",       Object::PLAYER       },
+	{ "Ship",         Object::SHIP         },
+	{ "SpaceStation", Object::SPACESTATION },
+	{ "Star",         Object::STAR         },
+	{ 0,              Object::OBJECT       }
+};
+
+static Object::Type _check_body_type(lua_State *l, int index)
+{
+	const char *name = luaL_checkstring(l, index);
+	for (int i = 0; s_bodyTypes[i].name; i++)
+		if (strcmp(s_bodyTypes[i].name, name) == 0)
+			return s_bodyTypes[i].type;
+	luaL_error(l, "Unknown body type '%s'", name);
+	return Object::OBJECT;
+}
+
+// call the filter function at index with the body. true if it accepts it
+static bool _filter_accepts(lua_State *l, int index, Body *b)
+{
+	lua_pushvalue(l, index);
+	LuaObject<Body>::PushToLua(b);
+	if (int ret = lua_pcall(l, 1, 1, 0)) {
+		const char *errmsg( "Unknown error" );
+		if (ret == LUA_ERRRUN)
+			errmsg = lua_tostring(l, -1);
+		else if (ret == LUA_ERRMEM)
+			errmsg = "memory allocation failure";
+		else if (ret == LUA_ERRERR)
+			errmsg = "error in error handler function";
+		luaL_error(l, "Error in filter function: %s", errmsg);
+	}
+	const bool accept = lua_toboolean(l, -1);
+	lua_pop(l, 1);
+	return accept;
+}
+
 /*
  * Function: GetBodies
  *
  * Get all the <Body> objects that match the specified filter
  *
- * bodies = Space.GetBodies(filter)
+ * bodies = Space.GetBodies(type, filter)
  *
  * Parameters:
  *
+ *   type - optional. The name of a <Body> class (eg "SpaceStation"). Only
+ *          bodies for which <Object.isa> would return true are considered.
+ *          This is checked before any Lua is run, so it's much cheaper than
+ *          testing the type in the filter function.
+ *
  *   filter - an option function. If specificed the function will be called
  *            once for each body with the <Body> object as the only parameter.
  *            If the filter function returns true then the <Body> will be
@@ -604,10 +655,13 @@ static int l_space_get_body(lua_State *l)
  * > local stations = Space.GetBodies(function (body)
  * >     return body.type == "STARPORT_SURFACE"
  * > end)
+ * >
+ * > -- get all the planets
+ * > local planets = Space.GetBodies("Planet")
  *
  * Availability:
  *
- *   alpha 10
+ *   alpha 10 (type alpha 34)
  *
  * Status:
  *
@@ -620,9 +674,18 @@ static int l_space_get_bodies(lua_State *l)
 
 	LUA_DEBUG_START(l);
 
+	int filterIndex = 1;
+	bool typed = false;
+	Object::Type type = Object::OBJECT;
+	if (lua_type(l, 1) == LUA_TSTRING) {
+		type = _check_body_type(l, 1);
+		typed = true;
+		filterIndex = 2;
+	}
+
 	bool filter = false;
-	if (lua_gettop(l) >= 1) {
-		luaL_checktype(l, 1, LUA_TFUNCTION); // any type of function
+	if (lua_gettop(l) >= filterIndex) {
+		luaL_checktype(l, filterIndex, LUA_TFUNCTION); // any type of function
 		filter = true;
 	}
 
@@ -631,25 +694,11 @@ static int l_space_get_bodies(lua_State *l)
 	for (Space::BodyIterator i = Pi::game->GetSpace()->BodiesBegin(); i != Pi::game->GetSpace()->BodiesEnd(); ++i) {
 		Body *b = *i;
 
-		if (filter) {
-			lua_pushvalue(l, 1);
-			LuaObject<Body>::PushToLua(b);
-			if (int ret = lua_pcall(l, 1, 1, 0)) {
-				const char *errmsg( "Unknown error" );
-				if (ret == LUA_ERRRUN)
-					errmsg = lua_tostring(l, -1);
-				else if (ret == LUA_ERRMEM)
-					errmsg = "memory allocation failure";
-				else if (ret == LUA_ERRERR)
-					errmsg = "error in error handler function";
-				luaL_error(l, "Error in filter function: %s", errmsg);
-			}
-			if (!lua_toboolean(l, -1)) {
-				lua_pop(l, 1);
-				continue;
-			}
-			lua_pop(l, 1);
-		}
+		if (typed && !b->IsType(type))
+			continue;
+
+		if (filter && !_filter_accepts(l, filterIndex, b))
+			continue;
 
 		lua_pushinteger(l, lua_rawlen(l, -1)+1);
 		LuaObject<Body>::PushToLua(b);
@@ -661,6 +710,125 @@ static int l_space_get_bodies(lua_State *l)
 	return 1;
 }
 
+struct NearBody {
+	NearBody(Body *_body, double _dist) : body(_body), dist(_dist) {}
+	Body *body;
+	double dist;
+	bool operator<(const NearBody &a) const { return dist < a.dist; }
+};
+
+/*
+ * Function: GetBodiesNear
+ *
+ * Get the <Body> objects within some distance of a body, nearest first
+ *
+ * bodies = Space.GetBodiesNear(body, radius, type, filter)
+ *
+ * The search runs over the grid <Space> keeps of where everything is, so
+ * only bodies that are actually close by are ever handed to Lua. The grid
+ * is rebuilt every physics step; a body that has only come within range
+ * (or been added to space) during the current step may not be found until
+ * the next one.
+ *
+ * Parameters:
+ *
+ *   body - the <Body> to search around. It is not included in the results
+ *
+ *   radius - the distance to search, in metres
+ *
+ *   type - optional. The name of a <Body> class (eg "Ship"), as for
+ *          <GetBodies>. nil for any type
+ *
+ *   filter - optional. A function called with each body that is in range
+ *            and of the right type. Only bodies it returns true for are
+ *            included
+ *
+ * Return:
+ *
+ *   bodies - an array containing zero or more <Body> objects, sorted by
+ *            distance from the body
+ *
+ * Example:
+ *
+ * > -- ships within 50km of the player
+ * > local ships = Space.GetBodiesNear(Game.player, 50000, "Ship")
+ *
+ * Availability:
+ *
+ *   alpha 34
+ *
+ * Status:
+ *
+ *   experimental
+ */
+static int l_space_get_bodies_near(lua_State *l)
+{
+	if (!Pi::game)
+		luaL_error(l, "Game is not started");
+
+	LUA_DEBUG_START(l);
+
+	Body *centre = LuaObject<Body>::CheckFromLua(1);
+	const double radius = luaL_checknumber(l, 2);
+
+	bool typed = false;
+	Object::Type type = Object::OBJECT;
+	if (!lua_isnoneornil(l, 3)) {
+		type = _check_body_type(l, 3);
+		typed = true;
+	}
+
+	bool filter = false;
+	if (!lua_isnoneornil(l, 4)) {
+		luaL_checktype(l, 4, LUA_TFUNCTION);
+		filter = true;
+	}
+
+	Space *space = Pi::game->GetSpace();
+	Space::BodyNearList candidates;
+	space->GetBodiesMaybeNear(centre, radius, candidates);
+
+	// the centre always finds itself if the grid knows about it. if it
+	// doesn't (it, or the whole space, is newer than the last step) the grid
+	// is no use, so just look at everything
+	if (std::find(candidates.begin(), candidates.end(), centre) == candidates.end())
+	{
+		candidates.clear();
+		for (Space::BodyIterator i = space->BodiesBegin(); i != space->BodiesEnd(); ++i)
+			candidates.push_back(*i);
+	}
+
+	// everything that passes the native checks, with its current distance
+	std::vector<NearBody> found;
+	found.reserve(candidates.size());
+	for (Space::BodyNearIterator i = candidates.begin(); i != candidates.end(); ++i) {
+		Body *b = *i;
+		if (b == centre || b->IsDead())
+			continue;
+		if (typed && !b->IsType(type))
+			continue;
+		const double dist = b->GetPositionRelTo(centre).Length();
+		if (dist > radius)
+			continue;
+		found.push_back(NearBody(b, dist));
+	}
+
+	std::stable_sort(found.begin(), found.end());
+
+	lua_newtable(l);
+	int n = 0;
+	for (std::vector<NearBody>::const_iterator i = found.begin(); i != found.end(); ++i) {
+		if (filter && !_filter_accepts(l, 4, (*i).body))
+			continue;
+		LuaObject<Body>::PushToLua((*i).body);
+		lua_rawseti(l, -2, ++n);
+	}
+
+	LUA_DEBUG_END(l, 1);
+
+	return 1;
+}
+
 void LuaSpace::Register()
 {
 	lua_State *l = Lua::manager->GetLuaState();
@@ -677,6 +845,7 @@ void LuaSpace::Register()
 
 		{ "GetBody",   l_space_get_body   },
 		{ "GetBodies", l_space_get_bodies },
+		{ "GetBodiesNear", l_space_get_bodies_near },
 		{ 0, 0 }
 	};
 
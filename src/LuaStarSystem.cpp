@@ -13,6 +13,9 @@
 #include "Planet.h"
 #include "SpaceStation.h"
 #include "galaxy/Sector.h"
+#include "galaxy/GalaxyIndex.h"
+#include "galaxy/RoutePlanner.h"
+#include "LuaRef.h"
 #include "Factions.h"
 #include "FileSystem.h"
 
@@ -98,7 +101,7 @@ static int l_starsystem_get_body_paths(lua_State *l)
 
 	lua_newtable(l);
 
-	for (std::vector< RefCountedPtr<SystemBody> >::const_iterator i = s->m_bodies.begin(); i != s->m_bodies.end(); ++i)
+	for (std::vector<SystemBody*>::const_iterator i = s->m_bodies.begin(); i != s->m_bodies.end(); ++i)
 	{
 		lua_pushinteger(l, lua_rawlen(l, -1)+1);
 		LuaObject<SystemPath>::PushToLua(&(*i)->path);
@@ -140,7 +143,7 @@ static int l_starsystem_get_commodity_base_price_alterations(lua_State *l)
 
 	StarSystem *s = LuaObject<StarSystem>::CheckFromLua(1);
 
-	lua_newtable(l);
+	lua_createtable(l, 0, Equip::LAST_COMMODITY - Equip::FIRST_COMMODITY + 1);
 
 	for (int e = Equip::FIRST_COMMODITY; e <= Equip::LAST_COMMODITY; e++) {
 		lua_pushstring(l, EnumStrings::GetString("EquipType", e));
@@ -180,7 +183,47 @@ static int l_starsystem_is_commodity_legal(lua_State *l)
 {
 	StarSystem *s = LuaObject<StarSystem>::CheckFromLua(1);
 	Equip::Type e = static_cast<Equip::Type>(LuaConstants::GetConstantFromArg(l, "EquipType", 2));
-	lua_pushboolean(l, Polit::IsCommodityLegal(s, e));
+	lua_pushboolean(l, s->IsCommodityLegal(e));
+	return 1;
+}
+
+/*
+ * Method: GetCommodityLegality
+ *
+ * Get the legality of every cargo item in this system at once
+ *
+ * > legal = system:GetCommodityLegality()
+ *
+ * Return:
+ *
+ *   legal - a table. The keys are <Constants.EquipType> strings for each
+ *           cargo, the values are true if the cargo is legal for trade in
+ *           this system and false otherwise
+ *
+ * Availability:
+ *
+ *   alpha 34
+ *
+ * Status:
+ *
+ *   experimental
+ */
+static int l_starsystem_get_commodity_legality(lua_State *l)
+{
+	LUA_DEBUG_START(l);
+
+	StarSystem *s = LuaObject<StarSystem>::CheckFromLua(1);
+
+	lua_createtable(l, 0, Equip::LAST_COMMODITY - Equip::FIRST_COMMODITY + 1);
+
+	for (int e = Equip::FIRST_COMMODITY; e <= Equip::LAST_COMMODITY; e++) {
+		lua_pushstring(l, EnumStrings::GetString("EquipType", e));
+		lua_pushboolean(l, s->IsCommodityLegal(Equip::Type(e)));
+		lua_rawset(l, -3);
+	}
+
+	LUA_DEBUG_END(l, 1);
+
 	return 1;
 }
 
@@ -229,46 +272,25 @@ static int l_starsystem_get_nearby_systems(lua_State *l)
 
 	lua_newtable(l);
 
-	SystemPath here = s->GetPath();
-
-	int here_x = here.sectorX;
-	int here_y = here.sectorY;
-	int here_z = here.sectorZ;
-	Uint32 here_idx = here.systemIndex;
-	Sector here_sec(here_x, here_y, here_z);
-
-	int diff_sec = int(ceil(dist_ly/Sector::SIZE));
-
-	for (int x = here_x-diff_sec; x <= here_x+diff_sec; x++) {
-		for (int y = here_y-diff_sec; y <= here_y+diff_sec; y++) {
-			for (int z = here_z-diff_sec; z <= here_z+diff_sec; z++) {
-				Sector sec(x, y, z);
-
-				for (unsigned int idx = 0; idx < sec.m_systems.size(); idx++) {
-					if (x == here_x && y == here_y && z == here_z && idx == here_idx)
-						continue;
-
-					if (Sector::DistanceBetween(&here_sec, here_idx, &sec, idx) > dist_ly)
-						continue;
-
-					RefCountedPtr<StarSystem> sys = StarSystem::GetCached(SystemPath(x, y, z, idx));
-					if (filter) {
-						lua_pushvalue(l, 3);
-						LuaObject<StarSystem>::PushToLua(sys.Get());
-						lua_call(l, 1, 1);
-						if (!lua_toboolean(l, -1)) {
-							lua_pop(l, 1);
-							continue;
-						}
-						lua_pop(l, 1);
-					}
-
-					lua_pushinteger(l, lua_rawlen(l, -1)+1);
-					LuaObject<StarSystem>::PushToLua(sys.Get());
-					lua_rawset(l, -3);
-				}
+	std::vector<GalaxyIndex::Result> nearby;
+	GalaxyIndex::GetSystemsInRange(s->GetPath(), dist_ly, nearby);
+
+	for (std::vector<GalaxyIndex::Result>::const_iterator i = nearby.begin(); i != nearby.end(); ++i) {
+		RefCountedPtr<StarSystem> sys = StarSystem::GetCached(i->path);
+		if (filter) {
+			lua_pushvalue(l, 3);
+			LuaObject<StarSystem>::PushToLua(sys.Get());
+			lua_call(l, 1, 1);
+			if (!lua_toboolean(l, -1)) {
+				lua_pop(l, 1);
+				continue;
 			}
+			lua_pop(l, 1);
 		}
+
+		lua_pushinteger(l, lua_rawlen(l, -1)+1);
+		LuaObject<StarSystem>::PushToLua(sys.Get());
+		lua_rawset(l, -3);
 	}
 
 	LUA_DEBUG_END(l, 1);
@@ -312,10 +334,10 @@ static int l_starsystem_distance_to(lua_State *l)
 		loc2 = &(s2->GetPath());
 	}
 
-	Sector sec1(loc1->sectorX, loc1->sectorY, loc1->sectorZ);
-	Sector sec2(loc2->sectorX, loc2->sectorY, loc2->sectorZ);
+	RefCountedPtr<Sector> sec1 = Sector::GetCached(*loc1);
+	RefCountedPtr<Sector> sec2 = Sector::GetCached(*loc2);
 
-	double dist = Sector::DistanceBetween(&sec1, loc1->systemIndex, &sec2, loc2->systemIndex);
+	double dist = Sector::DistanceBetween(sec1.Get(), loc1->systemIndex, sec2.Get(), loc2->systemIndex);
 
 	lua_pushnumber(l, dist);
 
@@ -323,6 +345,96 @@ static int l_starsystem_distance_to(lua_State *l)
 	return 1;
 }
 
+static void route_planned(const RoutePlanner::Route &route, LuaRef callback)
+{
+	// the game it was planned for is gone
+	if (!Pi::game) return;
+
+	lua_State *l = callback.GetLua();
+
+	LUA_DEBUG_START(l);
+
+	callback.PushCopyToStack();
+
+	if (route.found) {
+		lua_createtable(l, route.systems.size(), 0);
+		for (size_t i = 0; i < route.systems.size(); i++) {
+			LuaObject<SystemPath>::PushToLua(route.systems[i]);
+			lua_rawseti(l, -2, i+1);
+		}
+		lua_pushnumber(l, route.distance);
+	} else {
+		lua_pushnil(l);
+		lua_pushnil(l);
+	}
+
+	pi_lua_protected_call(l, 2, 0);
+
+	LUA_DEBUG_END(l, 0);
+}
+
+/*
+ * Method: PlanRoute
+ *
+ * Plan a chain of hyperspace jumps from this system to another, in the
+ * background
+ *
+ * > system:PlanRoute(target, range, callback, fewestJumps)
+ *
+ * Parameters:
+ *
+ *   target - a <SystemPath> or <StarSystem> to plan the route to
+ *
+ *   range - the longest jump the route can make, in light years. usually a
+ *           ship's hyperspaceRange
+ *
+ *   callback - a function called once the route has been worked out, with
+ *              the route and its length in light years. the route is an
+ *              array of <SystemPaths> from this system to the target, both
+ *              included. if there's no route both are nil
+ *
+ *   fewestJumps - optional. if true the route makes as few jumps as it can,
+ *                 otherwise it's as short as it can be. defaults to false
+ *
+ * Example:
+ *
+ * > Game.system:PlanRoute(target, ship:GetStats().hyperspaceRange, function (route, distance)
+ * >     if route then print(#route-1 .. " jumps, " .. distance .. " ly") end
+ * > end)
+ *
+ * Availability:
+ *
+ *   alpha 34
+ *
+ * Status:
+ *
+ *   experimental
+ */
+static int l_starsystem_plan_route(lua_State *l)
+{
+	LUA_DEBUG_START(l);
+
+	StarSystem *s = LuaObject<StarSystem>::CheckFromLua(1);
+
+	const SystemPath *target = LuaObject<SystemPath>::GetFromLua(2);
+	if (!target) {
+		StarSystem *s2 = LuaObject<StarSystem>::CheckFromLua(2);
+		target = &(s2->GetPath());
+	}
+	if (!target->HasValidSystem())
+		return luaL_error(l, "target must be a system, not a sector");
+
+	const float range = luaL_checknumber(l, 3);
+	luaL_checktype(l, 4, LUA_TFUNCTION);
+	const RoutePlanner::Cost cost = lua_toboolean(l, 5) ? RoutePlanner::FEWEST_JUMPS : RoutePlanner::SHORTEST;
+
+	RoutePlanner::Plan(s->GetPath(), *target, range, cost, sigc::bind(sigc::ptr_fun(&route_planned), LuaRef(l, 4)));
+
+	LUA_DEBUG_END(l, 0);
+
+	return 0;
+}
+
 /*
  * Method: ExportToLua
  *
@@ -498,11 +610,14 @@ template <> void LuaObject<StarSystem>::RegisterClass()
 
 		{ "GetCommodityBasePriceAlterations", l_starsystem_get_commodity_base_price_alterations },
 		{ "IsCommodityLegal",                 l_starsystem_is_commodity_legal                   },
+		{ "GetCommodityLegality",             l_starsystem_get_commodity_legality               },
 
 		{ "GetNearbySystems", l_starsystem_get_nearby_systems },
 
 		{ "DistanceTo", l_starsystem_distance_to },
 
+		{ "PlanRoute", l_starsystem_plan_route },
+
 		{ "ExportToLua", l_starsystem_export_to_lua },
 
 		{ 0, 0 }
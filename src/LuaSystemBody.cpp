@@ -141,15 +141,11 @@ static int l_sbody_attr_parent(lua_State *l)
 {
 	SystemBody *sbody = LuaObject<SystemBody>::CheckFromLua(1);
 
-	// sbody->parent is 0 as it was cleared by the acquirer. we need to go
-	// back to the starsystem proper to get what we need.
-	RefCountedPtr<StarSystem> s = StarSystem::GetCached(sbody->path);
-	SystemBody *live_sbody = s->GetBodyByPath(sbody->path);
-
-	if (!live_sbody->parent)
+	// the body's reference keeps its system, and so its parent, alive
+	if (!sbody->parent)
 		return 0;
 
-	LuaObject<SystemBody>::PushToLua(live_sbody->parent);
+	LuaObject<SystemBody>::PushToLua(sbody->parent);
 	return 1;
 }
 
@@ -70,8 +70,8 @@ static int l_sbodypath_new(lua_State *l)
 		path.systemIndex = luaL_checkinteger(l, 4);
 
 		// if this is a system path, then check that the system exists
-		Sector s(sector_x, sector_y, sector_z);
-		if (size_t(path.systemIndex) >= s.m_systems.size())
+		RefCountedPtr<Sector> s = Sector::GetCached(path);
+		if (size_t(path.systemIndex) >= s->m_systems.size())
 			luaL_error(l, "System %d in sector <%d,%d,%d> does not exist", path.systemIndex, sector_x, sector_y, sector_z);
 
 		if (lua_gettop(l) > 4) {
@@ -241,10 +241,10 @@ static int l_sbodypath_distance_to(lua_State *l)
 		loc2 = &(s2->GetPath());
 	}
 
-	Sector sec1(loc1->sectorX, loc1->sectorY, loc1->sectorZ);
-	Sector sec2(loc2->sectorX, loc2->sectorY, loc2->sectorZ);
+	RefCountedPtr<Sector> sec1 = Sector::GetCached(*loc1);
+	RefCountedPtr<Sector> sec2 = Sector::GetCached(*loc2);
 
-	double dist = Sector::DistanceBetween(&sec1, loc1->systemIndex, &sec2, loc2->systemIndex);
+	double dist = Sector::DistanceBetween(sec1.Get(), loc1->systemIndex, sec2.Get(), loc2->systemIndex);
 
 	lua_pushnumber(l, dist);
 
@@ -3,63 +3,187 @@
 
 #include "LuaTimer.h"
 #include "LuaUtils.h"
+#include "LuaMemoryTracker.h"
 #include "Game.h"
+#include "OS.h"
+#include "Profiler.h"
 #include "Pi.h"
+#include <algorithm>
 
 void LuaTimer::Tick()
 {
+	PROFILE_ZONE("LuaTimer::Tick");
+
 	assert(Pi::game);
+
+	const double now = Pi::game->GetTime();
+	if (m_heap.empty() || m_heap.front().at > now)
+		return;
+
 	lua_State *l = Lua::manager->GetLuaState();
 
 	LUA_DEBUG_START(l);
 
+	lua_getfield(l, LUA_REGISTRYINDEX, "PiTimerCallbacks");
+	assert(lua_istable(l, -1));
+
+	m_due.clear();
+	while (!m_heap.empty() && m_heap.front().at <= now) {
+		std::pop_heap(m_heap.begin(), m_heap.end(), DueLater());
+		m_due.push_back(m_heap.back());
+		m_heap.pop_back();
+	}
+
+	// everything that's due is called once, oldest timer first. anything
+	// the callbacks schedule can't be due until a later tick
+	std::sort(m_due.begin(), m_due.end(), CreatedEarlier());
+
+	for (std::vector<Timer>::iterator i = m_due.begin(); i != m_due.end(); ++i) {
+		lua_rawgeti(l, -1, (*i).callback);
+		pi_lua_protected_call(l, 0, 1);
+		bool cancel = lua_toboolean(l, -1);
+		lua_pop(l, 1);
+
+		if ((*i).every <= 0.0 || cancel)
+			luaL_unref(l, -1, (*i).callback);
+		else {
+			(*i).at = Pi::game->GetTime() + (*i).every;
+			m_heap.push_back(*i);
+			std::push_heap(m_heap.begin(), m_heap.end(), DueLater());
+		}
+	}
+
+	lua_pop(l, 1);
+
+	LUA_DEBUG_END(l, 0);
+}
+
+void LuaTimer::Schedule(lua_State *l, double at, double every, int funcIndex)
+{
+	LUA_DEBUG_START(l);
+
+	lua_pushvalue(l, funcIndex);
+
 	lua_getfield(l, LUA_REGISTRYINDEX, "PiTimerCallbacks");
 	if (lua_isnil(l, -1)) {
 		lua_pop(l, 1);
-		LUA_DEBUG_END(l, 0);
-		return;
+		lua_newtable(l);
+		lua_pushvalue(l, -1);
+		lua_setfield(l, LUA_REGISTRYINDEX, "PiTimerCallbacks");
 	}
-	assert(lua_istable(l, -1));
 
-	double now = Pi::game->GetTime();
+	lua_insert(l, -2);
+	Timer t;
+	t.at = at;
+	t.every = every;
+	t.callback = luaL_ref(l, -2);
+	t.seq = m_nextSeq++;
 
-	lua_pushnil(l);
-	while (lua_next(l, -2)) {
-		assert(lua_istable(l, -1));
+	lua_pop(l, 1);
 
-		lua_getfield(l, -1, "at");
-		double at = lua_tonumber(l, -1);
+	m_heap.push_back(t);
+	std::push_heap(m_heap.begin(), m_heap.end(), DueLater());
+
+	LUA_DEBUG_END(l, 0);
+}
+
+// push the registry table holding the task threads, making it if need be
+static void _push_task_table(lua_State *l)
+{
+	lua_getfield(l, LUA_REGISTRYINDEX, "PiTimerTasks");
+	if (lua_isnil(l, -1)) {
 		lua_pop(l, 1);
+		lua_newtable(l);
+		lua_pushvalue(l, -1);
+		lua_setfield(l, LUA_REGISTRYINDEX, "PiTimerTasks");
+	}
+}
+
+void LuaTimer::StartTask(lua_State *l, int funcIndex)
+{
+	LUA_DEBUG_START(l);
 
-		if (at <= now) {
-			lua_getfield(l, -1, "callback");
-			pi_lua_protected_call(l, 0, 1);
-			bool cancel = lua_toboolean(l, -1);
-			lua_pop(l, 1);
+	funcIndex = lua_absindex(l, funcIndex);
 
-			lua_getfield(l, -1, "every");
-			if (lua_isnil(l, -1) || cancel) {
-				lua_pop(l, 1);
+	_push_task_table(l);
 
-				lua_pushvalue(l, -2);
-				lua_pushnil(l);
-				lua_settable(l, -5);
-			}
-			else {
-				double every = lua_tonumber(l, -1);
-				lua_pop(l, 1);
+	Task t;
+	t.thread = lua_newthread(l);
+	lua_pushvalue(l, funcIndex);
+	lua_xmove(l, t.thread, 1);
+	t.ref = luaL_ref(l, -2);
+
+	lua_pop(l, 1);
+
+	m_tasks.push_back(t);
+
+	LUA_DEBUG_END(l, 0);
+}
+
+void LuaTimer::RunTasks()
+{
+	if (m_tasks.empty())
+		return;
+
+	lua_State *l = Lua::manager->GetLuaState();
+
+	LUA_DEBUG_START(l);
+
+	_push_task_table(l);
+
+	const Uint64 freq = OS::HFTimerFreq();
+	const Uint64 end = OS::HFTimer() + (m_taskBudget > 0 ? (Uint64(m_taskBudget) * freq) / 1000000 : 0);
 
-				pi_lua_settable(l, "at", Pi::game->GetTime() + every);
+	// each task gets at most one turn a frame, so anything they start now
+	// waits for the next one
+	for (size_t turns = m_tasks.size(); turns > 0; turns--) {
+		Task t = m_tasks.front();
+		m_tasks.pop_front();
+
+		// the first resume starts the function, which is already on the
+		// thread's stack. later ones return nothing from the yield
+		const int nargs = lua_status(t.thread) == LUA_YIELD ? 0 : lua_gettop(t.thread) - 1;
+		LuaMemoryTracker::SetThread(t.thread);
+		const int ret = lua_resume(t.thread, l, nargs);
+		LuaMemoryTracker::SetThread(0);
+
+		if (ret == LUA_YIELD) {
+			lua_settop(t.thread, 0);
+			m_tasks.push_back(t);
+		}
+		else {
+			if (ret != LUA_OK) {
+				// same treatment as an error anywhere else in Lua
+				luaL_traceback(l, t.thread, lua_tostring(t.thread, -1), 0);
+				const std::string errorMsg = lua_tostring(l, -1);
+				lua_pop(l, 1);
+				Error("%s", errorMsg.c_str());
 			}
+			luaL_unref(l, -1, t.ref);
 		}
 
-		lua_pop(l, 1);
+		if (m_taskBudget > 0 && OS::HFTimer() >= end)
+			break;
 	}
+
 	lua_pop(l, 1);
 
 	LUA_DEBUG_END(l, 0);
 }
 
+void LuaTimer::ClearTasks()
+{
+	if (m_tasks.empty())
+		return;
+
+	lua_State *l = Lua::manager->GetLuaState();
+
+	// the threads are collected once nothing refers to them
+	lua_pushnil(l);
+	lua_setfield(l, LUA_REGISTRYINDEX, "PiTimerTasks");
+	m_tasks.clear();
+}
+
 /*
  * Class: Timer
  *
@@ -96,28 +220,6 @@ void LuaTimer::Tick()
  * underlying object exists before trying to use it.
  */
 
-static void _finish_timer_create(lua_State *l)
-{
-	lua_pushstring(l, "callback");
-	lua_pushvalue(l, 3);
-	lua_settable(l, -3);
-
-	lua_getfield(l, LUA_REGISTRYINDEX, "PiTimerCallbacks");
-	if (lua_isnil(l, -1)) {
-		lua_pop(l, 1);
-		lua_newtable(l);
-		lua_pushvalue(l, -1);
-		lua_setfield(l, LUA_REGISTRYINDEX, "PiTimerCallbacks");
-	}
-
-	lua_insert(l, -2);
-	lua_pushinteger(l, lua_rawlen(l, -2) + 1);
-	lua_insert(l, -2);
-	lua_settable(l, -3);
-
-	lua_pop(l, 1);
-}
-
 /*
  * Method: CallAt
  *
@@ -160,14 +262,7 @@ static int l_timer_call_at(lua_State *l)
 	if (at <= Pi::game->GetTime())
 		luaL_error(l, "Specified time is in the past");
 
-	LUA_DEBUG_START(l);
-
-	lua_newtable(l);
-	pi_lua_settable(l, "at", at);
-
-	_finish_timer_create(l);
-
-	LUA_DEBUG_END(l, 0);
+	LuaObject<LuaTimer>::CheckFromLua(1)->Schedule(l, at, 0.0, 3);
 
 	return 0;
 }
@@ -223,15 +318,59 @@ static int l_timer_call_every(lua_State *l)
 	if (every <= 0)
 		luaL_error(l, "Specified interval must be greater than zero");
 
-	LUA_DEBUG_START(l);
+	LuaObject<LuaTimer>::CheckFromLua(1)->Schedule(l, Pi::game->GetTime() + every, every, 3);
 
-	lua_newtable(l);
-	pi_lua_settable(l, "every", every);
-	pi_lua_settable(l, "at", Pi::game->GetTime() + every);
+	return 0;
+}
 
-	_finish_timer_create(l);
+/*
+ * Method: StartTask
+ *
+ * Run a function a little at a time, over many frames.
+ *
+ * > Timer:StartTask(function)
+ *
+ * The function is run as a coroutine. Whenever it calls coroutine.yield()
+ * it gives up the rest of the frame, and it's resumed from there on a later
+ * one. Each frame only has a certain amount of time for tasks (the
+ * LuaTaskBudget setting), shared out between all of them in turn, so a job
+ * that would otherwise hold up a frame can be spread out by yielding every
+ * so often.
+ *
+ * Tasks run in real time, not game time, and keep running while the game is
+ * paused, but not in hyperspace. They are not saved, and are dropped when
+ * the game ends. Like timer functions, they can find that game objects they
+ * held on to have gone away between turns; see <Object.exists>.
+ *
+ * Parameters:
+ *
+ *   function - the function to run. Takes no parameters and returns nothing.
+ *
+ * Example:
+ *
+ * > Timer:StartTask(function ()
+ * >     for i,station in ipairs(Space.GetBodies("SpaceStation")) do
+ * >         makeAdverts(station)
+ * >         coroutine.yield()
+ * >     end
+ * > end)
+ *
+ * Availability:
+ *
+ *   alpha 34
+ *
+ * Status:
+ *
+ *   experimental
+ */
+static int l_timer_start_task(lua_State *l)
+{
+	if (!Pi::game)
+		luaL_error(l, "Game is not started");
 
-	LUA_DEBUG_END(l, 0);
+	luaL_checktype(l, 2, LUA_TFUNCTION); // any type of function
+
+	LuaObject<LuaTimer>::CheckFromLua(1)->StartTask(l, 2);
 
 	return 0;
 }
@@ -243,6 +382,7 @@ template <> void LuaObject<LuaTimer>::RegisterClass()
 	static const luaL_Reg l_methods[] = {
 		{ "CallAt",    l_timer_call_at    },
 		{ "CallEvery", l_timer_call_every },
+		{ "StartTask", l_timer_start_task },
 		{ 0, 0 }
 	};
 
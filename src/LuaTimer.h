@@ -6,10 +6,74 @@
 
 #include "LuaManager.h"
 #include "DeleteEmitter.h"
+#include <deque>
+#include <vector>
 
+// timers are kept in a heap ordered by when they're due, so a tick that has
+// nothing to call only looks at the top of it. the callbacks themselves live
+// in the registry table PiTimerCallbacks, and the heap holds refs to them
+//
+// tasks are coroutines for work that's too long to do in one go. each frame
+// the main loop resumes them in turn until the task budget is used up, and
+// they run until they yield or finish. the threads are kept alive by refs in
+// the registry table PiTimerTasks
 class LuaTimer : public DeleteEmitter {
 public:
+	LuaTimer() : m_nextSeq(0), m_taskBudget(0) {}
+
 	void Tick();
+
+	// call the function at funcIndex on the stack at game time at, and then
+	// every seconds after that if every isn't 0
+	void Schedule(lua_State *l, double at, double every, int funcIndex);
+
+	// run the function at funcIndex on the stack as a task, starting next
+	// frame
+	void StartTask(lua_State *l, int funcIndex);
+
+	// microseconds per frame to spend resuming tasks. every waiting task
+	// gets a turn if it's 0, and at least one does whatever it is
+	void SetTaskBudget(int us) { m_taskBudget = us; }
+
+	// give the waiting tasks their turns for this frame. real time, not
+	// game time, so they make progress while the game is paused
+	void RunTasks();
+
+	// drop every task, finished or not
+	void ClearTasks();
+
+	size_t GetNumTasks() const { return m_tasks.size(); }
+
+private:
+	struct Timer {
+		double at;
+		double every;
+		int callback; // ref in PiTimerCallbacks
+		Uint32 seq;   // creation order. due timers are called in this order
+	};
+
+	// puts the soonest at the top of the heap
+	struct DueLater {
+		bool operator()(const Timer &a, const Timer &b) const {
+			return a.at > b.at || (!(a.at < b.at) && a.seq > b.seq);
+		}
+	};
+
+	struct CreatedEarlier {
+		bool operator()(const Timer &a, const Timer &b) const { return a.seq < b.seq; }
+	};
+
+	struct Task {
+		lua_State *thread;
+		int ref; // in PiTimerTasks
+	};
+
+	std::vector<Timer> m_heap;
+	std::vector<Timer> m_due; // only used by Tick, kept to save reallocating
+	Uint32 m_nextSeq;
+
+	std::deque<Task> m_tasks; // in the order they'll next be resumed
+	int m_taskBudget;
 };
 
 #endif
@@ -4,6 +4,8 @@
 #include "LuaUtils.h"
 #include "libs.h"
 #include "FileSystem.h"
+#include "LuaBytecodeCache.h"
+#include "LuaProfiler.h"
 
 extern "C" {
 #ifdef ENABLE_LDB
@@ -281,9 +283,11 @@ int pi_lua_panic(lua_State *L)
 
 void pi_lua_protected_call(lua_State* L, int nargs, int nresults) {
 	int handleridx = lua_gettop(L) - nargs;
+	LuaProfiler::Enter(L, handleridx);
 	lua_pushcfunction(L, &l_handle_error);
 	lua_insert(L, handleridx);
 	int ret = lua_pcall(L, nargs, nresults, handleridx);
+	LuaProfiler::Leave();
 	lua_remove(L, handleridx); // pop error_handler
 	if (ret) {
 		std::string errorMsg = lua_tostring(L, -1);
@@ -312,7 +316,7 @@ static void pi_lua_dofile(lua_State *l, const FileSystem::FileData &code)
 	bool trusted = code.GetInfo().GetSource().IsTrusted();
 	const std::string chunkName = (trusted ? "[T] @" : "@") + path;
 
-	if (luaL_loadbuffer(l, source.begin, source.Size(), chunkName.c_str())) {
+	if (LuaBytecodeCache::Load(l, source.begin, source.Size(), chunkName)) {
 		pi_lua_panic(l);
 	} else {
 		int ret = lua_pcall(l, 0, 0, -2);
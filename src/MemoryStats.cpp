@@ -0,0 +1,160 @@
+// Copyright © 2008-2013 Pioneer Developers. See AUTHORS.txt for details
+// Licensed under the terms of the GPL v3. See licenses/GPL-3.txt
+
+#include "MemoryStats.h"
+#include "SDL_thread.h"
+#include <algorithm>
+#include <cassert>
+#include <cstdio>
+
+namespace MemoryStats {
+
+static const char *s_names[NUM_TAGS] = {
+	"terrain",
+	"terrain_vbo",
+	"models",
+	"textures",
+	"star_systems",
+	"sectors",
+	"sfx",
+	"sound",
+	"saves"
+};
+
+struct Counter {
+	size_t current;
+	size_t peak;
+	size_t budget;
+};
+
+static Counter s_counters[NUM_TAGS];
+static size_t s_total = 0;
+static size_t s_totalPeak = 0;
+static SDL_mutex *s_lock = 0;
+
+class Lock {
+public:
+	Lock() { if (s_lock) SDL_LockMutex(s_lock); }
+	~Lock() { if (s_lock) SDL_UnlockMutex(s_lock); }
+};
+
+void Init()
+{
+	if (!s_lock) s_lock = SDL_CreateMutex();
+}
+
+const char *GetName(Tag tag)
+{
+	assert(tag < NUM_TAGS);
+	return s_names[tag];
+}
+
+void Add(Tag tag, size_t bytes)
+{
+	if (tag >= NUM_TAGS || !bytes) return;
+	Lock lock;
+	Counter &c = s_counters[tag];
+	c.current += bytes;
+	c.peak = std::max(c.peak, c.current);
+	s_total += bytes;
+	s_totalPeak = std::max(s_totalPeak, s_total);
+}
+
+void Remove(Tag tag, size_t bytes)
+{
+	if (tag >= NUM_TAGS || !bytes) return;
+	Lock lock;
+	Counter &c = s_counters[tag];
+	assert(c.current >= bytes);
+	c.current -= std::min(c.current, bytes);
+	s_total -= std::min(s_total, bytes);
+}
+
+size_t GetCurrent(Tag tag)
+{
+	assert(tag < NUM_TAGS);
+	Lock lock;
+	return s_counters[tag].current;
+}
+
+size_t GetPeak(Tag tag)
+{
+	assert(tag < NUM_TAGS);
+	Lock lock;
+	return s_counters[tag].peak;
+}
+
+size_t GetTotal()
+{
+	Lock lock;
+	return s_total;
+}
+
+size_t GetTotalPeak()
+{
+	Lock lock;
+	return s_totalPeak;
+}
+
+void ResetPeaks()
+{
+	Lock lock;
+	for (int i = 0; i < NUM_TAGS; i++)
+		s_counters[i].peak = s_counters[i].current;
+	s_totalPeak = s_total;
+}
+
+void SetBudget(Tag tag, size_t bytes)
+{
+	assert(tag < NUM_TAGS);
+	Lock lock;
+	s_counters[tag].budget = bytes;
+}
+
+size_t GetBudget(Tag tag)
+{
+	assert(tag < NUM_TAGS);
+	Lock lock;
+	return s_counters[tag].budget;
+}
+
+bool IsOverBudget(Tag tag)
+{
+	assert(tag < NUM_TAGS);
+	Lock lock;
+	const Counter &c = s_counters[tag];
+	return c.budget && c.current > c.budget;
+}
+
+static inline double mb(size_t bytes)
+{
+	return double(bytes) / double(1 << 20);
+}
+
+std::string Report()
+{
+	Counter counters[NUM_TAGS];
+	size_t total, totalPeak;
+	{
+		Lock lock;
+		std::copy(s_counters, s_counters + NUM_TAGS, counters);
+		total = s_total;
+		totalPeak = s_totalPeak;
+	}
+
+	char buf[128];
+	snprintf(buf, sizeof(buf), "Memory: %.1f MB, peak %.1f MB", mb(total), mb(totalPeak));
+	std::string out(buf);
+	for (int i = 0; i < NUM_TAGS; i++) {
+		const Counter &c = counters[i];
+		snprintf(buf, sizeof(buf), "\n  %-12s %7.1f MB, peak %7.1f MB", s_names[i], mb(c.current), mb(c.peak));
+		out += buf;
+		if (c.budget) {
+			snprintf(buf, sizeof(buf), " of %.0f MB%s", mb(c.budget), c.current > c.budget ? ", OVER" : "");
+			out += buf;
+		}
+	}
+	return out;
+}
+
+}
@@ -0,0 +1,71 @@
+// Copyright © 2008-2013 Pioneer Developers. See AUTHORS.txt for details
+// Licensed under the terms of the GPL v3. See licenses/GPL-3.txt
+
+#ifndef _MEMORYSTATS_H
+#define _MEMORYSTATS_H
+
+#include <cstddef>
+#include <string>
+
+// bytes held by each of the big memory users, and the most each has held
+// since the peaks were last reset. the owners charge and refund their memory
+// in big pieces (pool slabs, whole buffers, cache entries), so this never
+// sees individual small allocations and costs next to nothing.
+//
+// each tag can have a budget. this doesn't enforce it, the owner's eviction
+// does where it has any, but the readout shows what's over
+namespace MemoryStats {
+
+	enum Tag {
+		TERRAIN,      // patch heights, normals and colours
+		TERRAIN_VBO,  // patch vertex buffers
+		MODELS,       // model vertex and index data
+		TEXTURES,     // resident textures
+		STAR_SYSTEMS, // the star system cache
+		SECTORS,      // the sector cache
+		SFX,          // per-frame effect arrays
+		SOUND,        // decoded sound samples
+		SAVES,        // serialised games held in memory
+		NUM_TAGS,
+		UNTRACKED = NUM_TAGS
+	};
+
+	// makes Add and Remove safe from any thread. until it's called they
+	// don't lock, which is fine for single threaded tools
+	void Init();
+
+	const char *GetName(Tag tag);
+
+	// UNTRACKED is ignored
+	void Add(Tag tag, size_t bytes);
+	void Remove(Tag tag, size_t bytes);
+
+	size_t GetCurrent(Tag tag);
+	size_t GetPeak(Tag tag);
+	size_t GetTotal();
+	size_t GetTotalPeak();
+	// peaks start again from what's held now
+	void ResetPeaks();
+
+	// 0 for no budget
+	void SetBudget(Tag tag, size_t bytes);
+	size_t GetBudget(Tag tag);
+	bool IsOverBudget(Tag tag);
+
+	// a line per tag, for the debug readout
+	std::string Report();
+
+	// charges bytes for as long as it's in scope
+	class ScopedCharge {
+	public:
+		ScopedCharge(Tag tag, size_t bytes) : m_tag(tag), m_bytes(bytes) { Add(m_tag, m_bytes); }
+		~ScopedCharge() { Remove(m_tag, m_bytes); }
+	private:
+		ScopedCharge(const ScopedCharge &);
+		ScopedCharge &operator=(const ScopedCharge &);
+		const Tag m_tag;
+		const size_t m_bytes;
+	};
+}
+
+#endif
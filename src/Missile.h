@@ -7,8 +7,9 @@
 #include <list>
 #include "libs.h"
 #include "Ship.h"
+#include "BodyPool.h"
 
-class Missile: public Ship {
+class Missile: public Ship, public BodyPool<Missile> {
 public:
 	OBJDEF(Missile, Ship, MISSILE);
 	Missile(ShipType::Id type, Body *owner, int power=-1);
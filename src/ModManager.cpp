@@ -17,4 +17,7 @@ void ModManager::Init() {
 			FileSystem::gameDataFiles.PrependSource(new FileSystem::FileSourceZip(FileSystem::userFiles, zipPath));
 		}
 	}
+
+	// all the sources are in place now
+	FileSystem::gameDataFiles.BuildIndex();
 }
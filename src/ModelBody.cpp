@@ -4,6 +4,7 @@
 #include "libs.h"
 #include "ModelBody.h"
 #include "Frame.h"
+#include "FrameProfiler.h"
 #include "Game.h"
 #include "matrix4x4.h"
 #include "ModelCache.h"
@@ -293,14 +294,16 @@ void ModelBody::ResetLighting(Graphics::Renderer *r, const std::vector<Graphics:
 
 void ModelBody::RenderModel(Graphics::Renderer *r, const Camera *camera, const vector3d &viewCoords, const matrix4x4d &viewTransform, const bool setLighting)
 {
+	FrameProfiler::ScopedPass pass(FrameProfiler::PASS_MODELS);
+
 	std::vector<Graphics::Light> oldLights;
 	Color oldAmbient;
 	if (setLighting)
 		SetLighting(r, camera, oldLights, oldAmbient);
 
-	matrix4x4d m2 = GetInterpOrient();
-	m2.SetTranslate(GetInterpPosition());
-	matrix4x4d t = viewTransform * m2;
+	// the translation is viewCoords, already worked out relative to the
+	// camera, so only the orientation needs multiplying out
+	const matrix4x4d t(viewTransform.GetOrient() * GetInterpOrient());
 
 	//double to float matrix
 	matrix4x4f trans;
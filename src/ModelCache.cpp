@@ -2,40 +2,290 @@
 // Licensed under the terms of the GPL v3. See licenses/GPL-3.txt
 
 #include "ModelCache.h"
+#include "JobQueue.h"
+#include "MemoryStats.h"
 #include "scenegraph/SceneGraph.h"
+#include "scenegraph/NodeVisitor.h"
+#include "graphics/Material.h"
+#include "graphics/StaticMesh.h"
+#include "graphics/Texture.h"
 
-ModelCache::ModelCache(Graphics::Renderer *r)
+// models found in the last this many milliseconds are kept, so what's
+// just been handed out isn't dropped before it's instanced
+static const Uint32 KEEP_TICKS = 5000;
+
+class ModelCache::ReadJob : public Job {
+public:
+	ReadJob(ModelCache *cache, const std::string &name) :
+		m_cache(cache), m_files(new SceneGraph::ModelFiles(name)), m_ok(false) {}
+	virtual ~ReadJob() { delete m_files; }
+	virtual const char *GetName() const { return "ModelCache::ReadJob"; }
+
+	virtual void OnRun() {
+		try {
+			m_files->Read();
+			m_ok = true;
+		} catch (SceneGraph::LoadingError &) {
+		}
+	}
+
+	virtual void OnFinish() {
+		m_cache->OnFilesRead(m_files, m_ok);
+		m_files = 0;
+	}
+
+private:
+	ModelCache *m_cache;
+	SceneGraph::ModelFiles *m_files;
+	bool m_ok;
+};
+
+// adds up the geometry, each mesh once however often it's attached
+class MemoryVisitor : public SceneGraph::NodeVisitor {
+public:
+	MemoryVisitor() : bytes(0) {}
+
+	virtual void ApplyStaticGeometry(SceneGraph::StaticGeometry &g) {
+		for (unsigned int i = 0; i < g.GetNumMeshes(); i++) {
+			Graphics::StaticMesh *mesh = g.GetMesh(i).Get();
+			if (!m_meshes.insert(mesh).second) continue;
+			// position, normal and uv0, as models have them
+			size_t meshBytes = size_t(mesh->GetNumVerts()) * 32 + size_t(mesh->GetNumIndices()) * sizeof(Uint16);
+			// and the same again once the renderer has its buffers
+			if (mesh->cached) meshBytes *= 2;
+			bytes += meshBytes;
+		}
+		g.Traverse(*this);
+	}
+
+	size_t bytes;
+
+private:
+	std::set<Graphics::StaticMesh*> m_meshes;
+};
+
+static size_t texture_bytes(const Graphics::Texture *t)
+{
+	// RGBA with mipmaps. compressed textures take less
+	const vector2f &size = t->GetDescriptor().dataSize;
+	return size_t(size.x * size.y * 4.f * 4.f / 3.f);
+}
+
+size_t ModelCache::GetMeshMemoryUsage(SceneGraph::Model *m)
+{
+	MemoryVisitor mv;
+	m->GetRoot()->Accept(mv);
+	return mv.bytes;
+}
+
+size_t ModelCache::GetMemoryUsage(SceneGraph::Model *m)
+{
+	std::set<const Graphics::Texture*> textures;
+	for (unsigned int i = 0; i < m->GetNumMaterials(); i++) {
+		const Graphics::Material *mat = m->GetMaterialByIndex(i).Get();
+		const Graphics::Texture *maps[] = { mat->texture0, mat->texture1, mat->texture2 };
+		for (unsigned int j = 0; j < COUNTOF(maps); j++)
+			if (maps[j]) textures.insert(maps[j]);
+	}
+
+	size_t bytes = GetMeshMemoryUsage(m);
+	for (std::set<const Graphics::Texture*>::const_iterator it = textures.begin(); it != textures.end(); ++it)
+		bytes += texture_bytes(*it);
+	return bytes;
+}
+
+ModelCache::ModelCache(Graphics::Renderer *r, Graphics::TextureLoader *textureLoader, JobQueue *jobs)
 : m_renderer(r)
+, m_textureLoader(textureLoader)
+, m_jobs(jobs)
+, m_jobGroup(jobs ? jobs->NewGroup() : 0)
+, m_budget(0)
 {
 
 }
 
 ModelCache::~ModelCache()
 {
+	// none of them will call back after this
+	if (m_jobs) m_jobs->CancelGroup(m_jobGroup);
 	Flush();
 }
 
+SceneGraph::Model *ModelCache::Load(const SceneGraph::ModelFiles &files)
+{
+	SceneGraph::Loader loader(m_renderer);
+	loader.SetTextureLoader(m_textureLoader);
+	return loader.LoadModel(files);
+}
+
+void ModelCache::Add(const std::string &name, SceneGraph::Model *m)
+{
+	Entry &e = m_models[name];
+	e.model = m;
+	e.bytes = GetMemoryUsage(m);
+	e.meshBytes = GetMeshMemoryUsage(m);
+	MemoryStats::Add(MemoryStats::MODELS, e.meshBytes);
+	e.lastUsed = SDL_GetTicks();
+	m_stats.models++;
+	m_stats.loads++;
+	m_stats.bytes += e.bytes;
+	m_evictedBytes.erase(name);
+}
+
 SceneGraph::Model *ModelCache::FindModel(const std::string &name)
 {
 	ModelMap::iterator it = m_models.find(name);
 
 	if (it == m_models.end()) {
+		// a request still reading its files is beaten to it, and its
+		// results dropped when they arrive
+		RefCountedPtr<Request> req;
+		RequestMap::iterator pending = m_requests.find(name);
+		if (pending != m_requests.end()) {
+			req = pending->second;
+			m_requests.erase(pending);
+		}
+
 		try {
-			SceneGraph::Loader loader(m_renderer);
-			SceneGraph::Model *m = loader.LoadModel(name);
-			m_models[name] = m;
+			SceneGraph::ModelFiles files(name);
+			files.Read();
+			SceneGraph::Model *m = Load(files);
+			Add(name, m);
+			if (req) req->Resolve(m);
 			return m;
 		} catch (SceneGraph::LoadingError &) {
+			if (req) req->Resolve(0);
 			throw ModelNotFoundException();
 		}
 	}
-	return it->second;
+	it->second.lastUsed = SDL_GetTicks();
+	return it->second.model;
+}
+
+RefCountedPtr<ModelCache::Request> ModelCache::RequestModel(const std::string &name)
+{
+	RequestMap::iterator pending = m_requests.find(name);
+	if (pending != m_requests.end())
+		return pending->second;
+
+	RefCountedPtr<Request> req(new Request(name));
+
+	ModelMap::iterator it = m_models.find(name);
+	if (it != m_models.end()) {
+		it->second.lastUsed = SDL_GetTicks();
+		req->Resolve(it->second.model);
+		return req;
+	}
+
+	if (!m_jobs) {
+		try {
+			req->Resolve(FindModel(name));
+		} catch (ModelNotFoundException &) {
+			req->Resolve(0);
+		}
+		return req;
+	}
+
+	m_requests[name] = req;
+	ReadJob *job = new ReadJob(this, name);
+	job->SetGroup(m_jobGroup);
+	job->SetPriority(Job::PRIORITY_LOW);
+	m_jobs->Queue(job);
+	return req;
+}
+
+void ModelCache::OnFilesRead(SceneGraph::ModelFiles *files, bool ok)
+{
+	ScopedPtr<SceneGraph::ModelFiles> owned(files);
+
+	RequestMap::iterator pending = m_requests.find(files->GetName());
+	if (pending == m_requests.end()) return; //FindModel got there first
+	RefCountedPtr<Request> req = pending->second;
+	m_requests.erase(pending);
+
+	SceneGraph::Model *m = 0;
+	if (ok) {
+		try {
+			m = Load(*files);
+			Add(files->GetName(), m);
+		} catch (SceneGraph::LoadingError &) {
+			m = 0;
+		}
+	}
+	if (!m) fprintf(stderr, "Could not load requested model %s\n", files->GetName().c_str());
+	req->Resolve(m);
+}
+
+void ModelCache::Pin(SceneGraph::Model *m)
+{
+	for (ModelMap::iterator it = m_models.begin(); it != m_models.end(); ++it) {
+		if (it->second.model == m) {
+			it->second.pinned = true;
+			return;
+		}
+	}
+}
+
+void ModelCache::Preload()
+{
+	size_t expected = m_stats.bytes;
+	for (std::vector<std::string>::const_iterator it = m_preloadList.begin(); it != m_preloadList.end(); ++it) {
+		if (m_models.count(*it) || m_requests.count(*it)) continue;
+
+		// models never loaded are given the benefit of the doubt
+		std::map<std::string, size_t>::const_iterator known = m_evictedBytes.find(*it);
+		const size_t bytes = (known != m_evictedBytes.end()) ? known->second : 0;
+		if (m_budget && expected + bytes > m_budget) continue;
+		expected += bytes;
+
+		RequestModel(*it);
+	}
+}
+
+void ModelCache::Update()
+{
+	if (m_budget && m_stats.bytes > m_budget)
+		Evict();
+}
+
+void ModelCache::Evict()
+{
+	const Uint32 now = SDL_GetTicks();
+
+	std::vector<std::pair<Uint32, std::string> > candidates;
+	for (ModelMap::const_iterator it = m_models.begin(); it != m_models.end(); ++it) {
+		const Entry &e = it->second;
+		if (e.pinned || e.model->GetNumInstances() > 0 || now - e.lastUsed < KEEP_TICKS)
+			continue;
+		candidates.push_back(std::make_pair(e.lastUsed, it->first));
+	}
+	std::sort(candidates.begin(), candidates.end());
+
+	for (std::vector<std::pair<Uint32, std::string> >::const_iterator it = candidates.begin();
+		it != candidates.end() && m_stats.bytes > m_budget; ++it) {
+		ModelMap::iterator entry = m_models.find(it->second);
+		m_stats.bytes -= entry->second.bytes;
+		MemoryStats::Remove(MemoryStats::MODELS, entry->second.meshBytes);
+		m_stats.models--;
+		m_stats.evictions++;
+		m_evictedBytes[entry->first] = entry->second.bytes;
+		delete entry->second.model;
+		m_models.erase(entry);
+	}
 }
 
 void ModelCache::Flush()
 {
 	for(ModelMap::iterator it = m_models.begin(); it != m_models.end(); ++it) {
-		delete it->second;
+		MemoryStats::Remove(MemoryStats::MODELS, it->second.meshBytes);
+		delete it->second.model;
 	}
 	m_models.clear();
+	m_stats.models = 0;
+	m_stats.bytes = 0;
+
+	// whatever is on its way is dropped when it arrives
+	for (RequestMap::iterator it = m_requests.begin(); it != m_requests.end(); ++it)
+		it->second->Resolve(0);
+	m_requests.clear();
 }
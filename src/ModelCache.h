@@ -4,29 +4,119 @@
 #ifndef _MODELCACHE_H
 #define _MODELCACHE_H
 /*
- * This class is a quick thoughtless hack
- * Also it only deals in New Models
+ * Keeps the loaded models (new models only), by name.
+ *
+ * With a memory budget, models nobody uses are dropped, least recently used
+ * first, to stay within it. A model is in use while instances of it exist,
+ * for a few seconds after it was last found, or for good once pinned (for
+ * users that keep the model itself, not an instance). Memory counts the
+ * vertices and indices of the meshes, their buffers on the GPU and the
+ * textures of the materials, estimated.
+ *
+ * Models can also be requested ahead of use. Finding and reading the files
+ * (and importing meshes, the slow part) then happens on the job queue, and
+ * the model is made on the main thread when the job finishes. FindModel on
+ * a model that is still on its way loads it right away as before. The
+ * preload list names models to request again whenever Preload is called,
+ * if they aren't loaded and seem to fit in the budget.
  */
 #include "libs.h"
+#include "RefCounted.h"
 #include <stdexcept>
 
-namespace Graphics { class Renderer; }
-namespace SceneGraph { class Model; }
+namespace Graphics { class Renderer; class TextureLoader; }
+namespace SceneGraph { class Model; class ModelFiles; }
+class JobQueue;
 
 class ModelCache {
 public:
 	struct ModelNotFoundException : public std::runtime_error {
 		ModelNotFoundException() : std::runtime_error("Could not find model") { }
 	};
-	ModelCache(Graphics::Renderer*);
+
+	// a model that may still be loading
+	class Request : public RefCounted {
+	public:
+		const std::string &GetName() const { return m_name; }
+		bool IsReady() const { return m_ready; }
+		// the model once ready, or 0 if it couldn't be loaded. like any
+		// model from the cache, make an instance or pin it to keep it
+		SceneGraph::Model *GetModel() const { return m_model; }
+
+	private:
+		friend class ModelCache;
+		Request(const std::string &name) : m_name(name), m_ready(false), m_model(0) { }
+		void Resolve(SceneGraph::Model *m) { m_ready = true; m_model = m; }
+
+		std::string m_name;
+		bool m_ready;
+		SceneGraph::Model *m_model;
+	};
+
+	// with a texture loader, model textures load in the background. with a
+	// job queue, requested models do too
+	ModelCache(Graphics::Renderer*, Graphics::TextureLoader *textureLoader = 0, JobQueue *jobs = 0);
 	~ModelCache();
 	SceneGraph::Model *FindModel(const std::string&);
+	// start loading a model if it isn't loaded or on its way already
+	RefCountedPtr<Request> RequestModel(const std::string&);
+	// never drop the model
+	void Pin(SceneGraph::Model *m);
 	void Flush();
 
+	// bytes to keep models within, 0 for no limit
+	void SetBudget(size_t bytes) { m_budget = bytes; }
+	size_t GetBudget() const { return m_budget; }
+
+	void SetPreloadList(const std::vector<std::string> &names) { m_preloadList = names; }
+	void Preload();
+
+	// once a frame. drops models if over budget
+	void Update();
+
+	struct Stats {
+		Stats() : models(0), bytes(0), evictions(0), loads(0) {}
+		unsigned int models;
+		size_t bytes;
+		unsigned int evictions; //since the last ResetCounts
+		unsigned int loads; //ever
+	};
+	const Stats &GetStats() const { return m_stats; }
+	void ResetCounts() { m_stats.evictions = 0; }
+
+	// estimated memory of a model, shared parts once
+	static size_t GetMemoryUsage(SceneGraph::Model *m);
+	// the same, but only its geometry, leaving out the textures
+	static size_t GetMeshMemoryUsage(SceneGraph::Model *m);
+
 private:
-	typedef std::map<std::string, SceneGraph::Model*> ModelMap;
+	class ReadJob;
+	friend class ReadJob;
+	void OnFilesRead(SceneGraph::ModelFiles *files, bool ok);
+	SceneGraph::Model *Load(const SceneGraph::ModelFiles &files);
+	void Add(const std::string &name, SceneGraph::Model *m);
+	void Evict();
+
+	struct Entry {
+		Entry() : model(0), bytes(0), meshBytes(0), lastUsed(0), pinned(false) {}
+		SceneGraph::Model *model;
+		size_t bytes;
+		size_t meshBytes; //charged to MemoryStats, textures are there already
+		Uint32 lastUsed; //ticks
+		bool pinned;
+	};
+	typedef std::map<std::string, Entry> ModelMap;
+	typedef std::map<std::string, RefCountedPtr<Request> > RequestMap;
 	ModelMap m_models;
+	RequestMap m_requests; //still loading
+	std::map<std::string, size_t> m_evictedBytes; //to guess whether preloads fit
+	std::vector<std::string> m_preloadList;
 	Graphics::Renderer *m_renderer;
+	Graphics::TextureLoader *m_textureLoader;
+	JobQueue *m_jobs;
+	Uint32 m_jobGroup;
+	size_t m_budget;
+	Stats m_stats;
 };
 
 #endif
@@ -9,10 +9,12 @@
 #include "graphics/Drawables.h"
 #include "scenegraph/DumpVisitor.h"
 #include "scenegraph/FindNodeVisitor.h"
+#include "scenegraph/LOD.h"
 #include "OS.h"
 #include "Pi.h"
 #include "StringF.h"
 #include "ModManager.h"
+#include <map>
 #include <sstream>
 
 //default options
@@ -75,12 +77,16 @@ namespace {
 	{
 		return base_distance * powf(2.0f, zoom);
 	}
+
+	//vertical, in degrees
+	const float CAMERA_FOV = 85.f;
 }
 
 ModelViewer::ModelViewer(Graphics::Renderer *r, LuaManager *lm)
 : m_done(false)
 , m_screenshotQueued(false)
 , m_frameTime(0.f)
+, m_loadTime(0.0)
 , m_renderer(r)
 , m_decalTexture(0)
 , m_rotX(0), m_rotY(0), m_zoom(0)
@@ -112,14 +118,8 @@ ModelViewer::~ModelViewer()
 	ClearModel();
 }
 
-void ModelViewer::Run(const std::string &modelName)
+Graphics::Renderer *ModelViewer::InitComponents(GameConfig *config, bool vsync)
 {
-	ScopedPtr<GameConfig> config(new GameConfig);
-
-	Graphics::Renderer *renderer;
-	ModelViewer *viewer;
-
-	//init components
 	FileSystem::Init();
 	FileSystem::userFiles.MakeDirectory(""); // ensure the config directory exists
 	if (SDL_Init(SDL_INIT_VIDEO) < 0)
@@ -138,28 +138,307 @@ void ModelViewer::Run(const std::string &modelName)
 	videoSettings.fullscreen = (config->Int("StartFullscreen") != 0);
 	videoSettings.shaders = (config->Int("DisableShaders") == 0);
 	videoSettings.requestedSamples = config->Int("AntiAliasingMode");
-	videoSettings.vsync = (config->Int("VSync") != 0);
+	videoSettings.vsync = vsync;
 	videoSettings.useTextureCompression = (config->Int("UseTextureCompression") != 0);
-	renderer = Graphics::Init(videoSettings);
+	videoSettings.textureCache = (config->Int("TextureCache") != 0);
+	Graphics::Renderer *renderer = Graphics::Init(videoSettings);
 
 	OS::LoadWindowIcon();
 	SDL_WM_SetCaption("Model viewer","Model viewer");
 
 	NavLights::Init(renderer);
 
+	return renderer;
+}
+
+void ModelViewer::UninitComponents(Graphics::Renderer *renderer)
+{
+	Lua::Uninit();
+	delete renderer;
+	NavLights::Uninit();
+	Graphics::Uninit();
+	FileSystem::Uninit();
+	SDL_Quit();
+}
+
+void ModelViewer::Run(const std::string &modelName)
+{
+	ScopedPtr<GameConfig> config(new GameConfig);
+	Graphics::Renderer *renderer = InitComponents(config.Get(), config->Int("VSync") != 0);
+
 	//run main loop until quit
-	viewer = new ModelViewer(renderer, Lua::manager);
+	ModelViewer *viewer = new ModelViewer(renderer, Lua::manager);
 	viewer->SetModel(modelName);
 	viewer->MainLoop();
 
 	//uninit components
 	delete viewer;
-	Lua::Uninit();
+	UninitComponents(renderer);
+}
+
+int ModelViewer::Compile(const std::string &modelName)
+{
+	ScopedPtr<GameConfig> config(new GameConfig);
+
+	//a window and GL context are needed to make right materials,
+	//even if nothing is drawn
+	FileSystem::Init();
+	if (SDL_Init(SDL_INIT_VIDEO) < 0)
+		OS::Error("SDL initialization failed: %s\n", SDL_GetError());
+
+	Graphics::Settings videoSettings = {};
+	videoSettings.width = 640;
+	videoSettings.height = 480;
+	videoSettings.shaders = (config->Int("DisableShaders") == 0);
+	Graphics::Renderer *renderer = Graphics::Init(videoSettings);
+	SDL_WM_SetCaption("Model compiler","Model compiler");
+
+	NavLights::Init(renderer);
+
+	std::vector<std::string> names;
+	if (!modelName.empty())
+		names.push_back(modelName);
+	else {
+		for (FileSystem::FileEnumerator files(FileSystem::gameDataFiles, "models", FileSystem::FileEnumerator::Recurse); !files.Finished(); files.Next()) {
+			const std::string &name = files.Current().GetName();
+			if (files.Current().IsFile() && ends_with(name, ".model"))
+				names.push_back(name.substr(0, name.size()-6));
+		}
+	}
+
+	int failed = 0;
+	{
+		SceneGraph::Loader loader(renderer);
+		for (std::vector<std::string>::const_iterator it = names.begin(); it != names.end(); ++it) {
+			try {
+				const std::string path = loader.CompileModel(*it);
+				printf("%s -> %s\n", it->c_str(), path.c_str());
+			} catch (SceneGraph::LoadingError &err) {
+				fprintf(stderr, "%s: %s\n", it->c_str(), err.what());
+				failed++;
+			}
+		}
+	}
+
 	delete renderer;
 	NavLights::Uninit();
 	Graphics::Uninit();
 	FileSystem::Uninit();
 	SDL_Quit();
+
+	return failed;
+}
+
+namespace {
+	//models are classed by the directory under models/ they're in, and
+	//each class can have a budget, 0 for none
+	struct ModelClass {
+		const char *name;
+		const char *dir;
+		const char *trianglesKey;
+		const char *drawCallsKey;
+	};
+	const ModelClass MODEL_CLASSES[] = {
+		{ "ship",     "models/ships/",     "ModelBenchShipTriangles",     "ModelBenchShipDrawCalls"     },
+		{ "station",  "models/stations/",  "ModelBenchStationTriangles",  "ModelBenchStationDrawCalls"  },
+		{ "building", "models/buildings/", "ModelBenchBuildingTriangles", "ModelBenchBuildingDrawCalls" }
+	};
+
+	//frames drawn at each distance before and while measuring. the
+	//camera goes once round the model while measuring
+	const int BENCH_WARMUP_FRAMES = 5;
+	const int BENCH_FRAMES = 60;
+
+	//the first LOD node, whose levels set the distances to look from
+	class FindLODVisitor : public SceneGraph::NodeVisitor {
+	public:
+		FindLODVisitor() : lod(0) {}
+		virtual void ApplyLOD(SceneGraph::LOD &l) {
+			if (!lod) lod = &l;
+		}
+		SceneGraph::LOD *lod;
+	};
+
+	//camera distances that show each level of the model's LOD node, or
+	//just the usual starting distance if it has none
+	std::vector<float> lod_distances(SceneGraph::Model *model)
+	{
+		std::vector<float> distances;
+		FindLODVisitor v;
+		model->GetRoot()->Accept(v);
+		if (!v.lod || v.lod->GetNumChildren() < 2) {
+			distances.push_back(model->GetDrawClipRadius() * 1.5f);
+			return distances;
+		}
+
+		//as LOD::Render works out the radius on screen
+		const float scale = Graphics::GetScreenHeight() * model->GetDrawClipRadius() /
+			(2.f * tan(DEG2RAD(CAMERA_FOV) / 2.f));
+		for (unsigned int i = 0; i < v.lod->GetNumChildren(); i++) {
+			//the middle of the range of radii the level is drawn at
+			const float hi = float(v.lod->GetPixelSize(i));
+			const float lo = i ? float(v.lod->GetPixelSize(i-1)) : 0.f;
+			distances.push_back(scale / std::max((lo + hi) * 0.5f, 1.f));
+		}
+		return distances;
+	}
+
+	//GL_TIME_ELAPSED around each frame's model drawing, read back once
+	//every frame at one distance is done
+	class GpuTimer {
+	public:
+		GpuTimer() : m_arb(glewIsSupported("GL_ARB_timer_query")) {
+			m_enabled = m_arb || glewIsSupported("GL_EXT_timer_query");
+			if (m_enabled) glGenQueries(BENCH_FRAMES, m_queries);
+		}
+		~GpuTimer() {
+			if (m_enabled) glDeleteQueries(BENCH_FRAMES, m_queries);
+		}
+		bool IsEnabled() const { return m_enabled; }
+		void Begin(int frame) { if (m_enabled) glBeginQuery(GL_TIME_ELAPSED_EXT, m_queries[frame]); }
+		void End() { if (m_enabled) glEndQuery(GL_TIME_ELAPSED_EXT); }
+		//ms per frame. waits for the GPU
+		double GetAverage() const {
+			if (!m_enabled) return 0.0;
+			double total = 0.0;
+			for (int i = 0; i < BENCH_FRAMES; i++) {
+				if (m_arb) {
+					GLuint64 ns = 0;
+					glGetQueryObjectui64v(m_queries[i], GL_QUERY_RESULT, &ns);
+					total += double(ns) * 1e-6;
+				} else {
+					GLuint64EXT ns = 0;
+					glGetQueryObjectui64vEXT(m_queries[i], GL_QUERY_RESULT, &ns);
+					total += double(ns) * 1e-6;
+				}
+			}
+			return total / BENCH_FRAMES;
+		}
+	private:
+		bool m_enabled;
+		bool m_arb;
+		GLuint m_queries[BENCH_FRAMES];
+	};
+}
+
+int ModelViewer::Benchmark(const std::string &reportFile, const std::vector<std::string> &modelNames)
+{
+	ScopedPtr<GameConfig> config(new GameConfig);
+	//vsync would hide the frame times
+	Graphics::Renderer *renderer = InitComponents(config.Get(), false);
+
+	//every model's class, from where its file is
+	std::map<std::string, int> classes;
+	std::vector<std::string> names;
+	for (FileSystem::FileEnumerator files(FileSystem::gameDataFiles, "models", FileSystem::FileEnumerator::Recurse); !files.Finished(); files.Next()) {
+		const FileSystem::FileInfo &info = files.Current();
+		if (!info.IsFile() || !ends_with(info.GetName(), ".model")) continue;
+		const std::string name = info.GetName().substr(0, info.GetName().size()-6);
+		names.push_back(name);
+		classes[name] = -1;
+		for (int i = 0; i < int(COUNTOF(MODEL_CLASSES)); i++)
+			if (starts_with(info.GetPath(), MODEL_CLASSES[i].dir)) classes[name] = i;
+	}
+	if (!modelNames.empty())
+		names = modelNames;
+
+	int failed = 0;
+	FILE *report = FileSystem::userFiles.OpenWriteStream(reportFile);
+	if (!report) {
+		fprintf(stderr, "could not open %s\n", FileSystem::JoinPath(FileSystem::GetUserDir(), reportFile).c_str());
+		failed = int(names.size());
+	} else {
+		fprintf(report, "model,class,lod,distance,load_ms,draw_calls,triangles,cpu_ms,gpu_ms,over_budget\n");
+
+		ModelViewer *viewer = new ModelViewer(renderer, Lua::manager);
+		for (std::vector<std::string>::const_iterator it = names.begin(); it != names.end() && !viewer->m_done; ++it) {
+			std::map<std::string, int>::const_iterator c = classes.find(*it);
+			const int classIndex = (c != classes.end()) ? c->second : -1;
+			const ModelClass *mc = classIndex >= 0 ? &MODEL_CLASSES[classIndex] : 0;
+			if (!viewer->BenchmarkModel(report, *it, mc ? mc->name : "other",
+					mc ? config->Int(mc->trianglesKey) : 0, mc ? config->Int(mc->drawCallsKey) : 0))
+				failed++;
+		}
+		delete viewer;
+
+		fclose(report);
+		printf("report written to %s\n", FileSystem::JoinPath(FileSystem::GetUserDir(), reportFile).c_str());
+	}
+
+	UninitComponents(renderer);
+	return failed;
+}
+
+//a row for each distance. false if the model wouldn't load or went over
+//budget at any distance
+bool ModelViewer::BenchmarkModel(FILE *report, const std::string &name, const std::string &modelClass, int maxTriangles, int maxDrawCalls)
+{
+	SetModel(name);
+	if (!m_model) {
+		fprintf(report, "%s,%s,,,,,,,,load failed\n", name.c_str(), modelClass.c_str());
+		return false;
+	}
+
+	bool ok = true;
+	const std::vector<float> distances = lod_distances(m_model);
+	for (unsigned int lod = 0; lod < distances.size() && !m_done; lod++) {
+		m_baseDistance = distances[lod];
+		m_zoom = 0.f;
+
+		GpuTimer gpuTimer;
+		Uint64 drawCalls = 0, triangles = 0, cpuTicks = 0;
+		for (int frame = -BENCH_WARMUP_FRAMES; frame < BENCH_FRAMES && !m_done; frame++) {
+			//once round, tilting up and down
+			const float t = float(std::max(frame, 0)) / float(BENCH_FRAMES);
+			m_rotY = 360.f * t;
+			m_rotX = 30.f * sin(2.f * float(M_PI) * t);
+
+			SDL_Event event;
+			while (SDL_PollEvent(&event))
+				if (event.type == SDL_QUIT || (event.type == SDL_KEYDOWN && event.key.keysym.sym == SDLK_ESCAPE))
+					m_done = true;
+
+			m_renderer->ClearScreen();
+			m_navLights->Update(1.f / 60.f);
+
+			const Uint64 start = OS::HFTimer();
+			if (frame >= 0) gpuTimer.Begin(frame);
+			DrawModel();
+			if (frame >= 0) gpuTimer.End();
+			const Uint64 end = OS::HFTimer();
+
+			m_renderer->SwapBuffers();
+
+			if (frame >= 0) {
+				const Graphics::Stats &stats = m_renderer->GetStats();
+				drawCalls += stats.Get(Graphics::Stats::STAT_DRAW_CALLS);
+				triangles += stats.Get(Graphics::Stats::STAT_TRIANGLES);
+				cpuTicks += end - start;
+			}
+		}
+		if (m_done) break;
+
+		const Uint32 avgDrawCalls = Uint32(drawCalls / BENCH_FRAMES);
+		const Uint32 avgTriangles = Uint32(triangles / BENCH_FRAMES);
+		const double cpuMs = double(cpuTicks) * 1000.0 / double(OS::HFTimerFreq()) / BENCH_FRAMES;
+
+		std::string over;
+		if (maxTriangles > 0 && avgTriangles > Uint32(maxTriangles)) over += "triangles ";
+		if (maxDrawCalls > 0 && avgDrawCalls > Uint32(maxDrawCalls)) over += "draw_calls ";
+		if (!over.empty()) {
+			over.erase(over.size()-1);
+			ok = false;
+			printf("%s: over budget at LOD %u (%s)\n", name.c_str(), lod, over.c_str());
+		}
+
+		std::string gpuMs;
+		if (gpuTimer.IsEnabled())
+			gpuMs = stringf("%0{f.3}", gpuTimer.GetAverage());
+
+		fprintf(report, "%s,%s,%u,%.1f,%.1f,%u,%u,%.3f,%s,%s\n", name.c_str(), modelClass.c_str(), lod, distances[lod],
+			m_loadTime, avgDrawCalls, avgTriangles, cpuMs, gpuMs.c_str(), over.c_str());
+	}
+	return ok;
 }
 
 bool ModelViewer::OnPickModel(UI::List *list)
@@ -533,7 +812,7 @@ void ModelViewer::DrawModel()
 	assert(m_model);
 	m_renderer->SetBlendMode(Graphics::BLEND_SOLID);
 
-	m_renderer->SetPerspectiveProjection(85, Graphics::GetScreenWidth()/float(Graphics::GetScreenHeight()), 0.1f, 10000.f);
+	m_renderer->SetPerspectiveProjection(CAMERA_FOV, Graphics::GetScreenWidth()/float(Graphics::GetScreenHeight()), 0.1f, 10000.f);
 	m_renderer->SetTransform(matrix4x4f::Identity());
 	UpdateLights();
 
@@ -826,7 +1105,9 @@ void ModelViewer::SetModel(const std::string &filename, bool resetCamera /* true
 	try {
 		m_modelName = filename;
 		SceneGraph::Loader loader(m_renderer, true);
+		const Uint64 loadStart = OS::HFTimer();
 		m_model = loader.LoadModel(filename);
+		m_loadTime = double(OS::HFTimer() - loadStart) * 1000.0 / double(OS::HFTimerFreq());
 
 		//set decal textures, max 4 supported.
 		//Identical texture at the moment
@@ -14,14 +14,27 @@
 #include "scenegraph/SceneGraph.h"
 #include "ui/Context.h"
 
+class GameConfig;
+
 class ModelViewer {
 public:
 	ModelViewer(Graphics::Renderer *r, LuaManager *l);
 	~ModelViewer();
 
 	static void Run(const std::string &modelName);
+	//write compiled (.sgm) versions of a model, or all of them when
+	//no name is given. returns the number that failed
+	static int Compile(const std::string &modelName);
+	//load each model (or all of them, when none are given) and orbit it
+	//at the distance of each LOD level, writing what it cost to a CSV in
+	//the user dir. returns the number that failed to load or went over
+	//their class's budget
+	static int Benchmark(const std::string &reportFile, const std::vector<std::string> &modelNames);
 
 private:
+	static Graphics::Renderer *InitComponents(GameConfig *config, bool vsync);
+	static void UninitComponents(Graphics::Renderer *renderer);
+
 	bool OnPickModel(UI::List*);
 	bool OnQuit();
 	bool OnReloadModel(UI::Widget*);
@@ -29,6 +42,7 @@ private:
 	bool OnToggleGrid(UI::Widget*);
 	bool OnToggleGuns(UI::CheckBox*);
 	void AddLog(const std::string &line);
+	bool BenchmarkModel(FILE *report, const std::string &name, const std::string &modelClass, int maxTriangles, int maxDrawCalls);
 	void ChangeCameraPreset(SDLKey, SDLMod);
 	void ClearLog();
 	void ClearModel();
@@ -76,6 +90,7 @@ private:
 	bool m_done;
 	bool m_screenshotQueued;
 	double m_frameTime;
+	double m_loadTime; //ms, of the last SetModel
 	Graphics::Renderer *m_renderer;
 	Graphics::Texture *m_decalTexture;
 	float m_rotX, m_rotY, m_zoom;
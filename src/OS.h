@@ -32,6 +32,10 @@ namespace OS {
 
 	// http://stackoverflow.com/questions/150355/programmatically-find-the-number-of-cores-on-a-machine
 	int GetNumCores();
+
+	// the most memory the process has had at once, in bytes. 0 if the
+	// platform can't say
+	size_t GetPeakMemoryUsage();
 }
 
 #endif
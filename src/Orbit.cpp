@@ -9,6 +9,11 @@
 	#include "win32/WinMath.h"
 #endif
 
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define ORBIT_USE_SSE2
+#include <emmintrin.h>
+#endif
+
 static double calc_orbital_period(double semiMajorAxis, double centralMass)
 {
 	return 2.0*M_PI*sqrt((semiMajorAxis*semiMajorAxis*semiMajorAxis)/(G*centralMass));
@@ -53,6 +58,144 @@ static double calc_velocity_area_per_sec_gravpoint(double semiMajorAxis, double
 	return M_PI * a2 * sqrt((eccentricity < 1.0) ? (1 - e2) : (e2 - 1.0)) / calc_orbital_period_gravpoint(semiMajorAxis, totalMass, bodyMass);
 }
 
+// Kepler's equation M = E - e*sin(E) is solved for the eccentric anomaly E
+// by Newton's method, starting from Danby's guess. sin(E) and cos(E) are only
+// evaluated once, for the mean anomaly; each step then turns them along by
+// the step with the Taylor series, which is nothing but multiplies and adds
+// and so does two orbits at a time just as well as one. steps are clamped to
+// a radian, where the series is good to well under an ulp, and an orbit stops
+// as soon as its step drops below KEPLER_TOLERANCE, which takes three or four
+// steps for most orbits and still converges for very eccentric ones.
+//
+// the SSE2 version must do exactly the same operations in the same order as
+// the scalar one so that batched positions match OrbitalPosAtTime bit for bit
+static const double KEPLER_TOLERANCE = 1e-14;
+static const int KEPLER_MAX_ITERATIONS = 16;
+static const double KEPLER_MAX_STEP = 1.0;
+
+// Taylor coefficients of sin(d)/d and cos(d) in d^2, from d^2 up
+static const int KEPLER_SIN_TERMS = 8;
+static const double KEPLER_SIN_COEFFS[KEPLER_SIN_TERMS] = {
+	-1.0/6.0, 1.0/120.0, -1.0/5040.0, 1.0/362880.0, -1.0/39916800.0,
+	1.0/6227020800.0, -1.0/1307674368000.0, 1.0/355687428096000.0
+};
+static const int KEPLER_COS_TERMS = 9;
+static const double KEPLER_COS_COEFFS[KEPLER_COS_TERMS] = {
+	-1.0/2.0, 1.0/24.0, -1.0/720.0, 1.0/40320.0, -1.0/3628800.0,
+	1.0/479001600.0, -1.0/87178291200.0, 1.0/20922789888000.0, -1.0/6402373705728000.0
+};
+
+// M reduced to -pi..pi so the tolerance means the same thing on every orbit
+static inline double reduce_mean_anomaly(const double M)
+{
+	return M - 2.0*M_PI*floor(M/(2.0*M_PI) + 0.5);
+}
+
+static inline void rotate_sincos(const double d, double &s, double &c)
+{
+	const double d2 = d*d;
+	double ps = KEPLER_SIN_COEFFS[KEPLER_SIN_TERMS-1];
+	for (int i = KEPLER_SIN_TERMS-2; i >= 0; i--)
+		ps = KEPLER_SIN_COEFFS[i] + d2*ps;
+	double pc = KEPLER_COS_COEFFS[KEPLER_COS_TERMS-1];
+	for (int i = KEPLER_COS_TERMS-2; i >= 0; i--)
+		pc = KEPLER_COS_COEFFS[i] + d2*pc;
+	const double sd = d*(1.0 + d2*ps);
+	const double cd = 1.0 + d2*pc;
+
+	const double s1 = s*cd + c*sd;
+	c = c*cd - s*sd;
+	s = s1;
+}
+
+// M is mean anomaly, already reduced. sinE and cosE start as sin(M) and cos(M)
+// and come back as sin and cos of the eccentric anomaly
+static void solve_kepler_elliptic(const double M, const double e, double &sinE, double &cosE)
+{
+	const double d0 = 0.85*e*(sinE < 0.0 ? -1.0 : 1.0);
+	double E = M + d0;
+	rotate_sincos(d0, sinE, cosE);
+
+	for (int iter = 0; iter < KEPLER_MAX_ITERATIONS; iter++) {
+		const double f = E - e*sinE - M;
+		const double fp = 1.0 - e*cosE;
+		const double d = std::min(std::max(-f / fp, -KEPLER_MAX_STEP), KEPLER_MAX_STEP);
+		E = E + d;
+		rotate_sincos(d, sinE, cosE);
+		if (!(fabs(d) > KEPLER_TOLERANCE)) break;
+	}
+}
+
+#ifdef ORBIT_USE_SSE2
+
+static inline void rotate_sincos2(const __m128d d, __m128d &s, __m128d &c)
+{
+	const __m128d one = _mm_set1_pd(1.0);
+	const __m128d d2 = _mm_mul_pd(d, d);
+	__m128d ps = _mm_set1_pd(KEPLER_SIN_COEFFS[KEPLER_SIN_TERMS-1]);
+	for (int i = KEPLER_SIN_TERMS-2; i >= 0; i--)
+		ps = _mm_add_pd(_mm_set1_pd(KEPLER_SIN_COEFFS[i]), _mm_mul_pd(d2, ps));
+	__m128d pc = _mm_set1_pd(KEPLER_COS_COEFFS[KEPLER_COS_TERMS-1]);
+	for (int i = KEPLER_COS_TERMS-2; i >= 0; i--)
+		pc = _mm_add_pd(_mm_set1_pd(KEPLER_COS_COEFFS[i]), _mm_mul_pd(d2, pc));
+	const __m128d sd = _mm_mul_pd(d, _mm_add_pd(one, _mm_mul_pd(d2, ps)));
+	const __m128d cd = _mm_add_pd(one, _mm_mul_pd(d2, pc));
+
+	const __m128d s1 = _mm_add_pd(_mm_mul_pd(s, cd), _mm_mul_pd(c, sd));
+	c = _mm_sub_pd(_mm_mul_pd(c, cd), _mm_mul_pd(s, sd));
+	s = s1;
+}
+
+// two orbits' worth of solve_kepler_elliptic. an orbit that has converged
+// steps by zero while it waits for the other, which leaves it untouched
+static void solve_kepler_elliptic2(const double *M, const double *e, double *sinE, double *cosE)
+{
+	const __m128d zero = _mm_setzero_pd();
+	const __m128d sign = _mm_set1_pd(-0.0);
+	const __m128d maxStep = _mm_set1_pd(KEPLER_MAX_STEP);
+	const __m128d minStep = _mm_set1_pd(-KEPLER_MAX_STEP);
+	const __m128d tolerance = _mm_set1_pd(KEPLER_TOLERANCE);
+
+	const __m128d m = _mm_loadu_pd(M);
+	const __m128d ecc = _mm_loadu_pd(e);
+	__m128d s = _mm_loadu_pd(sinE);
+	__m128d c = _mm_loadu_pd(cosE);
+
+	const __m128d negative = _mm_cmplt_pd(s, zero);
+	const __m128d d0 = _mm_mul_pd(_mm_mul_pd(_mm_set1_pd(0.85), ecc),
+		_mm_or_pd(_mm_and_pd(negative, _mm_set1_pd(-1.0)), _mm_andnot_pd(negative, _mm_set1_pd(1.0))));
+	__m128d E = _mm_add_pd(m, d0);
+	rotate_sincos2(d0, s, c);
+
+	__m128d active = _mm_cmpeq_pd(zero, zero);
+	for (int iter = 0; iter < KEPLER_MAX_ITERATIONS; iter++) {
+		const __m128d f = _mm_sub_pd(_mm_sub_pd(E, _mm_mul_pd(ecc, s)), m);
+		const __m128d fp = _mm_sub_pd(_mm_set1_pd(1.0), _mm_mul_pd(ecc, c));
+		__m128d d = _mm_div_pd(_mm_xor_pd(f, sign), fp);
+		d = _mm_and_pd(active, _mm_min_pd(_mm_max_pd(d, minStep), maxStep));
+		E = _mm_add_pd(E, d);
+		rotate_sincos2(d, s, c);
+		active = _mm_and_pd(active, _mm_cmpgt_pd(_mm_andnot_pd(sign, d), tolerance));
+		if (!_mm_movemask_pd(active)) break;
+	}
+
+	_mm_storeu_pd(sinE, s);
+	_mm_storeu_pd(cosE, c);
+}
+
+#endif
+
+// position in the orbital plane from the eccentric anomaly
+static inline vector3d elliptic_position(const double e, const double a, const double sinE, const double cosE)
+{
+	// true anomaly (angle of orbit position)
+	const double cos_v = (cosE - e) / (1.0 - e*cosE);
+	const double sin_v = (sqrt(1.0-e*e)*sinE) / (1.0 - e*cosE);
+	// heliocentric distance
+	const double r = a * (1.0 - e*cosE);
+	return vector3d(-cos_v*r, sin_v*r, 0);
+}
+
 static void calc_position_from_mean_anomaly(const double M, const double e, const double a, double &cos_v, double &sin_v, double *r) {
 	// M is mean anomaly
 	// e is eccentricity
@@ -64,19 +207,17 @@ static void calc_position_from_mean_anomaly(const double M, const double e, cons
 
 	if (e < 1.0) { // elliptic orbit
 		// eccentric anomaly
-		// NR method to solve for E: M = E-sin(E)
-		double E = M;
-		for (int iter=5; iter > 0; --iter) {
-			E = E - (E-e*(sin(E))-M) / (1.0 - e*cos(E));
-		}
+		const double Mr = reduce_mean_anomaly(M);
+		double sinE = sin(Mr), cosE = cos(Mr);
+		solve_kepler_elliptic(Mr, e, sinE, cosE);
 
 		// true anomaly (angle of orbit position)
-		cos_v = (cos(E) - e) / (1.0 - e*cos(E));
-		sin_v = (sqrt(1.0-e*e)*sin(E))/ (1.0 - e*cos(E));
+		cos_v = (cosE - e) / (1.0 - e*cosE);
+		sin_v = (sqrt(1.0-e*e)*sinE)/ (1.0 - e*cosE);
 
 		// heliocentric distance
 		if (r) {
-			*r = a * (1.0 - e*cos(E));
+			*r = a * (1.0 - e*cosE);
 		}
 
 	} else { // parabolic or hyperbolic orbit
@@ -133,6 +274,13 @@ double Orbit::MeanAnomalyAtTime(double time) const {
 
 vector3d Orbit::OrbitalPosAtTime(double t) const
 {
+	if (m_eccentricity < 1.0) {
+		const double M = reduce_mean_anomaly(MeanAnomalyAtTime(t));
+		double sinE = sin(M), cosE = cos(M);
+		solve_kepler_elliptic(M, m_eccentricity, sinE, cosE);
+		return m_orient * elliptic_position(m_eccentricity, m_semiMajorAxis, sinE, cosE);
+	}
+
 	double cos_v, sin_v, r;
 	calc_position_from_mean_anomaly(MeanAnomalyAtTime(t), m_eccentricity, m_semiMajorAxis, cos_v, sin_v, &r);
 	return m_orient * vector3d(-cos_v*r, sin_v*r, 0);
@@ -293,3 +441,60 @@ Orbit Orbit::FromBodyState(const vector3d &pos, const vector3d &vel, double cent
 
 	return ret;
 }
+
+void OrbitBatch::Clear()
+{
+	m_orbits.clear();
+	m_times.clear();
+	m_positions.clear();
+}
+
+size_t OrbitBatch::Add(const Orbit &orbit, double t)
+{
+	m_orbits.push_back(&orbit);
+	m_times.push_back(t);
+	return m_orbits.size() - 1;
+}
+
+void OrbitBatch::Solve()
+{
+	const size_t num = m_orbits.size();
+	m_positions.resize(num);
+
+	m_elliptic.clear();
+	m_meanAnomaly.clear();
+	m_eccentricity.clear();
+	m_sinE.clear();
+	m_cosE.clear();
+
+	for (size_t i = 0; i < num; i++) {
+		const Orbit &orbit = *m_orbits[i];
+		if (orbit.m_eccentricity < 1.0) {
+			const double M = reduce_mean_anomaly(orbit.MeanAnomalyAtTime(m_times[i]));
+			m_elliptic.push_back(i);
+			m_meanAnomaly.push_back(M);
+			m_eccentricity.push_back(orbit.m_eccentricity);
+			m_sinE.push_back(sin(M));
+			m_cosE.push_back(cos(M));
+		} else {
+			// hyperbolic orbits are few and far between (the player's,
+			// mostly), so they're not worth vectorising
+			m_positions[i] = orbit.OrbitalPosAtTime(m_times[i]);
+		}
+	}
+
+	const size_t numElliptic = m_elliptic.size();
+	size_t j = 0;
+#ifdef ORBIT_USE_SSE2
+	for (; j+1 < numElliptic; j += 2)
+		solve_kepler_elliptic2(&m_meanAnomaly[j], &m_eccentricity[j], &m_sinE[j], &m_cosE[j]);
+#endif
+	for (; j < numElliptic; j++)
+		solve_kepler_elliptic(m_meanAnomaly[j], m_eccentricity[j], m_sinE[j], m_cosE[j]);
+
+	for (j = 0; j < numElliptic; j++) {
+		const Orbit &orbit = *m_orbits[m_elliptic[j]];
+		m_positions[m_elliptic[j]] = orbit.m_orient *
+			elliptic_position(m_eccentricity[j], orbit.m_semiMajorAxis, m_sinE[j], m_cosE[j]);
+	}
+}
@@ -6,6 +6,7 @@
 
 #include "vector3.h"
 #include "matrix3x3.h"
+#include <vector>
 
 class Orbit {
 public:
@@ -41,6 +42,8 @@ public:
 	const matrix3x3d &GetPlane() const { return m_orient; }
 
 private:
+	friend class OrbitBatch;
+
 	double TrueAnomalyFromMeanAnomaly(double MeanAnomaly) const;
 	double MeanAnomalyFromTrueAnomaly(double trueAnomaly) const;
 	double MeanAnomalyAtTime(double time) const;
@@ -53,4 +56,37 @@ private:
 	matrix3x3d m_orient;
 };
 
+// works out positions on lots of orbits at once. the Kepler equations of all
+// the elliptic orbits are laid out side by side and solved together, two at
+// a time where SSE2 is available. the results are the same as calling
+// OrbitalPosAtTime on each orbit, bit for bit, so batched and unbatched
+// callers always agree about where things are.
+//
+// the orbits must stay alive until Solve has been called
+class OrbitBatch {
+public:
+	void Clear();
+
+	// queue up the position on orbit at time t. returns the index to fetch
+	// it with after Solve
+	size_t Add(const Orbit &orbit, double t);
+
+	void Solve();
+
+	size_t GetSize() const { return m_orbits.size(); }
+	const vector3d &GetPosition(size_t i) const { return m_positions[i]; }
+
+private:
+	std::vector<const Orbit*> m_orbits;
+	std::vector<double> m_times;
+	std::vector<vector3d> m_positions;
+
+	// elliptic orbits, one array per quantity
+	std::vector<size_t> m_elliptic;
+	std::vector<double> m_meanAnomaly;
+	std::vector<double> m_eccentricity;
+	std::vector<double> m_sinE;
+	std::vector<double> m_cosE;
+};
+
 #endif
@@ -4,18 +4,23 @@
 #include "Pi.h"
 #include "libs.h"
 #include "AmbientSounds.h"
+#include "Camera.h"
 #include "CargoBody.h"
 #include "CityOnPlanet.h"
 #include "DeathView.h"
 #include "Factions.h"
 #include "FileSystem.h"
 #include "Frame.h"
+#include "FrameProfiler.h"
+#include "FrameStats.h"
+#include "Profiler.h"
 #include "GalacticView.h"
 #include "Game.h"
 #include "GameMenuView.h"
 #include "GeoSphere.h"
 #include "Intro.h"
 #include "Lang.h"
+#include "LuaBytecodeCache.h"
 #include "LuaChatForm.h"
 #include "LuaComms.h"
 #include "LuaConsole.h"
@@ -32,10 +37,14 @@
 #include "LuaMissile.h"
 #include "LuaMusic.h"
 #include "LuaNameGen.h"
+#include "LuaNative.h"
 #include "LuaRef.h"
+#include "LuaSerializer.h"
 #include "LuaShipDef.h"
 #include "LuaSpace.h"
 #include "LuaTimer.h"
+#include "LuaUtils.h"
+#include "MemoryStats.h"
 #include "Missile.h"
 #include "ModelCache.h"
 #include "ModManager.h"
@@ -45,6 +54,7 @@
 #include "Planet.h"
 #include "Player.h"
 #include "Projectile.h"
+#include "PropertyMap.h"
 #include "SDLWrappers.h"
 #include "SectorView.h"
 #include "Serializer.h"
@@ -66,11 +76,15 @@
 #include "EnumStrings.h"
 #include "galaxy/CustomSystem.h"
 #include "galaxy/Galaxy.h"
+#include "galaxy/GalaxyIndex.h"
+#include "galaxy/SectorDatabase.h"
 #include "galaxy/StarSystem.h"
 #include "gameui/Lua.h"
 #include "graphics/Graphics.h"
 #include "graphics/Light.h"
 #include "graphics/Renderer.h"
+#include "graphics/TextureLoader.h"
+#include "graphics/TextureManager.h"
 #include "gui/Gui.h"
 #include "scenegraph/Model.h"
 #include "scenegraph/Lua.h"
@@ -118,7 +132,6 @@ float Pi::frameTime;
 #if WITH_DEVKEYS
 bool Pi::showDebugInfo;
 #endif
-int Pi::statSceneTris;
 GameConfig *Pi::config;
 struct DetailLevel Pi::detail = { 0, 0 };
 bool Pi::joystickEnabled;
@@ -138,6 +151,7 @@ ObjectViewerView *Pi::objectViewerView;
 
 Sound::MusicPlayer Pi::musicPlayer;
 ScopedPtr<JobQueue> Pi::jobQueue;
+ScopedPtr<Graphics::TextureLoader> Pi::textureLoader;
 
 static void draw_progress(UI::Gauge *gauge, UI::Label *label, float progress)
 {
@@ -200,6 +214,7 @@ static void LuaInit()
 	// XXX load everything. for now, just modules
 	lua_State *l = Lua::manager->GetLuaState();
 	pi_lua_dofile_recursive(l, "libs");
+	LuaNative::Install(l);
 	pi_lua_dofile_recursive(l, "ui");
 	pi_lua_dofile_recursive(l, "modules");
 
@@ -238,6 +253,135 @@ SceneGraph::Model *Pi::FindModel(const std::string &name, bool allowPlaceholder)
 	return m;
 }
 
+// startup is a graph of steps. a step is started once every step it depends
+// on is done: on the main thread if it needs GL or the main Lua state, or
+// as a job if it doesn't. each step that finishes moves the progress bar on
+struct InitStep {
+	void (*fn)();
+	bool mainThread;
+	Uint32 after; // mask of the steps this one depends on
+};
+
+class InitJob : public Job {
+public:
+	InitJob(void (*fn)(), bool *done) : m_fn(fn), m_done(done) {
+		// don't wait behind preloading models
+		SetPriority(PRIORITY_HIGH);
+	}
+	virtual void OnRun() { m_fn(); }
+	virtual void OnFinish() { *m_done = true; }
+	virtual const char *GetName() const { return "InitJob"; }
+
+private:
+	void (*m_fn)();
+	bool *m_done;
+};
+
+// run all the steps, taking the progress bar from "from" to "to" as they
+// finish. gauge may be 0 if there isn't one yet
+static void run_init_steps(const InitStep *steps, const int count, UI::Gauge *gauge, UI::Label *label, float from, float to)
+{
+	assert(count <= 32);
+	bool started[32] = { false }, done[32] = { false };
+	Uint32 doneMask = 0;
+	int numDone = 0;
+
+	while (numDone < count) {
+		int mainStep = -1;
+		for (int i = 0; i < count; i++) {
+			if (started[i] || (steps[i].after & ~doneMask)) continue;
+			if (steps[i].mainThread) {
+				if (mainStep < 0) mainStep = i;
+			} else {
+				started[i] = true;
+				Pi::Jobs()->Queue(new InitJob(steps[i].fn, &done[i]));
+			}
+		}
+
+		if (mainStep >= 0) {
+			started[mainStep] = true;
+			steps[mainStep].fn();
+			done[mainStep] = true;
+		} else if (!Pi::Jobs()->FinishJobs())
+			SDL_Delay(1);
+
+		int nowDone = 0, running = 0;
+		for (int i = 0; i < count; i++) {
+			if (started[i] && !done[i]) running++;
+			if (!done[i]) continue;
+			doneMask |= (1 << i);
+			nowDone++;
+		}
+		// with nothing running the steps left wait on each other
+		assert(running > 0 || mainStep >= 0 || nowDone == count);
+		if (nowDone != numDone) {
+			numDone = nowDone;
+			if (gauge) draw_progress(gauge, label, from + (to - from) * float(numDone) / float(count));
+		}
+	}
+}
+
+static void InitUIContext()
+{
+	// XXX UI requires Lua  but Pi::ui must exist before we start loading
+	// templates. so now we have crap everywhere :/
+	Lua::Init();
+
+	Pi::ui.Reset(new UI::Context(Lua::manager, Pi::renderer, Graphics::GetScreenWidth(), Graphics::GetScreenHeight(), Lang::GetCurrentLanguage()));
+}
+
+static void InitModelCache()
+{
+	Pi::textureLoader.Reset(new Graphics::TextureLoader(Pi::renderer, Pi::Jobs()));
+	Pi::modelCache = new ModelCache(Pi::renderer, Pi::textureLoader.Get(), Pi::Jobs());
+	Pi::modelCache->SetBudget(size_t(std::max(Pi::config->Int("ModelBudgetMB"), 0)) << 20);
+
+	//ships the player can't fly are otherwise loaded on the spot the
+	//first time one spawns. the intro loads the others. after a jump
+	//anything could spawn, so they're all preloaded again when one starts
+	std::vector<std::string> preload;
+	for (std::vector<ShipType>::const_iterator it = ShipType::types.begin(); it != ShipType::types.end(); ++it) {
+		if (std::find(ShipType::player_ships.begin(), ShipType::player_ships.end(), it->id) == ShipType::player_ships.end())
+			preload.push_back(it->modelName);
+	}
+	Pi::modelCache->SetPreloadList(preload);
+	Pi::modelCache->Preload();
+	for (std::vector<ShipType::Id>::const_iterator it = ShipType::player_ships.begin(); it != ShipType::player_ships.end(); ++it)
+		preload.push_back(ShipType::Get(*it)->modelName);
+	Pi::modelCache->SetPreloadList(preload);
+}
+
+static void InitSectorDatabase()
+{
+	SectorDatabase::Init(Pi::config->Int("SectorDatabase") != 0);
+}
+
+static void InitPrograms()
+{
+	Pi::renderer->PrecompilePrograms();
+}
+
+static void InitEffects()
+{
+	NavLights::Init(Pi::renderer);
+	Sfx::Init(Pi::renderer);
+}
+
+static void InitSound()
+{
+	if (Pi::config->Int("DisableSound")) return;
+
+	Sound::Init();
+	Sound::SetMasterVolume(Pi::config->Float("MasterVolume"));
+	Sound::SetSfxVolume(Pi::config->Float("SfxVolume"));
+	Pi::GetMusicPlayer().SetVolume(Pi::config->Float("MusicVolume"));
+
+	Sound::Pause(0);
+	if (Pi::config->Int("MasterMuted")) Sound::Pause(1);
+	if (Pi::config->Int("SfxMuted")) Sound::SetSfxVolume(0.f);
+	if (Pi::config->Int("MusicMuted")) Pi::GetMusicPlayer().SetEnabled(false);
+}
+
 const char Pi::SAVE_DIR_NAME[] = "savefiles";
 
 std::string Pi::GetSaveDir()
@@ -249,6 +393,7 @@ void Pi::Init()
 {
 	OS::NotifyLoadBegin();
 
+	MemoryStats::Init();
 	FileSystem::Init();
 	FileSystem::userFiles.MakeDirectory(""); // ensure the config directory exists
 
@@ -304,11 +449,18 @@ void Pi::Init()
 	videoSettings.height = config->Int("ScrHeight");
 	videoSettings.fullscreen = (config->Int("StartFullscreen") != 0);
 	videoSettings.shaders = (config->Int("DisableShaders") == 0);
+	videoSettings.shaderBinaryCache = (config->Int("ShaderBinaryCache") != 0);
 	videoSettings.requestedSamples = config->Int("AntiAliasingMode");
 	videoSettings.vsync = (config->Int("VSync") != 0);
 	videoSettings.useTextureCompression = (config->Int("UseTextureCompression") != 0);
+	videoSettings.textureCache = (config->Int("TextureCache") != 0);
 
 	Pi::renderer = Graphics::Init(videoSettings);
+	if (Graphics::TextureManager *tm = renderer->GetTextureManager()) {
+		tm->SetBudget(size_t(std::max(config->Int("TextureBudgetMB"), 0)) << 20);
+		MemoryStats::SetBudget(MemoryStats::TEXTURES, tm->GetBudget());
+	}
+	SceneGraph::Model::SetMinPixelSize(config->Float("ModelCullPixels"));
 	{
 		std::ostringstream buf;
 		renderer->PrintDebugInfo(buf);
@@ -345,17 +497,34 @@ void Pi::Init()
 	jobQueue.Reset(new JobQueue(numThreads));
 	printf("started %d worker threads\n", numThreads);
 
-	// XXX early, Lua init needs it
-	ShipType::Init();
+	MemoryStats::SetBudget(MemoryStats::STAR_SYSTEMS, size_t(std::max(config->Int("StarSystemBudgetMB"), 0)) << 20);
+	MemoryStats::SetBudget(MemoryStats::SECTORS, size_t(std::max(config->Int("SectorBudgetMB"), 0)) << 20);
+	StarSystem::SetCacheSize(std::max(config->Int("StarSystemCacheSize"), 0));
+	Camera::SetOcclusionCulling(config->Int("OcclusionCulling"));
 
-	// XXX UI requires Lua  but Pi::ui must exist before we start loading
-	// templates. so now we have crap everywhere :/
-	Lua::Init();
+	LuaBytecodeCache::SetEnabled(config->Int("LuaBytecodeCache"));
+	CustomSystem::SetCacheEnabled(config->Int("CustomSystemCache"));
 
-	Pi::ui.Reset(new UI::Context(Lua::manager, Pi::renderer, Graphics::GetScreenWidth(), Graphics::GetScreenHeight(), Lang::GetCurrentLanguage()));
+	// XXX early, Lua init needs it. it has its own Lua state, so it can
+	// be parsed while the main one is set up
+	{
+		enum { SHIP_TYPES, UI_CONTEXT, STEP_COUNT };
+		const InitStep steps[STEP_COUNT] = {
+			{ &ShipType::Init, false, 0 },
+			{ &InitUIContext,  true,  0 }
+		};
+		run_init_steps(steps, STEP_COUNT, 0, 0, 0.0f, 0.0f);
+	}
 
 	LuaInit();
 
+	// from here on the main loops drive the collector
+	Lua::manager->SetGCPacing(config->Int("LuaGCPause"), config->Int("LuaGCStepMul"));
+	Lua::manager->SetGCBudget(std::max(config->Int("LuaGCBudget"), 0));
+	Pi::luaTimer->SetTaskBudget(config->Int("LuaTaskBudget"));
+	GeoSphere::SetUpdateBudget(config->Int("TerrainUpdateBudget"));
+	Lua::manager->SetMemoryLimits(size_t(std::max(config->Int("LuaMemorySoftLimit"), 0)) << 20, size_t(std::max(config->Int("LuaMemoryHardLimit"), 0)) << 20);
+
 	// Gui::Init shouldn't initialise any VBOs, since we haven't tested
 	// that the capability exists. (Gui does not use VBOs so far)
 	Gui::Init(renderer, Graphics::GetScreenWidth(), Graphics::GetScreenHeight(), 800, 600);
@@ -379,50 +548,31 @@ void Pi::Init()
 
 	draw_progress(gauge, label, 0.1f);
 
-	Galaxy::Init();
-	draw_progress(gauge, label, 0.2f);
-
-	Faction::Init();
-	draw_progress(gauge, label, 0.3f);
-
-	CustomSystem::Init();
-	draw_progress(gauge, label, 0.4f);
-
-	modelCache = new ModelCache(Pi::renderer);
-	draw_progress(gauge, label, 0.5f);
-
 //unsigned int control_word;
 //_clearfp();
 //_controlfp_s(&control_word, _EM_INEXACT | _EM_UNDERFLOW | _EM_ZERODIVIDE, _MCW_EM);
 //double fpexcept = Pi::timeAccelRates[1] / Pi::timeAccelRates[0];
 
-	draw_progress(gauge, label, 0.6f);
-
-	GeoSphere::Init();
-	draw_progress(gauge, label, 0.7f);
-
-	CityOnPlanet::Init();
-	draw_progress(gauge, label, 0.8f);
-
-	SpaceStation::Init();
-	draw_progress(gauge, label, 0.9f);
-
-	NavLights::Init(Pi::renderer);
-	Sfx::Init(Pi::renderer);
-	draw_progress(gauge, label, 0.95f);
-
-	if (!config->Int("DisableSound")) {
-		Sound::Init();
-		Sound::SetMasterVolume(config->Float("MasterVolume"));
-		Sound::SetSfxVolume(config->Float("SfxVolume"));
-		GetMusicPlayer().SetVolume(config->Float("MusicVolume"));
-
-		Sound::Pause(0);
-		if (config->Int("MasterMuted")) Sound::Pause(1);
-		if (config->Int("SfxMuted")) Sound::SetSfxVolume(0.f);
-		if (config->Int("MusicMuted")) GetMusicPlayer().SetEnabled(false);
+	{
+		// factions build star systems, and naming their bodies needs the
+		// main Lua state. custom systems only need the factions to exist.
+		// the sector database is made from all three
+		enum { GALAXY, FACTIONS, CUSTOM_SYSTEMS, SECTOR_DATABASE, MODELS, GEOSPHERE, CITIES, STATIONS, PROGRAMS, EFFECTS, SOUND, STEP_COUNT };
+		const InitStep steps[STEP_COUNT] = {
+			{ &Galaxy::Init,         true,  0 },
+			{ &Faction::Init,        true,  1 << GALAXY },
+			{ &CustomSystem::Init,   false, 1 << FACTIONS },
+			{ &InitSectorDatabase,   false, 1 << CUSTOM_SYSTEMS },
+			{ &InitModelCache,       true,  0 },
+			{ &GeoSphere::Init,      true,  0 },
+			{ &CityOnPlanet::Init,   false, 0 },
+			{ &SpaceStation::Init,   false, 0 },
+			{ &InitPrograms,         true,  0 },
+			{ &InitEffects,          true,  0 },
+			{ &InitSound,            true,  0 }
+		};
+		run_init_steps(steps, STEP_COUNT, gauge, label, 0.1f, 1.0f);
 	}
-	draw_progress(gauge, label, 1.0f);
 
 	OS::NotifyLoadEnd();
 
@@ -497,10 +647,10 @@ void Pi::Init()
 	if (pStatFile)
 	{
 		fprintf(pStatFile, "name,modelname,hullmass,capacity,fakevol,rescale,xsize,ysize,zsize,facc,racc,uacc,sacc,aacc,exvel\n");
-		for (std::map<std::string, ShipType>::iterator i = ShipType::types.begin();
+		for (std::vector<ShipType>::const_iterator i = ShipType::types.begin();
 				i != ShipType::types.end(); ++i)
 		{
-			const ShipType *shipdef = &(i->second);
+			const ShipType *shipdef = &(*i);
 			SceneGraph::Model *model = Pi::FindModel(shipdef->modelName, false);
 
 			double hullmass = shipdef->hullMass;
@@ -577,6 +727,7 @@ void Pi::Quit()
 	SpaceStation::Uninit();
 	CityOnPlanet::Uninit();
 	GeoSphere::Uninit();
+	SectorDatabase::Uninit();
 	Galaxy::Uninit();
 	Faction::Uninit();
 	CustomSystem::Uninit();
@@ -584,10 +735,17 @@ void Pi::Quit()
 	Pi::ui.Reset(0);
 	LuaUninit();
 	Gui::Uninit();
+	FrameProfiler::Stop();
+	FrameStats::Stop();
+	Profiler::Stop();
+	textureLoader.Reset();
 	delete Pi::modelCache;
 	delete Pi::renderer;
 	delete Pi::config;
 	StarSystem::ShrinkCache();
+	Sector::ShrinkCache();
+	GalaxyIndex::Clear();
+	StarSystem::ClearSummaries();
 	SDL_Quit();
 	FileSystem::Uninit();
 	jobQueue.Reset();
@@ -672,6 +830,20 @@ void Pi::HandleEvents()
 #if WITH_DEVKEYS
 						case SDLK_i: // Toggle Debug info
 							Pi::showDebugInfo = !Pi::showDebugInfo;
+							// pass timings are shown with the rest
+							if (Pi::showDebugInfo) {
+								const std::string csvFile = config->String("FrameProfilerCSV");
+								FILE *csv = 0;
+								if (!csvFile.empty()) {
+									csv = FileSystem::userFiles.OpenWriteStream(csvFile, FileSystem::FileSourceFS::WRITE_TEXT);
+									if (!csv) fprintf(stderr, "Could not open '%s'\n", csvFile.c_str());
+								}
+								FrameProfiler::Start(csv);
+								Profiler::Start();
+							} else {
+								FrameProfiler::Stop();
+								Profiler::Stop();
+							}
 							break;
 						case SDLK_m:  // Gimme money!
 							if(Pi::game) {
@@ -746,16 +918,9 @@ void Pi::HandleEvents()
 
 								else {
 									const std::string name = "_quicksave";
-									const std::string path = FileSystem::JoinPath(GetSaveDir(), name);
-									try {
-										Game::SaveGame(name, Pi::game);
-										Pi::cpan->MsgLog()->Message("", Lang::GAME_SAVED_TO + path);
-									} catch (CouldNotOpenFileException) {
-										Pi::cpan->MsgLog()->Message("", stringf(Lang::COULD_NOT_OPEN_FILENAME, formatarg("path", path)));
-									}
-									catch (CouldNotWriteToFileException) {
-										Pi::cpan->MsgLog()->Message("", Lang::GAME_SAVE_CANNOT_WRITE);
-									}
+									// the result turns up in the message log. if the last
+									// one is still being written this one's dropped
+									Game::SaveGameAsync(name, Pi::game, true);
 								}
 							}
 							break;
@@ -829,6 +994,12 @@ void Pi::TombStoneLoop()
 		Gui::Draw();
 		Pi::renderer->SwapBuffers();
 
+		// the intro models' textures come in through here
+		jobQueue->FinishJobs(config->Int("JobFinishBudget"));
+		textureLoader->Update(config->Int("TextureUploadBudget"));
+
+		Lua::manager->StepGarbage();
+
 		Pi::frameTime = 0.001f*(SDL_GetTicks() - last_time);
 		_time += Pi::frameTime;
 		last_time = SDL_GetTicks();
@@ -917,11 +1088,15 @@ void Pi::Start()
 		intro->Draw(_time);
 		Pi::renderer->EndFrame();
 
+		PropertyMap::FlushAll();
+
 		ui->Update();
 		ui->Draw();
 
 		Pi::renderer->SwapBuffers();
 
+		Lua::manager->StepGarbage();
+
 		Pi::frameTime = 0.001f*(SDL_GetTicks() - last_time);
 		_time += Pi::frameTime;
 		last_time = SDL_GetTicks();
@@ -946,7 +1121,9 @@ void Pi::EndGame()
 	LuaEvent::Queue("onGameEnd");
 	LuaEvent::Emit();
 
+	luaTimer->ClearTasks();
 	Lua::manager->CollectGarbage();
+	luaSerializer->ClearCache();
 
 	if (!config->Int("DisableSound")) AmbientSounds::Uninit();
 	Sound::DestroyAllEvents();
@@ -971,18 +1148,39 @@ void Pi::MainLoop()
 	Uint32 last_stats = SDL_GetTicks();
 	int frame_stat = 0;
 	int phys_stat = 0;
-	char fps_readout[256];
+	char fps_readout[4096];
 	memset(fps_readout, 0, sizeof(fps_readout));
 #endif
 
+	Uint32 last_autosave = SDL_GetTicks();
+
 	int MAX_PHYSICS_TICKS = Pi::config->Int("MaxPhysicsCyclesPerRender");
 	if (MAX_PHYSICS_TICKS <= 0)
 		MAX_PHYSICS_TICKS = 4;
+	// catching up stops once the ticks have taken this long, so a run of
+	// slow ticks slows the game down rather than taking the frame rate
+	// with it
+	const int physicsBudget = Pi::config->Int("PhysicsBudget");
+	const Uint64 physicsBudgetTicks = physicsBudget > 0 ? Uint64(physicsBudget) * OS::HFTimerFreq() / 1000000 : 0;
 
 	double currentTime = 0.001 * double(SDL_GetTicks());
 	double accumulator = Pi::game->GetTimeStep();
 	Pi::gameTickAlpha = 0;
 
+	{
+		const std::string hitchLog = config->String("HitchLog");
+		FILE *log = 0;
+		if (!hitchLog.empty()) {
+			log = FileSystem::userFiles.OpenWriteStream(hitchLog, FileSystem::FileSourceFS::WRITE_TEXT);
+			if (!log) fprintf(stderr, "Could not open '%s'\n", hitchLog.c_str());
+		}
+		FrameStats::Start(config->Float("HitchThreshold"), log);
+	}
+	Uint64 frameStart = OS::HFTimer();
+	Uint32 lastLuaEvents = LuaEvent::GetQueuedCount();
+	Uint32 lastModelLoads = modelCache->GetStats().loads;
+	Uint32 lastGCSteps = Lua::manager->GetGCSteps();
+
 	while (Pi::game) {
 		double newTime = 0.001 * double(SDL_GetTicks());
 		Pi::frameTime = newTime - currentTime;
@@ -993,16 +1191,20 @@ void Pi::MainLoop()
 		const float step = Pi::game->GetTimeStep();
 		if (step > 0.0f) {
 			int phys_ticks = 0;
+			const Uint64 physicsStart = OS::HFTimer();
 			while (accumulator >= step) {
-				if (++phys_ticks >= MAX_PHYSICS_TICKS) {
+				if (++phys_ticks >= MAX_PHYSICS_TICKS ||
+						(physicsBudgetTicks && phys_ticks > 1 && OS::HFTimer() - physicsStart > physicsBudgetTicks)) {
 					accumulator = 0.0;
 					break;
 				}
 				game->TimeStep(step);
-				GeoSphere::UpdateAllGeoSpheres();
 
 				accumulator -= step;
 			}
+			// the terrain only has to keep up with the frames, not the ticks
+			if (phys_ticks)
+				GeoSphere::UpdateAllGeoSpheres();
 			// rendering interpolation between frames: don't use when docked
 			int pstate = Pi::game->GetPlayer()->GetFlightState();
 			if (pstate == Ship::DOCKED || pstate == Ship::DOCKING) Pi::gameTickAlpha = 1.0;
@@ -1044,6 +1246,8 @@ void Pi::MainLoop()
 		}
 		game->GetSpace()->GetRootFrame()->UpdateInterpTransform(Pi::GetGameTickAlpha());
 
+		PropertyMap::FlushAll();
+
 		currentView->Update();
 		currentView->Draw3D();
 		// XXX HandleEvents at the moment must be after view->Draw3D and before
@@ -1056,6 +1260,7 @@ void Pi::MainLoop()
 
 		Pi::renderer->EndFrame();
 		if( DrawGUI ) {
+			FrameProfiler::ScopedPass pass(FrameProfiler::PASS_GUI);
 			Gui::Draw();
 		} else if (game && game->IsNormalSpace()) {
 			if (config->Int("DisableScreenshotInfo")==0) {
@@ -1087,11 +1292,15 @@ void Pi::MainLoop()
 #endif
 
 		Pi::renderer->SwapBuffers();
+		FrameProfiler::EndFrame();
+		Profiler::EndFrame();
 
 		// game exit or failed load from GameMenuView will have cleared
 		// Pi::game. we can't continue.
-		if (!Pi::game)
+		if (!Pi::game) {
+			FrameStats::Stop();
 			return;
+		}
 
 		if (Pi::game->UpdateTimeAccel())
 			accumulator = 0; // fix for huge pauses 10000x -> 1x
@@ -1100,12 +1309,36 @@ void Pi::MainLoop()
 			// XXX should this really be limited to while the player is alive?
 			// this is something we need not do every turn...
 			if (!config->Int("DisableSound")) AmbientSounds::Update();
-			StarSystem::ShrinkCache();
 		}
 		cpan->Update();
 		musicPlayer.Update();
 
-		jobQueue->FinishJobs();
+		if (!Pi::game->IsHyperspace())
+			luaTimer->RunTasks();
+
+		// anything that doesn't fit in the budget is picked up next frame
+		FrameStats::Work frameWork;
+		frameWork.jobsFinished = jobQueue->FinishJobs(config->Int("JobFinishBudget"));
+		frameWork.texturesLoaded = textureLoader->Update(config->Int("TextureUploadBudget"));
+		modelCache->Update();
+		Lua::manager->StepGarbage();
+
+		frameWork.luaEvents = LuaEvent::GetQueuedCount() - lastLuaEvents;
+		frameWork.modelsLoaded = modelCache->GetStats().loads - lastModelLoads;
+		frameWork.gcSteps = Lua::manager->GetGCSteps() - lastGCSteps;
+		lastLuaEvents += frameWork.luaEvents;
+		lastModelLoads += frameWork.modelsLoaded;
+		lastGCSteps += frameWork.gcSteps;
+		const Uint64 frameEnd = OS::HFTimer();
+		FrameStats::EndFrame(double(frameEnd - frameStart) * 1000.0 / double(OS::HFTimerFreq()), frameWork);
+		frameStart = frameEnd;
+
+		const int autosaveInterval = config->Int("AutosaveInterval");
+		if (autosaveInterval > 0 && SDL_GetTicks() - last_autosave > Uint32(autosaveInterval) * 1000) {
+			if (!Pi::player->IsDead() && !Pi::game->IsHyperspace())
+				Game::SaveGameAsync("_autosave", Pi::game, false);
+			last_autosave = SDL_GetTicks();
+		}
 
 #if WITH_DEVKEYS
 		if (Pi::showDebugInfo && SDL_GetTicks() - last_stats > 1000) {
@@ -1114,22 +1347,71 @@ void Pi::MainLoop()
 			int lua_memKB = int(lua_mem >> 10) % 1024;
 			int lua_memMB = int(lua_mem >> 20);
 
+			const LuaAllocator::Stats &luaAlloc = Lua::manager->GetAllocStats();
+
+			Graphics::TextureManager::Stats texStats;
+			if (Graphics::TextureManager *tm = renderer->GetTextureManager()) {
+				texStats = tm->GetStats();
+				tm->ResetCounts();
+			}
+
+			const ModelCache::Stats modelStats = modelCache->GetStats();
+			modelCache->ResetCounts();
+
+			size_t systemsCached;
+			Uint32 systemHits, systemMisses;
+			StarSystem::GetCacheStats(systemsCached, systemHits, systemMisses);
+
+			const Graphics::Stats &renderStats = renderer->GetStats();
+			const Uint32 sceneTris = renderStats.Get(Graphics::Stats::STAT_TRIANGLES);
+
 			snprintf(
 				fps_readout, sizeof(fps_readout),
-				"%d fps (%.1f ms/f), %d phys updates, %d triangles, %.3f M tris/sec, %d terrain vtx/sec, %d glyphs/sec\n"
-				"Lua mem usage: %d MB + %d KB + %d bytes",
-				frame_stat, (1000.0/frame_stat), phys_stat, Pi::statSceneTris, Pi::statSceneTris*frame_stat*1e-6,
+				"%d fps (%.1f ms/f), %d phys updates, %u triangles, %.3f M tris/sec, %d terrain vtx/sec, %d glyphs/sec\n"
+				"Last frame: %u draw calls, %u vertices, %u KB buffers, %u KB textures uploaded, %u program switches, %u texture binds, %u state changes, %u target switches\n"
+				"Lua mem usage: %d MB + %d KB + %d bytes, %.1f ms/s collecting, %u jobs waiting to finish\n"
+				"Lua allocs: %u/s, %u%% pooled, %u frees/s, %u KB in pools\n"
+				"%u star systems cached, %u hits, %u misses\n"
+				"Textures: %u MB of %u MB resident, %u evicted, %u evictions/s, %u reloads/s\n"
+				"Models: %u loaded, %u MB, %u evictions/s",
+				frame_stat, (1000.0/frame_stat), phys_stat, sceneTris, sceneTris*frame_stat*1e-6,
 				GeoSphere::GetVtxGenCount(), Text::TextureFont::GetGlyphCount(),
-				lua_memMB, lua_memKB, lua_memB
+				renderStats.Get(Graphics::Stats::STAT_DRAW_CALLS), renderStats.Get(Graphics::Stats::STAT_VERTICES_UPLOADED),
+				renderStats.Get(Graphics::Stats::STAT_BUFFER_BYTES_UPLOADED) >> 10, renderStats.Get(Graphics::Stats::STAT_TEXTURE_BYTES_UPLOADED) >> 10,
+				renderStats.Get(Graphics::Stats::STAT_PROGRAM_SWITCHES), renderStats.Get(Graphics::Stats::STAT_TEXTURE_BINDS),
+				renderStats.Get(Graphics::Stats::STAT_STATE_CHANGES), renderStats.Get(Graphics::Stats::STAT_RENDER_TARGET_SWITCHES),
+				lua_memMB, lua_memKB, lua_memB, Lua::manager->GetGCTime()*1e-3, jobQueue->GetNumWaitingToFinish(),
+				luaAlloc.allocs, luaAlloc.allocs ? Uint32((Uint64(luaAlloc.pooledAllocs) * 100) / luaAlloc.allocs) : 0,
+				luaAlloc.frees, unsigned(luaAlloc.poolBytes >> 10),
+				unsigned(systemsCached), systemHits, systemMisses,
+				unsigned(texStats.residentBytes >> 20), unsigned(texStats.totalBytes >> 20),
+				texStats.evicted, texStats.evictions, texStats.reloads,
+				modelStats.models, unsigned(modelStats.bytes >> 20), modelStats.evictions
 			);
+			const std::string frameTimes = "\n" + FrameStats::Report();
+			strncat(fps_readout, frameTimes.c_str(), sizeof(fps_readout) - strlen(fps_readout) - 1);
+			const std::string memory = "\n" + MemoryStats::Report();
+			strncat(fps_readout, memory.c_str(), sizeof(fps_readout) - strlen(fps_readout) - 1);
+			const std::string jobStats = "\n" + jobQueue->GetStatsReport();
+			strncat(fps_readout, jobStats.c_str(), sizeof(fps_readout) - strlen(fps_readout) - 1);
+			jobQueue->ResetStats();
+			if (FrameProfiler::IsRunning()) {
+				const std::string passes = "\n" + FrameProfiler::Report();
+				strncat(fps_readout, passes.c_str(), sizeof(fps_readout) - strlen(fps_readout) - 1);
+			}
+			if (Profiler::IsRunning()) {
+				const std::string zones = "\n" + Profiler::Report();
+				strncat(fps_readout, zones.c_str(), sizeof(fps_readout) - strlen(fps_readout) - 1);
+			}
 			frame_stat = 0;
 			phys_stat = 0;
+			Lua::manager->ResetGCTime();
+			Lua::manager->ResetAllocCounts();
 			Text::TextureFont::ClearGlyphCount();
 			GeoSphere::ClearVtxGenCount();
 			if (SDL_GetTicks() - last_stats > 1200) last_stats = SDL_GetTicks();
 			else last_stats += 1000;
 		}
-		Pi::statSceneTris = 0;
 #endif
 
 #ifdef MAKING_VIDEO
@@ -1140,6 +1422,191 @@ void Pi::MainLoop()
 		}
 #endif /* MAKING_VIDEO */
 	}
+
+	FrameStats::Stop();
+}
+
+static bool start_benchmark_game(const std::string &start)
+{
+	int x, y, z;
+	unsigned int system, body = 0;
+	char end;
+	const int n = sscanf(start.c_str(), "%d,%d,%d,%u,%u%c", &x, &y, &z, &system, &body, &end);
+	if (n != 4 && n != 5) {
+		try {
+			Pi::game = Game::LoadGame(start);
+		} catch (...) {
+			fprintf(stderr, "benchmark: couldn't load '%s'\n", start.c_str());
+			return false;
+		}
+		return true;
+	}
+
+	// as Game.StartGame does it
+	const SystemPath path(x, y, z, system, body);
+	RefCountedPtr<StarSystem> sys(StarSystem::GetCached(path));
+	if (body >= sys->m_bodies.size()) {
+		fprintf(stderr, "benchmark: no body at %s\n", start.c_str());
+		return false;
+	}
+	SystemBody *sbody = sys->GetBodyByPath(path);
+	if (sbody->GetSuperType() == SystemBody::SUPERTYPE_STARPORT)
+		Pi::game = new Game(path);
+	else
+		Pi::game = new Game(path, vector3d(0, 1.5*sbody->GetRadius(), 0));
+	return true;
+}
+
+int Pi::Benchmark(const std::string &start, int ticks, int timeAccel)
+{
+	Game::TimeAccel accel = Game::TIMEACCEL_1X;
+	switch (timeAccel) {
+		case 1:     accel = Game::TIMEACCEL_1X; break;
+		case 10:    accel = Game::TIMEACCEL_10X; break;
+		case 100:   accel = Game::TIMEACCEL_100X; break;
+		case 1000:  accel = Game::TIMEACCEL_1000X; break;
+		case 10000: accel = Game::TIMEACCEL_10000X; break;
+		default:
+			fprintf(stderr, "benchmark: time acceleration must be 1, 10, 100, 1000 or 10000\n");
+			return 1;
+	}
+
+	// the same run every time, as far as the workers finishing in a
+	// different order allows
+	Pi::rng.seed(0);
+
+	if (!start_benchmark_game(start))
+		return 1;
+	InitGame();
+	StartGame();
+	Pi::game->SetTimeAccel(accel);
+
+	// every tick is a frame for the profiler, so its report is per tick
+	const bool profiling = Profiler::IsRunning();
+	if (!profiling) Profiler::Start();
+
+	const double startGameTime = Pi::game->GetTime();
+	const Uint64 startTime = OS::HFTimer();
+	jobQueue->ResetStats();
+	int tick;
+	for (tick = 0; tick < ticks && !Pi::player->IsDead(); tick++) {
+		Pi::game->TimeStep(Pi::game->GetTimeStep());
+		GeoSphere::UpdateAllGeoSpheres();
+
+		// the rest of a frame that isn't drawing
+		if (!Pi::game->IsHyperspace())
+			luaTimer->RunTasks();
+		jobQueue->FinishJobs(config->Int("JobFinishBudget"));
+		modelCache->Update();
+		Lua::manager->StepGarbage();
+
+		Profiler::EndFrame();
+	}
+	const double seconds = double(OS::HFTimer() - startTime) / double(OS::HFTimerFreq());
+
+	printf("benchmark: %d ticks, %.1f game seconds in %.3f seconds, %.3f ms per tick\n",
+		tick, Pi::game->GetTime() - startGameTime, seconds, tick ? seconds * 1000.0 / tick : 0.0);
+	if (Pi::player->IsDead())
+		printf("benchmark: stopped early, the player died\n");
+#if WITH_PROFILER
+	printf("%s", Profiler::Report().c_str());
+#endif
+	printf("%s\n", jobQueue->GetStatsReport().c_str());
+
+	if (!profiling) Profiler::Stop();
+	EndGame();
+	return 0;
+}
+
+static void print_save_step(const char *name, Uint64 start, size_t bytes)
+{
+	const double ms = double(OS::HFTimer() - start) * 1000.0 / double(OS::HFTimerFreq());
+	printf("savebenchmark: %-24s %10.2f ms %12u bytes, peak memory %u MB, Lua %u KB\n", name, ms,
+		unsigned(bytes), unsigned(OS::GetPeakMemoryUsage() >> 20), unsigned(Lua::manager->GetMemoryUsage() >> 10));
+}
+
+int Pi::SaveBenchmark(const std::string &start, int numShips, int numMissions, int numLogEntries)
+{
+	static const char SAVE_NAME[] = "_savebenchmark";
+
+	Pi::rng.seed(0);
+
+	if (!start_benchmark_game(start))
+		return 1;
+	InitGame();
+	StartGame();
+
+	// the ships, missions and log come from the script
+	lua_State *l = Lua::manager->GetLuaState();
+	pi_lua_dofile(l, "benchmark/savegame.lua");
+	lua_getglobal(l, "BenchmarkSaveGame");
+	lua_pushinteger(l, numShips);
+	lua_pushinteger(l, numMissions);
+	lua_pushinteger(l, numLogEntries);
+	pi_lua_protected_call(l, 3, 0);
+	LuaEvent::Emit();
+
+	printf("savebenchmark: %u bodies, %d missions, %d log entries\n",
+		unsigned(game->GetSpace()->GetNumBodies()), numMissions, numLogEntries);
+
+	Uint64 t = OS::HFTimer();
+	size_t bytes;
+	{
+		Serializer::Writer wr;
+		game->Serialize(wr);
+		bytes = wr.GetData().size();
+	}
+	print_save_step("Game::Serialize", t, bytes);
+
+	// with the cache cleared every module is pickled again, as the first
+	// save of a game does it
+	std::string pickled;
+	luaSerializer->ClearCache();
+	t = OS::HFTimer();
+	{
+		Serializer::Writer wr;
+		luaSerializer->Serialize(wr);
+		pickled = wr.GetData();
+	}
+	print_save_step("LuaSerializer pickle", t, pickled.size());
+
+	t = OS::HFTimer();
+	{
+		Serializer::Reader rd(pickled);
+		luaSerializer->Unserialize(rd);
+	}
+	print_save_step("LuaSerializer unpickle", t, pickled.size());
+
+	luaSerializer->ClearCache();
+	t = OS::HFTimer();
+	try {
+		Game::SaveGame(SAVE_NAME, game);
+	} catch (...) {
+		fprintf(stderr, "savebenchmark: couldn't save '%s'\n", SAVE_NAME);
+		EndGame();
+		return 1;
+	}
+	RefCountedPtr<FileSystem::FileData> saved = FileSystem::userFiles.ReadFile(FileSystem::JoinPathBelow(SAVE_DIR_NAME, SAVE_NAME));
+	print_save_step("Game::SaveGame", t, saved ? saved->GetSize() : 0);
+	saved.Reset();
+
+	EndGame();
+
+	t = OS::HFTimer();
+	try {
+		game = Game::LoadGame(SAVE_NAME);
+	} catch (...) {
+		fprintf(stderr, "savebenchmark: couldn't load '%s'\n", SAVE_NAME);
+		return 1;
+	}
+	print_save_step("Game::LoadGame", t, 0);
+
+	InitGame();
+	StartGame();
+	EndGame();
+
+	remove(FileSystem::JoinPath(GetSaveDir(), SAVE_NAME).c_str());
+	return 0;
 }
 
 float Pi::CalcHyperspaceRangeMax(int hyperclass, int total_mass_in_tonnes)
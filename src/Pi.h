@@ -35,6 +35,7 @@ class StarSystem;
 class SystemInfoView;
 class SystemView;
 class UIView;
+namespace Graphics { class TextureLoader; }
 class View;
 class WorldView;
 namespace Graphics { class Renderer; }
@@ -70,6 +71,14 @@ public:
 	static void EndGame();
 	static void Start();
 	static void MainLoop();
+	// step the game at start (a save file, or "x,y,z,system[,body]") ticks
+	// times at the time acceleration timeAccel (1, 10 ... 10000) as fast as
+	// it goes, drawing nothing, and print how long it took. returns the
+	// process exit code
+	static int Benchmark(const std::string &start, int ticks, int timeAccel);
+	// start a game as Benchmark does, fill it with ships, missions and
+	// script data, then time saving and loading it and each part of that
+	static int SaveBenchmark(const std::string &start, int numShips, int numMissions, int numLogEntries);
 	static void TombStoneLoop();
 	static void OnChangeDetailLevel();
 	static void ToggleLuaConsole();
@@ -125,7 +134,6 @@ public:
 	static RefCountedPtr<UI::Context> ui;
 
 	static Random rng;
-	static int statSceneTris;
 
 	static void SetView(View *v);
 	static View *GetView() { return currentView; }
@@ -168,6 +176,7 @@ private:
 	static void InitJoysticks();
 
 	static ScopedPtr<JobQueue> jobQueue;
+	static ScopedPtr<Graphics::TextureLoader> textureLoader;
 
 	static bool menuDone;
 
@@ -5,6 +5,8 @@
 #include "Pi.h"
 #include "WorldView.h"
 #include "GeoSphere.h"
+#include "JobQueue.h"
+#include "StringF.h"
 #include "perlin.h"
 #include "graphics/Material.h"
 #include "graphics/Renderer.h"
@@ -24,16 +26,104 @@ static const Graphics::AttributeSet RING_VERTEX_ATTRIBS
 	= Graphics::ATTRIB_POSITION
 	| Graphics::ATTRIB_UV0;
 
-Planet::Planet(): TerrainBody(), m_ringVertices(RING_VERTEX_ATTRIBS)
+// samples from the surface to the top of the atmosphere. the curve is
+// smooth enough that interpolating between them stays well within a
+// thousandth of the real thing
+static const int ATMOSPHERE_TABLE_SIZE = 512;
+
+// NOTE: texture width must be > 1 to avoid graphical glitches with Intel GMA 900 systems
+//       this is something to do with mipmapping (probably mipmap generation going wrong)
+//       (if the texture is generated without mipmaps then a 1xN texture works)
+static const int RING_TEXTURE_WIDTH = 4;
+static const int RING_TEXTURE_LENGTH = 256;
+// ring textures are kept by the renderer under this and the body's seed,
+// so coming back to a system doesn't make them again
+static const char *RING_TEXTURE_CACHE = "planet-rings";
+
+// what the ring texture is made from, copied out so the job doesn't touch
+// the SystemBody
+struct RingParams {
+	float inner, outer;
+	double radius;
+	Uint32 seed;
+	Color4f baseCol;
+};
+
+static void generate_ring_texture(const RingParams &params, Color4ub *buf)
+{
+	const float ringScale = (params.outer-params.inner)*params.radius / 1.5e7f;
+
+	Random rng(params.seed+4609837);
+	const Color4f &baseCol = params.baseCol;
+	double noiseOffset = 2048.0 * rng.Double();
+	for (int i = 0; i < RING_TEXTURE_LENGTH; ++i) {
+		const float alpha = (float(i) / float(RING_TEXTURE_LENGTH)) * ringScale;
+		const float n = 0.25 +
+			0.60 * noise( 5.0 * alpha, noiseOffset, 0.0) +
+			0.15 * noise(10.0 * alpha, noiseOffset, 0.0);
+
+		const float LOG_SCALE = 1.0f/sqrtf(sqrtf(log1pf(1.0f)));
+		const float v = LOG_SCALE*sqrtf(sqrtf(log1pf(n)));
+
+		Color4ub color;
+		color.r = (v*baseCol.r)*255.0f;
+		color.g = (v*baseCol.g)*255.0f;
+		color.b = (v*baseCol.b)*255.0f;
+		color.a = (((v*0.25f)+0.75f)*baseCol.a)*255.0f;
+
+		Color4ub *row = buf + i * RING_TEXTURE_WIDTH;
+		for (int j = 0; j < RING_TEXTURE_WIDTH; ++j) {
+			row[j] = color;
+		}
+	}
+
+	// first and last pixel are forced to zero, to give a slightly smoother ring edge
+	{
+		Color4ub* row;
+		row = buf;
+		memset(row, 0, RING_TEXTURE_WIDTH * 4);
+		row = buf + (RING_TEXTURE_LENGTH - 1) * RING_TEXTURE_WIDTH;
+		memset(row, 0, RING_TEXTURE_WIDTH * 4);
+	}
+}
+
+// makes the ring texture pixels on a worker. the texture itself can only
+// be made on the main thread
+class Planet::RingJob : public Job {
+public:
+	RingJob(Planet *planet, const RingParams &params) : m_planet(planet), m_params(params), m_pixels(0) {}
+	virtual ~RingJob() { delete [] m_pixels; }
+	virtual const char *GetName() const { return "Planet::RingJob"; }
+
+	virtual void OnRun() {
+		m_pixels = new Color4ub[RING_TEXTURE_WIDTH * RING_TEXTURE_LENGTH];
+		generate_ring_texture(m_params, m_pixels);
+	}
+
+	virtual void OnFinish() {
+		m_planet->OnRingTextureDone(m_pixels);
+	}
+
+private:
+	Planet *m_planet;
+	RingParams m_params;
+	Color4ub *m_pixels;
+};
+
+Planet::Planet(): TerrainBody(), m_ringVertices(RING_VERTEX_ATTRIBS), m_ringJobGroup(0)
 {
 }
 
-Planet::Planet(SystemBody *sbody): TerrainBody(sbody), m_ringVertices(RING_VERTEX_ATTRIBS)
+Planet::Planet(SystemBody *sbody): TerrainBody(sbody), m_ringVertices(RING_VERTEX_ATTRIBS), m_ringJobGroup(0)
 {
 	InitParams(sbody);
 }
 
-Planet::~Planet() {}
+Planet::~Planet()
+{
+	if (m_ringJobGroup && Pi::Jobs())
+		Pi::Jobs()->CancelGroup(m_ringJobGroup);
+}
 
 void Planet::Load(Serializer::Reader &rd, Space *space)
 {
@@ -75,6 +165,19 @@ void Planet::InitParams(const SystemBody *sbody)
 	}
 	m_atmosphereRadius = h + sbody->GetRadius();
 
+	// ships and the camera ask for the state every tick, so it's all
+	// worked out up front
+	m_atmosphereTable.clear();
+	m_atmosphereTableStep = 0.0;
+	if (h > 0.0) {
+		m_atmosphereTableStep = h / ATMOSPHERE_TABLE_SIZE;
+		m_atmosphereTable.resize(ATMOSPHERE_TABLE_SIZE + 1);
+		for (int i = 0; i <= ATMOSPHERE_TABLE_SIZE; i++) {
+			AtmosphereSample &sample = m_atmosphereTable[i];
+			CalcAtmosphericState(sbody->GetRadius() + i * m_atmosphereTableStep, &sample.pressure, &sample.density);
+		}
+	}
+
 	SetPhysRadius(std::max(m_atmosphereRadius, GetMaxFeatureRadius()+1000));
 	if (sbody->HasRings()) {
 		SetClipRadius(sbody->GetRadius() * sbody->m_rings.maxRadius.ToDouble());
@@ -90,6 +193,19 @@ void Planet::InitParams(const SystemBody *sbody)
  * but it isn't visually noticeable.
  */
 void Planet::GetAtmosphericState(double dist, double *outPressure, double *outDensity) const
+{
+	if (dist >= m_atmosphereRadius || m_atmosphereTable.empty()) {*outDensity = 0.0; *outPressure = 0.0; return;}
+
+	const double pos = std::max(dist - GetSystemBody()->GetRadius(), 0.0) / m_atmosphereTableStep;
+	const int i = std::min(int(pos), ATMOSPHERE_TABLE_SIZE - 1);
+	const double frac = std::min(pos - i, 1.0);
+	const AtmosphereSample &a = m_atmosphereTable[i];
+	const AtmosphereSample &b = m_atmosphereTable[i+1];
+	*outPressure = a.pressure + (b.pressure - a.pressure) * frac;
+	*outDensity = a.density + (b.density - a.density) * frac;
+}
+
+void Planet::CalcAtmosphericState(double dist, double *outPressure, double *outDensity) const
 {
 #if 0
 	static bool atmosphereTableShown = false;
@@ -97,7 +213,7 @@ void Planet::GetAtmosphericState(double dist, double *outPressure, double *outDe
 		atmosphereTableShown = true;
 		for (double h = -1000; h <= 50000; h = h+1000.0) {
 			double p = 0.0, d = 0.0;
-			GetAtmosphericState(h+this->GetSystemBody()->GetRadius(),&p,&d);
+			CalcAtmosphericState(h+this->GetSystemBody()->GetRadius(),&p,&d);
 			printf("height(m): %f, pressure(kpa): %f, density: %f\n", h, p*101325.0/1000.0, d);
 		}
 	}
@@ -161,64 +277,57 @@ void Planet::GenerateRings(Graphics::Renderer *renderer)
 		m_ringVertices.Add(vector3f(outer*sa, 0.0f, outer*ca), vector2f(float(i), 1.0f));
 	}
 
-	// generate the ring texture
-	// NOTE: texture width must be > 1 to avoid graphical glitches with Intel GMA 900 systems
-	//       this is something to do with mipmapping (probably mipmap generation going wrong)
-	//       (if the texture is generated without mipmaps then a 1xN texture works)
-	const int RING_TEXTURE_WIDTH = 4;
-	const int RING_TEXTURE_LENGTH = 256;
-	ScopedMalloc<Color4ub> buf(malloc(RING_TEXTURE_WIDTH * RING_TEXTURE_LENGTH * 4));
-
-	const float ringScale = (outer-inner)*sbody->GetRadius() / 1.5e7f;
-
-	Random rng(GetSystemBody()->seed+4609837);
-	Color4f baseCol = sbody->m_rings.baseColor.ToColor4f();
-	double noiseOffset = 2048.0 * rng.Double();
-	for (int i = 0; i < RING_TEXTURE_LENGTH; ++i) {
-		const float alpha = (float(i) / float(RING_TEXTURE_LENGTH)) * ringScale;
-		const float n = 0.25 +
-			0.60 * noise( 5.0 * alpha, noiseOffset, 0.0) +
-			0.15 * noise(10.0 * alpha, noiseOffset, 0.0);
-
-		const float LOG_SCALE = 1.0f/sqrtf(sqrtf(log1pf(1.0f)));
-		const float v = LOG_SCALE*sqrtf(sqrtf(log1pf(n)));
-
-		Color4ub color;
-		color.r = (v*baseCol.r)*255.0f;
-		color.g = (v*baseCol.g)*255.0f;
-		color.b = (v*baseCol.b)*255.0f;
-		color.a = (((v*0.25f)+0.75f)*baseCol.a)*255.0f;
+	Graphics::MaterialDescriptor desc;
+	desc.effect = Graphics::EFFECT_PLANETRING;
+	desc.lighting = true;
+	desc.twoSided = true;
+	desc.textures = 1;
+	m_ringMaterial.Reset(renderer->CreateMaterial(desc));
 
-		Color4ub *row = buf.Get() + i * RING_TEXTURE_WIDTH;
-		for (int j = 0; j < RING_TEXTURE_WIDTH; ++j) {
-			row[j] = color;
-		}
+	// the texture may still be around from an earlier visit
+	Graphics::Texture *cached = renderer->GetCachedTexture(RING_TEXTURE_CACHE, stringf("%0", sbody->seed));
+	if (cached) {
+		m_ringTexture.Reset(cached);
+		m_ringMaterial->texture0 = m_ringTexture.Get();
+		return;
 	}
 
-	// first and last pixel are forced to zero, to give a slightly smoother ring edge
-	{
-		Color4ub* row;
-		row = buf.Get();
-		memset(row, 0, RING_TEXTURE_WIDTH * 4);
-		row = buf.Get() + (RING_TEXTURE_LENGTH - 1) * RING_TEXTURE_WIDTH;
-		memset(row, 0, RING_TEXTURE_WIDTH * 4);
+	RingParams params;
+	params.inner = inner;
+	params.outer = outer;
+	params.radius = sbody->GetRadius();
+	params.seed = sbody->seed;
+	params.baseCol = sbody->m_rings.baseColor.ToColor4f();
+
+	// the rings aren't drawn until the texture is ready
+	if (Pi::Jobs()) {
+		m_ringJobGroup = Pi::Jobs()->NewGroup();
+		RingJob *job = new RingJob(this, params);
+		job->SetGroup(m_ringJobGroup);
+		Pi::Jobs()->Queue(job);
+	} else {
+		Color4ub *pixels = new Color4ub[RING_TEXTURE_WIDTH * RING_TEXTURE_LENGTH];
+		generate_ring_texture(params, pixels);
+		OnRingTextureDone(pixels);
+		delete [] pixels;
 	}
+}
+
+void Planet::OnRingTextureDone(const Color4ub *pixels)
+{
+	m_ringJobGroup = 0;
 
 	const vector2f texSize(RING_TEXTURE_WIDTH, RING_TEXTURE_LENGTH);
 	const Graphics::TextureDescriptor texDesc(
 			Graphics::TEXTURE_RGBA_8888, texSize, Graphics::LINEAR_REPEAT, true);
 
+	Graphics::Renderer *renderer = Pi::renderer;
 	m_ringTexture.Reset(renderer->CreateTexture(texDesc));
 	m_ringTexture->Update(
-			static_cast<void*>(buf.Get()), texSize,
+			static_cast<const void*>(pixels), texSize,
 			Graphics::TEXTURE_RGBA_8888);
+	renderer->AddCachedTexture(RING_TEXTURE_CACHE, stringf("%0", GetSystemBody()->seed), m_ringTexture.Get());
 
-	Graphics::MaterialDescriptor desc;
-	desc.effect = Graphics::EFFECT_PLANETRING;
-	desc.lighting = true;
-	desc.twoSided = true;
-	desc.textures = 1;
-	m_ringMaterial.Reset(renderer->CreateMaterial(desc));
 	m_ringMaterial->texture0 = m_ringTexture.Get();
 }
 
@@ -227,15 +336,16 @@ void Planet::DrawGasGiantRings(Renderer *renderer, const matrix4x4d &modelView)
 	renderer->SetBlendMode(BLEND_ALPHA_PREMULT);
 	renderer->SetDepthTest(true);
 
-	if (!m_ringTexture)
+	if (!m_ringMaterial)
 		GenerateRings(renderer);
 
 	const SystemBody *sbody = GetSystemBody();
 	assert(sbody->HasRings());
 
-	renderer->SetTransform(modelView);
-
-	renderer->DrawTriangles(&m_ringVertices, m_ringMaterial.Get(), TRIANGLE_STRIP);
+	if (m_ringTexture) {
+		renderer->SetTransform(modelView);
+		renderer->DrawTriangles(&m_ringVertices, m_ringMaterial.Get(), TRIANGLE_STRIP);
+	}
 
 	renderer->SetBlendMode(BLEND_SOLID);
 }
@@ -23,6 +23,7 @@ public:
 
 	virtual void SubRender(Graphics::Renderer *r, const matrix4x4d &viewTran, const vector3d &camPos);
 
+	// interpolated from a table made when the planet is
 	void GetAtmosphericState(double dist, double *outPressure, double *outDensity) const;
 	double GetAtmosphereRadius() const { return m_atmosphereRadius; }
 
@@ -35,15 +36,28 @@ protected:
 
 private:
 	void InitParams(const SystemBody*);
+	void CalcAtmosphericState(double dist, double *outPressure, double *outDensity) const;
+	// the geometry is made straight away, the texture by a job
 	void GenerateRings(Graphics::Renderer *renderer);
+	class RingJob;
+	void OnRingTextureDone(const Color4ub *pixels);
 	void DrawGasGiantRings(Graphics::Renderer *r, const matrix4x4d &modelView);
 	void DrawAtmosphere(Graphics::Renderer *r, const matrix4x4d &modelView, const vector3d &camPos);
 
 	double m_atmosphereRadius;
 	double m_surfaceGravity_g;
+
+	// pressure and density every m_atmosphereTableStep metres up from the
+	// surface, to the top of the atmosphere. empty if there's none
+	struct AtmosphereSample {
+		double pressure, density;
+	};
+	std::vector<AtmosphereSample> m_atmosphereTable;
+	double m_atmosphereTableStep;
 	RefCountedPtr<Graphics::Texture> m_ringTexture;
 	Graphics::VertexArray m_ringVertices;
 	ScopedPtr<Graphics::Material> m_ringMaterial;
+	Uint32 m_ringJobGroup; // while the texture is being made
 
 	// Legacy renderer visuals
 	ScopedPtr<Graphics::VertexArray> m_atmosphereVertices;
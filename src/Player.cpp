@@ -4,8 +4,10 @@
 #include "Player.h"
 #include "Frame.h"
 #include "Game.h"
+#include "JobQueue.h"
 #include "KeyBindings.h"
 #include "Lang.h"
+#include "ModelCache.h"
 #include "Pi.h"
 #include "SectorView.h"
 #include "Serializer.h"
@@ -15,6 +17,7 @@
 #include "SpaceStationView.h"
 #include "WorldView.h"
 #include "StringF.h"
+#include "galaxy/StarSystem.h"
 
 //Some player specific sounds
 static Sound::Event s_soundUndercarriage;
@@ -228,8 +231,15 @@ Ship::HyperjumpStatus Player::StartHyperspaceCountdown(const SystemPath &dest)
 {
 	HyperjumpStatus status = Ship::StartHyperspaceCountdown(dest);
 
-	if (status == HYPERJUMP_OK)
+	if (status == HYPERJUMP_OK) {
 		s_soundHyperdrive.Play("Hyperdrive_Charge");
+		// bring back ships dropped from the cache before they spawn at the
+		// other end
+		Pi::modelCache->Preload();
+		// and have the system made during the countdown rather than the
+		// jump. Game::PrepareArrival takes it from there
+		StarSystem::RequestBatch(std::vector<SystemPath>(1, dest), Job::PRIORITY_HIGH);
+	}
 
 	return status;
 }
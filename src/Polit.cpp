@@ -185,27 +185,19 @@ void GetCrime(Sint64 *crimeBitset, Sint64 *fine)
 	}
 }
 
-void GetSysPolitStarSystem(const StarSystem *s, const fixed human_infestedness, SysPolit &outSysPolit)
+void GetSysPolitStarSystem(const SystemPath &path, const Faction *faction, const GovType customGovType, const fixed human_infestedness, SysPolit &outSysPolit)
 {
-	SystemPath path = s->GetPath();
 	const Uint32 _init[5] = { Uint32(path.sectorX), Uint32(path.sectorY), Uint32(path.sectorZ), path.systemIndex, POLIT_SEED };
 	Random rand(_init, 5);
 
-	Sector sec(path.sectorX, path.sectorY, path.sectorZ);
-
-	GovType a = GOV_INVALID;
-
 	/* from custom system definition */
-	if (sec.m_systems[path.systemIndex].customSys) {
-		Polit::GovType t = sec.m_systems[path.systemIndex].customSys->govType;
-		a = t;
-	}
+	GovType a = customGovType;
 	if (a == GOV_INVALID) {
 		if (path == SystemPath(0,0,0,0)) {
 			a = Polit::GOV_EARTHDEMOC;
 		} else if (human_infestedness > 0) {
 			// attempt to get the government type from the faction
-			a = s->GetFaction()->PickGovType(rand);
+			a = faction->PickGovType(rand);
 
 			// if that fails, either no faction or a faction with no gov types, then pick something at random
 			if (a == GOV_INVALID) {
@@ -9,6 +9,8 @@
 
 class StarSystem;
 class SysPolit;
+class SystemPath;
+class Faction;
 class Ship;
 
 namespace Polit {
@@ -52,7 +54,9 @@ namespace Polit {
 	};
 
 	void NotifyOfCrime(Ship *s, enum Crime c);
-	void GetSysPolitStarSystem(const StarSystem *s, const fixed human_infestedness, SysPolit &outSysPolit);
+	// customGovType is the custom system's, or GOV_INVALID if there isn't one
+	void GetSysPolitStarSystem(const SystemPath &path, const Faction *faction, const GovType customGovType, const fixed human_infestedness, SysPolit &outSysPolit);
+	// works it out from scratch. use StarSystem::IsCommodityLegal, which keeps the answers
 	bool IsCommodityLegal(const StarSystem *s, const Equip::Type t);
 	void Init();
 	void Serialize(Serializer::Writer &wr);
@@ -0,0 +1,231 @@
+// Copyright © 2008-2013 Pioneer Developers. See AUTHORS.txt for details
+// Licensed under the terms of the GPL v3. See licenses/GPL-3.txt
+
+#include "Profiler.h"
+#include "OS.h"
+#include "StringF.h"
+#include "SDL_thread.h"
+#include <map>
+#include <vector>
+
+namespace Profiler {
+
+static const int MAX_PROFILED_THREADS = 16;
+static const Uint32 RING_SIZE = 16384; // zones per thread
+static const int MAX_DEPTH = 32;
+
+// zones this close to being overwritten aren't read from another thread
+static const Uint32 RING_SLACK = 256;
+
+struct Event {
+	const char *name;
+	Uint64 start; // HFTimer
+	Uint64 end;
+	Uint32 depth;
+};
+
+struct ThreadLog {
+	ThreadLog(Uint32 id_) : id(id_), written(0), depth(0) {}
+	Uint32 id;
+	Event events[RING_SIZE];
+	volatile Uint32 written; // ever. the newest is at (written-1) % RING_SIZE
+	// the zones still open
+	const char *openName[MAX_DEPTH];
+	Uint64 openStart[MAX_DEPTH];
+	int depth;
+};
+
+// threads are added and never removed. the pointer is set before the count
+// goes up, so reading without the lock sees only complete logs
+static ThreadLog *s_threads[MAX_PROFILED_THREADS];
+static volatile int s_numThreads = 0;
+static SDL_mutex *s_threadsLock = 0;
+
+static bool s_running = false;
+static Uint64 s_epoch = 0;
+
+// main thread, for Report. by path, parent zone names and its own joined by /
+struct Total {
+	Total() : depth(0), ms(0.0), calls(0), order(0) {}
+	std::string name;
+	std::string parent;
+	int depth;
+	double ms;
+	Uint32 calls;
+	Uint32 order; // first seen, so siblings come out in the order they ran
+};
+static std::map<std::string, Total> s_totals;
+static Uint32 s_nextOrder = 0;
+static Uint32 s_frames = 0;
+static Uint32 s_frameFirst = 0; // first zone of the frame being recorded
+
+static ThreadLog *find_log(bool create)
+{
+	const Uint32 id = SDL_ThreadID();
+	const int numThreads = s_numThreads;
+	for (int i = 0; i < numThreads; i++)
+		if (s_threads[i]->id == id) return s_threads[i];
+	if (!create) return 0;
+
+	ThreadLog *log = 0;
+	SDL_LockMutex(s_threadsLock);
+	if (s_numThreads < MAX_PROFILED_THREADS) {
+		log = new ThreadLog(id);
+		s_threads[s_numThreads] = log;
+		s_numThreads = s_numThreads + 1;
+	}
+	SDL_UnlockMutex(s_threadsLock);
+	return log;
+}
+
+void Start()
+{
+	// the main thread's log is made here, so it's the first
+	if (!s_threadsLock) s_threadsLock = SDL_CreateMutex();
+	if (!s_epoch) s_epoch = OS::HFTimer();
+
+	s_running = true;
+	ThreadLog *log = find_log(true);
+	s_frameFirst = log ? log->written : 0;
+	s_totals.clear();
+	s_nextOrder = 0;
+	s_frames = 0;
+}
+
+void Stop()
+{
+	s_running = false;
+}
+
+bool IsRunning()
+{
+	return s_running;
+}
+
+void Begin(const char *name)
+{
+	ThreadLog *log = find_log(true);
+	if (!log) return;
+	// deeper than the log keeps is counted, so End still pairs up
+	if (log->depth < MAX_DEPTH) {
+		log->openName[log->depth] = name;
+		log->openStart[log->depth] = OS::HFTimer();
+	}
+	log->depth++;
+}
+
+void End()
+{
+	ThreadLog *log = find_log(false);
+	if (!log || !log->depth) return;
+	log->depth--;
+	if (log->depth >= MAX_DEPTH) return;
+
+	Event &e = log->events[log->written % RING_SIZE];
+	e.name = log->openName[log->depth];
+	e.start = log->openStart[log->depth];
+	e.end = OS::HFTimer();
+	e.depth = log->depth;
+	log->written = log->written + 1;
+}
+
+static bool by_start(const Event &a, const Event &b)
+{
+	return a.start < b.start || (a.start == b.start && a.depth < b.depth);
+}
+
+// the zones of a log from first on, oldest first, as far as the ring still
+// has them
+static void copy_events(const ThreadLog *log, Uint32 first, Uint32 slack, std::vector<Event> &out)
+{
+	const Uint32 written = log->written;
+	if (written - first > RING_SIZE - slack)
+		first = written - (RING_SIZE - slack);
+	for (Uint32 i = first; i != written; i++)
+		out.push_back(log->events[i % RING_SIZE]);
+	std::sort(out.begin(), out.end(), by_start);
+}
+
+void EndFrame()
+{
+	if (!s_running) return;
+	ThreadLog *log = find_log(true);
+	if (!log) return;
+
+	std::vector<Event> events;
+	copy_events(log, s_frameFirst, 0, events);
+	s_frameFirst = log->written;
+	s_frames++;
+
+	const double toMs = 1000.0 / double(OS::HFTimerFreq());
+	std::string path[MAX_DEPTH];
+	for (std::vector<Event>::const_iterator i = events.begin(); i != events.end(); ++i) {
+		const Uint32 depth = i->depth;
+		path[depth] = depth ? path[depth-1] + "/" + i->name : i->name;
+		Total &t = s_totals[path[depth]];
+		if (!t.calls) {
+			t.name = i->name;
+			if (depth) t.parent = path[depth-1];
+			t.depth = depth;
+			t.order = s_nextOrder++;
+		}
+		t.ms += double(i->end - i->start) * toMs;
+		t.calls++;
+	}
+}
+
+static bool by_order(const Total *a, const Total *b)
+{
+	return a->order < b->order;
+}
+
+static void report_children(const std::vector<const Total*> &totals, const std::string &parent, int depth, std::string &out)
+{
+	for (std::vector<const Total*>::const_iterator i = totals.begin(); i != totals.end(); ++i) {
+		const Total &t = **i;
+		if (t.depth != depth || t.parent != parent) continue;
+		out += stringf("%0%1 %2{f.2} ms, %3{f.1} calls\n", std::string(depth*2, ' '), t.name,
+			t.ms / s_frames, double(t.calls) / s_frames);
+		report_children(totals, depth ? parent + "/" + t.name : t.name, depth+1, out);
+	}
+}
+
+std::string Report()
+{
+	std::string out;
+	if (s_frames) {
+		std::vector<const Total*> totals;
+		for (std::map<std::string, Total>::const_iterator i = s_totals.begin(); i != s_totals.end(); ++i)
+			totals.push_back(&i->second);
+		std::sort(totals.begin(), totals.end(), by_order);
+		report_children(totals, "", 0, out);
+	}
+	s_totals.clear();
+	s_nextOrder = 0;
+	s_frames = 0;
+	return out;
+}
+
+bool WriteTrace(FILE *f)
+{
+	const double toUs = 1000000.0 / double(OS::HFTimerFreq());
+	fputs("{\"traceEvents\":[\n", f);
+	bool first = true;
+	const int numThreads = s_numThreads;
+	for (int t = 0; t < numThreads; t++) {
+		// other threads may be writing as this runs, so the zones about to
+		// be overwritten are left alone
+		std::vector<Event> events;
+		copy_events(s_threads[t], 0, RING_SLACK, events);
+		for (std::vector<Event>::const_iterator i = events.begin(); i != events.end(); ++i) {
+			fprintf(f, "%s{\"name\":\"%s\",\"ph\":\"X\",\"pid\":0,\"tid\":%d,\"ts\":%.3f,\"dur\":%.3f}",
+				first ? "" : ",\n", i->name, t,
+				double(Sint64(i->start - s_epoch)) * toUs, double(i->end - i->start) * toUs);
+			first = false;
+		}
+	}
+	fputs("\n]}\n", f);
+	return !ferror(f);
+}
+
+}
@@ -0,0 +1,55 @@
+// Copyright © 2008-2013 Pioneer Developers. See AUTHORS.txt for details
+// Licensed under the terms of the GPL v3. See licenses/GPL-3.txt
+
+#ifndef _PROFILER_H
+#define _PROFILER_H
+
+#include "libs.h"
+
+// a hierarchical cpu profiler. PROFILE_ZONE("name") makes the rest of the
+// scope it's in a zone, and zones inside zones nest. each thread writes the
+// zones it finishes to a ring buffer of its own, so threads share nothing
+// while they record. the oldest zones are lost when a ring is full.
+//
+// built with WITH_PROFILER 0 the macro is empty. built in, a zone costs a
+// check while the profiler is stopped
+namespace Profiler {
+
+	void Start();
+	void Stop();
+	bool IsRunning();
+
+	// bracket a zone. the name isn't copied, so it should be a literal.
+	// End finishes the one begun last on the same thread
+	void Begin(const char *name);
+	void End();
+
+	// call once per frame, from the main thread
+	void EndFrame();
+
+	// the main thread's zones as a tree, milliseconds and calls per frame,
+	// averaged over the frames since the last report
+	std::string Report();
+
+	// every zone still in the rings, from every thread, in the trace event
+	// JSON that chrome://tracing reads
+	bool WriteTrace(FILE *f);
+
+	class Zone {
+	public:
+		Zone(const char *name) : m_running(IsRunning()) { if (m_running) Begin(name); }
+		~Zone() { if (m_running) End(); }
+	private:
+		bool m_running;
+	};
+}
+
+#if WITH_PROFILER
+#define PROFILE_CONCAT_(a, b) a##b
+#define PROFILE_CONCAT(a, b) PROFILE_CONCAT_(a, b)
+#define PROFILE_ZONE(name) Profiler::Zone PROFILE_CONCAT(profileZone, __LINE__)(name)
+#else
+#define PROFILE_ZONE(name)
+#endif
+
+#endif /* _PROFILER_H */
@@ -26,6 +26,8 @@ ScopedPtr<Graphics::VertexArray> Projectile::s_sideVerts;
 ScopedPtr<Graphics::VertexArray> Projectile::s_glowVerts;
 ScopedPtr<Graphics::Material> Projectile::s_sideMat;
 ScopedPtr<Graphics::Material> Projectile::s_glowMat;
+ScopedPtr<Graphics::VertexArray> Projectile::s_sideBatch;
+ScopedPtr<Graphics::VertexArray> Projectile::s_glowBatch;
 
 void Projectile::BuildModel()
 {
@@ -33,6 +35,7 @@ void Projectile::BuildModel()
 	Graphics::MaterialDescriptor desc;
 	desc.textures = 1;
 	desc.twoSided = true;
+	desc.vertexColors = true;
 	s_sideMat.Reset(Pi::renderer->CreateMaterial(desc));
 	s_glowMat.Reset(Pi::renderer->CreateMaterial(desc));
 	s_sideMat->texture0 = Graphics::TextureBuilder::Billboard("textures/projectile_l.png").GetOrCreateTexture(Pi::renderer, "billboard");
@@ -57,6 +60,8 @@ void Projectile::BuildModel()
 
 	s_sideVerts.Reset(new Graphics::VertexArray(Graphics::ATTRIB_POSITION | Graphics::ATTRIB_UV0));
 	s_glowVerts.Reset(new Graphics::VertexArray(Graphics::ATTRIB_POSITION | Graphics::ATTRIB_UV0));
+	s_sideBatch.Reset(new Graphics::VertexArray(Graphics::ATTRIB_POSITION | Graphics::ATTRIB_DIFFUSE | Graphics::ATTRIB_UV0));
+	s_glowBatch.Reset(new Graphics::VertexArray(Graphics::ATTRIB_POSITION | Graphics::ATTRIB_DIFFUSE | Graphics::ATTRIB_UV0));
 
 	//add four intersecting planes to create a volumetric effect
 	for (int i=0; i < 4; i++) {
@@ -98,6 +103,35 @@ void Projectile::FreeModel()
 	s_glowMat.Reset();
 	s_sideVerts.Reset();
 	s_glowVerts.Reset();
+	s_sideBatch.Reset();
+	s_glowBatch.Reset();
+}
+
+// put a copy of the model into the batch, moved to where it's drawn
+static void add_to_batch(Graphics::VertexArray *batch, const Graphics::VertexArray *model, const matrix4x4f &m, const Color &color)
+{
+	for (unsigned int i = 0; i < model->GetNumVerts(); i++)
+		batch->Add(m * model->position[i], color, model->uv0[i]);
+}
+
+void Projectile::RenderBatch(Graphics::Renderer *renderer)
+{
+	if (!s_sideBatch || (!s_sideBatch->GetNumVerts() && !s_glowBatch->GetNumVerts())) return;
+
+	renderer->SetTransform(matrix4x4f::Identity());
+	renderer->SetBlendMode(Graphics::BLEND_ALPHA_ONE);
+	renderer->SetDepthWrite(false);
+
+	if (s_sideBatch->GetNumVerts())
+		renderer->DrawTriangles(s_sideBatch.Get(), s_sideMat.Get());
+	if (s_glowBatch->GetNumVerts())
+		renderer->DrawTriangles(s_glowBatch.Get(), s_glowMat.Get());
+
+	renderer->SetBlendMode(Graphics::BLEND_SOLID);
+	renderer->SetDepthWrite(true);
+
+	s_sideBatch->Clear();
+	s_glowBatch->Clear();
 }
 
 Projectile::Projectile(): Body()
@@ -106,7 +140,6 @@ Projectile::Projectile(): Body()
 	SetOrient(matrix3x3d::Identity());
 	m_type = 1;
 	m_age = 0;
-	m_parent = 0;
 	m_flags |= FLAG_DRAW_LAST;
 }
 
@@ -121,7 +154,7 @@ void Projectile::Save(Serializer::Writer &wr, Space *space)
 	wr.Vector3d(m_dirVel);
 	wr.Float(m_age);
 	wr.Int32(m_type);
-	wr.Int32(space->GetIndexForBody(m_parent));
+	wr.Int32(space->GetIndexForBody(space->GetBodyForHandle(m_parent)));
 }
 
 void Projectile::Load(Serializer::Reader &rd, Space *space)
@@ -137,7 +170,7 @@ void Projectile::Load(Serializer::Reader &rd, Space *space)
 void Projectile::PostLoadFixup(Space *space)
 {
 	Body::PostLoadFixup(space);
-	m_parent = space->GetBodyByIndex(m_parentIndex);
+	m_parent = space->GetHandleForBody(space->GetBodyByIndex(m_parentIndex));
 }
 
 void Projectile::UpdateInterpTransform(double alpha)
@@ -147,11 +180,6 @@ void Projectile::UpdateInterpTransform(double alpha)
 	m_interpPos = alpha*GetPosition() + (1.0-alpha)*oldPos;
 }
 
-void Projectile::NotifyRemoved(const Body* const removedBody)
-{
-	if (m_parent == removedBody) m_parent = 0;
-}
-
 void Projectile::TimeStepUpdate(const float timeStep)
 {
 	m_age += timeStep;
@@ -214,11 +242,12 @@ void Projectile::StaticUpdate(const float timeStep)
 		}
 		else if (o->IsType(Object::BODY)) {
 			Body *hit = static_cast<Body*>(o);
-			if (hit != m_parent) {
-				hit->OnDamage(m_parent, GetDamage());
+			Body *parent = Pi::game->GetSpace()->GetBodyForHandle(m_parent);
+			if (hit != parent) {
+				hit->OnDamage(parent, GetDamage());
 				Pi::game->GetSpace()->KillBody(this);
 				if (hit->IsType(Object::SHIP))
-					LuaEvent::Queue("onShipHit", dynamic_cast<Ship*>(hit), dynamic_cast<Body*>(m_parent));
+					LuaEvent::Queue("onShipHit", dynamic_cast<Ship*>(hit), parent);
 			}
 		}
 	}
@@ -228,7 +257,7 @@ void Projectile::StaticUpdate(const float timeStep)
 			Planet *const planet = static_cast<Planet*>(GetFrame()->GetBody());
 			const SystemBody *b = planet->GetSystemBody();
 			vector3d pos = GetPosition();
-			double terrainHeight = planet->GetTerrainHeight(pos.Normalized());
+			double terrainHeight = planet->GetCachedTerrainHeight(pos.Normalized());
 			if (terrainHeight > pos.Length()) {
 				// hit the fucker
 				if (b->type == SystemBody::TYPE_PLANET_ASTEROID) {
@@ -263,16 +292,13 @@ void Projectile::Render(Graphics::Renderer *renderer, const Camera *camera, cons
 	m[13] = from.y;
 	m[14] = from.z;
 
-	renderer->SetBlendMode(Graphics::BLEND_ALPHA_ONE);
-	renderer->SetDepthWrite(false);
-
 	// increase visible size based on distance from camera, z is always negative
 	// allows them to be smaller while maintaining visibility for game play
 	const float dist_scale = float(viewCoords.z / -500);
 	const float length = Equip::lasers[m_type].length + dist_scale;
 	const float width = Equip::lasers[m_type].width + dist_scale;
 
-	renderer->SetTransform(m * matrix4x4f::ScaleMatrix(width, width, length));
+	m = m * matrix4x4f::ScaleMatrix(width, width, length);
 
 	Color color = Equip::lasers[m_type].color;
 	// fade them out as they age so they don't suddenly disappear
@@ -282,29 +308,22 @@ void Projectile::Render(Graphics::Renderer *renderer, const Camera *camera, cons
 	vector3f view_dir = vector3f(viewCoords).Normalized();
 	color.a = base_alpha * (1.f - powf(fabs(dir.Dot(view_dir)), length));
 
-	if (color.a > 0.01f) {
-		s_sideMat->diffuse = color;
-		renderer->DrawTriangles(s_sideVerts.Get(), s_sideMat.Get());
-	}
+	if (color.a > 0.01f)
+		add_to_batch(s_sideBatch.Get(), s_sideVerts.Get(), m, color);
 
 	// fade out glow quads when viewing nearly edge on
 	// these and the side quads fade at different rates
 	// so that they aren't both at the same alpha as that looks strange
 	color.a = base_alpha * powf(fabs(dir.Dot(view_dir)), width);
 
-	if (color.a > 0.01f) {
-		s_glowMat->diffuse = color;
-		renderer->DrawTriangles(s_glowVerts.Get(), s_glowMat.Get());
-	}
-
-	renderer->SetBlendMode(Graphics::BLEND_SOLID);
-	renderer->SetDepthWrite(true);
+	if (color.a > 0.01f)
+		add_to_batch(s_glowBatch.Get(), s_glowVerts.Get(), m, color);
 }
 
 void Projectile::Add(Body *parent, Equip::Type type, const vector3d &pos, const vector3d &baseVel, const vector3d &dirVel)
 {
 	Projectile *p = new Projectile();
-	p->m_parent = parent;
+	p->m_parent = Pi::game->GetSpace()->GetHandleForBody(parent);
 	p->m_type = Equip::types[type].tableIndex;
 	p->SetFrame(parent->GetFrame());
 
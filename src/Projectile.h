@@ -5,7 +5,9 @@
 #define _PROJECTILE_H
 
 #include "Body.h"
+#include "BodyPool.h"
 #include "EquipType.h"
+#include "Space.h"
 #include "graphics/Material.h"
 #include "SmartPtr.h"
 
@@ -15,7 +17,7 @@ namespace Graphics {
 	class VertexArray;
 }
 
-class Projectile: public Body {
+class Projectile: public Body, public BodyPool<Projectile> {
 public:
 	OBJDEF(Projectile, Body, PROJECTILE);
 
@@ -26,11 +28,13 @@ public:
 	virtual void Render(Graphics::Renderer *r, const Camera *camera, const vector3d &viewCoords, const matrix4x4d &viewTransform);
 	void TimeStepUpdate(const float timeStep);
 	void StaticUpdate(const float timeStep);
-	virtual void NotifyRemoved(const Body* const removedBody);
 	virtual void UpdateInterpTransform(double alpha);
 	virtual void PostLoadFixup(Space *space);
 
 	static void FreeModel();
+	// draw every projectile Render has collected since the last call, and
+	// forget them. the camera does this once it's drawn all the bodies
+	static void RenderBatch(Graphics::Renderer *r);
 
 protected:
 	virtual void Save(Serializer::Writer &wr, Space *space);
@@ -38,7 +42,7 @@ protected:
 private:
 	float GetDamage() const;
 	double GetRadius() const;
-	Body *m_parent;
+	Space::BodyHandle m_parent;
 	vector3d m_baseVel;
 	vector3d m_dirVel;
 	float m_age;
@@ -52,6 +56,9 @@ private:
 	static ScopedPtr<Graphics::VertexArray> s_glowVerts;
 	static ScopedPtr<Graphics::Material> s_sideMat;
 	static ScopedPtr<Graphics::Material> s_glowMat;
+	// in view space, with the colour of each projectile in its vertices
+	static ScopedPtr<Graphics::VertexArray> s_sideBatch;
+	static ScopedPtr<Graphics::VertexArray> s_glowBatch;
 };
 
 #endif /* _PROJECTILE_H */
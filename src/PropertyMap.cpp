@@ -3,8 +3,14 @@
 
 #include "PropertyMap.h"
 #include "LuaUtils.h"
+#include <algorithm>
 
-PropertyMap::PropertyMap(LuaManager *lua)
+std::vector<PropertyMap*> PropertyMap::s_pending;
+std::vector<PropertyMap*> *PropertyMap::s_flushing = 0;
+size_t PropertyMap::s_numUnsynced = 0;
+
+PropertyMap::PropertyMap(LuaManager *lua) :
+	m_pending(false)
 {
 	lua_State *l = lua->GetLuaState();
 	LUA_DEBUG_START(l);
@@ -14,6 +20,80 @@ PropertyMap::PropertyMap(LuaManager *lua)
 	LUA_DEBUG_END(l, 0);
 }
 
+PropertyMap::~PropertyMap()
+{
+	s_numUnsynced -= m_unsynced.size();
+	if (m_pending)
+		s_pending.erase(std::find(s_pending.begin(), s_pending.end(), this));
+	if (s_flushing)
+		std::replace(s_flushing->begin(), s_flushing->end(), this, static_cast<PropertyMap*>(0));
+}
+
+void PropertyMap::SetValue(const std::string &k, const NativeValue &v)
+{
+	std::pair<PropertyTable::iterator,bool> entry = m_properties.insert(std::make_pair(k, Property()));
+	Property &p = (*entry.first).second;
+	if (!entry.second && p.value == v)
+		return;
+
+	p.value = v;
+
+	if (!p.unsynced) {
+		p.unsynced = true;
+		m_unsynced.push_back(entry.first);
+		s_numUnsynced++;
+	}
+	if (!p.unsignalled) {
+		p.unsignalled = true;
+		m_unsignalled.push_back(entry.first);
+	}
+	if (!m_pending) {
+		m_pending = true;
+		s_pending.push_back(this);
+	}
+}
+
+void PropertyMap::Sync()
+{
+	if (m_unsynced.empty())
+		return;
+
+	lua_State *l = m_table.GetLua();
+	LUA_DEBUG_START(l);
+
+	m_table.PushCopyToStack();
+	for (std::vector<PropertyTable::iterator>::iterator i = m_unsynced.begin(); i != m_unsynced.end(); ++i) {
+		Property &p = (*(*i)).second;
+		const std::string &k = (*(*i)).first;
+		lua_pushlstring(l, k.c_str(), k.size());
+		switch (p.value.type) {
+			case NativeValue::BOOLEAN: lua_pushboolean(l, p.value.number > 0.0); break;
+			case NativeValue::NUMBER:  lua_pushnumber(l, p.value.number); break;
+			case NativeValue::STRING:  lua_pushlstring(l, p.value.string.c_str(), p.value.string.size()); break;
+		}
+		lua_rawset(l, -3);
+		p.unsynced = false;
+	}
+	lua_pop(l, 1);
+
+	s_numUnsynced -= m_unsynced.size();
+	m_unsynced.clear();
+
+	LUA_DEBUG_END(l, 0);
+}
+
+void PropertyMap::SendSignals()
+{
+	// a handler can set more properties (or these ones again), so work on
+	// a copy. anything it changes is signalled next time
+	std::vector<PropertyTable::iterator> keys;
+	keys.swap(m_unsignalled);
+	for (std::vector<PropertyTable::iterator>::iterator i = keys.begin(); i != keys.end(); ++i)
+		(*(*i)).second.unsignalled = false;
+	for (std::vector<PropertyTable::iterator>::iterator i = keys.begin(); i != keys.end(); ++i)
+		SendSignal((*(*i)).first);
+}
+
 void PropertyMap::SendSignal(const std::string &k)
 {
 	std::map< std::string,sigc::signal<void,PropertyMap &,const std::string &> >::iterator i = m_signals.find(k);
@@ -25,5 +105,34 @@ void PropertyMap::SendSignal(const std::string &k)
 
 void PropertyMap::PushLuaTable()
 {
+	Sync();
 	m_table.PushCopyToStack();
 }
+
+void PropertyMap::SyncAll()
+{
+	for (std::vector<PropertyMap*>::iterator i = s_pending.begin(); i != s_pending.end(); ++i)
+		(*i)->Sync();
+}
+
+void PropertyMap::FlushAll()
+{
+	if (s_pending.empty())
+		return;
+
+	// handlers can set properties and create and destroy maps, so work
+	// through the list as it is now. a map destroyed in the meantime blanks
+	// its entry, and anything changed is picked up next time
+	std::vector<PropertyMap*> pending;
+	pending.swap(s_pending);
+	for (std::vector<PropertyMap*>::iterator i = pending.begin(); i != pending.end(); ++i)
+		(*i)->m_pending = false;
+
+	s_flushing = &pending;
+	for (size_t i = 0; i < pending.size(); i++) {
+		if (!pending[i]) continue;
+		pending[i]->Sync();
+		if (pending[i]) pending[i]->SendSignals();
+	}
+	s_flushing = 0;
+}
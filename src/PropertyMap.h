@@ -11,16 +11,22 @@
 
 struct lua_State;
 
+// values are kept natively, and setting one that hasn't changed does
+// nothing. changes are only copied into the Lua table when something is
+// about to look at it (Get, PushLuaTable, or a property lookup on the Lua
+// side via SyncAll), and the change signals go out once per frame from
+// FlushAll, once for each property however often it changed
 class PropertyMap {
 public:
 	PropertyMap(LuaManager *lua);
+	~PropertyMap();
 
 	template <class Value> void Set(const std::string &k, const Value &v) {
-		ScopedTable(m_table).Set(k, v);
-		SendSignal(k);
+		SetValue(k, MakeValue(v));
 	}
 
 	template <class Value> void Get(const std::string &k, Value &v) {
+		Sync();
 		v = ScopedTable(m_table).Get<Value>(k, v);
 	}
 
@@ -30,11 +36,59 @@ public:
 		return m_signals[k].connect(fn);
 	}
 
+	// copy every pending change into the Lua tables. cheap if there are none
+	static bool HaveUnsynced() { return s_numUnsynced > 0; }
+	static void SyncAll();
+
+	// sync everything, then send the change signals. main loop only
+	static void FlushAll();
+
 private:
-	LuaRef m_table;
+	struct NativeValue {
+		enum Type { BOOLEAN, NUMBER, STRING };
+		Type type;
+		double number; // also holds booleans
+		std::string string;
+
+		bool operator==(const NativeValue &a) const {
+			return type == a.type && (type == STRING ? string == a.string : !(number < a.number || number > a.number));
+		}
+	};
+
+	static NativeValue MakeValue(bool v)               { NativeValue a; a.type = NativeValue::BOOLEAN; a.number = v ? 1.0 : 0.0; return a; }
+	static NativeValue MakeValue(int v)                { NativeValue a; a.type = NativeValue::NUMBER; a.number = v; return a; }
+	static NativeValue MakeValue(unsigned int v)       { NativeValue a; a.type = NativeValue::NUMBER; a.number = v; return a; }
+	static NativeValue MakeValue(float v)              { NativeValue a; a.type = NativeValue::NUMBER; a.number = v; return a; }
+	static NativeValue MakeValue(double v)             { NativeValue a; a.type = NativeValue::NUMBER; a.number = v; return a; }
+	static NativeValue MakeValue(const char *v)        { NativeValue a; a.type = NativeValue::STRING; a.number = 0.0; a.string = v; return a; }
+	static NativeValue MakeValue(const std::string &v) { NativeValue a; a.type = NativeValue::STRING; a.number = 0.0; a.string = v; return a; }
+
+	struct Property {
+		Property() : unsynced(false), unsignalled(false) {}
+		NativeValue value;
+		bool unsynced;
+		bool unsignalled;
+	};
+	typedef std::map<std::string,Property> PropertyTable;
 
+	void SetValue(const std::string &k, const NativeValue &v);
+	void Sync();
+	void SendSignals();
 	void SendSignal(const std::string &k);
+
+	LuaRef m_table;
+
+	PropertyTable m_properties;
+	std::vector<PropertyTable::iterator> m_unsynced;
+	std::vector<PropertyTable::iterator> m_unsignalled;
+
 	std::map< std::string,sigc::signal<void,PropertyMap &,const std::string &> > m_signals;
+
+	// maps with changes that haven't been synced or signalled yet
+	static std::vector<PropertyMap*> s_pending;
+	static std::vector<PropertyMap*> *s_flushing; // what FlushAll is working through
+	static size_t s_numUnsynced;
+	bool m_pending;
 };
 
 #endif
@@ -83,10 +83,7 @@ public:
 	// interval [0, 2**32)
 	Uint32 Int32()
 	{
-		current ^= (current << 17);
-		current ^= (current >> 13);
-		current ^= (current << 5);
-		return current;
+		return Next(current);
 	}
 
 	// Pick an integer like you're rolling a "choices" sided die,
@@ -180,7 +177,51 @@ public:
 			o *= Fixed();
 		return o;
 	}
+	//
+	// Batch generators.
+	//
+	// Each gives exactly what n calls to the single number version would,
+	// in the same order, but keeps the state in a register for the whole
+	// run. For filling tables and placing lots of things at once
+	//
+
+	// n numbers from Int32(), interval [0, 2**32)
+	void Fill(Uint32 *out, size_t n)
+	{
+		Uint32 state = current;
+		for (size_t i = 0; i < n; i++)
+			out[i] = Next(state);
+		current = state;
+	}
+
+	// n numbers from Double(), interval [0, 1)
+	void Fill(double *out, size_t n)
+	{
+		Uint32 state = current;
+		for (size_t i = 0; i < n; i++)
+			out[i] = double(Next(state)) * (1. / 4294967296.);
+		current = state;
+	}
+
+	// n numbers from Int32(choices), interval [0, choices)
+	void FillInt(Uint32 *out, size_t n, int choices)
+	{
+		assert(choices > 0);
+		Uint32 state = current;
+		for (size_t i = 0; i < n; i++)
+			out[i] = Next(state) % choices;
+		current = state;
+	}
+
 private:
+	static inline Uint32 Next(Uint32 &state)
+	{
+		state ^= (state << 17);
+		state ^= (state >> 13);
+		state ^= (state << 5);
+		return state;
+	}
+
 	Random(const Random&); // copy constructor not defined
 	void operator=(const Random&); // assignment operator not defined
 };
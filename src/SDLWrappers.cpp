@@ -13,10 +13,15 @@ SDLSurfacePtr LoadSurfaceFromFile(const std::string &fname, FileSystem::FileSour
 		return SDLSurfacePtr();
 	}
 
-	SDL_RWops *datastream = SDL_RWFromConstMem(filedata->GetData(), filedata->GetSize());
+	return LoadSurfaceFromData(fname, *filedata);
+}
+
+SDLSurfacePtr LoadSurfaceFromData(const std::string &fname, const FileSystem::FileData &data)
+{
+	SDL_RWops *datastream = SDL_RWFromConstMem(data.GetData(), data.GetSize());
 	SDL_Surface *surface = IMG_Load_RW(datastream, 1);
 	if (!surface) {
-		fprintf(stderr, "LoadSurfaceFromFile: %s: %s\n", fname.c_str(), IMG_GetError());
+		fprintf(stderr, "LoadSurfaceFromData: %s: %s\n", fname.c_str(), IMG_GetError());
 		return SDLSurfacePtr();
 	}
 
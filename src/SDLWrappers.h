@@ -6,7 +6,7 @@
 
 #include "SmartPtr.h"
 
-namespace FileSystem { class FileSource; }
+namespace FileSystem { class FileSource; class FileData; }
 
 struct SDL_Surface;
 
@@ -30,5 +30,7 @@ public:
 
 SDLSurfacePtr LoadSurfaceFromFile(const std::string &fname, FileSystem::FileSource &source);
 SDLSurfacePtr LoadSurfaceFromFile(const std::string &fname);
+// decode a file that's already been read. fname is only for messages
+SDLSurfacePtr LoadSurfaceFromData(const std::string &fname, const FileSystem::FileData &data);
 
 #endif
@@ -5,6 +5,7 @@
 #include "Factions.h"
 #include "GalacticView.h"
 #include "Game.h"
+#include "JobQueue.h"
 #include "Lang.h"
 #include "Pi.h"
 #include "Player.h"
@@ -27,6 +28,10 @@ using namespace Graphics;
 static const int DRAW_RAD = 5;
 #define INNER_RADIUS (Sector::SIZE*1.5f)
 #define OUTER_RADIUS (Sector::SIZE*float(DRAW_RAD))
+// the far view's chunks are this many sectors along each side. chunks this
+// many sectors away are drawn with less detail, and less again at twice that
+static const int FAR_CHUNK_SECTORS = 4;
+static const float FAR_LOD_DIST = 8.f;
 static const float FAR_THRESHOLD = 7.5f;
 static const float FAR_LIMIT     = 36.f;
 static const float FAR_MAX       = 46.f;
@@ -37,6 +42,9 @@ enum DetailSelection {
 ,	DETAILBOX_FACTION = 2
 };
 
+// how many sectors beyond the drawn ones to generate ahead of the view
+static const float PREFETCH_DEPTH = 2.f;
+
 static const float ZOOM_SPEED = 15;
 static const float WHEEL_SENSITIVITY = .03f;		// Should be a variable in user settings.
 
@@ -99,12 +107,18 @@ void SectorView::InitDefaults()
 
 	m_secPosFar = vector3f(INT_MAX, INT_MAX, INT_MAX);
 	m_radiusFar = 0;
+	m_farSectorsMissing = false;
+	m_secPosNear = vector3f(INT_MAX, INT_MAX, INT_MAX);
+	m_jobGroup = Pi::Jobs()->NewGroup();
+	m_newSectorsReady = false;
 	m_cacheXMin = 0;
 	m_cacheXMax = 0;
 	m_cacheYMin = 0;
 	m_cacheYMax = 0;
-	m_cacheYMin = 0;
-	m_cacheYMax = 0;
+	m_cacheZMin = 0;
+	m_cacheZMax = 0;
+	m_routeRange = 0.0f;
+	m_routePlan = 0;
 }
 
 void SectorView::InitObject()
@@ -263,6 +277,8 @@ void SectorView::InitObject()
 
 SectorView::~SectorView()
 {
+	Pi::Jobs()->CancelGroup(m_jobGroup);
+	RoutePlanner::Cancel(m_routePlan);
 	m_onMouseButtonDown.disconnect();
 	if (m_onKeyPressConnection.connected()) m_onKeyPressConnection.disconnect();
 }
@@ -308,35 +324,35 @@ void SectorView::OnSearchBoxKeyPress(const SDL_keysym *keysym)
 
 	bool gotMatch = false, gotStartMatch = false;
 	SystemPath bestMatch;
-	const std::string *bestMatchName = 0;
+	std::string bestMatchName;
 
-	for (std::map<SystemPath,Sector*>::iterator i = m_sectorCache.begin(); i != m_sectorCache.end(); ++i)
+	for (std::map<SystemPath,RefCountedPtr<Sector> >::iterator i = m_sectorCache.begin(); i != m_sectorCache.end(); ++i)
 
 		for (unsigned int systemIndex = 0; systemIndex < (*i).second->m_systems.size(); systemIndex++) {
-			const Sector::System *ss = &((*i).second->m_systems[systemIndex]);
+			const std::string name = (*i).second->GetSystemName(systemIndex);
 
 			// compare with the start of the current system
-			if (strncasecmp(search.c_str(), ss->name.c_str(), search.size()) == 0) {
+			if (strncasecmp(search.c_str(), name.c_str(), search.size()) == 0) {
 
 				// matched, see if they're the same size
-				if (search.size() == ss->name.size()) {
+				if (search.size() == name.size()) {
 
 					// exact match, take it and go
 					SystemPath path = (*i).first;
 					path.systemIndex = systemIndex;
-					Pi::cpan->MsgLog()->Message("", stringf(Lang::EXACT_MATCH_X, formatarg("system", ss->name)));
+					Pi::cpan->MsgLog()->Message("", stringf(Lang::EXACT_MATCH_X, formatarg("system", name)));
 					GotoSystem(path);
 					return;
 				}
 
 				// partial match at start of name
-				if (!gotMatch || !gotStartMatch || bestMatchName->size() > ss->name.size()) {
+				if (!gotMatch || !gotStartMatch || bestMatchName.size() > name.size()) {
 
 					// don't already have one or its shorter than the previous
 					// one, take it
 					bestMatch = (*i).first;
 					bestMatch.systemIndex = systemIndex;
-					bestMatchName = &(ss->name);
+					bestMatchName = name;
 					gotMatch = gotStartMatch = true;
 				}
 
@@ -344,22 +360,22 @@ void SectorView::OnSearchBoxKeyPress(const SDL_keysym *keysym)
 			}
 
 			// look for the search term somewhere within the current system
-			if (pi_strcasestr(ss->name.c_str(), search.c_str())) {
+			if (pi_strcasestr(name.c_str(), search.c_str())) {
 
 				// found it
-				if (!gotMatch || !gotStartMatch || bestMatchName->size() > ss->name.size()) {
+				if (!gotMatch || !gotStartMatch || bestMatchName.size() > name.size()) {
 
 					// best we've found so far, take it
 					bestMatch = (*i).first;
 					bestMatch.systemIndex = systemIndex;
-					bestMatchName = &(ss->name);
+					bestMatchName = name;
 					gotMatch = true;
 				}
 			}
 		}
 
 	if (gotMatch) {
-		Pi::cpan->MsgLog()->Message("", stringf(Lang::NOT_FOUND_BEST_MATCH_X, formatarg("system", *bestMatchName)));
+		Pi::cpan->MsgLog()->Message("", stringf(Lang::NOT_FOUND_BEST_MATCH_X, formatarg("system", bestMatchName)));
 		GotoSystem(bestMatch);
 	}
 
@@ -498,7 +514,7 @@ void SectorView::OnClickSystem(const SystemPath &path)
 		SetSelectedSystem(path);
 }
 
-void SectorView::PutSystemLabels(Sector *sec, const vector3f &origin, int drawRadius)
+void SectorView::PutSystemLabels(Sector *sec, NearSector &nearSec, const vector3f &origin, int drawRadius)
 {
 	Uint32 sysIdx = 0;
 	for (std::vector<Sector::System>::iterator sys = sec->m_systems.begin(); sys !=sec->m_systems.end(); ++sys, ++sysIdx) {
@@ -514,9 +530,8 @@ void SectorView::PutSystemLabels(Sector *sec, const vector3f &origin, int drawRa
 		if (m_hiddenFactions.find((*sys).faction) != m_hiddenFactions.end() && can_skip) continue;
 
 		// determine if system in hyperjump range or not
-		Sector *playerSec = GetCached(m_current.sectorX, m_current.sectorY, m_current.sectorZ);
-		float dist = Sector::DistanceBetween(sec, sysIdx, playerSec, m_current.systemIndex);
-		bool inRange = dist <= m_playerHyperspaceRange;
+		NearSystem &nearSys = nearSec.systems[sysIdx];
+		bool inRange = nearSys.jumpDist <= m_playerHyperspaceRange;
 
 		// place the label
 		vector3d systemPos = vector3d((*sys).FullPosition() - origin);
@@ -527,7 +542,7 @@ void SectorView::PutSystemLabels(Sector *sec, const vector3f &origin, int drawRa
 				continue;
 			
 			// work out the colour
-			Color labelColor = (*sys).faction->AdjustedColour((*sys).population, inRange);
+			const Color &labelColor = GetLabelColor(*sys, nearSys, inRange);
 
 			// get a system path to pass to the event handler when the label is licked
 			SystemPath sysPath = SystemPath((*sys).sx, (*sys).sy, (*sys).sz, sysIdx);
@@ -535,7 +550,7 @@ void SectorView::PutSystemLabels(Sector *sec, const vector3f &origin, int drawRa
 			// label text
 			std::string text = "";
 			if(inRange || m_drawOutRangeLabelButton->GetPressed() || !can_skip)
-				text = (*sys).name;
+				text = nearSys.name;
 
 			// setup the label;
 			m_clickableLabels->Add(text, sigc::bind(sigc::mem_fun(this, &SectorView::OnClickSystem), sysPath), screenPos.x, screenPos.y, labelColor);
@@ -550,13 +565,14 @@ void SectorView::PutFactionLabels(const vector3f &origin)
 	for (std::set<Faction*>::iterator it = m_visibleFactions.begin(); it != m_visibleFactions.end(); ++it) {
 		if ((*it)->hasHomeworld && m_hiddenFactions.find((*it)) == m_hiddenFactions.end()) {
 
-			Sector::System sys = GetCached((*it)->homeworld)->m_systems[(*it)->homeworld.systemIndex];
+			const Sector *homeSec = GetCached((*it)->homeworld);
+			const Sector::System &sys = homeSec->m_systems[(*it)->homeworld.systemIndex];
 			if ((m_pos*Sector::SIZE - sys.FullPosition()).Length() > (m_zoomClamped/FAR_THRESHOLD )*OUTER_RADIUS) continue;
 
 			vector3d pos;
 			if (Gui::Screen::Project(vector3d(sys.FullPosition() - origin), pos)) {
 
-				std::string labelText    = sys.name + "\n" + (*it)->name;
+				std::string labelText    = homeSec->GetSystemName((*it)->homeworld.systemIndex) + "\n" + (*it)->name;
 				Color       labelColor  = (*it)->colour;
 				float       labelHeight = 0;
 				float       labelWidth  = 0;
@@ -595,6 +611,13 @@ void SectorView::PutFactionLabels(const vector3f &origin)
 
 void SectorView::UpdateSystemLabels(SystemLabels &labels, const SystemPath &path)
 {
+	// filling these in means generating the whole system, and they can only
+	// be seen in this view. OnSwitchTo fills them all in again, so until then
+	// there's nothing to do. that keeps a loaded game's selection and
+	// hyperspace target from being generated before anyone looks at them
+	if (Pi::GetView() != this)
+		return;
+
 	Sector *sec = GetCached(path.sectorX, path.sectorY, path.sectorZ);
 	Sector *playerSec = GetCached(m_current.sectorX, m_current.sectorY, m_current.sectorZ);
 
@@ -722,6 +745,14 @@ void SectorView::DrawNearSectors(const matrix4x4f& modelview)
 {
 	m_visibleFactions.clear();
 
+	// the near view still builds its sectors on the spot, but they're
+	// usually ready by the time we scroll into them
+	const vector3f secOrigin = vector3f(int(floorf(m_pos.x)), int(floorf(m_pos.y)), int(floorf(m_pos.z)));
+	if (!secOrigin.ExactlyEqual(m_secPosNear)) {
+		PrefetchSectors(secOrigin, secOrigin - m_secPosNear, DRAW_RAD, false);
+		m_secPosNear = secOrigin;
+	}
+
 	const Sector *playerSec = GetCached(m_current.sectorX, m_current.sectorY, m_current.sectorZ);
 	const vector3f playerPos = Sector::SIZE * vector3f(float(m_current.sectorX), float(m_current.sectorY), float(m_current.sectorZ)) + playerSec->m_systems[m_current.systemIndex].p;
 
@@ -735,25 +766,80 @@ void SectorView::DrawNearSectors(const matrix4x4f& modelview)
 	}
 
 	// ...then switch and do all the labels
-	const vector3f secOrigin = vector3f(int(floorf(m_pos.x)), int(floorf(m_pos.y)), int(floorf(m_pos.z)));
-	
 	m_renderer->SetTransform(modelview);
 	glDepthRange(0,1);
 	Gui::Screen::EnterOrtho();
 	for (int sx = -DRAW_RAD; sx <= DRAW_RAD; sx++) {
 		for (int sy = -DRAW_RAD; sy <= DRAW_RAD; sy++) {
 			for (int sz = -DRAW_RAD; sz <= DRAW_RAD; sz++) {
-				PutSystemLabels(GetCached(sx + secOrigin.x, sy + secOrigin.y, sz + secOrigin.z), Sector::SIZE * secOrigin, Sector::SIZE * DRAW_RAD);
+				const int x = sx + secOrigin.x, y = sy + secOrigin.y, z = sz + secOrigin.z;
+				Sector *sec = GetCached(x, y, z);
+				PutSystemLabels(sec, GetNearSector(sec, x, y, z), Sector::SIZE * secOrigin, Sector::SIZE * DRAW_RAD);
 			}
 		}
 	}
 	Gui::Screen::LeaveOrtho();
+
+	PutRoute(secOrigin, modelview);
+}
+
+void SectorView::PutRoute(const vector3f &secOrigin, const matrix4x4f &modelview)
+{
+	if (m_route.systems.size() <= 2) return;
+
+	const Color light(0.8f, 0.6f, 0.f, 1.f);
+	for (size_t i = 1; i < m_route.systems.size(); i++) {
+		const SystemPath &a = m_route.systems[i-1];
+		const SystemPath &b = m_route.systems[i];
+		const vector3f posA = Sector::SIZE * (vector3f(float(a.sectorX), float(a.sectorY), float(a.sectorZ)) - secOrigin) + m_route.positions[i-1];
+		const vector3f posB = Sector::SIZE * (vector3f(float(b.sectorX), float(b.sectorY), float(b.sectorZ)) - secOrigin) + m_route.positions[i];
+		m_lineVerts->Add(modelview * posA, light);
+		m_lineVerts->Add(modelview * posB, light);
+	}
+}
+
+SectorView::NearSector &SectorView::GetNearSector(Sector *sec, int sx, int sy, int sz)
+{
+	NearSector &nearSec = m_nearSectors[SystemPath(sx, sy, sz)];
+	if (nearSec.current == m_current && nearSec.systems.size() == sec->m_systems.size())
+		return nearSec;
+
+	nearSec.current = m_current;
+	nearSec.systems.resize(sec->m_systems.size());
+
+	Sector *playerSec = GetCached(m_current.sectorX, m_current.sectorY, m_current.sectorZ);
+	for (Uint32 sysIdx = 0; sysIdx < sec->m_systems.size(); sysIdx++) {
+		const Sector::System &sys = sec->m_systems[sysIdx];
+		NearSystem &n = nearSec.systems[sysIdx];
+		n.jumpDist = Sector::DistanceBetween(sec, sysIdx, playerSec, m_current.systemIndex);
+		const float *col = StarSystem::starColors[sys.starType[0]];
+		n.starColor = Color(col[0], col[1], col[2]);
+		n.starScale = StarSystem::starScale[sys.starType[0]];
+		n.name = sec->GetSystemName(sysIdx);
+		n.labelPop = sys.population;
+		n.labelColor[0] = sys.faction->AdjustedColour(sys.population, false);
+		n.labelColor[1] = sys.faction->AdjustedColour(sys.population, true);
+	}
+
+	return nearSec;
+}
+
+// the population is filled in as systems are looked at, so check it's the same
+const Color &SectorView::GetLabelColor(const Sector::System &sys, NearSystem &nearSys, bool inRange)
+{
+	if (nearSys.labelPop != sys.population) {
+		nearSys.labelPop = sys.population;
+		nearSys.labelColor[0] = sys.faction->AdjustedColour(sys.population, false);
+		nearSys.labelColor[1] = sys.faction->AdjustedColour(sys.population, true);
+	}
+	return nearSys.labelColor[inRange ? 1 : 0];
 }
 
 void SectorView::DrawNearSector(const int sx, const int sy, const int sz, const vector3f &playerAbsPos,const matrix4x4f &trans)
 {
 	m_renderer->SetTransform(trans);
 	Sector* ps = GetCached(sx, sy, sz);
+	NearSector &nearSec = GetNearSector(ps, sx, sy, sz);
 
 	int cz = int(floor(m_pos.z+0.5f));
 
@@ -798,9 +884,8 @@ void SectorView::DrawNearSector(const int sx, const int sy, const int sz, const
 		if (m_hiddenFactions.find(i->faction) != m_hiddenFactions.end() && can_skip) continue;
 
 		// determine if system in hyperjump range or not
-		Sector *playerSec = GetCached(m_current.sectorX, m_current.sectorY, m_current.sectorZ);
-		float dist = Sector::DistanceBetween(ps, sysIdx, playerSec, m_current.systemIndex);
-		bool inRange = dist <= m_playerHyperspaceRange;
+		const NearSystem &nearSys = nearSec.systems[sysIdx];
+		bool inRange = nearSys.jumpDist <= m_playerHyperspaceRange;
 
 		// don't worry about looking for inhabited systems if they're
 		// unexplored (same calculation as in StarSystem.cpp) or we've
@@ -815,9 +900,11 @@ void SectorView::DrawNearSector(const int sx, const int sy, const int sz, const
 
 			// Ideally, since this takes so f'ing long, it wants to be done as a threaded job but haven't written that yet.
 			if( (diff.x < 0.001f && diff.y < 0.001f && diff.z < 0.001f) ) {
+				// the summary knows unexplored systems are empty without
+				// generating them, and remembers the rest after the
+				// StarSystem cache lets them go
 				SystemPath current = SystemPath(sx, sy, sz, sysIdx);
-				RefCountedPtr<StarSystem> pSS = StarSystem::GetCached(current);
-				(*i).population = pSS->GetTotalPop();
+				(*i).population = StarSystem::GetSummary(current).GetTotalPop();
 			}
 
 		}
@@ -858,11 +945,10 @@ void SectorView::DrawNearSector(const int sx, const int sy, const int sz, const
 		// draw star blob itself
 		systrans.Rotate(DEG2RAD(-m_rotZ), 0, 0, 1);
 		systrans.Rotate(DEG2RAD(-m_rotX), 1, 0, 0);
-		systrans.Scale((StarSystem::starScale[(*i).starType[0]]));
+		systrans.Scale(nearSys.starScale);
 		m_renderer->SetTransform(systrans);
 
-		float *col = StarSystem::starColors[(*i).starType[0]];
-		m_disk->SetColor(Color(col[0], col[1], col[2]));
+		m_disk->SetColor(nearSys.starColor);
 		m_disk->Draw(m_renderer);
 
 		// player location indicator
@@ -904,6 +990,12 @@ void SectorView::DrawNearSector(const int sx, const int sy, const int sz, const
 	}
 }
 
+// which chunk a sector is in, along one axis
+static inline int far_chunk_coord(int s)
+{
+	return s >= 0 ? s / FAR_CHUNK_SECTORS : -((-s - 1) / FAR_CHUNK_SECTORS) - 1;
+}
+
 void SectorView::DrawFarSectors(const matrix4x4f& modelview)
 {
 	int buildRadius = ceilf((m_zoomClamped/FAR_THRESHOLD) * 3);
@@ -911,55 +1003,224 @@ void SectorView::DrawFarSectors(const matrix4x4f& modelview)
 
 	const vector3f secOrigin = vector3f(int(floorf(m_pos.x)), int(floorf(m_pos.y)), int(floorf(m_pos.z)));
 
-	// build vertex and colour arrays for all the stars we want to see, if we don't already have them
-	if (m_toggledFaction || buildRadius != m_radiusFar || !secOrigin.ExactlyEqual(m_secPosFar)) {
-		m_farstars       .clear();
-		m_farstarsColor  .clear();
-		m_visibleFactions.clear();
+	// a faction was hidden or shown, so every chunk is out of date
+	if (m_toggledFaction) {
+		m_farSectors.clear();
+		m_farChunks.clear();
+	}
 
-		for (int sx = secOrigin.x-buildRadius; sx <= secOrigin.x+buildRadius; sx++) {
-			for (int sy = secOrigin.y-buildRadius; sy <= secOrigin.y+buildRadius; sy++) {
-				for (int sz = secOrigin.z-buildRadius; sz <= secOrigin.z+buildRadius; sz++) {
-						if ((vector3f(sx,sy,sz) - secOrigin).Length() <= buildRadius){
-							BuildFarSector(GetCached(sx, sy, sz), Sector::SIZE * secOrigin, m_farstars, m_farstarsColor);
-						}
-					}
+	// work out which chunks to draw, building the ones we don't already have
+	// or that are missing sectors that have come in since
+	if (m_toggledFaction || buildRadius != m_radiusFar || !secOrigin.ExactlyEqual(m_secPosFar) || (m_farSectorsMissing && m_newSectorsReady)) {
+		if (buildRadius != m_radiusFar || !secOrigin.ExactlyEqual(m_secPosFar))
+			PrefetchSectors(secOrigin, secOrigin - m_secPosFar, buildRadius, buildRadius > m_radiusFar);
+
+		m_farChunkDraws  .clear();
+		m_visibleFactions.clear();
+		m_farSectorsMissing = false;
+		m_newSectorsReady   = false;
+
+		const int cxmin = far_chunk_coord(int(secOrigin.x) - buildRadius), cxmax = far_chunk_coord(int(secOrigin.x) + buildRadius);
+		const int cymin = far_chunk_coord(int(secOrigin.y) - buildRadius), cymax = far_chunk_coord(int(secOrigin.y) + buildRadius);
+		const int czmin = far_chunk_coord(int(secOrigin.z) - buildRadius), czmax = far_chunk_coord(int(secOrigin.z) + buildRadius);
+
+		for (int cx = cxmin; cx <= cxmax; cx++) {
+			for (int cy = cymin; cy <= cymax; cy++) {
+				for (int cz = czmin; cz <= czmax; cz++) {
+					const SystemPath loc(cx, cy, cz);
+					FarChunk &chunk = m_farChunks[loc];
+					const bool stale = !chunk.complete || (chunk.clipped && (chunk.clipRadius != buildRadius || !chunk.clipOrigin.ExactlyEqual(secOrigin)));
+					if (stale)
+						BuildFarChunk(loc, chunk, secOrigin, buildRadius);
+					if (!chunk.complete)
+						m_farSectorsMissing = true;
+
+					m_visibleFactions.insert(chunk.factions.begin(), chunk.factions.end());
+					if (!chunk.lodCount[0]) continue;
+
+					// coarser detail the further the chunk is from the middle
+					const vector3f corner = float(FAR_CHUNK_SECTORS) * vector3f(float(cx), float(cy), float(cz));
+					const vector3f centre = corner + vector3f(0.5f * float(FAR_CHUNK_SECTORS - 1));
+					const float dist = (centre - secOrigin).Length();
+					int level = 0;
+					while (level < FAR_LOD_LEVELS-1 && dist >= FAR_LOD_DIST * float(1 << level))
+						level++;
+
+					FarChunkDraw draw;
+					draw.loc    = loc;
+					draw.offset = Sector::SIZE * (corner - secOrigin);
+					draw.level  = level;
+					m_farChunkDraws.push_back(draw);
 				}
 			}
+		}
 
 		m_secPosFar      = secOrigin;
 		m_radiusFar      = buildRadius;
 		m_toggledFaction = false;
 	}
 
+	if (!m_farMaterial) {
+		Graphics::MaterialDescriptor desc;
+		desc.vertexColors = true;
+		m_farMaterial.Reset(m_renderer->CreateMaterial(desc));
+	}
+
 	// always draw the stars, slightly altering their size for different different resolutions, so they still look okay
+	const float pointSize = 1.f + (Graphics::GetScreenHeight() / 720.f);
+	for (std::vector<FarChunkDraw>::const_iterator i = m_farChunkDraws.begin(); i != m_farChunkDraws.end(); ++i) {
+		// ShrinkCache may have let it go since
+		std::map<SystemPath,FarChunk>::const_iterator found = m_farChunks.find(i->loc);
+		if (found == m_farChunks.end()) continue;
+
+		const FarChunk &chunk = found->second;
+		const unsigned int count = chunk.lodCount[i->level];
+		if (!count) continue;
+
+		m_renderer->SetTransform(modelview * matrix4x4f::Translation(i->offset));
+		if (chunk.buffer.Valid()) {
+			chunk.buffer->SetVertexCount(count);
+			m_renderer->DrawBufferPoints(chunk.buffer.Get(), m_farMaterial.Get(), pointSize);
+		} else
+			m_renderer->DrawPoints(count, &chunk.points[0], &chunk.colors[0], pointSize);
+	}
+	m_renderer->SetTransform(modelview);
+
+	// the chunks leave out hidden factions, so add the systems we always show
+	m_farstars     .clear();
+	m_farstarsColor.clear();
+	AddHiddenFarSystem(m_current, secOrigin, buildRadius);
+	AddHiddenFarSystem(m_selected, secOrigin, buildRadius);
+	AddHiddenFarSystem(m_hyperspaceTarget, secOrigin, buildRadius);
 	if (m_farstars.size() > 0)
-		m_renderer->DrawPoints(m_farstars.size(), &m_farstars[0], &m_farstarsColor[0], 1.f + (Graphics::GetScreenHeight() / 720.f));
+		m_renderer->DrawPoints(m_farstars.size(), &m_farstars[0], &m_farstarsColor[0], pointSize);
 
 	// also add labels for any faction homeworlds among the systems we've drawn
 	PutFactionLabels(Sector::SIZE * secOrigin);
 }
 
-void SectorView::BuildFarSector(Sector* sec, const vector3f &origin, std::vector<vector3f> &points, std::vector<Color> &colors)
+const SectorView::FarSector *SectorView::GetFarSector(int sx, int sy, int sz, float priority)
 {
-	Color starColor;
-	for (std::vector<Sector::System>::iterator i = sec->m_systems.begin(); i != sec->m_systems.end(); ++i) {
-		// skip the system if it doesn't fall within the sphere we're viewing.
-		if ((m_pos*Sector::SIZE - (*i).FullPosition()).Length() > (m_zoomClamped/FAR_THRESHOLD )*OUTER_RADIUS) continue;
+	const SystemPath loc(sx, sy, sz);
+	std::map<SystemPath,FarSector>::const_iterator i = m_farSectors.find(loc);
+	if (i != m_farSectors.end())
+		return &i->second;
+
+	Sector *sec = GetCachedIfReady(sx, sy, sz, priority);
+	if (!sec) return 0;
+
+	FarSector &farSec = m_farSectors[loc];
+	for (std::vector<Sector::System>::const_iterator sys = sec->m_systems.begin(); sys != sec->m_systems.end(); ++sys) {
+		// if the system belongs to a faction we've chosen to hide skip it
+		farSec.factions.insert(sys->faction);
+		if (m_hiddenFactions.find(sys->faction) != m_hiddenFactions.end()) continue;
+
+		// a system is in every level up to the number of times two goes
+		// into its index, so each level has about half the stars of the
+		// one before
+		int level = 0;
+		while (level < FAR_LOD_LEVELS-1 && !(sys->idx & (1 << level)))
+			level++;
+
+		Color starColor = sys->faction->colour;
+		starColor.a = .75f;
+		farSec.points[level].push_back(sys->p);
+		farSec.colors[level].push_back(starColor);
+	}
+	return &farSec;
+}
 
-		// if the system belongs to a faction we've chosen to hide also skip it, if it's not selectd in some way
-		m_visibleFactions.insert(i->faction);
-		if (m_hiddenFactions.find(i->faction) != m_hiddenFactions.end()
-			&& !i->IsSameSystem(m_selected) && !i->IsSameSystem(m_hyperspaceTarget) && !i->IsSameSystem(m_current)) continue;
+void SectorView::BuildFarChunk(const SystemPath &loc, FarChunk &chunk, const vector3f &secOrigin, int radius)
+{
+	const int x0 = loc.sectorX * FAR_CHUNK_SECTORS;
+	const int y0 = loc.sectorY * FAR_CHUNK_SECTORS;
+	const int z0 = loc.sectorZ * FAR_CHUNK_SECTORS;
+
+	chunk.factions.clear();
+	chunk.complete = true;
+	chunk.clipped  = false;
+
+	// the sectors in the radius
+	std::vector<std::pair<vector3f, const FarSector*> > sectors;
+	sectors.reserve(FAR_CHUNK_SECTORS * FAR_CHUNK_SECTORS * FAR_CHUNK_SECTORS);
+	for (int sx = x0; sx < x0 + FAR_CHUNK_SECTORS; sx++) {
+		for (int sy = y0; sy < y0 + FAR_CHUNK_SECTORS; sy++) {
+			for (int sz = z0; sz < z0 + FAR_CHUNK_SECTORS; sz++) {
+				const float dist = (vector3f(sx,sy,sz) - secOrigin).Length();
+				if (dist > radius) {
+					chunk.clipped = true;
+					continue;
+				}
 
-		// otherwise add the system's position (origin must be m_pos's *sector* or we get judder)
-		// and faction color to the list to draw
-		starColor = (*i).faction->colour;
-		starColor.a = .75f;
+				const FarSector *farSec = GetFarSector(sx, sy, sz, Job::PRIORITY_NORMAL - dist);
+				if (!farSec) {
+					chunk.complete = false;
+					continue;
+				}
+
+				chunk.factions.insert(farSec->factions.begin(), farSec->factions.end());
+				sectors.push_back(std::make_pair(Sector::SIZE * vector3f(float(sx - x0), float(sy - y0), float(sz - z0)), farSec));
+			}
+		}
+	}
 
-		points.push_back((*i).FullPosition() - origin);
-		colors.push_back(starColor);
+	chunk.clipOrigin = secOrigin;
+	chunk.clipRadius = radius;
+
+	// coarsest first, so every level is the start of the next
+	VertexArray va(ATTRIB_POSITION | ATTRIB_DIFFUSE);
+	for (int level = FAR_LOD_LEVELS-1; level >= 0; level--) {
+		for (std::vector<std::pair<vector3f, const FarSector*> >::const_iterator i = sectors.begin(); i != sectors.end(); ++i) {
+			const std::vector<vector3f> &points = i->second->points[level];
+			for (std::vector<vector3f>::const_iterator p = points.begin(); p != points.end(); ++p)
+				va.position.push_back(*p + i->first);
+			va.diffuse.insert(va.diffuse.end(), i->second->colors[level].begin(), i->second->colors[level].end());
+		}
+		chunk.lodCount[level] = va.GetNumVerts();
 	}
+
+	chunk.points.clear();
+	chunk.colors.clear();
+	if (!va.GetNumVerts()) {
+		if (chunk.buffer.Valid())
+			chunk.buffer->SetVertexCount(0);
+		return;
+	}
+
+	// edge chunks get rebuilt as the view moves, so they keep their buffer
+	// for as long as the stars fit
+	if (chunk.buffer.Valid() && chunk.buffer->Populate(va))
+		return;
+
+	Graphics::VertexBufferDesc desc;
+	desc.attribs = ATTRIB_POSITION | ATTRIB_DIFFUSE;
+	desc.numVertices = va.GetNumVerts();
+	desc.usage = chunk.clipped ? BUFFER_USAGE_DYNAMIC : BUFFER_USAGE_STATIC;
+	chunk.buffer.Reset(m_renderer->CreateVertexBuffer(desc));
+	if (chunk.buffer.Valid() && chunk.buffer->Populate(va)) return;
+
+	// no buffers, the points are sent over when they're drawn
+	chunk.buffer.Reset();
+	chunk.points.swap(va.position);
+	chunk.colors.swap(va.diffuse);
+}
+
+// origin must be m_pos's *sector* or we get judder
+void SectorView::AddHiddenFarSystem(const SystemPath &path, const vector3f &secOrigin, int radius)
+{
+	if (!path.HasValidSystem()) return;
+	if ((vector3f(path.sectorX, path.sectorY, path.sectorZ) - secOrigin).Length() > radius) return;
+
+	std::map<SystemPath,RefCountedPtr<Sector> >::const_iterator i = m_sectorCache.find(path.SectorOnly());
+	if (i == m_sectorCache.end() || path.systemIndex >= i->second->m_systems.size()) return;
+
+	const Sector::System &sys = i->second->m_systems[path.systemIndex];
+	if (m_hiddenFactions.find(sys.faction) == m_hiddenFactions.end()) return;
+
+	Color starColor = sys.faction->colour;
+	starColor.a = .75f;
+	m_farstars.push_back(sys.FullPosition() - Sector::SIZE * secOrigin);
+	m_farstarsColor.push_back(starColor);
 }
 
 void SectorView::OnSwitchTo() {
@@ -969,6 +1230,7 @@ void SectorView::OnSwitchTo() {
 
 	Update();
 
+	UpdateSystemLabels(m_currentSystemLabels, m_current);
 	UpdateSystemLabels(m_selectedSystemLabels, m_selected);
 	UpdateSystemLabels(m_targetSystemLabels, m_hyperspaceTarget);
 }
@@ -1186,6 +1448,7 @@ void SectorView::Update()
 	ShrinkCache();
 
 	m_playerHyperspaceRange = Pi::player->GetStats().hyperspace_range;
+	UpdateRoute();
 
 	if(Graphics::AreShadersEnabled() && !m_jumpSphere.Valid())
 	{
@@ -1216,17 +1479,14 @@ void SectorView::MouseButtonDown(int button, int x, int y)
 
 Sector* SectorView::GetCached(const SystemPath& loc)
 {
-	Sector *s = 0;
-
-	std::map<SystemPath,Sector*>::iterator i = m_sectorCache.find(loc);
+	std::map<SystemPath,RefCountedPtr<Sector> >::iterator i = m_sectorCache.find(loc);
 	if (i != m_sectorCache.end())
-		return (*i).second;
+		return (*i).second.Get();
 
-	s = new Sector(loc.sectorX, loc.sectorY, loc.sectorZ);
-	m_sectorCache.insert( std::pair<SystemPath,Sector*>(loc, s) );
-	s->AssignFactions();
+	RefCountedPtr<Sector> s = Sector::GetCached(loc);
+	m_sectorCache.insert( std::make_pair(loc, s) );
 
-	return s;
+	return s.Get();
 }
 
 Sector* SectorView::GetCached(const int sectorX, const int sectorY, const int sectorZ)
@@ -1235,6 +1495,130 @@ Sector* SectorView::GetCached(const int sectorX, const int sectorY, const int se
 	return GetCached(loc);
 }
 
+void SectorView::UpdateRoute()
+{
+	// the current system is only a place to start from while we're in it
+	const bool wanted = m_inSystem && m_playerHyperspaceRange > 0.0f && !m_hyperspaceTarget.IsSameSystem(m_current);
+
+	if (wanted && m_hyperspaceTarget.IsSameSystem(m_routeTo) && m_current.IsSameSystem(m_routeFrom) && is_equal_exact(m_playerHyperspaceRange, m_routeRange))
+		return;
+
+	RoutePlanner::Cancel(m_routePlan);
+	m_routePlan = 0;
+	m_route = RoutePlanner::Route();
+	m_routeFrom = m_routeTo = SystemPath();
+	m_routeRange = 0.0f;
+
+	if (!wanted) return;
+
+	m_routeFrom = m_current;
+	m_routeTo = m_hyperspaceTarget;
+	m_routeRange = m_playerHyperspaceRange;
+	m_routePlan = RoutePlanner::Plan(m_current, m_hyperspaceTarget, m_playerHyperspaceRange, RoutePlanner::FEWEST_JUMPS,
+		sigc::mem_fun(this, &SectorView::OnRoutePlanned));
+}
+
+void SectorView::OnRoutePlanned(const RoutePlanner::Route &route)
+{
+	m_routePlan = 0;
+	m_route = route;
+}
+
+// generates one sector from a worker. faction assignment only reads the
+// faction tables once they're built, so it can be done here too
+class SectorView::SectorJob : public Job {
+public:
+	SectorJob(SectorView *view, const SystemPath &loc) : m_view(view), m_loc(loc), m_sector(0) {}
+	virtual ~SectorJob() { delete m_sector; }
+	virtual const char *GetName() const { return "SectorView::SectorJob"; }
+
+	virtual void OnRun() {
+		m_sector = new Sector(m_loc.sectorX, m_loc.sectorY, m_loc.sectorZ);
+		m_sector->AssignFactions();
+	}
+
+	virtual void OnFinish() {
+		m_view->OnSectorGenerated(m_loc, m_sector);
+		m_sector = 0;
+	}
+
+private:
+	SectorView *m_view;
+	SystemPath m_loc;
+	Sector *m_sector;
+};
+
+Sector* SectorView::GetCachedIfReady(const int sectorX, const int sectorY, const int sectorZ, float priority)
+{
+	const SystemPath loc(sectorX, sectorY, sectorZ);
+
+	std::map<SystemPath,RefCountedPtr<Sector> >::iterator i = m_sectorCache.find(loc);
+	if (i != m_sectorCache.end())
+		return (*i).second.Get();
+
+	RefCountedPtr<Sector> s = Sector::FindCached(sectorX, sectorY, sectorZ);
+	if (s) {
+		m_sectorCache.insert( std::make_pair(loc, s) );
+		return s.Get();
+	}
+
+	RequestSector(loc, priority);
+	return 0;
+}
+
+void SectorView::RequestSector(const SystemPath &loc, float priority)
+{
+	if (m_pendingSectors.count(loc)) return;
+	m_pendingSectors.insert(loc);
+
+	SectorJob *job = new SectorJob(this, loc);
+	job->SetPriority(priority);
+	job->SetGroup(m_jobGroup);
+	Pi::Jobs()->Queue(job);
+}
+
+void SectorView::OnSectorGenerated(const SystemPath &loc, Sector *sec)
+{
+	m_pendingSectors.erase(loc);
+
+	// hold on to it if it's in the box we're drawing. anything else was
+	// generated ahead of us and waits in the shared cache
+	RefCountedPtr<Sector> s = Sector::AddToCache(sec);
+	if (s->WithinBox(m_cacheXMin, m_cacheXMax, m_cacheYMin, m_cacheYMax, m_cacheZMin, m_cacheZMax))
+		m_sectorCache.insert( std::make_pair(loc, s) );
+
+	m_newSectorsReady = true;
+}
+
+// queue up the sectors just beyond radius that are about to come into view:
+// the side of the shell we're heading towards when moving, all of it when
+// zooming out. a jump across the map isn't travel, so that's skipped
+void SectorView::PrefetchSectors(const vector3f &secOrigin, const vector3f &travel, int radius, bool zoomingOut)
+{
+	const float travelLen = travel.Length();
+	const bool moving = travelLen > 0.f && travelLen <= float(radius);
+	if (!moving && !zoomingOut) return;
+
+	const vector3f dir = moving ? travel / travelLen : vector3f(0.f);
+	const float outer = float(radius) + PREFETCH_DEPTH;
+	const int r = int(ceilf(outer));
+
+	for (int sx = -r; sx <= r; sx++) {
+		for (int sy = -r; sy <= r; sy++) {
+			for (int sz = -r; sz <= r; sz++) {
+				const vector3f d = vector3f(float(sx), float(sy), float(sz));
+				const float dist = d.Length();
+				if (dist <= float(radius) || dist > outer) continue;
+				if (!zoomingOut && d.Dot(dir) <= 0.f) continue;
+
+				const SystemPath loc(int(secOrigin.x) + sx, int(secOrigin.y) + sy, int(secOrigin.z) + sz);
+				if (m_sectorCache.count(loc) || Sector::FindCached(loc.sectorX, loc.sectorY, loc.sectorZ)) continue;
+				RequestSector(loc, Job::PRIORITY_LOW - dist);
+			}
+		}
+	}
+}
+
 void SectorView::ShrinkCache()
 {
 	// we're going to use these to determine if our sectors are within the range that we'll ever render
@@ -1252,18 +1636,44 @@ void SectorView::ShrinkCache()
 	if  (xmin != m_cacheXMin || xmax != m_cacheXMax
 	  || ymin != m_cacheYMin || ymax != m_cacheYMax
 	  || zmin != m_cacheZMin || zmax != m_cacheZMax) {
-		std::map<SystemPath,Sector*>::iterator iter = m_sectorCache.begin();
+		std::map<SystemPath,RefCountedPtr<Sector> >::iterator iter = m_sectorCache.begin();
 		while (iter != m_sectorCache.end())	{
-			Sector *s = (*iter).second;
+			Sector *s = (*iter).second.Get();
 			//check_point_in_box
 			if (s && !s->WithinBox( xmin, xmax, ymin, ymax, zmin, zmax )) {
-				delete s;
 				m_sectorCache.erase( iter++ );
 			} else {
 				iter++;
 			}
 		}
 
+		// the near and far views' sectors and chunks go with them
+		std::map<SystemPath,NearSector>::iterator nearSec = m_nearSectors.begin();
+		while (nearSec != m_nearSectors.end()) {
+			const SystemPath &c = nearSec->first;
+			if (c.sectorX < xmin || c.sectorX > xmax || c.sectorY < ymin || c.sectorY > ymax || c.sectorZ < zmin || c.sectorZ > zmax)
+				m_nearSectors.erase(nearSec++);
+			else
+				++nearSec;
+		}
+		std::map<SystemPath,FarSector>::iterator farSec = m_farSectors.begin();
+		while (farSec != m_farSectors.end()) {
+			const SystemPath &c = farSec->first;
+			if (c.sectorX < xmin || c.sectorX > xmax || c.sectorY < ymin || c.sectorY > ymax || c.sectorZ < zmin || c.sectorZ > zmax)
+				m_farSectors.erase(farSec++);
+			else
+				++farSec;
+		}
+		std::map<SystemPath,FarChunk>::iterator chunk = m_farChunks.begin();
+		while (chunk != m_farChunks.end()) {
+			const SystemPath &c = chunk->first;
+			if (c.sectorX*FAR_CHUNK_SECTORS > xmax || (c.sectorX+1)*FAR_CHUNK_SECTORS <= xmin
+			 || c.sectorY*FAR_CHUNK_SECTORS > ymax || (c.sectorY+1)*FAR_CHUNK_SECTORS <= ymin
+			 || c.sectorZ*FAR_CHUNK_SECTORS > zmax || (c.sectorZ+1)*FAR_CHUNK_SECTORS <= zmin)
+				m_farChunks.erase(chunk++);
+			else
+				++chunk;
+		}
 		m_cacheXMin = xmin;
 		m_cacheXMax = xmax;
 		m_cacheYMin = ymin;
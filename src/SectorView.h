@@ -11,9 +11,11 @@
 #include <set>
 #include <string>
 #include "View.h"
+#include "galaxy/RoutePlanner.h"
 #include "galaxy/Sector.h"
 #include "galaxy/SystemPath.h"
 #include "graphics/Drawables.h"
+#include "graphics/VertexBuffer.h"
 
 class SectorView: public View {
 public:
@@ -52,12 +54,62 @@ private:
 		Gui::Label *shortDesc;
 	};
 
+	// what the near view draws for a system that only changes when the
+	// current system does, worked out when its sector comes near
+	struct NearSystem {
+		float jumpDist; // from the current system
+		Color starColor;
+		float starScale;
+		std::string name;
+		// for the population it was last worked out for, out of range and in range
+		fixed labelPop;
+		Color labelColor[2];
+	};
+	struct NearSector {
+		SystemPath current;
+		std::vector<NearSystem> systems;
+	};
+
+	NearSector &GetNearSector(Sector *sec, int sx, int sy, int sz);
+	const Color &GetLabelColor(const Sector::System &sys, NearSystem &nearSys, bool inRange);
 	void DrawNearSectors(const matrix4x4f& modelview);
 	void DrawNearSector(const int sx, const int sy, const int sz, const vector3f &playerAbsPos, const matrix4x4f &trans);
-	void PutSystemLabels(Sector *sec, const vector3f &origin, int drawRadius);
+	void PutSystemLabels(Sector *sec, NearSector &nearSec, const vector3f &origin, int drawRadius);
+
+	// the far view keeps the stars in chunks of sectors, each in a buffer of
+	// its own. a chunk's stars are ordered so that the first lodCount[n] of
+	// them make up detail level n, which is drawn for chunks further away
+	enum { FAR_LOD_LEVELS = 3 };
+	// a sector's stars by level, where they are in the sector
+	struct FarSector {
+		std::vector<vector3f> points[FAR_LOD_LEVELS];
+		std::vector<Color> colors[FAR_LOD_LEVELS];
+		std::set<Faction*> factions;
+	};
+	struct FarChunk {
+		FarChunk() : complete(false), clipped(false), clipRadius(0) {}
+		RefCountedPtr<Graphics::VertexBuffer> buffer;
+		std::vector<vector3f> points; // only if there's no buffer
+		std::vector<Color> colors;
+		unsigned int lodCount[FAR_LOD_LEVELS];
+		std::set<Faction*> factions;
+		bool complete; // none of its sectors were missing
+		// sectors outside the radius were left out, so it's only any good
+		// for the same origin and radius
+		bool clipped;
+		vector3f clipOrigin;
+		int clipRadius;
+	};
+	struct FarChunkDraw {
+		SystemPath loc;
+		vector3f offset;
+		int level;
+	};
 
 	void DrawFarSectors(const matrix4x4f& modelview);
-	void BuildFarSector(Sector *sec, const vector3f &origin, std::vector<vector3f> &points, std::vector<Color> &colors);
+	const FarSector *GetFarSector(int sx, int sy, int sz, float priority);
+	void BuildFarChunk(const SystemPath &loc, FarChunk &chunk, const vector3f &secOrigin, int radius);
+	void AddHiddenFarSystem(const SystemPath &path, const vector3f &secOrigin, int radius);
 	void PutFactionLabels(const vector3f &secPos);
 
 	void SetSelectedSystem(const SystemPath &path);
@@ -69,10 +121,24 @@ private:
 
 	void UpdateHyperspaceLockLabel();
 
+	// a target out of jump range gets a route planned to it, which is drawn
+	// jump by jump
+	void UpdateRoute();
+	void OnRoutePlanned(const RoutePlanner::Route &route);
+	void PutRoute(const vector3f &secOrigin, const matrix4x4f &modelview);
+
 	Sector* GetCached(const SystemPath& loc);
 	Sector* GetCached(const int sectorX, const int sectorY, const int sectorZ);
 	void ShrinkCache();
 
+	// the far view, and whatever we're about to scroll into, get their
+	// sectors generated on the job queue. the view draws what's ready
+	class SectorJob;
+	Sector* GetCachedIfReady(const int sectorX, const int sectorY, const int sectorZ, float priority);
+	void RequestSector(const SystemPath &loc, float priority);
+	void OnSectorGenerated(const SystemPath &loc, Sector *sec);
+	void PrefetchSectors(const vector3f &secOrigin, const vector3f &travel, int radius, bool zoomingOut);
+
 	void MouseButtonDown(int button, int x, int y);
 	void OnKeyPressed(SDL_keysym *keysym);
 	void OnSearchBoxKeyPress(const SDL_keysym *keysym);
@@ -134,20 +200,39 @@ private:
 	sigc::connection m_onMouseButtonDown;
 	sigc::connection m_onKeyPressConnection;
 
-	std::map<SystemPath,Sector*> m_sectorCache;
+	std::map<SystemPath,RefCountedPtr<Sector> > m_sectorCache; // what we're drawing, held from Sector's cache
+	std::set<SystemPath> m_pendingSectors;
+	Uint32 m_jobGroup;
+	bool m_newSectorsReady;
 	std::string m_previousSearch;
 
 	float m_playerHyperspaceRange;
 	Graphics::Drawables::Line3D m_jumpLine;
 
+	RoutePlanner::Route m_route;
+	SystemPath m_routeFrom;
+	SystemPath m_routeTo;
+	float m_routeRange;
+	Uint32 m_routePlan;
+
 	RefCountedPtr<Graphics::Material> m_material;
 
+	std::map<SystemPath,NearSector> m_nearSectors;
+	std::map<SystemPath,FarSector> m_farSectors;
+	std::map<SystemPath,FarChunk> m_farChunks; // by chunk coordinates
+	std::vector<FarChunkDraw> m_farChunkDraws;
+	RefCountedPtr<Graphics::Material> m_farMaterial;
+	// current, selected and target systems of hidden factions, which are
+	// drawn anyway
 	std::vector<vector3f> m_farstars;
 	std::vector<Color>    m_farstarsColor;
 
 	vector3f m_secPosFar;
 	int      m_radiusFar;
 	bool     m_toggledFaction;
+	bool     m_farSectorsMissing;
+
+	vector3f m_secPosNear;
 
 	int m_cacheXMin;
 	int m_cacheXMax;
@@ -8,10 +8,101 @@
 #include "Space.h"
 #include "Ship.h"
 #include "HyperspaceCloud.h"
+#include "FileSystem.h"
+#include "miniz/miniz.h"
 
 namespace Serializer {
 
-const std::string &Writer::GetData() { return m_str; }
+/*
+ * A compressed stream is this magic, then blocks of:
+ *
+ *   Uint32 raw size
+ *   Uint32 compressed size
+ *   the block, zlib compressed
+ *
+ * with sizes little endian. Each block is one Writer::Flush, so for a save
+ * each top level section starts a block and they can be inflated on their
+ * own. A block with a raw size of zero ends it.
+ */
+static const char s_compressedMagic[] = "PIOZ";
+static const size_t COMPRESSED_MAGIC_LEN = 4;
+
+static void put_uint32(std::string &out, Uint32 x)
+{
+	out.push_back(char(x&0xff));
+	out.push_back(char((x>>8)&0xff));
+	out.push_back(char((x>>16)&0xff));
+	out.push_back(char((x>>24)&0xff));
+}
+
+static Uint32 get_uint32(const char *p)
+{
+	const Uint8 *b = reinterpret_cast<const Uint8*>(p);
+	return (Uint32(b[3]) << 24) | (Uint32(b[2]) << 16) | (Uint32(b[1]) << 8) | Uint32(b[0]);
+}
+
+FileSink::FileSink(FILE *f, bool compress):
+	m_file(f),
+	m_compress(compress),
+	m_started(false),
+	m_failed(false)
+{
+}
+
+void FileSink::Write(const std::string &data)
+{
+	if (m_failed || data.empty()) return;
+
+	if (!m_compress) {
+		if (fwrite(data.data(), data.size(), 1, m_file) != 1)
+			m_failed = true;
+		return;
+	}
+
+	mz_ulong compressedSize = mz_compressBound(data.size());
+	std::vector<unsigned char> compressed(compressedSize);
+	if (mz_compress2(&compressed[0], &compressedSize, reinterpret_cast<const unsigned char*>(data.data()), data.size(), MZ_BEST_SPEED) != MZ_OK) {
+		m_failed = true;
+		return;
+	}
+
+	std::string out;
+	if (!m_started) {
+		out.append(s_compressedMagic, COMPRESSED_MAGIC_LEN);
+		m_started = true;
+	}
+	put_uint32(out, data.size());
+	put_uint32(out, compressedSize);
+	out.append(reinterpret_cast<const char*>(&compressed[0]), compressedSize);
+
+	if (fwrite(out.data(), out.size(), 1, m_file) != 1)
+		m_failed = true;
+}
+
+void FileSink::Finish()
+{
+	if (m_failed || !m_compress) return;
+
+	std::string out;
+	if (!m_started) {
+		out.append(s_compressedMagic, COMPRESSED_MAGIC_LEN);
+		m_started = true;
+	}
+	put_uint32(out, 0);
+	put_uint32(out, 0);
+
+	if (fwrite(out.data(), out.size(), 1, m_file) != 1)
+		m_failed = true;
+}
+
+const std::string &Writer::GetData() { assert(!m_sink); return m_str; }
+void Writer::Flush() {
+	assert(m_sink);
+	if (!m_str.empty()) {
+		m_sink->Write(m_str);
+		m_str.clear();
+	}
+}
 void Writer::Byte(Uint8 x) {
 	m_str.push_back(char(x));
 }
@@ -64,6 +155,10 @@ void Writer::Double(double f) {
 		Byte (p.c[i]);
 	}
 }
+void Writer::Doubles(const double *v, size_t n)
+{
+	m_str.append(reinterpret_cast<const char*>(v), n * sizeof(double));
+}
 /* First byte is string length, including null terminator */
 void Writer::String(const char* s)
 {
@@ -108,100 +203,161 @@ void Writer::WrQuaternionf(const Quaternionf &q)
 }
 
 
-Reader::Reader(): m_data(""), m_pos(0) {
+namespace {
+	// owns the bytes of a reader made from a string, or read off a FILE
+	class ReaderBuffer : public RefCounted {
+	public:
+		std::string data;
+	};
 }
-Reader::Reader(const std::string &data):
-	m_data(data),
-	m_pos(0) {
 
+Reader::Reader(): m_data(0), m_size(0), m_pos(0) {
+}
+Reader::Reader(const std::string &data): m_pos(0) {
+	ReaderBuffer *buf = new ReaderBuffer;
+	buf->data = data;
+	m_owner.Reset(buf);
+	m_data = buf->data.data();
+	m_size = buf->data.size();
 }
 Reader::Reader(FILE *fptr): m_pos(0) {
-	m_data = "";
-	while (!feof(fptr)) m_data.push_back(fgetc(fptr));
-	printf(SIZET_FMT " characters in savefile\n", m_data.size());
+	ReaderBuffer *buf = new ReaderBuffer;
+	m_owner.Reset(buf);
+
+	// size it up front if the stream can tell us, otherwise grow as we go
+	long start = ftell(fptr);
+	if (start >= 0 && fseek(fptr, 0, SEEK_END) == 0) {
+		long end = ftell(fptr);
+		fseek(fptr, start, SEEK_SET);
+		if (end > start) buf->data.reserve(size_t(end - start));
+	}
+
+	char chunk[65536];
+	size_t n;
+	while ((n = fread(chunk, 1, sizeof(chunk), fptr)) > 0)
+		buf->data.append(chunk, n);
+
+	m_data = buf->data.data();
+	m_size = buf->data.size();
+	printf(SIZET_FMT " characters in savefile\n", m_size);
+}
+Reader::Reader(const RefCountedPtr<FileSystem::FileData> &file, size_t offset):
+	m_owner(file.Get()),
+	m_data(file->GetData() + std::min(offset, file->GetSize())),
+	m_size(file->GetSize() - std::min(offset, file->GetSize())),
+	m_pos(0) {
+
+	if (m_size >= COMPRESSED_MAGIC_LEN && memcmp(m_data, s_compressedMagic, COMPRESSED_MAGIC_LEN) == 0) {
+		ReaderBuffer *buf = new ReaderBuffer;
+		RefCountedPtr<RefCounted> owner(buf);
+
+		const char *p = m_data + COMPRESSED_MAGIC_LEN;
+		const char *end = m_data + m_size;
+		for (;;) {
+			if (end - p < 8) throw SavedGameCorruptException();
+			const Uint32 rawSize = get_uint32(p);
+			const Uint32 compressedSize = get_uint32(p+4);
+			p += 8;
+			if (rawSize == 0) break;
+			if (Uint32(end - p) < compressedSize) throw SavedGameCorruptException();
+
+			const size_t at = buf->data.size();
+			buf->data.resize(at + rawSize);
+			mz_ulong inflated = rawSize;
+			if (mz_uncompress(reinterpret_cast<unsigned char*>(&buf->data[at]), &inflated, reinterpret_cast<const unsigned char*>(p), compressedSize) != MZ_OK || inflated != rawSize)
+				throw SavedGameCorruptException();
+			p += compressedSize;
+		}
+
+		printf(SIZET_FMT " bytes compressed to " SIZET_FMT "\n", buf->data.size(), m_size);
+		m_owner = owner;
+		m_data = buf->data.data();
+		m_size = buf->data.size();
+	}
+
+	printf(SIZET_FMT " characters in savefile\n", m_size);
 }
-bool Reader::AtEnd() { return m_pos >= m_data.size(); }
+Reader::Reader(const RefCountedPtr<RefCounted> &owner, const char *data, size_t size):
+	m_owner(owner),
+	m_data(data),
+	m_size(size),
+	m_pos(0) {
+}
+bool Reader::AtEnd() { return m_pos >= m_size; }
 void Reader::Seek(int pos) { m_pos = pos; }
 Uint8 Reader::Byte() {
-#ifdef DEBUG
-	assert(m_pos < m_data.size());
-#endif /* DEBUG */
-	return Uint8(m_data[m_pos++]);
+	return *Take(1);
 }
 bool Reader::Bool() {
 	return Byte() != 0;
 }
 Uint16 Reader::Int16()
 {
-	int t1, t2;
-	t2 = Byte();
-	t1 = Byte();
-	return ((t1 << 8) | t2);
+	const Uint8 *p = Take(2);
+	return Uint16(p[0] | (p[1] << 8));
 }
 Uint32 Reader::Int32(void)
 {
-	int t1, t2, t3, t4;
-	t4 = Byte();
-	t3 = Byte();
-	t2 = Byte();
-	t1 = Byte();
-	return ((t1 << 24) | (t2 << 16) | (t3 << 8) | t4);
+	const Uint8 *p = Take(4);
+	return (Uint32(p[3]) << 24) | (Uint32(p[2]) << 16) | (Uint32(p[1]) << 8) | Uint32(p[0]);
 }
 Uint64 Reader::Int64(void)
 {
-	Uint64 t1, t2, t3, t4, t5, t6, t7, t8;
-	t8 = Byte();
-	t7 = Byte();
-	t6 = Byte();
-	t5 = Byte();
-	t4 = Byte();
-	t3 = Byte();
-	t2 = Byte();
-	t1 = Byte();
-	return ((t1<<56) | (t2<<48) | (t3<<40) | (t4<<32) | (t5 << 24) | (t6 << 16) | (t7 << 8) | t8);
+	const Uint8 *p = Take(8);
+	const Uint64 lo = (Uint32(p[3]) << 24) | (Uint32(p[2]) << 16) | (Uint32(p[1]) << 8) | Uint32(p[0]);
+	const Uint64 hi = (Uint32(p[7]) << 24) | (Uint32(p[6]) << 16) | (Uint32(p[5]) << 8) | Uint32(p[4]);
+	return (hi << 32) | lo;
 }
 
 float Reader::Float ()
 {
-	unsigned int i;
-	union {
-		unsigned char c[sizeof (float)];
-		float f;
-	} p;
-
-	for (i=0; i<sizeof (float); i++) {
-		p.c[i] = Byte ();
-	}
-	return p.f;
+	// same byte order the writer used, whatever that was
+	float f;
+	memcpy(&f, Take(sizeof(float)), sizeof(float));
+	return f;
 }
 
 double Reader::Double ()
 {
-	unsigned int i;
-	union {
-		unsigned char c[sizeof (double)];
-		double f;
-	} p;
+	double f;
+	memcpy(&f, Take(sizeof(double)), sizeof(double));
+	return f;
+}
 
-	for (i=0; i<sizeof (double); i++) {
-		p.c[i] = Byte ();
-	}
-	return p.f;
+void Reader::Doubles(double *v, size_t n)
+{
+	memcpy(v, Take(n * sizeof(double)), n * sizeof(double));
 }
 
 std::string Reader::String()
 {
-	int size = Int32();
-	if (size == 0) return "";
+	return StringView().ToString();
+}
+
+StringRange Reader::StringView()
+{
+	static const char empty[] = "";
 
-	std::string buf;
-	buf.reserve(size-1);
+	Uint32 size = Int32();
+	if (size == 0) return StringRange(empty, size_t(0));
 
-	for (int i=0; i<size-1; i++) {
-		buf.push_back(char(Byte()));
+	const char *p = reinterpret_cast<const char*>(Take(size));
+	if (p[size-1] != '\0') throw SavedGameCorruptException();
+	return StringRange(p, size-1); // without the null terminator
+}
+
+Reader Reader::RdSection(const std::string &section_label_expected)
+{
+	if (StringView() != section_label_expected.c_str()) {
+		throw SavedGameCorruptException();
 	}
-	Byte();// discard null terminator
-	return buf;
+
+	// the section is written as a string. rather than copy it out, point
+	// a reader at it where it lies
+	const StringRange data = StringView();
+	Reader section(m_owner, data.begin, data.Size());
+	section.SetStreamVersion(StreamVersion());
+	return section;
 }
 
 vector3d Reader::Vector3d()
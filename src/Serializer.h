@@ -6,6 +6,8 @@
 
 #include "utils.h"
 #include "Quaternion.h"
+#include "RefCounted.h"
+#include "StringRange.h"
 #include <vector>
 
 class Frame;
@@ -18,12 +20,26 @@ struct SavedGameWrongVersionException {};
 struct CouldNotOpenFileException {};
 struct CouldNotWriteToFileException {};
 
+namespace FileSystem { class FileData; }
+
 namespace Serializer {
 
 	class Writer {
 	public:
-		Writer() {}
+		// takes a streaming writer's output a piece at a time
+		class Sink {
+		public:
+			virtual ~Sink() {}
+			virtual void Write(const std::string &data) = 0;
+		};
+
+		Writer(): m_sink(0) {}
+		// everything written goes on to the sink, a top level section at a
+		// time, so the whole stream is never held at once. GetData can't be
+		// used, and Flush must be called at the end
+		Writer(Sink *sink): m_sink(sink) {}
 		const std::string &GetData();
+		void Flush();
 		void Byte(Uint8 x);
 		void Bool(bool x);
 		void Int16(Uint16 x);
@@ -31,6 +47,8 @@ namespace Serializer {
 		void Int64(Uint64 x);
 		void Float(float f);
 		void Double(double f);
+		// n doubles in one go, laid out exactly as n calls to Double would
+		void Doubles(const double *v, size_t n);
 		void String(const char* s);
 		void String(const std::string &s);
 		void Vector3d(vector3d vec);
@@ -38,6 +56,7 @@ namespace Serializer {
 		void WrSection(const std::string &section_label, const std::string &section_data) {
 			String(section_label);
 			String(section_data);
+			if (m_sink) Flush();
 		}
 		/** Best not to use these except in templates */
 		void Auto(Sint32 x) { Int32(x); }
@@ -46,13 +65,38 @@ namespace Serializer {
 		void Auto(double x) { Double(x); }
 	private:
 		std::string m_str;
+		Sink *m_sink;
+	};
+
+	// writes a stream to a file as it comes, either as it is or deflated a
+	// piece at a time. Reader takes either kind of file
+	class FileSink : public Writer::Sink {
+	public:
+		FileSink(FILE *f, bool compress);
+		virtual void Write(const std::string &data);
+		// ends the stream. call after the writer's last Flush
+		void Finish();
+		// true if anything failed to compress or write. once something has,
+		// nothing more is written
+		bool Failed() const { return m_failed; }
+	private:
+		FILE *m_file;
+		bool m_compress;
+		bool m_started;
+		bool m_failed;
 	};
 
+	// decodes straight out of one contiguous buffer. sections are views into
+	// their parent's buffer, and everything shares ownership of it, so a
+	// section can outlive the reader it came from
 	class Reader {
 	public:
 		Reader();
 		Reader(const std::string &data);
 		Reader(FILE *fptr);
+		// starts offset bytes in, so whatever comes ahead of the stream
+		// proper can be skipped
+		Reader(const RefCountedPtr<FileSystem::FileData> &file, size_t offset = 0);
 		bool AtEnd();
 		void Seek(int pos);
 		Uint8 Byte();
@@ -62,17 +106,15 @@ namespace Serializer {
 		Uint64 Int64();
 		float Float ();
 		double Double ();
+		void Doubles(double *v, size_t n);
 		std::string String();
+		// the next string where it lies in the buffer, without copying it.
+		// it stays good for as long as any reader sharing the buffer does,
+		// and is always followed by a null
+		StringRange StringView();
 		vector3d Vector3d();
 		Quaternionf RdQuaternionf();
-		Reader RdSection(const std::string &section_label_expected) {
-			if (section_label_expected != String()) {
-				throw SavedGameCorruptException();
-			}
-			Reader section = Reader(String());
-			section.SetStreamVersion(StreamVersion());
-			return section;
-		}
+		Reader RdSection(const std::string &section_label_expected);
 		/** Best not to use these except in templates */
 		void Auto(Sint32 *x) { *x = Int32(); }
 		void Auto(Sint64 *x) { *x = Int64(); }
@@ -81,12 +123,23 @@ namespace Serializer {
 		int StreamVersion() const { return m_streamVersion; }
 		void SetStreamVersion(int x) { m_streamVersion = x; }
 	private:
-		std::string m_data;
+		Reader(const RefCountedPtr<RefCounted> &owner, const char *data, size_t size);
+
+		// the next n bytes, or throws if there aren't that many left
+		const Uint8 *Take(size_t n) {
+			if (n > m_size - std::min(m_pos, m_size)) throw SavedGameCorruptException();
+			const Uint8 *p = reinterpret_cast<const Uint8*>(m_data + m_pos);
+			m_pos += n;
+			return p;
+		}
+
+		RefCountedPtr<RefCounted> m_owner; // whatever keeps m_data alive
+		const char *m_data;
+		size_t m_size;
 		size_t m_pos;
 		int m_streamVersion;
 	};
 
-
 }
 
 #endif /* _SERIALIZE_H */
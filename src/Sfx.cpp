@@ -5,6 +5,7 @@
 #include "Frame.h"
 #include "galaxy/StarSystem.h"
 #include "libs.h"
+#include "MemoryStats.h"
 #include "Pi.h"
 #include "Pi.h"
 #include "Space.h"
@@ -13,13 +14,59 @@
 #include "graphics/Material.h"
 #include "graphics/Renderer.h"
 #include "graphics/TextureBuilder.h"
+#include "graphics/VertexArray.h"
 
 using namespace Graphics;
 
-static const int MAX_SFX_PER_FRAME = 1024;
+static const size_t MAX_SFX_PER_FRAME = 1024;
 
-Graphics::Drawables::Sphere3D *Sfx::shieldEffect = 0;
-Graphics::Drawables::Sphere3D *Sfx::explosionEffect = 0;
+// the particles of every frame, in camera space, drawn together at the end
+struct ParticleBatch {
+	void Add(const vector3f &pos, const Color &c, float size) {
+		positions.push_back(pos);
+		colors.push_back(c);
+		sizes.push_back(size);
+	}
+	void Draw(Graphics::Renderer *r, Graphics::Material *mat, Graphics::BlendMode blend) {
+		if (positions.empty()) return;
+		r->SetBlendMode(blend);
+		r->DrawPointSprites(positions.size(), &positions[0], &colors[0], &sizes[0], mat);
+		positions.clear();
+		colors.clear();
+		sizes.clear();
+	}
+	std::vector<vector3f> positions;
+	std::vector<Color> colors;
+	std::vector<float> sizes;
+};
+static ParticleBatch s_damageBatch;
+static ParticleBatch s_smokeBatch;
+
+// the sphere as triangles, from least to most detailed
+static std::vector<vector3f> s_sphereModels[3];
+
+// explosion and shield spheres, in camera space, drawn together at the end.
+// each is a copy of the sphere with as much detail as its size on screen needs
+struct SphereBatch {
+	SphereBatch() : verts(ATTRIB_POSITION | ATTRIB_DIFFUSE) {}
+	void Add(const vector3f &pos, float radius, const Color &c) {
+		const float size = radius / std::max(pos.Length(), 1.0f);
+		const std::vector<vector3f> &model = s_sphereModels[size < 0.02f ? 0 : size < 0.1f ? 1 : 2];
+		for (std::vector<vector3f>::const_iterator i = model.begin(); i != model.end(); ++i)
+			verts.Add(pos + (*i)*radius, c);
+	}
+	void Draw(Graphics::Renderer *r, Graphics::Material *mat, Graphics::BlendMode blend) {
+		if (!verts.GetNumVerts()) return;
+		r->SetBlendMode(blend);
+		r->DrawTriangles(&verts, mat);
+		verts.Clear();
+	}
+	VertexArray verts;
+};
+static SphereBatch s_explosionBatch;
+static SphereBatch s_shieldBatch;
+
+Graphics::Material *Sfx::sphereEffect = 0;
 Graphics::Material *Sfx::damageParticle = 0;
 Graphics::Material *Sfx::ecmParticle = 0;
 Graphics::Material *Sfx::smokeParticle = 0;
@@ -48,28 +95,21 @@ void Sfx::Load(Serializer::Reader &rd)
 void Sfx::Serialize(Serializer::Writer &wr, const Frame *f)
 {
 	// how many sfx turds are active in frame?
-	int numActive = 0;
-	if (f->m_sfx) {
-		for (int i=0; i<MAX_SFX_PER_FRAME; i++) {
-			if (f->m_sfx[i].m_type != TYPE_NONE) numActive++;
-		}
-	}
+	const int numActive = f->m_sfx ? f->m_sfx->size() : 0;
 	wr.Int32(numActive);
 
-	if (numActive) for (int i=0; i<MAX_SFX_PER_FRAME; i++) {
-		if (f->m_sfx[i].m_type != TYPE_NONE) {
-			f->m_sfx[i].Save(wr);
-		}
-	}
+	for (int i=0; i<numActive; i++)
+		(*f->m_sfx)[i].Save(wr);
 }
 
 void Sfx::Unserialize(Serializer::Reader &rd, Frame *f)
 {
 	int numActive = rd.Int32();
 	if (numActive) {
-		f->m_sfx = new Sfx[MAX_SFX_PER_FRAME];
+		f->m_sfx = new std::vector<Sfx>(numActive);
+		MemoryStats::Add(MemoryStats::SFX, f->m_sfx->capacity() * sizeof(Sfx));
 		for (int i=0; i<numActive; i++) {
-			f->m_sfx[i].Load(rd);
+			(*f->m_sfx)[i].Load(rd);
 		}
 	}
 }
@@ -108,56 +148,43 @@ void Sfx::Render(Renderer *renderer, const matrix4x4d &ftransform)
 		case TYPE_NONE: break;
 		case TYPE_EXPLOSION: {
 			//Explosion effect: A quick flash of three concentric coloured spheres. A bit retro.
-			const matrix4x4f trans = matrix4x4f::Translation(fpos.x, fpos.y, fpos.z);
-			RefCountedPtr<Material> exmat = Sfx::explosionEffect->GetMaterial();
-			exmat->diffuse = Color(1.f, 1.f, 0.5f, 1.f);
-			renderer->SetTransform(trans * matrix4x4f::ScaleMatrix(500*m_age));
-			Sfx::explosionEffect->Draw(renderer);
-			renderer->SetBlendMode(BLEND_ALPHA);
-			exmat->diffuse = Color(1.f, 0.5f, 0.f, 0.66f);
-			renderer->SetTransform(trans * matrix4x4f::ScaleMatrix(750*m_age));
-			Sfx::explosionEffect->Draw(renderer);
-			exmat->diffuse = Color(1.f, 0.f, 0.f, 0.33f);
-			renderer->SetTransform(trans * matrix4x4f::ScaleMatrix(1000*m_age));
-			Sfx::explosionEffect->Draw(renderer);
+			s_explosionBatch.Add(pos, 500*m_age, Color(1.f, 1.f, 0.5f, 1.f));
+			s_explosionBatch.Add(pos, 750*m_age, Color(1.f, 0.5f, 0.f, 0.66f));
+			s_explosionBatch.Add(pos, 1000*m_age, Color(1.f, 0.f, 0.f, 0.33f));
 			break;
 		} case TYPE_DAMAGE: {
-			renderer->SetTransform(matrix4x4d::Translation(fpos));
-			damageParticle->diffuse = Color(1.f, 1.f, 0.f, 1.0f-(m_age/2.0f));
-			renderer->SetBlendMode(BLEND_ALPHA_ONE);
-			renderer->DrawPointSprites(1, &pos, damageParticle, 20.f);
+			s_damageBatch.Add(pos, Color(1.f, 1.f, 0.f, 1.0f-(m_age/2.0f)), 20.f);
 			break;
 		} case TYPE_SMOKE: {
 			float var = Pi::rng.Double()*0.05f; //slightly variation to trail color
+			Color c;
 			if (m_age < 0.5)
 				//start trail
-				smokeParticle->diffuse = Color(0.75f-var, 0.75f-var, 0.75f-var, m_age*0.5-(m_age/2.0f));
+				c = Color(0.75f-var, 0.75f-var, 0.75f-var, m_age*0.5-(m_age/2.0f));
 			else
 				//end trail
-				smokeParticle->diffuse = Color(0.75-var, 0.75f-var, 0.75f-var, 0.5*0.5-(m_age/16.0));
+				c = Color(0.75-var, 0.75f-var, 0.75f-var, 0.5*0.5-(m_age/16.0));
 
-			renderer->SetTransform(matrix4x4d::Translation(fpos));
-
-			damageParticle->diffuse*=0.05;
-			renderer->SetBlendMode(Graphics::BLEND_ALPHA);
-			renderer->DrawPointSprites(1, &pos, smokeParticle, (m_speed*m_age));
+			s_smokeBatch.Add(pos, c, m_speed*m_age);
 			break;
 		}
 	}
 }
 
+// only good until the next one's added to the frame
 Sfx *Sfx::AllocSfxInFrame(Frame *f)
 {
 	if (!f->m_sfx) {
-		f->m_sfx = new Sfx[MAX_SFX_PER_FRAME];
+		f->m_sfx = new std::vector<Sfx>();
 	}
 
-	for (int i=0; i<MAX_SFX_PER_FRAME; i++) {
-		if (f->m_sfx[i].m_type == TYPE_NONE) {
-			return &f->m_sfx[i];
-		}
-	}
-	return 0;
+	if (f->m_sfx->size() >= MAX_SFX_PER_FRAME) return 0;
+	const size_t capacity = f->m_sfx->capacity();
+	f->m_sfx->push_back(Sfx());
+	// the array only ever grows, until the frame frees it
+	if (f->m_sfx->capacity() != capacity)
+		MemoryStats::Add(MemoryStats::SFX, (f->m_sfx->capacity() - capacity) * sizeof(Sfx));
+	return &f->m_sfx->back();
 }
 
 void Sfx::Add(const Body *b, TYPE t)
@@ -187,14 +214,25 @@ void Sfx::AddThrustSmoke(const Body *b, TYPE t, const float speed, vector3d adju
 	sfx->m_vel = vector3d(0,0,0);
 }
 
+void Sfx::AddShield(const vector3f &pos, float radius, const Color &c)
+{
+	s_shieldBatch.Add(pos, radius, c);
+}
+
 void Sfx::TimeStepAll(const float timeStep, Frame *f)
 {
 	if (f->m_sfx) {
-		for (int i=0; i<MAX_SFX_PER_FRAME; i++) {
-			if (f->m_sfx[i].m_type != TYPE_NONE) {
-				f->m_sfx[i].TimeStepUpdate(timeStep);
+		// update them, moving the live ones down over the finished ones
+		std::vector<Sfx> &sfx = *f->m_sfx;
+		size_t numLive = 0;
+		for (size_t i=0; i<sfx.size(); i++) {
+			sfx[i].TimeStepUpdate(timeStep);
+			if (sfx[i].m_type != TYPE_NONE) {
+				if (i != numLive) sfx[numLive] = sfx[i];
+				numLive++;
 			}
 		}
+		sfx.resize(numLive);
 	}
 
 	for (Frame::ChildIterator it = f->BeginChildren(); it != f->EndChildren(); ++it) {
@@ -204,43 +242,62 @@ void Sfx::TimeStepAll(const float timeStep, Frame *f)
 
 void Sfx::RenderAll(Renderer *renderer, Frame *f, const Frame *camFrame)
 {
-	if (f->m_sfx) {
+	// everything is gathered from all the frames first and drawn together,
+	// a draw for each kind. shields were added as their ships were drawn
+	RenderFrame(renderer, f, camFrame);
+
+	renderer->SetTransform(matrix4x4f::Identity());
+	s_explosionBatch.Draw(renderer, sphereEffect, BLEND_ALPHA);
+	s_shieldBatch.Draw(renderer, sphereEffect, BLEND_ADDITIVE);
+	s_smokeBatch.Draw(renderer, smokeParticle, BLEND_ALPHA);
+	s_damageBatch.Draw(renderer, damageParticle, BLEND_ALPHA_ONE);
+}
+
+void Sfx::RenderFrame(Renderer *renderer, Frame *f, const Frame *camFrame)
+{
+	if (f->m_sfx && !f->m_sfx->empty()) {
 		matrix4x4d ftran;
 		Frame::GetFrameTransform(f, camFrame, ftran);
 
-		for (int i=0; i<MAX_SFX_PER_FRAME; i++) {
-			if (f->m_sfx[i].m_type != TYPE_NONE) {
-				f->m_sfx[i].Render(renderer, ftran);
-			}
-		}
+		for (std::vector<Sfx>::iterator i = f->m_sfx->begin(); i != f->m_sfx->end(); ++i)
+			i->Render(renderer, ftran);
 	}
 
 	for (Frame::ChildIterator it = f->BeginChildren(); it != f->EndChildren(); ++it) {
-		RenderAll(renderer, *it, camFrame);
+		RenderFrame(renderer, *it, camFrame);
 	}
 }
 
 void Sfx::Init(Graphics::Renderer *r)
 {
 	Graphics::MaterialDescriptor desc;
-	RefCountedPtr<Graphics::Material> shieldMat(r->CreateMaterial(desc));
-	RefCountedPtr<Graphics::Material> explosionMat(r->CreateMaterial(desc));
-	shieldEffect = new Graphics::Drawables::Sphere3D(shieldMat, 2);
-	explosionEffect = new Graphics::Drawables::Sphere3D(explosionMat, 2);
+	for (int i = 0; i < 3; i++) {
+		const Graphics::Drawables::Sphere3D sphere(RefCountedPtr<Graphics::Material>(0), i);
+		const Graphics::Surface *surface = sphere.GetSurface();
+		const std::vector<vector3f> &position = surface->GetVertices()->position;
+		const std::vector<unsigned short> &indices = surface->GetIndices();
+		s_sphereModels[i].clear();
+		for (std::vector<unsigned short>::const_iterator j = indices.begin(); j != indices.end(); ++j)
+			s_sphereModels[i].push_back(position[*j]);
+	}
+	desc.vertexColors = true;
+	sphereEffect = r->CreateMaterial(desc);
+	desc.vertexColors = false;
 
 	desc.textures = 1;
-	damageParticle = r->CreateMaterial(desc);
-	damageParticle->texture0 = Graphics::TextureBuilder::Billboard("textures/smoke.png").GetOrCreateTexture(r, "billboard");
 	ecmParticle = r->CreateMaterial(desc);
 	ecmParticle->texture0 = Graphics::TextureBuilder::Billboard("textures/ecm.png").GetOrCreateTexture(r, "billboard");
+	// these are batched, each particle with its own colour
+	desc.vertexColors = true;
+	damageParticle = r->CreateMaterial(desc);
+	damageParticle->texture0 = Graphics::TextureBuilder::Billboard("textures/smoke.png").GetOrCreateTexture(r, "billboard");
 	smokeParticle = r->CreateMaterial(desc);
 	smokeParticle->texture0 = Graphics::TextureBuilder::Billboard("textures/smoke.png").GetOrCreateTexture(r, "billboard");
 }
 
 void Sfx::Uninit()
 {
-	delete shieldEffect; shieldEffect = 0;
-	delete explosionEffect; explosionEffect = 0;
+	delete sphereEffect; sphereEffect = 0;
 	delete damageParticle; damageParticle = 0;
 	delete ecmParticle; ecmParticle = 0;
 	delete smokeParticle; smokeParticle = 0;
@@ -11,9 +11,6 @@ class Frame;
 namespace Graphics {
 	class Renderer;
 	class Material;
-	namespace Drawables {
-		class Sphere3D;
-	}
 }
 
 class Sfx {
@@ -22,6 +19,8 @@ public:
 
 	static void Add(const Body *, TYPE);
 	static void AddThrustSmoke(const Body *b, TYPE, float speed, vector3d adjustpos);
+	// a shield bubble, in camera space. it's drawn with the rest in RenderAll
+	static void AddShield(const vector3f &pos, float radius, const Color &c);
 	static void TimeStepAll(const float timeStep, Frame *f);
 	static void RenderAll(Graphics::Renderer *r, Frame *f, const Frame *camFrame);
 	static void Serialize(Serializer::Writer &wr, const Frame *f);
@@ -34,14 +33,14 @@ public:
 	//create shared models
 	static void Init(Graphics::Renderer *r);
 	static void Uninit();
-	static Graphics::Drawables::Sphere3D *shieldEffect;
-	static Graphics::Drawables::Sphere3D *explosionEffect;
+	static Graphics::Material *sphereEffect;
 	static Graphics::Material *damageParticle;
 	static Graphics::Material *ecmParticle;
 	static Graphics::Material *smokeParticle;
 
 private:
 	static Sfx *AllocSfxInFrame(Frame *f);
+	static void RenderFrame(Graphics::Renderer *r, Frame *f, const Frame *camFrame);
 
 	void Render(Graphics::Renderer *r, const matrix4x4d &transform);
 	void TimeStepUpdate(const float timeStep);
@@ -131,7 +131,7 @@ void Ship::Load(Serializer::Reader &rd, Space *space)
 	SetShipId(rd.String()); // XXX handle missing thirdparty ship
 	m_dockedWithPort = rd.Int32();
 	m_dockedWithIndex = rd.Int32();
-	m_equipment.InitSlotSizes(m_type->id);
+	m_equipment.InitSlotSizes(*m_type);
 	m_equipment.Load(rd);
 	Init();
 	m_stats.hull_mass_left = rd.Float(); // must be after Init()...
@@ -200,7 +200,7 @@ Ship::Ship(ShipType::Id shipId): DynamicBody(),
 	SetShipId(shipId);
 	m_thrusters.x = m_thrusters.y = m_thrusters.z = 0;
 	m_angThrusters.x = m_angThrusters.y = m_angThrusters.z = 0;
-	m_equipment.InitSlotSizes(shipId);
+	m_equipment.InitSlotSizes(*m_type);
 	m_hyperspace.countdown = 0;
 	m_hyperspace.now = false;
 	for (int i=0; i<ShipType::GUNMOUNT_MAX; i++) {
@@ -486,10 +486,10 @@ static float distance_to_system(const SystemPath &dest)
 	assert(here.HasValidSystem());
 	assert(dest.HasValidSystem());
 
-	Sector sec1(here.sectorX, here.sectorY, here.sectorZ);
-	Sector sec2(dest.sectorX, dest.sectorY, dest.sectorZ);
+	RefCountedPtr<Sector> sec1 = Sector::GetCached(here);
+	RefCountedPtr<Sector> sec2 = Sector::GetCached(dest);
 
-	return Sector::DistanceBetween(&sec1, here.systemIndex, &sec2, dest.systemIndex);
+	return Sector::DistanceBetween(sec1.Get(), here.systemIndex, sec2.Get(), dest.systemIndex);
 }
 
 Ship::HyperjumpStatus Ship::GetHyperspaceDetails(const SystemPath &dest, int &outFuelRequired, double &outDurationSecs)
@@ -657,7 +657,7 @@ void Ship::Blastoff()
 
 	vector3d up = GetPosition().Normalized();
 	assert(GetFrame()->GetBody()->IsType(Object::PLANET));
-	const double planetRadius = 2.0 + static_cast<Planet*>(GetFrame()->GetBody())->GetTerrainHeight(up);
+	const double planetRadius = 2.0 + static_cast<Planet*>(GetFrame()->GetBody())->GetTerrainHeight(up, 1.0);
 	SetVelocity(vector3d(0, 0, 0));
 	SetAngVelocity(vector3d(0, 0, 0));
 	SetFlightState(FLYING);
@@ -676,7 +676,7 @@ void Ship::TestLanded()
 	if (GetFrame()->GetBody()->IsType(Object::PLANET)) {
 		double speed = GetVelocity().Length();
 		vector3d up = GetPosition().Normalized();
-		const double planetRadius = static_cast<Planet*>(GetFrame()->GetBody())->GetTerrainHeight(up);
+		const double planetRadius = static_cast<Planet*>(GetFrame()->GetBody())->GetCachedTerrainHeight(up);
 
 		if (speed < MAX_LANDING_SPEED) {
 			// check player is sortof sensibly oriented for landing
@@ -706,7 +706,7 @@ void Ship::SetLandedOn(Planet *p, float latitude, float longitude)
 	Frame* f = p->GetFrame()->GetRotFrame();
 	SetFrame(f);
 	vector3d up = vector3d(cos(latitude)*sin(longitude), sin(latitude), cos(latitude)*cos(longitude));
-	const double planetRadius = p->GetTerrainHeight(up);
+	const double planetRadius = p->GetTerrainHeight(up, 0.25);
 	SetPosition(up * (planetRadius - GetAabb().min.y));
 	vector3d right = up.Cross(vector3d(0,0,1)).Normalized();
 	SetOrient(matrix3x3d::FromVectors(right, up));
@@ -717,6 +717,17 @@ void Ship::SetLandedOn(Planet *p, float latitude, float longitude)
 	LuaEvent::Queue("onShipLanded", this, p);
 }
 
+void Ship::ParallelTimeStepUpdate(const float timeStep)
+{
+	vector3d maxThrust = GetMaxThrust(m_thrusters);
+	vector3d thrust = vector3d(maxThrust.x*m_thrusters.x, maxThrust.y*m_thrusters.y,
+		maxThrust.z*m_thrusters.z);
+	AddRelForce(thrust);
+	AddRelTorque(GetShipType()->angThrust * m_angThrusters);
+
+	DynamicBody::ParallelTimeStepUpdate(timeStep);
+}
+
 void Ship::TimeStepUpdate(const float timeStep)
 {
 	// If docked, station is responsible for updating position/orient of ship
@@ -725,9 +736,11 @@ void Ship::TimeStepUpdate(const float timeStep)
 	vector3d maxThrust = GetMaxThrust(m_thrusters);
 	vector3d thrust = vector3d(maxThrust.x*m_thrusters.x, maxThrust.y*m_thrusters.y,
 		maxThrust.z*m_thrusters.z);
-	AddRelForce(thrust);
-	AddRelTorque(GetShipType()->angThrust * m_angThrusters);
 
+	if (!IsParallelStepDone()) {
+		AddRelForce(thrust);
+		AddRelTorque(GetShipType()->angThrust * m_angThrusters);
+	}
 	DynamicBody::TimeStepUpdate(timeStep);
 
 	// fuel use decreases mass, so do this as the last thing in the frame
@@ -1142,19 +1155,9 @@ void Ship::Render(Graphics::Renderer *renderer, const Camera *camera, const vect
 	// draw shield recharge bubble
 	if (m_stats.shield_mass_left < m_stats.shield_mass) {
 		const float shield = 0.01f*GetPercentShields();
-		renderer->SetBlendMode(Graphics::BLEND_ADDITIVE);
-
-		matrix4x4f trans = matrix4x4f::Identity();
-		trans.Translate(viewCoords.x, viewCoords.y, viewCoords.z);
-		trans.Scale(GetPhysRadius());
-		renderer->SetTransform(trans);
-
 		//fade based on strength
-		Sfx::shieldEffect->GetMaterial()->diffuse =
-			Color((1.0f-shield),shield,0.0,0.33f*(1.0f-shield));
-		Sfx::shieldEffect->Draw(renderer);
-
-		renderer->SetBlendMode(Graphics::BLEND_SOLID);
+		Sfx::AddShield(vector3f(viewCoords), GetPhysRadius(),
+			Color((1.0f-shield),shield,0.0,0.33f*(1.0f-shield)));
 	}
 
 	if (m_ecmRecharge > 0.0f) {
@@ -1268,14 +1271,15 @@ std::string Ship::MakeRandomLabel()
 
 void Ship::SetShipId(const ShipType::Id &shipId)
 {
-	m_type = &ShipType::types[shipId];
+	m_type = ShipType::Get(shipId);
+	assert(m_type);
 	Properties().Set("shipId", shipId);
 }
 
 void Ship::SetShipType(const ShipType::Id &shipId)
 {
 	SetShipId(shipId);
-	m_equipment.InitSlotSizes(shipId);
+	m_equipment.InitSlotSizes(*m_type);
 	SetModel(m_type->modelName.c_str());
 	m_skin.Apply(GetModel());
 	Init();
@@ -99,12 +99,17 @@ public:
 	bool Undock();
 	virtual void TimeStepUpdate(const float timeStep);
 	virtual void StaticUpdate(const float timeStep);
+	// ships in flight integrate in the parallel step. anything docking,
+	// docked or landed is being positioned by someone else
+	virtual bool HasParallelTimeStep() const { return m_flightState == FLYING && DynamicBody::HasParallelTimeStep(); }
+	virtual void ParallelTimeStepUpdate(const float timeStep);
 
 	void TimeAccelAdjust(const float timeStep);
 	void SetDecelerating(bool decel) { m_decelerating = decel; }
 	bool IsDecelerating() const { return m_decelerating; }
 
 	virtual void NotifyRemoved(const Body* const removedBody);
+	virtual bool HoldsBodyReferences() const { return true; }
 	virtual bool OnCollision(Object *o, Uint32 flags, double relVel);
 	virtual bool OnDamage(Object *attacker, float kgDamage);
 
@@ -15,6 +15,11 @@
 
 static const double VICINITY_MIN = 15000.0;
 static const double VICINITY_MUL = 4.0;
+// longest a clear path goes without being checked again, in seconds
+static const double MAX_REPLAN_INTERVAL = 2.0;
+// target movement since the last check that makes it stale, as a
+// fraction of the distance to it
+static const double REPLAN_TARGET_MOVE = 0.01;
 
 AICommand *AICommand::Load(Serializer::Reader &rd)
 {
@@ -623,8 +628,7 @@ static int CheckCollision(Ship *ship, const vector3d &pathdir, double pathdist,
 }
 
 // ok, need thing to step down through bodies and find closest approach
-// modify targpos directly to aim short of dangerous bodies
-static bool ParentSafetyAdjust(Ship *ship, Frame *targframe, vector3d &targpos, vector3d &targvel)
+static Body *FindParentSafetyBody(Ship *ship, Frame *targframe)
 {
 	Body *body = 0;
 	Frame *frame = targframe->GetNonRotFrame();
@@ -638,6 +642,12 @@ static bool ParentSafetyAdjust(Ship *ship, Frame *targframe, vector3d &targpos,
 
 		frame = frame->GetParent()->GetNonRotFrame();			// check next frame down
 	}
+	return body;
+}
+
+// modify targpos directly to aim short of dangerous bodies
+static bool ParentSafetyAdjust(Ship *ship, Body *body, vector3d &targpos, vector3d &targvel)
+{
 	if (!body) return false;
 
 	// aim for zero velocity at surface of that body
@@ -673,6 +683,7 @@ extern double calc_ivel(double dist, double vel, double acc);
 AICmdFlyTo::AICmdFlyTo(Ship *ship, Body *target) : AICommand(ship, CMD_FLYTO)
 {
 	m_frame = 0; m_state = -6; m_lockhead = true; m_endvel = 0; m_tangent = false;
+	InvalidatePlan();
 	if (!target->IsType(Object::TERRAINBODY)) m_dist = VICINITY_MIN;
 	else m_dist = VICINITY_MUL*MaxEffectRad(target, ship);
 
@@ -695,6 +706,7 @@ AICmdFlyTo::AICmdFlyTo(Ship *ship, Frame *targframe, const vector3d &posoff, dou
 	m_endvel = endvel;
 	m_tangent = tangent;
 	m_frame = 0; m_state = -6; m_lockhead = true;
+	InvalidatePlan();
 }
 
 bool AICmdFlyTo::TimeStepUpdate()
@@ -717,11 +729,23 @@ bool AICmdFlyTo::TimeStepUpdate()
 		targvel = GetVelInFrame(m_ship->GetFrame(), m_targframe, m_posoff);		
 	}
 	Frame *targframe = m_target ? m_target->GetFrame() : m_targframe;
-	ParentSafetyAdjust(m_ship, targframe, targpos, targvel);
+
+	// the slow checks are redone now and then, more often near the target
+	const double now = Pi::game->GetTime();
+	const bool replan = now >= m_nextReplan || m_frame != m_ship->GetFrame() || m_safetyFrame != targframe;
+	if (replan) {
+		m_safetyBody = FindParentSafetyBody(m_ship, targframe);
+		m_safetyFrame = targframe;
+	}
+	ParentSafetyAdjust(m_ship, m_safetyBody, targpos, targvel);
 	vector3d relpos = targpos - m_ship->GetPosition();
 	vector3d reldir = relpos.NormalizedSafe();
 	vector3d relvel = targvel - m_ship->GetVelocity();
 	double targdist = relpos.Length();
+	if (replan) {
+		const double speed = std::max(m_ship->GetVelocity().Length(), 1.0);
+		m_nextReplan = now + Clamp(REPLAN_TARGET_MOVE * targdist / speed, 0.0, MAX_REPLAN_INTERVAL);
+	}
 
 #ifdef DEBUG_AUTOPILOT
 if (m_ship->IsType(Object::PLAYER))
@@ -744,7 +768,14 @@ printf("Autopilot dist = %.1f, speed = %.1f, zthrust = %.2f, state = %i\n",
 	if ((m_target && body != m_target)
 		|| (m_targframe && (!m_tangent || body != m_targframe->GetBody())))
 	{
-		int coll = CheckCollision(m_ship, reldir, targdist, targpos, m_endvel, erad);
+		// only a clear path is trusted, anything else is watched every tick
+		int coll = 0;
+		const double moveLimit = std::max(REPLAN_TARGET_MOVE * targdist, 1000.0);
+		if (replan || !m_pathClear || (targpos - m_checkedTargPos).LengthSqr() > moveLimit * moveLimit) {
+			coll = CheckCollision(m_ship, reldir, targdist, targpos, m_endvel, erad);
+			m_pathClear = (coll == 0);
+			m_checkedTargPos = targpos;
+		}
 		if (coll == 0) {				// no collision
 			if (m_child) { delete m_child; m_child = 0; }
 		}
@@ -884,9 +915,17 @@ bool AICmdDock::TimeStepUpdate()
 
 	int port = m_target->GetMyDockingPort(m_ship);
 	if (port == -1) {
+		// the station hands over a bay when one is free, so just keep
+		// station until then
+		if (m_target->IsQueuedForDocking(m_ship)) {
+			m_ship->AIMatchVel(m_target->GetVelocityRelTo(m_ship->GetFrame()));
+			return false;
+		}
 		std::string msg;
 		const bool cleared = m_target->GetDockingClearance(m_ship, msg);
 		port = m_target->GetMyDockingPort(m_ship);
+		if (!cleared && port == -1 && m_target->QueueForDocking(m_ship))
+			return false;
 		if (!cleared || (port == -1)) {
 			m_ship->AIMessage(Ship::AIERROR_REFUSED_PERM);
 			return true;
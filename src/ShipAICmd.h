@@ -136,6 +136,7 @@ public:
 		m_endvel = rd.Double();
 		m_tangent = rd.Bool();
 		m_state = rd.Int32();
+		InvalidatePlan();
 	}
 	virtual void PostLoadFixup(Space *space) {
 		AICommand::PostLoadFixup(space);
@@ -146,6 +147,7 @@ public:
 	virtual void OnDeleted(const Body *body) {
 		AICommand::OnDeleted(body);
 		if (m_target == body) m_target = 0;
+		if (m_safetyBody == body) InvalidatePlan();
 	}
 
 private:
@@ -161,6 +163,16 @@ private:
 	int m_targetIndex, m_targframeIndex;	// used during deserialisation
 	vector3d m_reldir;	// target direction relative to ship at last frame change
 	Frame *m_frame;		// last frame of ship
+
+	// the obstruction tests rarely change their answer from one tick to
+	// the next, so a clear path is trusted until the next replan, a frame
+	// change or the target moving off. none of this is saved
+	void InvalidatePlan() { m_nextReplan = 0.0; m_pathClear = false; m_safetyBody = 0; m_safetyFrame = 0; }
+	double m_nextReplan;		// game time
+	bool m_pathClear;			// no collision at the last check
+	vector3d m_checkedTargPos;	// target pos in m_frame at the last check
+	Body *m_safetyBody;			// from FindParentSafetyBody at the last replan
+	Frame *m_safetyFrame;		// target frame it was found for
 };
 
 
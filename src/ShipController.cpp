@@ -12,8 +12,49 @@
 #include "WorldView.h"
 #include "OS.h"
 
+// AI ships this far from the player, and out in open space, only think every
+// few steps. their thrusters hold whatever they were last told in between
+static const double AI_LOD_DISTANCE = 1.0e8; // 100,000km
+// open space means at least this many radii from the frame's body, and never
+// closer than the minimum (stations are tiny and docking is fiddly)
+static const double AI_LOD_CLEARANCE_RADII = 10.0;
+static const double AI_LOD_MIN_CLEARANCE = 50000.0;
+static const int AI_LOD_MAX_INTERVAL = 4;
+// never leave the thrusters unattended for longer than this much game time,
+// so at high time acceleration the AI runs every step no matter what
+static const float AI_LOD_MAX_GAP = 4.0f;
+
+static bool IsAIOutOfSight(const Ship *ship)
+{
+	if (ship->GetFlightState() != Ship::FLYING) return false;
+
+	const Frame *frame = ship->GetFrame();
+	if (!frame || frame->IsRotFrame()) return false;
+	if (!Pi::player || !Pi::player->GetFrame()) return false;
+
+	if (const Body *body = frame->GetBody()) {
+		const double clearance = std::max(AI_LOD_CLEARANCE_RADII * body->GetPhysRadius(), AI_LOD_MIN_CLEARANCE);
+		if (ship->GetPosition().LengthSqr() < clearance*clearance) return false;
+	}
+
+	return ship->GetPositionRelTo(Pi::player).LengthSqr() > AI_LOD_DISTANCE*AI_LOD_DISTANCE;
+}
+
+ShipController::ShipController() :
+	m_ship(0),
+	// spread the far ships' thinking over the steps
+	m_lodCounter(int((reinterpret_cast<size_t>(this) >> 4) % AI_LOD_MAX_INTERVAL))
+{
+}
+
 void ShipController::StaticUpdate(float timeStep)
 {
+	const int interval = Clamp(int(AI_LOD_MAX_GAP / timeStep), 1, AI_LOD_MAX_INTERVAL);
+	if (interval > 1 && IsAIOutOfSight(m_ship)) {
+		if (++m_lodCounter < interval) return;
+		m_lodCounter = 0;
+	}
+
 	OS::EnableFPE();
 	m_ship->AITimeStep(timeStep);
 	OS::DisableFPE();
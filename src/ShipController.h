@@ -32,7 +32,7 @@ public:
 		AI = 0,
 		PLAYER = 1
 	};
-	ShipController() { }
+	ShipController();
 	virtual ~ShipController() { }
 	virtual Type GetType() { return AI; }
 	virtual void Save(Serializer::Writer &wr, Space *s) { }
@@ -41,6 +41,11 @@ public:
 	virtual void StaticUpdate(float timeStep);
 	virtual void SetFlightControlState(FlightControlState s) { }
 	Ship *m_ship;
+
+private:
+	// steps since the AI last ran, while it's far enough away to be run
+	// less often
+	int m_lodCounter;
 };
 
 // autopilot AI + input
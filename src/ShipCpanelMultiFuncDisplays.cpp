@@ -29,6 +29,7 @@ static const float SCANNER_SCALE     = 0.00001f;
 static const float SCANNER_YSHRINK   = 0.75f;
 static const float A_BIT             = 1.1f;
 static const unsigned int SCANNER_STEPS = 100;
+static const double SCANNER_CONTACT_INTERVAL = 0.1; // game seconds between contact updates
 
 enum ScannerBlobWeight { WEIGHT_LIGHT, WEIGHT_HEAVY };
 
@@ -119,7 +120,7 @@ ScannerWidget::ScannerWidget(Graphics::Renderer *r) :
 	m_renderer(r)
 {
 	m_mode = SCANNER_MODE_AUTO;
-	m_currentRange = m_manualRange = m_targetRange = SCANNER_RANGE_MIN;
+	m_currentRange = m_manualRange = m_targetRange = m_autoRange = SCANNER_RANGE_MIN;
 
 	InitObject();
 }
@@ -131,6 +132,7 @@ ScannerWidget::ScannerWidget(Graphics::Renderer *r, Serializer::Reader &rd) :
 	m_currentRange = rd.Float();
 	m_manualRange = rd.Float();
 	m_targetRange = rd.Float();
+	m_autoRange = m_targetRange;
 
 	InitObject();
 }
@@ -139,6 +141,8 @@ void ScannerWidget::InitObject()
 {
 	m_toggleScanModeConnection = KeyBindings::toggleScanMode.onPress.connect(sigc::mem_fun(this, &ScannerWidget::ToggleMode));
 	m_lastRange = SCANNER_RANGE_MAX * 100.0f;		// force regen
+	m_contactTime = -SCANNER_CONTACT_INTERVAL;		// force contact update
+	m_combatTarget = m_navTarget = 0;
 	GenerateBaseGeometry();
 }
 
@@ -211,31 +215,70 @@ void ScannerWidget::Draw()
 
 void ScannerWidget::Update()
 {
-	m_contacts.clear();
-
 	if (Pi::player->m_equipment.Get(Equip::SLOT_SCANNER) != Equip::SCANNER) {
+		m_contacts.clear();
 		m_mode = SCANNER_MODE_AUTO;
-		m_currentRange = m_manualRange = m_targetRange = SCANNER_RANGE_MIN;
+		m_currentRange = m_manualRange = m_targetRange = m_autoRange = SCANNER_RANGE_MIN;
 		return;
 	}
 
+	// contacts are only collected a few times a second. in between they're
+	// moved along the velocities they had then (see DrawBlobs)
+	const double time = Pi::game->GetTime();
+	if (time < m_contactTime || time - m_contactTime >= SCANNER_CONTACT_INTERVAL ||
+			m_combatTarget != Pi::player->GetCombatTarget() || m_navTarget != Pi::player->GetNavTarget())
+		UpdateContacts();
+
+	if (KeyBindings::increaseScanRange.IsActive()) {
+		if (m_mode == SCANNER_MODE_AUTO) {
+			m_manualRange = m_targetRange;
+			m_mode = SCANNER_MODE_MANUAL;
+		}
+		else
+			m_manualRange = m_currentRange;
+		m_manualRange = Clamp(m_manualRange * 1.05f, SCANNER_RANGE_MIN, SCANNER_RANGE_MAX);
+	}
+	else if (KeyBindings::decreaseScanRange.IsActive()) {
+		if (m_mode == SCANNER_MODE_AUTO) {
+			m_manualRange = m_targetRange;
+			m_mode = SCANNER_MODE_MANUAL;
+		}
+		else
+			m_manualRange = m_currentRange;
+		m_manualRange = Clamp(m_manualRange * 0.95f, SCANNER_RANGE_MIN, SCANNER_RANGE_MAX);
+	}
+
+	if (m_mode == SCANNER_MODE_AUTO)
+		m_targetRange = m_autoRange;
+	else
+		m_targetRange = m_manualRange;
+}
+
+void ScannerWidget::UpdateContacts()
+{
+	m_contacts.clear();
+	m_contactTime = Pi::game->GetTime();
+	m_combatTarget = Pi::player->GetCombatTarget();
+	m_navTarget = Pi::player->GetNavTarget();
+
 	// range priority is combat target > ship/missile > nav target > other
 	enum { RANGE_MAX, RANGE_FAR_OTHER, RANGE_NAV, RANGE_FAR_SHIP, RANGE_COMBAT } range_type = RANGE_MAX;
 	float combat_dist = 0, far_ship_dist = 0, nav_dist = 0, far_other_dist = 0;
 
-	// collect the bodies to be displayed, and if AUTO, distances
+	// collect the bodies to be displayed, and their distances for AUTO
 	Space::BodyNearList nearby;
 	Pi::game->GetSpace()->GetBodiesMaybeNear(Pi::player, SCANNER_RANGE_MAX, nearby);
 	for (Space::BodyNearIterator i = nearby.begin(); i != nearby.end(); ++i) {
 		if ((*i) == Pi::player) continue;
 
-		float dist = float((*i)->GetPositionRelTo(Pi::player).Length());
-
 		Contact c;
 		c.type = (*i)->GetType();
 		c.pos = (*i)->GetPositionRelTo(Pi::player);
+		c.vel = (*i)->GetVelocityRelTo(Pi::player);
 		c.isSpecial = false;
 
+		const float dist = float(c.pos.Length());
+
 		switch ((*i)->GetType()) {
 
 			case Object::MISSILE:
@@ -252,9 +295,9 @@ void ScannerWidget::Update()
 				if (s->GetFlightState() != Ship::FLYING && s->GetFlightState() != Ship::LANDED)
 					continue;
 
-				if ((*i) == Pi::player->GetCombatTarget()) c.isSpecial = true;
+				if ((*i) == m_combatTarget) c.isSpecial = true;
 
-				if (m_mode == SCANNER_MODE_AUTO && range_type != RANGE_COMBAT) {
+				if (range_type != RANGE_COMBAT) {
 					if (c.isSpecial == true) {
 						combat_dist = dist;
 						range_type = RANGE_COMBAT;
@@ -271,9 +314,9 @@ void ScannerWidget::Update()
 			case Object::CARGOBODY:
 			case Object::HYPERSPACECLOUD:
 
-				if ((*i) == Pi::player->GetNavTarget()) c.isSpecial = true;
+				if ((*i) == m_navTarget) c.isSpecial = true;
 
-				if (m_mode == SCANNER_MODE_AUTO && range_type < RANGE_NAV) {
+				if (range_type < RANGE_NAV) {
 					if (c.isSpecial == true) {
 						nav_dist = dist;
 						range_type = RANGE_NAV;
@@ -292,51 +335,45 @@ void ScannerWidget::Update()
 		m_contacts.push_back(c);
 	}
 
-	if (KeyBindings::increaseScanRange.IsActive()) {
-		if (m_mode == SCANNER_MODE_AUTO) {
-			m_manualRange = m_targetRange;
-			m_mode = SCANNER_MODE_MANUAL;
-		}
-		else
-			m_manualRange = m_currentRange;
-		m_manualRange = Clamp(m_manualRange * 1.05f, SCANNER_RANGE_MIN, SCANNER_RANGE_MAX);
-	}
-	else if (KeyBindings::decreaseScanRange.IsActive()) {
-		if (m_mode == SCANNER_MODE_AUTO) {
-			m_manualRange = m_targetRange;
-			m_mode = SCANNER_MODE_MANUAL;
-		}
-		else
-			m_manualRange = m_currentRange;
-		m_manualRange = Clamp(m_manualRange * 0.95f, SCANNER_RANGE_MIN, SCANNER_RANGE_MAX);
-	}
-
-	if (m_mode == SCANNER_MODE_AUTO) {
-		switch (range_type) {
-			case RANGE_COMBAT:
-				m_targetRange = Clamp(combat_dist * A_BIT, SCANNER_RANGE_MIN, SCANNER_RANGE_MAX);
-				break;
-			case RANGE_FAR_SHIP:
-				m_targetRange = Clamp(far_ship_dist * A_BIT, SCANNER_RANGE_MIN, SCANNER_RANGE_MAX);
-				break;
-			case RANGE_NAV:
-				m_targetRange = Clamp(nav_dist * A_BIT, SCANNER_RANGE_MIN, SCANNER_RANGE_MAX);
-				break;
-			case RANGE_FAR_OTHER:
-				m_targetRange = Clamp(far_other_dist * A_BIT, SCANNER_RANGE_MIN, SCANNER_RANGE_MAX);
-				break;
-			default:
-				m_targetRange = SCANNER_RANGE_MAX;
-				break;
-		}
+	switch (range_type) {
+		case RANGE_COMBAT:
+			m_autoRange = Clamp(combat_dist * A_BIT, SCANNER_RANGE_MIN, SCANNER_RANGE_MAX);
+			break;
+		case RANGE_FAR_SHIP:
+			m_autoRange = Clamp(far_ship_dist * A_BIT, SCANNER_RANGE_MIN, SCANNER_RANGE_MAX);
+			break;
+		case RANGE_NAV:
+			m_autoRange = Clamp(nav_dist * A_BIT, SCANNER_RANGE_MIN, SCANNER_RANGE_MAX);
+			break;
+		case RANGE_FAR_OTHER:
+			m_autoRange = Clamp(far_other_dist * A_BIT, SCANNER_RANGE_MIN, SCANNER_RANGE_MAX);
+			break;
+		default:
+			m_autoRange = SCANNER_RANGE_MAX;
+			break;
 	}
+}
 
-	else
-		m_targetRange = m_manualRange;
+// a quad from a to b, in triangles
+static void add_quad(VertexArray &va, const vector3f &a, const vector3f &b, const Color &c)
+{
+	va.Add(vector3f(a.x, a.y, 0.f), c);
+	va.Add(vector3f(a.x, b.y, 0.f), c);
+	va.Add(vector3f(b.x, a.y, 0.f), c);
+	va.Add(vector3f(b.x, a.y, 0.f), c);
+	va.Add(vector3f(a.x, b.y, 0.f), c);
+	va.Add(vector3f(b.x, b.y, 0.f), c);
 }
 
 void ScannerWidget::DrawBlobs(bool below)
 {
+	// stalks and blobs are quads so they can all go in one draw, whatever
+	// their weight
+	VertexArray va(ATTRIB_POSITION | ATTRIB_DIFFUSE, m_contacts.size() * 12);
+
+	const matrix3x3d &orient = Pi::player->GetOrient();
+	const double dt = Pi::game->GetTime() - m_contactTime;
+
 	for (std::list<Contact>::iterator i = m_contacts.begin(); i != m_contacts.end(); ++i) {
 		ScannerBlobWeight weight = WEIGHT_LIGHT;
 
@@ -384,17 +421,18 @@ void ScannerWidget::DrawBlobs(bool below)
 				continue;
 		}
 
-		float pointSize = 1.f;
+		// half widths of the stalk and the blob
+		float lineWidth, pointSize;
 		if (weight == WEIGHT_LIGHT) {
-			glLineWidth(1);
-			pointSize = 3.f;
+			lineWidth = 0.5f;
+			pointSize = 1.5f;
 		}
 		else {
-			glLineWidth(2);
-			pointSize = 4.f;
+			lineWidth = 1.f;
+			pointSize = 2.f;
 		}
 
-		vector3d pos = i->pos * Pi::player->GetOrient();
+		vector3d pos = (i->pos + i->vel * dt) * orient;
 		if ((pos.y > 0) && (below)) continue;
 		if ((pos.y < 0) && (!below)) continue;
 
@@ -402,12 +440,12 @@ void ScannerWidget::DrawBlobs(bool below)
 		const float y_base = m_y + m_y * SCANNER_YSHRINK * float(pos.z) * m_scale;
 		const float y_blob = y_base - m_y * SCANNER_YSHRINK * float(pos.y) * m_scale;
 
-		const vector3f verts[] = { vector3f(x, y_base, 0.f), vector3f(x, y_blob, 0.f) };
-		m_renderer->DrawLines(2, &verts[0], *color);
-
-		vector3f blob(x, y_blob, 0.f);
-		m_renderer->DrawPoints(1, &blob, color, pointSize);
+		add_quad(va, vector3f(x - lineWidth, y_base, 0.f), vector3f(x + lineWidth, y_blob, 0.f), *color);
+		add_quad(va, vector3f(x - pointSize, y_blob - pointSize, 0.f), vector3f(x + pointSize, y_blob + pointSize, 0.f), *color);
 	}
+
+	if (va.GetNumVerts() > 0)
+		m_renderer->DrawTriangles(&va, Graphics::vtxColorMaterial);
 }
 
 void ScannerWidget::GenerateBaseGeometry()
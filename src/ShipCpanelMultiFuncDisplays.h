@@ -74,6 +74,7 @@ public:
 private:
 	void InitObject();
 
+	void UpdateContacts();
 	void DrawBlobs(bool below);
 	void GenerateBaseGeometry();
 	void GenerateRingsAndSpokes();
@@ -84,14 +85,19 @@ private:
 	struct Contact {
 		Object::Type type;
 		vector3d pos;
+		vector3d vel;
 		bool isSpecial;
 	};
 	std::list<Contact> m_contacts;
+	double m_contactTime;
+	// the targets when the contacts were collected
+	const Body *m_combatTarget;
+	const Body *m_navTarget;
 
 	enum ScannerMode { SCANNER_MODE_AUTO, SCANNER_MODE_MANUAL };
 	ScannerMode m_mode;
 
-	float m_currentRange, m_manualRange, m_targetRange;
+	float m_currentRange, m_manualRange, m_targetRange, m_autoRange;
 	float m_scale;
 
 	float m_x;
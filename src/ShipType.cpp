@@ -9,12 +9,13 @@
 #include "FileSystem.h"
 #include "utils.h"
 #include "Lang.h"
+#include "OS.h"
 #include <algorithm>
 
 const char *ShipType::gunmountNames[GUNMOUNT_MAX] = {
 	Lang::FRONT, Lang::REAR };
 
-std::map<ShipType::Id, ShipType> ShipType::types;
+std::vector<ShipType> ShipType::types;
 
 std::vector<ShipType::Id> ShipType::player_ships;
 std::vector<ShipType::Id> ShipType::static_ships;
@@ -36,20 +37,47 @@ static double GetEffectiveExhaustVelocity(double fuelTankMass, double thrusterFu
 
 static bool ShipIsUnbuyable(const ShipType::Id &id)
 {
-	const ShipType &t = ShipType::types[id];
-	return (t.baseprice == 0);
+	const ShipType *t = ShipType::Get(id);
+	return (t->baseprice == 0);
 }
 
-static std::string s_currentShipFile;
+static bool IdLess(const ShipType &a, const char *b) { return strcmp(a.id.c_str(), b) < 0; }
 
-int _define_ship(lua_State *L, ShipType::Tag tag, std::vector<ShipType::Id> *list)
+// static
+const ShipType *ShipType::Get(const char *name)
 {
-	if (s_currentShipFile.empty())
+	std::vector<ShipType>::const_iterator t = std::lower_bound(types.begin(), types.end(), name, IdLess);
+	if (t == types.end() || t->id != name) return 0;
+	else return &(*t);
+}
+
+// parses every step'th ship file from first, in a Lua state of its own,
+// so any number of them can run at once. each file's ship goes in its slot
+// in ships, so they can be merged in file order afterwards
+struct ShipFileParser {
+	const std::vector<std::string> *paths;
+	const std::vector<ShipType::Id> *ids;
+	std::vector<ShipType> *ships;
+	std::vector<char> *defined;
+	size_t first, step;
+	// the file being run, cleared once it has defined its ship
+	size_t current;
+
+	static int Run(void *data);
+};
+
+static const size_t NO_SHIP_FILE = size_t(-1);
+
+static int _define_ship(lua_State *L, ShipType::Tag tag)
+{
+	ShipFileParser *parser = static_cast<ShipFileParser*>(lua_touserdata(L, lua_upvalueindex(1)));
+	if (parser->current == NO_SHIP_FILE)
 		return luaL_error(L, "ship file contains multiple ship definitions");
 
 	ShipType s;
 	s.tag = tag;
-	s.id = s_currentShipFile;
+	s.id = (*parser->ids)[parser->current];
+	s.index = 0;
 
 	LUA_DEBUG_START(L);
 	LuaTable t(L, -1);
@@ -168,38 +196,39 @@ int _define_ship(lua_State *L, ShipType::Tag tag, std::vector<ShipType::Id> *lis
 	if (s.minCrew < 1 || s.maxCrew < 1 || s.minCrew > s.maxCrew)
 		return luaL_error(L, "Invalid values for min_crew and max_crew");
 
-	const std::string& id = s_currentShipFile;
-	typedef std::map<ShipType::Id, ShipType>::iterator iter;
-	std::pair<iter, bool> result = ShipType::types.insert(std::make_pair(id, s));
-	if (result.second)
-		list->push_back(s_currentShipFile);
-	else
-		return luaL_error(L, "Ship '%s' was already defined by a different file", id.c_str());
-	s_currentShipFile.clear();
+	(*parser->ships)[parser->current] = s;
+	(*parser->defined)[parser->current] = 1;
+	parser->current = NO_SHIP_FILE;
 
 	return 0;
 }
 
-int define_ship(lua_State *L)
+static int define_ship(lua_State *L)
 {
-	return _define_ship(L, ShipType::TAG_SHIP, &ShipType::player_ships);
+	return _define_ship(L, ShipType::TAG_SHIP);
 }
 
-int define_static_ship(lua_State *L)
+static int define_static_ship(lua_State *L)
 {
-	return _define_ship(L, ShipType::TAG_STATIC_SHIP, &ShipType::static_ships);
+	return _define_ship(L, ShipType::TAG_STATIC_SHIP);
 }
 
-int define_missile(lua_State *L)
+static int define_missile(lua_State *L)
 {
-	return _define_ship(L, ShipType::TAG_MISSILE, &ShipType::missile_ships);
+	return _define_ship(L, ShipType::TAG_MISSILE);
 }
 
-void ShipType::Init()
+static void register_define_function(lua_State *l, const char *name, lua_CFunction fn, ShipFileParser *parser)
 {
-	static bool isInitted = false;
-	if (isInitted) return;
-	isInitted = true;
+	lua_pushlightuserdata(l, parser);
+	lua_pushcclosure(l, fn, 1);
+	lua_setglobal(l, name);
+}
+
+// static
+int ShipFileParser::Run(void *data)
+{
+	ShipFileParser *parser = static_cast<ShipFileParser*>(data);
 
 	lua_State *l = luaL_newstate();
 
@@ -224,28 +253,86 @@ void ShipType::Init()
 	LUA_DEBUG_CHECK(l, 0);
 
 	// register ship definition functions
-	lua_register(l, "define_ship", define_ship);
-	lua_register(l, "define_static_ship", define_static_ship);
-	lua_register(l, "define_missile", define_missile);
+	register_define_function(l, "define_ship", define_ship, parser);
+	register_define_function(l, "define_static_ship", define_static_ship, parser);
+	register_define_function(l, "define_missile", define_missile, parser);
 
 	LUA_DEBUG_CHECK(l, 0);
 
-	// load all ship definitions
+	for (size_t i = parser->first; i < parser->paths->size(); i += parser->step) {
+		parser->current = i;
+		pi_lua_dofile(l, (*parser->paths)[i]);
+		parser->current = NO_SHIP_FILE;
+	}
+
+	LUA_DEBUG_END(l, 0);
+
+	lua_close(l);
+	return 0;
+}
+
+void ShipType::Init()
+{
+	static bool isInitted = false;
+	if (isInitted) return;
+	isInitted = true;
+
+	// find all ship definitions
+	std::vector<std::string> paths;
+	std::vector<Id> ids;
 	namespace fs = FileSystem;
 	for (fs::FileEnumerator files(fs::gameDataFiles, "ships", fs::FileEnumerator::Recurse);
 			!files.Finished(); files.Next()) {
 		const fs::FileInfo &info = files.Current();
 		if (ends_with(info.GetPath(), ".lua")) {
 			const std::string name = info.GetName();
-			s_currentShipFile = name.substr(0, name.size()-4);
-			pi_lua_dofile(l, info.GetPath());
-			s_currentShipFile.clear();
+			paths.push_back(info.GetPath());
+			ids.push_back(name.substr(0, name.size()-4));
 		}
 	}
 
-	LUA_DEBUG_END(l, 0);
-
-	lua_close(l);
+	// the files share nothing while they're run, so they're split between
+	// threads. this one takes a share too
+	std::vector<ShipType> ships(paths.size());
+	std::vector<char> defined(paths.size(), 0);
+	const size_t numParsers = std::max<size_t>(1, std::min<size_t>(std::max(OS::GetNumCores(), 1), paths.size()));
+	std::vector<ShipFileParser> parsers(numParsers);
+	std::vector<SDL_Thread*> threads(numParsers, static_cast<SDL_Thread*>(0));
+	for (size_t i = 0; i < numParsers; i++) {
+		ShipFileParser &parser = parsers[i];
+		parser.paths = &paths;
+		parser.ids = &ids;
+		parser.ships = &ships;
+		parser.defined = &defined;
+		parser.first = i;
+		parser.step = numParsers;
+		parser.current = NO_SHIP_FILE;
+		if (i > 0)
+			threads[i] = SDL_CreateThread(&ShipFileParser::Run, &parser);
+	}
+	for (size_t i = 0; i < numParsers; i++)
+		if (!threads[i]) ShipFileParser::Run(&parsers[i]);
+	for (size_t i = 0; i < numParsers; i++)
+		if (threads[i]) SDL_WaitThread(threads[i], 0);
+
+	// merge in file order, so the lists come out as they always have
+	for (size_t i = 0; i < paths.size(); i++) {
+		if (!defined[i]) continue;
+		const ShipType &s = ships[i];
+		if (Get(s.id)) {
+			fprintf(stderr, "Ship '%s' was already defined by a different file\n", s.id.c_str());
+			continue;
+		}
+		types.insert(std::lower_bound(types.begin(), types.end(), s.id.c_str(), IdLess), s);
+		switch (s.tag) {
+			case TAG_SHIP: player_ships.push_back(s.id); break;
+			case TAG_STATIC_SHIP: static_ships.push_back(s.id); break;
+			case TAG_MISSILE: missile_ships.push_back(s.id); break;
+			default: break;
+		}
+	}
+	for (size_t i = 0; i < types.size(); i++)
+		types[i].index = i;
 
 	//remove unbuyable ships from player ship list
 	ShipType::player_ships.erase(
@@ -258,7 +345,7 @@ void ShipType::Init()
 	//collect ships that can fit atmospheric shields
 	for (std::vector<ShipType::Id>::const_iterator it = ShipType::player_ships.begin();
 		it != ShipType::player_ships.end(); ++it) {
-		const ShipType &ship = ShipType::types[*it];
+		const ShipType &ship = *ShipType::Get(*it);
 		if (ship.equipSlotCapacity[Equip::SLOT_ATMOSHIELD] != 0)
 			ShipType::playable_atmospheric_ships.push_back(*it);
 	}
@@ -41,6 +41,7 @@ struct ShipType {
 	////////
 	Tag tag;
 	Id id;
+	Uint32 index; // into types. stays the same for a run of the game, not between runs
 	std::string name;
 	std::string modelName;
 	float linThrust[THRUSTER_MAX];
@@ -68,7 +69,10 @@ struct ShipType {
 	static std::string MISSILE_SMART;
 	static std::string MISSILE_UNGUIDED;
 
-	static std::map<Id, ShipType> types;
+	// every ship type, sorted by id. lookups by id are a binary search over
+	// this, so keep them to where an id comes in from outside (Lua, saves)
+	// and hold on to the ShipType or its index after that
+	static std::vector<ShipType> types;
 	static std::vector<Id> player_ships;
 	static std::vector<Id> static_ships;
 	static std::vector<Id> missile_ships;
@@ -77,11 +81,10 @@ struct ShipType {
 
 	static const char *gunmountNames[GUNMOUNT_MAX];
 	static void Init();
-	static const ShipType *Get(const char *name) {
-		std::map<Id, ShipType>::iterator t = types.find(name);
-		if (t == types.end()) return 0;
-		else return &(*t).second;
-	}
+	// 0 if there's no such ship type
+	static const ShipType *Get(const char *name);
+	static const ShipType *Get(const Id &name) { return Get(name.c_str()); }
+	static const ShipType *GetByIndex(Uint32 index) { return index < types.size() ? &types[index] : 0; }
 };
 
 #endif /* _SHIPTYPE_H */
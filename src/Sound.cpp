@@ -6,6 +6,7 @@
  */
 
 #include <SDL.h>
+#include <SDL_thread.h>
 #include <stdio.h>
 #include <assert.h>
 #include <vorbis/vorbisfile.h>
@@ -17,6 +18,12 @@
 #include "Pi.h"
 #include "Player.h"
 #include "FileSystem.h"
+#include "MemoryStats.h"
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define SOUND_USE_SSE2
+#include <emmintrin.h>
+#endif
 
 namespace Sound {
 
@@ -25,6 +32,20 @@ static const unsigned int BUF_SIZE = 4096;
 static const unsigned int MAX_WAVSTREAMS = 10; //first two are for music
 static const double STREAM_IF_LONGER_THAN = 10.0;
 
+// long samples are decoded by a thread of their own into a ring per stream,
+// so the audio callback only ever mixes. a ring holds about four callbacks
+// worth, and the decoder tops them up this often
+static const Uint32 STREAM_RING_SIZE = 32768; // Sint16s, a power of two
+static const Uint32 STREAM_DECODE_INTERVAL = 20; // ms
+static const Uint32 SAMPLE_CACHE_SIZE = 16*1024*1024; // bytes of decoded samples
+
+// sound effects quieter than this aren't played at all, and no more than
+// this many of one sample play at once. repeating sounds that lose their
+// wavstream to a louder one wait as virtual voices until one is free
+static const float MIN_AUDIBLE_VOLUME = 0.01f;
+static const int MAX_VOICES_PER_SAMPLE = 3;
+static const unsigned int MAX_VIRTUAL_VOICES = 8;
+
 class OggFileDataStream {
 public:
 	static const ov_callbacks CALLBACKS;
@@ -161,8 +182,6 @@ eventid BodyMakeNoise(const Body *b, const char *sfx, float vol)
 
 struct SoundEvent {
 	const Sample *sample;
-	OggVorbis_File *oggv; // if sample->buf = 0 then stream this
-	OggFileDataStream ogg_data_stream;
 	Uint32 buf_pos;
 	float volume[2]; // left and right channels
 	eventid identifier;
@@ -171,10 +190,36 @@ struct SoundEvent {
 	float targetVolume[2];
 	float rateOfChange[2]; // per sample
 	bool ascend[2];
+	float prev[2]; // the last frame of input, to resample from
+
+	// if sample->buf = 0 when it starts then it's streamed. the decoder
+	// thread writes what it decodes to the ring and the callback reads it.
+	// both counters only go up, and are only touched with the audio locked
+	bool streamed;
+	Uint32 stream_serial;
+	Uint32 ring_read, ring_write;
+	bool stream_eof; // nothing more will be written
 };
 
 static std::map<std::string, Sample> sfx_samples;
 struct SoundEvent wavstream[MAX_WAVSTREAMS];
+static SoundEvent virtual_voice[MAX_VIRTUAL_VOICES];
+static Sint16 stream_ring[MAX_WAVSTREAMS][STREAM_RING_SIZE];
+static Uint32 next_stream_serial = 1;
+static Uint32 sample_cache_used; // bytes
+static Uint32 sample_use_count;
+
+// what the decoder thread is doing for each wavstream. only it touches these
+struct StreamDecoder {
+	Uint32 serial; // of the event being decoded, 0 for none
+	bool open;
+	OggVorbis_File oggv;
+	OggFileDataStream ogg_data_stream;
+};
+static StreamDecoder stream_decoder[MAX_WAVSTREAMS];
+static SDL_Thread *decoder_thread;
+static SDL_sem *decoder_wake;
+static bool decoder_quit;
 
 static Sample *GetSample(const char *filename)
 {
@@ -192,6 +237,10 @@ static SoundEvent *GetEvent(eventid id)
 		if (wavstream[i].sample && (wavstream[i].identifier == id))
 			return &wavstream[i];
 	}
+	for (unsigned int i = 0; i < MAX_VIRTUAL_VOICES; i++) {
+		if (virtual_voice[i].sample && (virtual_voice[i].identifier == id))
+			return &virtual_voice[i];
+	}
 	return 0;
 }
 
@@ -209,56 +258,376 @@ bool SetOp(eventid id, Op op)
 	return ret;
 }
 
+// the decoder thread sees the event's gone and closes its stream
 static void DestroyEvent(SoundEvent *ev)
 {
-	if (ev->oggv) {
-		// streaming ogg
-		ov_clear(ev->oggv);
-		delete ev->oggv;
-		ev->oggv = 0;
-		ev->ogg_data_stream.Reset();
-	}
 	ev->sample = 0;
 }
 
+// with the audio locked
+static void StartStream(SoundEvent *ev)
+{
+	if (ev->sample) {
+		// it's used, so try to have it decoded for next time
+		Sample *sample = const_cast<Sample*>(ev->sample);
+		sample->last_used = ++sample_use_count;
+		if (!sample->buf && !sample->stream) sample->wanted = true;
+	}
+	ev->streamed = ev->sample && !ev->sample->buf;
+	ev->prev[0] = ev->prev[1] = 0.0f;
+	ev->stream_serial = next_stream_serial++;
+	ev->ring_read = ev->ring_write = 0;
+	ev->stream_eof = false;
+}
+
+// with the audio locked. copy up to count decoded values out of the ring
+static Uint32 read_stream(SoundEvent &ev, Sint16 *out, Uint32 count)
+{
+	const Sint16 *ring = stream_ring[&ev - wavstream];
+	count = std::min(count, ev.ring_write - ev.ring_read);
+	const Uint32 start = ev.ring_read & (STREAM_RING_SIZE-1);
+	const Uint32 first = std::min(count, STREAM_RING_SIZE - start);
+	memcpy(out, ring + start, first*sizeof(Sint16));
+	memcpy(out + first, ring, (count - first)*sizeof(Sint16));
+	ev.ring_read += count;
+	return count;
+}
+
+// with the audio locked. the ring must have room for count
+static void write_stream(SoundEvent &ev, const Sint16 *in, Uint32 count)
+{
+	Sint16 *ring = stream_ring[&ev - wavstream];
+	const Uint32 start = ev.ring_write & (STREAM_RING_SIZE-1);
+	const Uint32 first = std::min(count, STREAM_RING_SIZE - start);
+	memcpy(ring + start, in, first*sizeof(Sint16));
+	memcpy(ring, in + first, (count - first)*sizeof(Sint16));
+	ev.ring_write += count;
+}
+
+static void close_decoder(StreamDecoder &dec)
+{
+	if (dec.open) {
+		ov_clear(&dec.oggv);
+		dec.ogg_data_stream.Reset();
+		dec.open = false;
+	}
+	dec.serial = 0;
+}
+
+static bool open_decoder(StreamDecoder &dec, const std::string &path)
+{
+	RefCountedPtr<FileSystem::FileData> oggdata = FileSystem::gameDataFiles.ReadFile(path);
+	if (!oggdata) {
+		fprintf(stderr, "Could not open '%s'", path.c_str());
+		return false;
+	}
+	dec.ogg_data_stream.Reset(oggdata);
+	oggdata.Reset();
+	if (ov_open_callbacks(&dec.ogg_data_stream, &dec.oggv, 0, 0, OggFileDataStream::CALLBACKS) < 0) {
+		fprintf(stderr, "Vorbis could not understand '%s'", path.c_str());
+		dec.ogg_data_stream.Reset();
+		return false;
+	}
+	dec.open = true;
+	return true;
+}
+
+// fill the ring of one wavstream as far as it'll go. the file is opened and
+// decoded without the audio locked, it's only locked to look at the event
+// and to copy into the ring
+static void decode_stream(unsigned int idx, Sint16 *chunk)
+{
+	SoundEvent &ev = wavstream[idx];
+	StreamDecoder &dec = stream_decoder[idx];
+
+	SDL_LockAudio();
+	const Sample *sample = ev.sample;
+	const Uint32 serial = (sample && ev.streamed) ? ev.stream_serial : 0;
+	const bool repeat = (ev.op & OP_REPEAT) != 0;
+	const bool eof = ev.stream_eof;
+	const Uint32 space = STREAM_RING_SIZE - (ev.ring_write - ev.ring_read);
+	SDL_UnlockAudio();
+
+	if (serial != dec.serial) {
+		close_decoder(dec);
+		dec.serial = serial;
+		if (serial && !open_decoder(dec, sample->path)) {
+			SDL_LockAudio();
+			if (ev.sample && ev.stream_serial == serial) ev.stream_eof = true;
+			SDL_UnlockAudio();
+			return;
+		}
+	}
+	if (!dec.open || eof) return;
+
+	// whole sample frames only
+	const int wanted = int(space - space % sample->channels) * 2;
+	if (wanted < int(STREAM_RING_SIZE / 2)) return;
+
+	int got = 0;
+	bool ended = false, rewound = false;
+	while (got < wanted) {
+		int music_section;
+		const int amt = ov_read(&dec.oggv, reinterpret_cast<char*>(chunk) + got,
+				wanted - got, 0, 2, 1, &music_section);
+		if (amt > 0) {
+			got += amt;
+			rewound = false;
+		}
+		else if (amt == 0 && repeat && !rewound) {
+			ov_pcm_seek(&dec.oggv, 0);
+			rewound = true;
+		}
+		else {
+			ended = true;
+			break;
+		}
+	}
+
+	SDL_LockAudio();
+	if (ev.sample && ev.stream_serial == serial) {
+		write_stream(ev, chunk, got / 2);
+		if (ended) ev.stream_eof = true;
+	}
+	SDL_UnlockAudio();
+}
+
+// the whole of a sample, or 0 if it can't be read
+static Uint16 *decode_sample(const Sample &sample)
+{
+	StreamDecoder dec;
+	dec.open = false;
+	if (!open_decoder(dec, sample.path)) return 0;
+
+	Uint16 *buf = new Uint16[sample.buf_len];
+	Uint32 i = 0;
+	while (i < 2*sample.buf_len) {
+		int music_section;
+		int amt = ov_read(&dec.oggv, reinterpret_cast<char*>(buf) + i,
+				2*sample.buf_len - i, 0, 2, 1, &music_section);
+		if (amt <= 0) break;
+		i += amt;
+	}
+	// anything short is silence
+	memset(reinterpret_cast<char*>(buf) + i, 0, 2*sample.buf_len - i);
+
+	close_decoder(dec);
+	return buf;
+}
+
+// with the audio locked. true if an event is playing from the sample's buf
+static bool sample_in_use(const Sample *sample)
+{
+	for (unsigned int i = 0; i < MAX_WAVSTREAMS; i++) {
+		if (wavstream[i].sample == sample && !wavstream[i].streamed)
+			return true;
+	}
+	return false;
+}
+
+// decode one sample that's wanted into the cache, making room for it by
+// dropping the least recently used ones that aren't playing
+static void cache_sample()
+{
+	Sample *sample = 0;
+	SDL_LockAudio();
+	for (std::map<std::string, Sample>::iterator i = sfx_samples.begin(); i != sfx_samples.end(); ++i) {
+		if (i->second.wanted) {
+			sample = &i->second;
+			sample->wanted = false;
+			break;
+		}
+	}
+	SDL_UnlockAudio();
+	if (!sample || sample->buf) return;
+
+	Uint16 *buf = decode_sample(*sample);
+	if (!buf) return;
+	const Uint32 size = sample->buf_len * sizeof(Uint16);
+
+	std::vector<Uint16*> dropped;
+	Uint32 droppedBytes = 0;
+	SDL_LockAudio();
+	while (sample_cache_used + size > SAMPLE_CACHE_SIZE) {
+		Sample *lru = 0;
+		for (std::map<std::string, Sample>::iterator i = sfx_samples.begin(); i != sfx_samples.end(); ++i) {
+			Sample &s = i->second;
+			if (s.buf && (!lru || s.last_used < lru->last_used) && !sample_in_use(&s))
+				lru = &s;
+		}
+		if (!lru) break;
+		dropped.push_back(lru->buf);
+		lru->buf = 0;
+		sample_cache_used -= lru->buf_len * sizeof(Uint16);
+		droppedBytes += lru->buf_len * sizeof(Uint16);
+	}
+	sample->buf = buf;
+	sample_cache_used += size;
+	SDL_UnlockAudio();
+
+	MemoryStats::Remove(MemoryStats::SOUND, droppedBytes);
+	MemoryStats::Add(MemoryStats::SOUND, size);
+
+	for (std::vector<Uint16*>::iterator i = dropped.begin(); i != dropped.end(); ++i)
+		delete[] *i;
+}
+
+static int decoder_main(void *)
+{
+	std::vector<Sint16> chunk(STREAM_RING_SIZE);
+	while (!decoder_quit) {
+		for (unsigned int i = 0; i < MAX_WAVSTREAMS; i++)
+			decode_stream(i, &chunk[0]);
+		cache_sample();
+		SDL_SemWaitTimeout(decoder_wake, STREAM_DECODE_INTERVAL);
+	}
+	for (unsigned int i = 0; i < MAX_WAVSTREAMS; i++)
+		close_decoder(stream_decoder[i]);
+	return 0;
+}
+
+// how much it matters that the event keeps playing
+static float event_loudness(const SoundEvent &ev)
+{
+	return std::max(std::max(ev.volume[0], ev.volume[1]), std::max(ev.targetVolume[0], ev.targetVolume[1]));
+}
+
+// with the audio locked. a free virtual voice, or 0
+static SoundEvent *free_virtual_voice()
+{
+	for (unsigned int i = 0; i < MAX_VIRTUAL_VOICES; i++) {
+		if (!virtual_voice[i].sample) return &virtual_voice[i];
+	}
+	return 0;
+}
+
+// with the audio locked. take the event off its wavstream, keeping it as a
+// virtual voice if it repeats
+static void RetireEvent(SoundEvent *ev)
+{
+	if (ev->op & OP_REPEAT) {
+		SoundEvent *v = free_virtual_voice();
+		if (v) *v = *ev;
+	}
+	DestroyEvent(ev);
+}
+
+// with the audio locked, from the callback. put the loudest virtual voices
+// back on any free sfx wavstreams, and move the rest along their volume
+// animations as if they were playing
+static void update_virtual_voices(int num_frames)
+{
+	for (unsigned int i = 0; i < MAX_VIRTUAL_VOICES; i++) {
+		SoundEvent &v = virtual_voice[i];
+		if (!v.sample) continue;
+		for (int chan=0; chan<2; chan++) {
+			const float change = v.rateOfChange[chan] * float(num_frames);
+			if (v.targetVolume[chan] > v.volume[chan])
+				v.volume[chan] = std::min(v.volume[chan] + change, v.targetVolume[chan]);
+			else
+				v.volume[chan] = std::max(v.volume[chan] - change, v.targetVolume[chan]);
+		}
+		if (!(v.op & OP_REPEAT) || ((v.op & OP_STOP_AT_TARGET_VOLUME) &&
+				(v.targetVolume[0] <= v.volume[0]) && (v.targetVolume[1] <= v.volume[1])))
+			DestroyEvent(&v);
+	}
+
+	for (unsigned int idx = 2; idx < MAX_WAVSTREAMS; idx++) {
+		if (wavstream[idx].sample) continue;
+		SoundEvent *loudest = 0;
+		for (unsigned int i = 0; i < MAX_VIRTUAL_VOICES; i++) {
+			if (virtual_voice[i].sample && (!loudest || event_loudness(virtual_voice[i]) > event_loudness(*loudest)))
+				loudest = &virtual_voice[i];
+		}
+		if (!loudest) break;
+		wavstream[idx] = *loudest;
+		wavstream[idx].buf_pos = 0;
+		DestroyEvent(loudest);
+		StartStream(&wavstream[idx]);
+	}
+}
+
 /*
  * Volume should be 0-65535
  */
 static Uint32 identifier = 1;
 eventid PlaySfx (const char *fx, const float volume_left, const float volume_right, const Op op)
 {
+	const float left = volume_left * GetSfxVolume();
+	const float right = volume_right * GetSfxVolume();
+	const float loudness = std::max(left, right);
+
+	// nobody would hear it. repeating sounds are often started silent and
+	// faded in, so they're kept
+	if (loudness < MIN_AUDIBLE_VOLUME && !(op & OP_REPEAT)) return 0;
+
+	const Sample *sample = GetSample(fx);
+	if (!sample) return 0;
+
 	SDL_LockAudio();
-	unsigned int idx;
-	Uint32 age;
-	/* find free wavstream (first two reserved for music) */
-	for (idx = 2; idx < MAX_WAVSTREAMS; idx++) {
-		if (!wavstream[idx].sample) break;
-	}
-	if (idx == MAX_WAVSTREAMS) {
-		/* otherwise overwrite oldest one */
-		age = 0; idx = 0;
-		for (unsigned int i = 2; i < MAX_WAVSTREAMS; i++) {
-			if ((i==0) || (wavstream[i].buf_pos > age)) {
-				idx = i;
-				age = wavstream[i].buf_pos;
-			}
+	SoundEvent *ev = 0;
+
+	/* if there are too many of this sample already, it can only replace the
+	 * quietest of them. otherwise it takes a free wavstream (the first two
+	 * are reserved for music) or the quietest one */
+	int same = 0;
+	SoundEvent *quietest_same = 0, *quietest = 0;
+	for (unsigned int idx = 2; idx < MAX_WAVSTREAMS; idx++) {
+		SoundEvent &e = wavstream[idx];
+		if (!e.sample) {
+			if (!ev) ev = &e;
+			continue;
+		}
+		if (!quietest || event_loudness(e) < event_loudness(*quietest)) quietest = &e;
+		if (e.sample == sample) {
+			same++;
+			if (!quietest_same || event_loudness(e) < event_loudness(*quietest_same)) quietest_same = &e;
 		}
-		DestroyEvent(&wavstream[idx]);
 	}
-	wavstream[idx].sample = GetSample(fx);
-	wavstream[idx].oggv = 0;
-	wavstream[idx].buf_pos = 0;
-	wavstream[idx].volume[0] = volume_left * GetSfxVolume();
-	wavstream[idx].volume[1] = volume_right * GetSfxVolume();
-	wavstream[idx].op = op;
-	wavstream[idx].identifier = identifier;
-	wavstream[idx].targetVolume[0] = volume_left * GetSfxVolume();
-	wavstream[idx].targetVolume[1] = volume_right * GetSfxVolume();
-	wavstream[idx].rateOfChange[0] = wavstream[idx].rateOfChange[1] = 0.0f;
+	if (same >= MAX_VOICES_PER_SAMPLE)
+		ev = quietest_same;
+	else if (!ev)
+		ev = quietest;
+
+	if (ev && ev->sample) {
+		if (event_loudness(*ev) < loudness)
+			RetireEvent(ev);
+		else
+			ev = 0;
+	}
+
+	if (!ev && (op & OP_REPEAT))
+		ev = free_virtual_voice();
+	if (!ev) {
+		SDL_UnlockAudio();
+		return 0;
+	}
+
+	ev->sample = sample;
+	ev->buf_pos = 0;
+	ev->volume[0] = left;
+	ev->volume[1] = right;
+	ev->op = op;
+	ev->identifier = identifier;
+	ev->targetVolume[0] = left;
+	ev->targetVolume[1] = right;
+	ev->rateOfChange[0] = ev->rateOfChange[1] = 0.0f;
+	StartStream(ev);
 	SDL_UnlockAudio();
+	if (decoder_wake) SDL_SemPost(decoder_wake);
 	return identifier++;
 }
 
+void Preload(const char *fx)
+{
+	SDL_LockAudio();
+	Sample *sample = GetSample(fx);
+	const bool wanted = sample && !sample->buf && !sample->stream;
+	if (wanted) sample->wanted = true;
+	SDL_UnlockAudio();
+	if (wanted && decoder_wake) SDL_SemPost(decoder_wake);
+}
+
 //unlike PlaySfx, we want uninterrupted play and do not care about age
 //alternate between two streams for crossfade
 static int nextMusicStream = 0;
@@ -270,7 +639,6 @@ eventid PlayMusic(const char *fx, const float volume_left, const float volume_ri
 	if (wavstream[idx].sample)
 		DestroyEvent(&wavstream[idx]);
 	wavstream[idx].sample = GetSample(fx);
-	wavstream[idx].oggv = 0;
 	wavstream[idx].buf_pos = 0;
 	wavstream[idx].volume[0] = volume_left;
 	wavstream[idx].volume[1] = volume_right;
@@ -279,114 +647,117 @@ eventid PlayMusic(const char *fx, const float volume_left, const float volume_ri
 	wavstream[idx].targetVolume[0] = volume_left; //already scaled in MusicPlayer
 	wavstream[idx].targetVolume[1] = volume_right;
 	wavstream[idx].rateOfChange[0] = wavstream[idx].rateOfChange[1] = 0.0f;
+	StartStream(&wavstream[idx]);
 	SDL_UnlockAudio();
+	if (decoder_wake) SDL_SemPost(decoder_wake);
 	return identifier++;
 }
 
+/*
+ * turn count values of input into stereo frames at the output rate. 22050hz
+ * is interpolated linearly, from the last frame of the previous block. returns
+ * the number of floats written, two per frame
+ */
+template <int T_channels, int T_upsample>
+static int unpack_input(float *out, const Sint16 *in, int count, float prev[2])
+{
+	int o = 0;
+	for (int i = 0; i < count; i += T_channels) {
+		const float l = float(in[i]);
+		const float r = (T_channels == 1) ? l : float(in[i+1]);
+		if (T_upsample == 2) {
+			out[o++] = 0.5f * (prev[0] + l);
+			out[o++] = 0.5f * (prev[1] + r);
+		}
+		out[o++] = l;
+		out[o++] = r;
+		prev[0] = l;
+		prev[1] = r;
+	}
+	return o;
+}
+
+/*
+ * add len floats of frames to buffer, with the volume ramped linearly over
+ * the block from where it is toward the target
+ */
+static void mix_block(float *buffer, const float *frames, int len, SoundEvent &ev)
+{
+	const int num_frames = len / 2;
+	if (!num_frames) return;
+
+	float start[2], step[2];
+	for (int chan=0; chan<2; chan++) {
+		start[chan] = ev.volume[chan];
+		const float change = ev.rateOfChange[chan] * float(num_frames);
+		const float end = ev.ascend[chan] ?
+			std::min(start[chan] + change, ev.targetVolume[chan]) :
+			std::max(start[chan] - change, ev.targetVolume[chan]);
+		step[chan] = (end - start[chan]) / float(num_frames);
+		ev.volume[chan] = end;
+	}
+
+	int pos = 0;
+#ifdef SOUND_USE_SSE2
+	// two frames at a time
+	__m128 vol = _mm_setr_ps(start[0], start[1], start[0] + step[0], start[1] + step[1]);
+	const __m128 vol_step = _mm_setr_ps(2.0f*step[0], 2.0f*step[1], 2.0f*step[0], 2.0f*step[1]);
+	for (; pos+4 <= len; pos += 4) {
+		const __m128 mixed = _mm_add_ps(_mm_loadu_ps(buffer + pos), _mm_mul_ps(_mm_loadu_ps(frames + pos), vol));
+		_mm_storeu_ps(buffer + pos, mixed);
+		vol = _mm_add_ps(vol, vol_step);
+	}
+#endif
+	for (; pos < len; pos += 2) {
+		const float f = float(pos / 2);
+		buffer[pos] += frames[pos] * (start[0] + step[0] * f);
+		buffer[pos+1] += frames[pos+1] * (start[1] + step[1] * f);
+	}
+}
+
 /*
  * len is the number of floats to put in buffer, NOT full samples (a sample would be 2 floats since stereo)
  */
 template <int T_channels, int T_upsample>
 static void fill_audio_1stream(float *buffer, int len, int stream_num)
 {
+	float *frames = static_cast<float*>(alloca(sizeof(float)*len));
 	// inbuf will be smaller for mono and for 22050hz samples
 	Sint16 *inbuf = static_cast<Sint16*>(alloca(len*T_channels / T_upsample));
 	// hm pity to put this here ^^ since not used by ev.sample->buf case
 	SoundEvent &ev = wavstream[stream_num];
-	int inbuf_pos = 0;
 	int pos = 0;
 	while ((pos < len) && ev.sample) {
-		if (ev.sample->buf) {
+		// values of input it takes to fill the rest of the buffer
+		const int wanted = (len-pos)*T_channels / (2*T_upsample);
+
+		const Sint16 *in;
+		int in_len;
+		if (!ev.streamed) {
 			// already decoded
-			inbuf = reinterpret_cast<Sint16 *>(ev.sample->buf);
-			inbuf_pos = ev.buf_pos;
+			in = reinterpret_cast<const Sint16 *>(ev.sample->buf) + ev.buf_pos;
+			in_len = std::min(wanted, int(ev.sample->buf_len - ev.buf_pos));
 		} else {
-			// stream ogg vorbis
-			// ogg vorbis streaming
-			if (!ev.oggv) {
-				// open file to start streaming
-				ev.oggv = new OggVorbis_File;
-				RefCountedPtr<FileSystem::FileData> oggdata = FileSystem::gameDataFiles.ReadFile(ev.sample->path);
-				if (!oggdata) {
-					fprintf(stderr, "Could not open '%s'", ev.sample->path.c_str());
-					ev.sample = 0;
-					return;
-				}
-				ev.ogg_data_stream.Reset(oggdata);
-				oggdata.Reset();
-				if (ov_open_callbacks(&ev.ogg_data_stream, ev.oggv, 0, 0, OggFileDataStream::CALLBACKS) < 0) {
-					fprintf(stderr, "Vorbis could not understand '%s'", ev.sample->path.c_str());
-					ev.sample = 0;
-					return;
-				}
-			}
-			int i=0;
-			// (len-pos) = num floats the destination buffer wants.
-			// if we are stereo then to fill this we need (len-pos)*2 bytes
-			// if we are mono we want (len-pos) bytes
-			int wanted_bytes = (len-pos)*T_channels / T_upsample;
-			for (;;) {
-				int music_section;
-				if (wanted_bytes == 0) break;
-				int amt = ov_read(ev.oggv, reinterpret_cast<char*>(inbuf) + i,
-						wanted_bytes, 0, 2, 1, &music_section);
-				i += amt;
-				wanted_bytes -= amt;
-				if (amt == 0) break;
+			// streamed, whatever the decoder thread has got ready
+			in = inbuf;
+			in_len = read_stream(ev, inbuf, wanted);
+			if (in_len == 0) {
+				if (ev.stream_eof) DestroyEvent(&ev);
+				// else the decoder's fallen behind. it'll catch up
+				break;
 			}
 		}
 
-		while (pos < len) {
-			/* Volume animations */
-			for (int chan=0; chan<2; chan++) {
-				if (ev.ascend[chan]) {
-					ev.volume[chan] = std::min(ev.volume[chan] + ev.rateOfChange[chan], ev.targetVolume[chan]);
-				} else {
-					ev.volume[chan] = std::max(ev.volume[chan] - ev.rateOfChange[chan], ev.targetVolume[chan]);
-				}
-			}
+		const int n = unpack_input<T_channels,T_upsample>(frames, in, in_len, ev.prev);
+		mix_block(buffer + pos, frames, n, ev);
+		pos += n;
+		ev.buf_pos += in_len;
 
-			float s0, s1;
-
-			if (T_channels == 1) {
-				s0 = float(inbuf[inbuf_pos++]);
-				s1 = ev.volume[1] * s0;
-				s0 = ev.volume[0] * s0;
-				ev.buf_pos += 1;
-			} else /* stereo */ {
-				s0 = ev.volume[0] * float(inbuf[inbuf_pos++]);
-				s1 = ev.volume[1] * float(inbuf[inbuf_pos++]);
-				ev.buf_pos += 2;
-			}
-
-			if (T_upsample == 1) {
-				buffer[pos] += s0;
-				buffer[pos+1] += s1;
-				pos += 2;
-			} else {
-				buffer[pos] += s0;
-				buffer[pos+1] += s1;
-				buffer[pos+2] += s0;
-				buffer[pos+3] += s1;
-				pos += 4;
-			}
-
-			/* Repeat or end? */
-			if (ev.buf_pos >= ev.sample->buf_len) {
-				ev.buf_pos = 0;
-				inbuf_pos = 0;
-				if (!(ev.op & OP_REPEAT)) {
-					DestroyEvent(&ev);
-					break;
-				}
-				if (ev.oggv) {
-					// streaming ogg
-					ov_pcm_seek(ev.oggv, 0);
-					// repeat outer loop to decode some
-					// more vorbis from the start of the stream
-					break;
-				}
-			}
+		/* Repeat or end? streams are rewound by the decoder */
+		if (!ev.streamed && ev.buf_pos >= ev.sample->buf_len) {
+			ev.buf_pos = 0;
+			if (!(ev.op & OP_REPEAT))
+				DestroyEvent(&ev);
 		}
 	}
 }
@@ -426,10 +797,24 @@ static void fill_audio(void *udata, Uint8 *dsp_buf, int len)
 		}
 	}
 
+	update_virtual_voices(len_in_floats / 2);
+
 	/* Convert float sample buffer to Sint16 samples the hardware likes */
-	for (int pos=0; pos<len_in_floats; pos++) {
+	Sint16 *out = reinterpret_cast<Sint16*>(dsp_buf);
+	int pos = 0;
+#ifdef SOUND_USE_SSE2
+	const __m128 vol = _mm_set1_ps(m_masterVol);
+	const __m128 lo = _mm_set1_ps(-32768.0f);
+	const __m128 hi = _mm_set1_ps(32767.0f);
+	for (; pos+8 <= len_in_floats; pos += 8) {
+		const __m128 a = _mm_min_ps(_mm_max_ps(_mm_mul_ps(_mm_loadu_ps(tmpbuf + pos), vol), lo), hi);
+		const __m128 b = _mm_min_ps(_mm_max_ps(_mm_mul_ps(_mm_loadu_ps(tmpbuf + pos + 4), vol), lo), hi);
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(out + pos), _mm_packs_epi32(_mm_cvttps_epi32(a), _mm_cvttps_epi32(b)));
+	}
+#endif
+	for (; pos<len_in_floats; pos++) {
 		const float val = m_masterVol * tmpbuf[pos];
-		(reinterpret_cast<Sint16*>(dsp_buf))[pos] = Sint16(Clamp(val, -32768.0f, 32767.0f));
+		out[pos] = Sint16(Clamp(val, -32768.0f, 32767.0f));
 	}
 }
 
@@ -440,6 +825,9 @@ void DestroyAllEvents()
 	for (unsigned int idx = 0; idx < MAX_WAVSTREAMS; idx++) {
 		DestroyEvent(&wavstream[idx]);
 	}
+	for (unsigned int idx = 0; idx < MAX_VIRTUAL_VOICES; idx++) {
+		DestroyEvent(&virtual_voice[idx]);
+	}
 	SDL_UnlockAudio();
 }
 
@@ -482,19 +870,10 @@ static void load_sound(const std::string &basename, const std::string &path, boo
 	const float seconds = num_samples/float(info->rate);
 	//printf("%f seconds\n", seconds);
 
-	// immediately decode and store as raw sample if short enough
-	if (seconds < STREAM_IF_LONGER_THAN) {
-		sample.buf = new Uint16[sample.buf_len];
-
-		int i=0;
-		for (;;) {
-			int music_section;
-			int amt = ov_read(&oggv, reinterpret_cast<char*>(sample.buf) + i,
-					2*sample.buf_len - i, 0, 2, 1, &music_section);
-			i += amt;
-			if (amt == 0) break;
-		}
-	}
+	// short ones are decoded when they're first wanted
+	sample.stream = (seconds >= STREAM_IF_LONGER_THAN);
+	sample.wanted = false;
+	sample.last_used = 0;
 
 	if (is_music) {
 		sample.isMusic = true;
@@ -534,6 +913,10 @@ bool Init ()
 			return false;
 		}
 
+		decoder_quit = false;
+		decoder_wake = SDL_CreateSemaphore(0);
+		decoder_thread = SDL_CreateThread(&decoder_main, 0);
+
 		// load all the wretched effects
 		for (FileSystem::FileEnumerator files(FileSystem::gameDataFiles, "sounds", FileSystem::FileEnumerator::Recurse); !files.Finished(); files.Next()) {
 			const FileSystem::FileInfo &info = files.Current();
@@ -558,8 +941,20 @@ bool Init ()
 void Uninit ()
 {
 	DestroyAllEvents();
+	if (decoder_thread) {
+		decoder_quit = true;
+		SDL_SemPost(decoder_wake);
+		SDL_WaitThread(decoder_thread, 0);
+		decoder_thread = 0;
+	}
+	if (decoder_wake) {
+		SDL_DestroySemaphore(decoder_wake);
+		decoder_wake = 0;
+	}
 	std::map<std::string, Sample>::iterator i;
 	for (i=sfx_samples.begin(); i!=sfx_samples.end(); ++i) delete[] (*i).second.buf;
+	MemoryStats::Remove(MemoryStats::SOUND, sample_cache_used);
+	sample_cache_used = 0;
 	SDL_CloseAudio ();
 }
 
@@ -625,19 +1020,15 @@ bool Event::VolumeAnimate(const float targetVol1, const float targetVol2, const
 bool Event::SetVolume(const float vol_left, const float vol_right)
 {
 	SDL_LockAudio();
-	bool status = false;
-	for (unsigned int i = 0; i < MAX_WAVSTREAMS; i++) {
-		if (wavstream[i].sample && (wavstream[i].identifier == eid)) {
-			wavstream[i].volume[0] = vol_left;
-			wavstream[i].volume[1] = vol_right;
-			wavstream[i].targetVolume[0] = vol_left;
-			wavstream[i].targetVolume[1] = vol_right;
-			status = true;
-			break;
-		}
+	SoundEvent *ev = GetEvent(eid);
+	if (ev) {
+		ev->volume[0] = vol_left;
+		ev->volume[1] = vol_right;
+		ev->targetVolume[0] = vol_left;
+		ev->targetVolume[1] = vol_right;
 	}
 	SDL_UnlockAudio();
-	return status;
+	return (ev != 0);
 }
 
 const std::map<std::string, Sample> & GetSamples()
@@ -19,13 +19,19 @@ enum {
 typedef Uint32 Op;
 
 struct Sample {
-	Uint16 *buf;
+	Uint16 *buf; // decoded, or null if it isn't in the cache
 	Uint32 buf_len;
 	Uint32 channels;
 	int upsample; // 1 = 44100, 2=22050
 	/* if buf is null, this will be path to an ogg we must stream */
 	std::string path;
 	bool isMusic;
+	/* long samples are always streamed. short ones are decoded into buf on
+	 * first use or when preloaded, and dropped again, least recently used
+	 * first, when the cache is full. until then they're streamed too */
+	bool stream;
+	bool wanted; // should be decoded into buf
+	Uint32 last_used;
 };
 
 class Event {
@@ -61,6 +67,10 @@ void DestroyAllEvents();
 void Pause (int on);
 eventid PlaySfx (const char *fx, const float volume_left, const float volume_right, const Op op);
 eventid PlayMusic (const char *fx, const float volume_left, const float volume_right, const Op op);
+/**
+ * Decode a sample in the background, so it's ready when it's played.
+ */
+void Preload (const char *fx);
 inline static eventid PlaySfx (const char *fx) { return PlaySfx(fx, 1.0f, 1.0f, 0); }
 eventid BodyMakeNoise(const Body *b, const char *fx, float vol);
 void SetMasterVolume(const float vol);
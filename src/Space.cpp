@@ -4,6 +4,7 @@
 #include "libs.h"
 #include "Space.h"
 #include "Body.h"
+#include "BodyPool.h"
 #include "Frame.h"
 #include "Star.h"
 #include "Planet.h"
@@ -25,15 +26,51 @@
 #include "Game.h"
 #include "MathUtil.h"
 #include "LuaEvent.h"
+#include "JobQueue.h"
+#include "Profiler.h"
+#include "SDL_thread.h"
+
+// edge length of a grid cell. big enough that the usual searches around a
+// ship (missile proximity, ECM, the 100km alert radius) only touch a handful
+// of cells
+static const double BODY_NEAR_CELL_SIZE = 50000.0;
+
+//static
+Space::BodyNearFinder::CellPos Space::BodyNearFinder::GetCellPos(const vector3d &pos)
+{
+	CellPos c;
+	c.x = Sint64(floor(pos.x / BODY_NEAR_CELL_SIZE));
+	c.y = Sint64(floor(pos.y / BODY_NEAR_CELL_SIZE));
+	c.z = Sint64(floor(pos.z / BODY_NEAR_CELL_SIZE));
+	return c;
+}
 
 void Space::BodyNearFinder::Prepare()
 {
-	m_bodyDist.clear();
+	m_bodyPos.clear();
+	m_cells.clear();
 
-	for (Space::BodyIterator i = m_space->BodiesBegin(); i != m_space->BodiesEnd(); ++i)
-		m_bodyDist.push_back(BodyDist((*i), (*i)->GetPositionRelTo(m_space->GetRootFrame()).Length()));
+	for (Space::BodyIterator i = m_space->BodiesBegin(); i != m_space->BodiesEnd(); ++i) {
+		const vector3d pos = (*i)->GetPositionRelTo(m_space->GetRootFrame());
+		m_bodyPos.push_back(BodyPos((*i), pos, GetCellPos(pos)));
+	}
+
+	std::sort(m_bodyPos.begin(), m_bodyPos.end());
+
+	for (Uint32 i = 0; i < m_bodyPos.size(); i++) {
+		if (m_cells.empty() || !(m_cells.back().pos == m_bodyPos[i].cell))
+			m_cells.push_back(Cell(m_bodyPos[i].cell, i));
+		m_cells.back().count++;
+	}
+}
 
-	std::sort(m_bodyDist.begin(), m_bodyDist.end());
+void Space::BodyNearFinder::GatherCell(const Cell &cell, const vector3d &pos, double distSqr, BodyNearList &bodies) const
+{
+	for (Uint32 i = cell.first; i < cell.first + cell.count; i++) {
+		const BodyPos &bp = m_bodyPos[i];
+		if ((bp.pos - pos).LengthSqr() <= distSqr)
+			bodies.push_back(bp.body);
+	}
 }
 
 void Space::BodyNearFinder::GetBodiesMaybeNear(const Body *b, double dist, BodyNearList &bodies) const
@@ -43,16 +80,32 @@ void Space::BodyNearFinder::GetBodiesMaybeNear(const Body *b, double dist, BodyN
 
 void Space::BodyNearFinder::GetBodiesMaybeNear(const vector3d &pos, double dist, BodyNearList &bodies) const
 {
-	if (m_bodyDist.empty()) return;
-
-	const double len = pos.Length();
-
-	std::vector<BodyDist>::const_iterator min = std::lower_bound(m_bodyDist.begin(), m_bodyDist.end(), len-dist);
-	std::vector<BodyDist>::const_iterator max = std::upper_bound(min, m_bodyDist.end(), len+dist);
+	if (m_cells.empty()) return;
+
+	const double distSqr = dist*dist;
+	const CellPos lo = GetCellPos(pos - vector3d(dist));
+	const CellPos hi = GetCellPos(pos + vector3d(dist));
+
+	// each column of cells along z costs a binary search. when the search
+	// is wide enough that there are more columns than occupied cells it's
+	// cheaper to just go through the occupied ones
+	if (double(hi.x - lo.x + 1) * double(hi.y - lo.y + 1) >= double(m_cells.size())) {
+		for (std::vector<Cell>::const_iterator i = m_cells.begin(); i != m_cells.end(); ++i) {
+			const CellPos &c = (*i).pos;
+			if (c.x >= lo.x && c.x <= hi.x && c.y >= lo.y && c.y <= hi.y && c.z >= lo.z && c.z <= hi.z)
+				GatherCell(*i, pos, distSqr, bodies);
+		}
+		return;
+	}
 
-	while (min != max) {
-		bodies.push_back((*min).body);
-		++min;
+	for (Sint64 x = lo.x; x <= hi.x; x++) {
+		for (Sint64 y = lo.y; y <= hi.y; y++) {
+			CellPos start;
+			start.x = x; start.y = y; start.z = lo.z;
+			std::vector<Cell>::const_iterator i = std::lower_bound(m_cells.begin(), m_cells.end(), Cell(start, 0));
+			for (; i != m_cells.end() && (*i).pos.x == x && (*i).pos.y == y && (*i).pos.z <= hi.z; ++i)
+				GatherCell(*i, pos, distSqr, bodies);
+		}
 	}
 }
 
@@ -91,7 +144,7 @@ Space::Space(Game *game, const SystemPath &path)
 	m_rootFrame.Reset(new Frame(0, Lang::SYSTEM));
 	m_rootFrame->SetRadius(FLT_MAX);
 
-	GenBody(m_starSystem->rootBody.Get(), m_rootFrame.Get());
+	GenBody(m_starSystem->rootBody, m_rootFrame.Get());
 	m_rootFrame->UpdateOrbitRails(m_game->GetTime(), m_game->GetTimeStep());
 
 	//DebugDumpFrames();
@@ -120,20 +173,22 @@ Space::Space(Game *game, Serializer::Reader &rd)
 
 	Uint32 nbodies = rd.Int32();
 	for (Uint32 i = 0; i < nbodies; i++)
-		m_bodies.push_back(Body::Unserialize(rd, this));
+		AddBody(Body::Unserialize(rd, this));
 	RebuildBodyIndex();
 
 	Frame::PostUnserializeFixup(m_rootFrame.Get(), this);
-	for (BodyIterator i = m_bodies.begin(); i != m_bodies.end(); ++i)
+	for (BodyIterator i = BodiesBegin(); i != BodiesEnd(); ++i)
 		(*i)->PostLoadFixup(this);
 }
 
 Space::~Space()
 {
 	UpdateBodies(); // make sure anything waiting to be removed gets removed before we go and kill everything else
-	for (std::list<Body*>::iterator i = m_bodies.begin(); i != m_bodies.end(); ++i)
+	for (std::vector<Body*>::iterator i = m_bodies.begin(); i != m_bodies.end(); ++i)
 		KillBody(*i);
 	UpdateBodies();
+
+	BodyPoolBase::FreeAll();
 }
 
 void Space::Serialize(Serializer::Writer &wr)
@@ -149,7 +204,7 @@ void Space::Serialize(Serializer::Writer &wr)
 	wr.WrSection("Frames", section.GetData());
 
 	wr.Int32(m_bodies.size());
-	for (BodyIterator i = m_bodies.begin(); i != m_bodies.end(); ++i)
+	for (BodyIterator i = BodiesBegin(); i != BodiesEnd(); ++i)
 		(*i)->Serialize(wr, this);
 }
 
@@ -174,31 +229,45 @@ SystemBody *Space::GetSystemBodyByIndex(Uint32 idx) const
 	return m_sbodyIndex[idx];
 }
 
-Uint32 Space::GetIndexForFrame(const Frame *frame) const
+// the lookups are sorted (pointer, index) pairs, built along with each
+// index, so finding the index of a pointer is a binary search instead of a
+// walk through everything
+template <typename T>
+static void build_lookup(const std::vector<T*> &index, std::vector< std::pair<const T*,Uint32> > &lookup)
 {
-	assert(m_frameIndexValid);
-	for (Uint32 i = 0; i < m_frameIndex.size(); i++)
-		if (m_frameIndex[i] == frame) return i;
+	lookup.clear();
+	lookup.reserve(index.size());
+	for (Uint32 i = 0; i < index.size(); i++)
+		lookup.push_back(std::make_pair(static_cast<const T*>(index[i]), i));
+	std::sort(lookup.begin(), lookup.end());
+}
+
+template <typename T>
+static Uint32 find_in_lookup(const std::vector< std::pair<const T*,Uint32> > &lookup, const T *p)
+{
+	typename std::vector< std::pair<const T*,Uint32> >::const_iterator i =
+		std::lower_bound(lookup.begin(), lookup.end(), std::make_pair(p, Uint32(0)));
+	if (i != lookup.end() && i->first == p) return i->second;
 	assert(0);
 	return Uint32(-1);
 }
 
+Uint32 Space::GetIndexForFrame(const Frame *frame) const
+{
+	assert(m_frameIndexValid);
+	return find_in_lookup(m_frameLookup, frame);
+}
+
 Uint32 Space::GetIndexForBody(const Body *body) const
 {
 	assert(m_bodyIndexValid);
-	for (Uint32 i = 0; i < m_bodyIndex.size(); i++)
-		if (m_bodyIndex[i] == body) return i;
-	assert(0);
-	return Uint32(-1);
+	return find_in_lookup(m_bodyLookup, body);
 }
 
 Uint32 Space::GetIndexForSystemBody(const SystemBody *sbody) const
 {
 	assert(m_sbodyIndexValid);
-	for (Uint32 i = 0; i < m_sbodyIndex.size(); i++)
-		if (m_sbodyIndex[i] == sbody) return i;
-	assert(0);
-	return Uint32(-1);
+	return find_in_lookup(m_sbodyLookup, sbody);
 }
 
 void Space::AddFrameToIndex(Frame *frame)
@@ -219,21 +288,27 @@ void Space::AddSystemBodyToIndex(SystemBody *sbody)
 
 void Space::RebuildFrameIndex()
 {
+	// the frame tree hardly ever changes shape, so last time's size is a
+	// good guess
+	const size_t lastSize = m_frameIndex.size();
 	m_frameIndex.clear();
+	m_frameIndex.reserve(lastSize);
 	m_frameIndex.push_back(0);
 
 	if (m_rootFrame)
 		AddFrameToIndex(m_rootFrame.Get());
 
+	build_lookup(m_frameIndex, m_frameLookup);
 	m_frameIndexValid = true;
 }
 
 void Space::RebuildBodyIndex()
 {
 	m_bodyIndex.clear();
+	m_bodyIndex.reserve(m_bodies.size()+1);
 	m_bodyIndex.push_back(0);
 
-	for (BodyIterator i = m_bodies.begin(); i != m_bodies.end(); ++i) {
+	for (BodyIterator i = BodiesBegin(); i != BodiesEnd(); ++i) {
 		m_bodyIndex.push_back(*i);
 		// also index ships inside clouds
 		// XXX we should not have to know about this. move indexing grunt work
@@ -244,23 +319,94 @@ void Space::RebuildBodyIndex()
 		}
 	}
 
+	build_lookup(m_bodyIndex, m_bodyLookup);
 	m_bodyIndexValid = true;
 }
 
 void Space::RebuildSystemBodyIndex()
 {
 	m_sbodyIndex.clear();
+	if (m_starSystem)
+		m_sbodyIndex.reserve(m_starSystem->m_bodies.size()+1);
 	m_sbodyIndex.push_back(0);
 
 	if (m_starSystem)
-		AddSystemBodyToIndex(m_starSystem->rootBody.Get());
+		AddSystemBodyToIndex(m_starSystem->rootBody);
 
+	build_lookup(m_sbodyIndex, m_sbodyLookup);
 	m_sbodyIndexValid = true;
 }
 
 void Space::AddBody(Body *b)
 {
+	assert(!b->GetSpaceSlot());
+
+	if (m_bodySlots.empty())
+		m_bodySlots.push_back(BodySlot()); // slot 0 is the null handle
+
+	Uint32 slot;
+	if (!m_freeBodySlots.empty()) {
+		slot = m_freeBodySlots.back();
+		m_freeBodySlots.pop_back();
+	} else {
+		slot = m_bodySlots.size();
+		m_bodySlots.push_back(BodySlot());
+	}
+
+	BodySlot &s = m_bodySlots[slot];
+	s.body = b;
+	s.bodyIndex = m_bodies.size();
 	m_bodies.push_back(b);
+	if (b->HoldsBodyReferences()) {
+		s.notifyIndex = m_notifyBodies.size();
+		m_notifyBodies.push_back(b);
+	}
+	b->SetSpaceSlot(slot);
+}
+
+// takes the body out of both vectors by moving the last entry into its
+// place, which shuffles the update order a little but is constant time
+void Space::RemoveBodyFromSlots(Body *b)
+{
+	const Uint32 slot = b->GetSpaceSlot();
+	if (!slot) return; // already gone, or queued for removal twice
+
+	BodySlot &s = m_bodySlots[slot];
+	assert(s.body == b);
+
+	Body *moved = m_bodies.back();
+	m_bodies[s.bodyIndex] = moved;
+	m_bodySlots[moved->GetSpaceSlot()].bodyIndex = s.bodyIndex;
+	m_bodies.pop_back();
+
+	if (b->HoldsBodyReferences()) {
+		moved = m_notifyBodies.back();
+		m_notifyBodies[s.notifyIndex] = moved;
+		m_bodySlots[moved->GetSpaceSlot()].notifyIndex = s.notifyIndex;
+		m_notifyBodies.pop_back();
+	}
+
+	s.body = 0;
+	s.serial++;
+	m_freeBodySlots.push_back(slot);
+	b->SetSpaceSlot(0);
+}
+
+Space::BodyHandle Space::GetHandleForBody(const Body *b) const
+{
+	BodyHandle h;
+	if (b && b->GetSpaceSlot()) {
+		h.slot = b->GetSpaceSlot();
+		h.serial = m_bodySlots[h.slot].serial;
+	}
+	return h;
+}
+
+Body *Space::GetBodyForHandle(const BodyHandle &h) const
+{
+	if (!h.slot || h.slot >= m_bodySlots.size()) return 0;
+	const BodySlot &s = m_bodySlots[h.slot];
+	return s.serial == h.serial ? s.body : 0;
 }
 
 void Space::RemoveBody(Body *b)
@@ -297,11 +443,11 @@ vector3d Space::GetHyperspaceExitPoint(const SystemPath &source) const
 
 	const SystemPath &dest = m_starSystem->GetPath();
 
-	Sector source_sec(source.sectorX, source.sectorY, source.sectorZ);
-	Sector dest_sec(dest.sectorX, dest.sectorY, dest.sectorZ);
+	RefCountedPtr<Sector> source_sec = Sector::GetCached(source);
+	RefCountedPtr<Sector> dest_sec = Sector::GetCached(dest);
 
-	Sector::System source_sys = source_sec.m_systems[source.systemIndex];
-	Sector::System dest_sys = dest_sec.m_systems[dest.systemIndex];
+	const Sector::System &source_sys = source_sec->m_systems[source.systemIndex];
+	const Sector::System &dest_sys = dest_sec->m_systems[dest.systemIndex];
 
 	const vector3d sourcePos = vector3d(source_sys.p) + vector3d(source.sectorX, source.sectorY, source.sectorZ);
 	const vector3d destPos = vector3d(dest_sys.p) + vector3d(dest.sectorX, dest.sectorY, dest.sectorZ);
@@ -327,7 +473,7 @@ Body *Space::FindNearestTo(const Body *b, Object::Type t) const
 {
 	Body *nearest = 0;
 	double dist = FLT_MAX;
-	for (std::list<Body*>::const_iterator i = m_bodies.begin(); i != m_bodies.end(); ++i) {
+	for (BodyIterator i = BodiesBegin(); i != BodiesEnd(); ++i) {
 		if ((*i)->IsDead()) continue;
 		if ((*i)->IsType(t)) {
 			double d = (*i)->GetPositionRelTo(b).Length();
@@ -347,7 +493,7 @@ Body *Space::FindBodyForPath(const SystemPath *path) const
 
 	if (!body) return 0;
 
-	for (BodyIterator i = m_bodies.begin(); i != m_bodies.end(); ++i) {
+	for (BodyIterator i = BodiesBegin(); i != BodiesEnd(); ++i) {
 		if ((*i)->GetSystemBody() == body) return *i;
 	}
 	return 0;
@@ -398,6 +544,8 @@ static void RelocateStarportIfUnderwaterOrBuried(SystemBody *sbody, Frame *frame
 	const double delta = 20.0/radius; // in radii
 	const double maxSlope = 0.2; // 0.0 to 1.0
 	const double maxHeightVariation = maxSlope*delta*radius; // in m
+	// the samples can come from the terrain meshes if they're this close
+	const double slopeTolerance = maxHeightVariation*0.1; // in m
 
 	matrix3x3d rot_ = rot;
 	vector3d pos_ = pos;
@@ -415,18 +563,18 @@ static void RelocateStarportIfUnderwaterOrBuried(SystemBody *sbody, Frame *frame
 	for (int tries = 0; tries < 200; tries++) {
 		variationWithinLimits = true;
 
-		const double height = planet->GetTerrainHeight(pos_) - radius; // in m
+		const double height = planet->GetTerrainHeight(pos_, slopeTolerance) - radius; // in m
 
 		// check height at 6 points around the starport center stays within variation tolerances
 		// GetHeight gives a varying height field in 3 dimensions.
 		// Given it's smoothly varying it's fine to sample it in arbitary directions to get an idea of how sharply it varies
 		double v[6];
-		v[0] = fabs(planet->GetTerrainHeight(vector3d(pos_.x+delta, pos_.y, pos_.z))-radius-height);
-		v[1] = fabs(planet->GetTerrainHeight(vector3d(pos_.x-delta, pos_.y, pos_.z))-radius-height);
-		v[2] = fabs(planet->GetTerrainHeight(vector3d(pos_.x, pos_.y, pos_.z+delta))-radius-height);
-		v[3] = fabs(planet->GetTerrainHeight(vector3d(pos_.x, pos_.y, pos_.z-delta))-radius-height);
-		v[4] = fabs(planet->GetTerrainHeight(vector3d(pos_.x, pos_.y+delta, pos_.z))-radius-height);
-		v[5] = fabs(planet->GetTerrainHeight(vector3d(pos_.x, pos_.y-delta, pos_.z))-radius-height);
+		v[0] = fabs(planet->GetTerrainHeight(vector3d(pos_.x+delta, pos_.y, pos_.z), slopeTolerance)-radius-height);
+		v[1] = fabs(planet->GetTerrainHeight(vector3d(pos_.x-delta, pos_.y, pos_.z), slopeTolerance)-radius-height);
+		v[2] = fabs(planet->GetTerrainHeight(vector3d(pos_.x, pos_.y, pos_.z+delta), slopeTolerance)-radius-height);
+		v[3] = fabs(planet->GetTerrainHeight(vector3d(pos_.x, pos_.y, pos_.z-delta), slopeTolerance)-radius-height);
+		v[4] = fabs(planet->GetTerrainHeight(vector3d(pos_.x, pos_.y+delta, pos_.z), slopeTolerance)-radius-height);
+		v[5] = fabs(planet->GetTerrainHeight(vector3d(pos_.x, pos_.y-delta, pos_.z), slopeTolerance)-radius-height);
 
 		// break if variation for all points is within limits
 		double variationMax = 0.0;
@@ -577,7 +725,7 @@ static Frame *MakeFrameFor(SystemBody *sbody, Body *b, Frame *f)
 		Planet *planet = static_cast<Planet*>(rotFrame->GetBody());
 		RelocateStarportIfUnderwaterOrBuried(sbody, rotFrame, planet, pos, rot);
 		sbody->orbit.SetPlane(rot);
-		b->SetPosition(pos * planet->GetTerrainHeight(pos));
+		b->SetPosition(pos * planet->GetTerrainHeight(pos, 0.25));
 		b->SetOrient(rot);
 		return rotFrame;
 	} else {
@@ -732,7 +880,7 @@ static void CollideWithTerrain(Body *body)
 	double altitude = body->GetPosition().Length() + aabb.min.y;
 	if (altitude >= terrain->GetMaxFeatureRadius()) return;
 
-	double terrHeight = terrain->GetTerrainHeight(body->GetPosition().Normalized());
+	double terrHeight = terrain->GetCachedTerrainHeight(body->GetPosition().Normalized());
 	if (altitude >= terrHeight) return;
 
 	CollisionContact c;
@@ -744,34 +892,274 @@ static void CollideWithTerrain(Body *body)
 	hitCallback(&c);
 }
 
-void Space::CollideFrame(Frame *f)
+// a piece of work that can be handed to the job queue, but that the main
+// thread would rather do itself than sit waiting for. whoever claims it
+// first runs it
+class ClaimableTask : public RefCounted {
+public:
+	ClaimableTask() : m_claimed(false) {
+		m_lock = SDL_CreateMutex();
+		m_done = SDL_CreateSemaphore(0);
+	}
+	virtual ~ClaimableTask() {
+		SDL_DestroySemaphore(m_done);
+		SDL_DestroyMutex(m_lock);
+	}
+
+	bool Claim() {
+		SDL_LockMutex(m_lock);
+		const bool claimed = !m_claimed;
+		m_claimed = true;
+		SDL_UnlockMutex(m_lock);
+		return claimed;
+	}
+
+	virtual void Run() = 0;
+
+	// wait for a task that a runner claimed
+	void WaitDone() { SDL_SemWait(m_done); }
+	void PostDone() { SDL_SemPost(m_done); }
+
+private:
+	SDL_mutex *m_lock;
+	SDL_sem *m_done;
+	bool m_claimed;
+};
+
+class ClaimableTaskJob : public Job {
+public:
+	ClaimableTaskJob(const RefCountedPtr<ClaimableTask> &task) : m_task(task) {}
+	virtual const char *GetName() const { return "ClaimableTaskJob"; }
+
+	virtual void OnRun() {
+		if (m_task->Claim()) {
+			m_task->Run();
+			m_task->PostDone();
+		}
+	}
+	virtual void OnFinish() {}
+
+private:
+	// jobs are only ever deleted on the main thread, so the task outlives any
+	// runner that's using it
+	RefCountedPtr<ClaimableTask> m_task;
+};
+
+// queues every task, then works through them in order on the main thread,
+// running any that no runner has picked up yet and waiting for the rest.
+// when it returns every task has finished
+template <typename T>
+static void RunClaimableTasks(const std::vector< RefCountedPtr<T> > &tasks)
 {
-	f->GetCollisionSpace()->Collide(&hitCallback);
+	std::vector<ClaimableTaskJob*> jobs;
+	jobs.reserve(tasks.size());
+	for (size_t i = 0; i < tasks.size(); i++) {
+		ClaimableTaskJob *job = new ClaimableTaskJob(RefCountedPtr<ClaimableTask>(tasks[i].Get()));
+		job->SetPriority(Job::PRIORITY_HIGH);
+		Pi::Jobs()->Queue(job);
+		jobs.push_back(job);
+	}
+
+	// FinishJobs isn't called until we're done, so the jobs are all still
+	// around to be cancelled, whatever state they're in
+	for (size_t i = 0; i < tasks.size(); i++) {
+		if (tasks[i]->Claim()) {
+			Pi::Jobs()->Cancel(jobs[i]);
+			tasks[i]->Run();
+		} else
+			tasks[i]->WaitDone();
+	}
+}
+
+// frames' collision spaces are independent, so they're collided in parallel
+// on the job queue. the contacts are kept and handed to hitCallback on the
+// main thread afterwards, in the same order a serial run would produce them
+class CollisionTask : public ClaimableTask {
+public:
+	CollisionTask(CollisionSpace *space) : m_space(space) {}
+
+	// main thread, before the first task is queued
+	static void Init() {
+		if (!s_threadTasksLock)
+			s_threadTasksLock = SDL_CreateMutex();
+	}
+
+	virtual void Run();
+
+	const std::vector<CollisionContact> &GetContacts() const { return m_contacts; }
+
+private:
+	static void GatherContact(CollisionContact *c);
+
+	CollisionSpace *m_space;
+	std::vector<CollisionContact> m_contacts;
+
+	// the collider only takes a plain callback, so it finds the task's
+	// contact list from the thread it's running on
+	static std::map<Uint32, CollisionTask*> s_threadTasks;
+	static SDL_mutex *s_threadTasksLock;
+};
+
+std::map<Uint32, CollisionTask*> CollisionTask::s_threadTasks;
+SDL_mutex *CollisionTask::s_threadTasksLock = 0;
+
+void CollisionTask::Run()
+{
+	const Uint32 thread = SDL_ThreadID();
+	SDL_LockMutex(s_threadTasksLock);
+	s_threadTasks[thread] = this;
+	SDL_UnlockMutex(s_threadTasksLock);
+
+	m_space->Collide(&GatherContact);
+
+	SDL_LockMutex(s_threadTasksLock);
+	s_threadTasks.erase(thread);
+	SDL_UnlockMutex(s_threadTasksLock);
+}
+
+void CollisionTask::GatherContact(CollisionContact *c)
+{
+	SDL_LockMutex(s_threadTasksLock);
+	CollisionTask *task = s_threadTasks[SDL_ThreadID()];
+	SDL_UnlockMutex(s_threadTasksLock);
+	assert(task);
+	task->m_contacts.push_back(*c);
+}
+
+static void GatherCollisionFrames(Frame *f, std::vector<Frame*> &frames)
+{
+	frames.push_back(f);
 	for (Frame::ChildIterator it = f->BeginChildren(); it != f->EndChildren(); ++it)
-		CollideFrame(*it);
+		GatherCollisionFrames(*it, frames);
+}
+
+void Space::CollideFrame(Frame *f)
+{
+	PROFILE_ZONE("Space::CollideFrame");
+
+	std::vector<Frame*> frames;
+	GatherCollisionFrames(f, frames);
+
+	// frames without moving geoms have nothing to collide, but still need
+	// their static trees kept up to date
+	std::vector<CollisionSpace*> spaces;
+	for (std::vector<Frame*>::iterator it = frames.begin(); it != frames.end(); ++it) {
+		CollisionSpace *space = (*it)->GetCollisionSpace();
+		if (space->HasGeoms())
+			spaces.push_back(space);
+		else
+			space->Collide(&hitCallback);
+	}
+
+	// not worth the trip through the queue
+	if (spaces.size() < 2) {
+		for (std::vector<CollisionSpace*>::iterator it = spaces.begin(); it != spaces.end(); ++it)
+			(*it)->Collide(&hitCallback);
+		return;
+	}
+
+	CollisionTask::Init();
+
+	std::vector< RefCountedPtr<CollisionTask> > tasks;
+	tasks.reserve(spaces.size());
+	for (std::vector<CollisionSpace*>::iterator it = spaces.begin(); it != spaces.end(); ++it)
+		tasks.push_back(RefCountedPtr<CollisionTask>(new CollisionTask(*it)));
+
+	RunClaimableTasks(tasks);
+
+	// everything's been collided, so the responses can't disturb a search
+	// that's still going on
+	for (size_t i = 0; i < tasks.size(); i++) {
+		const std::vector<CollisionContact> &contacts = tasks[i]->GetContacts();
+		for (std::vector<CollisionContact>::const_iterator c = contacts.begin(); c != contacts.end(); ++c) {
+			CollisionContact contact = *c;
+			hitCallback(&contact);
+		}
+	}
+}
+
+// a run of bodies whose ParallelTimeStepUpdate can go on a worker thread
+class BodyStepTask : public ClaimableTask {
+public:
+	BodyStepTask(Body *const *bodies, size_t count, float step) : m_bodies(bodies), m_count(count), m_step(step) {}
+
+	virtual void Run() {
+		for (size_t i = 0; i < m_count; i++)
+			m_bodies[i]->ParallelTimeStepUpdate(m_step);
+	}
+
+private:
+	Body *const *m_bodies;
+	size_t m_count;
+	float m_step;
+};
+
+// enough to be worth a trip through the job queue
+static const size_t BODIES_PER_STEP_TASK = 16;
+
+void Space::ParallelTimeStep(float step)
+{
+	std::vector<Body*> bodies;
+	for (BodyIterator i = BodiesBegin(); i != BodiesEnd(); ++i)
+		if ((*i)->HasParallelTimeStep())
+			bodies.push_back(*i);
+
+	if (bodies.size() < 2*BODIES_PER_STEP_TASK) {
+		for (std::vector<Body*>::iterator i = bodies.begin(); i != bodies.end(); ++i)
+			(*i)->ParallelTimeStepUpdate(step);
+		return;
+	}
+
+	std::vector< RefCountedPtr<BodyStepTask> > tasks;
+	for (size_t first = 0; first < bodies.size(); first += BODIES_PER_STEP_TASK) {
+		const size_t count = std::min(BODIES_PER_STEP_TASK, bodies.size() - first);
+		tasks.push_back(RefCountedPtr<BodyStepTask>(new BodyStepTask(&bodies[first], count, step)));
+	}
+
+	RunClaimableTasks(tasks);
 }
 
 void Space::TimeStep(float step)
 {
+	PROFILE_ZONE("Space::TimeStep");
+
 	m_frameIndexValid = m_bodyIndexValid = m_sbodyIndexValid = false;
 
 	// XXX does not need to be done this often
 	CollideFrame(m_rootFrame.Get());
-	for (BodyIterator i = m_bodies.begin(); i != m_bodies.end(); ++i)
-		CollideWithTerrain(*i);
+	{
+		PROFILE_ZONE("terrain collisions");
+		for (BodyIterator i = BodiesBegin(); i != BodiesEnd(); ++i)
+			CollideWithTerrain(*i);
+	}
 
 	// update frames of reference
-	for (BodyIterator i = m_bodies.begin(); i != m_bodies.end(); ++i)
-		(*i)->UpdateFrame();
+	{
+		PROFILE_ZONE("update frames");
+		for (BodyIterator i = BodiesBegin(); i != BodiesEnd(); ++i)
+			(*i)->UpdateFrame();
+	}
 
 	// AI acts here, then move all bodies and frames
-	for (BodyIterator i = m_bodies.begin(); i != m_bodies.end(); ++i)
-		(*i)->StaticUpdate(step);
+	{
+		PROFILE_ZONE("static update");
+		for (BodyIterator i = BodiesBegin(); i != BodiesEnd(); ++i)
+			(*i)->StaticUpdate(step);
+	}
 
 	m_rootFrame->UpdateOrbitRails(m_game->GetTime(), m_game->GetTimeStep());
 
-	for (BodyIterator i = m_bodies.begin(); i != m_bodies.end(); ++i)
-		(*i)->TimeStepUpdate(step);
+	{
+		PROFILE_ZONE("time step update");
+
+		// the self-contained part of moving bodies (integrating every moving body)
+		// can be spread over the workers. everything else stays on this thread
+		if (Pi::config->Int("ParallelBodyUpdates"))
+			ParallelTimeStep(step);
+
+		for (BodyIterator i = BodiesBegin(); i != BodiesEnd(); ++i)
+			(*i)->TimeStepUpdate(step);
+	}
 
 	// XXX don't emit events in hyperspace. this is mostly to maintain the
 	// status quo. in particular without this onEnterSystem will fire in the
@@ -783,7 +1171,10 @@ void Space::TimeStep(float step)
 		Pi::luaTimer->Tick();
 	}
 
-	UpdateBodies();
+	{
+		PROFILE_ZONE("update bodies");
+		UpdateBodies();
+	}
 
 	m_bodyNearFinder.Prepare();
 }
@@ -794,18 +1185,18 @@ void Space::UpdateBodies()
 	m_processingFinalizationQueue = true;
 #endif
 
-	for (BodyIterator b = m_removeBodies.begin(); b != m_removeBodies.end(); ++b) {
+	for (std::list<Body*>::const_iterator b = m_removeBodies.begin(); b != m_removeBodies.end(); ++b) {
 		(*b)->SetFrame(0);
-		for (BodyIterator i = m_bodies.begin(); i != m_bodies.end(); ++i)
+		for (std::vector<Body*>::const_iterator i = m_notifyBodies.begin(); i != m_notifyBodies.end(); ++i)
 			(*i)->NotifyRemoved(*b);
-		m_bodies.remove(*b);
+		RemoveBodyFromSlots(*b);
 	}
 	m_removeBodies.clear();
 
-	for (BodyIterator b = m_killBodies.begin(); b != m_killBodies.end(); ++b) {
-		for (BodyIterator i = m_bodies.begin(); i != m_bodies.end(); ++i)
+	for (std::list<Body*>::const_iterator b = m_killBodies.begin(); b != m_killBodies.end(); ++b) {
+		for (std::vector<Body*>::const_iterator i = m_notifyBodies.begin(); i != m_notifyBodies.end(); ++i)
 			(*i)->NotifyRemoved(*b);
-		m_bodies.remove(*b);
+		RemoveBodyFromSlots(*b);
 		delete *b;
 	}
 	m_killBodies.clear();
@@ -5,6 +5,7 @@
 #define _SPACE_H
 
 #include <list>
+#include <vector>
 #include "Object.h"
 #include "vector3.h"
 #include "Serializer.h"
@@ -58,9 +59,32 @@ public:
 	Body *FindNearestTo(const Body *b, Object::Type t) const;
 	Body *FindBodyForPath(const SystemPath *path) const;
 
-	typedef std::list<Body*>::const_iterator BodyIterator;
-	const BodyIterator BodiesBegin() const { return m_bodies.begin(); }
-	const BodyIterator BodiesEnd() const { return m_bodies.end(); }
+	// walks the bodies by position rather than by pointer, so bodies can be
+	// added (they go on the end) while someone is iterating
+	class BodyIterator {
+	public:
+		BodyIterator(const std::vector<Body*> *bodies, size_t index) : m_bodies(bodies), m_index(index) {}
+		Body *operator*() const { return (*m_bodies)[m_index]; }
+		BodyIterator &operator++() { ++m_index; return *this; }
+		bool operator==(const BodyIterator &a) const { return m_index == a.m_index; }
+		bool operator!=(const BodyIterator &a) const { return m_index != a.m_index; }
+	private:
+		const std::vector<Body*> *m_bodies;
+		size_t m_index;
+	};
+	const BodyIterator BodiesBegin() const { return BodyIterator(&m_bodies, 0); }
+	const BodyIterator BodiesEnd() const { return BodyIterator(&m_bodies, m_bodies.size()); }
+	size_t GetNumBodies() const { return m_bodies.size(); }
+
+	// a reference to a body that can safely outlive it. it resolves to null
+	// once the body has been removed from space, so whoever holds one doesn't
+	// need to hear about it through NotifyRemoved
+	struct BodyHandle {
+		BodyHandle() : slot(0), serial(0) {}
+		Uint32 slot, serial;
+	};
+	BodyHandle GetHandleForBody(const Body *b) const;
+	Body *GetBodyForHandle(const BodyHandle &h) const;
 
 	Background::Container& GetBackground() { return m_background; }
 
@@ -83,6 +107,7 @@ private:
 	void UpdateBodies();
 
 	void CollideFrame(Frame *f);
+	void ParallelTimeStep(float step);
 
 	ScopedPtr<Frame> m_rootFrame;
 
@@ -91,7 +116,26 @@ private:
 	Game *m_game;
 
 	// all the bodies we know about
-	std::list<Body*> m_bodies;
+	std::vector<Body*> m_bodies;
+
+	// bodies that hold pointers to other bodies and want NotifyRemoved
+	std::vector<Body*> m_notifyBodies;
+
+	// every body in space owns a slot, which tracks where it lives in the
+	// vectors above so it can be taken out without searching. slots are
+	// reused, serial tells apart the bodies that have held one. slot 0 is
+	// never used so a zeroed handle is always null
+	struct BodySlot {
+		BodySlot() : body(0), serial(0), bodyIndex(0), notifyIndex(0) {}
+		Body *body;
+		Uint32 serial;
+		Uint32 bodyIndex;
+		Uint32 notifyIndex; // only meaningful if the body HoldsBodyReferences()
+	};
+	std::vector<BodySlot> m_bodySlots;
+	std::vector<Uint32> m_freeBodySlots;
+
+	void RemoveBodyFromSlots(Body *b);
 
 	// bodies that were removed/killed this timestep and need pruning at the end
 	std::list<Body*> m_removeBodies;
@@ -108,33 +152,64 @@ private:
 	std::vector<Frame*> m_frameIndex;
 	std::vector<Body*>  m_bodyIndex;
 	std::vector<SystemBody*> m_sbodyIndex;
+	// the same, sorted by pointer, for the GetIndexFor lookups
+	std::vector< std::pair<const Frame*,Uint32> > m_frameLookup;
+	std::vector< std::pair<const Body*,Uint32> > m_bodyLookup;
+	std::vector< std::pair<const SystemBody*,Uint32> > m_sbodyLookup;
 
 	//background (elements that are infinitely far away,
 	//e.g. starfield and milky way)
 	Background::Container m_background;
 
+	// sorts bodies into a grid of cubes in root frame space, so a search
+	// only has to look at the cubes its sphere touches. Prepare rebuilds it
+	// once per step, so the positions it knows about are as of then
 	class BodyNearFinder {
 	public:
 		BodyNearFinder(const Space *space) : m_space(space) {}
 		void Prepare();
 
+		// bodies whose centres were within dist of the point when the
+		// finder was last prepared
 		void GetBodiesMaybeNear(const Body *b, double dist, BodyNearList &bodies) const;
 		void GetBodiesMaybeNear(const vector3d &pos, double dist, BodyNearList &bodies) const;
 
 	private:
-		struct BodyDist {
-			BodyDist(Body *_body, double _dist) : body(_body), dist(_dist) {}
-			Body   *body;
-			double dist;
+		struct CellPos {
+			Sint64 x, y, z;
+
+			bool operator<(const CellPos &a) const {
+				if (x != a.x) return x < a.x;
+				if (y != a.y) return y < a.y;
+				return z < a.z;
+			}
+			bool operator==(const CellPos &a) const { return x == a.x && y == a.y && z == a.z; }
+		};
 
-			bool operator<(const BodyDist &a) const { return dist < a.dist; }
+		struct BodyPos {
+			BodyPos(Body *_body, const vector3d &_pos, const CellPos &_cell) : body(_body), pos(_pos), cell(_cell) {}
+			Body    *body;
+			vector3d pos;
+			CellPos  cell;
 
-			friend bool operator<(const BodyDist &a, double d) { return a.dist < d; }
-			friend bool operator<(double d, const BodyDist &a) { return d < a.dist; }
+			bool operator<(const BodyPos &a) const { return cell < a.cell; }
 		};
 
+		// a run of m_bodyPos entries that share a cell
+		struct Cell {
+			Cell(const CellPos &_pos, Uint32 _first) : pos(_pos), first(_first), count(0) {}
+			CellPos pos;
+			Uint32  first, count;
+
+			bool operator<(const Cell &a) const { return pos < a.pos; }
+		};
+
+		static CellPos GetCellPos(const vector3d &pos);
+		void GatherCell(const Cell &cell, const vector3d &pos, double distSqr, BodyNearList &bodies) const;
+
 		const Space *m_space;
-		std::vector<BodyDist> m_bodyDist;
+		std::vector<BodyPos> m_bodyPos;
+		std::vector<Cell> m_cells; // sorted by position
 	};
 
 	BodyNearFinder m_bodyNearFinder;
@@ -23,6 +23,11 @@
 #include "graphics/Graphics.h"
 #include <algorithm>
 
+// ships waiting for a bay. any more are turned away as before
+static const unsigned int MAX_DOCKING_QUEUE = 8;
+// the bulletin board is filled in once the player is this close
+static const double BB_CREATE_DISTANCE = 1000000.0;
+
 void SpaceStation::Init()
 {
 	SpaceStationType::Init();
@@ -171,13 +176,10 @@ void SpaceStation::InitStation()
 {
 	m_adjacentCity = 0;
 	for(int i=0; i<NUM_STATIC_SLOTS; i++) m_staticSlot[i] = false;
-	Random rand(m_sbody->seed);
 	bool ground = m_sbody->type == SystemBody::TYPE_STARPORT_ORBITAL ? false : true;
-	if (ground) {
-		m_type = &SpaceStationType::surfaceStationTypes[ rand.Int32(SpaceStationType::surfaceStationTypes.size()) ];
-	} else {
-		m_type = &SpaceStationType::orbitalStationTypes[ rand.Int32(SpaceStationType::orbitalStationTypes.size()) ];
-	}
+	SpaceStationType *type = SpaceStationType::ForSystemBody(m_sbody);
+	type->LoadModel();
+	m_type = type;
 
 	if(m_shipDocking.empty()) {
 		m_shipDocking.reserve(m_type->numDockingPorts);
@@ -202,7 +204,10 @@ void SpaceStation::InitStation()
 	m_navLights.Reset(new NavLights(GetModel(), 2.2f));
 	m_navLights->SetEnabled(true);
 
-	if (ground) SetClipRadius(CITY_ON_PLANET_RADIUS);		// overrides setmodel
+	if (ground) {
+		SetClipRadius(CITY_ON_PLANET_RADIUS);		// overrides setmodel
+		CityOnPlanet::RequestModels();
+	}
 
 	m_doorAnimation = GetModel()->FindAnimation("doors");
 }
@@ -276,6 +281,7 @@ void SpaceStation::NotifyRemoved(const Body* const removedBody)
 			m_shipDocking[i].ship = 0;
 		}
 	}
+	m_dockingQueue.erase(std::remove(m_dockingQueue.begin(), m_dockingQueue.end(), removedBody), m_dockingQueue.end());
 }
 
 int SpaceStation::GetMyDockingPort(const Ship *s) const
@@ -347,18 +353,8 @@ bool SpaceStation::GetDockingClearance(Ship *s, std::string &outMsg)
 		// initial unoccupied check
 		if (m_shipDocking[i].ship != 0) continue;
 
-		// size-of-ship vs size-of-bay check
-		const SpaceStationType::SBayGroup *const pBayGroup = m_type->FindGroupByBay(i);
-		if( !pBayGroup ) continue;
-
-		const Aabb &bbox = s->GetAabb();
-		const double bboxRad = bbox.GetRadius();
-
-		if( pBayGroup->minShipSize < bboxRad && bboxRad < pBayGroup->maxShipSize ) {
-			shipDocking_t &sd = m_shipDocking[i];
-			sd.ship = s;
-			sd.stage = 1;
-			sd.stagePos = 0;
+		if (BayFitsShip(i, s)) {
+			GrantClearance(i, s);
 			outMsg = stringf(Lang::CLEARANCE_GRANTED_BAY_N, formatarg("bay", i+1));
 			return true;
 		}
@@ -367,6 +363,72 @@ bool SpaceStation::GetDockingClearance(Ship *s, std::string &outMsg)
 	return false;
 }
 
+// size-of-ship vs size-of-bay check
+bool SpaceStation::BayFitsShip(int bay, const Ship *s) const
+{
+	const SpaceStationType::SBayGroup *const pBayGroup = m_type->FindGroupByBay(bay);
+	if( !pBayGroup ) return false;
+
+	const double bboxRad = s->GetAabb().GetRadius();
+	return pBayGroup->minShipSize < bboxRad && bboxRad < pBayGroup->maxShipSize;
+}
+
+void SpaceStation::GrantClearance(int bay, Ship *s)
+{
+	shipDocking_t &sd = m_shipDocking[bay];
+	sd.ship = s;
+	sd.stage = 1;
+	sd.stagePos = 0;
+}
+
+bool SpaceStation::QueueForDocking(Ship *s)
+{
+	if (IsQueuedForDocking(s)) return true;
+	if (m_dockingQueue.size() >= MAX_DOCKING_QUEUE) return false;
+
+	bool fits = false;
+	for (Uint32 i=0; i<m_shipDocking.size() && !fits; i++)
+		fits = BayFitsShip(i, s);
+	if (!fits) return false;
+
+	m_dockingQueue.push_back(s);
+	return true;
+}
+
+bool SpaceStation::IsQueuedForDocking(const Ship *s) const
+{
+	return std::find(m_dockingQueue.begin(), m_dockingQueue.end(), s) != m_dockingQueue.end();
+}
+
+void SpaceStation::LeaveDockingQueue(const Ship *s)
+{
+	m_dockingQueue.erase(std::remove(m_dockingQueue.begin(), m_dockingQueue.end(), s), m_dockingQueue.end());
+}
+
+// first come first served, though a ship further back that fits a bay the
+// ones in front don't goes ahead of them
+void SpaceStation::ServeDockingQueue()
+{
+	std::deque<Ship*>::iterator it = m_dockingQueue.begin();
+	while (it != m_dockingQueue.end()) {
+		Ship *s = *it;
+		// gone off somewhere else
+		if (s->GetFlightState() != Ship::FLYING) {
+			it = m_dockingQueue.erase(it);
+			continue;
+		}
+
+		int bay = -1;
+		for (Uint32 i=0; i<m_shipDocking.size(); i++) {
+			if (m_shipDocking[i].ship == 0 && BayFitsShip(i, s)) { bay = i; break; }
+		}
+		if (bay == -1) { ++it; continue; }
+
+		GrantClearance(bay, s);
+		it = m_dockingQueue.erase(it);
+	}
+}
+
 bool SpaceStation::OnCollision(Object *b, Uint32 flags, double relVel)
 {
 	if ((flags & 0x10) && (b->IsType(Object::SHIP))) {
@@ -502,6 +564,10 @@ void SpaceStation::DockingUpdate(const double timeStep)
 		}
 	}
 
+	// after the bays have been cleared, so a waiting ship gets the first one
+	if (!m_dockingQueue.empty())
+		ServeDockingQueue();
+
 	m_doorAnimationState = Clamp(m_doorAnimationState + m_doorAnimationStep*timeStep, 0.0, 1.0);
 	if (m_doorAnimation)
 		m_doorAnimation->SetProgress(m_doorAnimationState);
@@ -531,26 +597,26 @@ void SpaceStation::PositionDockedShip(Ship *ship, int port) const
 	}
 }
 
-void SpaceStation::StaticUpdate(const float timeStep)
+// update again in an hour or two
+static double next_shipyard_update()
 {
-	bool update = false;
+	return Pi::game->GetTime() + 3600.0 + 3600.0*Pi::rng.Double();
+}
 
-	// if there's no BB and there are ships here, make one
-	if (!m_bbCreated && GetFreeDockingPort() != 0) {
-		CreateBB();
-		update = true;
+void SpaceStation::StaticUpdate(const float timeStep)
+{
+	// if there's no BB and the player is coming, make one. stations the
+	// player never goes near don't need one
+	if (!m_bbCreated) {
+		if (Pi::player && Pi::player->GetPositionRelTo(this).LengthSqr() < BB_CREATE_DISTANCE*BB_CREATE_DISTANCE)
+			CreateBB();
 	}
 
 	// if there is and it hasn't had an update for a while, update it
 	else if (Pi::game->GetTime() > m_lastUpdatedShipyard) {
 		LuaEvent::Queue("onUpdateBB", this);
-		update = true;
-	}
-
-	if (update) {
 		UpdateShipyard();
-		// update again in an hour or two
-		m_lastUpdatedShipyard = Pi::game->GetTime() + 3600.0 + 3600.0*Pi::rng.Double();
+		m_lastUpdatedShipyard = next_shipyard_update();
 	}
 
 	DoLawAndOrder(timeStep);
@@ -623,7 +689,7 @@ bool SpaceStation::CanSell(Equip::Type t, bool verbose) const {
 	return result;
 }
 bool SpaceStation::DoesSell(Equip::Type t) const {
-	return Polit::IsCommodityLegal(Pi::game->GetSpace()->GetStarSystem().Get(), t);
+	return Pi::game->GetSpace()->GetStarSystem()->IsCommodityLegal(t);
 }
 
 Sint64 SpaceStation::GetPrice(Equip::Type t) const {
@@ -705,6 +771,9 @@ void SpaceStation::CreateBB()
 
 	LuaEvent::Queue("onCreateBB", this);
 	m_bbCreated = true;
+
+	UpdateShipyard();
+	m_lastUpdatedShipyard = next_shipyard_update();
 }
 
 static int next_ref = 0;
@@ -747,7 +816,11 @@ bool SpaceStation::RemoveBBAdvert(int ref)
 
 const std::list<const BBAdvert*> SpaceStation::GetBBAdverts()
 {
-	if (!m_bbShuffled) {
+	// the adverts arrive with the next round of Lua events
+	if (!m_bbCreated)
+		CreateBB();
+
+	if (!m_bbShuffled && !m_bbAdverts.empty()) {
 		std::random_shuffle(m_bbAdverts.begin(), m_bbAdverts.end());
 		m_bbShuffled = true;
 	}
@@ -14,6 +14,7 @@
 #include "ShipType.h"
 #include "SpaceStationType.h"
 #include "scenegraph/ModelSkin.h"
+#include <deque>
 
 #define MAX_DOCKING_PORTS		240	//256-(0x10), 0x10 is used because the collision surfaces use it as an identifying flag
 
@@ -74,6 +75,7 @@ public:
 	const std::vector<ShipOnSale> &GetShipsOnSale() const { return m_shipsOnSale; }
 	virtual void PostLoadFixup(Space *space);
 	virtual void NotifyRemoved(const Body* const removedBody);
+	virtual bool HoldsBodyReferences() const { return true; }
 
 	// should call Ship::Undock and Ship::SetDockedWith instead
 	// Returns true on success, false if permission denied
@@ -85,6 +87,14 @@ public:
 	int GetFreeDockingPort() const; // returns -1 if none free
 	int GetMyDockingPort(const Ship *s) const;
 
+	// ships that were refused only because every bay that fits them is busy
+	// can wait their turn instead of asking again. free bays are handed to
+	// them in order as clearance, with the usual time limit. returns false
+	// if the queue is full or no bay could ever take the ship
+	bool QueueForDocking(Ship *s);
+	bool IsQueuedForDocking(const Ship *s) const;
+	void LeaveDockingQueue(const Ship *s);
+
 	const SpaceStationType *GetStationType() const { return m_type; }
 	bool IsGroundStation() const;
 
@@ -95,6 +105,9 @@ public:
 
 	bool AllocateStaticSlot(int& slot);
 
+	// fill the bulletin board, market and shipyard, if they aren't already.
+	// it happens when the player comes near, or when anything asks for the
+	// adverts, so call this to have them ready sooner
 	void CreateBB();
 	int AddBBAdvert(std::string description, AdvertFormBuilder builder);
 	const BBAdvert *GetBBAdvert(int ref);
@@ -116,6 +129,9 @@ protected:
 
 private:
 	void DockingUpdate(const double timeStep);
+	bool BayFitsShip(int bay, const Ship *s) const;
+	void GrantClearance(int bay, Ship *s);
+	void ServeDockingQueue();
 	void PositionDockedShip(Ship *ship, int port) const;
 	void DoLawAndOrder(const double timeStep);
 	bool IsPortLocked(const int bay) const;
@@ -143,6 +159,8 @@ private:
 	typedef std::vector<shipDocking_t>::const_iterator	constShipDockingIter;
 	typedef std::vector<shipDocking_t>::iterator		shipDockingIter;
 	std::vector<shipDocking_t> m_shipDocking;
+	// not saved. the ships' docking commands queue up again after a load
+	std::deque<Ship*> m_dockingQueue;
 
 	SpaceStationType::TBayGroups mBayGroups;
 
@@ -7,11 +7,14 @@
 #include "LuaVector.h"
 #include "LuaVector.h"
 #include "LuaTable.h"
+#include "ModelCache.h"
 #include "Pi.h"
+#include "Random.h"
 #include "Ship.h"
 #include "StringF.h"
 #include "scenegraph/Model.h"
 #include "OS.h"
+#include "galaxy/StarSystem.h"
 
 #include <algorithm>
 
@@ -110,6 +113,26 @@ void SpaceStationType::OnSetupComplete()
 	}
 }
 
+// static
+SpaceStationType *SpaceStationType::ForSystemBody(const SystemBody *sbody)
+{
+	Random rand(sbody->seed);
+	if (sbody->type == SystemBody::TYPE_STARPORT_ORBITAL)
+		return &orbitalStationTypes[ rand.Int32(orbitalStationTypes.size()) ];
+	return &surfaceStationTypes[ rand.Int32(surfaceStationTypes.size()) ];
+}
+
+void SpaceStationType::LoadModel()
+{
+	if (model) return;
+
+	// the bays come from the model's tags, so they're only filled in once
+	// a station of this type is first made
+	model = Pi::FindModel(modelName);
+	Pi::modelCache->Pin(model);
+	OnSetupComplete();
+}
+
 const SpaceStationType::SBayGroup* SpaceStationType::FindGroupByBay(const int zeroBaseBayID) const
 {
 	for (TBayGroups::const_iterator bayIter = bayGroups.begin(), grpEnd=bayGroups.end(); bayIter!=grpEnd ; ++bayIter ) {
@@ -314,9 +337,6 @@ static int _define_station(lua_State *L, SpaceStationType &station)
 	LUA_DEBUG_END(L, 0);
 
 	assert(!station.modelName.empty());
-
-	station.model = Pi::FindModel(station.modelName);
-	station.OnSetupComplete();
 	return 0;
 }
 
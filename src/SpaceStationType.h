@@ -9,6 +9,7 @@
 //Space station definition, loaded from data/stations
 
 class Ship;
+class SystemBody;
 namespace SceneGraph { class Model; }
 
 struct SpaceStationType {
@@ -58,6 +59,8 @@ struct SpaceStationType {
 
 	SpaceStationType();
 
+	// load the model and the bays from it, if that's not been done yet
+	void LoadModel();
 	void OnSetupComplete();
 	const SBayGroup* FindGroupByBay(const int zeroBaseBayID) const;
 	SBayGroup* GetGroupByBay(const int zeroBaseBayID);
@@ -75,6 +78,8 @@ struct SpaceStationType {
 
 	static void Init();
 	static void Uninit();
+	// the type a station for this body will be, chosen by its seed
+	static SpaceStationType *ForSystemBody(const SystemBody *sbody);
 	static std::vector<SpaceStationType> surfaceStationTypes;
 	static std::vector<SpaceStationType> orbitalStationTypes;
 };
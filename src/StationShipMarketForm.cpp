@@ -77,10 +77,10 @@ void StationShipMarketForm::UpdateShipList()
 	for (std::vector<ShipOnSale>::const_iterator i = ships.begin(); i!=ships.end(); ++i) {
 		Gui::Fixed *f = new Gui::Fixed(450, line_height);
 
-		Gui::Label *l = new Gui::Label(ShipType::types[(*i).id].name);
+		Gui::Label *l = new Gui::Label(ShipType::Get((*i).id)->name);
 		f->Add(l,0,0);
-		f->Add(new Gui::Label(format_money(ShipType::types[(*i).id].baseprice - playerShipPrice)), 200, 0);
-		f->Add(new Gui::Label(stringf(Lang::NUMBER_TONNES, formatarg("mass", ShipType::types[(*i).id].capacity))), 350, 0);
+		f->Add(new Gui::Label(format_money(ShipType::Get((*i).id)->baseprice - playerShipPrice)), 200, 0);
+		f->Add(new Gui::Label(stringf(Lang::NUMBER_TONNES, formatarg("mass", ShipType::Get((*i).id)->capacity))), 350, 0);
 
 		Gui::SolidButton *sb = new Gui::SolidButton();
 		sb->onClick.connect(sigc::bind(sigc::mem_fun(this, &StationShipMarketForm::ViewShip), num));
@@ -16,7 +16,7 @@ StationShipViewForm::StationShipViewForm(FormController *controller, int marketI
 	m_marketIndex(marketIndex),
 	m_sos(m_station->GetShipsOnSale()[marketIndex])
 {
-	const ShipType &type = ShipType::types[m_sos.id];
+	const ShipType &type = *ShipType::Get(m_sos.id);
 
 	SetTitle(stringf(Lang::SOMEWHERE_SHIP_MARKET, formatarg("station", m_station->GetLabel())));
 
@@ -122,7 +122,7 @@ StationShipViewForm::StationShipViewForm(FormController *controller, int marketI
 void StationShipViewForm::BuyShip()
 {
 	const int playerShipPrice = Pi::player->GetShipType()->baseprice >> 1;
-	Sint64 cost = ShipType::types[m_sos.id].baseprice - playerShipPrice;
+	Sint64 cost = ShipType::Get(m_sos.id)->baseprice - playerShipPrice;
 	if (Pi::player->GetMoney() < cost) {
 		Pi::cpan->MsgLog()->Message("", Lang::YOU_NOT_ENOUGH_MONEY);
 		return;
@@ -135,7 +135,7 @@ void StationShipViewForm::BuyShip()
 	Pi::player->SetShipType(m_sos.id);
 	Pi::player->SetLabel(m_sos.regId);
 	Pi::player->SetSkin(m_sos.skin);
-	Pi::player->m_equipment.Set(Equip::SLOT_ENGINE, 0, ShipType::types[m_sos.id].hyperdrive);
+	Pi::player->m_equipment.Set(Equip::SLOT_ENGINE, 0, ShipType::Get(m_sos.id)->hyperdrive);
 	Pi::player->UpdateStats();
 
 	m_station->ReplaceShipOnSale(m_marketIndex, old);
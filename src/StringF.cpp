@@ -9,6 +9,8 @@
 #include <cstring>
 #include <cassert>
 #include <climits>
+#include <cstdio>
+#include <vector>
 
 // ---------------------------------------------------------------------------
 // ## FormatSpec
@@ -230,6 +232,38 @@ void init_iosflags(std::ostream& ss, const PrintfSpec& spec) {
 	}
 }
 
+// the same formatting init_iosflags asks a stream for, done by snprintf
+// without making a stream (and its locale) for every argument. the stream
+// pads with zeros on the right of left aligned numbers, which printf won't
+// do, so those have to go through a stream still
+static bool printf_matches_stream(const PrintfSpec& spec) {
+	return !((spec.flags & PrintfSpec::AlignLeft) && (spec.flags & PrintfSpec::PadZero));
+}
+
+template <typename T>
+static std::string format_printf(const PrintfSpec& spec, const char* conv, T value) {
+	char fmt[32];
+	char* f = fmt;
+	*f++ = '%';
+	if (spec.flags & PrintfSpec::AlignLeft) *f++ = '-';
+	if (spec.flags & PrintfSpec::ForceSign) *f++ = '+';
+	if (spec.flags & PrintfSpec::PadZero) *f++ = '0';
+	if (spec.flags & PrintfSpec::ShowType) *f++ = '#';
+	if (spec.width != -1) f += sprintf(f, "%d", spec.width);
+	if (spec.precision != -1) f += sprintf(f, ".%d", spec.precision);
+	strcpy(f, conv);
+
+	char buf[64];
+	const int len = snprintf(buf, sizeof(buf), fmt, value);
+	if (len < 0)
+		return std::string("%(err: bad format)");
+	if (len < int(sizeof(buf)))
+		return std::string(buf, len);
+	std::vector<char> big(len + 1);
+	snprintf(&big[0], big.size(), fmt, value);
+	return std::string(&big[0], len);
+}
+
 /*
 	if (spec.flags & PrintfSpec::AlignLeft) { ss << '-'; }
 	if (spec.flags & PrintfSpec::PadZero)   { ss << '0'; }
@@ -240,14 +274,21 @@ void init_iosflags(std::ostream& ss, const PrintfSpec& spec) {
 	if (spec.precision != -1) { ss << '.' << spec.precision; }
 */
 
-std::string to_string(int64_t value, const FormatSpec& fmt) {
+// the stream has to do left aligned zero padding, see printf_matches_stream
+template <typename T>
+static std::string format_stream(const PrintfSpec& spec, std::ios::fmtflags flags, T value) {
 	std::ostringstream ss;
+	ss.setf(flags, std::ios::basefield | std::ios::floatfield | std::ios::uppercase);
+	init_iosflags(ss, spec);
+	ss << value;
+	return ss.str();
+}
+
+std::string to_string(int64_t value, const FormatSpec& fmt) {
 	PrintfSpec spec;
 
 	if (! fmt.empty()) {
-		if (fmt.specifierIs("d") || fmt.specifierIs("i")) {
-			ss.setf(std::ios::dec, std::ios::basefield);
-		} else
+		if (!fmt.specifierIs("d") && !fmt.specifierIs("i"))
 			return std::string("%(err: bad format)");
 
 		const char *fmtbegin, *fmtend;
@@ -264,26 +305,27 @@ std::string to_string(int64_t value, const FormatSpec& fmt) {
 	if (spec.precision != -1)
 		return std::string("%(err: bad format)");
 
-	init_iosflags(ss, spec);
-
-	ss << value;
-	return ss.str();
+	if (printf_matches_stream(spec))
+		return format_printf(spec, "lld", static_cast<long long>(value));
+	return format_stream(spec, std::ios::dec, value);
 }
 
 std::string to_string(uint64_t value, const FormatSpec& fmt) {
-	std::ostringstream ss;
 	PrintfSpec spec;
+	const char* conv = "llu";
+	std::ios::fmtflags flags = std::ios::dec;
 
 	if (! fmt.empty()) {
 		if (fmt.specifierIs("u")) {
-			ss.setf(std::ios::dec, std::ios::basefield);
 		} else if (fmt.specifierIs("x")) {
-			ss.setf(std::ios::hex, std::ios::basefield);
+			conv = "llx";
+			flags = std::ios::hex;
 		} else if (fmt.specifierIs("X")) {
-			ss.setf(std::ios::hex, std::ios::basefield);
-			ss.setf(std::ios::uppercase);
+			conv = "llX";
+			flags = std::ios::hex | std::ios::uppercase;
 		} else if (fmt.specifierIs("o")) {
-			ss.setf(std::ios::oct, std::ios::basefield);
+			conv = "llo";
+			flags = std::ios::oct;
 		} else
 			return std::string("%(err: bad format)");
 
@@ -301,27 +343,30 @@ std::string to_string(uint64_t value, const FormatSpec& fmt) {
 	if (spec.precision != -1)
 		return std::string("%(err: bad format)");
 
-	init_iosflags(ss, spec);
-
-	ss << value;
-	return ss.str();
+	if (printf_matches_stream(spec))
+		return format_printf(spec, conv, static_cast<unsigned long long>(value));
+	return format_stream(spec, flags, value);
 }
 
 std::string to_string(double value, const FormatSpec& fmt) {
-	std::ostringstream ss;
 	PrintfSpec spec;
+	const char* conv = "g";
+	std::ios::fmtflags flags = std::ios::fmtflags(0);
 
 	if (! fmt.empty()) {
 		if (fmt.specifierIs("f")) {
-			ss.setf(std::ios::fixed, std::ios::floatfield);
+			conv = "f";
+			flags = std::ios::fixed;
 		} else if (fmt.specifierIs("g")) {
 		} else if (fmt.specifierIs("G")) {
-			ss.setf(std::ios::uppercase);
+			conv = "G";
+			flags = std::ios::uppercase;
 		} else if (fmt.specifierIs("e")) {
-			ss.setf(std::ios::scientific, std::ios::floatfield);
+			conv = "e";
+			flags = std::ios::scientific;
 		} else if (fmt.specifierIs("E")) {
-			ss.setf(std::ios::scientific, std::ios::floatfield);
-			ss.setf(std::ios::uppercase);
+			conv = "E";
+			flags = std::ios::scientific | std::ios::uppercase;
 		} else
 			return std::string("%(err: bad format)");
 
@@ -335,10 +380,9 @@ std::string to_string(double value, const FormatSpec& fmt) {
 	if (spec.flags & PrintfSpec::PadSign)
 		return std::string("%(err: bad format)");
 
-	init_iosflags(ss, spec);
-
-	ss << value;
-	return ss.str();
+	if (printf_matches_stream(spec))
+		return format_printf(spec, conv, value);
+	return format_stream(spec, flags, value);
 }
 
 std::string to_string(const char* value, const FormatSpec& fmt) {
@@ -399,6 +443,8 @@ static inline const char* scan_bracetext(const char* fmt) {
 
 std::string string_format(const char* fmt, int numargs, FormatArg const * const args[]) {
 	std::string out;
+	// most of the output is the format's own text
+	out.reserve(strlen(fmt) + 16*numargs);
 	const char *c = fmt;
 	while (*c) {
 		while (*c && *c != '%') ++c;
@@ -25,6 +25,10 @@ static const float ZOOM_OUT_SPEED = 1.f/ZOOM_IN_SPEED;
 static const float WHEEL_SENSITIVITY = .2f;		// Should be a variable in user settings.
 // i don't know how to name it
 static const double ROUGH_SIZE_OF_TURD = 10.0;
+// points around a circular orbit. eccentric ones get more, up to the max,
+// as they bend sharply near periapsis
+static const int MIN_ORBIT_SAMPLES = 100;
+static const int MAX_ORBIT_SAMPLES = 400;
 
 SystemView::SystemView()
 {
@@ -155,6 +159,58 @@ void SystemView::PutOrbit(const Orbit *orbit, const vector3d &offset, const Colo
 	}
 }
 
+void SystemView::PutBodyOrbit(const SystemBody *b, const vector3d &offset, const matrix4x4f &trans)
+{
+	const Uint32 index = b->path.bodyIndex;
+	if (index >= m_orbitBuffers.size() || !m_orbitBuffers[index].Valid()) return;
+
+	matrix4x4f orbitTrans = trans;
+	orbitTrans.Translate(vector3f(offset));
+	orbitTrans.Scale(float(b->orbit.GetSemiMajorAxis() * m_zoom));
+	m_renderer->SetTransform(orbitTrans);
+	m_renderer->DrawBuffer(m_orbitBuffers[index].Get(), m_orbitMaterial.Get(), LINES);
+	m_renderer->SetTransform(trans);
+}
+
+void SystemView::BuildOrbitBuffers(const SystemBody *b)
+{
+	for (std::vector<SystemBody*>::const_iterator kid = b->children.begin(); kid != b->children.end(); ++kid) {
+		BuildOrbitBuffers(*kid);
+
+		const Orbit &orbit = (*kid)->orbit;
+		const double a = orbit.GetSemiMajorAxis();
+		if (is_zero_general(a)) continue;
+
+		const double e = orbit.GetEccentricity();
+		const int samples = Clamp(int(MIN_ORBIT_SAMPLES * (1.0 + 3.0 * e)), MIN_ORBIT_SAMPLES, MAX_ORBIT_SAMPLES);
+		// don't close the loop for hyperbolas and parabolas
+		const int segments = e < 1.0 ? samples : samples - 1;
+
+		// pairs of points, as the renderer has no line strips for buffers
+		VertexArray va(ATTRIB_POSITION, segments * 2);
+		vector3f prev(orbit.EvenSpacedPosTrajectory(0.0) / a);
+		for (int i = 1; i <= segments; i++) {
+			const vector3f next(orbit.EvenSpacedPosTrajectory(double(i % samples) / double(samples)) / a);
+			va.Add(prev);
+			va.Add(next);
+			prev = next;
+		}
+
+		VertexBufferDesc desc;
+		desc.attribs = ATTRIB_POSITION;
+		desc.numVertices = va.GetNumVerts();
+		desc.usage = BUFFER_USAGE_STATIC;
+		RefCountedPtr<VertexBuffer> buffer(m_renderer->CreateVertexBuffer(desc));
+		if (!buffer.Valid()) continue;
+		buffer->Populate(va);
+
+		const Uint32 index = (*kid)->path.bodyIndex;
+		if (index >= m_orbitBuffers.size())
+			m_orbitBuffers.resize(index + 1);
+		m_orbitBuffers[index] = buffer;
+	}
+}
+
 void SystemView::OnClickObject(const SystemBody *b)
 {
 	m_selectedObject = b;
@@ -249,11 +305,11 @@ void SystemView::PutBody(const SystemBody *b, const vector3d &offset, const matr
 		for(std::vector<SystemBody*>::const_iterator kid = b->children.begin(); kid != b->children.end(); ++kid) {
 			if (is_zero_general((*kid)->orbit.GetSemiMajorAxis())) continue;
 			if ((*kid)->orbit.GetSemiMajorAxis() * m_zoom < ROUGH_SIZE_OF_TURD) {
-				PutOrbit(&((*kid)->orbit), offset, Color(0.f, 1.f, 0.f, 1.f));
+				PutBodyOrbit(*kid, offset, trans);
 			}
 
 			// not using current time yet
-			vector3d pos = (*kid)->orbit.OrbitalPosAtTime(m_time);
+			vector3d pos = GetBodyPosition(*kid);
 			pos *= double(m_zoom);
 
 			PutBody(*kid, offset + pos, trans);
@@ -272,7 +328,7 @@ void SystemView::PutSelectionBox(const SystemBody *b, const vector3d &rootPos, c
 	vector3d pos = rootPos;
 	// while (b->parent), not while (b) because the root SystemBody is defined to be at (0,0,0)
 	while (b->parent) {
-		pos += b->orbit.OrbitalPosAtTime(m_time) * double(m_zoom);
+		pos += GetBodyPosition(b) * double(m_zoom);
 		b = b->parent;
 	}
 
@@ -310,10 +366,47 @@ void SystemView::GetTransformTo(const SystemBody *b, vector3d &pos)
 {
 	if (b->parent) {
 		GetTransformTo(b->parent, pos);
-		pos -= double(m_zoom) * b->orbit.OrbitalPosAtTime(m_time);
+		pos -= double(m_zoom) * GetBodyPosition(b);
 	}
 }
 
+// only ever used from the main thread
+static OrbitBatch s_orbitBatch;
+static std::vector<const SystemBody*> s_batchBodies;
+
+static void add_bodies_to_batch(const SystemBody *b, double time)
+{
+	for (std::vector<SystemBody*>::const_iterator kid = b->children.begin(); kid != b->children.end(); ++kid) {
+		s_orbitBatch.Add((*kid)->orbit, time);
+		s_batchBodies.push_back(*kid);
+		add_bodies_to_batch(*kid, time);
+	}
+}
+
+// every body is looked up a few times a frame while drawing, so they're all
+// solved together up front
+void SystemView::UpdateBodyPositions()
+{
+	s_orbitBatch.Clear();
+	s_batchBodies.clear();
+	add_bodies_to_batch(m_system->rootBody, m_time);
+	s_orbitBatch.Solve();
+
+	m_bodyPositions.assign(s_batchBodies.size() + 1, vector3d(0.0));
+	for (size_t i = 0; i < s_batchBodies.size(); i++) {
+		const Uint32 index = s_batchBodies[i]->path.bodyIndex;
+		if (index >= m_bodyPositions.size())
+			m_bodyPositions.resize(index + 1, vector3d(0.0));
+		m_bodyPositions[index] = s_orbitBatch.GetPosition(i);
+	}
+}
+
+const vector3d &SystemView::GetBodyPosition(const SystemBody *b) const
+{
+	assert(b->path.bodyIndex < m_bodyPositions.size());
+	return m_bodyPositions[b->path.bodyIndex];
+}
+
 void SystemView::Draw3D()
 {
 	m_renderer->SetPerspectiveProjection(50.f, Pi::GetScrAspect(), 1.f, 1000.f);
@@ -323,6 +416,7 @@ void SystemView::Draw3D()
 	if (m_system) {
 		if (!m_system->GetPath().IsSameSystem(path)) {
 			m_system.Reset();
+			m_orbitBuffers.clear();
 			ResetViewpoint();
 		}
 	}
@@ -336,7 +430,14 @@ void SystemView::Draw3D()
 	std::string t = Lang::TIME_POINT+format_date(m_time);
 	m_timePoint->SetText(t);
 
-	if (!m_system) m_system = StarSystem::GetCached(path);
+	if (!m_system) {
+		m_system = StarSystem::GetCached(path);
+		if (!m_orbitMaterial.Valid()) {
+			m_orbitMaterial.Reset(m_renderer->CreateMaterial(MaterialDescriptor()));
+			m_orbitMaterial->diffuse = Color(0.f, 1.f, 0.f, 1.f);
+		}
+		if (m_system->rootBody) BuildOrbitBuffers(m_system->rootBody);
+	}
 
 	// XXX fog is not going to be supported in renderer likely -
 	// fade the circles some other way
@@ -352,6 +453,8 @@ void SystemView::Draw3D()
 	trans.Rotate(DEG2RAD(m_rot_z), 0, 0, 1);
 	m_renderer->SetTransform(trans);
 
+	if (m_system->rootBody) UpdateBodyPositions();
+
 	vector3d pos(0,0,0);
 	if (m_selectedObject) GetTransformTo(m_selectedObject, pos);
 
@@ -359,7 +462,7 @@ void SystemView::Draw3D()
 	if (m_system->GetUnexplored())
 		m_infoLabel->SetText(Lang::UNEXPLORED_SYSTEM_NO_SYSTEM_VIEW);
 	else if (m_system->rootBody) {
-		PutBody(m_system->rootBody.Get(), pos, trans);
+		PutBody(m_system->rootBody, pos, trans);
 		if (Pi::game->GetSpace()->GetStarSystem() == m_system) {
 			const Body *navTarget = Pi::player->GetNavTarget();
 			const SystemBody *navTargetSystemBody = navTarget ? navTarget->GetSystemBody() : 0;
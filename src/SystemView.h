@@ -8,6 +8,7 @@
 #include "gui/Gui.h"
 #include "View.h"
 #include "graphics/Drawables.h"
+#include "graphics/VertexBuffer.h"
 
 class StarSystem;
 class SystemBody;
@@ -24,11 +25,15 @@ protected:
 private:
 	static const double PICK_OBJECT_RECT_SIZE;
 	void PutOrbit(const Orbit *orb, const vector3d &offset, const Color &color, double planetRadius = 0.0);
+	void PutBodyOrbit(const SystemBody *b, const vector3d &offset, const matrix4x4f &trans);
+	void BuildOrbitBuffers(const SystemBody *b);
 	void PutBody(const SystemBody *b, const vector3d &offset, const matrix4x4f &trans);
 	void PutLabel(const SystemBody *b, const vector3d &offset);
 	void PutSelectionBox(const SystemBody *b, const vector3d &rootPos, const Color &col);
 	void PutSelectionBox(const vector3d &worldPos, const Color &col);
 	void GetTransformTo(const SystemBody *b, vector3d &pos);
+	void UpdateBodyPositions();
+	const vector3d &GetBodyPosition(const SystemBody *b) const;
 	void OnClickObject(const SystemBody *b);
 	void OnClickAccel(float step);
 	void OnClickRealt();
@@ -40,6 +45,7 @@ private:
 	float m_rot_x, m_rot_z;
 	float m_zoom, m_zoomTo;
 	double m_time;
+	std::vector<vector3d> m_bodyPositions; // at m_time, by body index
 	bool m_realtime;
 	double m_timeStep;
 	Gui::ImageButton *m_zoomInButton;
@@ -51,6 +57,11 @@ private:
 	sigc::connection m_onMouseButtonDown;
 
 	ScopedPtr<Graphics::Drawables::Disk> m_bodyIcon;
+
+	// each body's orbit in units of its semi-major axis, by body index.
+	// the shapes never change, so they're made once per system
+	std::vector< RefCountedPtr<Graphics::VertexBuffer> > m_orbitBuffers;
+	RefCountedPtr<Graphics::Material> m_orbitMaterial;
 };
 
 #endif /* _SYSTEMVIEW_H */
@@ -133,6 +133,28 @@ double TerrainBody::GetTerrainHeight(const vector3d &pos_) const
 	}
 }
 
+double TerrainBody::GetTerrainHeight(const vector3d &pos_, double tolerance) const
+{
+	double radius = m_sbody->GetRadius();
+	if (m_geosphere) {
+		return radius * (1.0 + m_geosphere->GetHeight(pos_, tolerance / radius));
+	} else {
+		assert(0);
+		return radius;
+	}
+}
+
+double TerrainBody::GetCachedTerrainHeight(const vector3d &pos_) const
+{
+	double radius = m_sbody->GetRadius();
+	if (m_geosphere) {
+		return radius * (1.0 + m_geosphere->GetCachedHeight(pos_));
+	} else {
+		assert(0);
+		return radius;
+	}
+}
+
 bool TerrainBody::IsSuperType(SystemBody::BodySuperType t) const
 {
 	if (!m_sbody) return false;
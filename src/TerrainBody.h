@@ -22,6 +22,14 @@ public:
 	virtual bool OnCollision(Object *b, Uint32 flags, double relVel) { return true; }
 	virtual double GetMass() const { return m_mass; }
 	double GetTerrainHeight(const vector3d &pos) const;
+	// same, but allowed to be out by up to tolerance metres, which lets it
+	// come from the terrain meshes already generated near the camera rather
+	// than the fractal. main thread only
+	double GetTerrainHeight(const vector3d &pos, double tolerance) const;
+	// same as GetTerrainHeight, to within a fraction of a metre, but much
+	// cheaper for repeated queries near each other. for collision and
+	// altitude checks, not for placing things
+	double GetCachedTerrainHeight(const vector3d &pos) const;
 	bool IsSuperType(SystemBody::BodySuperType t) const;
 	virtual const SystemBody *GetSystemBody() const { return m_sbody; }
 	GeoSphere *GetGeoSphere() const { return m_geosphere; }
@@ -0,0 +1,140 @@
+// Copyright © 2008-2013 Pioneer Developers. See AUTHORS.txt for details
+// Licensed under the terms of the GPL v3. See licenses/GPL-3.txt
+
+#include "TerrainHeightCache.h"
+#include "GeoSphere.h"
+#include "libs.h"
+#include <algorithm>
+#include <cmath>
+
+// edge length of the finest and the coarsest cells, in metres (near the
+// middle of a face, cells get smaller towards the cube edges)
+static const double MIN_CELL_SIZE = 1.0;
+static const double MAX_CELL_SIZE = 512.0;
+// how far interpolation is allowed to stray from the real terrain, in metres
+static const double HEIGHT_TOLERANCE = 0.25;
+// cell coordinates have to fit in 28 bits for the keys
+static const int MAX_LEVEL_LIMIT = 28;
+// start over rather than let the cache grow without bound. a ship flying
+// along the ground fills this in a few minutes
+static const size_t MAX_SAMPLES = 32768;
+
+// which cube face a direction passes through and where on that face, with u
+// and v running from -1 to 1
+static void ToFace(const vector3d &p, int &face, double &u, double &v)
+{
+	const double ax = fabs(p.x), ay = fabs(p.y), az = fabs(p.z);
+	if (ax >= ay && ax >= az) {
+		face = p.x > 0.0 ? 0 : 1;
+		u = p.y / ax; v = p.z / ax;
+	} else if (ay >= az) {
+		face = p.y > 0.0 ? 2 : 3;
+		u = p.x / ay; v = p.z / ay;
+	} else {
+		face = p.z > 0.0 ? 4 : 5;
+		u = p.x / az; v = p.y / az;
+	}
+}
+
+static vector3d FromFace(int face, double u, double v)
+{
+	switch (face) {
+		case 0: return vector3d( 1.0, u, v);
+		case 1: return vector3d(-1.0, u, v);
+		case 2: return vector3d(u,  1.0, v);
+		case 3: return vector3d(u, -1.0, v);
+		case 4: return vector3d(u, v,  1.0);
+		default: return vector3d(u, v, -1.0);
+	}
+}
+
+static int LevelForCellSize(double planetRadius, double cellSize)
+{
+	// a face is two units across at one radius out
+	const int level = int(ceil(log(2.0 * planetRadius / cellSize) / log(2.0)));
+	return Clamp(level, 0, MAX_LEVEL_LIMIT);
+}
+
+TerrainHeightCache::TerrainHeightCache(const GeoSphere *geosphere, double planetRadius) :
+	m_geosphere(geosphere),
+	m_minLevel(LevelForCellSize(planetRadius, MAX_CELL_SIZE)),
+	m_maxLevel(LevelForCellSize(planetRadius, MIN_CELL_SIZE)),
+	m_tolerance(HEIGHT_TOLERANCE / planetRadius)
+{
+}
+
+void TerrainHeightCache::Clear()
+{
+	m_samples.clear();
+	m_cells.clear();
+}
+
+double TerrainHeightCache::GetSample(int face, Uint32 i, Uint32 j)
+{
+	const Uint64 key = (Uint64(face) << 58) | (Uint64(i) << 29) | Uint64(j);
+	std::map<Uint64, double>::const_iterator it = m_samples.find(key);
+	if (it != m_samples.end())
+		return it->second;
+
+	if (m_samples.size() >= MAX_SAMPLES)
+		Clear();
+
+	const double scale = 2.0 / double(1u << m_maxLevel);
+	const vector3d p = FromFace(face, i * scale - 1.0, j * scale - 1.0).Normalized();
+	const double h = m_geosphere->GetHeight(p);
+	m_samples.insert(std::make_pair(key, h));
+	return h;
+}
+
+double TerrainHeightCache::GetHeight(const vector3d &p)
+{
+	int face;
+	double u, v;
+	ToFace(p, face, u, v);
+
+	// position in finest level grid points
+	const double gridSize = double(1u << m_maxLevel);
+	const double gu = Clamp((u + 1.0) * 0.5 * gridSize, 0.0, gridSize);
+	const double gv = Clamp((v + 1.0) * 0.5 * gridSize, 0.0, gridSize);
+
+	for (int level = m_minLevel; ; level++) {
+		const int shift = m_maxLevel - level;
+		const Uint32 cellSize = 1u << shift;
+		const Uint32 lastCell = (1u << level) - 1;
+		const Uint32 ci = std::min(Uint32(gu) >> shift, lastCell);
+		const Uint32 cj = std::min(Uint32(gv) >> shift, lastCell);
+		const Uint32 i0 = ci << shift, i1 = i0 + cellSize;
+		const Uint32 j0 = cj << shift, j1 = j0 + cellSize;
+
+		const double h00 = GetSample(face, i0, j0);
+		const double h10 = GetSample(face, i1, j0);
+		const double h01 = GetSample(face, i0, j1);
+		const double h11 = GetSample(face, i1, j1);
+
+		bool flat = (level == m_maxLevel);
+		if (!flat) {
+			const Uint64 cellKey = (Uint64(face) << 61) | (Uint64(level) << 56) | (Uint64(ci) << 28) | Uint64(cj);
+			std::map<Uint64, bool>::const_iterator it = m_cells.find(cellKey);
+			if (it != m_cells.end())
+				flat = it->second;
+			else {
+				// the edge midpoints and centre are the next level's corners,
+				// so the work isn't wasted if the cell turns out to be bumpy
+				const Uint32 im = i0 + cellSize/2, jm = j0 + cellSize/2;
+				flat =
+					fabs(GetSample(face, im, jm) - 0.25 * (h00 + h10 + h01 + h11)) <= m_tolerance &&
+					fabs(GetSample(face, im, j0) - 0.5 * (h00 + h10)) <= m_tolerance &&
+					fabs(GetSample(face, im, j1) - 0.5 * (h01 + h11)) <= m_tolerance &&
+					fabs(GetSample(face, i0, jm) - 0.5 * (h00 + h01)) <= m_tolerance &&
+					fabs(GetSample(face, i1, jm) - 0.5 * (h10 + h11)) <= m_tolerance;
+				m_cells.insert(std::make_pair(cellKey, flat));
+			}
+		}
+
+		if (flat) {
+			const double tu = (gu - double(i0)) / double(cellSize);
+			const double tv = (gv - double(j0)) / double(cellSize);
+			return (1.0 - tv) * ((1.0 - tu) * h00 + tu * h10) + tv * ((1.0 - tu) * h01 + tu * h11);
+		}
+	}
+}
@@ -0,0 +1,55 @@
+// Copyright © 2008-2013 Pioneer Developers. See AUTHORS.txt for details
+// Licensed under the terms of the GPL v3. See licenses/GPL-3.txt
+
+#ifndef _TERRAINHEIGHTCACHE_H
+#define _TERRAINHEIGHTCACHE_H
+
+#include "vector3.h"
+#include <SDL_stdinc.h>
+#include <map>
+
+class GeoSphere;
+
+// remembers terrain heights around recent queries, so bodies sitting on or
+// skimming over the surface don't run the full terrain fractal every tick.
+//
+// heights are sampled on a grid over the faces of a cube wrapped around the
+// planet. a query starts in a coarse cell and only moves down to finer ones
+// while interpolating the cell's corners misses the real height at its centre
+// or edge midpoints by more than the tolerance; once a cell is found to be
+// flat enough the answer is a bilinear blend of its corners. corners and
+// midpoints are shared between neighbouring cells and levels, so after the
+// first few queries in an area almost nothing new gets sampled.
+//
+// results are in the same units as GeoSphere::GetHeight. not thread safe,
+// main thread only
+class TerrainHeightCache {
+public:
+	// planetRadius is in metres and only used to size the grid and tolerance
+	TerrainHeightCache(const GeoSphere *geosphere, double planetRadius);
+
+	// p is a unit vector from the planet centre
+	double GetHeight(const vector3d &p);
+
+	// forget everything, for when the terrain changes underneath us
+	void Clear();
+
+	size_t GetNumSamples() const { return m_samples.size(); }
+	// in planet radii
+	double GetTolerance() const { return m_tolerance; }
+
+private:
+	// i and j are grid points at the finest level
+	double GetSample(int face, Uint32 i, Uint32 j);
+
+	const GeoSphere *m_geosphere;
+	int m_minLevel;
+	int m_maxLevel;
+	double m_tolerance; // in planet radii
+
+	std::map<Uint64, double> m_samples;
+	// cells we've already tested, and whether they were flat enough
+	std::map<Uint64, bool> m_cells;
+};
+
+#endif
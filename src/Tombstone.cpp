@@ -5,6 +5,7 @@
 #include "Lang.h"
 #include "Pi.h"
 #include "graphics/Renderer.h"
+#include "graphics/TextureGL.h"
 #include "scenegraph/SceneGraph.h"
 
 Tombstone::Tombstone(Graphics::Renderer *r, int width, int height)
@@ -34,5 +35,6 @@ void Tombstone::Draw(float _time)
 	rot[14] = -std::max(150.0f - 30.0f*_time, 30.0f);
 	m_model->Render(rot);
 	glPopAttrib();
+	Graphics::TextureGL::InvalidateBindings(); // glPopAttrib put back the old texture bindings
 	m_renderer->SetAmbientColor(oldSceneAmbientColor);
 }
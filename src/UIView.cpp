@@ -2,6 +2,7 @@
 // Licensed under the terms of the GPL v3. See licenses/GPL-3.txt
 
 #include "UIView.h"
+#include "FrameProfiler.h"
 #include "Pi.h"
 #include "ui/Context.h"
 #include "gameui/Panel.h"
@@ -13,6 +14,7 @@ void UIView::Update()
 
 void UIView::Draw3D()
 {
+	FrameProfiler::ScopedPass pass(FrameProfiler::PASS_UI);
 	Pi::ui->Draw();
 }
 
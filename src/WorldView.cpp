@@ -574,10 +574,11 @@ void WorldView::RefreshButtonStateAndVisibility()
 #endif
 	if (Pi::player->GetFlightState() == Ship::HYPERSPACE) {
 		const SystemPath dest = Pi::player->GetHyperspaceDest();
-		RefCountedPtr<StarSystem> s = StarSystem::GetCached(dest);
+		// only the name, which doesn't need the system generated
+		const StarSystemSummary s = StarSystem::GetSummary(dest);
 
 		Pi::cpan->SetOverlayText(ShipCpanel::OVERLAY_TOP_LEFT, stringf(Lang::IN_TRANSIT_TO_N_X_X_X,
-			formatarg("system", s->GetName()),
+			formatarg("system", s.GetName()),
 			formatarg("x", dest.sectorX),
 			formatarg("y", dest.sectorY),
 			formatarg("z", dest.sectorZ)));
@@ -622,7 +623,7 @@ void WorldView::RefreshButtonStateAndVisibility()
 			double radius;
 			vector3d surface_pos = Pi::player->GetPosition().Normalized();
 			if (astro->IsType(Object::TERRAINBODY)) {
-				radius = static_cast<TerrainBody*>(astro)->GetTerrainHeight(surface_pos);
+				radius = static_cast<TerrainBody*>(astro)->GetCachedTerrainHeight(surface_pos);
 			} else {
 				// XXX this is an improper use of GetBoundingRadius
 				// since it is not a surface radius
@@ -745,14 +746,14 @@ void WorldView::RefreshButtonStateAndVisibility()
 			}
 			else {
 				const SystemPath dest = ship->GetHyperspaceDest();
-				Sector s(dest.sectorX, dest.sectorY, dest.sectorZ);
+				RefCountedPtr<Sector> s = Sector::GetCached(dest);
 				text += (cloud->IsArrival() ? Lang::HYPERSPACE_ARRIVAL_CLOUD : Lang::HYPERSPACE_DEPARTURE_CLOUD);
 				text += "\n";
 				text += stringf(Lang::SHIP_MASS_N_TONNES, formatarg("mass", ship->GetStats().total_mass));
 				text += "\n";
 				text += (cloud->IsArrival() ? Lang::SOURCE : Lang::DESTINATION);
 				text += ": ";
-				text += s.m_systems[dest.systemIndex].name;
+				text += s->GetSystemName(dest.systemIndex);
 				text += "\n";
 				text += stringf(Lang::DATE_DUE_N, formatarg("date", format_date(cloud->GetDueDate())));
 				text += "\n";
@@ -1015,8 +1016,8 @@ void WorldView::OnHyperspaceTargetChanged()
 
 	const SystemPath path = Pi::sectorView->GetHyperspaceTarget();
 
-	RefCountedPtr<StarSystem> system = StarSystem::GetCached(path);
-	Pi::cpan->MsgLog()->Message("", stringf(Lang::SET_HYPERSPACE_DESTINATION_TO, formatarg("system", system->GetName())));
+	const StarSystemSummary system = StarSystem::GetSummary(path);
+	Pi::cpan->MsgLog()->Message("", stringf(Lang::SET_HYPERSPACE_DESTINATION_TO, formatarg("system", system.GetName())));
 }
 
 void WorldView::OnPlayerChangeTarget()
@@ -1214,22 +1215,41 @@ void WorldView::UpdateProjectedObjects()
 	const Frame *cam_frame = m_camera->GetCamFrame();
 	matrix3x3d cam_rot = cam_frame->GetOrient();
 
-	// determine projected positions and update labels
+	// determine projected positions and update labels. the camera has
+	// already worked out where everything is relative to it, so that's used
+	// rather than going through the frames again for every body
+	const std::vector<Camera::BodyAttrs> &bodies = m_camera->GetSortedBodies();
+
+	// the camera's never far from the player, so if the player's out of
+	// view this is near enough
+	vector3d playerViewCoords(0.0);
+	for (std::vector<Camera::BodyAttrs>::const_iterator i = bodies.begin(); i != bodies.end(); ++i)
+		if ((*i).body == Pi::player) {
+			playerViewCoords = (*i).viewCoords;
+			break;
+		}
+
+	// nearest first, so that where labels would overlap it's the nearest
+	// body that keeps its label
 	m_bodyLabels->Clear();
 	m_projectedPos.clear();
-	for (Space::BodyIterator i = Pi::game->GetSpace()->BodiesBegin(); i != Pi::game->GetSpace()->BodiesEnd(); ++i) {
-		Body *b = *i;
+	for (std::vector<Camera::BodyAttrs>::const_reverse_iterator i = bodies.rbegin(); i != bodies.rend(); ++i) {
+		Body *b = (*i).body;
 
 		// don't show the player label on internal camera
 		if (b->IsType(Object::PLAYER) && GetCamType() == CAM_INTERNAL)
 			continue;
 
-		vector3d pos = b->GetInterpPositionRelTo(cam_frame);
+		vector3d pos = (*i).viewCoords;
 		if ((pos.z < -1.0) && project_to_screen(pos, pos, frustum, guiSize)) {
 
+			// nothing off the screen can be seen or clicked on
+			if (pos.x < 0.0 || pos.y < 0.0 || pos.x >= guiSize[0] || pos.y >= guiSize[1])
+				continue;
+
 			// only show labels on large or nearby bodies
-			if (b->IsType(Object::PLANET) || b->IsType(Object::STAR) || b->IsType(Object::SPACESTATION) || Pi::player->GetPositionRelTo(b).LengthSqr() < 1000000.0*1000000.0)
-				m_bodyLabels->Add((*i)->GetLabel(), sigc::bind(sigc::mem_fun(this, &WorldView::SelectBody), *i, true), float(pos.x), float(pos.y));
+			if (b->IsType(Object::PLANET) || b->IsType(Object::STAR) || b->IsType(Object::SPACESTATION) || ((*i).viewCoords - playerViewCoords).LengthSqr() < 1000000.0*1000000.0)
+				m_bodyLabels->Add(b->GetLabel(), sigc::bind(sigc::mem_fun(this, &WorldView::SelectBody), b, true), float(pos.x), float(pos.y));
 
 			m_projectedPos[b] = pos;
 		}
@@ -22,4 +22,9 @@
 #define WITH_DEVKEYS 1
 #endif
 
+// define to build in the cpu profiler zones. without it PROFILE_ZONE is empty
+#ifndef WITH_PROFILER
+#define WITH_PROFILER WITH_DEVKEYS
+#endif
+
 #endif
@@ -5,8 +5,51 @@
 #include "../buildopts.h"
 #include <stdio.h>
 #include <float.h>
+#include <algorithm>
 
-BVHTree::BVHTree(int numObjs, const objPtr_t *objPtrs, const Aabb *objAabbs)
+// number of centroid bins the surface area heuristic sorts objects into
+static const int SAH_BINS_FAST = 8;
+static const int SAH_BINS_QUALITY = 32;
+// cost of visiting a node relative to testing one object against a ray or edge
+static const double SAH_TRAVERSAL_COST = 1.0;
+// nodes with more objects than this are always split if they can be
+static const int SAH_MAX_LEAF_OBJS = 4;
+// the traversals in GeomTree and Geom use fixed size stacks of 32 nodes, so
+// pathological meshes get fat leaves rather than overflowing them
+static const int MAX_TREE_DEPTH = 28;
+
+static inline void ResetBox(Aabb &box)
+{
+	box.min = vector3d(DBL_MAX, DBL_MAX, DBL_MAX);
+	box.max = vector3d(-DBL_MAX, -DBL_MAX, -DBL_MAX);
+}
+
+// Aabb::Update also tracks a radius we have no use for here
+static inline void GrowBox(Aabb &box, const vector3d &min, const vector3d &max)
+{
+	box.min.x = std::min(box.min.x, min.x);
+	box.min.y = std::min(box.min.y, min.y);
+	box.min.z = std::min(box.min.z, min.z);
+	box.max.x = std::max(box.max.x, max.x);
+	box.max.y = std::max(box.max.y, max.y);
+	box.max.z = std::max(box.max.z, max.z);
+}
+
+// only ever compared against other areas, so the factor of two is dropped
+static inline double HalfArea(const Aabb &box)
+{
+	const vector3d d = box.max - box.min;
+	return d.x*d.y + d.y*d.z + d.z*d.x;
+}
+
+static inline int BinIndex(double pos, double min, double scale, int numBins)
+{
+	const int b = int((pos - min) * scale);
+	return Clamp(b, 0, numBins-1);
+}
+
+BVHTree::BVHTree(int numObjs, const objPtr_t *objPtrs, const Aabb *objAabbs, BuildMode mode) :
+	m_buildMode(mode)
 {
 	std::vector<int> activeObjIdxs(numObjs);
 	for (int i=0; i<numObjs; i++) activeObjIdxs[i] = i;
@@ -20,7 +63,54 @@ BVHTree::BVHTree(int numObjs, const objPtr_t *objPtrs, const Aabb *objAabbs)
 	m_nodeAllocMax = numObjs*2 + 1;
 
 	m_root = AllocNode();
-	BuildNode(m_root, objPtrs, objAabbs, activeObjIdxs);
+	BuildNode(m_root, objPtrs, objAabbs, activeObjIdxs, 0);
+}
+
+void BVHTree::Save(FILE *f) const
+{
+	const Uint32 numNodes = m_nodeAllocPos;
+	const Uint32 numObjs = m_objPtrAllocPos;
+	fwrite(&numNodes, sizeof(numNodes), 1, f);
+	fwrite(&numObjs, sizeof(numObjs), 1, f);
+	fwrite(m_bvhNodes, sizeof(BVHNode), numNodes, f);
+	fwrite(m_objPtrAlloc, sizeof(objPtr_t), numObjs, f);
+}
+
+BVHTree *BVHTree::Load(FILE *f)
+{
+	Uint32 numNodes, numObjs;
+	if (fread(&numNodes, sizeof(numNodes), 1, f) != 1 || fread(&numObjs, sizeof(numObjs), 1, f) != 1)
+		return 0;
+	if (numNodes == 0 || numObjs == 0 || numNodes > 2*numObjs + 1)
+		return 0;
+
+	BVHTree *tree = new BVHTree;
+	tree->m_buildMode = BUILD_QUALITY;
+	tree->m_bvhNodes = new BVHNode[numNodes];
+	tree->m_nodeAllocPos = tree->m_nodeAllocMax = numNodes;
+	tree->m_objPtrAlloc = new objPtr_t[numObjs];
+	tree->m_objPtrAllocPos = tree->m_objPtrAllocMax = numObjs;
+	tree->m_root = tree->m_bvhNodes;
+
+	bool ok = fread(tree->m_bvhNodes, sizeof(BVHNode), numNodes, f) == numNodes &&
+		fread(tree->m_objPtrAlloc, sizeof(objPtr_t), numObjs, f) == numObjs;
+
+	// everything the traversals follow has to stay inside the arrays. the
+	// depth first layout means the right child is always further along, and
+	// the left child is the next node
+	for (Uint32 i = 0; ok && i < numNodes; i++) {
+		const BVHNode &node = tree->m_bvhNodes[i];
+		if (node.IsLeaf())
+			ok = node.offset < numObjs && node.numTris <= numObjs - node.offset;
+		else
+			ok = node.offset > 1 && node.offset < numNodes - i;
+	}
+
+	if (!ok) {
+		delete tree;
+		return 0;
+	}
+	return tree;
 }
 
 void BVHTree::MakeLeaf(BVHNode *node, const objPtr_t *objPtrs, std::vector<objPtr_t> &objs)
@@ -33,7 +123,7 @@ void BVHTree::MakeLeaf(BVHNode *node, const objPtr_t *objPtrs, std::vector<objPt
 	}
 
 	node->numTris = numTris;
-	node->triIndicesStart = &m_objPtrAlloc[m_objPtrAllocPos];
+	node->offset = m_objPtrAllocPos;
 	//if (objs.size()>3) printf("fat node %d\n", objs.size());
 
 	// copy tri indices to the stinking flat array
@@ -45,95 +135,130 @@ void BVHTree::MakeLeaf(BVHNode *node, const objPtr_t *objPtrs, std::vector<objPt
 void BVHTree::BuildNode(BVHNode *node,
 			const objPtr_t *objPtrs,
 			const Aabb *objAabbs,
-			std::vector<objPtr_t> &activeObjIdx)
+			std::vector<objPtr_t> &activeObjIdx,
+			int depth)
 {
 	const int numTris = activeObjIdx.size();
 	if (numTris <= 0) Error("BuildNode called with no elements in activeObjIndex.");
 
-	if (numTris == 1) {
+	Aabb aabb, centroidBox;
+	ResetBox(aabb);
+	ResetBox(centroidBox);
+	for (int i=0; i<numTris; i++) {
+		const Aabb &objAabb = objAabbs[activeObjIdx[i]];
+		GrowBox(aabb, objAabb.min, objAabb.max);
+		const vector3d mid = 0.5 * (objAabb.min + objAabb.max);
+		GrowBox(centroidBox, mid, mid);
+	}
+	node->min = vector3f(aabb.min);
+	node->max = vector3f(aabb.max);
+
+	if (numTris == 1 || depth >= MAX_TREE_DEPTH) {
 		MakeLeaf(node, objPtrs, activeObjIdx);
 		return;
 	}
 
-	std::vector<int> splitSides(numTris);
+	const int numBins = (m_buildMode == BUILD_QUALITY) ? SAH_BINS_QUALITY : SAH_BINS_FAST;
+	const vector3d centroidSize = centroidBox.max - centroidBox.min;
 
-	Aabb aabb;
-	aabb.min = vector3d(FLT_MAX, FLT_MAX, FLT_MAX);
-	aabb.max = vector3d(-FLT_MAX, -FLT_MAX, -FLT_MAX);
-
-	for (int i=0; i<numTris; i++) {
-		int idx = activeObjIdx[i];
-		aabb.Update(objAabbs[idx].min);
-		aabb.Update(objAabbs[idx].max);
+	// fast mode only bins along the axis the centroids are most spread out on
+	int firstAxis = 0, lastAxis = 2;
+	if (m_buildMode == BUILD_FAST) {
+		int longest = 0;
+		if (centroidSize[1] > centroidSize[longest]) longest = 1;
+		if (centroidSize[2] > centroidSize[longest]) longest = 2;
+		firstAxis = lastAxis = longest;
 	}
-	node->numTris = numTris;
-	node->aabb = aabb;
-
-	Aabb splitBox = aabb;
-	double splitPos;
-	int splitAxis;
-	int s1count, s2count;
-	int attempt = 0;
-
-	for (;;) {
-		splitAxis = 0;
 
-		vector3d boxSize = splitBox.max - splitBox.min;
+	Aabb binBox[SAH_BINS_QUALITY];
+	int binCount[SAH_BINS_QUALITY];
+	double rightArea[SAH_BINS_QUALITY];
+	int rightCount[SAH_BINS_QUALITY];
 
-		if (boxSize[1] > boxSize[0]) splitAxis = 1;
-		if ((boxSize[2] > boxSize[1]) && (boxSize[2] > boxSize[0])) splitAxis = 2;
+	double bestCost = DBL_MAX;
+	int bestAxis = -1, bestSplit = 0;
 
-		// split pos in middle of splitBox
-		splitPos = 0.5f * (splitBox.min[splitAxis] + splitBox.max[splitAxis]);
-		s1count = 0, s2count = 0;
+	for (int axis = firstAxis; axis <= lastAxis; axis++) {
+		// all the centroids are on one plane, so nothing to split along here
+		if (centroidSize[axis] <= 0.0) continue;
+		const double binScale = numBins / centroidSize[axis];
 
+		for (int b=0; b<numBins; b++) {
+			ResetBox(binBox[b]);
+			binCount[b] = 0;
+		}
 		for (int i=0; i<numTris; i++) {
-			int idx = activeObjIdx[i];
-			double mid = 0.5 * (objAabbs[idx].min[splitAxis] + objAabbs[idx].max[splitAxis]);
-			if (mid < splitPos) {
-				splitSides[i] = 0;
-				s1count++;
-			} else {
-				splitSides[i] = 1;
-				s2count++;
-			}
+			const Aabb &objAabb = objAabbs[activeObjIdx[i]];
+			const double mid = 0.5 * (objAabb.min[axis] + objAabb.max[axis]);
+			const int b = BinIndex(mid, centroidBox.min[axis], binScale, numBins);
+			GrowBox(binBox[b], objAabb.min, objAabb.max);
+			binCount[b]++;
 		}
 
-		if (s1count == numTris) {
-			if (attempt < MAX_SPLITPOS_RETRIES) {
-				// try splitting at average point
-				splitBox.max[splitAxis] = splitPos;
-				attempt++;
-				continue;
-			} else {
-				MakeLeaf(node, objPtrs, activeObjIdx);
-				return;
-			}
-		} else if (s2count == numTris) {
-			if (attempt < MAX_SPLITPOS_RETRIES) {
-				// try splitting at average point
-				splitBox.min[splitAxis] = splitPos;
-				attempt++;
-				continue;
-			} else {
-				MakeLeaf(node, objPtrs, activeObjIdx);
-				return;
+		// sweep from the right to get the cost of everything past each split,
+		// then from the left to find the cheapest one. splitting at b puts
+		// bins [0,b) on the left and [b,numBins) on the right
+		Aabb acc;
+		ResetBox(acc);
+		int count = 0;
+		for (int b=numBins-1; b>0; b--) {
+			if (binCount[b]) GrowBox(acc, binBox[b].min, binBox[b].max);
+			count += binCount[b];
+			rightArea[b] = count ? HalfArea(acc) : 0.0;
+			rightCount[b] = count;
+		}
+		ResetBox(acc);
+		count = 0;
+		for (int b=1; b<numBins; b++) {
+			if (binCount[b-1]) GrowBox(acc, binBox[b-1].min, binBox[b-1].max);
+			count += binCount[b-1];
+			if (!count || !rightCount[b]) continue;
+			const double cost = HalfArea(acc) * count + rightArea[b] * rightCount[b];
+			if (cost < bestCost) {
+				bestCost = cost;
+				bestAxis = axis;
+				bestSplit = b;
 			}
 		}
-		break;
+	}
+
+	// every centroid in the same place; there's no split that would help
+	if (bestAxis < 0) {
+		MakeLeaf(node, objPtrs, activeObjIdx);
+		return;
+	}
+
+	// small nodes are only split if the heuristic says that's cheaper than
+	// testing everything in them
+	if (numTris <= SAH_MAX_LEAF_OBJS) {
+		const double nodeArea = HalfArea(aabb);
+		const double splitCost = SAH_TRAVERSAL_COST + (nodeArea > 0.0 ? bestCost / nodeArea : 0.0);
+		if (splitCost >= double(numTris)) {
+			MakeLeaf(node, objPtrs, activeObjIdx);
+			return;
+		}
 	}
 
 	std::vector<int> side[2];
+	side[0].reserve(numTris);
+	side[1].reserve(numTris);
 
+	const double binScale = numBins / centroidSize[bestAxis];
 	for (int i=0; i<numTris; i++) {
-		side[splitSides[i]].push_back(activeObjIdx[i]);
+		const int idx = activeObjIdx[i];
+		const double mid = 0.5 * (objAabbs[idx].min[bestAxis] + objAabbs[idx].max[bestAxis]);
+		const int b = BinIndex(mid, centroidBox.min[bestAxis], binScale, numBins);
+		side[b < bestSplit ? 0 : 1].push_back(idx);
 	}
 
-	// recurse!
-	node->triIndicesStart = 0;
-	node->kids[0] = AllocNode();
-	node->kids[1] = AllocNode();
+	// recurse! the left subtree is built straight after this node, and the
+	// right one after all of that
+	node->numTris = 0;
+	BVHNode *left = AllocNode();
+	assert(left == node + 1);
+	BuildNode(left, objPtrs, objAabbs, side[0], depth+1);
 
-	BuildNode(node->kids[0], objPtrs, objAabbs, side[0]);
-	BuildNode(node->kids[1], objPtrs, objAabbs, side[1]);
+	BVHNode *right = AllocNode();
+	node->offset = Uint32(right - node);
+	BuildNode(right, objPtrs, objAabbs, side[1], depth+1);
 }
@@ -5,51 +5,84 @@
 #define _BVHTREE_H
 
 #include <assert.h>
+#include <stdio.h>
 #include <vector>
 #include "../vector3.h"
 #include "../Aabb.h"
 #include "../utils.h"
 
-#define MAX_SPLITPOS_RETRIES 15
-
+// nodes are stored depth first in one array, so an interior node's left
+// child is always the next node and a node fits in 32 bytes. the bounds come
+// from float vertices, so keeping them as floats loses nothing
 struct BVHNode {
-	Aabb aabb;
-
-	/* if triIndicesStart == 0 then not leaf,
-	 * kids[] valid */
-	int numTris;
-	int *triIndicesStart;
-
-	BVHNode *kids[2];
+	vector3f min;
+	// leaves: index of the first object in BVHTree::GetLeafObjs.
+	// interior nodes: how many nodes along the right child is
+	Uint32 offset;
+	vector3f max;
+	// zero for interior nodes
+	Uint32 numTris;
 
-	BVHNode() {
-		kids[0] = 0;
-		triIndicesStart = 0;
-	}
+	BVHNode() : offset(0), numTris(0) {}
 	bool IsLeaf() const {
-		return triIndicesStart != 0;
+		return numTris != 0;
+	}
+	const BVHNode *GetLeft() const { return this + 1; }
+	const BVHNode *GetRight() const { return this + offset; }
+	Aabb GetAabb() const {
+		Aabb aabb;
+		aabb.min = vector3d(min);
+		aabb.max = vector3d(max);
+		return aabb;
 	}
 };
 
 class BVHTree {
 public:
 	typedef int objPtr_t;
-	BVHTree(int numObjs, const objPtr_t *objPtrs, const Aabb *objAabbs);
+
+	// both modes place splits with a binned surface area heuristic. fast
+	// only looks at the longest axis with a few bins; quality tries every
+	// axis with more bins, which takes a few times longer to build but
+	// gives cheaper traversals
+	enum BuildMode {
+		BUILD_FAST,
+		BUILD_QUALITY
+	};
+
+	BVHTree(int numObjs, const objPtr_t *objPtrs, const Aabb *objAabbs, BuildMode mode = BUILD_QUALITY);
 	~BVHTree() {
 		delete [] m_objPtrAlloc;
 		delete [] m_bvhNodes;
 	}
-	BVHNode *GetRoot() { return m_root; }
+	const BVHNode *GetRoot() const { return m_root; }
+
+	// raw dump of the nodes and object list, in native byte order. Load
+	// returns 0 if the data is short or doesn't describe a sane tree
+	void Save(FILE *f) const;
+	static BVHTree *Load(FILE *f);
+
+	const objPtr_t *GetObjs() const { return m_objPtrAlloc; }
+	int GetNumObjs() const { return int(m_objPtrAllocPos); }
+
+	// the objects under a leaf are numTris entries starting here
+	const objPtr_t *GetLeafObjs(const BVHNode *leaf) const {
+		assert(leaf->IsLeaf());
+		return &m_objPtrAlloc[leaf->offset];
+	}
 private:
+	BVHTree() {}
 	void BuildNode(BVHNode *node,
 			const objPtr_t *objPtrs,
 			const Aabb *objAabbs,
-			std::vector<objPtr_t> &activeObjIdxs);
+			std::vector<objPtr_t> &activeObjIdxs,
+			int depth);
 	void MakeLeaf(BVHNode *node, const objPtr_t *objPtrs, std::vector<objPtr_t> &objs);
 	BVHNode *AllocNode() {
 		if (m_nodeAllocPos >= m_nodeAllocMax) Error("Out of space in m_bvhNodes.");
 		return &m_bvhNodes[m_nodeAllocPos++];
 	}
+	BuildMode m_buildMode;
 	BVHNode *m_root;
 	objPtr_t *m_objPtrAlloc;
 	size_t m_objPtrAllocPos;
@@ -194,6 +194,335 @@ void BvhTree::BuildNode(BvhNode *node, const std::list<Geom*> &a_geoms, int &out
 
 ///////////////////////////////////////////////////////////////////////
 
+/*
+ * Incrementally maintained tree of the moving geoms. Each leaf holds one geom
+ * with a fattened aabb, and only needs reinserting when the geom leaves it,
+ * so most ticks touch nothing but the containment tests. Inserts pick the
+ * sibling that grows the tree's surface area least and rotations keep it
+ * balanced.
+ */
+class DynamicBvhTree {
+public:
+	DynamicBvhTree() : m_root(NULL_NODE), m_freeList(NULL_NODE) {}
+
+	void Insert(Geom *g);
+	void Remove(Geom *g);
+	// reinsert g if it has moved out of its fat aabb
+	void Update(Geom *g);
+	void CollideGeom(Geom *, const Aabb &, int minMailboxValue, void (*callback)(CollisionContact*));
+
+private:
+	enum { NULL_NODE = -1 };
+
+	struct Node {
+		Aabb aabb;
+		vector3d lastPos;	// leaves: where the geom was at the last update
+		Geom *geom;			// leaves only
+		int parent;			// doubles as the free list link
+		int kids[2];
+		int height;			// leaves are 0, free nodes -1
+		bool IsLeaf() const { return kids[0] == NULL_NODE; }
+	};
+
+	int AllocNode();
+	void FreeNode(int idx);
+	void InsertLeaf(int leaf);
+	void RemoveLeaf(int leaf);
+	void RefitFrom(int idx);
+	int Balance(int idx);
+
+	std::vector<Node> m_nodes;
+	int m_root;
+	int m_freeList;
+	std::vector<int> m_stack;
+};
+
+// fat aabbs are this much of the geom's radius bigger on every side
+static const double FAT_AABB_MARGIN = 0.25;
+// and stretched this many ticks worth of movement ahead of it
+static const double FAT_AABB_DISPLACEMENT = 2.0;
+
+static inline void GeomAabb(Geom *g, Aabb &aabb)
+{
+	const vector3d pos = g->GetPosition();
+	const double rad = g->GetGeomTree()->GetRadius();
+	aabb.min = pos - vector3d(rad, rad, rad);
+	aabb.max = pos + vector3d(rad, rad, rad);
+}
+
+static inline Aabb CombineAabbs(const Aabb &a, const Aabb &b)
+{
+	Aabb c;
+	c.min = vector3d(std::min(a.min.x, b.min.x), std::min(a.min.y, b.min.y), std::min(a.min.z, b.min.z));
+	c.max = vector3d(std::max(a.max.x, b.max.x), std::max(a.max.y, b.max.y), std::max(a.max.z, b.max.z));
+	return c;
+}
+
+static inline bool AabbContains(const Aabb &outer, const Aabb &inner)
+{
+	return outer.min.x <= inner.min.x && outer.min.y <= inner.min.y && outer.min.z <= inner.min.z &&
+		outer.max.x >= inner.max.x && outer.max.y >= inner.max.y && outer.max.z >= inner.max.z;
+}
+
+// only ever compared, so the factor of two is dropped
+static inline double AabbHalfArea(const Aabb &a)
+{
+	const vector3d d = a.max - a.min;
+	return d.x*d.y + d.y*d.z + d.z*d.x;
+}
+
+int DynamicBvhTree::AllocNode()
+{
+	int idx;
+	if (m_freeList != NULL_NODE) {
+		idx = m_freeList;
+		m_freeList = m_nodes[idx].parent;
+	} else {
+		idx = m_nodes.size();
+		m_nodes.push_back(Node());
+	}
+	Node &n = m_nodes[idx];
+	n.geom = 0;
+	n.parent = NULL_NODE;
+	n.kids[0] = n.kids[1] = NULL_NODE;
+	n.height = 0;
+	return idx;
+}
+
+void DynamicBvhTree::FreeNode(int idx)
+{
+	m_nodes[idx].geom = 0;
+	m_nodes[idx].height = -1;
+	m_nodes[idx].parent = m_freeList;
+	m_freeList = idx;
+}
+
+void DynamicBvhTree::Insert(Geom *g)
+{
+	assert(g->GetProxyIndex() == NULL_NODE);
+	const int leaf = AllocNode();
+	Node &n = m_nodes[leaf];
+	n.geom = g;
+	n.lastPos = g->GetPosition();
+	GeomAabb(g, n.aabb);
+	const double margin = FAT_AABB_MARGIN * g->GetGeomTree()->GetRadius();
+	n.aabb.min -= vector3d(margin, margin, margin);
+	n.aabb.max += vector3d(margin, margin, margin);
+	g->SetProxyIndex(leaf);
+	InsertLeaf(leaf);
+}
+
+void DynamicBvhTree::Remove(Geom *g)
+{
+	const int leaf = g->GetProxyIndex();
+	assert(leaf != NULL_NODE && m_nodes[leaf].geom == g);
+	RemoveLeaf(leaf);
+	FreeNode(leaf);
+	g->SetProxyIndex(NULL_NODE);
+}
+
+void DynamicBvhTree::Update(Geom *g)
+{
+	const int leaf = g->GetProxyIndex();
+	assert(leaf != NULL_NODE && m_nodes[leaf].geom == g);
+
+	const vector3d pos = g->GetPosition();
+	const vector3d displacement = FAT_AABB_DISPLACEMENT * (pos - m_nodes[leaf].lastPos);
+	m_nodes[leaf].lastPos = pos;
+
+	Aabb aabb;
+	GeomAabb(g, aabb);
+	if (AabbContains(m_nodes[leaf].aabb, aabb)) return;
+
+	// fatten, and stretch the box along the way it's going so a geom
+	// moving steadily doesn't need reinserting every tick
+	const double margin = FAT_AABB_MARGIN * g->GetGeomTree()->GetRadius();
+	aabb.min -= vector3d(margin, margin, margin);
+	aabb.max += vector3d(margin, margin, margin);
+	for (int i=0; i<3; i++) {
+		if (displacement[i] < 0.0) aabb.min[i] += displacement[i];
+		else aabb.max[i] += displacement[i];
+	}
+
+	RemoveLeaf(leaf);
+	m_nodes[leaf].aabb = aabb;
+	InsertLeaf(leaf);
+}
+
+void DynamicBvhTree::InsertLeaf(int leaf)
+{
+	if (m_root == NULL_NODE) {
+		m_root = leaf;
+		m_nodes[leaf].parent = NULL_NODE;
+		return;
+	}
+
+	// walk down to the cheapest sibling. the cost of pairing with a node is
+	// the area of the new parent, plus how much every ancestor grows
+	const Aabb leafAabb = m_nodes[leaf].aabb;
+	int idx = m_root;
+	while (!m_nodes[idx].IsLeaf()) {
+		const Node &n = m_nodes[idx];
+		const double area = AabbHalfArea(n.aabb);
+		const double combinedArea = AabbHalfArea(CombineAabbs(n.aabb, leafAabb));
+		const double cost = 2.0 * combinedArea;
+		const double inheritanceCost = 2.0 * (combinedArea - area);
+
+		double kidCost[2];
+		for (int k=0; k<2; k++) {
+			const Node &kid = m_nodes[n.kids[k]];
+			const double newArea = AabbHalfArea(CombineAabbs(kid.aabb, leafAabb));
+			kidCost[k] = inheritanceCost + (kid.IsLeaf() ? newArea : newArea - AabbHalfArea(kid.aabb));
+		}
+
+		if (cost < kidCost[0] && cost < kidCost[1]) break;
+		idx = (kidCost[0] < kidCost[1]) ? n.kids[0] : n.kids[1];
+	}
+	const int sibling = idx;
+
+	// AllocNode can move m_nodes, so no references are held across it
+	const int oldParent = m_nodes[sibling].parent;
+	const int newParent = AllocNode();
+	m_nodes[newParent].parent = oldParent;
+	m_nodes[newParent].aabb = CombineAabbs(leafAabb, m_nodes[sibling].aabb);
+	m_nodes[newParent].height = m_nodes[sibling].height + 1;
+	m_nodes[newParent].kids[0] = sibling;
+	m_nodes[newParent].kids[1] = leaf;
+	m_nodes[sibling].parent = newParent;
+	m_nodes[leaf].parent = newParent;
+
+	if (oldParent != NULL_NODE) {
+		Node &p = m_nodes[oldParent];
+		p.kids[p.kids[0] == sibling ? 0 : 1] = newParent;
+	} else {
+		m_root = newParent;
+	}
+
+	RefitFrom(m_nodes[leaf].parent);
+}
+
+void DynamicBvhTree::RemoveLeaf(int leaf)
+{
+	if (leaf == m_root) {
+		m_root = NULL_NODE;
+		return;
+	}
+
+	const int parent = m_nodes[leaf].parent;
+	const int grandParent = m_nodes[parent].parent;
+	const int sibling = m_nodes[parent].kids[m_nodes[parent].kids[0] == leaf ? 1 : 0];
+
+	// the sibling takes the parent's place
+	if (grandParent != NULL_NODE) {
+		Node &gp = m_nodes[grandParent];
+		gp.kids[gp.kids[0] == parent ? 0 : 1] = sibling;
+		m_nodes[sibling].parent = grandParent;
+		FreeNode(parent);
+		RefitFrom(grandParent);
+	} else {
+		m_root = sibling;
+		m_nodes[sibling].parent = NULL_NODE;
+		FreeNode(parent);
+	}
+}
+
+// fix up bounds and heights from idx to the root, rebalancing on the way
+void DynamicBvhTree::RefitFrom(int idx)
+{
+	while (idx != NULL_NODE) {
+		idx = Balance(idx);
+		Node &n = m_nodes[idx];
+		const Node &a = m_nodes[n.kids[0]];
+		const Node &b = m_nodes[n.kids[1]];
+		n.height = 1 + std::max(a.height, b.height);
+		n.aabb = CombineAabbs(a.aabb, b.aabb);
+		idx = n.parent;
+	}
+}
+
+// if one of idx's subtrees is more than one taller than the other, rotate
+// that subtree's root up into idx's place. returns whichever node is now in
+// idx's place
+int DynamicBvhTree::Balance(int iA)
+{
+	Node &A = m_nodes[iA];
+	if (A.IsLeaf() || A.height < 2) return iA;
+
+	const int balance = m_nodes[A.kids[1]].height - m_nodes[A.kids[0]].height;
+	if (balance >= -1 && balance <= 1) return iA;
+
+	// the taller kid (up) and the shorter one (other)
+	const int upSide = (balance > 1) ? 1 : 0;
+	const int iUp = A.kids[upSide];
+	const int iOther = A.kids[1-upSide];
+	Node &up = m_nodes[iUp];
+	const int iF = up.kids[0];
+	const int iG = up.kids[1];
+
+	// up takes A's place and A becomes its first kid
+	up.kids[0] = iA;
+	up.parent = A.parent;
+	A.parent = iUp;
+	if (up.parent != NULL_NODE) {
+		Node &p = m_nodes[up.parent];
+		p.kids[p.kids[0] == iA ? 0 : 1] = iUp;
+	} else {
+		m_root = iUp;
+	}
+
+	// up keeps its taller kid and hands the shorter one to A
+	const int iKeep = (m_nodes[iF].height > m_nodes[iG].height) ? iF : iG;
+	const int iGive = (iKeep == iF) ? iG : iF;
+	up.kids[1] = iKeep;
+	A.kids[upSide] = iGive;
+	m_nodes[iGive].parent = iA;
+
+	A.aabb = CombineAabbs(m_nodes[iOther].aabb, m_nodes[iGive].aabb);
+	A.height = 1 + std::max(m_nodes[iOther].height, m_nodes[iGive].height);
+	up.aabb = CombineAabbs(A.aabb, m_nodes[iKeep].aabb);
+	up.height = 1 + std::max(A.height, m_nodes[iKeep].height);
+
+	return iUp;
+}
+
+void DynamicBvhTree::CollideGeom(Geom *g, const Aabb &geomAabb, int minMailboxValue, void (*callback)(CollisionContact*))
+{
+	if (m_root == NULL_NODE) return;
+
+	// our big aabb
+	vector3d pos = g->GetPosition();
+	double radius = g->GetGeomTree()->GetRadius();
+
+	m_stack.clear();
+	m_stack.push_back(m_root);
+
+	while (!m_stack.empty()) {
+		const Node &node = m_nodes[m_stack.back()];
+		m_stack.pop_back();
+
+		if (!geomAabb.Intersects(node.aabb)) continue;
+
+		if (!node.IsLeaf()) {
+			m_stack.push_back(node.kids[0]);
+			m_stack.push_back(node.kids[1]);
+			continue;
+		}
+
+		Geom *g2 = node.geom;
+		if (!g2->IsEnabled()) continue;
+		if (g2->GetMailboxIndex() < minMailboxValue) continue;
+		if (g2 == g) continue;
+		if (g->GetGroup() && g2->GetGroup() == g->GetGroup()) continue;
+		double radius2 = g2->GetGeomTree()->GetRadius();
+		vector3d pos2 = g2->GetPosition();
+		if ((pos-pos2).Length() <= (radius + radius2)) {
+			g->Collide(g2, callback);
+		}
+	}
+}
+
+///////////////////////////////////////////////////////////////////////
+
 int CollisionSpace::s_nextHandle = 1;
 
 CollisionSpace::CollisionSpace()
@@ -201,23 +530,27 @@ CollisionSpace::CollisionSpace()
 	sphere.radius = 0;
 	m_needStaticGeomRebuild = true;
 	m_staticObjectTree = 0;
-	m_dynamicObjectTree = 0;
+	m_dynamicObjectTree = new DynamicBvhTree();
 }
 
 CollisionSpace::~CollisionSpace()
 {
 	if (m_staticObjectTree) delete m_staticObjectTree;
-	if (m_dynamicObjectTree) delete m_dynamicObjectTree;
+	delete m_dynamicObjectTree;
 }
 
 void CollisionSpace::AddGeom(Geom *geom)
 {
 	m_geoms.push_back(geom);
+	m_dynamicObjectTree->Insert(geom);
 }
 
 void CollisionSpace::RemoveGeom(Geom *geom)
 {
-	m_geoms.remove(geom);
+	std::list<Geom*>::iterator i = std::find(m_geoms.begin(), m_geoms.end(), geom);
+	if (i == m_geoms.end()) return;
+	m_geoms.erase(i);
+	m_dynamicObjectTree->Remove(geom);
 }
 
 void CollisionSpace::AddStaticGeom(Geom *geom)
@@ -264,101 +597,155 @@ void CollisionSpace::CollideRaySphere(const vector3d &start, const vector3d &dir
 
 void CollisionSpace::TraceRay(const vector3d &start, const vector3d &dir, double len, CollisionContact *c, Geom *ignore)
 {
-	vector3d invDir(1.0/dir.x, 1.0/dir.y, 1.0/dir.z);
-	c->dist = len;
+	Ray ray;
+	ray.start = start;
+	ray.dir = dir;
+	ray.len = len;
+	ray.ignore = ignore;
+	TraceRays(1, &ray, c);
+}
 
-	BvhNode *vn_stack[16];
-	BvhNode *node = m_staticObjectTree->m_root;
-	int stackPos = -1;
+// trace some rays through one geom's tree, keeping any hits that are closer
+// than what the rays have already found
+void CollisionSpace::TraceRaysAgainstGeom(Geom *g, const Ray *rays, const int *rayIdxs, int numRays, CollisionContact *contacts)
+{
+	const matrix4x4d &invTrans = g->GetInvTransform();
+
+	vector3f *modelDirs = reinterpret_cast<vector3f*>(alloca(sizeof(vector3f)*numRays));
+	isect_t *isects = reinterpret_cast<isect_t*>(alloca(sizeof(isect_t)*numRays));
+	for (int i=0; i<numRays; i++) {
+		const Ray &ray = rays[rayIdxs[i]];
+		const vector3d md = invTrans.ApplyRotationOnly(ray.dir);
+		modelDirs[i] = vector3f(md.x, md.y, md.z);
+		isects[i].dist = float(contacts[rayIdxs[i]].dist);
+		isects[i].triIdx = -1;
+	}
+
+	// runs of rays from the same point are a coherent bundle
+	for (int i=0; i<numRays; ) {
+		const vector3d &start = rays[rayIdxs[i]].start;
+		int end = i+1;
+		while (end < numRays && rays[rayIdxs[end]].start.ExactlyEqual(start)) end++;
+
+		const vector3d ms = invTrans * start;
+		const vector3f modelStart = vector3f(ms.x, ms.y, ms.z);
+		if (end - i > 1)
+			g->GetGeomTree()->TraceCoherentRays(end - i, modelStart, &modelDirs[i], &isects[i]);
+		else
+			g->GetGeomTree()->TraceRay(modelStart, modelDirs[i], &isects[i]);
+		i = end;
+	}
+
+	for (int i=0; i<numRays; i++) {
+		const isect_t &isect = isects[i];
+		if (isect.triIdx == -1) continue;
+
+		const Ray &ray = rays[rayIdxs[i]];
+		CollisionContact *c = &contacts[rayIdxs[i]];
+		c->pos = ray.start + ray.dir*double(isect.dist);
+
+		vector3f n = g->GetGeomTree()->GetTriNormal(isect.triIdx);
+		c->normal = vector3d(n.x, n.y, n.z);
+		c->normal = g->GetTransform().ApplyRotationOnly(c->normal);
+
+		c->depth = ray.len - isect.dist;
+		c->triIdx = isect.triIdx;
+		c->userData1 = g->GetUserData();
+		c->userData2 = 0;
+		c->geomFlag = g->GetGeomTree()->GetTriFlag(isect.triIdx);
+		c->dist = isect.dist;
+	}
+}
+
+// a node still to be visited by TraceRays, along with the rays that reached it
+struct RayPacket {
+	BvhNode *node;
+	size_t first, count;
+};
+
+void CollisionSpace::TraceRays(int numRays, const Ray *rays, CollisionContact *contacts)
+{
+	if (numRays <= 0) return;
+
+	std::vector<vector3d> invDirs(numRays);
+	for (int i=0; i<numRays; i++) {
+		invDirs[i] = vector3d(1.0/rays[i].dir.x, 1.0/rays[i].dir.y, 1.0/rays[i].dir.z);
+		contacts[i].dist = rays[i].len;
+	}
+
+	// walk the static tree with the whole batch. each node passes on to its
+	// kids only the rays that hit it, as a run in rayIdxs
+	std::vector<int> rayIdxs(numRays);
+	for (int i=0; i<numRays; i++) rayIdxs[i] = i;
+	std::vector<RayPacket> stack;
+	if (m_staticObjectTree && m_staticObjectTree->m_root) {
+		const RayPacket root = { m_staticObjectTree->m_root, 0, size_t(numRays) };
+		stack.push_back(root);
+	}
+
+	while (!stack.empty()) {
+		const RayPacket e = stack.back();
+		stack.pop_back();
 
-	for (;node;) {
 		// do we hit it?
-		{
+		const size_t first = rayIdxs.size();
+		for (size_t i = e.first; i < e.first + e.count; i++) {
+			const int r = rayIdxs[i];
 			isect_t isect;
-			isect.dist = float(c->dist);
+			isect.dist = float(contacts[r].dist);
 			isect.triIdx = -1;
-			if (!node->CollideRay(start, invDir, &isect)) goto pop_jizz;
+			if (e.node->CollideRay(rays[r].start, invDirs[r], &isect))
+				rayIdxs.push_back(r);
 		}
+		const size_t count = rayIdxs.size() - first;
+		if (!count) continue;
 
-		if (node->geomStart) {
+		if (e.node->geomStart) {
 			// it is a leaf node
 			// collide with all geoms
-			for (int i=0; i<node->numGeoms; i++) {
-				Geom *g = node->geomStart[i];
-
-				const matrix4x4d &invTrans = g->GetInvTransform();
-				vector3d ms = invTrans * start;
-				vector3d md = invTrans.ApplyRotationOnly(dir);
-				vector3f modelStart = vector3f(ms.x, ms.y, ms.z);
-				vector3f modelDir = vector3f(md.x, md.y, md.z);
-
-				isect_t isect;
-				isect.dist = float(c->dist);
-				isect.triIdx = -1;
-				g->GetGeomTree()->TraceRay(modelStart, modelDir, &isect);
-				if (isect.triIdx != -1) {
-					c->pos = start + dir*double(isect.dist);
-
-					vector3f n = g->GetGeomTree()->GetTriNormal(isect.triIdx);
-					c->normal = vector3d(n.x, n.y, n.z);
-					c->normal = g->GetTransform().ApplyRotationOnly(c->normal);
-
-					c->depth = len - isect.dist;
-					c->triIdx = isect.triIdx;
-					c->userData1 = g->GetUserData();
-					c->userData2 = 0;
-					c->geomFlag = g->GetGeomTree()->GetTriFlag(isect.triIdx);
-					c->dist = isect.dist;
-				}
-			}
-		} else if (node->kids[0]) {
-			vn_stack[++stackPos] = node->kids[0];
-			node = node->kids[1];
-			continue;
+			for (int i=0; i<e.node->numGeoms; i++)
+				TraceRaysAgainstGeom(e.node->geomStart[i], rays, &rayIdxs[first], count, contacts);
+		} else if (e.node->kids[0]) {
+			const RayPacket left = { e.node->kids[0], first, count };
+			const RayPacket right = { e.node->kids[1], first, count };
+			stack.push_back(left);
+			stack.push_back(right);
 		}
-pop_jizz:
-		if (stackPos < 0) break;
-		node = vn_stack[stackPos--];
 	}
 
+	// moving geoms. the dynamic tree's bounds are only refreshed when the
+	// space collides, so they're tested one by one, but a bounding sphere
+	// check skips the ones a ray can't reach
+	std::vector<int> geomRays;
+	geomRays.reserve(numRays);
 	for (std::list<Geom*>::iterator i = m_geoms.begin(); i != m_geoms.end(); ++i) {
-		if ((*i) == ignore) continue;
-		if ((*i)->IsEnabled()) {
-			const matrix4x4d &invTrans = (*i)->GetInvTransform();
-			vector3d ms = invTrans * start;
-			vector3d md = invTrans.ApplyRotationOnly(dir);
-			vector3f modelStart = vector3f(ms.x, ms.y, ms.z);
-			vector3f modelDir = vector3f(md.x, md.y, md.z);
-
-			isect_t isect;
-			isect.dist = float(c->dist);
-			isect.triIdx = -1;
-			(*i)->GetGeomTree()->TraceRay(modelStart, modelDir, &isect);
-			if (isect.triIdx != -1) {
-				c->pos = start + dir*double(isect.dist);
-
-				vector3f n = (*i)->GetGeomTree()->GetTriNormal(isect.triIdx);
-				c->normal = vector3d(n.x, n.y, n.z);
-				c->normal = (*i)->GetTransform().ApplyRotationOnly(c->normal);
-
-				c->depth = len - isect.dist;
-				c->triIdx = isect.triIdx;
-				c->userData1 = (*i)->GetUserData();
-				c->userData2 = 0;
-				c->geomFlag = (*i)->GetGeomTree()->GetTriFlag(isect.triIdx);
-				c->dist = isect.dist;
-			}
+		Geom *g = *i;
+		if (!g->IsEnabled()) continue;
+
+		const vector3d pos = g->GetPosition();
+		const double radius = g->GetGeomTree()->GetRadius();
+		geomRays.clear();
+		for (int r=0; r<numRays; r++) {
+			if (rays[r].ignore == g) continue;
+			const vector3d toGeom = pos - rays[r].start;
+			const double along = Clamp(toGeom.Dot(rays[r].dir), 0.0, contacts[r].dist);
+			if ((toGeom - rays[r].dir*along).LengthSqr() > radius*radius) continue;
+			geomRays.push_back(r);
 		}
+		if (!geomRays.empty())
+			TraceRaysAgainstGeom(g, rays, &geomRays[0], geomRays.size(), contacts);
 	}
-	{
+
+	for (int r=0; r<numRays; r++) {
 		isect_t isect;
-		isect.dist = float(c->dist);
+		isect.dist = float(contacts[r].dist);
 		isect.triIdx = -1;
-		CollideRaySphere(start, dir, &isect);
+		CollideRaySphere(rays[r].start, rays[r].dir, &isect);
 		if (isect.triIdx != -1) {
-			c->pos = start + dir*double(isect.dist);
+			CollisionContact *c = &contacts[r];
+			c->pos = rays[r].start + rays[r].dir*double(isect.dist);
 			c->normal = vector3d(0.0);
-			c->depth = len - isect.dist;
+			c->depth = rays[r].len - isect.dist;
 			c->triIdx = -1;
 			c->userData1 = sphere.userData;
 			c->userData2 = 0;
@@ -381,7 +768,7 @@ void CollisionSpace::CollideGeoms(Geom *a, int minMailboxValue, void (*callback)
 	ourAabb.max = pos + vector3d(radius, radius, radius);
 
 	if (m_staticObjectTree) m_staticObjectTree->CollideGeom(a, ourAabb, 0, callback);
-	if (m_dynamicObjectTree) m_dynamicObjectTree->CollideGeom(a, ourAabb, minMailboxValue, callback);
+	m_dynamicObjectTree->CollideGeom(a, ourAabb, minMailboxValue, callback);
 
 	/* test the fucker against the planet sphere thing */
 	if (sphere.radius > 0.0) {
@@ -396,10 +783,12 @@ void CollisionSpace::RebuildObjectTrees()
 		if (m_staticObjectTree) delete m_staticObjectTree;
 		m_staticObjectTree = new BvhTree(m_staticGeoms);
 	}
-	if (m_dynamicObjectTree) delete m_dynamicObjectTree;
-	m_dynamicObjectTree = new BvhTree(m_geoms);
-
 	m_needStaticGeomRebuild = false;
+
+	// the geoms have moved since last time, but only the ones that have left
+	// their fat aabbs need their place in the tree changing
+	for (std::list<Geom*>::iterator i = m_geoms.begin(); i != m_geoms.end(); ++i)
+		m_dynamicObjectTree->Update(*i);
 }
 
 void CollisionSpace::Collide(void (*callback)(CollisionContact*))
@@ -18,12 +18,21 @@ struct Sphere {
 };
 
 class BvhTree;
+class DynamicBvhTree;
 
 /*
  * Collision spaces have a bunch of geoms and at most one sphere (for a planet).
  */
 class CollisionSpace {
 public:
+	// a query for TraceRays. dir should be unit length
+	struct Ray {
+		vector3d start;
+		vector3d dir;
+		double len;
+		Geom *ignore;
+	};
+
 	CollisionSpace();
 	~CollisionSpace();
 	void AddGeom(Geom*);
@@ -31,10 +40,15 @@ public:
 	void AddStaticGeom(Geom*);
 	void RemoveStaticGeom(Geom*);
 	void TraceRay(const vector3d &start, const vector3d &dir, double len, CollisionContact *c, Geom *ignore = 0);
+	// the same as calling TraceRay for each ray, but the object tree is walked
+	// once for the whole batch, geoms a ray can't reach are skipped, and rays
+	// that share a start point go through each geom's tree together
+	void TraceRays(int numRays, const Ray *rays, CollisionContact *contacts);
 	void Collide(void (*callback)(CollisionContact*));
 	void SetSphere(const vector3d &pos, double radius, void *user_data) {
 		sphere.pos = pos; sphere.radius = radius; sphere.userData = user_data;
 	}
+	bool HasGeoms() const { return !m_geoms.empty(); }
 	void FlagRebuildObjectTrees() { m_needStaticGeomRebuild = true; }
 	void RebuildObjectTrees();
 
@@ -46,11 +60,12 @@ public:
 private:
 	void CollideGeoms(Geom *a, int minMailboxValue, void (*callback)(CollisionContact*));
 	void CollideRaySphere(const vector3d &start, const vector3d &dir, isect_t *isect);
+	void TraceRaysAgainstGeom(Geom *g, const Ray *rays, const int *rayIdxs, int numRays, CollisionContact *contacts);
 	std::list<Geom*> m_geoms;
 	std::list<Geom*> m_staticGeoms;
 	bool m_needStaticGeomRebuild;
 	BvhTree *m_staticObjectTree;
-	BvhTree *m_dynamicObjectTree;
+	DynamicBvhTree *m_dynamicObjectTree;
 	Sphere sphere;
 
 	static int s_nextHandle;
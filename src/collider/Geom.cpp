@@ -18,6 +18,7 @@ Geom::Geom(const GeomTree *geomtree)
 	m_data = 0;
 	m_mailboxIndex = 0;
 	m_group = 0;
+	m_proxyIndex = -1;
 }
 
 matrix4x4d Geom::GetRotation() const
@@ -93,7 +94,7 @@ void Geom::Collide(Geom *b, void (*callback)(CollisionContact*))
 //	printf("%d 'rays' in %dms (%f rps)\n", numEdges, t, 1000.0*numEdges / (double)t);
 }
 
-static bool rotatedAabbIsectsNormalOne(Aabb &a, const matrix4x4d &transA, Aabb &b)
+static bool rotatedAabbIsectsNormalOne(const Aabb &a, const matrix4x4d &transA, const Aabb &b)
 {
 	Aabb arot;
 	vector3d p[8];
@@ -117,8 +118,8 @@ static bool rotatedAabbIsectsNormalOne(Aabb &a, const matrix4x4d &transA, Aabb &
 void Geom::CollideEdgesWithTrisOf(int &maxContacts, Geom *b, const matrix4x4d &transTo, void (*callback)(CollisionContact*))
 {
 	struct stackobj {
-		BVHNode *edgeNode;
-		BVHNode *triNode;
+		const BVHNode *edgeNode;
+		const BVHNode *triNode;
 	} stack[32];
 	int stackpos = 0;
 
@@ -126,43 +127,44 @@ void Geom::CollideEdgesWithTrisOf(int &maxContacts, Geom *b, const matrix4x4d &t
 	stack[0].triNode = b->GetGeomTree()->m_triTree->GetRoot();
 
 	while ((stackpos >= 0) && (maxContacts > 0)) {
-		BVHNode *edgeNode = stack[stackpos].edgeNode;
-		BVHNode *triNode = stack[stackpos].triNode;
+		const BVHNode *edgeNode = stack[stackpos].edgeNode;
+		const BVHNode *triNode = stack[stackpos].triNode;
 		stackpos--;
 
 		// does the edgeNode (with its aabb described in 6 planes transformed and rotated to
 		// b's coordinates) intersect with one or other of b's child nodes?
-		if (triNode->triIndicesStart || edgeNode->triIndicesStart) {
+		if (triNode->IsLeaf() || edgeNode->IsLeaf()) {
 			// reached triangle leaf node or edge leaf node.
 			// Intersect all edges under edgeNode with this leaf
 			CollideEdgesTris(maxContacts, edgeNode, transTo, b, triNode, callback);
 		} else {
-			BVHNode *left = triNode->kids[0];
-			BVHNode *right = triNode->kids[1];
-			bool edgeNodeIsectsLeftChild = rotatedAabbIsectsNormalOne(edgeNode->aabb, transTo, left->aabb);
-			bool edgeNodeIsectsRightChild = rotatedAabbIsectsNormalOne(edgeNode->aabb, transTo, right->aabb);
+			const BVHNode *left = triNode->GetLeft();
+			const BVHNode *right = triNode->GetRight();
+			const Aabb edgeAabb = edgeNode->GetAabb();
+			bool edgeNodeIsectsLeftChild = rotatedAabbIsectsNormalOne(edgeAabb, transTo, left->GetAabb());
+			bool edgeNodeIsectsRightChild = rotatedAabbIsectsNormalOne(edgeAabb, transTo, right->GetAabb());
 			//edgeNodeIsectsRightChild = edgeNodeIsectsLeftChild = true;
 			if (edgeNodeIsectsRightChild) {
 				if (edgeNodeIsectsLeftChild) {
 					// isects both. split edgeNode and try again
 					++stackpos;
-					stack[stackpos].edgeNode = edgeNode->kids[0];
+					stack[stackpos].edgeNode = edgeNode->GetLeft();
 					stack[stackpos].triNode = triNode;
 					++stackpos;
-					stack[stackpos].edgeNode = edgeNode->kids[1];
+					stack[stackpos].edgeNode = edgeNode->GetRight();
 					stack[stackpos].triNode = triNode;
 				} else {
 					// hits only right child. go down into that
 					// side with same edge node
 					++stackpos;
 					stack[stackpos].edgeNode = edgeNode;
-					stack[stackpos].triNode = triNode->kids[1];
+					stack[stackpos].triNode = triNode->GetRight();
 				}
 			} else if (edgeNodeIsectsLeftChild) {
 				// hits only left child
 				++stackpos;
 				stack[stackpos].edgeNode = edgeNode;
-				stack[stackpos].triNode = triNode->kids[0];
+				stack[stackpos].triNode = triNode->GetLeft();
 			} else {
 				// hits none
 			}
@@ -178,30 +180,31 @@ void Geom::CollideEdgesTris(int &maxContacts, const BVHNode *edgeNode, const mat
 		Geom *b, const BVHNode *btriNode, void (*callback)(CollisionContact*))
 {
 	if (maxContacts <= 0) return;
-	if (edgeNode->triIndicesStart) {
+	if (edgeNode->IsLeaf()) {
 		const GeomTree::Edge *edges = this->GetGeomTree()->GetEdges();
+		const int *edgeIdxs = this->GetGeomTree()->m_edgeTree->GetLeafObjs(edgeNode);
 		int numContacts = 0;
 		vector3f dir;
 		isect_t isect;
-		for (int i=0; i<edgeNode->numTris; i++) {
-			int vtxNum = edges[ edgeNode->triIndicesStart[i] ].v1i;
+		for (Uint32 i=0; i<edgeNode->numTris; i++) {
+			int vtxNum = edges[ edgeIdxs[i] ].v1i;
 			vector3d v1 = transToB * vector3d(&GetGeomTree()->m_vertices[vtxNum]);
 			vector3f _from(float(v1.x), float(v1.y), float(v1.z));
 
 			vector3d _dir(
-					double(edges[ edgeNode->triIndicesStart[i] ].dir.x),
-					double(edges[ edgeNode->triIndicesStart[i] ].dir.y),
-					double(edges[ edgeNode->triIndicesStart[i] ].dir.z));
+					double(edges[ edgeIdxs[i] ].dir.x),
+					double(edges[ edgeIdxs[i] ].dir.y),
+					double(edges[ edgeIdxs[i] ].dir.z));
 			_dir = transToB.ApplyRotationOnly(_dir);
 			dir = vector3f(&_dir.x);
-			isect.dist = edges[ edgeNode->triIndicesStart[i] ].len;
+			isect.dist = edges[ edgeIdxs[i] ].len;
 			isect.triIdx = -1;
 
 			b->GetGeomTree()->TraceRay(btriNode, _from, dir, &isect);
 
 			if (isect.triIdx == -1) continue;
 			numContacts++;
-			const double depth = edges[ edgeNode->triIndicesStart[i] ].len - isect.dist;
+			const double depth = edges[ edgeIdxs[i] ].len - isect.dist;
 			// in world coords
 			CollisionContact contact;
 			contact.pos = b->GetTransform() * (v1 + vector3d(&dir.x)*double(isect.dist));
@@ -216,13 +219,13 @@ void Geom::CollideEdgesTris(int &maxContacts, const BVHNode *edgeNode, const mat
 			contact.userData2 = b->m_data;
 			// contact geomFlag is bitwise OR of triangle's and edge's flags
 			contact.geomFlag = b->m_geomtree->GetTriFlag(isect.triIdx) |
-				edges[ edgeNode->triIndicesStart[i] ].triFlag;
+				edges[ edgeIdxs[i] ].triFlag;
 			callback(&contact);
 			if (--maxContacts <= 0) return;
 		}
 	} else {
-		CollideEdgesTris(maxContacts, edgeNode->kids[0], transToB, b, btriNode, callback);
-		CollideEdgesTris(maxContacts, edgeNode->kids[1], transToB, b, btriNode, callback);
+		CollideEdgesTris(maxContacts, edgeNode->GetLeft(), transToB, b, btriNode, callback);
+		CollideEdgesTris(maxContacts, edgeNode->GetRight(), transToB, b, btriNode, callback);
 	}
 }
 
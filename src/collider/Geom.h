@@ -34,6 +34,9 @@ public:
 	int GetMailboxIndex() const { return m_mailboxIndex; }
 	void SetGroup(int g) { m_group = g; }
 	int GetGroup() const { return m_group; }
+	// leaf in the collision space's dynamic tree, or -1 when not in one
+	void SetProxyIndex(int idx) { m_proxyIndex = idx; }
+	int GetProxyIndex() const { return m_proxyIndex; }
 private:
 	void CollideEdgesWithTrisOf(int &maxContacts, Geom *b, const matrix4x4d &transTo, void (*callback)(CollisionContact*));
 	void CollideEdgesTris(int &maxContacts, const BVHNode *edgeNode, const matrix4x4d &transToB,
@@ -46,6 +49,7 @@ private:
 	const GeomTree *m_geomtree;
 	void *m_data;
 	int m_group;
+	int m_proxyIndex;
 };
 
 #endif /* _GEOM_H */
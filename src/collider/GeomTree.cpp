@@ -4,10 +4,50 @@
 #include "../libs.h"
 #include "GeomTree.h"
 #include "BVHTree.h"
+#include <SDL.h>
+#include <algorithm>
 #include <map>
 
 int GeomTree::stats_rayTriIntersections;
 
+// below this many triangles starting a thread costs more than it saves
+static const int PARALLEL_BUILD_MIN_TRIS = 5000;
+
+namespace {
+	// orders positions for finding duplicates. equal positions compare
+	// equivalent, the same as vector3::ExactlyEqual
+	struct VertexLess {
+		const float *vertices;
+		VertexLess(const float *v) : vertices(v) {}
+		bool operator()(int a, int b) const {
+			const float *va = &vertices[3*a], *vb = &vertices[3*b];
+			if (va[0] < vb[0]) return true;
+			if (vb[0] < va[0]) return false;
+			if (va[1] < vb[1]) return true;
+			if (vb[1] < va[1]) return false;
+			if (va[2] < vb[2]) return true;
+			if (vb[2] < va[2]) return false;
+			return a < b;
+		}
+	};
+
+	// the triangle tree is built on a thread of its own while the edges
+	// are worked out and their tree built
+	struct TriTreeBuild {
+		int numTris;
+		const int *tris;
+		const Aabb *aabbs;
+		BVHTree::BuildMode mode;
+		BVHTree *tree;
+
+		static int Run(void *data) {
+			TriTreeBuild *b = static_cast<TriTreeBuild*>(data);
+			b->tree = new BVHTree(b->numTris, b->tris, b->aabbs, b->mode);
+			return 0;
+		}
+	};
+}
+
 
 GeomTree::~GeomTree()
 {
@@ -16,9 +56,7 @@ GeomTree::~GeomTree()
 	delete m_edgeTree;
 }
 
-#include <SDL.h>
-
-GeomTree::GeomTree(int numVerts, int numTris, float *vertices, int *indices, unsigned int *triflags): m_numVertices(numVerts)
+GeomTree::GeomTree(int numVerts, int numTris, float *vertices, int *indices, unsigned int *triflags, BVHTree::BuildMode mode): m_numVertices(numVerts), m_numTris(numTris)
 {
 	m_vertices = vertices;
 	m_indices = indices;
@@ -39,16 +77,26 @@ GeomTree::GeomTree(int numVerts, int numTris, float *vertices, int *indices, uns
 	if ((_i1) < (_i2)) edges[std::pair<int,int>(_i1,_i2)] = _triflag; \
 	else if ((_i1) > (_i2)) edges[std::pair<int,int>(_i2,_i1)] = _triflag;
 
-	// eliminate duplicate vertices
-	for (int i=0; i<numVerts; i++) {
-		vector3d v = vector3d(&m_vertices[3*i]);
-		for (int j=i+1; j<numVerts; j++) {
-			vector3d v2 = vector3d(&m_vertices[3*j]);
-			if (v2.ExactlyEqual(v)) {
-				for (int k=0; k<numTris*3; k++) {
-					if ((indices[k] == j) && (triflags[k/3] < 0x8000)) indices[k] = i;
-				}
-			}
+	// eliminate duplicate vertices: every copy of a position is replaced
+	// by its first occurrence. sorted, so copies are next to each other
+	{
+		std::vector<int> sorted(numVerts);
+		for (int i=0; i<numVerts; i++) sorted[i] = i;
+		std::sort(sorted.begin(), sorted.end(), VertexLess(m_vertices));
+
+		std::vector<int> first(numVerts);
+		for (int i=0; i<numVerts; ) {
+			int j = i + 1;
+			const float *v = &m_vertices[3*sorted[i]];
+			while (j < numVerts && vector3d(&m_vertices[3*sorted[j]]).ExactlyEqual(vector3d(v)))
+				j++;
+			// the lowest index of the run comes first
+			for (int k=i; k<j; k++) first[sorted[k]] = sorted[i];
+			i = j;
+		}
+
+		for (int k=0; k<numTris*3; k++) {
+			if (triflags[k/3] < 0x8000) indices[k] = first[indices[k]];
 		}
 	}
 
@@ -91,9 +139,12 @@ GeomTree::GeomTree(int numVerts, int numTris, float *vertices, int *indices, uns
 	}
 
 	//int t = SDL_GetTicks();
-	m_triTree = new BVHTree(activeTris.size(), &activeTris[0], aabbs);
-	delete [] aabbs;
-	//printf("Tri tree of %d tris build in %dms\n", activeTris.size(), SDL_GetTicks() - t);
+	TriTreeBuild triBuild = { int(activeTris.size()), activeTris.empty() ? 0 : &activeTris[0], aabbs, mode, 0 };
+	SDL_Thread *triThread = 0;
+	if (triBuild.numTris >= PARALLEL_BUILD_MIN_TRIS)
+		triThread = SDL_CreateThread(&TriTreeBuild::Run, &triBuild);
+	if (!triThread)
+		TriTreeBuild::Run(&triBuild);
 
 	m_numEdges = edges.size();
 	m_edges = new Edge[m_numEdges];
@@ -124,27 +175,98 @@ GeomTree::GeomTree(int numVerts, int numTris, float *vertices, int *indices, uns
 		aabbs[pos].Update(v2);
 	}
 	//t = SDL_GetTicks();
-	m_edgeTree = new BVHTree(m_numEdges, edgeIdxs, aabbs);
+	m_edgeTree = new BVHTree(m_numEdges, edgeIdxs, aabbs, mode);
 	delete [] aabbs;
 	delete [] edgeIdxs;
 	//printf("Edge tree of %d edges build in %dms\n", m_numEdges, SDL_GetTicks() - t);
+
+	if (triThread)
+		SDL_WaitThread(triThread, 0);
+	m_triTree = triBuild.tree;
+	delete [] triBuild.aabbs;
+	//printf("Tri tree of %d tris build in %dms\n", triBuild.numTris, SDL_GetTicks() - t);
+}
+
+GeomTree::GeomTree(int numVerts, int numTris) :
+	m_numVertices(numVerts), m_numTris(numTris), m_vertices(0),
+	m_triTree(0), m_edgeTree(0), m_radius(0.0), m_numEdges(0), m_edges(0),
+	m_indices(0), m_triFlags(0)
+{
+}
+
+void GeomTree::Save(FILE *f) const
+{
+	fwrite(&m_aabb, sizeof(m_aabb), 1, f);
+	fwrite(&m_radius, sizeof(m_radius), 1, f);
+	fwrite(m_indices, sizeof(int), 3*m_numTris, f);
+	fwrite(&m_numEdges, sizeof(m_numEdges), 1, f);
+	fwrite(m_edges, sizeof(Edge), m_numEdges, f);
+	m_triTree->Save(f);
+	m_edgeTree->Save(f);
+}
+
+GeomTree *GeomTree::Load(FILE *f, int numVerts, int numTris, float *vertices, int *indices, unsigned int *triflags)
+{
+	GeomTree *t = new GeomTree(numVerts, numTris);
+	t->m_vertices = vertices;
+	t->m_indices = indices;
+	t->m_triFlags = triflags;
+
+	std::vector<int> newIndices(3*numTris);
+	bool ok = numTris > 0 &&
+		fread(&t->m_aabb, sizeof(t->m_aabb), 1, f) == 1 &&
+		fread(&t->m_radius, sizeof(t->m_radius), 1, f) == 1 &&
+		fread(&newIndices[0], sizeof(int), newIndices.size(), f) == newIndices.size() &&
+		fread(&t->m_numEdges, sizeof(t->m_numEdges), 1, f) == 1;
+	for (size_t i = 0; ok && i < newIndices.size(); i++)
+		ok = newIndices[i] >= 0 && newIndices[i] < numVerts;
+
+	if (ok && t->m_numEdges > 0 && t->m_numEdges <= 3*numTris) {
+		t->m_edges = new Edge[t->m_numEdges];
+		ok = fread(t->m_edges, sizeof(Edge), t->m_numEdges, f) == size_t(t->m_numEdges);
+		for (int i = 0; ok && i < t->m_numEdges; i++) {
+			const Edge &e = t->m_edges[i];
+			ok = e.v1i >= 0 && e.v1i < 3*numVerts && e.v2i >= 0 && e.v2i < 3*numVerts;
+		}
+	} else
+		ok = false;
+
+	// the trees' object lists are triangle offsets and edge numbers
+	if (ok) ok = (t->m_triTree = BVHTree::Load(f)) != 0;
+	if (ok) ok = (t->m_edgeTree = BVHTree::Load(f)) != 0;
+	if (ok) {
+		const BVHTree::objPtr_t *objs = t->m_triTree->GetObjs();
+		for (int i = 0; ok && i < t->m_triTree->GetNumObjs(); i++)
+			ok = objs[i] >= 0 && objs[i] < 3*numTris;
+		objs = t->m_edgeTree->GetObjs();
+		for (int i = 0; ok && i < t->m_edgeTree->GetNumObjs(); i++)
+			ok = objs[i] >= 0 && objs[i] < t->m_numEdges;
+	}
+
+	if (!ok) {
+		delete t;
+		return 0;
+	}
+
+	std::copy(newIndices.begin(), newIndices.end(), indices);
+	return t;
 }
 
 static bool SlabsRayAabbTest(const BVHNode *n, const vector3f &start, const vector3f &invDir, isect_t *isect)
 {
 	float
-	l1      = (n->aabb.min.x - start.x) * invDir.x,
-	l2      = (n->aabb.max.x - start.x) * invDir.x,
+	l1      = (n->min.x - start.x) * invDir.x,
+	l2      = (n->max.x - start.x) * invDir.x,
 	lmin    = std::min(l1,l2),
 	lmax    = std::max(l1,l2);
 
-	l1      = (n->aabb.min.y - start.y) * invDir.y;
-	l2      = (n->aabb.max.y - start.y) * invDir.y;
+	l1      = (n->min.y - start.y) * invDir.y;
+	l2      = (n->max.y - start.y) * invDir.y;
 	lmin    = std::max(std::min(l1,l2), lmin);
 	lmax    = std::min(std::max(l1,l2), lmax);
 
-	l1      = (n->aabb.min.z - start.z) * invDir.z;
-	l2      = (n->aabb.max.z - start.z) * invDir.z;
+	l1      = (n->min.z - start.z) * invDir.z;
+	l2      = (n->max.z - start.z) * invDir.z;
 	lmin    = std::max(std::min(l1,l2), lmin);
 	lmax    = std::min(std::max(l1,l2), lmax);
 
@@ -158,7 +280,7 @@ void GeomTree::TraceRay(const vector3f &start, const vector3f &dir, isect_t *ise
 
 void GeomTree::TraceRay(const BVHNode *currnode, const vector3f &a_origin, const vector3f &a_dir, isect_t *isect) const
 {
-	BVHNode *stack[32];
+	const BVHNode *stack[32];
 	int stackpos = -1;
 	vector3f invDir(1.0f/a_dir.x, 1.0f/a_dir.y, 1.0f/a_dir.z);
 
@@ -167,12 +289,15 @@ void GeomTree::TraceRay(const BVHNode *currnode, const vector3f &a_origin, const
 			if (!SlabsRayAabbTest(currnode, a_origin, invDir, isect)) goto pop_bstack;
 
 			stackpos++;
-			stack[stackpos] = currnode->kids[1];
-			currnode = currnode->kids[0];
+			stack[stackpos] = currnode->GetRight();
+			currnode = currnode->GetLeft();
 		}
 		// triangle intersection jizz
-		for (int i=0; i<currnode->numTris; i++) {
-			RayTriIntersect(1, a_origin, &a_dir, currnode->triIndicesStart[i], isect);
+		{
+			const int *tris = m_triTree->GetLeafObjs(currnode);
+			for (Uint32 i=0; i<currnode->numTris; i++) {
+				RayTriIntersect(1, a_origin, &a_dir, tris[i], isect);
+			}
 		}
 pop_bstack:
 		if (stackpos < 0) break;
@@ -182,7 +307,7 @@ pop_bstack:
 }
 
 struct bvhstack {
-	BVHNode *node;
+	const BVHNode *node;
 	int activeRay;
 };
 
@@ -212,13 +337,16 @@ void GeomTree::TraceCoherentRays(const BVHNode *currnode, int numRays, const vec
 			if (activeRay < 0) goto pop_bstack;
 
 			stackpos++;
-			stack[stackpos].node = currnode->kids[1];
+			stack[stackpos].node = currnode->GetRight();
 			stack[stackpos].activeRay = activeRay;
-			currnode = currnode->kids[0];
+			currnode = currnode->GetLeft();
 		}
 		// triangle intersection jizz
-		for (int i=0; i<currnode->numTris; i++) {
-			RayTriIntersect(activeRay+1, a_origin, a_dirs, currnode->triIndicesStart[i], isects);
+		{
+			const int *tris = m_triTree->GetLeafObjs(currnode);
+			for (Uint32 i=0; i<currnode->numTris; i++) {
+				RayTriIntersect(activeRay+1, a_origin, a_dirs, tris[i], isects);
+			}
 		}
 pop_bstack:
 		if (stackpos < 0) break;
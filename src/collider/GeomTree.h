@@ -8,6 +8,7 @@
 #include "../Aabb.h"
 #include "../matrix4x4.h"
 #include "CollisionContact.h"
+#include "BVHTree.h"
 
 struct tri_t;
 
@@ -17,13 +18,20 @@ struct isect_t {
 	float dist;
 };
 
-class BVHTree;
-struct BVHNode;
-
 class GeomTree {
 public:
-	GeomTree(int numVerts, int numTris, float *vertices, int *indices, unsigned int *triflags);
+	// mode is used for both the triangle and edge trees
+	GeomTree(int numVerts, int numTris, float *vertices, int *indices, unsigned int *triflags, BVHTree::BuildMode mode = BVHTree::BUILD_QUALITY);
 	~GeomTree();
+
+	// everything the constructor works out, in native byte order, so that a
+	// cache can skip building the trees again. that includes the index list,
+	// since duplicate vertices are merged in place. Load replaces indices
+	// with the saved ones, or returns 0 and leaves them alone if the data
+	// doesn't match the mesh
+	void Save(FILE *f) const;
+	static GeomTree *Load(FILE *f, int numVerts, int numTris, float *vertices, int *indices, unsigned int *triflags);
+
 	const Aabb &GetAabb() const { return m_aabb; }
 	// dir should be unit length,
 	// isect.dist should be ray length
@@ -48,12 +56,14 @@ public:
 	int GetNumEdges() const { return m_numEdges; }
 
 	const int m_numVertices;
+	const int m_numTris;
 	const float *m_vertices;
 	static int stats_rayTriIntersections;
 
 	BVHTree *m_triTree;
 	BVHTree *m_edgeTree;
 private:
+	GeomTree(int numVerts, int numTris);
 	void RayTriIntersect(int numRays, const vector3f &origin, const vector3f *dirs, int triIdx, isect_t *isects) const;
 
 	double m_radius;
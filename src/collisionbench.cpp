@@ -0,0 +1,349 @@
+// Copyright © 2008-2013 Pioneer Developers. See AUTHORS.txt for details
+// Licensed under the terms of the GPL v3. See licenses/GPL-3.txt
+
+// times the collider on real ship and station collision meshes, so changes
+// to it can be compared. each operation is run for a while and reported in
+// nanoseconds per call, and optionally written out as json
+//
+// collisionbench [-json file] [-geoms n] [ship model] [station model]
+
+#include "libs.h"
+#include "FileSystem.h"
+#include "GameConfig.h"
+#include "NavLights.h"
+#include "OS.h"
+#include "CollMesh.h"
+#include "collider/collider.h"
+#include "graphics/Graphics.h"
+#include "graphics/Renderer.h"
+#include "scenegraph/SceneGraph.h"
+
+// each operation runs for at least this long
+static const double MIN_SECONDS = 0.5;
+
+static const int NUM_RAYS = 16384;
+// rays from one origin that go through TraceCoherentRays together
+static const int COHERENT_BATCH = 16;
+static const int NUM_PLACEMENTS = 1024;
+
+struct Result {
+	std::string name;
+	Uint64 count;
+	double ns;
+};
+
+static std::vector<Result> s_results;
+
+static double seconds_since(Uint64 start)
+{
+	return double(OS::HFTimer() - start) / double(OS::HFTimerFreq());
+}
+
+// op() does some work and returns how many operations that was
+template <typename T>
+static void run(const char *name, T &op)
+{
+	Uint64 count = 0;
+	const Uint64 start = OS::HFTimer();
+	double elapsed;
+	do {
+		count += op();
+		elapsed = seconds_since(start);
+	} while (elapsed < MIN_SECONDS);
+
+	Result r;
+	r.name = name;
+	r.count = count;
+	r.ns = elapsed * 1e9 / double(count);
+	s_results.push_back(r);
+
+	printf("%-32s %12.1f ns %12llu calls\n", name, r.ns, static_cast<unsigned long long>(count));
+}
+
+static int s_numContacts;
+static void count_contact(CollisionContact *c)
+{
+	s_numContacts++;
+}
+
+// GeomTree merges vertices by rewriting the indices, so every build gets a
+// fresh copy of the mesh
+struct BuildOp {
+	BuildOp(const CollMesh *mesh, BVHTree::BuildMode mode) : m_mesh(mesh), m_mode(mode) {}
+	int operator()() {
+		std::vector<vector3f> vertices(m_mesh->m_vertices);
+		std::vector<int> indices(m_mesh->m_indices);
+		std::vector<unsigned int> flags(m_mesh->m_flags);
+		GeomTree *t = new GeomTree(vertices.size(), indices.size()/3,
+			reinterpret_cast<float*>(&vertices[0]), &indices[0], &flags[0], m_mode);
+		delete t;
+		return 1;
+	}
+	const CollMesh *m_mesh;
+	BVHTree::BuildMode m_mode;
+};
+
+// rays start on a sphere around the mesh and head for points inside its box
+struct Rays {
+	Rays(const GeomTree *tree, Random &rng) : origins(NUM_RAYS), dirs(NUM_RAYS) {
+		const Aabb &aabb = tree->GetAabb();
+		const float len = float(2.0 * tree->GetRadius());
+		for (int i = 0; i < NUM_RAYS; i++) {
+			// one origin per coherent batch
+			if (i % COHERENT_BATCH == 0) {
+				const vector3d d = vector3d(rng.Double(-1.0, 1.0), rng.Double(-1.0, 1.0), rng.Double(-1.0, 1.0)).NormalizedSafe();
+				origins[i] = vector3f(d * (0.5 * double(len)));
+			} else
+				origins[i] = origins[i-1];
+			const vector3d target(rng.Double(aabb.min.x, aabb.max.x), rng.Double(aabb.min.y, aabb.max.y), rng.Double(aabb.min.z, aabb.max.z));
+			dirs[i] = (vector3f(target) - origins[i]).NormalizedSafe();
+		}
+		rayLen = len;
+	}
+	std::vector<vector3f> origins;
+	std::vector<vector3f> dirs;
+	float rayLen;
+};
+
+struct TraceRayOp {
+	TraceRayOp(const GeomTree *tree, const Rays &rays) : m_tree(tree), m_rays(rays) {}
+	int operator()() {
+		for (int i = 0; i < NUM_RAYS; i++) {
+			isect_t isect;
+			isect.triIdx = -1;
+			isect.dist = m_rays.rayLen;
+			m_tree->TraceRay(m_rays.origins[i], m_rays.dirs[i], &isect);
+		}
+		return NUM_RAYS;
+	}
+	const GeomTree *m_tree;
+	const Rays &m_rays;
+};
+
+struct TraceCoherentRaysOp {
+	TraceCoherentRaysOp(const GeomTree *tree, const Rays &rays) : m_tree(tree), m_rays(rays) {}
+	int operator()() {
+		isect_t isects[COHERENT_BATCH];
+		for (int i = 0; i < NUM_RAYS; i += COHERENT_BATCH) {
+			for (int j = 0; j < COHERENT_BATCH; j++) {
+				isects[j].triIdx = -1;
+				isects[j].dist = m_rays.rayLen;
+			}
+			m_tree->TraceCoherentRays(COHERENT_BATCH, m_rays.origins[i], &m_rays.dirs[i], isects);
+		}
+		return NUM_RAYS;
+	}
+	const GeomTree *m_tree;
+	const Rays &m_rays;
+};
+
+static matrix4x4d random_rotation(Random &rng)
+{
+	return matrix4x4d::RotateMatrix(rng.Double(2.0*M_PI),
+		rng.Double(-1.0, 1.0), rng.Double(-1.0, 1.0), rng.Double(-1.0, 1.0) + 1e-3);
+}
+
+// the ship dropped at random places in the station's box, so that a good
+// share of them touch
+struct CollideEdgesOp {
+	CollideEdgesOp(const GeomTree *ship, const GeomTree *station, Random &rng) : m_ship(ship), m_station(station) {
+		const Aabb &aabb = station->GetAabb();
+		for (int i = 0; i < NUM_PLACEMENTS; i++) {
+			matrix4x4d m = random_rotation(rng);
+			m[12] = rng.Double(aabb.min.x, aabb.max.x);
+			m[13] = rng.Double(aabb.min.y, aabb.max.y);
+			m[14] = rng.Double(aabb.min.z, aabb.max.z);
+			m_transforms.push_back(m);
+		}
+	}
+	int operator()() {
+		for (int i = 0; i < NUM_PLACEMENTS; i++)
+			m_ship->CollideEdgesWithTrisOf(m_station, m_transforms[i], count_contact);
+		return NUM_PLACEMENTS;
+	}
+	const GeomTree *m_ship;
+	const GeomTree *m_station;
+	std::vector<matrix4x4d> m_transforms;
+};
+
+// ships drifting about a box around the station, bouncing off its walls.
+// each call moves them all and collides the space once
+struct CollisionSpaceOp {
+	CollisionSpaceOp(GeomTree *ship, GeomTree *station, int numGeoms, Random &rng) {
+		m_stationGeom = new Geom(station);
+		m_stationGeom->MoveTo(matrix4x4d::Identity());
+		m_space.AddStaticGeom(m_stationGeom);
+
+		// sized so the ships are about as crowded as around a busy station
+		m_halfSize = station->GetRadius() + ship->GetRadius() * 4.0 * pow(double(numGeoms), 1.0/3.0);
+		const double speed = ship->GetRadius() * 0.1;
+		for (int i = 0; i < numGeoms; i++) {
+			Geom *g = new Geom(ship);
+			m_space.AddGeom(g);
+			m_geoms.push_back(g);
+			m_rotations.push_back(random_rotation(rng));
+			m_positions.push_back(vector3d(rng.Double(-m_halfSize, m_halfSize), rng.Double(-m_halfSize, m_halfSize), rng.Double(-m_halfSize, m_halfSize)));
+			m_velocities.push_back(vector3d(rng.Double(-1.0, 1.0), rng.Double(-1.0, 1.0), rng.Double(-1.0, 1.0)) * speed);
+			g->MoveTo(m_rotations[i], m_positions[i]);
+		}
+		m_space.RebuildObjectTrees();
+	}
+	~CollisionSpaceOp() {
+		for (std::vector<Geom*>::iterator it = m_geoms.begin(); it != m_geoms.end(); ++it) {
+			m_space.RemoveGeom(*it);
+			delete *it;
+		}
+		m_space.RemoveStaticGeom(m_stationGeom);
+		delete m_stationGeom;
+	}
+	int operator()() {
+		for (unsigned int i = 0; i < m_geoms.size(); i++) {
+			vector3d &p = m_positions[i];
+			vector3d &v = m_velocities[i];
+			p += v;
+			if (fabs(p.x) > m_halfSize) v.x = -v.x;
+			if (fabs(p.y) > m_halfSize) v.y = -v.y;
+			if (fabs(p.z) > m_halfSize) v.z = -v.z;
+			m_geoms[i]->MoveTo(m_rotations[i], p);
+		}
+		m_space.Collide(count_contact);
+		return 1;
+	}
+	CollisionSpace m_space;
+	Geom *m_stationGeom;
+	std::vector<Geom*> m_geoms;
+	std::vector<matrix4x4d> m_rotations;
+	std::vector<vector3d> m_positions;
+	std::vector<vector3d> m_velocities;
+	double m_halfSize;
+};
+
+static bool write_json(const std::string &filename, const std::string &ship, const std::string &station, int numGeoms)
+{
+	FILE *f = fopen(filename.c_str(), "w");
+	if (!f) return false;
+
+	fprintf(f, "{\n\t\"ship\": \"%s\",\n\t\"station\": \"%s\",\n\t\"geoms\": %d,\n\t\"results\": [\n",
+		ship.c_str(), station.c_str(), numGeoms);
+	for (unsigned int i = 0; i < s_results.size(); i++) {
+		const Result &r = s_results[i];
+		fprintf(f, "\t\t{ \"name\": \"%s\", \"ns\": %.1f, \"count\": %llu }%s\n",
+			r.name.c_str(), r.ns, static_cast<unsigned long long>(r.count), i+1 < s_results.size() ? "," : "");
+	}
+	fprintf(f, "\t]\n}\n");
+	fclose(f);
+	return true;
+}
+
+int main(int argc, char **argv)
+{
+	std::string jsonFile;
+	int numGeoms = 100;
+	std::vector<std::string> models;
+
+	for (int i = 1; i < argc; i++) {
+		const std::string arg(argv[i]);
+		if (arg == "-json" && i+1 < argc)
+			jsonFile = argv[++i];
+		else if (arg == "-geoms" && i+1 < argc)
+			numGeoms = std::max(1, atoi(argv[++i]));
+		else if (arg[0] != '-')
+			models.push_back(arg);
+		else {
+			fprintf(stderr, "usage: collisionbench [-json file] [-geoms n] [ship model] [station model]\n");
+			return 1;
+		}
+	}
+	const std::string shipName = models.size() > 0 ? models[0] : "natrix";
+	const std::string stationName = models.size() > 1 ? models[1] : "hoop_spacestation";
+
+	ScopedPtr<GameConfig> config(new GameConfig);
+
+	// a window and GL context are needed to load the models, even though
+	// only their collision meshes are used
+	FileSystem::Init();
+	if (SDL_Init(SDL_INIT_VIDEO) < 0)
+		OS::Error("SDL initialization failed: %s\n", SDL_GetError());
+
+	Graphics::Settings videoSettings = {};
+	videoSettings.width = 640;
+	videoSettings.height = 480;
+	videoSettings.shaders = (config->Int("DisableShaders") == 0);
+	Graphics::Renderer *renderer = Graphics::Init(videoSettings);
+	SDL_WM_SetCaption("collisionbench", "collisionbench");
+
+	NavLights::Init(renderer);
+
+	ScopedPtr<SceneGraph::Model> ship, station;
+	{
+		SceneGraph::Loader loader(renderer);
+		try {
+			ship.Reset(loader.LoadModel(shipName));
+			station.Reset(loader.LoadModel(stationName));
+		} catch (SceneGraph::LoadingError &err) {
+			fprintf(stderr, "couldn't load models: %s\n", err.what());
+			return 1;
+		}
+	}
+
+	const RefCountedPtr<CollMesh> shipMesh = ship->GetCollisionMesh();
+	const RefCountedPtr<CollMesh> stationMesh = station->GetCollisionMesh();
+	GeomTree *shipTree = shipMesh->GetGeomTree();
+	GeomTree *stationTree = stationMesh->GetGeomTree();
+
+	printf("ship %s: %d tris, station %s: %d tris\n\n",
+		shipName.c_str(), shipTree->m_numTris, stationName.c_str(), stationTree->m_numTris);
+
+	// the same random scene every run
+	Random rng(0);
+
+	{
+		BuildOp op(stationMesh.Get(), BVHTree::BUILD_FAST);
+		run("geomtree_build_fast", op);
+	}
+	{
+		BuildOp op(stationMesh.Get(), BVHTree::BUILD_QUALITY);
+		run("geomtree_build_quality", op);
+	}
+
+	const Rays rays(stationTree, rng);
+	{
+		TraceRayOp op(stationTree, rays);
+		run("trace_ray", op);
+	}
+	{
+		TraceCoherentRaysOp op(stationTree, rays);
+		run("trace_coherent_rays", op);
+	}
+
+	s_numContacts = 0;
+	{
+		CollideEdgesOp op(shipTree, stationTree, rng);
+		run("collide_edges_with_tris", op);
+	}
+	printf("%32s %d contacts\n", "", s_numContacts);
+
+	s_numContacts = 0;
+	{
+		CollisionSpaceOp op(shipTree, stationTree, numGeoms, rng);
+		run("collision_space_collide", op);
+	}
+	printf("%32s %d contacts\n", "", s_numContacts);
+
+	if (!jsonFile.empty()) {
+		if (write_json(jsonFile, shipName, stationName, numGeoms))
+			printf("\nwrote '%s'\n", jsonFile.c_str());
+		else
+			fprintf(stderr, "couldn't write '%s'\n", jsonFile.c_str());
+	}
+
+	ship.Reset();
+	station.Reset();
+	delete renderer;
+	NavLights::Uninit();
+	Graphics::Uninit();
+	FileSystem::Uninit();
+	SDL_Quit();
+
+	return 0;
+}
@@ -11,6 +11,8 @@
 #include "Polit.h"
 #include "Factions.h"
 #include "FileSystem.h"
+#include "Serializer.h"
+#include "Hash.h"
 #include <map>
 
 typedef std::map<SystemPath, CustomSystem::SystemList> SectorMap;
@@ -489,8 +491,254 @@ static void RegisterCustomSystemsAPI(lua_State *L)
 	register_class(L, LuaCustomSystemBody_TypeName, LuaCustomSystemBody_meta);
 }
 
+// ------ CustomSystem cache ------
+
+// the systems as the scripts left them, sector by sector. the file starts
+// with the hash of every script under data/systems, so changing, adding or
+// removing one means the scripts are run again and the cache rewritten.
+// factions are kept by name and looked up again, and a faction that's gone
+// makes the whole cache unusable
+static const char CACHE_FILE_NAME[] = "customsystems.cache";
+static const char CACHE_MAGIC[] = "PCSC";
+
+// bump this if what's kept for a system or a body changes
+static const Uint32 CACHE_VERSION = 1;
+
+static bool s_cacheEnabled = false;
+
+void CustomSystem::SetCacheEnabled(bool enabled)
+{
+	s_cacheEnabled = enabled;
+}
+
+static Uint64 hash_scripts(const std::string &basepath, Uint64 hash)
+{
+	for (FileSystem::FileEnumerator files(FileSystem::gameDataFiles, basepath, FileSystem::FileEnumerator::IncludeDirs); !files.Finished(); files.Next())
+	{
+		const FileSystem::FileInfo &info = files.Current();
+		const std::string &fpath = info.GetPath();
+		if (info.IsDir())
+			hash = hash_scripts(fpath, hash);
+		else if (ends_with(fpath, ".lua")) {
+			RefCountedPtr<FileSystem::FileData> code = info.Read();
+			hash = Hash64(fpath.c_str(), fpath.size(), hash);
+			hash = Hash64(code->GetData(), code->GetSize(), hash);
+		}
+	}
+	return hash;
+}
+
+static void write_fixed(Serializer::Writer &wr, const fixed &f) { wr.Int64(f.v); }
+static fixed read_fixed(Serializer::Reader &rd) { fixed f; f.v = Sint64(rd.Int64()); return f; }
+
+static void write_body(Serializer::Writer &wr, const CustomSystemBody *b)
+{
+	wr.String(b->name);
+	wr.Int32(b->type);
+	write_fixed(wr, b->radius);
+	write_fixed(wr, b->aspectRatio);
+	write_fixed(wr, b->mass);
+	wr.Int32(b->averageTemp);
+	write_fixed(wr, b->semiMajorAxis);
+	write_fixed(wr, b->eccentricity);
+	write_fixed(wr, b->orbitalOffset);
+	write_fixed(wr, b->orbitalPhaseAtStart);
+	wr.Bool(b->want_rand_offset);
+	wr.Float(b->latitude);
+	wr.Float(b->longitude);
+	write_fixed(wr, b->rotationPeriod);
+	write_fixed(wr, b->rotationalPhaseAtStart);
+	write_fixed(wr, b->axialTilt);
+	wr.String(b->heightMapFilename);
+	wr.Int32(b->heightMapFractal);
+	write_fixed(wr, b->metallicity);
+	write_fixed(wr, b->volatileGas);
+	write_fixed(wr, b->volatileLiquid);
+	write_fixed(wr, b->volatileIces);
+	write_fixed(wr, b->volcanicity);
+	write_fixed(wr, b->atmosOxidizing);
+	write_fixed(wr, b->life);
+	wr.Int32(b->ringStatus);
+	write_fixed(wr, b->ringInnerRadius);
+	write_fixed(wr, b->ringOuterRadius);
+	wr.Byte(b->ringColor.r);
+	wr.Byte(b->ringColor.g);
+	wr.Byte(b->ringColor.b);
+	wr.Byte(b->ringColor.a);
+	wr.Int32(b->seed);
+	wr.Bool(b->want_rand_seed);
+
+	wr.Int32(b->children.size());
+	for (std::vector<CustomSystemBody*>::const_iterator it = b->children.begin(); it != b->children.end(); ++it)
+		write_body(wr, *it);
+}
+
+static CustomSystemBody *read_body(Serializer::Reader &rd)
+{
+	ScopedPtr<CustomSystemBody> b(new CustomSystemBody);
+	b->name = rd.String();
+	b->type = SystemBody::BodyType(rd.Int32());
+	b->radius = read_fixed(rd);
+	b->aspectRatio = read_fixed(rd);
+	b->mass = read_fixed(rd);
+	b->averageTemp = rd.Int32();
+	b->semiMajorAxis = read_fixed(rd);
+	b->eccentricity = read_fixed(rd);
+	b->orbitalOffset = read_fixed(rd);
+	b->orbitalPhaseAtStart = read_fixed(rd);
+	b->want_rand_offset = rd.Bool();
+	b->latitude = rd.Float();
+	b->longitude = rd.Float();
+	b->rotationPeriod = read_fixed(rd);
+	b->rotationalPhaseAtStart = read_fixed(rd);
+	b->axialTilt = read_fixed(rd);
+	b->heightMapFilename = rd.String();
+	b->heightMapFractal = rd.Int32();
+	b->metallicity = read_fixed(rd);
+	b->volatileGas = read_fixed(rd);
+	b->volatileLiquid = read_fixed(rd);
+	b->volatileIces = read_fixed(rd);
+	b->volcanicity = read_fixed(rd);
+	b->atmosOxidizing = read_fixed(rd);
+	b->life = read_fixed(rd);
+	b->ringStatus = CustomSystemBody::RingStatus(rd.Int32());
+	b->ringInnerRadius = read_fixed(rd);
+	b->ringOuterRadius = read_fixed(rd);
+	b->ringColor.r = rd.Byte();
+	b->ringColor.g = rd.Byte();
+	b->ringColor.b = rd.Byte();
+	b->ringColor.a = rd.Byte();
+	b->seed = rd.Int32();
+	b->want_rand_seed = rd.Bool();
+
+	const Uint32 numChildren = rd.Int32();
+	for (Uint32 i = 0; i < numChildren; i++)
+		b->children.push_back(read_body(rd));
+	return b.Release();
+}
+
+static void write_system(Serializer::Writer &wr, const CustomSystem *cs)
+{
+	wr.String(cs->name);
+	wr.Bool(cs->sBody != 0);
+	if (cs->sBody) write_body(wr, cs->sBody);
+	wr.Int32(cs->numStars);
+	for (int i = 0; i < 4; i++)
+		wr.Int32(cs->primaryType[i]);
+	wr.Float(cs->pos.x);
+	wr.Float(cs->pos.y);
+	wr.Float(cs->pos.z);
+	wr.Int32(cs->seed);
+	wr.Bool(cs->want_rand_explored);
+	wr.Bool(cs->explored);
+	wr.String(cs->faction ? cs->faction->name : std::string());
+	wr.Int32(cs->govType);
+	wr.String(cs->shortDesc);
+	wr.String(cs->longDesc);
+}
+
+// null if the system's faction doesn't exist any more
+static CustomSystem *read_system(Serializer::Reader &rd, int x, int y, int z)
+{
+	ScopedPtr<CustomSystem> cs(new CustomSystem);
+	cs->name = rd.String();
+	if (rd.Bool()) cs->sBody = read_body(rd);
+	cs->numStars = rd.Int32();
+	for (int i = 0; i < 4; i++)
+		cs->primaryType[i] = SystemBody::BodyType(rd.Int32());
+	cs->pos.x = rd.Float();
+	cs->pos.y = rd.Float();
+	cs->pos.z = rd.Float();
+	cs->seed = rd.Int32();
+	cs->want_rand_explored = rd.Bool();
+	cs->explored = rd.Bool();
+	const std::string factionName = rd.String();
+	if (!factionName.empty()) {
+		cs->faction = Faction::GetFaction(factionName);
+		if (!cs->faction->IsValid()) return 0;
+	}
+	cs->govType = Polit::GovType(rd.Int32());
+	cs->shortDesc = rd.String();
+	cs->longDesc = rd.String();
+	cs->sectorX = x;
+	cs->sectorY = y;
+	cs->sectorZ = z;
+	return cs.Release();
+}
+
+static void write_cache(Uint64 scriptsHash)
+{
+	Serializer::Writer wr;
+	for (size_t i = 0; i < 4; i++)
+		wr.Byte(CACHE_MAGIC[i]);
+	wr.Int32(CACHE_VERSION);
+	wr.Int64(scriptsHash);
+
+	wr.Int32(s_sectorMap.size());
+	for (SectorMap::const_iterator secIt = s_sectorMap.begin(); secIt != s_sectorMap.end(); ++secIt) {
+		wr.Int32(secIt->first.sectorX);
+		wr.Int32(secIt->first.sectorY);
+		wr.Int32(secIt->first.sectorZ);
+		wr.Int32(secIt->second.size());
+		for (CustomSystem::SystemList::const_iterator sysIt = secIt->second.begin(); sysIt != secIt->second.end(); ++sysIt)
+			write_system(wr, *sysIt);
+	}
+
+	// a short write leaves a file that fails to read, so the scripts are
+	// just run again next time
+	const std::string &data = wr.GetData();
+	FILE *f = FileSystem::userFiles.OpenWriteStream(CACHE_FILE_NAME);
+	if (!f) return;
+	fwrite(data.data(), data.size(), 1, f);
+	fclose(f);
+}
+
+// fills s_sectorMap from the cache if it was made from these scripts. it's
+// left empty if not
+static bool read_cache(Uint64 scriptsHash)
+{
+	RefCountedPtr<FileSystem::FileData> data = FileSystem::userFiles.ReadFile(CACHE_FILE_NAME);
+	if (!data || data->GetSize() < 4 || memcmp(data->GetData(), CACHE_MAGIC, 4) != 0)
+		return false;
+
+	try {
+		Serializer::Reader rd(data, 4);
+		if (rd.Int32() != CACHE_VERSION || rd.Int64() != scriptsHash)
+			return false;
+
+		const Uint32 numSectors = rd.Int32();
+		for (Uint32 i = 0; i < numSectors; i++) {
+			const int x = rd.Int32();
+			const int y = rd.Int32();
+			const int z = rd.Int32();
+			CustomSystem::SystemList &systems = s_sectorMap[SystemPath(x, y, z)];
+			const Uint32 numSystems = rd.Int32();
+			for (Uint32 j = 0; j < numSystems; j++) {
+				CustomSystem *cs = read_system(rd, x, y, z);
+				if (!cs) {
+					CustomSystem::Uninit();
+					return false;
+				}
+				systems.push_back(cs);
+			}
+		}
+		if (!rd.AtEnd()) {
+			CustomSystem::Uninit();
+			return false;
+		}
+	} catch (SavedGameCorruptException) {
+		CustomSystem::Uninit();
+		return false;
+	}
+	return true;
+}
+
 void CustomSystem::Init()
 {
+	const Uint64 scriptsHash = s_cacheEnabled ? hash_scripts("systems", 0) : 0;
+	if (s_cacheEnabled && read_cache(scriptsHash))
+		return;
+
 	lua_State *L = luaL_newstate();
 	LUA_DEBUG_START(L);
 
@@ -523,6 +771,9 @@ void CustomSystem::Init()
 
 	LUA_DEBUG_END(L, 0);
 	lua_close(L);
+
+	if (s_cacheEnabled)
+		write_cache(scriptsHash);
 }
 
 void CustomSystem::Uninit()
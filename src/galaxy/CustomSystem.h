@@ -65,6 +65,10 @@ public:
 class CustomSystem {
 public:
 	typedef std::vector<CustomSystem*> SystemList;
+	// keep the systems made by the data/systems scripts in the user dir, so
+	// the scripts only have to run again when one of them changes. off
+	// until this is called, and it has to be before Init
+	static void SetCacheEnabled(bool enabled);
 	static void Init();
 	static void Uninit();
 	// XXX this is not as const-safe as it should be
@@ -14,7 +14,10 @@ const float GALAXY_RADIUS = 50000.0;
 const float SOL_OFFSET_X = 25000.0;
 const float SOL_OFFSET_Y = 0.0;
 
-static SDL_Surface *s_galaxybmp;
+// the galaxy.bmp pixels, one byte each and with no row padding. it is never
+// written after Init, so sectors can be made from worker threads too
+static std::vector<Uint8> s_density;
+static int s_densityWidth, s_densityHeight;
 
 void Init()
 {
@@ -27,21 +30,28 @@ void Init()
 	}
 
 	SDL_RWops *datastream = SDL_RWFromConstMem(filedata->GetData(), filedata->GetSize());
-	s_galaxybmp = SDL_LoadBMP_RW(datastream, 1);
-	if (!s_galaxybmp) {
+	SDL_Surface *galaxybmp = SDL_LoadBMP_RW(datastream, 1);
+	if (!galaxybmp) {
 		fprintf(stderr, "Galaxy: couldn't load: %s (%s)\n", filename.c_str(), SDL_GetError());
 		Pi::Quit();
 	}
-}
 
-void Uninit()
-{
-	if(s_galaxybmp) SDL_FreeSurface(s_galaxybmp);
+	s_densityWidth = galaxybmp->w;
+	s_densityHeight = galaxybmp->h;
+	s_density.resize(s_densityWidth * s_densityHeight);
+
+	SDL_LockSurface(galaxybmp);
+	for (int y = 0; y < s_densityHeight; y++) {
+		const Uint8 *row = static_cast<const Uint8*>(galaxybmp->pixels) + y*galaxybmp->pitch;
+		std::copy(row, row + s_densityWidth, s_density.begin() + y*s_densityWidth);
+	}
+	SDL_UnlockSurface(galaxybmp);
+	SDL_FreeSurface(galaxybmp);
 }
 
-SDL_Surface *GetGalaxyBitmap()
+void Uninit()
 {
-	return s_galaxybmp;
+	std::vector<Uint8>().swap(s_density);
 }
 
 Uint8 GetSectorDensity(int sx, int sy, int sz)
@@ -53,17 +63,13 @@ Uint8 GetSectorDensity(int sx, int sy, int sz)
 	offset_x = Clamp((offset_x + 1.0)*0.5, 0.0, 1.0);
 	offset_y = Clamp((offset_y + 1.0)*0.5, 0.0, 1.0);
 
-	int x = int(floor(offset_x * (s_galaxybmp->w - 1)));
-	int y = int(floor(offset_y * (s_galaxybmp->h - 1)));
+	int x = int(floor(offset_x * (s_densityWidth - 1)));
+	int y = int(floor(offset_y * (s_densityHeight - 1)));
 
-	SDL_LockSurface(s_galaxybmp);
-	int val = static_cast<unsigned char*>(s_galaxybmp->pixels)[x + y*s_galaxybmp->pitch];
-	SDL_UnlockSurface(s_galaxybmp);
-	// crappy unrealistic but currently adequate density dropoff with sector z
-	val = val * (256 - std::min(abs(sz),256)) / 256;
-	// reduce density somewhat to match real (gliese) density
-	val /= 2;
-	return Uint8(val);
+	const int val = s_density[x + y*s_densityWidth];
+	// crappy unrealistic but currently adequate density dropoff with sector
+	// z, and reduced density somewhat to match real (gliese) density
+	return Uint8(val * (256 - std::min(abs(sz),256)) / 512);
 }
 
 } /* namespace Galaxy */
@@ -13,7 +13,6 @@ namespace Galaxy {
 
 	void Init();
 	void Uninit();
-	SDL_Surface *GetGalaxyBitmap();
 	/* 0 - 255 */
 	Uint8 GetSectorDensity(int sx, int sy, int sz);
 }
@@ -0,0 +1,137 @@
+// Copyright © 2008-2013 Pioneer Developers. See AUTHORS.txt for details
+// Licensed under the terms of the GPL v3. See licenses/GPL-3.txt
+
+#include "GalaxyIndex.h"
+#include <map>
+
+// sectors worth of positions kept. each is only a few dozen bytes, and when
+// it fills up the lot is dropped and rebuilt as it's needed again
+static const size_t MAX_INDEXED_SECTORS = 65536;
+
+// how far outside a sector's box a system can appear to be, just from
+// float rounding in the distance calculation
+static const double BOX_SLACK = 1e-3;
+
+typedef std::map<SystemPath, std::vector<vector3f> > PositionGrid;
+static PositionGrid s_positions;
+
+// the returned reference is good until the next call
+static const std::vector<vector3f> &get_sector_positions(int x, int y, int z)
+{
+	const SystemPath loc(x, y, z);
+
+	PositionGrid::iterator i = s_positions.find(loc);
+	if (i != s_positions.end())
+		return i->second;
+
+	if (s_positions.size() >= MAX_INDEXED_SECTORS)
+		s_positions.clear();
+
+	RefCountedPtr<Sector> sec = Sector::GetCached(x, y, z);
+	std::vector<vector3f> &positions = s_positions[loc];
+	positions.reserve(sec->m_systems.size());
+	for (std::vector<Sector::System>::const_iterator sys = sec->m_systems.begin(); sys != sec->m_systems.end(); ++sys)
+		positions.push_back(sys->p);
+	return positions;
+}
+
+// nearest distance along one axis from the centre system to a sector that
+// is offset sectors away from it. c is the centre's position in its sector
+static inline double axis_gap(const double c, const int offset)
+{
+	const double lo = c - Sector::SIZE * double(offset + 1);
+	const double hi = c - Sector::SIZE * double(offset);
+	if (lo > 0.0) return lo;
+	if (hi < 0.0) return -hi;
+	return 0.0;
+}
+
+void GalaxyIndex::GetSystemsInRange(const SystemPath &centre, double radius, std::vector<Result> &out, const Filter *filter)
+{
+	assert(centre.HasValidSystem());
+
+	const std::vector<vector3f> &centreSector = get_sector_positions(centre.sectorX, centre.sectorY, centre.sectorZ);
+	assert(centre.systemIndex < centreSector.size());
+	const vector3f here = centreSector[centre.systemIndex];
+
+	const int diff = int(ceil(radius/Sector::SIZE));
+	const double limit = radius + BOX_SLACK;
+
+	for (int dx = -diff; dx <= diff; dx++) {
+		const double gx = axis_gap(here.x, dx);
+		if (gx > limit) continue;
+
+		for (int dy = -diff; dy <= diff; dy++) {
+			const double gy = axis_gap(here.y, dy);
+			if (gx*gx + gy*gy > limit*limit) continue;
+
+			for (int dz = -diff; dz <= diff; dz++) {
+				const double gz = axis_gap(here.z, dz);
+				if (gx*gx + gy*gy + gz*gz > limit*limit) continue;
+
+				const int x = centre.sectorX + dx;
+				const int y = centre.sectorY + dy;
+				const int z = centre.sectorZ + dz;
+
+				// only fetched if the filter needs it
+				RefCountedPtr<Sector> sec;
+
+				const std::vector<vector3f> &positions = get_sector_positions(x, y, z);
+				for (Uint32 idx = 0; idx < positions.size(); idx++) {
+					if (dx == 0 && dy == 0 && dz == 0 && idx == centre.systemIndex)
+						continue;
+
+					// same sums as Sector::DistanceBetween
+					vector3f dv = here - positions[idx];
+					dv += Sector::SIZE*vector3f(float(-dx), float(-dy), float(-dz));
+					const float dist = dv.Length();
+					if (dist > radius)
+						continue;
+
+					const SystemPath path(x, y, z, idx);
+					if (filter) {
+						if (!sec) sec = Sector::GetCached(x, y, z);
+						if (!filter->Accept(path, sec->m_systems[idx]))
+							continue;
+					}
+
+					Result r;
+					r.path = path;
+					r.distance = dist;
+					out.push_back(r);
+				}
+			}
+		}
+	}
+}
+
+bool GalaxyIndex::FindSectorPositions(int x, int y, int z, std::vector<vector3f> &out)
+{
+	PositionGrid::const_iterator i = s_positions.find(SystemPath(x, y, z));
+	if (i != s_positions.end()) {
+		out = i->second;
+		return true;
+	}
+
+	if (!Sector::FindCached(x, y, z))
+		return false;
+	// it's cached, so this doesn't generate it
+	out = get_sector_positions(x, y, z);
+	return true;
+}
+
+void GalaxyIndex::AddSectorPositions(int x, int y, int z, const std::vector<vector3f> &positions)
+{
+	const SystemPath loc(x, y, z);
+	if (s_positions.count(loc))
+		return;
+
+	if (s_positions.size() >= MAX_INDEXED_SECTORS)
+		s_positions.clear();
+	s_positions[loc] = positions;
+}
+
+void GalaxyIndex::Clear()
+{
+	s_positions.clear();
+}
@@ -0,0 +1,54 @@
+// Copyright © 2008-2013 Pioneer Developers. See AUTHORS.txt for details
+// Licensed under the terms of the GPL v3. See licenses/GPL-3.txt
+
+#ifndef _GALAXYINDEX_H
+#define _GALAXYINDEX_H
+
+#include "libs.h"
+#include "galaxy/Sector.h"
+#include "galaxy/SystemPath.h"
+#include <vector>
+
+// answers range queries over the galaxy ("every system within R ly of
+// here") without generating any more than it has to. sectors whose box
+// can't reach the sphere are skipped outright. the system positions of the
+// rest are copied into a compact grid the first time they're asked for and
+// kept long after the Sector itself has left its cache, so repeat queries
+// over the same space are just arithmetic.
+//
+// distances are worked out exactly as Sector::DistanceBetween does them, so
+// whatever it says is in range is in range here too
+class GalaxyIndex {
+public:
+	struct Result {
+		SystemPath path;
+		float distance; // lightyears
+	};
+
+	// a test pushed down into the query. it sees each system that's in range
+	// as its sector describes it, so candidates can be thrown out before
+	// anything instantiates a StarSystem for them
+	class Filter {
+	public:
+		virtual ~Filter() {}
+		virtual bool Accept(const SystemPath &path, const Sector::System &sys) const = 0;
+	};
+
+	// every system within radius ly of the centre system, not counting the
+	// centre itself. results come in sector order (x, then y, then z) and
+	// system order within each sector. they're appended to out
+	static void GetSystemsInRange(const SystemPath &centre, double radius, std::vector<Result> &out, const Filter *filter = 0);
+
+	// copy out the positions of the systems in a sector (in the sector, as
+	// Sector::System::p), if the index or the Sector cache has them. never
+	// generates anything
+	static bool FindSectorPositions(int x, int y, int z, std::vector<vector3f> &out);
+	// remember the positions of a sector generated somewhere else
+	static void AddSectorPositions(int x, int y, int z, const std::vector<vector3f> &positions);
+
+	// forget everything. positions never change, so this is only to give
+	// the memory back
+	static void Clear();
+};
+
+#endif /* _GALAXYINDEX_H */
@@ -0,0 +1,306 @@
+// Copyright © 2008-2013 Pioneer Developers. See AUTHORS.txt for details
+// Licensed under the terms of the GPL v3. See licenses/GPL-3.txt
+
+#include "RoutePlanner.h"
+#include "GalaxyIndex.h"
+#include "Sector.h"
+#include "Pi.h"
+#include "JobQueue.h"
+#include <functional>
+#include <queue>
+
+// the most sectors a search will look through. past that the route is too
+// long to be worth planning in one go
+static const int MAX_ROUTE_SECTORS = 8192;
+
+// how far off the straight line a route can wander, at least
+static const double MIN_DETOUR = Sector::SIZE;
+
+// a jump costs this much on top of its length when counting jumps, which
+// is more than any route could be long
+static const double JUMP_COST = 1e6;
+
+struct RouteSector {
+	int x, y, z;
+	bool generated; // by the job, so GalaxyIndex doesn't have it
+	std::vector<vector3f> positions;
+};
+
+struct RouteNode {
+	Uint32 sector;
+	Uint32 idx;
+	vector3d pos; // relative to the start sector, only for the grid
+};
+
+// same sums as Sector::DistanceBetween
+static inline float jump_distance(const RouteSector &sa, const vector3f &a, const RouteSector &sb, const vector3f &b)
+{
+	vector3f dv = a - b;
+	dv += Sector::SIZE*vector3f(float(sa.x - sb.x), float(sa.y - sb.y), float(sa.z - sb.z));
+	return dv.Length();
+}
+
+class RoutePlanner::SearchJob : public Job {
+public:
+	SearchJob(const std::vector<RouteSector> &sectors, Uint32 fromSector, Uint32 fromIdx, Uint32 toSector, Uint32 toIdx,
+			double detour, float range, Cost cost, const Callback &done) :
+		m_sectors(sectors),
+		m_fromSector(fromSector), m_fromIdx(fromIdx), m_toSector(toSector), m_toIdx(toIdx),
+		m_detour(detour), m_range(range), m_cost(cost), m_done(done) {}
+
+	virtual const char *GetName() const { return "RoutePlanner::SearchJob"; }
+
+	virtual void OnRun() {
+		for (std::vector<RouteSector>::iterator s = m_sectors.begin(); s != m_sectors.end(); ++s) {
+			if (IsCancelled()) return;
+			if (!s->generated) continue;
+
+			const Sector sec(s->x, s->y, s->z);
+			s->positions.reserve(sec.m_systems.size());
+			for (std::vector<Sector::System>::const_iterator sys = sec.m_systems.begin(); sys != sec.m_systems.end(); ++sys)
+				s->positions.push_back(sys->p);
+		}
+
+		Search();
+	}
+
+	virtual void OnFinish() {
+		for (std::vector<RouteSector>::const_iterator s = m_sectors.begin(); s != m_sectors.end(); ++s)
+			if (s->generated)
+				GalaxyIndex::AddSectorPositions(s->x, s->y, s->z, s->positions);
+
+		m_done(m_route);
+	}
+
+private:
+	vector3d Position(Uint32 sector, Uint32 idx) const {
+		const RouteSector &from = m_sectors[m_fromSector];
+		const RouteSector &s = m_sectors[sector];
+		return Sector::SIZE*vector3d(double(s.x - from.x), double(s.y - from.y), double(s.z - from.z)) + vector3d(s.positions[idx]);
+	}
+
+	float Distance(const RouteNode &a, const RouteNode &b) const {
+		return jump_distance(m_sectors[a.sector], m_sectors[a.sector].positions[a.idx], m_sectors[b.sector], m_sectors[b.sector].positions[b.idx]);
+	}
+
+	// a lower bound on what's left to pay from a node with the target this far away
+	double Heuristic(float dist) const {
+		if (m_cost == FEWEST_JUMPS)
+			return ceil(double(dist) / double(m_range)) * JUMP_COST + double(dist);
+		return double(dist);
+	}
+
+	void Search() {
+		const vector3d start = Position(m_fromSector, m_fromIdx);
+		const vector3d target = Position(m_toSector, m_toIdx);
+		const double sumLimit = (target - start).Length() + 2.0*m_detour;
+
+		// everything in the ellipsoid, and a grid of range sized cells to
+		// find each one's neighbours with
+		std::vector<RouteNode> nodes;
+		Uint32 startNode = 0, targetNode = 0;
+		std::map<SystemPath, std::vector<Uint32> > grid;
+
+		for (Uint32 s = 0; s < m_sectors.size(); s++) {
+			for (Uint32 idx = 0; idx < m_sectors[s].positions.size(); idx++) {
+				RouteNode n;
+				n.sector = s;
+				n.idx = idx;
+				n.pos = Position(s, idx);
+
+				const bool isStart = (s == m_fromSector && idx == m_fromIdx);
+				const bool isTarget = (s == m_toSector && idx == m_toIdx);
+				if (!isStart && !isTarget && (n.pos - start).Length() + (n.pos - target).Length() > sumLimit)
+					continue;
+
+				if (isStart) startNode = nodes.size();
+				if (isTarget) targetNode = nodes.size();
+
+				const SystemPath cell(int(floor(n.pos.x / m_range)), int(floor(n.pos.y / m_range)), int(floor(n.pos.z / m_range)));
+				grid[cell].push_back(nodes.size());
+				nodes.push_back(n);
+			}
+		}
+
+		// A*. the grid cells are as big as the range, so every neighbour is
+		// in the 27 cells around a node
+		typedef std::pair<double, Uint32> QueueEntry;
+		std::priority_queue<QueueEntry, std::vector<QueueEntry>, std::greater<QueueEntry> > open;
+		std::vector<double> cost(nodes.size(), std::numeric_limits<double>::max());
+		std::vector<float> distance(nodes.size(), 0.0f);
+		std::vector<Uint32> prev(nodes.size(), Uint32(-1));
+		std::vector<bool> closed(nodes.size(), false);
+
+		const RouteNode &goal = nodes[targetNode];
+		cost[startNode] = 0.0;
+		open.push(QueueEntry(Heuristic(Distance(nodes[startNode], goal)), startNode));
+
+		while (!open.empty()) {
+			if (IsCancelled()) return;
+
+			const Uint32 cur = open.top().second;
+			open.pop();
+			if (closed[cur]) continue;
+			closed[cur] = true;
+
+			if (cur == targetNode) break;
+
+			const RouteNode &n = nodes[cur];
+			const int cx = int(floor(n.pos.x / m_range));
+			const int cy = int(floor(n.pos.y / m_range));
+			const int cz = int(floor(n.pos.z / m_range));
+
+			for (int dx = -1; dx <= 1; dx++) {
+				for (int dy = -1; dy <= 1; dy++) {
+					for (int dz = -1; dz <= 1; dz++) {
+						std::map<SystemPath, std::vector<Uint32> >::const_iterator cell = grid.find(SystemPath(cx+dx, cy+dy, cz+dz));
+						if (cell == grid.end()) continue;
+
+						for (std::vector<Uint32>::const_iterator i = cell->second.begin(); i != cell->second.end(); ++i) {
+							const Uint32 next = *i;
+							if (closed[next]) continue;
+
+							const float jump = Distance(n, nodes[next]);
+							if (jump > m_range) continue;
+
+							const double c = cost[cur] + double(jump) + (m_cost == FEWEST_JUMPS ? JUMP_COST : 0.0);
+							if (c >= cost[next]) continue;
+
+							cost[next] = c;
+							distance[next] = distance[cur] + jump;
+							prev[next] = cur;
+							open.push(QueueEntry(c + Heuristic(Distance(nodes[next], goal)), next));
+						}
+					}
+				}
+			}
+		}
+
+		if (!closed[targetNode])
+			return;
+
+		m_route.found = true;
+		m_route.distance = distance[targetNode];
+		for (Uint32 i = targetNode; i != Uint32(-1); i = prev[i]) {
+			const RouteSector &s = m_sectors[nodes[i].sector];
+			m_route.systems.push_back(SystemPath(s.x, s.y, s.z, nodes[i].idx));
+			m_route.positions.push_back(s.positions[nodes[i].idx]);
+		}
+		std::reverse(m_route.systems.begin(), m_route.systems.end());
+		std::reverse(m_route.positions.begin(), m_route.positions.end());
+	}
+
+	std::vector<RouteSector> m_sectors;
+	Uint32 m_fromSector, m_fromIdx;
+	Uint32 m_toSector, m_toIdx;
+	double m_detour;
+	float m_range;
+	Cost m_cost;
+	Callback m_done;
+	Route m_route;
+};
+
+// nearest distance along one axis from c to a sector offset sectors away
+// from the origin sector
+static inline double axis_gap(const double c, const int offset)
+{
+	const double lo = Sector::SIZE * double(offset) - c;
+	const double hi = c - Sector::SIZE * double(offset + 1);
+	return std::max(0.0, std::max(lo, hi));
+}
+
+// how near any point of a sector's box gets to p
+static inline double box_distance(const vector3d &p, int x, int y, int z)
+{
+	const double gx = axis_gap(p.x, x);
+	const double gy = axis_gap(p.y, y);
+	const double gz = axis_gap(p.z, z);
+	return sqrt(gx*gx + gy*gy + gz*gz);
+}
+
+Uint32 RoutePlanner::Plan(const SystemPath &from, const SystemPath &to, float range, Cost cost, const Callback &done)
+{
+	assert(from.HasValidSystem() && to.HasValidSystem());
+
+	Route route;
+
+	if (from.IsSameSystem(to)) {
+		route.found = true;
+		route.systems.push_back(from.SystemOnly());
+		route.positions.push_back(Sector::GetCached(from)->m_systems[from.systemIndex].p);
+		done(route);
+		return 0;
+	}
+
+	if (range <= 0.0f) {
+		done(route);
+		return 0;
+	}
+
+	// in sector units relative to the start sector from here on
+	const RefCountedPtr<Sector> fromSec = Sector::GetCached(from);
+	const RefCountedPtr<Sector> toSec = Sector::GetCached(to);
+	const vector3d start = vector3d(fromSec->m_systems[from.systemIndex].p);
+	const vector3d target = Sector::SIZE*vector3d(double(to.sectorX - from.sectorX), double(to.sectorY - from.sectorY), double(to.sectorZ - from.sectorZ)) +
+		vector3d(toSec->m_systems[to.systemIndex].p);
+
+	const double straight = (target - start).Length();
+	const double detour = std::max(MIN_DETOUR, 2.0*double(range));
+	const double sumLimit = straight + 2.0*detour;
+
+	// every sector the ellipsoid reaches. none of it is further than half
+	// the long axis from the middle
+	const vector3d middle = (start + target) * 0.5;
+	const double reach = sumLimit * 0.5;
+	const int xmin = int(floor((middle.x - reach) / Sector::SIZE)), xmax = int(floor((middle.x + reach) / Sector::SIZE));
+	const int ymin = int(floor((middle.y - reach) / Sector::SIZE)), ymax = int(floor((middle.y + reach) / Sector::SIZE));
+	const int zmin = int(floor((middle.z - reach) / Sector::SIZE)), zmax = int(floor((middle.z + reach) / Sector::SIZE));
+
+	std::vector<RouteSector> sectors;
+	Uint32 fromSector = 0, toSector = 0;
+	for (int x = xmin; x <= xmax; x++) {
+		for (int y = ymin; y <= ymax; y++) {
+			for (int z = zmin; z <= zmax; z++) {
+				const bool isFrom = (x == 0 && y == 0 && z == 0);
+				const bool isTo = (x == to.sectorX - from.sectorX && y == to.sectorY - from.sectorY && z == to.sectorZ - from.sectorZ);
+				if (!isFrom && !isTo && box_distance(start, x, y, z) + box_distance(target, x, y, z) > sumLimit)
+					continue;
+
+				if (sectors.size() >= size_t(MAX_ROUTE_SECTORS)) {
+					done(route);
+					return 0;
+				}
+
+				if (isFrom) fromSector = sectors.size();
+				if (isTo) toSector = sectors.size();
+
+				sectors.push_back(RouteSector());
+				RouteSector &s = sectors.back();
+				s.x = from.sectorX + x;
+				s.y = from.sectorY + y;
+				s.z = from.sectorZ + z;
+				s.generated = !GalaxyIndex::FindSectorPositions(s.x, s.y, s.z, s.positions);
+			}
+		}
+	}
+
+	SearchJob *job = new SearchJob(sectors, fromSector, from.systemIndex, toSector, to.systemIndex, detour, range, cost, done);
+
+	if (!Pi::Jobs()) {
+		job->OnRun();
+		job->OnFinish();
+		delete job;
+		return 0;
+	}
+
+	const Uint32 group = Pi::Jobs()->NewGroup();
+	job->SetGroup(group);
+	Pi::Jobs()->Queue(job);
+	return group;
+}
+
+void RoutePlanner::Cancel(Uint32 id)
+{
+	if (id && Pi::Jobs())
+		Pi::Jobs()->CancelGroup(id);
+}
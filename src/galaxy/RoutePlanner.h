@@ -0,0 +1,53 @@
+// Copyright © 2008-2013 Pioneer Developers. See AUTHORS.txt for details
+// Licensed under the terms of the GPL v3. See licenses/GPL-3.txt
+
+#ifndef _ROUTEPLANNER_H
+#define _ROUTEPLANNER_H
+
+#include "libs.h"
+#include "galaxy/SystemPath.h"
+#include <vector>
+
+// finds a chain of hyperspace jumps between two systems, none of them longer
+// than the jump range. the search runs on the job queue over the systems in
+// an ellipsoid around the straight line between the two, so a route that
+// has to make a long detour around a gap may not be found.
+//
+// the positions come from GalaxyIndex where it has them. sectors nobody has
+// generated yet are generated by the job (positions only, they don't go in
+// the Sector cache) and handed to GalaxyIndex afterwards
+//
+// jump distances are worked out exactly as Sector::DistanceBetween does
+// them, so every jump in a route passes the hyperspace range check
+class RoutePlanner {
+public:
+	enum Cost {
+		SHORTEST,     // least total distance, so least fuel
+		FEWEST_JUMPS, // then least distance among those
+	};
+
+	struct Route {
+		Route() : found(false), distance(0.0f) {}
+
+		bool found;
+		// from the start to the target, both included
+		std::vector<SystemPath> systems;
+		// where each of them is in its sector, as Sector::System::p
+		std::vector<vector3f> positions;
+		float distance; // lightyears, over all the jumps
+	};
+
+	typedef sigc::slot<void, const Route &> Callback;
+
+	// the callback is called from the main thread once the route has been
+	// worked out, or it's clear there isn't one. when that's obvious, or
+	// there's no job queue, it's called before Plan returns. the returned id
+	// can be given to Cancel, after which the callback is never called
+	static Uint32 Plan(const SystemPath &from, const SystemPath &to, float range, Cost cost, const Callback &done);
+	static void Cancel(Uint32 id);
+
+private:
+	class SearchJob;
+};
+
+#endif /* _ROUTEPLANNER_H */
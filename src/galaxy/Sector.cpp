@@ -5,9 +5,13 @@
 #include "StarSystem.h"
 #include "CustomSystem.h"
 #include "Galaxy.h"
+#include "SectorDatabase.h"
 
 #include "Factions.h"
+#include "MemoryStats.h"
 #include "utils.h"
+#include <list>
+#include <map>
 
 static const unsigned int SYS_NAME_FRAGS = 32;
 static const char *sys_names[SYS_NAME_FRAGS] =
@@ -27,7 +31,7 @@ void Sector::GetCustomSystems()
 		const CustomSystem *cs = *it;
 		System s(sx, sy, sz, sysIdx);
 		s.p = SIZE*cs->pos;
-		s.name = cs->name;
+		SetSystemName(s, cs->name.data(), cs->name.size());
 		for (s.numStars=0; s.numStars<cs->numStars; s.numStars++) {
 			if (cs->primaryType[s.numStars] == 0) break;
 			s.starType[s.numStars] = cs->primaryType[s.numStars];
@@ -51,11 +55,15 @@ Sector::Sector(int x, int y, int z)
 	GetCustomSystems();
 	int customCount = m_systems.size();
 
+	if (SectorDatabase::GetSystems(x, y, z, *this))
+		return;
+
 	/* Always place random systems outside the core custom-only region */
 	if ((x < -CUSTOM_ONLY_RADIUS) || (x > CUSTOM_ONLY_RADIUS-1) ||
 	    (y < -CUSTOM_ONLY_RADIUS) || (y > CUSTOM_ONLY_RADIUS-1) ||
 	    (z < -CUSTOM_ONLY_RADIUS) || (z > CUSTOM_ONLY_RADIUS-1)) {
 		int numSystems = (rng.Int32(4,20) * Galaxy::GetSectorDensity(x, y, z)) >> 8;
+		m_names.reserve(m_names.size() + numSystems * 8);
 
 		for (int i=0; i<numSystems; i++) {
 			System s(sx, sy, sz, customCount + i);
@@ -71,9 +79,11 @@ Sector::Sector(int x, int y, int z)
 					s.numStars = 1; break;
 			}
 
-			s.p.x = rng.Double(SIZE);
-			s.p.y = rng.Double(SIZE);
-			s.p.z = rng.Double(SIZE);
+			double pos[3];
+			rng.Fill(pos, 3);
+			s.p.x = SIZE*pos[0];
+			s.p.y = SIZE*pos[1];
+			s.p.z = SIZE*pos[2];
 
 			s.seed = 0;
 			s.customSys = 0;
@@ -222,14 +232,103 @@ Sector::Sector(int x, int y, int z)
 				//printf("%d: %d%\n", sx, sy);
 			}
 
-			s.name = GenName(s, customCount + i,  rng);
-			//printf("%s: \n", s.name.c_str());
+			GenName(s, customCount + i,  rng);
 
 			m_systems.push_back(s);
 		}
 	}
 }
 
+// unreferenced sectors kept around. a GetNearbySystems(20) from the middle of
+// a sector touches 343 of them, the far sector view holds its own references
+static const size_t SECTOR_CACHE_SIZE = 4096;
+
+// most recently used first
+typedef std::list<Sector*> SectorLRU;
+typedef std::map<SystemPath,SectorLRU::iterator> SectorCacheMap;
+static SectorLRU s_sectorLRU;
+static SectorCacheMap s_cachedSectors;
+// trimming walks the whole cache, so only do it every so often
+static size_t s_sectorCacheTrimAt = SECTOR_CACHE_SIZE;
+
+size_t Sector::GetMemoryUsage() const
+{
+	return sizeof(Sector) + m_systems.capacity() * sizeof(System) + m_names.capacity();
+}
+
+// over the memory budget, unreferenced sectors go even if there are fewer
+// than keepUnreferenced
+void Sector::TrimCache(size_t keepUnreferenced)
+{
+	size_t unreferenced = 0;
+	for (SectorLRU::const_iterator i = s_sectorLRU.begin(); i != s_sectorLRU.end(); ++i)
+		if ((*i)->GetRefCount() == 1) unreferenced++;
+
+	SectorLRU::iterator i = s_sectorLRU.end();
+	while ((unreferenced > keepUnreferenced || MemoryStats::IsOverBudget(MemoryStats::SECTORS)) &&
+			unreferenced > 0 && i != s_sectorLRU.begin()) {
+		--i;
+		Sector *s = *i;
+		assert(s->GetRefCount() >= 1); // sanity check
+		// if the cache is the only owner, then delete it
+		if (s->GetRefCount() == 1) {
+			s_cachedSectors.erase(SystemPath(s->sx, s->sy, s->sz));
+			i = s_sectorLRU.erase(i);
+			MemoryStats::Remove(MemoryStats::SECTORS, s->GetMemoryUsage());
+			s->DecRefCount();
+			unreferenced--;
+		}
+	}
+
+	s_sectorCacheTrimAt = s_sectorLRU.size() + SECTOR_CACHE_SIZE/2;
+}
+
+RefCountedPtr<Sector> Sector::GetCached(int x, int y, int z)
+{
+	RefCountedPtr<Sector> cached = FindCached(x, y, z);
+	if (cached) return cached;
+
+	// faction assignment can build other sectors, so the new one only goes
+	// into the cache once it's finished
+	Sector *s = new Sector(x, y, z);
+	s->AssignFactions();
+	return AddToCache(s);
+}
+
+RefCountedPtr<Sector> Sector::FindCached(int x, int y, int z)
+{
+	SectorCacheMap::iterator i = s_cachedSectors.find(SystemPath(x, y, z));
+	if (i == s_cachedSectors.end())
+		return RefCountedPtr<Sector>();
+
+	s_sectorLRU.splice(s_sectorLRU.begin(), s_sectorLRU, i->second);
+	return RefCountedPtr<Sector>(*(i->second));
+}
+
+RefCountedPtr<Sector> Sector::AddToCache(Sector *s)
+{
+	RefCountedPtr<Sector> cached = FindCached(s->sx, s->sy, s->sz);
+	if (cached) {
+		delete s;
+		return cached;
+	}
+
+	s->IncRefCount(); // the cache owns one reference
+	s_sectorLRU.push_front(s);
+	s_cachedSectors.insert(SectorCacheMap::value_type(SystemPath(s->sx, s->sy, s->sz), s_sectorLRU.begin()));
+	MemoryStats::Add(MemoryStats::SECTORS, s->GetMemoryUsage());
+
+	RefCountedPtr<Sector> ret(s);
+	if (s_sectorLRU.size() > s_sectorCacheTrimAt || MemoryStats::IsOverBudget(MemoryStats::SECTORS))
+		TrimCache(SECTOR_CACHE_SIZE);
+	return ret;
+}
+
+void Sector::ShrinkCache()
+{
+	TrimCache(0);
+}
+
 float Sector::DistanceBetween(const Sector *a, int sysIdxA, const Sector *b, int sysIdxB)
 {
 	vector3f dv = a->m_systems[sysIdxA].p - b->m_systems[sysIdxB].p;
@@ -237,9 +336,16 @@ float Sector::DistanceBetween(const Sector *a, int sysIdxA, const Sector *b, int
 	return dv.Length();
 }
 
-std::string Sector::GenName(System &sys, int si, Random &rng)
+void Sector::SetSystemName(System &sys, const char *name, size_t length)
+{
+	assert(length <= 0xffff);
+	sys.nameOffset = m_names.size();
+	sys.nameLength = length;
+	m_names.append(name, length);
+}
+
+void Sector::GenName(System &sys, int si, Random &rng)
 {
-	std::string name;
 	const int dist = std::max(std::max(abs(sx),abs(sy)),abs(sz));
 
 	int chance = 100;
@@ -274,28 +380,29 @@ std::string Sector::GenName(System &sys, int si, Random &rng)
 		default: chance += 16*dist; break;
 	}
 
+	// built in place, so naming a system doesn't allocate
+	char buf[128];
+	int len;
+
 	Uint32 weight = rng.Int32(chance);
 	if (weight < 500 || Faction::IsHomeSystem(SystemPath(sx, sy, sz, si))) {
 		/* well done. you get a real name  */
-		int len = rng.Int32(2,3);
-		for (int i=0; i<len; i++) {
-			name += sys_names[rng.Int32(0,SYS_NAME_FRAGS-1)];
+		const int frags = rng.Int32(2,3);
+		len = 0;
+		for (int i=0; i<frags; i++) {
+			const char *frag = sys_names[rng.Int32(0,SYS_NAME_FRAGS-1)];
+			while (*frag) buf[len++] = *frag++;
 		}
-		name[0] = toupper(name[0]);
-		return name;
+		buf[0] = toupper(buf[0]);
 	} else if (weight < 800) {
-		char buf[128];
-		snprintf(buf, sizeof(buf), "MJBN %d%+d%+d", rng.Int32(10,999),sx,sy); // MJBN -> Morton Jordan Bennett Norris
-		return buf;
+		len = snprintf(buf, sizeof(buf), "MJBN %d%+d%+d", rng.Int32(10,999),sx,sy); // MJBN -> Morton Jordan Bennett Norris
 	} else if (weight < 1200) {
-		char buf[128];
-		snprintf(buf, sizeof(buf), "SC %d%+d%+d", rng.Int32(1000,9999),sx,sy);
-		return buf;
+		len = snprintf(buf, sizeof(buf), "SC %d%+d%+d", rng.Int32(1000,9999),sx,sy);
 	} else {
-		char buf[128];
-		snprintf(buf, sizeof(buf), "DSC %d%+d%+d", rng.Int32(1000,9999),sx,sy);
-		return buf;
+		len = snprintf(buf, sizeof(buf), "DSC %d%+d%+d", rng.Int32(1000,9999),sx,sy);
 	}
+
+	SetSystemName(sys, buf, len);
 }
 
 bool Sector::WithinBox(const int Xmin, const int Xmax, const int Ymin, const int Ymax, const int Zmin, const int Zmax) const {
@@ -311,9 +418,16 @@ bool Sector::WithinBox(const int Xmin, const int Xmax, const int Ymin, const int
 
 void Sector::AssignFactions()
 {
+	if (SectorDatabase::GetFactions(sx, sy, sz, m_systems))
+		return;
+
+	// the factions that can reach this sector are the same for all its systems
+	std::vector<Faction*> candidates;
+	Faction::GetCandidateFactions(sx, sy, sz, candidates);
+
 	Uint32 index = 0;
 	for (std::vector<Sector::System>::iterator system = m_systems.begin(); system != m_systems.end(); ++system, ++index ) {
-		(*system).faction = Faction::GetNearestFaction(*this, index);
+		(*system).faction = Faction::GetNearestFaction(*this, index, candidates);
 	}
 }
 
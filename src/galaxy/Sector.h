@@ -8,16 +8,31 @@
 #include "galaxy/SystemPath.h"
 #include "galaxy/StarSystem.h"
 #include "galaxy/CustomSystem.h"
+#include "RefCounted.h"
 #include <string>
 #include <vector>
 
 class Faction;
 
-class Sector {
+class Sector : public RefCounted {
 public:
 	// lightyears
 	static const float SIZE;
 	Sector(int x, int y, int z);
+
+	// sectors are expensive to generate, so everything shares them through
+	// this cache. cached sectors have their factions assigned. sectors
+	// nobody holds a reference to are kept around until there are too many
+	// of them, then the least recently used are dropped
+	static RefCountedPtr<Sector> GetCached(int x, int y, int z);
+	static RefCountedPtr<Sector> GetCached(const SystemPath &loc) { return GetCached(loc.sectorX, loc.sectorY, loc.sectorZ); }
+	// the cached sector, or null if it hasn't been generated. never generates
+	static RefCountedPtr<Sector> FindCached(int x, int y, int z);
+	// hand over a sector generated elsewhere, with its factions assigned. if
+	// there's one cached already that is returned and s is deleted
+	static RefCountedPtr<Sector> AddToCache(Sector *s);
+	// drop every sector nobody holds a reference to
+	static void ShrinkCache();
 	static float DistanceBetween(const Sector *a, int sysIdxA, const Sector *b, int sysIdxB);
 	static void Init();
 
@@ -30,13 +45,15 @@ public:
 
 	class System {
 	public:
-		System(int x, int y, int z, Uint32 si): customSys(0), population(-1), sx(x), sy(y), sz(z), idx(si) {};
+		System(int x, int y, int z, Uint32 si): nameOffset(0), nameLength(0), customSys(0), population(-1), sx(x), sy(y), sz(z), idx(si) {};
 		~System() {};
 
 		// Check that we've had our habitation status set
 
 		// public members
-		std::string name;
+		// where the name is in the sector's names (see Sector::GetSystemName)
+		Uint32 nameOffset;
+		Uint16 nameLength;
 		vector3f p;
 		int numStars;
 		SystemBody::BodyType starType[4];
@@ -45,7 +62,7 @@ public:
 		Faction *faction;
 		fixed population;
 
-		vector3f FullPosition() { return Sector::SIZE*vector3f(float(sx), float(sy), float(sz)) + p; };
+		vector3f FullPosition() const { return Sector::SIZE*vector3f(float(sx), float(sy), float(sz)) + p; };
 		bool IsSameSystem(const SystemPath &b) const { 
 			return sx == b.sectorX && sy == b.sectorY && sz == b.sectorZ && idx == b.systemIndex;
 		}
@@ -55,10 +72,24 @@ public:
 	};
 	std::vector<System> m_systems;
 
+	// the names of all the systems are kept one after another in a single
+	// string, rather than each system having a string of its own
+	std::string GetSystemName(Uint32 idx) const {
+		return m_names.substr(m_systems[idx].nameOffset, m_systems[idx].nameLength);
+	}
+	// for SectorDatabase
+	void SetSystemName(System &sys, const char *name, size_t length);
+
 private:
+	static void TrimCache(size_t keepUnreferenced);
+	// roughly, what the cache is charged for holding it
+	size_t GetMemoryUsage() const;
+
 	int sx, sy, sz;
 	void GetCustomSystems();
-	std::string GenName(System &sys, int si, Random &rand);
+	void GenName(System &sys, int si, Random &rand);
+
+	std::string m_names;
 };
 
 #endif /* _SECTOR_H */
@@ -0,0 +1,242 @@
+// Copyright © 2008-2013 Pioneer Developers. See AUTHORS.txt for details
+// Licensed under the terms of the GPL v3. See licenses/GPL-3.txt
+
+#include "SectorDatabase.h"
+#include "Factions.h"
+#include "FileSystem.h"
+#include <cstdio>
+
+extern "C" {
+#include "jenkins/lookup3.h"
+}
+
+namespace SectorDatabase {
+
+// the custom only core is 4 sectors out, and most of the play happens a
+// little way past it
+const int RADIUS = 12;
+static const int SIDE = 2*RADIUS + 1;
+
+static const char DATABASE_DIR_NAME[] = "sectorcache";
+static const char DATABASE_FILE_NAME[] = "sectors.db";
+
+// bump this if the layout changes, or sector generation does
+static const Uint32 DATABASE_VERSION = 1;
+
+static const char DATABASE_MAGIC[4] = { 'P', 'S', 'D', 'B' };
+
+struct FileHeader {
+	char magic[4];
+	Uint32 version;
+	Uint32 universeSeed;
+	Sint32 radius;
+	Uint32 dataHashA; // of the data files sectors are made from
+	Uint32 dataHashB;
+	Uint32 numSystems;
+	Uint32 namesSize;
+};
+
+// then SIDE^3 of these, x major
+struct SectorRecord {
+	Uint32 firstSystem;
+	Uint16 numSystems;
+	Uint16 numCustom; // the first numCustom systems are the custom ones
+};
+
+// then numSystems of these, then the names
+struct SystemRecord {
+	float p[3];
+	Uint32 seed;
+	Uint32 nameOffset;
+	Uint32 faction;
+	Uint8 numStars;
+	Uint8 nameLength;
+	Uint8 starType[4];
+	Uint8 pad[2];
+};
+
+static RefCountedPtr<FileSystem::FileData> s_data;
+static const SectorRecord *s_sectors;
+static const SystemRecord *s_systems;
+static const char *s_names;
+
+static void hash_file(const std::string &path, Uint32 &a, Uint32 &b)
+{
+	RefCountedPtr<FileSystem::FileData> data = FileSystem::gameDataFiles.ReadFile(path);
+	lookup3_hashlittle2(path.c_str(), path.size(), &a, &b);
+	if (data) lookup3_hashlittle2(data->GetData(), data->GetSize(), &a, &b);
+}
+
+// the header that a database made from the data as it is now has to have
+static FileHeader make_header()
+{
+	FileHeader header;
+	memcpy(header.magic, DATABASE_MAGIC, sizeof(DATABASE_MAGIC));
+	header.version = DATABASE_VERSION;
+	header.universeSeed = UNIVERSE_SEED;
+	header.radius = RADIUS;
+
+	header.dataHashA = header.dataHashB = 0;
+	hash_file("galaxy.bmp", header.dataHashA, header.dataHashB);
+	static const char *dirs[] = { "systems", "factions" };
+	for (unsigned int i = 0; i < COUNTOF(dirs); i++) {
+		for (FileSystem::FileEnumerator files(FileSystem::gameDataFiles, dirs[i], FileSystem::FileEnumerator::Recurse); !files.Finished(); files.Next())
+			hash_file(files.Current().GetPath(), header.dataHashA, header.dataHashB);
+	}
+
+	header.numSystems = 0;
+	header.namesSize = 0;
+	return header;
+}
+
+static inline int sector_index(int x, int y, int z)
+{
+	return ((x + RADIUS)*SIDE + (y + RADIUS))*SIDE + (z + RADIUS);
+}
+
+static inline bool is_covered(int x, int y, int z)
+{
+	return abs(x) <= RADIUS && abs(y) <= RADIUS && abs(z) <= RADIUS;
+}
+
+static bool load(const std::string &filename, const FileHeader &want)
+{
+	RefCountedPtr<FileSystem::FileData> data = FileSystem::userFiles.ReadFile(filename);
+	if (!data || data->GetSize() < sizeof(FileHeader)) return false;
+
+	const FileHeader &header = *reinterpret_cast<const FileHeader*>(data->GetData());
+	const bool ok = (memcmp(header.magic, want.magic, sizeof(want.magic)) == 0) &&
+		header.version == want.version &&
+		header.universeSeed == want.universeSeed &&
+		header.radius == want.radius &&
+		header.dataHashA == want.dataHashA &&
+		header.dataHashB == want.dataHashB &&
+		data->GetSize() == sizeof(FileHeader) + SIDE*SIDE*SIDE*sizeof(SectorRecord) +
+			size_t(header.numSystems)*sizeof(SystemRecord) + header.namesSize;
+	if (!ok) return false;
+
+	s_data = data;
+	s_sectors = reinterpret_cast<const SectorRecord*>(data->GetData() + sizeof(FileHeader));
+	s_systems = reinterpret_cast<const SystemRecord*>(s_sectors + SIDE*SIDE*SIDE);
+	s_names = reinterpret_cast<const char*>(s_systems + header.numSystems);
+	return true;
+}
+
+// generate every sector and write them out. nothing reads the database
+// while this runs, so these are generated as usual
+static void build(const std::string &filename, FileHeader header)
+{
+	std::vector<SectorRecord> sectors(SIDE*SIDE*SIDE);
+	std::vector<SystemRecord> systems;
+	std::string names;
+
+	for (int x = -RADIUS; x <= RADIUS; x++) {
+		for (int y = -RADIUS; y <= RADIUS; y++) {
+			for (int z = -RADIUS; z <= RADIUS; z++) {
+				Sector sec(x, y, z);
+				sec.AssignFactions();
+
+				SectorRecord &rec = sectors[sector_index(x, y, z)];
+				rec.firstSystem = systems.size();
+				rec.numSystems = sec.m_systems.size();
+				rec.numCustom = 0;
+
+				Uint32 idx = 0;
+				for (std::vector<Sector::System>::const_iterator it = sec.m_systems.begin(); it != sec.m_systems.end(); ++it, ++idx) {
+					if (it->customSys) rec.numCustom++;
+
+					SystemRecord sys;
+					memset(&sys, 0, sizeof(sys));
+					sys.p[0] = it->p.x;
+					sys.p[1] = it->p.y;
+					sys.p[2] = it->p.z;
+					sys.seed = it->seed;
+					sys.nameOffset = names.size();
+					const std::string name = sec.GetSystemName(idx);
+					sys.nameLength = std::min(name.size(), size_t(255));
+					sys.faction = it->faction->idx;
+					sys.numStars = it->numStars;
+					for (int i = 0; i < it->numStars; i++)
+						sys.starType[i] = it->starType[i];
+					names.append(name, 0, sys.nameLength);
+					systems.push_back(sys);
+				}
+			}
+		}
+	}
+
+	header.numSystems = systems.size();
+	header.namesSize = names.size();
+
+	// a short write leaves a file that fails the size check in load, so
+	// it's just built again next time
+	FILE *f = FileSystem::userFiles.OpenWriteStream(filename);
+	if (!f) return;
+	fwrite(&header, sizeof(header), 1, f);
+	fwrite(&sectors[0], sizeof(SectorRecord), sectors.size(), f);
+	if (!systems.empty()) fwrite(&systems[0], sizeof(SystemRecord), systems.size(), f);
+	if (!names.empty()) fwrite(names.data(), names.size(), 1, f);
+	fclose(f);
+}
+
+void Init(bool enabled)
+{
+	Uninit();
+	if (!enabled || !FileSystem::userFiles.MakeDirectory(DATABASE_DIR_NAME)) return;
+
+	const std::string filename = FileSystem::JoinPathBelow(DATABASE_DIR_NAME, DATABASE_FILE_NAME);
+	const FileHeader header = make_header();
+	if (load(filename, header)) return;
+
+	build(filename, header);
+	if (!load(filename, header))
+		fprintf(stderr, "SectorDatabase: couldn't save '%s', sectors will be generated\n", filename.c_str());
+}
+
+void Uninit()
+{
+	s_data.Reset();
+	s_sectors = 0;
+	s_systems = 0;
+	s_names = 0;
+}
+
+bool GetSystems(int x, int y, int z, Sector &sector)
+{
+	std::vector<Sector::System> &systems = sector.m_systems;
+
+	if (!s_sectors || !is_covered(x, y, z)) return false;
+
+	const SectorRecord &sec = s_sectors[sector_index(x, y, z)];
+	if (sec.numCustom != systems.size()) return false;
+
+	for (Uint32 i = sec.numCustom; i < sec.numSystems; i++) {
+		const SystemRecord &rec = s_systems[sec.firstSystem + i];
+		Sector::System s(x, y, z, i);
+		s.p = vector3f(rec.p[0], rec.p[1], rec.p[2]);
+		s.seed = rec.seed;
+		s.customSys = 0;
+		sector.SetSystemName(s, s_names + rec.nameOffset, rec.nameLength);
+		s.numStars = rec.numStars;
+		for (int j = 0; j < rec.numStars; j++)
+			s.starType[j] = SystemBody::BodyType(rec.starType[j]);
+		systems.push_back(s);
+	}
+	return true;
+}
+
+bool GetFactions(int x, int y, int z, std::vector<Sector::System> &systems)
+{
+	if (!s_sectors || !is_covered(x, y, z)) return false;
+
+	const SectorRecord &sec = s_sectors[sector_index(x, y, z)];
+	if (sec.numSystems != systems.size()) return false;
+
+	for (Uint32 i = 0; i < sec.numSystems; i++) {
+		const Uint32 faction = s_systems[sec.firstSystem + i].faction;
+		systems[i].faction = faction < Faction::GetNumFactions() ? Faction::GetFaction(faction) : Faction::GetNoFaction();
+	}
+	return true;
+}
+
+} /* namespace SectorDatabase */
@@ -0,0 +1,35 @@
+// Copyright © 2008-2013 Pioneer Developers. See AUTHORS.txt for details
+// Licensed under the terms of the GPL v3. See licenses/GPL-3.txt
+
+#ifndef _SECTORDATABASE_H
+#define _SECTORDATABASE_H
+
+#include "libs.h"
+#include "galaxy/Sector.h"
+#include <vector>
+
+// the generated systems of every sector near the core, with their factions,
+// kept in a file in the user dir so they don't have to be generated over and
+// over. the file is mapped in and read in place. it's made again whenever
+// the galaxy, custom system or faction data it came from changes, so what
+// it answers is exactly what generating the sector would have made.
+//
+// populations aren't kept, they need the whole StarSystem
+namespace SectorDatabase {
+	// sectors this far from sector 0,0,0 on every axis are in it
+	extern const int RADIUS;
+
+	// after the factions and custom systems are in. loads the database, or
+	// builds and saves it first if it's missing or out of date. off, it
+	// answers nothing and every sector is generated
+	void Init(bool enabled);
+	void Uninit();
+
+	// add the generated systems of the sector after its custom systems,
+	// which must already be in it. false if the sector isn't covered
+	bool GetSystems(int x, int y, int z, Sector &sector);
+	// set the factions of all the systems. false if the sector isn't covered
+	bool GetFactions(int x, int y, int z, std::vector<Sector::System> &systems);
+}
+
+#endif /* _SECTORDATABASE_H */
@@ -8,10 +8,15 @@
 #include "Serializer.h"
 #include "Pi.h"
 #include "LuaNameGen.h"
+#include "JobQueue.h"
+#include "MemoryStats.h"
 #include "enum_table.h"
 #include <map>
+#include <list>
+#include <set>
 #include <string>
 #include <algorithm>
+#include <new>
 #include "utils.h"
 #include "Orbit.h"
 #include "Lang.h"
@@ -879,7 +884,7 @@ SystemBody *StarSystem::GetBodyByPath(const SystemPath &path) const
 	assert(path.IsBodyPath());
 	assert(path.bodyIndex < m_bodies.size());
 
-	return m_bodies[path.bodyIndex].Get();
+	return m_bodies[path.bodyIndex];
 }
 
 SystemPath StarSystem::GetPathOf(const SystemBody *sbody) const
@@ -1003,7 +1008,7 @@ void StarSystem::GenerateFromCustom(const CustomSystem *customSys, Random &rand)
 {
 	const CustomSystemBody *csbody = customSys->sBody;
 
-	rootBody.Reset(NewBody());
+	rootBody = NewBody();
 	rootBody->type = csbody->type;
 	rootBody->parent = 0;
 	rootBody->seed = csbody->want_rand_seed ? rand.Int32() : csbody->seed;
@@ -1019,8 +1024,8 @@ void StarSystem::GenerateFromCustom(const CustomSystem *customSys, Random &rand)
 	rootBody->orbitalPhaseAtStart = csbody->orbitalPhaseAtStart;
 
 	int humanInfestedness = 0;
-	CustomGetKidsOf(rootBody.Get(), csbody->children, &humanInfestedness, rand);
-	Populate(false);
+	CustomGetKidsOf(rootBody, csbody->children, &humanInfestedness, rand);
+	Populate(false, customSys->govType);
 
 	// an example re-export of custom system, can be removed during the merge
 	//char filename[500];
@@ -1142,6 +1147,7 @@ void StarSystem::MakeBinaryPair(SystemBody *a, SystemBody *b, fixed minDist, Ran
 
 SystemBody::SystemBody()
 {
+	m_system = 0;
 	heightMapFilename = 0;
 	heightMapFractal = 0;
 	aspectRatio = fixed(1,1);
@@ -1373,46 +1379,57 @@ SystemBody::AtmosphereParameters SystemBody::CalcAtmosphereParams() const
 	return params;
 }
 
+/*
+ * 0 - ~500ly from sol: explored
+ * ~500ly - ~700ly (65-90 sectors): gradual
+ * ~700ly+: unexplored
+ *
+ * rand must be the system's own generator, fresh. in the gradual region this
+ * takes its first draw, and everything generated after depends on that
+ */
+static bool roll_unexplored(const SystemPath &path, const Sector::System &sys, Random &rand)
+{
+	int dist = isqrt(1 + path.sectorX*path.sectorX + path.sectorY*path.sectorY + path.sectorZ*path.sectorZ);
+	bool unexplored = !(((dist <= 90) && ( dist <= 65 || rand.Int32(dist) <= 40)) || Faction::IsHomeSystem(path));
+	if (sys.customSys && !sys.customSys->want_rand_explored)
+		unexplored = !sys.customSys->explored;
+	return unexplored;
+}
+
 /*
  * As my excellent comrades have pointed out, choices that depend on floating
  * point crap will result in different universes on different platforms.
  *
  * We must be sneaky and avoid floating point in these places.
  */
-StarSystem::StarSystem(const SystemPath &path) : m_path(path)
+StarSystem::StarSystem(const SystemPath &path, const Sector &sector) : rootBody(0), m_path(path)
 {
 	assert(path.IsSystemPath());
 	memset(m_tradeLevel, 0, sizeof(m_tradeLevel));
+	std::fill(m_commodityLegal, m_commodityLegal + Equip::TYPE_MAX, true);
 
-	Sector s = Sector(m_path.sectorX, m_path.sectorY, m_path.sectorZ);
-	assert(m_path.systemIndex >= 0 && m_path.systemIndex < s.m_systems.size());
+	assert(m_path.systemIndex >= 0 && m_path.systemIndex < sector.m_systems.size());
+	const Sector::System &sys = sector.m_systems[m_path.systemIndex];
 
-	m_seed    = s.m_systems[m_path.systemIndex].seed;
-	m_name    = s.m_systems[m_path.systemIndex].name;
-	m_faction = Faction::GetNearestFaction(s, m_path.systemIndex);
+	m_seed    = sys.seed;
+	m_name    = sector.GetSystemName(m_path.systemIndex);
+	m_faction = sys.faction;
 
 	Uint32 _init[6] = { m_path.systemIndex, Uint32(m_path.sectorX), Uint32(m_path.sectorY), Uint32(m_path.sectorZ), UNIVERSE_SEED, Uint32(m_seed) };
 	Random rand(_init, 6);
 
-	/*
-	 * 0 - ~500ly from sol: explored
-	 * ~500ly - ~700ly (65-90 sectors): gradual
-	 * ~700ly+: unexplored
-	 */
-	int dist = isqrt(1 + m_path.sectorX*m_path.sectorX + m_path.sectorY*m_path.sectorY + m_path.sectorZ*m_path.sectorZ);
-	m_unexplored = !(((dist <= 90) && ( dist <= 65 || rand.Int32(dist) <= 40)) || Faction::IsHomeSystem(path));
+	m_unexplored = roll_unexplored(m_path, sys, rand);
 
 	m_isCustom = m_hasCustomBodies = false;
-	if (s.m_systems[m_path.systemIndex].customSys) {
+	if (sys.customSys) {
 		m_isCustom = true;
-		const CustomSystem *custom = s.m_systems[m_path.systemIndex].customSys;
+		const CustomSystem *custom = sys.customSys;
 		m_numStars = custom->numStars;
 		if (custom->shortDesc.length() > 0) m_shortDesc = custom->shortDesc;
 		if (custom->longDesc.length() > 0) m_longDesc = custom->longDesc;
-		if (!custom->want_rand_explored) m_unexplored = !custom->explored;
 		if (!custom->IsRandom()) {
 			m_hasCustomBodies = true;
-			GenerateFromCustom(s.m_systems[m_path.systemIndex].customSys, rand);
+			GenerateFromCustom(sys.customSys, rand);
 			return;
 		}
 	}
@@ -1420,37 +1437,37 @@ StarSystem::StarSystem(const SystemPath &path) : m_path(path)
 	SystemBody *star[4];
 	SystemBody *centGrav1(0), *centGrav2(0);
 
-	const int numStars = s.m_systems[m_path.systemIndex].numStars;
+	const int numStars = sys.numStars;
 	assert((numStars >= 1) && (numStars <= 4));
 
 	if (numStars == 1) {
-		SystemBody::BodyType type = s.m_systems[m_path.systemIndex].starType[0];
+		SystemBody::BodyType type = sys.starType[0];
 		star[0] = NewBody();
 		star[0]->parent = 0;
-		star[0]->name = s.m_systems[m_path.systemIndex].name;
+		star[0]->name = m_name;
 		star[0]->orbMin = fixed(0);
 		star[0]->orbMax = fixed(0);
 
 		MakeStarOfType(star[0], type, rand);
-		rootBody.Reset(star[0]);
+		rootBody = star[0];
 		m_numStars = 1;
 	} else {
 		centGrav1 = NewBody();
 		centGrav1->type = SystemBody::TYPE_GRAVPOINT;
 		centGrav1->parent = 0;
-		centGrav1->name = s.m_systems[m_path.systemIndex].name+" A,B";
-		rootBody.Reset(centGrav1);
+		centGrav1->name = m_name+" A,B";
+		rootBody = centGrav1;
 
-		SystemBody::BodyType type = s.m_systems[m_path.systemIndex].starType[0];
+		SystemBody::BodyType type = sys.starType[0];
 		star[0] = NewBody();
-		star[0]->name = s.m_systems[m_path.systemIndex].name+" A";
+		star[0]->name = m_name+" A";
 		star[0]->parent = centGrav1;
 		MakeStarOfType(star[0], type, rand);
 
 		star[1] = NewBody();
-		star[1]->name = s.m_systems[m_path.systemIndex].name+" B";
+		star[1]->name = m_name+" B";
 		star[1]->parent = centGrav1;
-		MakeStarOfTypeLighterThan(star[1], s.m_systems[m_path.systemIndex].starType[1],
+		MakeStarOfTypeLighterThan(star[1], sys.starType[1],
 				star[0]->mass, rand);
 
 		centGrav1->mass = star[0]->mass + star[1]->mass;
@@ -1471,29 +1488,29 @@ try_that_again_guvnah:
 			// 3rd and maybe 4th star
 			if (numStars == 3) {
 				star[2] = NewBody();
-				star[2]->name = s.m_systems[m_path.systemIndex].name+" C";
+				star[2]->name = m_name+" C";
 				star[2]->orbMin = 0;
 				star[2]->orbMax = 0;
-				MakeStarOfTypeLighterThan(star[2], s.m_systems[m_path.systemIndex].starType[2],
+				MakeStarOfTypeLighterThan(star[2], sys.starType[2],
 					star[0]->mass, rand);
 				centGrav2 = star[2];
 				m_numStars = 3;
 			} else {
 				centGrav2 = NewBody();
 				centGrav2->type = SystemBody::TYPE_GRAVPOINT;
-				centGrav2->name = s.m_systems[m_path.systemIndex].name+" C,D";
+				centGrav2->name = m_name+" C,D";
 				centGrav2->orbMax = 0;
 
 				star[2] = NewBody();
-				star[2]->name = s.m_systems[m_path.systemIndex].name+" C";
+				star[2]->name = m_name+" C";
 				star[2]->parent = centGrav2;
-				MakeStarOfTypeLighterThan(star[2], s.m_systems[m_path.systemIndex].starType[2],
+				MakeStarOfTypeLighterThan(star[2], sys.starType[2],
 					star[0]->mass, rand);
 
 				star[3] = NewBody();
-				star[3]->name = s.m_systems[m_path.systemIndex].name+" D";
+				star[3]->name = m_name+" D";
 				star[3]->parent = centGrav2;
-				MakeStarOfTypeLighterThan(star[3], s.m_systems[m_path.systemIndex].starType[3],
+				MakeStarOfTypeLighterThan(star[3], sys.starType[3],
 					star[2]->mass, rand);
 
 				// Separate stars by 0.2 radii for each, so that their planets don't bump into the other star
@@ -1507,10 +1524,10 @@ try_that_again_guvnah:
 			SystemBody *superCentGrav = NewBody();
 			superCentGrav->type = SystemBody::TYPE_GRAVPOINT;
 			superCentGrav->parent = 0;
-			superCentGrav->name = s.m_systems[m_path.systemIndex].name;
+			superCentGrav->name = m_name;
 			centGrav1->parent = superCentGrav;
 			centGrav2->parent = superCentGrav;
-			rootBody.Reset(superCentGrav);
+			rootBody = superCentGrav;
 			const fixed minDistSuper = star[0]->orbMax + star[2]->orbMax;
 			MakeBinaryPair(centGrav1, centGrav2, 4*minDistSuper, rand);
 			superCentGrav->children.push_back(centGrav1);
@@ -1528,7 +1545,7 @@ try_that_again_guvnah:
 	if (m_numStars > 1) MakePlanetsAround(centGrav1, rand);
 	if (m_numStars == 4) MakePlanetsAround(centGrav2, rand);
 
-	Populate(true);
+	Populate(true, sys.customSys ? sys.customSys->govType : Polit::GOV_INVALID);
 
 	// an example export of generated system, can be removed during the merge
 	//char filename[500];
@@ -2016,7 +2033,7 @@ void StarSystem::MakeShortDescription(Random &rand)
 /* percent */
 #define MAX_COMMODITY_BASE_PRICE_ADJUSTMENT 25
 
-void StarSystem::Populate(bool addSpaceStations)
+void StarSystem::Populate(bool addSpaceStations, Polit::GovType customGovType)
 {
 	Uint32 _init[5] = { m_path.systemIndex, Uint32(m_path.sectorX), Uint32(m_path.sectorY), Uint32(m_path.sectorZ), UNIVERSE_SEED };
 	Random rand;
@@ -2054,7 +2071,12 @@ void StarSystem::Populate(bool addSpaceStations)
 //		printf("%s: %d%%\n", type.name, m_tradeLevel[t]);
 //	}
 //	printf("System total population %.3f billion\n", m_totalPop.ToFloat());
-	Polit::GetSysPolitStarSystem(this, m_totalPop, m_polit);
+	Polit::GetSysPolitStarSystem(m_path, m_faction, customGovType, m_totalPop, m_polit);
+
+	// legality only depends on the path, government and faction, and is
+	// asked for a lot (markets, trade routes), so it's kept
+	for (int i = 0; i < Equip::TYPE_MAX; i++)
+		m_commodityLegal[i] = Polit::IsCommodityLegal(this, Equip::Type(i));
 
 	if (addSpaceStations) {
 		rootBody->PopulateAddStations(this);
@@ -2173,7 +2195,7 @@ void SystemBody::PopulateStage1(StarSystem *system, fixed &outTotalPop)
 	}
 
 	if (!system->m_hasCustomBodies && m_population > 0)
-		name = Pi::luaNameGen->BodyName(this, namerand);
+		system->m_pendingNames.push_back(StarSystem::PendingName(this, namerand, false));
 
 	// Add a bunch of things people consume
 	for (int i=0; i<NUM_CONSUMABLES; i++) {
@@ -2265,7 +2287,7 @@ void SystemBody::PopulateAddStations(StarSystem *system)
 		sp->orbMin = sp->semiMajorAxis;
 		sp->orbMax = sp->semiMajorAxis;
 
-		sp->name = gen_unique_station_name(sp, system, namerand);
+		system->m_pendingNames.push_back(StarSystem::PendingName(sp, namerand, true));
 
 		pop -= rand.Fixed();
 		if (pop > 0) {
@@ -2274,7 +2296,7 @@ void SystemBody::PopulateAddStations(StarSystem *system)
 			*sp2 = *sp;
 			sp2->path = path2;
 			sp2->orbit.SetPlane(matrix3x3d::RotateZ(M_PI));
-			sp2->name = gen_unique_station_name(sp, system, namerand);
+			system->m_pendingNames.push_back(StarSystem::PendingName(sp2, namerand, true));
 			children.insert(children.begin(), sp2);
 			system->m_spaceStations.push_back(sp2);
 		}
@@ -2293,7 +2315,7 @@ void SystemBody::PopulateAddStations(StarSystem *system)
 		sp->parent = this;
 		sp->averageTemp = this->averageTemp;
 		sp->mass = 0;
-		sp->name = gen_unique_station_name(sp, system, namerand);
+		system->m_pendingNames.push_back(StarSystem::PendingName(sp, namerand, true));
 		memset(&sp->orbit, 0, sizeof(Orbit));
 		position_settlement_on_planet(sp);
 		children.insert(children.begin(), sp);
@@ -2301,19 +2323,50 @@ void SystemBody::PopulateAddStations(StarSystem *system)
 	}
 }
 
-static void clear_parent_and_child_pointers(SystemBody *body)
+// on the main thread, Lua isn't safe anywhere else. the names come out in
+// the order they were asked for, so each station is checked against the
+// same stations it would have been if it was named as it was made
+void StarSystem::ResolveNames()
+{
+	for (std::vector<PendingName>::iterator i = m_pendingNames.begin(); i != m_pendingNames.end(); ++i) {
+		if (i->unique)
+			i->body->name = gen_unique_station_name(i->body, this, i->namerand);
+		else
+			i->body->name = Pi::luaNameGen->BodyName(i->body, i->namerand);
+	}
+	m_pendingNames.clear();
+}
+
+SystemBody *StarSystem::NewBody()
 {
-	for (std::vector<SystemBody*>::iterator i = body->children.begin(); i != body->children.end(); ++i)
-		clear_parent_and_child_pointers(*i);
-	body->parent = 0;
-	body->children.clear();
+	const size_t slot = m_bodies.size() % BODY_BLOCK_SIZE;
+	if (slot == 0)
+		m_bodyBlocks.push_back(::operator new(BODY_BLOCK_SIZE * sizeof(SystemBody)));
+	SystemBody *body = new (static_cast<SystemBody*>(m_bodyBlocks.back()) + slot) SystemBody;
+	body->m_system = this;
+	body->path = m_path;
+	body->path.bodyIndex = m_bodies.size();
+	m_bodies.push_back(body);
+	return body;
 }
 
 StarSystem::~StarSystem()
 {
-	// clear parent and children pointers. someone (Lua) might still have a
-	// reference to things that are about to be deleted
-	clear_parent_and_child_pointers(rootBody.Get());
+	// nothing else can be holding a body now, a reference to one keeps the
+	// system alive
+	for (std::vector<SystemBody*>::iterator i = m_bodies.begin(); i != m_bodies.end(); ++i)
+		(*i)->~SystemBody();
+	for (std::vector<void*>::iterator i = m_bodyBlocks.begin(); i != m_bodyBlocks.end(); ++i)
+		::operator delete(*i);
+}
+
+size_t StarSystem::GetMemoryUsage() const
+{
+	size_t bytes = sizeof(StarSystem) + m_bodyBlocks.size() * BODY_BLOCK_SIZE * sizeof(SystemBody) +
+		m_bodies.capacity() * sizeof(SystemBody*);
+	for (std::vector<SystemBody*>::const_iterator i = m_bodies.begin(); i != m_bodies.end(); ++i)
+		bytes += (*i)->children.capacity() * sizeof(SystemBody*) + (*i)->name.capacity();
+	return bytes;
 }
 
 void StarSystem::Serialize(Serializer::Writer &wr, StarSystem *s)
@@ -2342,40 +2395,261 @@ RefCountedPtr<StarSystem> StarSystem::Unserialize(Serializer::Reader &rd)
 	}
 }
 
-typedef std::map<SystemPath,StarSystem*> SystemCacheMap;
+// most recently used first
+typedef std::list<StarSystem*> SystemLRU;
+typedef std::map<SystemPath,SystemLRU::iterator> SystemCacheMap;
+static SystemLRU s_systemLRU;
 static SystemCacheMap s_cachedSystems;
+// unreferenced systems kept for reuse. trimming walks the whole cache, so
+// it only happens once it's grown by half as much again
+static size_t s_systemCacheSize = 64;
+static size_t s_systemCacheTrimAt = 64;
+static Uint32 s_systemCacheHits = 0;
+static Uint32 s_systemCacheMisses = 0;
+
+// a summary is a couple of hundred bytes. when this many have piled up they
+// all go and get made again as they're needed
+static const size_t MAX_CACHED_SUMMARIES = 65536;
+
+typedef std::map<SystemPath,StarSystemSummary> SummaryCacheMap;
+static SummaryCacheMap s_cachedSummaries;
+
+// systems being made by RequestBatch, and the group their jobs are in. it's
+// only made when the first batch is asked for, so a ShrinkCache from a
+// worker (faction setup does that) never touches the queue
+static std::set<SystemPath> s_pendingSystems;
+static Uint32 s_batchGroup = 0;
+
+// makes the system in a worker. the sector was fetched on the main thread
+// and the job holds it, so nothing touches a reference count off it
+class StarSystem::GenerateJob : public Job {
+public:
+	GenerateJob(const SystemPath &path, const RefCountedPtr<Sector> &sector) : m_path(path), m_sector(sector), m_system(0) {}
+	virtual ~GenerateJob() { delete m_system; }
+	virtual const char *GetName() const { return "StarSystem::GenerateJob"; }
+
+	virtual void OnRun() {
+		m_system = new StarSystem(m_path, *m_sector);
+	}
+
+	virtual void OnFinish() {
+		s_pendingSystems.erase(m_path);
+		StarSystem *s = m_system;
+		m_system = 0;
+		// someone couldn't wait for it and made it themselves
+		if (s_cachedSystems.count(m_path)) {
+			delete s;
+			return;
+		}
+		AddToCache(s);
+	}
+
+private:
+	SystemPath m_path;
+	RefCountedPtr<Sector> m_sector;
+	StarSystem *m_system;
+};
 
 RefCountedPtr<StarSystem> StarSystem::GetCached(const SystemPath &path)
 {
 	SystemPath sysPath(path.SystemOnly());
 
-	StarSystem *s = 0;
-	std::pair<SystemCacheMap::iterator, bool>
-		ret = s_cachedSystems.insert(SystemCacheMap::value_type(sysPath, static_cast<StarSystem*>(0)));
-	if (ret.second) {
-		s = new StarSystem(sysPath);
-		ret.first->second = s;
-		s->IncRefCount(); // the cache owns one reference
-	} else {
-		s = ret.first->second;
+	SystemCacheMap::iterator i = s_cachedSystems.find(sysPath);
+	if (i != s_cachedSystems.end()) {
+		s_systemCacheHits++;
+		s_systemLRU.splice(s_systemLRU.begin(), s_systemLRU, i->second);
+		return RefCountedPtr<StarSystem>(*(i->second));
 	}
-	return RefCountedPtr<StarSystem>(s);
+
+	s_systemCacheMisses++;
+	RefCountedPtr<Sector> sec = Sector::GetCached(sysPath);
+	StarSystem *s = new StarSystem(sysPath, *sec);
+	return AddToCache(s);
 }
 
-void StarSystem::ShrinkCache()
+void StarSystem::RequestBatch(const std::vector<SystemPath> &paths, float priority)
+{
+	if (!s_batchGroup) s_batchGroup = Pi::Jobs()->NewGroup();
+
+	for (std::vector<SystemPath>::const_iterator i = paths.begin(); i != paths.end(); ++i) {
+		const SystemPath sysPath(i->SystemOnly());
+		if (s_cachedSystems.count(sysPath) || s_pendingSystems.count(sysPath)) continue;
+		s_pendingSystems.insert(sysPath);
+
+		GenerateJob *job = new GenerateJob(sysPath, Sector::GetCached(sysPath));
+		job->SetPriority(priority);
+		job->SetGroup(s_batchGroup);
+		Pi::Jobs()->Queue(job);
+	}
+}
+
+bool StarSystem::IsCached(const SystemPath &path)
 {
-	std::map<SystemPath,StarSystem*>::iterator i = s_cachedSystems.begin();
-	while (i != s_cachedSystems.end()) {
-		StarSystem *s = (*i).second;
+	return s_cachedSystems.count(path.SystemOnly()) > 0;
+}
+
+RefCountedPtr<StarSystem> StarSystem::AddToCache(StarSystem *s)
+{
+	const SystemPath &sysPath = s->GetPath();
+	s->IncRefCount(); // the cache owns one reference
+	// only once the system is referenced: the name generator gets the
+	// bodies pushed to Lua, and dropping those must not delete the system
+	s->ResolveNames();
+	s_systemLRU.push_front(s);
+	s_cachedSystems.insert(SystemCacheMap::value_type(sysPath, s_systemLRU.begin()));
+	MemoryStats::Add(MemoryStats::STAR_SYSTEMS, s->GetMemoryUsage());
+
+	SummaryCacheMap::iterator sum = s_cachedSummaries.find(sysPath);
+	if (sum != s_cachedSummaries.end())
+		sum->second.CopyResults(s);
+
+	RefCountedPtr<StarSystem> ret(s);
+	if (s_systemLRU.size() > s_systemCacheTrimAt || MemoryStats::IsOverBudget(MemoryStats::STAR_SYSTEMS))
+		TrimCache(s_systemCacheSize);
+	return ret;
+}
+
+// over the memory budget, unreferenced systems go even if there are fewer
+// than keepUnreferenced
+void StarSystem::TrimCache(size_t keepUnreferenced)
+{
+	size_t unreferenced = 0;
+	for (SystemLRU::const_iterator i = s_systemLRU.begin(); i != s_systemLRU.end(); ++i)
+		if ((*i)->GetRefCount() == 1) unreferenced++;
+
+	SystemLRU::iterator i = s_systemLRU.end();
+	while ((unreferenced > keepUnreferenced || MemoryStats::IsOverBudget(MemoryStats::STAR_SYSTEMS)) &&
+			unreferenced > 0 && i != s_systemLRU.begin()) {
+		--i;
+		StarSystem *s = *i;
 		assert(s->GetRefCount() >= 1); // sanity check
 		// if the cache is the only owner, then delete it
 		if (s->GetRefCount() == 1) {
-			delete s;
-			s_cachedSystems.erase(i++);
+			s_cachedSystems.erase(s->GetPath());
+			i = s_systemLRU.erase(i);
+			MemoryStats::Remove(MemoryStats::STAR_SYSTEMS, s->GetMemoryUsage());
+			s->DecRefCount();
+			unreferenced--;
 		}
+	}
+
+	s_systemCacheTrimAt = s_systemLRU.size() + std::max(s_systemCacheSize/2, size_t(1));
+}
+
+void StarSystem::SetCacheSize(size_t unreferenced)
+{
+	s_systemCacheSize = unreferenced;
+	TrimCache(s_systemCacheSize);
+}
+
+void StarSystem::GetCacheStats(size_t &outSize, Uint32 &outHits, Uint32 &outMisses)
+{
+	outSize = s_systemLRU.size();
+	outHits = s_systemCacheHits;
+	outMisses = s_systemCacheMisses;
+}
+
+void StarSystem::MakeSummary(const SystemPath &path, StarSystemSummary &out)
+{
+	RefCountedPtr<Sector> sec = Sector::GetCached(path);
+	assert(path.systemIndex >= 0 && path.systemIndex < sec->m_systems.size());
+	const Sector::System &sys = sec->m_systems[path.systemIndex];
+
+	out.m_path = path;
+	out.m_name = sec->GetSystemName(path.systemIndex);
+	out.m_faction = sys.faction;
+	out.m_seed = sys.seed;
+
+	// same generator, same first draw as the constructor
+	Uint32 _init[6] = { path.systemIndex, Uint32(path.sectorX), Uint32(path.sectorY), Uint32(path.sectorZ), UNIVERSE_SEED, Uint32(sys.seed) };
+	Random rand(_init, 6);
+	out.m_unexplored = roll_unexplored(path, sys, rand);
+
+	for (int i = 0; i < 4; i++)
+		out.m_starType[i] = sys.starType[i];
+
+	out.m_isCustom = (sys.customSys != 0);
+	if (sys.customSys && !sys.customSys->IsRandom()) {
+		out.m_numStars = sys.customSys->numStars;
+		out.m_primaryType = sys.customSys->sBody->type;
+	} else {
+		out.m_numStars = sys.numStars;
+		out.m_primaryType = sys.numStars == 1 ? sys.starType[0] : SystemBody::TYPE_GRAVPOINT;
+	}
+
+	out.m_complete = false;
+
+	SystemCacheMap::const_iterator full = s_cachedSystems.find(path);
+	if (full != s_cachedSystems.end()) {
+		out.CopyResults(*(full->second));
+		return;
+	}
+
+	// nobody lives in an unexplored system as far as we know (see
+	// SystemBody::PopulateStage1), so everything Populate would work out
+	// is known without the bodies
+	if (out.m_unexplored) {
+		out.m_totalPop = fixed(0);
+		Polit::GetSysPolitStarSystem(path, out.m_faction, sys.customSys ? sys.customSys->govType : Polit::GOV_INVALID, out.m_totalPop, out.m_polit);
+		if (sys.customSys && sys.customSys->shortDesc.length() > 0)
+			out.m_shortDesc = sys.customSys->shortDesc;
 		else
-			i++;
+			out.m_shortDesc = Lang::UNEXPLORED_SYSTEM_NO_DATA;
+		out.m_complete = true;
+	}
+}
+
+StarSystemSummary StarSystem::GetSummary(const SystemPath &path)
+{
+	SystemPath sysPath(path.SystemOnly());
+
+	SummaryCacheMap::iterator i = s_cachedSummaries.find(sysPath);
+	if (i != s_cachedSummaries.end())
+		return i->second;
+
+	if (s_cachedSummaries.size() >= MAX_CACHED_SUMMARIES)
+		s_cachedSummaries.clear();
+
+	StarSystemSummary &sum = s_cachedSummaries[sysPath];
+	MakeSummary(sysPath, sum);
+	return sum;
+}
+
+void StarSystem::ClearSummaries()
+{
+	s_cachedSummaries.clear();
+}
+
+void StarSystemSummary::CopyResults(const StarSystem *s) const
+{
+	m_totalPop = s->GetTotalPop();
+	m_polit = s->GetSysPolit();
+	m_shortDesc = s->m_shortDesc;
+	m_complete = true;
+}
+
+void StarSystemSummary::Complete() const
+{
+	if (m_complete) return;
+	// GetCached fills in the cached copy too
+	RefCountedPtr<StarSystem> s = StarSystem::GetCached(m_path);
+	CopyResults(s.Get());
+}
+
+RefCountedPtr<StarSystem> StarSystemSummary::GetStarSystem() const
+{
+	RefCountedPtr<StarSystem> s = StarSystem::GetCached(m_path);
+	if (!m_complete) CopyResults(s.Get());
+	return s;
+}
+
+void StarSystem::ShrinkCache()
+{
+	if (s_batchGroup) {
+		Pi::Jobs()->CancelGroup(s_batchGroup);
+		s_pendingSystems.clear();
 	}
+	TrimCache(0);
 }
 
 std::string StarSystem::ExportBodyToLua(FILE *f, SystemBody *body) {
@@ -2508,7 +2782,7 @@ void StarSystem::ExportToLua(const char *filename) {
 	fprintf(f,"-- Copyright © 2008-2012 Pioneer Developers. See AUTHORS.txt for details\n");
 	fprintf(f,"-- Licensed under the terms of the GPL v3. See licenses/GPL-3.txt\n\n");
 
-	std::string stars_in_system = GetStarTypes(rootBody.Get());
+	std::string stars_in_system = GetStarTypes(rootBody);
 
 	for(j = 0; ENUM_PolitGovType[j].name != 0; j++) {
 		if(ENUM_PolitGovType[j].value == GetSysPolit().govType)
@@ -2518,16 +2792,16 @@ void StarSystem::ExportToLua(const char *filename) {
 	fprintf(f,"local system = CustomSystem:new('%s', { %s })\n\t:govtype('%s')\n\t:short_desc('%s')\n\t:long_desc([[%s]])\n\n",
 			GetName().c_str(), stars_in_system.c_str(), ENUM_PolitGovType[j].name, GetShortDescription(), GetLongDescription());
 
-	fprintf(f, "system:bodies(%s)\n\n", ExportBodyToLua(f, rootBody.Get()).c_str());
+	fprintf(f, "system:bodies(%s)\n\n", ExportBodyToLua(f, rootBody).c_str());
 
-	Sector sec(GetPath().sectorX, GetPath().sectorY, GetPath().sectorZ);
+	RefCountedPtr<Sector> sec = Sector::GetCached(GetPath());
 	SystemPath pa = GetPath();
 
 	fprintf(f, "system:add_to_sector(%d,%d,%d,v(%.4f,%.4f,%.4f))\n",
 			pa.sectorX, pa.sectorY, pa.sectorZ,
-			sec.m_systems[pa.systemIndex].p.x/Sector::SIZE,
-			sec.m_systems[pa.systemIndex].p.y/Sector::SIZE,
-			sec.m_systems[pa.systemIndex].p.z/Sector::SIZE);
+			sec->m_systems[pa.systemIndex].p.x/Sector::SIZE,
+			sec->m_systems[pa.systemIndex].p.y/Sector::SIZE,
+			sec->m_systems[pa.systemIndex].p.z/Sector::SIZE);
 
 	fclose(f);
 }
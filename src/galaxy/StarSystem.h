@@ -30,6 +30,7 @@ enum EconType { // <enum name=EconType prefix=ECON_ public>
 
 class StarSystem;
 class Faction;
+class Sector;
 
 struct RingStyle {
 	// note: radius values are given as proportions of the planet radius
@@ -44,8 +45,15 @@ public:
 	SystemBody();
 	void PickPlanetType(Random &rand);
 	const SystemBody *FindStarAndTrueOrbitalRange(fixed &orbMin, fixed &orbMax);
-	SystemBody *parent;                // these are only valid if the StarSystem
-	std::vector<SystemBody*> children; // that create them still exists
+	SystemBody *parent;
+	std::vector<SystemBody*> children;
+
+	// a body made by a StarSystem lives in its body blocks, so a reference
+	// to the body is a reference to the system. bodies made on their own
+	// (terrainbench) count for themselves
+	void IncRefCount();
+	void DecRefCount();
+	int GetRefCount() const;
 
 	enum BodyType { // <enum scope='SystemBody' prefix=TYPE_ public>
 		TYPE_GRAVPOINT = 0,
@@ -206,16 +214,90 @@ public:
 	const char *heightMapFilename;
 	unsigned int heightMapFractal;
 private:
+	friend class StarSystem;
+
+	StarSystem *m_system;
 	Color m_atmosColor;
 	double m_atmosDensity;
 };
 
+// what can be said about a system without generating its bodies: straight
+// off its sector entry, plus the explored roll that starts the system's
+// generator. the values are the ones the full StarSystem ends up with.
+//
+// population, government and the short description come out of the body
+// tree, except in unexplored systems where there's nothing to count. asking
+// for them in an explored system builds the full StarSystem once and keeps
+// the answers, so the next summary of that system doesn't need it
+class StarSystemSummary {
+public:
+	const SystemPath &GetPath() const { return m_path; }
+	const std::string &GetName() const { return m_name; }
+	Faction* GetFaction() const { return m_faction; }
+	int GetNumStars() const { return m_numStars; }
+	SystemBody::BodyType GetStarType(int i) const { assert(i >= 0 && i < 4); return m_starType[i]; }
+	// type of the root body. a gravpoint for multiple star systems
+	SystemBody::BodyType GetPrimaryType() const { return m_primaryType; }
+	bool GetUnexplored() const { return m_unexplored; }
+	bool IsCustom() const { return m_isCustom; }
+	int GetSeed() const { return m_seed; }
+
+	// true if the values below are already known
+	bool IsComplete() const { return m_complete; }
+	fixed GetTotalPop() const { Complete(); return m_totalPop; }
+	const SysPolit &GetSysPolit() const { Complete(); return m_polit; }
+	const std::string &GetShortDescription() const { Complete(); return m_shortDesc; }
+
+	// promote to the full system
+	RefCountedPtr<StarSystem> GetStarSystem() const;
+
+private:
+	friend class StarSystem;
+
+	void Complete() const;
+	void CopyResults(const StarSystem *s) const;
+
+	SystemPath m_path;
+	std::string m_name;
+	Faction* m_faction;
+	int m_numStars;
+	SystemBody::BodyType m_starType[4];
+	SystemBody::BodyType m_primaryType;
+	bool m_unexplored;
+	bool m_isCustom;
+	int m_seed;
+
+	mutable bool m_complete;
+	mutable fixed m_totalPop;
+	mutable SysPolit m_polit;
+	mutable std::string m_shortDesc;
+};
+
 class StarSystem : public RefCounted {
 public:
 	friend class SystemBody;
+	friend class StarSystemSummary;
 
+	// systems nothing else holds stay in the cache, least recently used go
+	// first. ShrinkCache lets go of all of them
 	static RefCountedPtr<StarSystem> GetCached(const SystemPath &path);
 	static void ShrinkCache();
+	static void SetCacheSize(size_t unreferenced);
+	static void GetCacheStats(size_t &outSize, Uint32 &outHits, Uint32 &outMisses);
+
+	// generate the systems that aren't cached yet on the job queue, and put
+	// them in the cache as they finish. they come out the same as GetCached
+	// would have made them, whatever order the jobs run in. ShrinkCache
+	// drops any that haven't finished
+	static void RequestBatch(const std::vector<SystemPath> &paths, float priority);
+	// whether GetCached would find the system without making it
+	static bool IsCached(const SystemPath &path);
+
+	// summaries are cached on their own and outlive the systems. they're
+	// only dropped by ClearSummaries, which must follow anything that changes
+	// the sectors or the factions
+	static StarSystemSummary GetSummary(const SystemPath &path);
+	static void ClearSummaries();
 	void ExportToLua(const char *filename);
 
 	const std::string &GetName() const { return m_name; }
@@ -236,14 +318,17 @@ public:
 	static float starScale[];
 	static fixed starMetallicities[];
 
-	RefCountedPtr<SystemBody> rootBody;
+	SystemBody *rootBody;
 	std::vector<SystemBody*> m_spaceStations;
-	// index into this will be the SystemBody ID used by SystemPath
-	std::vector< RefCountedPtr<SystemBody> > m_bodies;
+	// index into this will be the SystemBody ID used by SystemPath. in the
+	// order they were made, which is also their order in m_bodyBlocks
+	std::vector<SystemBody*> m_bodies;
 
 	int GetCommodityBasePriceModPercent(int t) {
 		return m_tradeLevel[t];
 	}
+	// worked out by Polit::IsCommodityLegal when the system is populated
+	bool IsCommodityLegal(Equip::Type t) const { return m_commodityLegal[t]; }
 
 	Faction* GetFaction() const  { return m_faction; }
 	bool GetUnexplored() const { return m_unexplored; }
@@ -257,16 +342,15 @@ public:
 	fixed GetTotalPop() const { return m_totalPop; }
 
 private:
-	StarSystem(const SystemPath &path);
+	class GenerateJob;
+
+	// only reads the sector, the faction and custom system tables, so it can
+	// run off the main thread. the names from the Lua name generator are left
+	// for ResolveNames
+	StarSystem(const SystemPath &path, const Sector &sector);
 	~StarSystem();
 
-	SystemBody *NewBody() {
-		SystemBody *body = new SystemBody;
-		body->path = m_path;
-		body->path.bodyIndex = m_bodies.size();
-		m_bodies.push_back(RefCountedPtr<SystemBody>(body));
-		return body;
-	}
+	SystemBody *NewBody();
 	void MakeShortDescription(Random &rand);
 	void MakePlanetsAround(SystemBody *primary, Random &rand);
 	void MakeRandomStar(SystemBody *sbody, Random &rand);
@@ -275,9 +359,31 @@ private:
 	void MakeBinaryPair(SystemBody *a, SystemBody *b, fixed minDist, Random &rand);
 	void CustomGetKidsOf(SystemBody *parent, const std::vector<CustomSystemBody*> &children, int *outHumanInfestedness, Random &rand);
 	void GenerateFromCustom(const CustomSystem *, Random &rand);
-	void Populate(bool addSpaceStations);
+	void Populate(bool addSpaceStations, Polit::GovType customGovType);
+	void ResolveNames();
 	std::string ExportBodyToLua(FILE *f, SystemBody *body);
 	std::string GetStarTypes(SystemBody *body);
+	static void MakeSummary(const SystemPath &path, StarSystemSummary &out);
+	static RefCountedPtr<StarSystem> AddToCache(StarSystem *s);
+	static void TrimCache(size_t keepUnreferenced);
+	// roughly, what the cache is charged for holding it
+	size_t GetMemoryUsage() const;
+
+	// bodies waiting for a name from Lua, in the order generation asked for
+	// them. stations have to get a name no other station has
+	struct PendingName {
+		PendingName(SystemBody *b, const RefCountedPtr<Random> &r, bool u) : body(b), namerand(r), unique(u) {}
+		SystemBody *body;
+		RefCountedPtr<Random> namerand;
+		bool unique;
+	};
+	std::vector<PendingName> m_pendingNames;
+
+	// raw storage for BODY_BLOCK_SIZE bodies each, filled in order by
+	// NewBody. one allocation per block instead of one per body, and a
+	// system's bodies end up next to each other
+	enum { BODY_BLOCK_SIZE = 16 };
+	std::vector<void*> m_bodyBlocks;
 
 	SystemPath m_path;
 	int m_numStars;
@@ -297,10 +403,28 @@ private:
 
 	// percent price alteration
 	int m_tradeLevel[Equip::TYPE_MAX];
+	bool m_commodityLegal[Equip::TYPE_MAX];
 
 	fixed m_agricultural;
 	fixed m_humanProx;
 	fixed m_totalPop;
 };
 
+inline void SystemBody::IncRefCount()
+{
+	if (m_system) m_system->IncRefCount();
+	else RefCounted::IncRefCount();
+}
+
+inline void SystemBody::DecRefCount()
+{
+	if (m_system) m_system->DecRefCount();
+	else RefCounted::DecRefCount();
+}
+
+inline int SystemBody::GetRefCount() const
+{
+	return m_system ? m_system->GetRefCount() : RefCounted::GetRefCount();
+}
+
 #endif /* _STARSYSTEM_H */
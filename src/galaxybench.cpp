@@ -0,0 +1,205 @@
+// Copyright © 2008-2013 Pioneer Developers. See AUTHORS.txt for details
+// Licensed under the terms of the GPL v3. See licenses/GPL-3.txt
+
+// times the galaxy code: generating a cube of sectors, generating whole star
+// systems, nearby system queries the way StarSystem:GetNearbySystems makes
+// them, and how well the star system cache does for a player wandering from
+// system to system. everything is picked from the seed, so runs with the
+// same seed do the same work
+//
+// galaxybench [-seed n] [-radius sectors] [-systems n] [-queries n] [-jumps n]
+
+#include "libs.h"
+#include "Pi.h"
+#include "OS.h"
+#include "galaxy/Sector.h"
+#include "galaxy/SectorDatabase.h"
+#include "galaxy/GalaxyIndex.h"
+#include "galaxy/StarSystem.h"
+
+// how far StarSystem:GetNearbySystems is usually asked to look
+static const double QUERY_RANGE = 20.0;
+// how far the player can jump in the cache test
+static const double JUMP_RANGE = 10.0;
+static const size_t CACHE_SIZES[] = { 0, 64, 256, 1024 };
+
+static double seconds_since(Uint64 start)
+{
+	return double(OS::HFTimer() - start) / double(OS::HFTimerFreq());
+}
+
+// every sector in the cube, made from scratch the way the sector cache makes
+// them. returns the paths of all their systems
+static void bench_sectors(int radius, std::vector<SystemPath> &paths)
+{
+	int numSectors = 0, numSystems = 0;
+	const Uint64 start = OS::HFTimer();
+	for (int x = -radius; x <= radius; x++) {
+		for (int y = -radius; y <= radius; y++) {
+			for (int z = -radius; z <= radius; z++) {
+				Sector sec(x, y, z);
+				sec.AssignFactions();
+				numSectors++;
+				numSystems += sec.m_systems.size();
+				for (unsigned int i = 0; i < sec.m_systems.size(); i++)
+					paths.push_back(SystemPath(x, y, z, i));
+			}
+		}
+	}
+	const double elapsed = seconds_since(start);
+
+	printf("  %d sectors, %d systems: %.3f s, %.1f us per sector\n",
+		numSectors, numSystems, elapsed, elapsed * 1e6 / double(numSectors));
+}
+
+static void bench_systems(const std::vector<SystemPath> &sample)
+{
+	// nothing may be cached, or it wouldn't be generated
+	StarSystem::SetCacheSize(0);
+	StarSystem::ShrinkCache();
+
+	int numBodies = 0;
+	const Uint64 start = OS::HFTimer();
+	for (std::vector<SystemPath>::const_iterator it = sample.begin(); it != sample.end(); ++it) {
+		RefCountedPtr<StarSystem> sys = StarSystem::GetCached(*it);
+		numBodies += sys->m_bodies.size();
+	}
+	const double elapsed = seconds_since(start);
+
+	printf("  %d systems, %d bodies: %.3f s, %.1f us per system\n",
+		int(sample.size()), numBodies, elapsed, elapsed * 1e6 / double(sample.size()));
+}
+
+// as l_starsystem_get_nearby_systems, without the Lua
+static int nearby_systems(const SystemPath &centre, double range)
+{
+	std::vector<GalaxyIndex::Result> nearby;
+	GalaxyIndex::GetSystemsInRange(centre, range, nearby);
+	for (std::vector<GalaxyIndex::Result>::const_iterator i = nearby.begin(); i != nearby.end(); ++i)
+		RefCountedPtr<StarSystem> sys = StarSystem::GetCached(i->path);
+	return nearby.size();
+}
+
+static void bench_queries(const char *label, const std::vector<SystemPath> &centres)
+{
+	int numFound = 0;
+	const Uint64 start = OS::HFTimer();
+	for (std::vector<SystemPath>::const_iterator it = centres.begin(); it != centres.end(); ++it)
+		numFound += nearby_systems(*it, QUERY_RANGE);
+	const double elapsed = seconds_since(start);
+
+	printf("  %-5s %d queries, %.1f systems each: %.3f s, %.1f us per query\n",
+		label, int(centres.size()), double(numFound) / double(centres.size()),
+		elapsed, elapsed * 1e6 / double(centres.size()));
+}
+
+// the player jumps to a random system in range, and the sector view and
+// the scripts look at everything around it each time
+static void bench_cache(Uint32 seed, const SystemPath &from, int jumps)
+{
+	for (unsigned int c = 0; c < COUNTOF(CACHE_SIZES); c++) {
+		StarSystem::SetCacheSize(CACHE_SIZES[c]);
+		StarSystem::ShrinkCache();
+
+		size_t size;
+		Uint32 hits0, misses0;
+		StarSystem::GetCacheStats(size, hits0, misses0);
+
+		Random rng(seed);
+		SystemPath here = from;
+		const Uint64 start = OS::HFTimer();
+		for (int i = 0; i < jumps; i++) {
+			nearby_systems(here, QUERY_RANGE);
+
+			std::vector<GalaxyIndex::Result> reachable;
+			GalaxyIndex::GetSystemsInRange(here, JUMP_RANGE, reachable);
+			if (!reachable.empty())
+				here = reachable[rng.Int32(reachable.size())].path;
+		}
+		const double elapsed = seconds_since(start);
+
+		Uint32 hits, misses;
+		StarSystem::GetCacheStats(size, hits, misses);
+		hits -= hits0;
+		misses -= misses0;
+		printf("  cache %4d: %d hits, %d misses, %.1f%% hit rate, %.3f s\n",
+			int(CACHE_SIZES[c]), hits, misses, 100.0 * double(hits) / double(std::max(hits + misses, Uint32(1))), elapsed);
+	}
+}
+
+int main(int argc, char **argv)
+{
+	Uint32 seed = 0;
+	int radius = 4;
+	int numSystems = 200;
+	int numQueries = 200;
+	int numJumps = 200;
+
+	for (int i = 1; i < argc; i++) {
+		const std::string arg(argv[i]);
+		if (i+1 >= argc) {
+			fprintf(stderr, "usage: galaxybench [-seed n] [-radius sectors] [-systems n] [-queries n] [-jumps n]\n");
+			return 1;
+		}
+		const int value = atoi(argv[++i]);
+		if (arg == "-seed") seed = value;
+		else if (arg == "-radius") radius = std::max(0, value);
+		else if (arg == "-systems") numSystems = std::max(1, value);
+		else if (arg == "-queries") numQueries = std::max(1, value);
+		else if (arg == "-jumps") numJumps = std::max(1, value);
+		else {
+			fprintf(stderr, "galaxybench: unknown option %s\n", arg.c_str());
+			return 1;
+		}
+	}
+
+	// the factions and custom systems need the main Lua state, and
+	// generated systems need them
+	Pi::Init();
+
+	std::vector<SystemPath> paths;
+
+	printf("sectors, generated:\n");
+	SectorDatabase::Uninit();
+	paths.clear();
+	bench_sectors(radius, paths);
+
+	printf("sectors, from the database if it's on:\n");
+	SectorDatabase::Init(Pi::config->Int("SectorDatabase") != 0);
+	paths.clear();
+	bench_sectors(radius, paths);
+
+	if (paths.empty()) {
+		fprintf(stderr, "galaxybench: no systems in range\n");
+		Pi::Quit();
+	}
+
+	Random rng(seed);
+	std::vector<SystemPath> sample;
+	for (int i = 0; i < numSystems; i++)
+		sample.push_back(paths[rng.Int32(paths.size())]);
+	std::vector<SystemPath> centres;
+	for (int i = 0; i < numQueries; i++)
+		centres.push_back(paths[rng.Int32(paths.size())]);
+	const SystemPath walkStart = paths[rng.Int32(paths.size())];
+
+	printf("star systems:\n");
+	bench_systems(sample);
+
+	printf("nearby systems, %.0f ly:\n", QUERY_RANGE);
+	const int cacheSize = std::max(Pi::config->Int("StarSystemCacheSize"), 0);
+	StarSystem::SetCacheSize(cacheSize);
+	StarSystem::ShrinkCache();
+	GalaxyIndex::Clear();
+	bench_queries("cold", centres);
+	bench_queries("warm", centres);
+
+	printf("star system cache, %d jumps of up to %.0f ly:\n", numJumps, JUMP_RANGE);
+	bench_cache(seed, walkStart, numJumps);
+
+	StarSystem::SetCacheSize(cacheSize);
+	StarSystem::ShrinkCache();
+
+	Pi::Quit();
+	return 0;
+}
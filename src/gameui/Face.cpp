@@ -5,6 +5,7 @@
 #include "FileSystem.h"
 #include "SDLWrappers.h"
 #include "graphics/TextureBuilder.h"
+#include <list>
 
 using namespace UI;
 
@@ -28,11 +29,39 @@ static const Uint32 MAX_ACCESSORIES = 16;
 
 static const Uint32 MAX_BACKGROUND = 18;
 
+// the part images and the finished portraits are kept, most recently used
+// first, so flipping back and forth through adverts doesn't decode and
+// composite the same faces over and over. parts are shared between a lot
+// of faces (the backgrounds and clothes especially)
+static const size_t MAX_CACHED_PARTS = 64;
+static const size_t MAX_CACHED_FACES = 32;
+
+typedef std::list< std::pair<std::string, SDLSurfacePtr> > PartCache;
+typedef std::list< std::pair<Uint64, RefCountedPtr<Graphics::Texture> > > FaceCache;
+static PartCache s_partCache;
+static FaceCache s_faceCache;
+
 RefCountedPtr<Graphics::Material> Face::s_material;
 
+// a part that couldn't be loaded is remembered as missing too
+static SDLSurfacePtr _load_part(const char *filename)
+{
+	for (PartCache::iterator i = s_partCache.begin(); i != s_partCache.end(); ++i) {
+		if (i->first == filename) {
+			s_partCache.splice(s_partCache.begin(), s_partCache, i);
+			return i->second;
+		}
+	}
+
+	s_partCache.push_front(std::make_pair(std::string(filename), LoadSurfaceFromFile(filename)));
+	if (s_partCache.size() > MAX_CACHED_PARTS)
+		s_partCache.pop_back();
+	return s_partCache.front().second;
+}
+
 static void _blit_image(SDL_Surface *s, const char *filename, int xoff, int yoff)
 {
-	SDLSurfacePtr is = LoadSurfaceFromFile(filename);
+	SDLSurfacePtr is = _load_part(filename);
 	// XXX what should this do if the image couldn't be loaded?
 	if (! is) { return; }
 
@@ -55,6 +84,21 @@ Face::Face(Context *context, Uint32 flags, Uint32 seed) : Single(context)
 	m_flags = flags;
 	m_seed = seed;
 
+	if (!s_material) {
+		Graphics::MaterialDescriptor matDesc;
+		matDesc.textures = 1;
+		s_material.Reset(GetContext()->GetRenderer()->CreateMaterial(matDesc));
+	}
+
+	const Uint64 key = (Uint64(flags) << 32) | seed;
+	for (FaceCache::iterator i = s_faceCache.begin(); i != s_faceCache.end(); ++i) {
+		if (i->first == key) {
+			s_faceCache.splice(s_faceCache.begin(), s_faceCache, i);
+			m_texture = i->second;
+			return;
+		}
+	}
+
 	int race = rand.Int32(0,2);
 
 	int gender;
@@ -123,11 +167,9 @@ Face::Face(Context *context, Uint32 flags, Uint32 seed) : Single(context)
 
 	m_texture.Reset(Graphics::TextureBuilder(faceim, Graphics::LINEAR_CLAMP, true, true).CreateTexture(GetContext()->GetRenderer()));
 
-	if (!s_material) {
-		Graphics::MaterialDescriptor matDesc;
-		matDesc.textures = 1;
-		s_material.Reset(GetContext()->GetRenderer()->CreateMaterial(matDesc));
-	}
+	s_faceCache.push_front(std::make_pair(key, m_texture));
+	if (s_faceCache.size() > MAX_CACHED_FACES)
+		s_faceCache.pop_back();
 }
 
 void Face::Layout()
@@ -17,6 +17,7 @@ public:
 	virtual UI::Point PreferredSize() { return UI::Point(INT_MAX); }
 	virtual void Layout();
 	virtual void Draw();
+	virtual bool CanBatchDraw() const { return false; }
 
 	enum Flags { // <enum scope='GameUI::Face' name=GameUIFaceFlags public>
 		RAND        = 0,
@@ -33,7 +34,8 @@ private:
 
 	static RefCountedPtr<Graphics::Material> s_material;
 
-	ScopedPtr<Graphics::Texture> m_texture;
+	// shared with other faces of the same seed and flags
+	RefCountedPtr<Graphics::Texture> m_texture;
 };
 
 }
@@ -38,7 +38,20 @@ Disk::Disk(RefCountedPtr<Material> material, const int numEdges/*=72*/, const fl
 
 void Disk::Draw(Renderer *r)
 {
-	r->DrawTriangles(m_vertices.Get(), m_material.Get(), TRIANGLE_FAN);
+	if (!m_vertexBuffer.Valid()) {
+		VertexBufferDesc desc;
+		desc.attribs = ATTRIB_POSITION;
+		desc.numVertices = m_vertices->GetNumVerts();
+		desc.usage = BUFFER_USAGE_STATIC;
+		m_vertexBuffer.Reset(r->CreateVertexBuffer(desc));
+		if (m_vertexBuffer.Valid())
+			m_vertexBuffer->Populate(*m_vertices);
+	}
+
+	if (m_vertexBuffer.Valid())
+		r->DrawBuffer(m_vertexBuffer.Get(), m_material.Get(), TRIANGLE_FAN);
+	else
+		r->DrawTriangles(m_vertices.Get(), m_material.Get(), TRIANGLE_FAN);
 }
 
 void Disk::SetColor(const Color4f &c)
@@ -127,7 +140,26 @@ Sphere3D::Sphere3D(RefCountedPtr<Material> mat, int subdivs, float scale)
 
 void Sphere3D::Draw(Renderer *r)
 {
-	r->DrawSurface(m_surface.Get());
+	if (!m_vertexBuffer.Valid()) {
+		VertexBufferDesc desc;
+		desc.attribs = ATTRIB_POSITION | ATTRIB_NORMAL | ATTRIB_UV0;
+		desc.numVertices = m_surface->GetNumVerts();
+		desc.usage = BUFFER_USAGE_STATIC;
+		m_vertexBuffer.Reset(r->CreateVertexBuffer(desc));
+		m_indexBuffer.Reset(r->CreateIndexBuffer(m_surface->GetNumIndices(), BUFFER_USAGE_STATIC));
+		if (m_vertexBuffer.Valid() && m_indexBuffer.Valid()) {
+			m_vertexBuffer->Populate(*m_surface->GetVertices());
+			m_indexBuffer->Populate(m_surface->GetIndices());
+		} else {
+			m_vertexBuffer.Reset(0);
+			m_indexBuffer.Reset(0);
+		}
+	}
+
+	if (m_vertexBuffer.Valid())
+		r->DrawBufferIndexed(m_vertexBuffer.Get(), m_indexBuffer.Get(), m_surface->GetMaterial().Get());
+	else
+		r->DrawSurface(m_surface.Get());
 }
 
 int Sphere3D::AddVertex(const vector3f &v, const vector3f &n)
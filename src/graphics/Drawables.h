@@ -8,6 +8,7 @@
 #include "graphics/Renderer.h"
 #include "graphics/Surface.h"
 #include "graphics/VertexArray.h"
+#include "graphics/VertexBuffer.h"
 
 namespace Graphics {
 
@@ -59,6 +60,7 @@ public:
 
 private:
 	ScopedPtr<Graphics::VertexArray> m_vertices;
+	RefCountedPtr<VertexBuffer> m_vertexBuffer; //made on the first draw
 	RefCountedPtr<Material> m_material;
 };
 
@@ -87,9 +89,13 @@ public:
 	virtual void Draw(Renderer *r);
 
 	RefCountedPtr<Material> GetMaterial() const { return m_surface->GetMaterial(); }
+	const Surface *GetSurface() const { return m_surface.Get(); }
 
 private:
 	ScopedPtr<Surface> m_surface;
+	//copied over from the surface on the first draw
+	RefCountedPtr<VertexBuffer> m_vertexBuffer;
+	RefCountedPtr<IndexBuffer> m_indexBuffer;
 	//add a new vertex, return the index
 	int AddVertex(const vector3f &v, const vector3f &n);
 	//add three vertex indices to form a triangle
@@ -4,6 +4,11 @@
 #include "Frustum.h"
 #include "Graphics.h"
 
+#if defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+#define FRUSTUM_USE_SSE
+#include <xmmintrin.h>
+#endif
+
 namespace Graphics {
 
 // min/max FOV in degrees
@@ -103,6 +108,64 @@ bool Frustum::TestPointInfinite(const vector3d &p, double radius) const
 	return true;
 }
 
+void Frustum::TestSpheres(const SphereBatch &spheres, std::vector<Uint8> &visible) const
+{
+	TestSpheres(spheres, 6, visible);
+}
+
+void Frustum::TestSpheresInfinite(const SphereBatch &spheres, std::vector<Uint8> &visible) const
+{
+	// the far plane is last
+	TestSpheres(spheres, 5, visible);
+}
+
+void Frustum::TestSpheres(const SphereBatch &spheres, int numPlanes, std::vector<Uint8> &visible) const
+{
+	const Uint32 count = spheres.Size();
+	visible.resize(count);
+	if (!count) return;
+
+	float a[6], b[6], c[6], d[6];
+	for (int i=0; i<numPlanes; i++) {
+		a[i] = float(m_planes[i].a);
+		b[i] = float(m_planes[i].b);
+		c[i] = float(m_planes[i].c);
+		d[i] = float(m_planes[i].d);
+	}
+
+	const float *x = &spheres.x[0], *y = &spheres.y[0], *z = &spheres.z[0], *r = &spheres.radius[0];
+	Uint32 n = 0;
+
+#ifdef FRUSTUM_USE_SSE
+	// four spheres against one plane at a time. a sphere is out if it's
+	// behind any plane
+	const __m128 zero = _mm_setzero_ps();
+	for (; n + 4 <= count; n += 4) {
+		const __m128 px = _mm_loadu_ps(x+n), py = _mm_loadu_ps(y+n), pz = _mm_loadu_ps(z+n), pr = _mm_loadu_ps(r+n);
+		__m128 out = zero;
+		for (int i=0; i<numPlanes; i++) {
+			__m128 dist = _mm_add_ps(_mm_mul_ps(px, _mm_set1_ps(a[i])), _mm_mul_ps(py, _mm_set1_ps(b[i])));
+			dist = _mm_add_ps(dist, _mm_mul_ps(pz, _mm_set1_ps(c[i])));
+			dist = _mm_add_ps(dist, _mm_add_ps(_mm_set1_ps(d[i]), pr));
+			out = _mm_or_ps(out, _mm_cmplt_ps(dist, zero));
+		}
+		const int mask = _mm_movemask_ps(out);
+		visible[n]   = !(mask & 1);
+		visible[n+1] = !(mask & 2);
+		visible[n+2] = !(mask & 4);
+		visible[n+3] = !(mask & 8);
+	}
+#endif
+
+	// the same sums for what's left
+	for (; n < count; n++) {
+		bool in = true;
+		for (int i=0; i<numPlanes && in; i++)
+			in = (x[n]*a[i] + y[n]*b[i]) + z[n]*c[i] + (d[i] + r[n]) >= 0.0f;
+		visible[n] = in;
+	}
+}
+
 bool Frustum::ProjectPoint(const vector3d &in, vector3d &out) const
 {
 	// XXX replace glut dependency
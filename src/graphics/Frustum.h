@@ -9,6 +9,21 @@
 
 namespace Graphics {
 
+// bounding spheres packed one array per component, so a frustum can test
+// them four at a time. keep one around and Clear it to reuse the memory
+struct SphereBatch {
+	void Clear() { x.clear(); y.clear(); z.clear(); radius.clear(); }
+	void Add(const vector3d &p, double r) {
+		x.push_back(float(p.x));
+		y.push_back(float(p.y));
+		z.push_back(float(p.z));
+		radius.push_back(float(r));
+	}
+	Uint32 Size() const { return x.size(); }
+
+	std::vector<float> x, y, z, radius;
+};
+
 // Frustum can be used for projecting points (3D to 2D) and testing
 // if a point lies inside the visible area
 // Its' internal projection matrix should, but does not have to, match
@@ -31,6 +46,12 @@ public:
 	// test if point (sphere) is in the frustum, ignoring the far plane
 	bool TestPointInfinite(const vector3d &p, double radius) const;
 
+	// test every sphere in the batch at once. visible gets a flag for each,
+	// in the same order. the sums are done in floats, so the positions
+	// should be near the camera's origin, as view coordinates are
+	void TestSpheres(const SphereBatch &spheres, std::vector<Uint8> &visible) const;
+	void TestSpheresInfinite(const SphereBatch &spheres, std::vector<Uint8> &visible) const;
+
 	// project a point onto the near plane (typically the screen)
 	bool ProjectPoint(const vector3d &in, vector3d &out) const;
 
@@ -41,6 +62,8 @@ private:
 	void InitFromMatrix(const matrix4x4d &m);
 	void InitFromGLState();
 
+	void TestSpheres(const SphereBatch &spheres, int numPlanes, std::vector<Uint8> &visible) const;
+
 	struct Plane {
 		double a, b, c, d;
 		double DistanceToPoint(const vector3d &p) const {
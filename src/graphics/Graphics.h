@@ -19,7 +19,9 @@ namespace Graphics {
 	struct Settings {
 		bool fullscreen;
 		bool shaders;
+		bool shaderBinaryCache;
 		bool useTextureCompression;
+		bool textureCache;
 		int vsync;
 		int requestedSamples;
 		int height;
@@ -24,8 +24,11 @@ MaterialDescriptor::MaterialDescriptor()
 : effect(EFFECT_DEFAULT)
 , alphaTest(false)
 , atmosphere(false)
+, geomorph(false)
 , glowMap(false)
+, instanced(false)
 , lighting(false)
+, packedNormals(false)
 , specularMap(false)
 , twoSided(false)
 , usePatterns(false)
@@ -41,8 +44,11 @@ bool operator==(const MaterialDescriptor &a, const MaterialDescriptor &b)
 		a.effect == b.effect &&
 		a.alphaTest == b.alphaTest &&
 		a.atmosphere == b.atmosphere &&
+		a.geomorph == b.geomorph &&
 		a.glowMap == b.glowMap &&
+		a.instanced == b.instanced &&
 		a.lighting == b.lighting &&
+		a.packedNormals == b.packedNormals &&
 		a.specularMap == b.specularMap &&
 		a.twoSided == b.twoSided &&
 		a.usePatterns == b.usePatterns &&
@@ -43,8 +43,11 @@ public:
 	EffectType effect;
 	bool alphaTest;
 	bool atmosphere;
+	bool geomorph; //geosphere terrain morphs from each patch's parent
 	bool glowMap;
+	bool instanced; //variant taking per-instance transforms, set by rendererGL2
 	bool lighting;
+	bool packedNormals; //geosphere terrain vertices carry their normal in w
 	bool specularMap;
 	bool twoSided;
 	bool usePatterns; //pattern/color system
@@ -0,0 +1,86 @@
+// Copyright © 2008-2013 Pioneer Developers. See AUTHORS.txt for details
+// Licensed under the terms of the GPL v3. See licenses/GPL-3.txt
+
+#include "RenderQueue.h"
+#include "Material.h"
+#include <algorithm>
+#include <cstring>
+
+namespace Graphics {
+
+TextureSet::TextureSet(const Material *m)
+{
+	textures[0] = m->texture0;
+	textures[1] = m->texture1;
+	textures[2] = m->texture2;
+	textures[3] = m->texture3;
+	textures[4] = m->texture4;
+}
+
+void TextureSet::ApplyTo(Material *m) const
+{
+	m->texture0 = textures[0];
+	m->texture1 = textures[1];
+	m->texture2 = textures[2];
+	m->texture3 = textures[3];
+	m->texture4 = textures[4];
+}
+
+bool TextureSet::operator==(const TextureSet &b) const
+{
+	for (int i=0; i<NUM_TEXTURES; i++)
+		if (textures[i] != b.textures[i]) return false;
+	return true;
+}
+
+bool TextureSet::operator<(const TextureSet &b) const
+{
+	for (int i=0; i<NUM_TEXTURES; i++)
+		if (textures[i] != b.textures[i]) return textures[i] < b.textures[i];
+	return false;
+}
+
+struct ItemOrder {
+	bool operator()(const RenderQueue::Item &a, const RenderQueue::Item &b) const {
+		const bool aSolid = (a.blendMode == BLEND_SOLID);
+		const bool bSolid = (b.blendMode == BLEND_SOLID);
+		if (aSolid != bSolid) return aSolid;
+
+		// blended items have to go back to front or they won't look right,
+		// whatever it costs in state changes
+		if (!aSolid) return a.depth > b.depth;
+
+		if (a.program != b.program) return a.program < b.program;
+		if (a.material != b.material) return a.material < b.material;
+		if (a.textures != b.textures) return a.textures < b.textures;
+		if (a.mesh != b.mesh) return a.mesh < b.mesh;
+		if (a.surface != b.surface) return a.surface < b.surface;
+		return a.depth < b.depth;
+	}
+};
+
+unsigned int RenderQueue::AddTransform(const matrix4x4f &m)
+{
+	if (m_transforms.empty() || memcmp(&m_transforms.back()[0], &m[0], sizeof(float)*16) != 0)
+		m_transforms.push_back(m);
+	return m_transforms.size()-1;
+}
+
+void RenderQueue::Sort()
+{
+	std::stable_sort(m_items.begin(), m_items.end(), ItemOrder());
+}
+
+void RenderQueue::Clear()
+{
+	m_items.clear();
+	m_transforms.clear();
+}
+
+void RenderQueue::Swap(RenderQueue &other)
+{
+	m_items.swap(other.m_items);
+	m_transforms.swap(other.m_transforms);
+}
+
+}
@@ -0,0 +1,84 @@
+// Copyright © 2008-2013 Pioneer Developers. See AUTHORS.txt for details
+// Licensed under the terms of the GPL v3. See licenses/GPL-3.txt
+
+#ifndef _RENDERQUEUE_H
+#define _RENDERQUEUE_H
+/*
+ * Static mesh surfaces held back between Renderer::BeginRenderQueue and
+ * EndRenderQueue, so they can be sorted to cut down on state changes before
+ * they're submitted.
+ *
+ * Materials are shared between model instances and get their textures
+ * changed on the fly (patterns, decals), so every item carries the textures
+ * its material had when it was queued and the renderer puts them back when
+ * it draws that item.
+ */
+#include "libs.h"
+#include "Renderer.h"
+#include <vector>
+
+namespace Graphics {
+
+class Material;
+class StaticMesh;
+class Surface;
+class Texture;
+
+struct TextureSet {
+	TextureSet() { for (int i=0; i<NUM_TEXTURES; i++) textures[i] = 0; }
+	explicit TextureSet(const Material *m);
+
+	// put these textures back on the material
+	void ApplyTo(Material *m) const;
+
+	bool operator==(const TextureSet &b) const;
+	bool operator!=(const TextureSet &b) const { return !(*this == b); }
+	bool operator<(const TextureSet &b) const;
+
+	static const int NUM_TEXTURES = 5;
+	Texture *textures[NUM_TEXTURES];
+};
+
+class RenderQueue {
+public:
+	struct Item {
+		StaticMesh *mesh;
+		Surface *surface;
+		Material *material;
+		TextureSet textures;
+		const void *program; //renderer specific, items sharing one sort together
+		BlendMode blendMode;
+		float depth; //distance along the view axis, for ordering
+		unsigned int transform; //index into the transform list
+	};
+
+	typedef std::vector<Item>::const_iterator ItemIterator;
+
+	bool IsEmpty() const { return m_items.empty(); }
+	unsigned int GetNumItems() const { return m_items.size(); }
+
+	// returns the index for items to use. runs of items under the same
+	// transform share one entry
+	unsigned int AddTransform(const matrix4x4f &m);
+	void AddItem(const Item &item) { m_items.push_back(item); }
+
+	// solid items first, grouped by program, material, textures, mesh and
+	// then surface, front to back, so copies of one surface end up in a row. everything blended follows, back to front, and
+	// items at the same depth keep the order they were queued in
+	void Sort();
+
+	ItemIterator ItemsBegin() const { return m_items.begin(); }
+	ItemIterator ItemsEnd() const { return m_items.end(); }
+	const matrix4x4f &GetTransform(unsigned int idx) const { return m_transforms[idx]; }
+
+	void Clear();
+	void Swap(RenderQueue &other);
+
+private:
+	std::vector<Item> m_items;
+	std::vector<matrix4x4f> m_transforms;
+};
+
+}
+
+#endif
@@ -5,6 +5,7 @@
 #define _RENDERER_H
 
 #include "libs.h"
+#include "Stats.h"
 #include <map>
 
 namespace Graphics {
@@ -18,7 +19,6 @@ namespace Graphics {
  * later
  *
  * To Do:
- * Move statistics collection here: fps, number of triangles etc.
  * Screenshot function (at least read framebuffer, write to file elsewhere)
  * The 2D varieties of DrawPoints, DrawLines might have to go - it seemed
  * like a good idea to allow the possibility for optimizing these cases but
@@ -30,8 +30,10 @@ namespace Graphics {
  * XXX 2013-Apr-21: Surface is a bit pointless, and StaticMesh could be more
  * flexible with vertex attributes. Recommendation: replace with CreateVertexBuffer, CreateIndexBuffer
  * type approach and encourage these for most drawing. This will solve the terrain issue as well.
+ * (CreateVertexBuffer/CreateIndexBuffer are in now, see VertexBuffer.h)
  */
 
+class IndexBuffer;
 class Light;
 class Material;
 class MaterialDescriptor;
@@ -41,8 +43,11 @@ class StaticMesh;
 class Surface;
 class Texture;
 class TextureDescriptor;
+class TextureManager;
 class VertexArray;
+class VertexBuffer;
 struct RenderTargetDesc;
+struct VertexBufferDesc;
 
 // first some enums
 enum LineType {
@@ -56,7 +61,8 @@ enum PrimitiveType {
 	TRIANGLES = GL_TRIANGLES,
 	TRIANGLE_STRIP = GL_TRIANGLE_STRIP,
 	TRIANGLE_FAN = GL_TRIANGLE_FAN,
-	POINTS = GL_POINTS
+	POINTS = GL_POINTS,
+	LINES = GL_LINES
 };
 
 enum BlendMode {
@@ -69,6 +75,14 @@ enum BlendMode {
 	BLEND_DEST_ALPHA // XXX maybe crappy name
 };
 
+//how often the contents of a vertex or index buffer are expected
+//to change, so the renderer can pick the best place to keep them
+enum BufferUsage {
+	BUFFER_USAGE_STATIC,  //filled once, drawn many times
+	BUFFER_USAGE_DYNAMIC, //refilled every now and then
+	BUFFER_USAGE_STREAM   //refilled about as often as it's drawn
+};
+
 // Renderer base, functions return false if
 // failed/unsupported
 class Renderer
@@ -131,14 +145,35 @@ public:
 	virtual bool DrawSurface(const Surface *surface) { return false; }
 	//high amount of textured quads for particles etc
 	virtual bool DrawPointSprites(int count, const vector3f *positions, Material *material, float size) { return false; }
+	//the same, each with its own colour and size. the material should use vertex colours
+	virtual bool DrawPointSprites(int count, const vector3f *positions, const Color *colors, const float *sizes, Material *material) { return false; }
 	//complex unchanging geometry that is worthwhile to store in VBOs etc.
 	virtual bool DrawStaticMesh(StaticMesh *thing) { return false; }
+	//the vertices of a buffer, as many as it has been told to draw
+	virtual bool DrawBuffer(VertexBuffer *, Material *, PrimitiveType type=TRIANGLES) { return false; }
+	virtual bool DrawBufferIndexed(VertexBuffer *, IndexBuffer *, Material *, PrimitiveType type=TRIANGLES) { return false; }
+	//the vertices of a buffer as points, like DrawPoints. the material should use vertex colours
+	virtual bool DrawBufferPoints(VertexBuffer *, Material *, float pointSize=1.f) { return false; }
+	//additive, textured triangles that don't write depth: engine glows,
+	//lights. inside a render queue they are gathered up and go out with
+	//one draw per texture when it is submitted. uses position and uv0
+	virtual bool DrawGlow(const VertexArray *vertices, Texture *texture, const Color &color) { return false; }
+
+	//hold static meshes back from here until the matching EndRenderQueue,
+	//then draw them sorted by state. queues nest and the outermost End
+	//submits. any other draw or state change in between submits what has
+	//been queued so far first, so the picture comes out the same
+	virtual bool BeginRenderQueue() { return false; }
+	virtual bool EndRenderQueue() { return false; }
 
 	//creates a unique material based on the descriptor. It will not be deleted automatically.
 	virtual Material *CreateMaterial(const MaterialDescriptor &descriptor) = 0;
 	virtual Texture *CreateTexture(const TextureDescriptor &descriptor) = 0;
 	//returns 0 if unsupported
 	virtual RenderTarget *CreateRenderTarget(const RenderTargetDesc &) { return 0; }
+	//vertex and index storage kept by the renderer. returns 0 if unsupported
+	virtual VertexBuffer *CreateVertexBuffer(const VertexBufferDesc &) { return 0; }
+	virtual IndexBuffer *CreateIndexBuffer(unsigned int size, BufferUsage) { return 0; }
 
 	Texture *GetCachedTexture(const std::string &type, const std::string &name);
 	void AddCachedTexture(const std::string &type, const std::string &name, Texture *texture);
@@ -148,7 +183,16 @@ public:
 	// output human-readable debug info to the given stream
 	virtual bool PrintDebugInfo(std::ostream &out) { return false; }
 
+	// texture memory use and budget, if the renderer keeps track
+	virtual TextureManager *GetTextureManager() { return 0; }
+
+	// what the last complete frame drew and uploaded
+	const Stats &GetStats() const { return Stats::GetLastFrame(); }
+
 	virtual bool ReloadShaders() { return false; }
+	// build the shader programs that were used last time, so they don't
+	// have to be compiled mid-game
+	virtual void PrecompilePrograms() { }
 
 	// take a ticket representing the current renderer state. when the ticket
 	// is deleted, the renderer state is restored
@@ -162,6 +206,17 @@ public:
 		Renderer *m_renderer;
 	};
 
+	// queue static meshes for as long as the ticket exists
+	class QueueTicket {
+	public:
+		QueueTicket(Renderer *r) : m_renderer(r) { m_renderer->BeginRenderQueue(); }
+		virtual ~QueueTicket() { m_renderer->EndRenderQueue(); }
+	private:
+		QueueTicket(const QueueTicket&);
+		QueueTicket &operator=(const QueueTicket&);
+		Renderer *m_renderer;
+	};
+
 protected:
 	int m_width;
 	int m_height;
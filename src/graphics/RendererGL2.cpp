@@ -2,12 +2,14 @@
 // Licensed under the terms of the GPL v3. See licenses/GPL-3.txt
 
 #include "RendererGL2.h"
+#include "FileSystem.h"
 #include "Graphics.h"
 #include "Material.h"
 #include "RendererGLBuffers.h"
 #include "Texture.h"
 #include "TextureGL.h"
 #include "VertexArray.h"
+#include "VertexBufferGL.h"
 #include "gl2/GeoSphereMaterial.h"
 #include "gl2/GL2Material.h"
 #include "gl2/GL2RenderTarget.h"
@@ -29,6 +31,7 @@ RendererGL2::RendererGL2(const Graphics::Settings &vs)
 : RendererLegacy(vs)
 , m_invLogZfarPlus1(0.f)
 , m_activeRenderTarget(0)
+, m_useInstancing(glewIsSupported("GL_ARB_draw_instanced"))
 {
 	//the range is very large due to a "logarithmic z-buffer" trick used
 	//http://outerra.blogspot.com/2009/08/logarithmic-z-buffer.html
@@ -36,6 +39,8 @@ RendererGL2::RendererGL2(const Graphics::Settings &vs)
 	m_minZNear = 0.0001f;
 	m_maxZFar = 10000000.0f;
 
+	GL2::Program::SetBinaryCacheEnabled(vs.shaderBinaryCache);
+
 	MaterialDescriptor desc;
 	flatColorProg = new GL2::MultiProgram(desc);
 	m_programs.push_back(std::make_pair(desc, flatColorProg));
@@ -46,6 +51,7 @@ RendererGL2::RendererGL2(const Graphics::Settings &vs)
 
 RendererGL2::~RendererGL2()
 {
+	SaveProgramList();
 	while (!m_programs.empty()) delete m_programs.back().second, m_programs.pop_back();
 }
 
@@ -58,6 +64,8 @@ bool RendererGL2::BeginFrame()
 
 bool RendererGL2::SetRenderTarget(RenderTarget *rt)
 {
+	FlushRenderQueue();
+	Stats::Add(Stats::STAT_RENDER_TARGET_SWITCHES);
 	if (rt)
 		static_cast<GL2::RenderTarget*>(rt)->Bind();
 	else if (m_activeRenderTarget)
@@ -70,6 +78,8 @@ bool RendererGL2::SetRenderTarget(RenderTarget *rt)
 
 bool RendererGL2::SetPerspectiveProjection(float fov, float aspect, float near, float far)
 {
+	FlushRenderQueue();
+
 	// update values for log-z hack
 	m_invLogZfarPlus1 = 1.0f / (log(far+1.0f)/log(2.0f));
 
@@ -78,21 +88,26 @@ bool RendererGL2::SetPerspectiveProjection(float fov, float aspect, float near,
 
 bool RendererGL2::SetAmbientColor(const Color &c)
 {
+	FlushRenderQueue();
 	m_ambient = c;
 	return true;
 }
 
 bool RendererGL2::DrawLines(int count, const vector3f *v, const Color *c, LineType t)
 {
+	FlushRenderQueue();
 	if (count < 2 || !v) return false;
 
 	vtxColorProg->Use();
 	vtxColorProg->invLogZfarPlus1.Set(m_invLogZfarPlus1);
 	glEnableClientState(GL_VERTEX_ARRAY);
 	glEnableClientState(GL_COLOR_ARRAY);
-	glVertexPointer(3, GL_FLOAT, sizeof(vector3f), v);
-	glColorPointer(4, GL_FLOAT, sizeof(Color), c);
+	glVertexPointer(3, GL_FLOAT, sizeof(vector3f), m_vertexStream->Write(v, count * sizeof(vector3f)));
+	Stats::Add(Stats::STAT_VERTICES_UPLOADED, count);
+	glColorPointer(4, GL_FLOAT, sizeof(Color), m_vertexStream->Write(c, count * sizeof(Color)));
+	m_vertexStream->Unbind();
 	glDrawArrays(t, 0, count);
+	Stats::AddDraw(t, count);
 	glDisableClientState(GL_VERTEX_ARRAY);
 	glDisableClientState(GL_COLOR_ARRAY);
 	vtxColorProg->Unuse();
@@ -102,30 +117,59 @@ bool RendererGL2::DrawLines(int count, const vector3f *v, const Color *c, LineTy
 
 bool RendererGL2::DrawLines(int count, const vector3f *v, const Color &c, LineType t)
 {
+	FlushRenderQueue();
 	if (count < 2 || !v) return false;
 
 	flatColorProg->Use();
 	flatColorProg->diffuse.Set(c);
 	flatColorProg->invLogZfarPlus1.Set(m_invLogZfarPlus1);
 	glEnableClientState(GL_VERTEX_ARRAY);
-	glVertexPointer(3, GL_FLOAT, sizeof(vector3f), v);
+	glVertexPointer(3, GL_FLOAT, sizeof(vector3f), m_vertexStream->Write(v, count * sizeof(vector3f)));
+	Stats::Add(Stats::STAT_VERTICES_UPLOADED, count);
+	m_vertexStream->Unbind();
 	glDrawArrays(t, 0, count);
+	Stats::AddDraw(t, count);
 	glDisableClientState(GL_VERTEX_ARRAY);
 	flatColorProg->Unuse();
 
 	return true;
 }
 
-Material *RendererGL2::CreateMaterial(const MaterialDescriptor &d)
+const void *RendererGL2::GetProgramKey(const Material *m) const
 {
-	MaterialDescriptor desc = d;
+	//a shaderless fallback material has no program
+	const GL2::Material *mat = dynamic_cast<const GL2::Material*>(m);
+	return mat ? mat->m_program : 0;
+}
 
-	GL2::Material *mat = 0;
-	GL2::Program *p = 0;
+bool RendererGL2::CanDrawInstanced(const Material *m) const
+{
+	//only the multi shader knows how
+	return m_useInstancing && dynamic_cast<const GL2::MultiMaterial*>(m) != 0;
+}
 
-	if (desc.lighting) {
-		desc.dirLights = m_numDirLights;
+void RendererGL2::DrawInstanced(MeshVertexBuffer *vbuf, GLenum indexType, PrimitiveType pt, int start, int amount, Material *m, const matrix4x4f *transforms, int count)
+{
+	GL2::MultiMaterial *mat = static_cast<GL2::MultiMaterial*>(m);
+	mat->SetInstanced(true);
+	mat->Apply();
+
+	GL2::MultiProgram *p = mat->GetActiveProgram();
+	vbuf->BeginDraw();
+	for (int i = 0; i < count; i += GL2::MultiProgram::MAX_INSTANCES) {
+		const int n = std::min(count - i, int(GL2::MultiProgram::MAX_INSTANCES));
+		p->instanceTransforms.Set(transforms + i, n);
+		vbuf->DrawElementsInstanced(pt, start, amount, n, indexType);
 	}
+	vbuf->EndDraw();
+
+	mat->Unapply();
+	mat->SetInstanced(false);
+}
+
+GL2::Material *RendererGL2::NewMaterial(const MaterialDescriptor &desc)
+{
+	GL2::Material *mat = 0;
 
 	// Create the material. It will be also used to create the shader,
 	// like a tiny factory
@@ -157,12 +201,27 @@ Material *RendererGL2::CreateMaterial(const MaterialDescriptor &d)
 
 	mat->m_renderer = this;
 	mat->m_descriptor = desc;
+	return mat;
+}
+
+Material *RendererGL2::CreateMaterial(const MaterialDescriptor &d)
+{
+	MaterialDescriptor desc = d;
+
+	GL2::Program *p = 0;
+
+	if (desc.lighting) {
+		desc.dirLights = m_numDirLights;
+	}
+
+	GL2::Material *mat = NewMaterial(desc);
 
 	try {
 		p = GetOrCreateProgram(mat);
 	} catch (GL2::ShaderException &) {
 		// in release builds, the game does not quit instantly but attempts to revert
 		// to a 'shaderless' state
+		delete mat;
 		return RendererLegacy::CreateMaterial(desc);
 	}
 
@@ -238,4 +297,101 @@ GL2::Program* RendererGL2::GetOrCreateProgram(GL2::Material *mat)
 	return p;
 }
 
+// the descriptors of the programs made in a session are kept next to the
+// program binaries, one per line
+static const char PROGRAM_LIST_NAME[] = "programs.txt";
+
+void RendererGL2::PrecompilePrograms()
+{
+	if (!GL2::Program::IsBinaryCacheEnabled()) return;
+
+	FILE *f = FileSystem::userFiles.OpenReadStream(GL2::Program::GetBinaryCachePath(PROGRAM_LIST_NAME));
+	if (!f) return;
+
+	std::vector<MaterialDescriptor> descs;
+	char line[256];
+	while (fgets(line, sizeof(line), f)) {
+		MaterialDescriptor desc;
+		int v[11];
+		if (sscanf(line, "%d %d %d %d %d %d %d %d %d %d %d %u", &v[0], &v[1], &v[2], &v[3], &v[4], &v[5],
+				&v[6], &v[7], &v[8], &v[9], &v[10], &desc.dirLights) != 12)
+			continue;
+		desc.effect = EffectType(v[0]);
+		desc.alphaTest = v[1] != 0;
+		desc.atmosphere = v[2] != 0;
+		desc.glowMap = v[3] != 0;
+		desc.instanced = v[4] != 0;
+		desc.lighting = v[5] != 0;
+		desc.specularMap = v[6] != 0;
+		desc.twoSided = v[7] != 0;
+		desc.usePatterns = v[8] != 0;
+		desc.vertexColors = v[9] != 0;
+		desc.textures = v[10];
+
+		// lit materials switch program whenever the number of lights
+		// changes, so make all of them while at it
+		if (desc.lighting) {
+			for (unsigned int lights = 0; lights <= 4; lights++) {
+				desc.dirLights = lights;
+				descs.push_back(desc);
+			}
+		} else
+			descs.push_back(desc);
+	}
+	fclose(f);
+
+	for (std::vector<MaterialDescriptor>::const_iterator it = descs.begin(); it != descs.end(); ++it) {
+		if ((*it).instanced && !m_useInstancing) continue;
+		GL2::Material *mat = NewMaterial(*it);
+		try {
+			GetOrCreateProgram(mat);
+		} catch (GL2::ShaderException &) {
+			// the material will find out for itself when it's made
+		}
+		delete mat;
+	}
+}
+
+void RendererGL2::SaveProgramList()
+{
+	if (!GL2::Program::IsBinaryCacheEnabled()) return;
+
+	// the light counts all come back together, so lit ones are only listed once
+	std::vector<MaterialDescriptor> descs;
+	for (ProgramIterator it = m_programs.begin(); it != m_programs.end(); ++it) {
+		MaterialDescriptor desc = (*it).first;
+		if (desc.lighting) desc.dirLights = 0;
+		if (std::find(descs.begin(), descs.end(), desc) == descs.end())
+			descs.push_back(desc);
+	}
+
+	FILE *f = FileSystem::userFiles.OpenWriteStream(GL2::Program::GetBinaryCachePath(PROGRAM_LIST_NAME));
+	if (!f) return;
+	for (std::vector<MaterialDescriptor>::const_iterator it = descs.begin(); it != descs.end(); ++it) {
+		const MaterialDescriptor &desc = *it;
+		fprintf(f, "%d %d %d %d %d %d %d %d %d %d %d %u\n", int(desc.effect), int(desc.alphaTest), int(desc.atmosphere),
+			int(desc.glowMap), int(desc.instanced), int(desc.lighting), int(desc.specularMap), int(desc.twoSided),
+			int(desc.usePatterns), int(desc.vertexColors), desc.textures, desc.dirLights);
+	}
+	fclose(f);
+}
+
+GL2::Program* RendererGL2::GetOrCreateInstancedProgram(GL2::Material *mat)
+{
+	//same as the material's own program, but instanced
+	mat->m_descriptor.instanced = true;
+	GL2::Program *p = 0;
+	try {
+		p = GetOrCreateProgram(mat);
+	} catch (GL2::ShaderException &) {
+		//give up on instancing. whatever is being drawn comes out in one
+		//place for this frame
+		m_useInstancing = false;
+		mat->m_descriptor.instanced = false;
+		p = GetOrCreateProgram(mat);
+	}
+	mat->m_descriptor.instanced = false;
+	return p;
+}
+
 }
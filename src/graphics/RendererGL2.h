@@ -51,9 +51,18 @@ public:
 	virtual RenderTarget *CreateRenderTarget(const RenderTargetDesc &);
 
 	virtual bool ReloadShaders();
+	virtual void PrecompilePrograms();
+
+protected:
+	virtual const void *GetProgramKey(const Material *m) const;
+	virtual bool CanDrawInstanced(const Material *m) const;
+	virtual void DrawInstanced(MeshVertexBuffer *vbuf, GLenum indexType, PrimitiveType pt, int start, int amount, Material *m, const matrix4x4f *transforms, int count);
 
 private:
+	GL2::Material *NewMaterial(const MaterialDescriptor &);
 	GL2::Program* GetOrCreateProgram(GL2::Material*);
+	GL2::Program* GetOrCreateInstancedProgram(GL2::Material*);
+	void SaveProgramList();
 	friend class GL2::GeoSphereSurfaceMaterial;
 	friend class GL2::GeoSphereSkyMaterial;
 	friend class GL2::MultiMaterial;
@@ -63,6 +72,7 @@ private:
 	std::vector<std::pair<MaterialDescriptor, GL2::Program*> > m_programs;
 	float m_invLogZfarPlus1;
 	GL2::RenderTarget *m_activeRenderTarget;
+	bool m_useInstancing;
 };
 
 }
@@ -5,6 +5,7 @@
 #define _RENDERER_GL_BUFFERS_H
 
 #include "libs.h"
+#include "Stats.h"
 
 namespace Graphics {
 
@@ -56,6 +57,8 @@ public:
 		glBindBufferARB(m_target, 0);
 	}
 
+	//the first call sizes the store for maxElements of T, so a whole mesh
+	//can go in with one call or piece by piece
 	template<typename T>
 	int BufferData(const int count, const T *v) {
 		//initialise data store on first use
@@ -65,6 +68,9 @@ public:
 		}
 		int current = m_offset;
 		glBufferSubDataARB(m_target, sizeof(T)*m_offset, sizeof(T)*count, v);
+		Stats::Add(Stats::STAT_BUFFER_BYTES_UPLOADED, sizeof(T)*count);
+		if (m_target == GL_ARRAY_BUFFER)
+			Stats::Add(Stats::STAT_VERTICES_UPLOADED, count);
 		m_offset += count;
 		return current;
 	}
@@ -77,21 +83,40 @@ private:
 	unsigned int m_maxSize;
 };
 
-class IndexBuffer : public BufferBase {
+//16-bit indices, or 32-bit for meshes with more vertices than those can reach
+class MeshIndexBuffer : public BufferBase {
 public:
-	IndexBuffer(unsigned int maxElements) :
-		BufferBase(GL_ELEMENT_ARRAY_BUFFER, maxElements)
+	MeshIndexBuffer(unsigned int maxElements, bool wide = false) :
+		BufferBase(GL_ELEMENT_ARRAY_BUFFER, maxElements),
+		m_indexType(wide ? GL_UNSIGNED_INT : GL_UNSIGNED_SHORT)
 	{
 	}
 
 	int BufferIndexData(const int count, const unsigned short *v) {
+		assert(m_indexType == GL_UNSIGNED_SHORT);
 		return BufferData<unsigned short>(count, v);
 	}
+
+	int BufferIndexData(const int count, const Uint32 *v) {
+		assert(m_indexType == GL_UNSIGNED_INT);
+		return BufferData<Uint32>(count, v);
+	}
+
+	GLenum GetIndexType() const { return m_indexType; }
+
+private:
+	GLenum m_indexType;
 };
 
-class VertexBuffer : public BufferBase {
+//byte offset of index number start
+inline const GLvoid *IndexOffset(GLenum indexType, unsigned int start) {
+	const size_t size = indexType == GL_UNSIGNED_INT ? sizeof(GLuint) : sizeof(GLushort);
+	return reinterpret_cast<const GLvoid *>(start*size);
+}
+
+class MeshVertexBuffer : public BufferBase {
 public:
-	VertexBuffer(unsigned int maxElements) :
+	MeshVertexBuffer(unsigned int maxElements) :
 		BufferBase(GL_ARRAY_BUFFER, maxElements)
 	{
 		m_states[0] = GL_VERTEX_ARRAY;
@@ -104,14 +129,43 @@ public:
 		EnableClientStates();
 		SetPointers();
 		glDrawArrays(pt, start, count);
+		Stats::AddDraw(pt, count);
 		DisableClientStates();
 	};
 
-	virtual void DrawIndexed(GLenum pt, unsigned int start, unsigned int count) {
+	virtual void DrawIndexed(GLenum pt, unsigned int start, unsigned int count, GLenum indexType = GL_UNSIGNED_SHORT) {
 		EnableClientStates();
 		SetPointers();
 		//XXX use DrawRangeElements for potential performance boost
-		glDrawElements(pt, count, GL_UNSIGNED_SHORT, reinterpret_cast<const GLvoid *>(start*sizeof(GLushort)));
+		glDrawElements(pt, count, indexType, IndexOffset(indexType, start));
+		Stats::AddDraw(pt, count);
+		DisableClientStates();
+	}
+
+	//for drawing one range many times over: set up once, draw as often
+	//as needed, then finish
+	void BeginDraw() {
+		EnableClientStates();
+		SetPointers();
+	}
+
+	void DrawArrays(GLenum pt, unsigned int start, unsigned int count) {
+		glDrawArrays(pt, start, count);
+		Stats::AddDraw(pt, count);
+	}
+
+	void DrawElements(GLenum pt, unsigned int start, unsigned int count, GLenum indexType = GL_UNSIGNED_SHORT) {
+		glDrawElements(pt, count, indexType, IndexOffset(indexType, start));
+		Stats::AddDraw(pt, count);
+	}
+
+	//needs GL_ARB_draw_instanced
+	void DrawElementsInstanced(GLenum pt, unsigned int start, unsigned int count, int instances, GLenum indexType = GL_UNSIGNED_SHORT) {
+		glDrawElementsInstancedARB(pt, count, indexType, IndexOffset(indexType, start), instances);
+		Stats::AddDraw(pt, count, instances);
+	}
+
+	void EndDraw() {
 		DisableClientStates();
 	}
 
@@ -154,9 +208,9 @@ protected:
 	int m_numstates;
 };
 
-class UnlitVertexBuffer : public VertexBuffer {
+class UnlitMeshVertexBuffer : public MeshVertexBuffer {
 public:
-	UnlitVertexBuffer(unsigned int maxElements) : VertexBuffer(maxElements) {
+	UnlitMeshVertexBuffer(unsigned int maxElements) : MeshVertexBuffer(maxElements) {
 		m_states[0] = GL_VERTEX_ARRAY;
 		m_states[1] = GL_COLOR_ARRAY;
 		m_numstates = 2;
@@ -12,15 +12,23 @@
 #include "StringF.h"
 #include "Surface.h"
 #include "Texture.h"
+#include "TextureCache.h"
 #include "TextureGL.h"
+#include "TextureManager.h"
 #include "VertexArray.h"
+#include "VertexBufferGL.h"
 #include <stddef.h> //for offsetof
 #include <ostream>
 #include <sstream>
 #include <iterator>
+#include <map>
 
 namespace Graphics {
 
+// per-draw vertex and index data is written through these
+static const unsigned int VERTEX_STREAM_SIZE = 4*1024*1024;
+static const unsigned int INDEX_STREAM_SIZE = 512*1024;
+
 struct MeshRenderInfo : public RenderInfo {
 	MeshRenderInfo() :
 		numIndices(0),
@@ -34,8 +42,8 @@ struct MeshRenderInfo : public RenderInfo {
 		delete ibuf;
 	}
 	int numIndices;
-	VertexBuffer *vbuf;
-	IndexBuffer *ibuf;
+	MeshVertexBuffer *vbuf;
+	MeshIndexBuffer *ibuf;
 };
 
 // multiple surfaces can be buffered in one vbo so need to
@@ -52,9 +60,13 @@ RendererLegacy::RendererLegacy(const Graphics::Settings &vs)
 , m_minZNear(10.f)
 , m_maxZFar(1000000.0f)
 , m_useCompressedTextures(false)
+, m_currentBlendMode(BLEND_SOLID)
+, m_renderQueueDepth(0)
+, m_glowsQueued(false)
 {
 	const bool useDXTnTextures = vs.useTextureCompression && glewIsSupported("GL_EXT_texture_compression_s3tc");
 	m_useCompressedTextures = useDXTnTextures;
+	TextureCache::SetEnabled(vs.textureCache && useDXTnTextures);
 
 	glShadeModel(GL_SMOOTH);
 	glCullFace(GL_BACK);
@@ -70,11 +82,24 @@ RendererLegacy::RendererLegacy(const Graphics::Settings &vs)
 
 	SetClearColor(Color(0.f));
 	SetViewport(0, 0, m_width, m_height);
+
+	// whatever was bound before isn't known to the texture binding cache
+	TextureGL::InvalidateBindings();
+
+	m_vertexStream.Reset(new StreamBufferGL(GL_ARRAY_BUFFER_ARB, VERTEX_STREAM_SIZE));
+	m_indexStream.Reset(new StreamBufferGL(GL_ELEMENT_ARRAY_BUFFER_ARB, INDEX_STREAM_SIZE));
+	m_pointSprites.Reset(new VertexArray(ATTRIB_POSITION | ATTRIB_UV0));
+	m_coloredPointSprites.Reset(new VertexArray(ATTRIB_POSITION | ATTRIB_DIFFUSE | ATTRIB_UV0));
+	m_textureManager.Reset(new TextureManager());
 }
 
 RendererLegacy::~RendererLegacy()
 {
+	// while the texture manager is still around
+	RemoveAllCachedTextures();
 
+	for (std::vector<GlowBatch>::iterator it = m_glowBatches.begin(); it != m_glowBatches.end(); ++it)
+		delete it->vertices;
 }
 
 bool RendererLegacy::GetNearFarRange(float &near, float &far) const
@@ -92,6 +117,8 @@ bool RendererLegacy::BeginFrame()
 
 bool RendererLegacy::EndFrame()
 {
+	FlushRenderQueue();
+	m_textureManager->EndFrame();
 	return true;
 }
 
@@ -138,11 +165,13 @@ bool RendererLegacy::SwapBuffers()
 #endif
 
 	SDL_GL_SwapBuffers();
+	Stats::EndFrame();
 	return true;
 }
 
 bool RendererLegacy::ClearScreen()
 {
+	FlushRenderQueue();
 	glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
 	return true;
@@ -150,6 +179,7 @@ bool RendererLegacy::ClearScreen()
 
 bool RendererLegacy::ClearDepthBuffer()
 {
+	FlushRenderQueue();
 	glClear(GL_DEPTH_BUFFER_BIT);
 
 	return true;
@@ -163,6 +193,7 @@ bool RendererLegacy::SetClearColor(const Color &c)
 
 bool RendererLegacy::SetViewport(int x, int y, int width, int height)
 {
+	FlushRenderQueue();
 	glViewport(x, y, width, height);
 	return true;
 }
@@ -191,6 +222,7 @@ bool RendererLegacy::SetTransform(const matrix4x4f &m)
 
 bool RendererLegacy::SetPerspectiveProjection(float fov, float aspect, float near, float far)
 {
+	FlushRenderQueue();
 	Graphics::SetFov(fov);
 
 	double ymax = near * tan(fov * M_PI / 360.0);
@@ -206,6 +238,7 @@ bool RendererLegacy::SetPerspectiveProjection(float fov, float aspect, float nea
 
 bool RendererLegacy::SetOrthographicProjection(float xmin, float xmax, float ymin, float ymax, float zmin, float zmax)
 {
+	FlushRenderQueue();
 	glMatrixMode(GL_PROJECTION);
 	glLoadIdentity();
 	glOrtho(xmin, xmax, ymin, ymax, zmin, zmax);
@@ -214,6 +247,8 @@ bool RendererLegacy::SetOrthographicProjection(float xmin, float xmax, float ymi
 
 bool RendererLegacy::SetBlendMode(BlendMode m)
 {
+	m_currentBlendMode = m;
+	Stats::Add(Stats::STAT_STATE_CHANGES);
 	switch (m) {
 	case BLEND_SOLID:
 		glDisable(GL_BLEND);
@@ -250,6 +285,8 @@ bool RendererLegacy::SetBlendMode(BlendMode m)
 
 bool RendererLegacy::SetDepthTest(bool enabled)
 {
+	FlushRenderQueue();
+	Stats::Add(Stats::STAT_STATE_CHANGES);
 	if (enabled)
 		glEnable(GL_DEPTH_TEST);
 	else
@@ -259,6 +296,8 @@ bool RendererLegacy::SetDepthTest(bool enabled)
 
 bool RendererLegacy::SetDepthWrite(bool enabled)
 {
+	FlushRenderQueue();
+	Stats::Add(Stats::STAT_STATE_CHANGES);
 	if (enabled)
 		glDepthMask(GL_TRUE);
 	else
@@ -268,12 +307,15 @@ bool RendererLegacy::SetDepthWrite(bool enabled)
 
 bool RendererLegacy::SetWireFrameMode(bool enabled)
 {
+	FlushRenderQueue();
+	Stats::Add(Stats::STAT_STATE_CHANGES);
 	glPolygonMode(GL_FRONT_AND_BACK, enabled ? GL_LINE : GL_FILL);
 	return true;
 }
 
 bool RendererLegacy::SetLights(int numlights, const Light *lights)
 {
+	FlushRenderQueue();
 	if (numlights < 1) return false;
 
 	//glLight depends on the current transform, but we have always
@@ -312,6 +354,7 @@ bool RendererLegacy::SetLights(int numlights, const Light *lights)
 
 bool RendererLegacy::SetAmbientColor(const Color &c)
 {
+	FlushRenderQueue();
 	glLightModelfv(GL_LIGHT_MODEL_AMBIENT, c);
 	m_ambient = c;
 	return true;
@@ -319,6 +362,8 @@ bool RendererLegacy::SetAmbientColor(const Color &c)
 
 bool RendererLegacy::SetScissor(bool enabled, const vector2f &pos, const vector2f &size)
 {
+	FlushRenderQueue();
+	Stats::Add(Stats::STAT_STATE_CHANGES);
 	if (enabled) {
 		glScissor(pos.x,pos.y,size.x,size.y);
 		glEnable(GL_SCISSOR_TEST);
@@ -330,6 +375,7 @@ bool RendererLegacy::SetScissor(bool enabled, const vector2f &pos, const vector2
 
 bool RendererLegacy::DrawLines(int count, const vector3f *v, const Color *c, LineType t)
 {
+	FlushRenderQueue();
 	if (count < 2) return false;
 
 	glPushAttrib(GL_LIGHTING_BIT);
@@ -337,9 +383,12 @@ bool RendererLegacy::DrawLines(int count, const vector3f *v, const Color *c, Lin
 
 	glEnableClientState(GL_VERTEX_ARRAY);
 	glEnableClientState(GL_COLOR_ARRAY);
-	glVertexPointer(3, GL_FLOAT, sizeof(vector3f), v);
-	glColorPointer(4, GL_FLOAT, sizeof(Color), c);
+	glVertexPointer(3, GL_FLOAT, sizeof(vector3f), m_vertexStream->Write(v, count * sizeof(vector3f)));
+	Stats::Add(Stats::STAT_VERTICES_UPLOADED, count);
+	glColorPointer(4, GL_FLOAT, sizeof(Color), m_vertexStream->Write(c, count * sizeof(Color)));
+	m_vertexStream->Unbind();
 	glDrawArrays(t, 0, count);
+	Stats::AddDraw(t, count);
 	glDisableClientState(GL_VERTEX_ARRAY);
 	glDisableClientState(GL_COLOR_ARRAY);
 
@@ -350,6 +399,7 @@ bool RendererLegacy::DrawLines(int count, const vector3f *v, const Color *c, Lin
 
 bool RendererLegacy::DrawLines(int count, const vector3f *v, const Color &c, LineType t)
 {
+	FlushRenderQueue();
 	if (count < 2 || !v) return false;
 
 	glPushAttrib(GL_LIGHTING_BIT);
@@ -360,8 +410,11 @@ bool RendererLegacy::DrawLines(int count, const vector3f *v, const Color &c, Lin
 
 	glColor4f(c.r, c.g, c.b, c.a);
 	glEnableClientState(GL_VERTEX_ARRAY);
-	glVertexPointer(3, GL_FLOAT, sizeof(vector3f), v);
+	glVertexPointer(3, GL_FLOAT, sizeof(vector3f), m_vertexStream->Write(v, count * sizeof(vector3f)));
+	Stats::Add(Stats::STAT_VERTICES_UPLOADED, count);
+	m_vertexStream->Unbind();
 	glDrawArrays(t, 0, count);
+	Stats::AddDraw(t, count);
 	glDisableClientState(GL_VERTEX_ARRAY);
 	glColor4f(1.f, 1.f, 1.f, 1.f);
 
@@ -374,6 +427,7 @@ bool RendererLegacy::DrawLines(int count, const vector3f *v, const Color &c, Lin
 
 bool RendererLegacy::DrawLines2D(int count, const vector2f *v, const Color &c, LineType t)
 {
+	FlushRenderQueue();
 	if (count < 2 || !v) return false;
 
 	glPushAttrib(GL_LIGHTING_BIT);
@@ -381,8 +435,11 @@ bool RendererLegacy::DrawLines2D(int count, const vector2f *v, const Color &c, L
 
 	glColor4f(c.r, c.g, c.b, c.a);
 	glEnableClientState(GL_VERTEX_ARRAY);
-	glVertexPointer(2, GL_FLOAT, sizeof(vector2f), v);
+	glVertexPointer(2, GL_FLOAT, sizeof(vector2f), m_vertexStream->Write(v, count * sizeof(vector2f)));
+	Stats::Add(Stats::STAT_VERTICES_UPLOADED, count);
+	m_vertexStream->Unbind();
 	glDrawArrays(t, 0, count);
+	Stats::AddDraw(t, count);
 	glDisableClientState(GL_VERTEX_ARRAY);
 	glColor4f(1.f, 1.f, 1.f, 1.f);
 
@@ -393,6 +450,7 @@ bool RendererLegacy::DrawLines2D(int count, const vector2f *v, const Color &c, L
 
 bool RendererLegacy::DrawPoints(int count, const vector3f *points, const Color *colors, float size)
 {
+	FlushRenderQueue();
 	if (count < 1 || !points || !colors) return false;
 
 	glPushAttrib(GL_LIGHTING_BIT);
@@ -401,9 +459,12 @@ bool RendererLegacy::DrawPoints(int count, const vector3f *points, const Color *
 	glPointSize(size);
 	glEnableClientState(GL_VERTEX_ARRAY);
 	glEnableClientState(GL_COLOR_ARRAY);
-	glVertexPointer(3, GL_FLOAT, 0, points);
-	glColorPointer(4, GL_FLOAT, 0, colors);
+	glVertexPointer(3, GL_FLOAT, 0, m_vertexStream->Write(points, count * sizeof(vector3f)));
+	Stats::Add(Stats::STAT_VERTICES_UPLOADED, count);
+	glColorPointer(4, GL_FLOAT, 0, m_vertexStream->Write(colors, count * sizeof(Color)));
+	m_vertexStream->Unbind();
 	glDrawArrays(GL_POINTS, 0, count);
+	Stats::AddDraw(GL_POINTS, count);
 	glDisableClientState(GL_VERTEX_ARRAY);
 	glDisableClientState(GL_COLOR_ARRAY);
 	glPointSize(1.f); // XXX wont't be necessary
@@ -415,12 +476,14 @@ bool RendererLegacy::DrawPoints(int count, const vector3f *points, const Color *
 
 bool RendererLegacy::DrawTriangles(const VertexArray *v, Material *m, PrimitiveType t)
 {
+	FlushRenderQueue();
 	if (!v || v->position.size() < 3) return false;
 
 	m->Apply();
 	EnableClientStates(v);
 
 	glDrawArrays(t, 0, v->GetNumVerts());
+	Stats::AddDraw(t, v->GetNumVerts());
 
 	m->Unapply();
 	DisableClientStates();
@@ -430,6 +493,7 @@ bool RendererLegacy::DrawTriangles(const VertexArray *v, Material *m, PrimitiveT
 
 bool RendererLegacy::DrawSurface(const Surface *s)
 {
+	FlushRenderQueue();
 	if (!s || !s->GetVertices() || s->GetNumIndices() < 3) return false;
 
 	const Material *m = s->GetMaterial().Get();
@@ -438,7 +502,10 @@ bool RendererLegacy::DrawSurface(const Surface *s)
 	const_cast<Material*>(m)->Apply();
 	EnableClientStates(v);
 
-	glDrawElements(s->GetPrimtiveType(), s->GetNumIndices(), GL_UNSIGNED_SHORT, s->GetIndexPointer());
+	glDrawElements(s->GetPrimtiveType(), s->GetNumIndices(), GL_UNSIGNED_SHORT,
+		m_indexStream->Write(s->GetIndexPointer(), s->GetNumIndices() * sizeof(unsigned short)));
+	Stats::AddDraw(s->GetPrimtiveType(), s->GetNumIndices());
+	m_indexStream->Unbind();
 
 	const_cast<Material*>(m)->Unapply();
 	DisableClientStates();
@@ -448,10 +515,13 @@ bool RendererLegacy::DrawSurface(const Surface *s)
 
 bool RendererLegacy::DrawPointSprites(int count, const vector3f *positions, Material *material, float size)
 {
+	FlushRenderQueue();
 	if (count < 1 || !material || !material->texture0) return false;
 
 	SetDepthWrite(false);
-	VertexArray va(ATTRIB_POSITION | ATTRIB_UV0, count * 6);
+	//kept between calls so its storage only grows now and then
+	VertexArray &va = *m_pointSprites;
+	va.Clear();
 
 	matrix4x4f rot(GetCurrentTransform());
 	rot.ClearToRotOnly();
@@ -484,6 +554,45 @@ bool RendererLegacy::DrawPointSprites(int count, const vector3f *positions, Mate
 	return true;
 }
 
+bool RendererLegacy::DrawPointSprites(int count, const vector3f *positions, const Color *colors, const float *sizes, Material *material)
+{
+	FlushRenderQueue();
+	if (count < 1 || !material || !material->texture0) return false;
+
+	SetDepthWrite(false);
+	VertexArray &va = *m_coloredPointSprites;
+	va.Clear();
+
+	matrix4x4f rot(GetCurrentTransform());
+	rot.ClearToRotOnly();
+	rot = rot.InverseOf();
+
+	//corners of a sprite of size 1, scaled for each
+	const vector3f rotv1 = rot * vector3f(0.5f, 0.5f, 0.0f);
+	const vector3f rotv2 = rot * vector3f(0.5f, -0.5f, 0.0f);
+	const vector3f rotv3 = rot * vector3f(-0.5f, -0.5f, 0.0f);
+	const vector3f rotv4 = rot * vector3f(-0.5f, 0.5f, 0.0f);
+
+	for (int i=0; i<count; i++) {
+		const vector3f &pos = positions[i];
+		const Color &c = colors[i];
+		const float sz = sizes[i];
+
+		va.Add(pos+rotv4*sz, c, vector2f(0.f, 0.f)); //top left
+		va.Add(pos+rotv3*sz, c, vector2f(0.f, 1.f)); //bottom left
+		va.Add(pos+rotv1*sz, c, vector2f(1.f, 0.f)); //top right
+
+		va.Add(pos+rotv1*sz, c, vector2f(1.f, 0.f)); //top right
+		va.Add(pos+rotv3*sz, c, vector2f(0.f, 1.f)); //bottom left
+		va.Add(pos+rotv2*sz, c, vector2f(1.f, 1.f)); //bottom right
+	}
+	DrawTriangles(&va, material);
+	SetBlendMode(BLEND_SOLID);
+	SetDepthWrite(true);
+
+	return true;
+}
+
 bool RendererLegacy::DrawStaticMesh(StaticMesh *t)
 {
 	if (!t) return false;
@@ -501,6 +610,23 @@ bool RendererLegacy::DrawStaticMesh(StaticMesh *t)
 	}
 	MeshRenderInfo *meshInfo = static_cast<MeshRenderInfo*>(t->GetRenderInfo());
 
+	if (m_renderQueueDepth > 0) {
+		RenderQueue::Item item;
+		item.mesh = t;
+		item.blendMode = m_currentBlendMode;
+		//eye space looks down -z
+		item.depth = -m_currentTransform[14];
+		item.transform = m_renderQueue.AddTransform(m_currentTransform);
+		for (StaticMesh::SurfaceIterator surface = t->SurfacesBegin(); surface != t->SurfacesEnd(); ++surface) {
+			item.surface = (*surface).Get();
+			item.material = const_cast<Material*>((*surface)->GetMaterial().Get());
+			item.textures = TextureSet(item.material);
+			item.program = GetProgramKey(item.material);
+			m_renderQueue.AddItem(item);
+		}
+		return true;
+	}
+
 	//draw each surface
 	meshInfo->vbuf->Bind();
 	if (meshInfo->ibuf) {
@@ -512,7 +638,7 @@ bool RendererLegacy::DrawStaticMesh(StaticMesh *t)
 
 		const_cast<Material*>((*surface)->GetMaterial().Get())->Apply();
 		if (meshInfo->ibuf) {
-			meshInfo->vbuf->DrawIndexed(t->GetPrimtiveType(), surfaceInfo->glOffset, surfaceInfo->glAmount);
+			meshInfo->vbuf->DrawIndexed(t->GetPrimtiveType(), surfaceInfo->glOffset, surfaceInfo->glAmount, meshInfo->ibuf->GetIndexType());
 		} else {
 			//draw unindexed per surface
 			meshInfo->vbuf->Draw(t->GetPrimtiveType(), surfaceInfo->glOffset, surfaceInfo->glAmount);
@@ -526,6 +652,250 @@ bool RendererLegacy::DrawStaticMesh(StaticMesh *t)
 	return true;
 }
 
+bool RendererLegacy::DrawBuffer(VertexBuffer *vb, Material *m, PrimitiveType t)
+{
+	FlushRenderQueue();
+	if (!vb || !m || vb->GetVertexCount() == 0) return false;
+
+	VertexBufferGL *buf = static_cast<VertexBufferGL*>(vb);
+
+	m->Apply();
+	buf->Bind();
+
+	glDrawArrays(t, 0, vb->GetVertexCount());
+	Stats::AddDraw(t, vb->GetVertexCount());
+
+	m->Unapply();
+	buf->Unbind();
+
+	return true;
+}
+
+bool RendererLegacy::DrawBufferIndexed(VertexBuffer *vb, IndexBuffer *ib, Material *m, PrimitiveType t)
+{
+	FlushRenderQueue();
+	if (!vb || !ib || !m || ib->GetIndexCount() == 0) return false;
+
+	VertexBufferGL *vbuf = static_cast<VertexBufferGL*>(vb);
+	IndexBufferGL *ibuf = static_cast<IndexBufferGL*>(ib);
+
+	m->Apply();
+	vbuf->Bind();
+	ibuf->Bind();
+
+	glDrawElements(t, ib->GetIndexCount(), GL_UNSIGNED_SHORT, 0);
+	Stats::AddDraw(t, ib->GetIndexCount());
+
+	m->Unapply();
+	ibuf->Unbind();
+	vbuf->Unbind();
+
+	return true;
+}
+
+bool RendererLegacy::DrawBufferPoints(VertexBuffer *vb, Material *m, float size)
+{
+	glPushAttrib(GL_POINT_BIT);
+	glPointSize(size);
+	const bool drawn = DrawBuffer(vb, m, POINTS);
+	glPopAttrib();
+	return drawn;
+}
+
+bool RendererLegacy::BeginRenderQueue()
+{
+	m_renderQueueDepth++;
+	return true;
+}
+
+bool RendererLegacy::EndRenderQueue()
+{
+	assert(m_renderQueueDepth > 0);
+	if (--m_renderQueueDepth == 0)
+		FlushRenderQueue();
+	return true;
+}
+
+static inline bool same_material(const RenderQueue::Item &a, const RenderQueue::Item &b)
+{
+	return a.material == b.material && a.textures == b.textures && a.blendMode == b.blendMode;
+}
+
+static inline bool same_surface(const RenderQueue::Item &a, const RenderQueue::Item &b)
+{
+	return a.mesh == b.mesh && a.surface == b.surface && same_material(a, b);
+}
+
+void RendererLegacy::SubmitRenderQueue()
+{
+	//take the items out first. anything called from here that would
+	//flush the queue finds it empty
+	RenderQueue &queue = m_submitQueue;
+	queue.Swap(m_renderQueue);
+	queue.Sort();
+	const bool glows = m_glowsQueued;
+	m_glowsQueued = false;
+
+	const matrix4x4f savedTransform = m_currentTransform;
+	const BlendMode savedBlendMode = m_currentBlendMode;
+
+	//the items put their own textures on the (shared) materials, so
+	//remember what the materials had to put it back afterwards
+	std::map<Material*,TextureSet> savedTextures;
+	for (RenderQueue::ItemIterator it = queue.ItemsBegin(); it != queue.ItemsEnd(); ++it)
+		savedTextures.insert(std::make_pair(it->material, TextureSet(it->material)));
+
+	const RenderQueue::Item *prev = 0;
+	const RenderQueue::Item *applied = 0; //whose material is applied now
+	unsigned int transform = ~0u;
+	MeshRenderInfo *boundMesh = 0;
+	RenderQueue::ItemIterator it = queue.ItemsBegin();
+	while (it != queue.ItemsEnd()) {
+		const RenderQueue::Item &item = *it;
+
+		//copies of one surface in a row, where only the transform differs,
+		//go out together
+		RenderQueue::ItemIterator runEnd = it + 1;
+		while (runEnd != queue.ItemsEnd() && same_surface(item, *runEnd))
+			++runEnd;
+		const int runLength = runEnd - it;
+
+		//back to back surfaces with the same material and textures only
+		//need it applying once
+		if (applied && !same_material(*applied, item)) {
+			applied->material->Unapply();
+			applied = 0;
+		}
+
+		if (!prev || prev->blendMode != item.blendMode)
+			SetBlendMode(item.blendMode);
+
+		MeshRenderInfo *meshInfo = static_cast<MeshRenderInfo*>(item.mesh->GetRenderInfo());
+		if (meshInfo != boundMesh) {
+			if (boundMesh && boundMesh->ibuf && !meshInfo->ibuf)
+				boundMesh->ibuf->Unbind();
+			meshInfo->vbuf->Bind();
+			if (meshInfo->ibuf)
+				meshInfo->ibuf->Bind();
+			boundMesh = meshInfo;
+		}
+
+		const SurfaceRenderInfo *surfaceInfo = static_cast<SurfaceRenderInfo*>(item.surface->GetRenderInfo());
+		const PrimitiveType pt = item.mesh->GetPrimtiveType();
+
+		if (runLength > 1 && meshInfo->ibuf && CanDrawInstanced(item.material)) {
+			//this applies the material itself, with a program that reads
+			//the transforms it's given
+			if (applied) {
+				applied->material->Unapply();
+				applied = 0;
+			}
+			m_instanceTransforms.clear();
+			for (RenderQueue::ItemIterator i = it; i != runEnd; ++i)
+				m_instanceTransforms.push_back(queue.GetTransform(i->transform));
+			item.textures.ApplyTo(item.material);
+			DrawInstanced(meshInfo->vbuf, meshInfo->ibuf->GetIndexType(), pt, surfaceInfo->glOffset, surfaceInfo->glAmount, item.material, &m_instanceTransforms[0], runLength);
+		} else {
+			if (!applied) {
+				item.textures.ApplyTo(item.material);
+				item.material->Apply();
+				applied = &item;
+			}
+			//set the buffer up once for the whole run, then only the
+			//transform changes between draws
+			meshInfo->vbuf->BeginDraw();
+			for (RenderQueue::ItemIterator i = it; i != runEnd; ++i) {
+				if (i->transform != transform) {
+					SetTransform(queue.GetTransform(i->transform));
+					transform = i->transform;
+				}
+				if (meshInfo->ibuf)
+					meshInfo->vbuf->DrawElements(pt, surfaceInfo->glOffset, surfaceInfo->glAmount, meshInfo->ibuf->GetIndexType());
+				else
+					meshInfo->vbuf->DrawArrays(pt, surfaceInfo->glOffset, surfaceInfo->glAmount);
+			}
+			meshInfo->vbuf->EndDraw();
+		}
+
+		prev = &*(runEnd - 1);
+		it = runEnd;
+	}
+
+	if (applied)
+		applied->material->Unapply();
+	if (boundMesh) {
+		if (boundMesh->ibuf)
+			boundMesh->ibuf->Unbind();
+		boundMesh->vbuf->Unbind();
+	}
+
+	for (std::map<Material*,TextureSet>::const_iterator it = savedTextures.begin(); it != savedTextures.end(); ++it)
+		it->second.ApplyTo(it->first);
+
+	SetTransform(savedTransform);
+	SetBlendMode(savedBlendMode);
+
+	//keep the storage for next time
+	queue.Clear();
+
+	//on top of everything else, as they were drawn in the transparent pass
+	if (glows)
+		SubmitGlows();
+}
+
+bool RendererLegacy::DrawGlow(const VertexArray *v, Texture *texture, const Color &color)
+{
+	if (!v || v->position.size() < 3) return false;
+	assert(v->HasAttrib(ATTRIB_UV0));
+
+	GlowBatch *batch = 0;
+	for (std::vector<GlowBatch>::iterator it = m_glowBatches.begin(); it != m_glowBatches.end(); ++it)
+		if (it->texture == texture) { batch = &*it; break; }
+	if (!batch) {
+		const GlowBatch b = { texture, new VertexArray(ATTRIB_POSITION | ATTRIB_DIFFUSE | ATTRIB_UV0) };
+		m_glowBatches.push_back(b);
+		batch = &m_glowBatches.back();
+	}
+
+	//the batches are drawn with no transform
+	for (unsigned int i = 0; i < v->position.size(); i++)
+		batch->vertices->Add(m_currentTransform * v->position[i], color, v->uv0[i]);
+	m_glowsQueued = true;
+
+	if (m_renderQueueDepth == 0)
+		SubmitRenderQueue();
+	return true;
+}
+
+void RendererLegacy::SubmitGlows()
+{
+	if (!m_glowMaterial.Valid()) {
+		MaterialDescriptor desc;
+		desc.textures = 1;
+		desc.vertexColors = true;
+		desc.twoSided = true;
+		m_glowMaterial.Reset(CreateMaterial(desc));
+	}
+
+	const matrix4x4f savedTransform = m_currentTransform;
+	const BlendMode savedBlendMode = m_currentBlendMode;
+	SetTransform(matrix4x4f::Identity());
+	SetBlendMode(BLEND_ADDITIVE);
+	SetDepthWrite(false);
+
+	for (std::vector<GlowBatch>::iterator it = m_glowBatches.begin(); it != m_glowBatches.end(); ++it) {
+		if (it->vertices->GetNumVerts() == 0) continue;
+		m_glowMaterial->texture0 = it->texture;
+		DrawTriangles(it->vertices, m_glowMaterial.Get());
+		//keep the storage for next time
+		it->vertices->Clear();
+	}
+
+	SetDepthWrite(true);
+	SetBlendMode(savedBlendMode);
+	SetTransform(savedTransform);
+}
+
 void RendererLegacy::EnableClientStates(const VertexArray *v)
 {
 	if (!v) return;
@@ -533,23 +903,27 @@ void RendererLegacy::EnableClientStates(const VertexArray *v)
 	// XXX could be 3D or 2D
 	m_clientStates.push_back(GL_VERTEX_ARRAY);
 	glEnableClientState(GL_VERTEX_ARRAY);
-	glVertexPointer(3, GL_FLOAT, 0, reinterpret_cast<const GLvoid *>(&v->position[0]));
+	Stats::Add(Stats::STAT_VERTICES_UPLOADED, v->position.size());
+	// the arrays are copied into the stream buffer rather than pointed at,
+	// so the driver doesn't have to pull them over itself mid-draw
+	glVertexPointer(3, GL_FLOAT, 0, m_vertexStream->Write(&v->position[0], v->position.size() * sizeof(vector3f)));
 
 	if (v->HasAttrib(ATTRIB_DIFFUSE)) {
 		m_clientStates.push_back(GL_COLOR_ARRAY);
 		glEnableClientState(GL_COLOR_ARRAY);
-		glColorPointer(4, GL_FLOAT, 0, reinterpret_cast<const GLvoid *>(&v->diffuse[0]));
+		glColorPointer(4, GL_FLOAT, 0, m_vertexStream->Write(&v->diffuse[0], v->diffuse.size() * sizeof(Color)));
 	}
 	if (v->HasAttrib(ATTRIB_NORMAL)) {
 		m_clientStates.push_back(GL_NORMAL_ARRAY);
 		glEnableClientState(GL_NORMAL_ARRAY);
-		glNormalPointer(GL_FLOAT, 0, reinterpret_cast<const GLvoid *>(&v->normal[0]));
+		glNormalPointer(GL_FLOAT, 0, m_vertexStream->Write(&v->normal[0], v->normal.size() * sizeof(vector3f)));
 	}
 	if (v->HasAttrib(ATTRIB_UV0)) {
 		m_clientStates.push_back(GL_TEXTURE_COORD_ARRAY);
 		glEnableClientState(GL_TEXTURE_COORD_ARRAY);
-		glTexCoordPointer(2, GL_FLOAT, 0, reinterpret_cast<const GLvoid *>(&v->uv0[0]));
+		glTexCoordPointer(2, GL_FLOAT, 0, m_vertexStream->Write(&v->uv0[0], v->uv0.size() * sizeof(vector2f)));
 	}
+	m_vertexStream->Unbind();
 }
 
 void RendererLegacy::DisableClientStates()
@@ -576,67 +950,93 @@ bool RendererLegacy::BufferStaticMesh(StaticMesh *mesh)
 	mesh->SetRenderInfo(meshInfo);
 
 	const int totalVertices = mesh->GetNumVerts();
+	const int totalIndices = mesh->GetNumIndices();
 
 	//surfaces should have a matching vertex specification!!
 
-	int indexAdjustment = 0;
+	//every surface goes into one tightly packed, interleaved array that is
+	//uploaded at once, and the indices of all of them into one index array.
+	//a surface alone never needs more than 16-bit indices, but rebased for
+	//the whole mesh they can, and then all of it switches to 32-bit
+	const bool wideIndices = totalVertices > 65536;
+	ScopedArray<ModelVertex> modelVerts(model ? new ModelVertex[totalVertices] : 0);
+	ScopedArray<UnlitVertex> unlitVerts(background ? new UnlitVertex[totalVertices] : 0);
+	std::vector<unsigned short> indices;
+	std::vector<Uint32> wideIndexData;
+	if (wideIndices)
+		wideIndexData.reserve(totalIndices);
+	else
+		indices.reserve(totalIndices);
 
-	VertexBuffer *buf = 0;
+	int vertexOffset = 0;
 	for (StaticMesh::SurfaceIterator surface = mesh->SurfacesBegin(); surface != mesh->SurfacesEnd(); ++surface) {
 		const int numsverts = (*surface)->GetNumVerts();
 		const VertexArray *va = (*surface)->GetVertices();
 
-		int offset = 0;
 		if (model) {
-			ScopedArray<ModelVertex> vts(new ModelVertex[numsverts]);
+			ModelVertex *vts = &modelVerts[vertexOffset];
 			for(int j=0; j<numsverts; j++) {
 				vts[j].position = va->position[j];
 				vts[j].normal = va->normal[j];
 				vts[j].uv = va->uv0[j];
 			}
-
-			if (!buf)
-				buf = new VertexBuffer(totalVertices);
-			buf->Bind();
-			buf->BufferData<ModelVertex>(numsverts, vts.Get());
 		} else if (background) {
-			ScopedArray<UnlitVertex> vts(new UnlitVertex[numsverts]);
+			UnlitVertex *vts = &unlitVerts[vertexOffset];
 			for(int j=0; j<numsverts; j++) {
 				vts[j].position = va->position[j];
 				vts[j].color = va->diffuse[j];
 			}
-
-			if (!buf)
-				buf= new UnlitVertexBuffer(totalVertices);
-			buf->Bind();
-			offset = buf->BufferData<UnlitVertex>(numsverts, vts.Get());
 		}
 
 		SurfaceRenderInfo *surfaceInfo = new SurfaceRenderInfo();
-		surfaceInfo->glOffset = offset;
+		surfaceInfo->glOffset = vertexOffset;
 		surfaceInfo->glAmount = numsverts;
 		(*surface)->SetRenderInfo(surfaceInfo);
 
-		//buffer indices from each surface, if in use
+		//indices from each surface, if in use, moved past the vertices
+		//of the surfaces before it
 		if ((*surface)->IsIndexed()) {
 			assert(background == false);
 
-			//XXX should do this adjustment in RendererGL2Buffers
 			const unsigned short *originalIndices = (*surface)->GetIndexPointer();
-			std::vector<unsigned short> adjustedIndices((*surface)->GetNumIndices());
-			for (int i = 0; i < (*surface)->GetNumIndices(); ++i)
-				adjustedIndices[i] = originalIndices[i] + indexAdjustment;
-
-			if (!meshInfo->ibuf)
-				meshInfo->ibuf = new IndexBuffer(mesh->GetNumIndices());
-			meshInfo->ibuf->Bind();
-			const int ioffset = meshInfo->ibuf->BufferIndexData((*surface)->GetNumIndices(), &adjustedIndices[0]);
-			surfaceInfo->glOffset = ioffset;
-			surfaceInfo->glAmount = (*surface)->GetNumIndices();
-
-			indexAdjustment += (*surface)->GetNumVerts();
+			const int numIndices = (*surface)->GetNumIndices();
+			if (wideIndices) {
+				surfaceInfo->glOffset = wideIndexData.size();
+				for (int i = 0; i < numIndices; ++i)
+					wideIndexData.push_back(Uint32(originalIndices[i]) + vertexOffset);
+			} else {
+				surfaceInfo->glOffset = indices.size();
+				for (int i = 0; i < numIndices; ++i)
+					indices.push_back(originalIndices[i] + vertexOffset);
+			}
+			surfaceInfo->glAmount = numIndices;
 		}
+
+		vertexOffset += numsverts;
+	}
+
+	MeshVertexBuffer *buf = 0;
+	if (model) {
+		buf = new MeshVertexBuffer(totalVertices);
+		buf->Bind();
+		buf->BufferData<ModelVertex>(totalVertices, modelVerts.Get());
+	} else {
+		buf = new UnlitMeshVertexBuffer(totalVertices);
+		buf->Bind();
+		buf->BufferData<UnlitVertex>(totalVertices, unlitVerts.Get());
+	}
+
+	if (!indices.empty() || !wideIndexData.empty()) {
+		meshInfo->ibuf = new MeshIndexBuffer(totalIndices, wideIndices);
+		meshInfo->ibuf->Bind();
+		if (wideIndices)
+			meshInfo->ibuf->BufferIndexData(wideIndexData.size(), &wideIndexData[0]);
+		else
+			meshInfo->ibuf->BufferIndexData(indices.size(), &indices[0]);
+		meshInfo->ibuf->Unbind();
 	}
+	buf->Unbind();
+
 	assert(buf);
 	meshInfo->vbuf = buf;
 	mesh->cached = true;
@@ -669,7 +1069,17 @@ Material *RendererLegacy::CreateMaterial(const MaterialDescriptor &desc)
 
 Texture *RendererLegacy::CreateTexture(const TextureDescriptor &descriptor)
 {
-	return new TextureGL(descriptor, m_useCompressedTextures);
+	return new TextureGL(descriptor, m_useCompressedTextures, m_textureManager.Get());
+}
+
+VertexBuffer *RendererLegacy::CreateVertexBuffer(const VertexBufferDesc &desc)
+{
+	return new VertexBufferGL(desc);
+}
+
+IndexBuffer *RendererLegacy::CreateIndexBuffer(unsigned int size, BufferUsage usage)
+{
+	return new IndexBufferGL(size, usage);
 }
 
 // XXX very heavy. in the future when all GL calls are made through the
@@ -677,6 +1087,8 @@ Texture *RendererLegacy::CreateTexture(const TextureDescriptor &descriptor)
 // only restoring the things that have changed
 void RendererLegacy::PushState()
 {
+	FlushRenderQueue();
+	m_stateStack.push_back(std::make_pair(m_currentTransform, m_currentBlendMode));
 	glMatrixMode(GL_PROJECTION);
 	glPushMatrix();
 	glMatrixMode(GL_MODELVIEW);
@@ -686,11 +1098,17 @@ void RendererLegacy::PushState()
 
 void RendererLegacy::PopState()
 {
+	FlushRenderQueue();
 	glPopAttrib();
+	TextureGL::InvalidateBindings();
 	glMatrixMode(GL_PROJECTION);
 	glPopMatrix();
 	glMatrixMode(GL_MODELVIEW);
 	glPopMatrix();
+	assert(!m_stateStack.empty());
+	m_currentTransform = m_stateStack.back().first;
+	m_currentBlendMode = m_stateStack.back().second;
+	m_stateStack.pop_back();
 }
 
 static void dump_opengl_value(std::ostream &out, const char *name, GLenum id, int num_elems)
@@ -742,6 +1160,21 @@ bool RendererLegacy::PrintDebugInfo(std::ostream &out)
 			std::ostream_iterator<std::string>(out, "\n  "));
 	}
 
+	const TextureManager::Stats &texStats = m_textureManager->GetStats();
+	out << "\nTexture memory: " << (texStats.residentBytes >> 20) << " MB in " << texStats.textures << " textures";
+	if (m_textureManager->GetBudget())
+		out << ", budget " << (m_textureManager->GetBudget() >> 20) << " MB";
+	else
+		out << ", no budget";
+	out << "\n";
+
+	const Stats &stats = GetStats();
+	out << "\nLast frame:\n";
+	for (int i = 0; i < Stats::MAX_STAT; i++) {
+		const Stats::StatType type = Stats::StatType(i);
+		out << "  " << Stats::GetName(type) << ": " << stats.Get(type) << "\n";
+	}
+
 	out << "\nImplementation Limits:\n";
 
 	// first, clear all OpenGL error flags
@@ -7,10 +7,14 @@
  * Fixed function renderer (GL1.5 approx)
  */
 #include "Renderer.h"
+#include "RenderQueue.h"
 
 namespace Graphics {
 
 class Texture;
+class MeshVertexBuffer;
+class StreamBufferGL;
+class TextureManager;
 struct Settings;
 
 class RendererLegacy : public Renderer
@@ -54,13 +58,25 @@ public:
 	virtual bool DrawTriangles(const VertexArray *vertices, Material *material, PrimitiveType type=TRIANGLES);
 	virtual bool DrawSurface(const Surface *surface);
 	virtual bool DrawPointSprites(int count, const vector3f *positions, Material *material, float size);
+	virtual bool DrawPointSprites(int count, const vector3f *positions, const Color *colors, const float *sizes, Material *material);
 	virtual bool DrawStaticMesh(StaticMesh *thing);
+	virtual bool DrawBuffer(VertexBuffer *, Material *, PrimitiveType type=TRIANGLES);
+	virtual bool DrawBufferIndexed(VertexBuffer *, IndexBuffer *, Material *, PrimitiveType type=TRIANGLES);
+	virtual bool DrawBufferPoints(VertexBuffer *, Material *, float pointSize=1.f);
+	virtual bool DrawGlow(const VertexArray *vertices, Texture *texture, const Color &color);
+
+	virtual bool BeginRenderQueue();
+	virtual bool EndRenderQueue();
 
 	virtual Material *CreateMaterial(const MaterialDescriptor &descriptor);
 	virtual Texture *CreateTexture(const TextureDescriptor &descriptor);
+	virtual VertexBuffer *CreateVertexBuffer(const VertexBufferDesc &);
+	virtual IndexBuffer *CreateIndexBuffer(unsigned int size, BufferUsage);
 
 	virtual bool PrintDebugInfo(std::ostream &out);
 
+	virtual TextureManager *GetTextureManager() { return m_textureManager.Get(); }
+
 protected:
 	virtual void PushState();
 	virtual void PopState();
@@ -77,9 +93,46 @@ protected:
 	float m_minZNear;
 	float m_maxZFar;
 	bool m_useCompressedTextures;
+	ScopedPtr<TextureManager> m_textureManager;
+
+	//vertex and index arrays for a single draw are copied into these
+	ScopedPtr<StreamBufferGL> m_vertexStream;
+	ScopedPtr<StreamBufferGL> m_indexStream;
+	ScopedPtr<VertexArray> m_pointSprites;
+	ScopedPtr<VertexArray> m_coloredPointSprites;
 
 	matrix4x4f& GetCurrentTransform() { return m_currentTransform; }
 	matrix4x4f m_currentTransform;
+	BlendMode m_currentBlendMode;
+	//PushState/PopState go behind our back, so keep ours in step
+	std::vector<std::pair<matrix4x4f,BlendMode> > m_stateStack;
+
+	//draw anything queued, ahead of something that can't be reordered
+	//with it. call this first in every draw and state setter that the
+	//queue items don't carry themselves
+	void FlushRenderQueue() { if (!m_renderQueue.IsEmpty() || m_glowsQueued) SubmitRenderQueue(); }
+	void SubmitRenderQueue();
+	void SubmitGlows();
+	//items sharing a key share a shader, so sort together
+	virtual const void *GetProgramKey(const Material *m) const { return 0; }
+	//draw count copies of one surface, placed by the transforms, in as
+	//few calls as the hardware can. the material isn't applied yet. without
+	//support for it copies are drawn one by one, sharing one buffer set up
+	virtual bool CanDrawInstanced(const Material *m) const { return false; }
+	virtual void DrawInstanced(MeshVertexBuffer *vbuf, GLenum indexType, PrimitiveType pt, int start, int amount, Material *m, const matrix4x4f *transforms, int count) { }
+	int m_renderQueueDepth;
+	RenderQueue m_renderQueue;
+	RenderQueue m_submitQueue;
+	std::vector<matrix4x4f> m_instanceTransforms;
+
+	//glows queued by DrawGlow, in view space, one batch per texture
+	struct GlowBatch {
+		Texture *texture;
+		VertexArray *vertices;
+	};
+	std::vector<GlowBatch> m_glowBatches;
+	bool m_glowsQueued;
+	RefCountedPtr<Material> m_glowMaterial;
 };
 
 }
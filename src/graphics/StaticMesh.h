@@ -16,6 +16,8 @@ namespace Graphics {
  * unchanging geometry. Renderers can buffer the contents into VBOs or
  * whatever they prefer. The original vertex data is kept for reloading
  * on context switch.
+ * The GL renderers pack all the surfaces into one interleaved vertex buffer
+ * with a fixed layout, and their indices into one index buffer.
  */
 class StaticMesh : public Renderable {
 public:
@@ -40,6 +42,7 @@ public:
 
 	bool cached;
 
+	//per surface, so its indices fit in 16 bits
 	static const int MAX_VERTICES = 65536;
 
 private:
@@ -0,0 +1,55 @@
+// Copyright © 2008-2013 Pioneer Developers. See AUTHORS.txt for details
+// Licensed under the terms of the GPL v3. See licenses/GPL-3.txt
+
+#include "Stats.h"
+
+namespace Graphics {
+
+Stats Stats::s_frame;
+Stats Stats::s_lastFrame;
+
+static const char *s_statNames[Stats::MAX_STAT] = {
+	"draw_calls",
+	"triangles",
+	"vertices_uploaded",
+	"buffer_bytes_uploaded",
+	"texture_bytes_uploaded",
+	"program_switches",
+	"texture_binds",
+	"state_changes",
+	"render_target_switches"
+};
+
+void Stats::Clear()
+{
+	for (int i = 0; i < MAX_STAT; i++)
+		m_counters[i] = 0;
+}
+
+const char *Stats::GetName(StatType type)
+{
+	assert(type >= 0 && type < MAX_STAT);
+	return s_statNames[type];
+}
+
+void Stats::AddDraw(GLenum primitive, Uint32 count, Uint32 instances)
+{
+	Uint32 triangles = 0;
+	switch (primitive) {
+		case GL_TRIANGLES: triangles = count / 3; break;
+		case GL_TRIANGLE_STRIP:
+		case GL_TRIANGLE_FAN: triangles = count > 2 ? count - 2 : 0; break;
+		case GL_QUADS: triangles = (count / 4) * 2; break;
+		default: break;
+	}
+	s_frame.m_counters[STAT_DRAW_CALLS]++;
+	s_frame.m_counters[STAT_TRIANGLES] += triangles * instances;
+}
+
+void Stats::EndFrame()
+{
+	s_lastFrame = s_frame;
+	s_frame.Clear();
+}
+
+}
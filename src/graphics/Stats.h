@@ -0,0 +1,58 @@
+// Copyright © 2008-2013 Pioneer Developers. See AUTHORS.txt for details
+// Licensed under the terms of the GPL v3. See licenses/GPL-3.txt
+
+#ifndef _GRAPHICS_STATS_H
+#define _GRAPHICS_STATS_H
+
+#include "libs.h"
+
+namespace Graphics {
+
+/*
+ * Counts of what the renderer did in a frame. The renderer counts into the
+ * current frame, and so do the GL objects that do its work (textures,
+ * buffers, programs) and the few places that still draw with GL directly.
+ * There's only ever one renderer, so the frames are kept here rather than
+ * in it. Renderer::SwapBuffers ends a frame, and Renderer::GetStats gives
+ * the last one ended.
+ */
+class Stats {
+public:
+	enum StatType {
+		STAT_DRAW_CALLS,
+		STAT_TRIANGLES,
+		STAT_VERTICES_UPLOADED,
+		STAT_BUFFER_BYTES_UPLOADED,
+		STAT_TEXTURE_BYTES_UPLOADED,
+		STAT_PROGRAM_SWITCHES,
+		STAT_TEXTURE_BINDS,
+		STAT_STATE_CHANGES,
+		STAT_RENDER_TARGET_SWITCHES,
+		MAX_STAT
+	};
+
+	Stats() { Clear(); }
+
+	Uint32 Get(StatType type) const { return m_counters[type]; }
+	void Clear();
+
+	// short lowercase names, as used by the Lua binding
+	static const char *GetName(StatType type);
+
+	static void Add(StatType type, Uint32 n = 1) { s_frame.m_counters[type] += n; }
+	// a draw call of count vertices or indices (GL_TRIANGLES and friends)
+	static void AddDraw(GLenum primitive, Uint32 count, Uint32 instances = 1);
+
+	static const Stats &GetLastFrame() { return s_lastFrame; }
+	static void EndFrame();
+
+private:
+	Uint32 m_counters[MAX_STAT];
+
+	static Stats s_frame;
+	static Stats s_lastFrame;
+};
+
+}
+
+#endif
@@ -15,6 +15,9 @@ namespace Graphics {
 /*
  * Surface is a container for a vertex array, a material
  * and an index array. Intended for indexed triangle drawing.
+ * Indices are 16-bit, so a surface has at most StaticMesh::MAX_VERTICES
+ * vertices; a mesh holding several such surfaces is given 32-bit indices
+ * by the renderer when it needs them.
  */
 class Surface : public Renderable {
 public:
@@ -30,6 +33,7 @@ public:
 	int GetNumVerts() const { return m_vertices ? m_vertices->position.size() : 0; }
 	int GetNumIndices() const { return m_indices.size(); }
 	std::vector<unsigned short> &GetIndices() { return m_indices; }
+	const std::vector<unsigned short> &GetIndices() const { return m_indices; }
 	const unsigned short *GetIndexPointer() const { return &m_indices[0]; }
 
 	bool IsIndexed() const { return !m_indices.empty(); }
@@ -6,6 +6,7 @@
 
 #include "vector2.h"
 #include "RefCounted.h"
+#include <vector>
 
 namespace Graphics {
 
@@ -74,6 +75,10 @@ public:
 	virtual void Update(const void *data, const vector2f &dataSize, TextureFormat format, const unsigned int numMips = 0) = 0;
 	virtual void SetSampleMode(TextureSampleMode) = 0;
 
+	// the image as the driver compressed it, its mip levels one after
+	// another from the largest down. false if it wasn't compressed on upload
+	virtual bool GetCompressedImage(std::vector<unsigned char> &data, TextureFormat &format, unsigned int &numMips) { return false; }
+
 	virtual ~Texture() {}
 
 protected:
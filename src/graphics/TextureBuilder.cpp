@@ -2,6 +2,7 @@
 // Licensed under the terms of the GPL v3. See licenses/GPL-3.txt
 
 #include "TextureBuilder.h"
+#include "TextureManager.h"
 #include "FileSystem.h"
 #include "utils.h"
 #include <SDL_image.h>
@@ -12,12 +13,12 @@
 namespace Graphics {
 
 TextureBuilder::TextureBuilder(const SDLSurfacePtr &surface, TextureSampleMode sampleMode, bool generateMipmaps, bool potExtend, bool forceRGBA, bool compressTextures) :
-    m_surface(surface), m_sampleMode(sampleMode), m_generateMipmaps(generateMipmaps), m_potExtend(potExtend), m_forceRGBA(forceRGBA), m_compressTextures(compressTextures), m_prepared(false)
+    m_surface(surface), m_sampleMode(sampleMode), m_generateMipmaps(generateMipmaps), m_potExtend(potExtend), m_forceRGBA(forceRGBA), m_compressTextures(compressTextures), m_useTextureCache(true), m_storeInCache(false), m_prepared(false)
 {
 }
 
 TextureBuilder::TextureBuilder(const std::string &filename, TextureSampleMode sampleMode, bool generateMipmaps, bool potExtend, bool forceRGBA, bool compressTextures) :
-    m_filename(filename), m_sampleMode(sampleMode), m_generateMipmaps(generateMipmaps), m_potExtend(potExtend), m_forceRGBA(forceRGBA), m_compressTextures(compressTextures), m_prepared(false)
+    m_filename(filename), m_sampleMode(sampleMode), m_generateMipmaps(generateMipmaps), m_potExtend(potExtend), m_forceRGBA(forceRGBA), m_compressTextures(compressTextures), m_useTextureCache(true), m_storeInCache(false), m_prepared(false)
 {
 }
 
@@ -171,7 +172,23 @@ void TextureBuilder::LoadSurface()
 {
 	assert(!m_surface);
 
-	SDLSurfacePtr s = LoadSurfaceFromFile(m_filename);
+	// a cached copy made from this very file is already compressed and has
+	// its mipmaps, so there's nothing to decode. padded textures are left
+	// out, the copy wouldn't know about the padding
+	SDLSurfacePtr s;
+	if (m_useTextureCache && m_compressTextures && !m_potExtend && TextureCache::IsEnabled()) {
+		RefCountedPtr<FileSystem::FileData> filedata = FileSystem::gameDataFiles.ReadFile(m_filename);
+		if (filedata) {
+			m_cacheSource = TextureCache::MakeSource(m_filename, *filedata);
+			if (TextureCache::Load(m_cacheSource, m_dds))
+				return;
+			s = LoadSurfaceFromData(m_filename, *filedata);
+			m_storeInCache = s.Valid();
+		} else
+			fprintf(stderr, "LoadSurface: %s: could not read file\n", m_filename.c_str());
+	} else
+		s = LoadSurfaceFromFile(m_filename);
+
 	if (! s) { s = LoadSurfaceFromFile("textures/unknown.png"); }
 
 	// XXX if we can't load the fallback texture, then what?
@@ -200,6 +217,27 @@ void TextureBuilder::UpdateTexture(Texture *texture)
 	}
 }
 
+Texture *TextureBuilder::CreateTexture(Renderer *r)
+{
+	Texture *t = r->CreateTexture(GetDescriptor());
+	UpdateTexture(t);
+	if (m_storeInCache)
+		TextureCache::Store(m_cacheSource, t);
+	// anything from a file can be dropped from video memory and read again
+	TextureManager *tm = r->GetTextureManager();
+	if (tm && !m_filename.empty())
+		tm->SetSource(t, ForReload());
+	return t;
+}
+
+TextureBuilder TextureBuilder::ForReload() const
+{
+	assert(!m_filename.empty());
+	TextureBuilder b(m_filename, m_sampleMode, m_generateMipmaps, m_potExtend, m_forceRGBA, m_compressTextures);
+	b.m_useTextureCache = m_useTextureCache && !m_surface;
+	return b;
+}
+
 Texture *TextureBuilder::GetWhiteTexture(Renderer *r)
 {
 	return Model("textures/white.png").GetOrCreateTexture(r, "model");
@@ -9,6 +9,7 @@
 #include "Texture.h"
 #include "Renderer.h"
 #include "SDLWrappers.h"
+#include "TextureCache.h"
 
 #include "PicoDDS/PicoDDS.h"
 
@@ -35,13 +36,10 @@ public:
 	}
 
 	const TextureDescriptor &GetDescriptor() { PrepareSurface(); return m_descriptor; }
+	const std::string &GetFilename() const { return m_filename; }
 	void UpdateTexture(Texture *texture); // XXX pass src/dest rectangles
 
-	Texture *CreateTexture(Renderer *r) {
-		Texture *t = r->CreateTexture(GetDescriptor());
-		UpdateTexture(t);
-		return t;
-	}
+	Texture *CreateTexture(Renderer *r);
 
 	Texture *GetOrCreateTexture(Renderer *r, const std::string &type, const std::string &name = "") {
 		const std::string &cacheName = name.length() > 0 ? name : m_filename;
@@ -69,6 +67,14 @@ private:
 	bool m_forceRGBA;
 	bool m_compressTextures;
 
+	// look for a compressed copy in the texture cache first. off for
+	// reloads of a texture that was decoded, since they have to come back
+	// in the format it was made with
+	bool m_useTextureCache;
+	// decoded with the cache on, so what the driver makes of it is kept
+	bool m_storeInCache;
+	TextureCache::Source m_cacheSource;
+
 	TextureDescriptor m_descriptor;
 
 	void PrepareSurface();
@@ -76,6 +82,9 @@ private:
 
 	void LoadSurface();
 	void LoadDDS();
+
+	// a builder with the same settings that hasn't loaded anything yet
+	TextureBuilder ForReload() const;
 };
 
 }
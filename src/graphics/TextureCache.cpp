@@ -0,0 +1,209 @@
+// Copyright © 2008-2013 Pioneer Developers. See AUTHORS.txt for details
+// Licensed under the terms of the GPL v3. See licenses/GPL-3.txt
+
+#include "TextureCache.h"
+#include "Texture.h"
+#include "FileSystem.h"
+#include "Hash.h"
+#include "libs.h"
+#include "PicoDDS/PicoDDS.h"
+#include <cstdio>
+#include <vector>
+
+namespace Graphics {
+namespace TextureCache {
+
+static const char CACHE_DIR_NAME[] = "texturecache";
+
+// bump this if the header layout changes
+static const Uint32 CACHE_VERSION = 1;
+
+// the rest of the file is a plain DDS file, so a cached texture can be
+// looked at with any image tool
+static const size_t DDS_HEADER_SIZE = 128;
+
+// Update never takes more levels than this, and a 64k texture has fewer
+static const Uint32 MAX_MIP_LEVELS = 16;
+
+struct FileHeader {
+	char magic[4];
+	Uint32 version;
+	Uint32 sourceSize;
+	Uint32 nameSize;
+	Uint64 sourceHash;
+	Uint32 format;
+	Uint32 width;
+	Uint32 height;
+	Uint32 numMips;
+	Uint32 dataSize;
+};
+
+static const char CACHE_MAGIC[4] = { 'P', 'T', 'X', 'C' };
+
+static bool s_enabled = false;
+
+void SetEnabled(bool enabled)
+{
+	s_enabled = enabled && FileSystem::userFiles.MakeDirectory(CACHE_DIR_NAME);
+}
+
+bool IsEnabled()
+{
+	return s_enabled;
+}
+
+Source MakeSource(const std::string &filename, const FileSystem::FileData &data)
+{
+	Source source;
+	source.name = filename;
+	source.size = data.GetSize();
+	source.hash = Hash64(data.GetData(), data.GetSize());
+	return source;
+}
+
+static std::string CacheFileName(const std::string &name)
+{
+	char buf[32];
+	snprintf(buf, sizeof(buf), "%016llx", static_cast<unsigned long long>(Hash64(name.c_str(), name.size())));
+	return FileSystem::JoinPathBelow(CACHE_DIR_NAME, buf);
+}
+
+// the header that a cache file for this source has to have
+static FileHeader MakeHeader(const Source &source)
+{
+	FileHeader header;
+	memset(&header, 0, sizeof(header));
+	memcpy(header.magic, CACHE_MAGIC, sizeof(CACHE_MAGIC));
+	header.version = CACHE_VERSION;
+	header.sourceSize = source.size;
+	header.nameSize = source.name.size();
+	header.sourceHash = source.hash;
+	return header;
+}
+
+// bytes in numMips levels of DXT data, halving down to the smallest level
+// TextureGL uploads
+static size_t LevelsSize(TextureFormat format, Uint32 width, Uint32 height, Uint32 numMips)
+{
+	const size_t blockSize = (format == TEXTURE_DXT1) ? 8 : 16;
+	size_t size = 0;
+	for (Uint32 i = 0; i < numMips; i++) {
+		size += ((width + 3) / 4) * ((height + 3) / 4) * blockSize;
+		width = std::max(width / 2, 1U);
+		height = std::max(height / 2, 1U);
+	}
+	return size;
+}
+
+// the DDS header PicoDDS has to see in front of the levels. also used to
+// check the one in a cache file, so a damaged one can't make it read past
+// the end of the data
+static void MakeDDSHeader(const FileHeader &header, char out[DDS_HEADER_SIZE])
+{
+	using namespace PicoDDS::DDS;
+
+	Uint32 dwords[DDS_HEADER_SIZE / 4];
+	memset(dwords, 0, sizeof(dwords));
+	dwords[1] = 124; // size of the rest of the header
+	dwords[2] = DDSD_CAPS | DDSD_HEIGHT | DDSD_WIDTH | DDSD_PIXELFORMAT | DDSD_MIPMAPCOUNT | DDSD_LINEARSIZE;
+	dwords[3] = header.height;
+	dwords[4] = header.width;
+	dwords[5] = LevelsSize(TextureFormat(header.format), header.width, header.height, 1);
+	dwords[7] = header.numMips;
+	dwords[19] = 32; // size of the pixel format
+	dwords[20] = DDPF_FOURCC;
+	dwords[21] = (header.format == TEXTURE_DXT1) ? FOURCC('D','X','T','1') : FOURCC('D','X','T','5');
+	dwords[27] = DDSCAPS_TEXTURE | (header.numMips > 1 ? DDSCAPS_COMPLEX | DDSCAPS_MIPMAP : 0);
+
+	for (size_t i = 0; i < DDS_HEADER_SIZE / 4; i++)
+		dwords[i] = SDL_SwapLE32(dwords[i]);
+	memcpy(dwords, "DDS ", 4);
+	memcpy(out, dwords, DDS_HEADER_SIZE);
+}
+
+// read a cache file made from this source, up to its DDS part
+static bool ReadCached(const Source &source, FileHeader &header, std::vector<char> &dds)
+{
+	FILE *f = FileSystem::userFiles.OpenReadStream(CacheFileName(source.name));
+	if (!f) return false;
+
+	const FileHeader want = MakeHeader(source);
+	bool ok = (fread(&header, sizeof(header), 1, f) == 1) &&
+		(memcmp(header.magic, want.magic, sizeof(want.magic)) == 0) &&
+		header.version == want.version &&
+		header.sourceSize == want.sourceSize &&
+		header.sourceHash == want.sourceHash &&
+		header.nameSize == want.nameSize &&
+		(header.format == TEXTURE_DXT1 || header.format == TEXTURE_DXT5) &&
+		header.width > 0 && header.height > 0 &&
+		header.numMips > 0 && header.numMips <= MAX_MIP_LEVELS &&
+		header.dataSize == LevelsSize(TextureFormat(header.format), header.width, header.height, header.numMips);
+
+	// the name is kept too, so two textures whose names hash the same can't
+	// pick up each other's image
+	if (ok) {
+		std::vector<char> name(header.nameSize);
+		ok = header.nameSize == 0 || (fread(&name[0], header.nameSize, 1, f) == 1 &&
+			source.name.compare(0, std::string::npos, &name[0], header.nameSize) == 0);
+	}
+	if (ok) {
+		char ddsHeader[DDS_HEADER_SIZE];
+		MakeDDSHeader(header, ddsHeader);
+		dds.resize(DDS_HEADER_SIZE + header.dataSize);
+		ok = fread(&dds[0], dds.size(), 1, f) == 1 &&
+			memcmp(&dds[0], ddsHeader, DDS_HEADER_SIZE) == 0;
+	}
+	fclose(f);
+	return ok;
+}
+
+bool Load(const Source &source, PicoDDS::DDSImage &dds)
+{
+	if (!s_enabled) return false;
+	assert(!dds.headerdone_);
+
+	FileHeader header;
+	std::vector<char> data;
+	if (!ReadCached(source, header, data))
+		return false;
+
+	dds.Read(&data[0], data.size());
+	return dds.headerdone_;
+}
+
+void Store(const Source &source, Texture *texture)
+{
+	if (!s_enabled) return;
+
+	std::vector<unsigned char> levels;
+	TextureFormat format;
+	unsigned int numMips;
+	if (!texture->GetCompressedImage(levels, format, numMips))
+		return;
+
+	const TextureDescriptor &descriptor = texture->GetDescriptor();
+	FileHeader header = MakeHeader(source);
+	header.format = format;
+	header.width = descriptor.dataSize.x;
+	header.height = descriptor.dataSize.y;
+	header.numMips = numMips;
+	header.dataSize = levels.size();
+	if (numMips > MAX_MIP_LEVELS || levels.size() != LevelsSize(format, header.width, header.height, numMips))
+		return;
+
+	char ddsHeader[DDS_HEADER_SIZE];
+	MakeDDSHeader(header, ddsHeader);
+
+	// a short write leaves a file that fails the checks in ReadCached, so
+	// the texture just gets compressed again next time
+	FILE *f = FileSystem::userFiles.OpenWriteStream(CacheFileName(source.name));
+	if (!f) return;
+	fwrite(&header, sizeof(header), 1, f);
+	fwrite(source.name.c_str(), source.name.size(), 1, f);
+	fwrite(ddsHeader, sizeof(ddsHeader), 1, f);
+	fwrite(&levels[0], levels.size(), 1, f);
+	fclose(f);
+}
+
+}
+}
@@ -0,0 +1,50 @@
+// Copyright © 2008-2013 Pioneer Developers. See AUTHORS.txt for details
+// Licensed under the terms of the GPL v3. See licenses/GPL-3.txt
+
+#ifndef _TEXTURECACHE_H
+#define _TEXTURECACHE_H
+
+#include <SDL_stdinc.h>
+#include <string>
+
+namespace FileSystem { class FileData; }
+namespace PicoDDS { class DDSImage; }
+
+namespace Graphics {
+
+class Texture;
+
+// textures from data/ as the driver compressed them, DXT1 or DXT5 with their
+// mip levels, kept in the user dir. the first time a texture is loaded it's
+// decoded and compressed as usual and then read back and written out, after
+// that the compressed copy is loaded instead and the PNG is never decoded.
+// each file is keyed by the texture's name and checked against the size and
+// hash of the file it was made from, so an edited texture (or a mod
+// replacing one) is just compressed again
+namespace TextureCache {
+
+	// off until this is called. only worth having with texture compression
+	// on, since the cached copies are always compressed. main thread only
+	void SetEnabled(bool enabled);
+	bool IsEnabled();
+
+	// what a cached copy has to have been made from
+	struct Source {
+		Source() : size(0), hash(0) {}
+		std::string name;
+		Uint32 size;
+		Uint64 hash;
+	};
+	Source MakeSource(const std::string &filename, const FileSystem::FileData &data);
+
+	// read the cached copy into dds if there is one for this source
+	bool Load(const Source &source, PicoDDS::DDSImage &dds);
+
+	// write out what the driver made of the texture, if it compressed it
+	void Store(const Source &source, Texture *texture);
+
+}
+
+}
+
+#endif
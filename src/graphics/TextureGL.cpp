@@ -2,13 +2,52 @@
 // Licensed under the terms of the GPL v3. See licenses/GPL-3.txt
 
 #include "TextureGL.h"
+#include "TextureManager.h"
+#include "Stats.h"
 #include <cassert>
+#include <algorithm>
 #include "utils.h"
 
 static const unsigned int MIN_COMPRESSED_TEXTURE_DIMENSION = 16;
 
 namespace Graphics {
 
+// what's bound on each unit, and which unit is active, as far as we know.
+// everything binding textures goes through here, so only glPopAttrib can
+// make this wrong and InvalidateBindings is called after those.
+// UNKNOWN matches nothing so the next bind always happens
+static const unsigned int MAX_TRACKED_UNITS = 8;
+static const GLuint UNKNOWN = ~0u;
+static GLuint s_boundTexture[MAX_TRACKED_UNITS] = { UNKNOWN, UNKNOWN, UNKNOWN, UNKNOWN, UNKNOWN, UNKNOWN, UNKNOWN, UNKNOWN };
+static unsigned int s_activeUnit = UNKNOWN;
+
+void TextureGL::SetActiveUnit(unsigned int unit)
+{
+	if (unit == s_activeUnit) return;
+	glActiveTexture(GL_TEXTURE0 + unit);
+	s_activeUnit = unit;
+}
+
+void TextureGL::InvalidateBindings()
+{
+	for (unsigned int i = 0; i < MAX_TRACKED_UNITS; i++)
+		s_boundTexture[i] = UNKNOWN;
+	s_activeUnit = UNKNOWN;
+}
+
+void TextureGL::BindUnit(GLenum target, GLuint texture)
+{
+	if (s_activeUnit >= MAX_TRACKED_UNITS) {
+		glBindTexture(target, texture);
+		Stats::Add(Stats::STAT_TEXTURE_BINDS);
+		return;
+	}
+	if (s_boundTexture[s_activeUnit] == texture) return;
+	glBindTexture(target, texture);
+	s_boundTexture[s_activeUnit] = texture;
+	Stats::Add(Stats::STAT_TEXTURE_BINDS);
+}
+
 inline GLint GLInternalFormat(TextureFormat format) {
 	switch (format) {
 		case TEXTURE_RGB_888: return GL_RGB;
@@ -63,17 +102,79 @@ inline bool IsCompressed(TextureFormat format) {
 	return (format == TEXTURE_DXT1 || format == TEXTURE_DXT5);
 }
 
-TextureGL::TextureGL(const TextureDescriptor &descriptor, const bool useCompressed) :
-	Texture(descriptor), m_target(GL_TEXTURE_2D) // XXX don't force target
+// bytes per texel of uncompressed data as it's handed over
+inline int GetTexelSize(TextureFormat format) {
+	switch (format) {
+		case TEXTURE_RGBA_8888: return 4;
+		case TEXTURE_RGB_888: return 3;
+		case TEXTURE_LUMINANCE_ALPHA_88: return 2;
+		default: return 1;
+	}
+}
+
+// what the texture will take in video memory, roughly. drivers may pad
+static size_t EstimateByteSize(const TextureDescriptor &descriptor, const bool compressTexture)
 {
-	glGenTextures(1, &m_texture);
-	glBindTexture(m_target, m_texture);
+	const size_t width = descriptor.dataSize.x;
+	const size_t height = descriptor.dataSize.y;
+
+	if (IsCompressed(descriptor.format)) {
+		const size_t blockSize = GetMinSize(descriptor.format);
+		size_t w = width, h = height, bytes = 0;
+		for (unsigned int i = 0; i < std::max(descriptor.numberOfMipMaps, 1U); ++i) {
+			bytes += ((w + 3) / 4) * ((h + 3) / 4) * blockSize;
+			if (w <= MIN_COMPRESSED_TEXTURE_DIMENSION || h <= MIN_COMPRESSED_TEXTURE_DIMENSION)
+				break;
+			w /= 2;
+			h /= 2;
+		}
+		return bytes;
+	}
 
-	glEnable(m_target); //XXX legacy only
+	// eighths of a byte per texel, so DXT1 fits
+	size_t eighths;
+	switch (descriptor.format) {
+		case TEXTURE_RGBA_8888: eighths = compressTexture ? 8 : 32; break;
+		case TEXTURE_RGB_888: eighths = compressTexture ? 4 : 32; break; //RGB is padded to 4 bytes
+		case TEXTURE_LUMINANCE_ALPHA_88: eighths = 16; break;
+		case TEXTURE_INTENSITY_8: eighths = 8; break;
+		default: eighths = 32; break;
+	}
+	size_t bytes = (width * height * eighths) / 8;
+	// a full mip chain adds a third
+	if (descriptor.generateMipmaps)
+		bytes += bytes / 3;
+	return bytes;
+}
 
+TextureGL::TextureGL(const TextureDescriptor &descriptor, const bool useCompressed, TextureManager *manager) :
+	Texture(descriptor), m_target(GL_TEXTURE_2D), // XXX don't force target
+	m_texture(0),
 	// useCompressed is the global scope flag whereas descriptor.allowCompression is the local texture mode flag
 	// either both or neither might be true however only compress the texture when both are true.
-	const bool compressTexture = useCompressed && descriptor.allowCompression;
+	m_compress(useCompressed && descriptor.allowCompression),
+	m_sampleMode(descriptor.sampleMode),
+	m_manager(manager),
+	m_byteSize(EstimateByteSize(descriptor, m_compress)),
+	m_lastUsed(manager ? manager->GetFrame() : 0),
+	m_resident(false)
+{
+	Allocate();
+	if (m_manager)
+		m_manager->Add(this);
+}
+
+void TextureGL::Allocate()
+{
+	assert(!m_resident);
+	const TextureDescriptor &descriptor = GetDescriptor();
+
+	glGenTextures(1, &m_texture);
+	BindUnit(m_target, m_texture);
+
+	glEnable(m_target); //XXX legacy only
+
+	const bool compressTexture = m_compress;
 
 	switch (m_target) {
 		case GL_TEXTURE_2D:
@@ -114,7 +215,7 @@ TextureGL::TextureGL(const TextureDescriptor &descriptor, const bool useCompress
 	}
 
 	GLenum magFilter, minFilter, wrapS, wrapT;
-	switch (descriptor.sampleMode) {
+	switch (m_sampleMode) {
 		case LINEAR_CLAMP:
 			magFilter = GL_LINEAR;
 			minFilter = descriptor.generateMipmaps ? GL_LINEAR_MIPMAP_LINEAR : GL_LINEAR;
@@ -149,22 +250,43 @@ TextureGL::TextureGL(const TextureDescriptor &descriptor, const bool useCompress
 	glTexParameteri(m_target, GL_TEXTURE_MIN_FILTER, minFilter);
 
 	glDisable(m_target);  //XXX legacy only
+
+	m_resident = true;
 }
 
-TextureGL::~TextureGL()
+void TextureGL::Release()
 {
+	assert(m_resident);
 	glDeleteTextures(1, &m_texture);
+	// GL unbinds it everywhere, and the name may be handed out again
+	for (unsigned int i = 0; i < MAX_TRACKED_UNITS; i++)
+		if (s_boundTexture[i] == m_texture)
+			s_boundTexture[i] = 0;
+	m_texture = 0;
+	m_resident = false;
+}
+
+TextureGL::~TextureGL()
+{
+	if (m_resident)
+		Release();
+	if (m_manager)
+		m_manager->Remove(this);
 }
 
 void TextureGL::Update(const void *data, const vector2f &dataSize, TextureFormat format, const unsigned int numMips)
 {
+	if (!m_resident)
+		m_manager->Reload(this);
+
 	glEnable(m_target);  //XXX legacy only
-	glBindTexture(m_target, m_texture);
+	BindUnit(m_target, m_texture);
 
 	switch (m_target) {
 		case GL_TEXTURE_2D:
 			if (!IsCompressed(format)) {
 				glTexSubImage2D(m_target, 0, 0, 0, dataSize.x, dataSize.y, GLImageFormat(format), GLImageType(format), data);
+				Stats::Add(Stats::STAT_TEXTURE_BYTES_UPLOADED, Uint32(dataSize.x) * Uint32(dataSize.y) * GetTexelSize(format));
 			} else {
 				const GLint oglInternalFormat = GLImageFormat(format);
 				size_t Offset = 0;
@@ -175,6 +297,7 @@ void TextureGL::Update(const void *data, const vector2f &dataSize, TextureFormat
 				const unsigned char *pData = static_cast<const unsigned char*>(data);
 				for( unsigned int i = 0; i < numMips; ++i ) {
 					glCompressedTexSubImage2D(m_target, i, 0, 0, Width, Height, oglInternalFormat, bufSize, &pData[Offset]);
+					Stats::Add(Stats::STAT_TEXTURE_BYTES_UPLOADED, bufSize);
 					if( Width<=MIN_COMPRESSED_TEXTURE_DIMENSION || Height<=MIN_COMPRESSED_TEXTURE_DIMENSION ) {
 						break;
 					}
@@ -190,19 +313,73 @@ void TextureGL::Update(const void *data, const vector2f &dataSize, TextureFormat
 			assert(0);
 	}
 
-	glBindTexture(m_target, 0);
+	BindUnit(m_target, 0);
 	glDisable(m_target);  //XXX legacy only
 }
 
+bool TextureGL::GetCompressedImage(std::vector<unsigned char> &data, TextureFormat &format, unsigned int &numMips)
+{
+	const TextureDescriptor &descriptor = GetDescriptor();
+	if (!m_compress || !m_resident || m_target != GL_TEXTURE_2D || IsCompressed(descriptor.format))
+		return false;
+
+	// only what would be uploaded again as DXT. the driver is free to pick
+	// something else, so check what it actually did
+	const GLint wantFormat = GLCompressedInternalFormat(descriptor.format);
+	if (wantFormat == GL_COMPRESSED_RGBA_S3TC_DXT5_EXT) format = TEXTURE_DXT5;
+	else if (wantFormat == GL_COMPRESSED_RGB_S3TC_DXT1_EXT) format = TEXTURE_DXT1;
+	else return false;
+
+	BindUnit(m_target, m_texture);
+
+	GLint compressed = GL_FALSE, internalFormat = 0;
+	glGetTexLevelParameteriv(m_target, 0, GL_TEXTURE_COMPRESSED, &compressed);
+	glGetTexLevelParameteriv(m_target, 0, GL_TEXTURE_INTERNAL_FORMAT, &internalFormat);
+	bool ok = (compressed == GL_TRUE && internalFormat == wantFormat);
+
+	// the same levels Update takes for a DXT texture
+	data.clear();
+	numMips = 0;
+	size_t Width = descriptor.dataSize.x;
+	size_t Height = descriptor.dataSize.y;
+	while (ok) {
+		const size_t bufSize = ((Width + 3) / 4) * ((Height + 3) / 4) * GetMinSize(format);
+		GLint levelSize = 0;
+		glGetTexLevelParameteriv(m_target, numMips, GL_TEXTURE_COMPRESSED_IMAGE_SIZE, &levelSize);
+		if (size_t(levelSize) != bufSize) {
+			ok = false;
+			break;
+		}
+
+		const size_t offset = data.size();
+		data.resize(offset + bufSize);
+		glGetCompressedTexImage(m_target, numMips, &data[offset]);
+		++numMips;
+
+		if (!descriptor.generateMipmaps || Width<=MIN_COMPRESSED_TEXTURE_DIMENSION || Height<=MIN_COMPRESSED_TEXTURE_DIMENSION)
+			break;
+		Width /= 2;
+		Height /= 2;
+	}
+
+	BindUnit(m_target, 0);
+	return ok;
+}
+
 void TextureGL::Bind()
 {
+	if (m_manager) {
+		if (!m_resident)
+			m_manager->Reload(this);
+		m_lastUsed = m_manager->GetFrame();
+	}
 	glEnable(m_target);  //XXX legacy only
-	glBindTexture(m_target, m_texture);
+	BindUnit(m_target, m_texture);
 }
 
 void TextureGL::Unbind()
 {
-	glBindTexture(m_target, 0);
+	BindUnit(m_target, 0);
 	glDisable(m_target);  //XXX legacy only
 }
 
@@ -234,10 +411,12 @@ void TextureGL::SetSampleMode(TextureSampleMode mode)
 		default:
 			assert(0);
 	}
-	glBindTexture(m_target, m_texture);
+	m_sampleMode = mode;
+	if (!m_resident) return; //applied when it's loaded again
+	BindUnit(m_target, m_texture);
 	glTexParameteri(m_target, GL_TEXTURE_MAG_FILTER, magFilter);
 	glTexParameteri(m_target, GL_TEXTURE_MIN_FILTER, minFilter);
-	glBindTexture(m_target, 0);
+	BindUnit(m_target, 0);
 }
 
 }
@@ -9,25 +9,52 @@
 
 namespace Graphics {
 
+class TextureManager;
+
 class TextureGL : public Texture {
 public:
 	virtual void Update(const void *data, const vector2f &dataSize, TextureFormat format, const unsigned int numMips);
 
 	virtual ~TextureGL();
 
+	// bind to the active texture unit. binding a texture that's already
+	// bound there costs nothing
 	void Bind();
 	void Unbind();
 
 	virtual void SetSampleMode(TextureSampleMode);
+	virtual bool GetCompressedImage(std::vector<unsigned char> &data, TextureFormat &format, unsigned int &numMips);
 	GLuint GetTexture() const { return m_texture; }
 
+	// select the unit following binds go to, skipped if it already is
+	static void SetActiveUnit(unsigned int unit);
+	// forget what is known to be bound, for when GL state was changed
+	// behind our back (glPopAttrib with GL_TEXTURE_BIT)
+	static void InvalidateBindings();
+
 private:
 	friend class RendererLegacy;
 	friend class RendererGL2;
-	TextureGL(const TextureDescriptor &descriptor, const bool useCompressed);
+	friend class TextureManager;
+	// with a manager, the texture counts towards its budget
+	TextureGL(const TextureDescriptor &descriptor, const bool useCompressed, TextureManager *manager = 0);
+
+	static void BindUnit(GLenum target, GLuint texture);
+
+	// create and free the GL texture. data has to be uploaded again after
+	// an Allocate
+	void Allocate();
+	void Release();
 
 	GLenum m_target;
 	GLuint m_texture;
+	bool m_compress;
+	TextureSampleMode m_sampleMode;
+
+	TextureManager *m_manager;
+	size_t m_byteSize;
+	unsigned int m_lastUsed; //manager frame of the last bind
+	bool m_resident; //false while evicted
 };
 
 }
@@ -0,0 +1,115 @@
+// Copyright © 2008-2013 Pioneer Developers. See AUTHORS.txt for details
+// Licensed under the terms of the GPL v3. See licenses/GPL-3.txt
+
+#include "TextureLoader.h"
+#include "JobQueue.h"
+#include "OS.h"
+
+namespace Graphics {
+
+class TextureLoader::DecodeJob : public Job {
+public:
+	DecodeJob(TextureLoader *loader, const Key &key, TextureBuilder *builder) :
+		m_loader(loader), m_key(key), m_builder(builder) {}
+	virtual ~DecodeJob() { delete m_builder; }
+	virtual const char *GetName() const { return "TextureLoader::DecodeJob"; }
+
+	virtual void OnRun() {
+		// loads and converts the image, leaving only the upload
+		m_builder->GetDescriptor();
+	}
+
+	virtual void OnFinish() {
+		m_loader->OnDecoded(m_key, m_builder);
+		m_builder = 0;
+	}
+
+private:
+	TextureLoader *m_loader;
+	Key m_key;
+	TextureBuilder *m_builder;
+};
+
+TextureLoader::TextureLoader(Renderer *r, JobQueue *jobs)
+: m_renderer(r)
+, m_jobs(jobs)
+, m_jobGroup(jobs->NewGroup())
+{
+}
+
+TextureLoader::~TextureLoader()
+{
+	// none of them will call back after this
+	m_jobs->CancelGroup(m_jobGroup);
+
+	for (PendingMap::iterator it = m_pending.begin(); it != m_pending.end(); ++it)
+		delete it->second.builder;
+}
+
+void TextureLoader::Load(const TextureBuilder &builder, const std::string &type, RefCountedPtr<Material> material, TextureSlot slot, Texture *placeholder)
+{
+	const Key key(type, builder.GetFilename());
+	assert(!key.second.empty());
+
+	Texture *t = m_renderer->GetCachedTexture(key.first, key.second);
+	if (t) {
+		material.Get()->*slot = t;
+		return;
+	}
+
+	material.Get()->*slot = placeholder;
+
+	std::pair<PendingMap::iterator,bool> ins = m_pending.insert(std::make_pair(key, Pending()));
+	ins.first->second.users.push_back(User(material, slot));
+	if (!ins.second) return; //already on its way
+
+	DecodeJob *job = new DecodeJob(this, key, new TextureBuilder(builder));
+	job->SetGroup(m_jobGroup);
+	m_jobs->Queue(job);
+}
+
+void TextureLoader::OnDecoded(const Key &key, TextureBuilder *builder)
+{
+	PendingMap::iterator it = m_pending.find(key);
+	assert(it != m_pending.end() && !it->second.builder);
+	it->second.builder = builder;
+	m_decoded.push_back(key);
+}
+
+Uint32 TextureLoader::Update(const Uint32 maxMicroseconds)
+{
+	Uint32 uploaded = 0;
+
+	const Uint64 freq = OS::HFTimerFreq();
+	const Uint64 budget = (Uint64(maxMicroseconds) * freq) / 1000000;
+	const Uint64 start = maxMicroseconds ? OS::HFTimer() : 0;
+
+	while (!m_decoded.empty()) {
+		const Key key = m_decoded.front();
+		m_decoded.pop_front();
+
+		PendingMap::iterator it = m_pending.find(key);
+		assert(it != m_pending.end());
+		Pending &p = it->second;
+
+		// somebody may have loaded it the slow way in the meantime
+		Texture *t = m_renderer->GetCachedTexture(key.first, key.second);
+		if (!t) {
+			t = p.builder->CreateTexture(m_renderer);
+			m_renderer->AddCachedTexture(key.first, key.second, t);
+			uploaded++;
+		}
+		for (std::vector<User>::iterator user = p.users.begin(); user != p.users.end(); ++user)
+			user->first.Get()->*(user->second) = t;
+
+		delete p.builder;
+		m_pending.erase(it);
+
+		if (maxMicroseconds && OS::HFTimer() - start >= budget)
+			break;
+	}
+
+	return uploaded;
+}
+
+}
@@ -0,0 +1,75 @@
+// Copyright © 2008-2013 Pioneer Developers. See AUTHORS.txt for details
+// Licensed under the terms of the GPL v3. See licenses/GPL-3.txt
+
+#ifndef _TEXTURELOADER_H
+#define _TEXTURELOADER_H
+/*
+ * Loads textures without stalling the main thread. Reading, decoding and
+ * converting the image (everything TextureBuilder does before it has a
+ * descriptor) runs as a job on the JobQueue. The decoded images are then
+ * created and uploaded from the main thread by Update, as many per frame as
+ * fit in its time budget.
+ *
+ * Until then the material slot that asked for the texture holds a
+ * placeholder, and it's switched over once the real one is uploaded.
+ * Finished textures go in the renderer's texture cache just like with
+ * TextureBuilder::GetOrCreateTexture, so later requests find them there.
+ */
+#include "libs.h"
+#include "Material.h"
+#include "TextureBuilder.h"
+#include <deque>
+
+class JobQueue;
+
+namespace Graphics {
+
+class TextureLoader {
+public:
+	TextureLoader(Renderer *r, JobQueue *jobs);
+	~TextureLoader();
+
+	// one of the texture pointers of a material, eg. &Material::texture0
+	typedef Texture *Material::*TextureSlot;
+
+	// point the slot at the cached texture of this type and the builder's
+	// filename, or at the placeholder until that has been loaded. the
+	// material is kept alive until then
+	void Load(const TextureBuilder &builder, const std::string &type, RefCountedPtr<Material> material, TextureSlot slot, Texture *placeholder);
+
+	// call from the main loop, after JobQueue::FinishJobs. uploads decoded
+	// textures until maxMicroseconds have been spent; at least one is
+	// always done, and 0 uploads everything that's ready. returns the number
+	// uploaded
+	Uint32 Update(const Uint32 maxMicroseconds = 0);
+
+	// textures still being decoded or waiting to be uploaded
+	unsigned int GetNumPending() const { return m_pending.size(); }
+
+private:
+	class DecodeJob;
+	friend class DecodeJob;
+
+	typedef std::pair<std::string,std::string> Key; //type, name
+	typedef std::pair<RefCountedPtr<Material>,TextureSlot> User;
+
+	struct Pending {
+		Pending() : builder(0) {}
+		TextureBuilder *builder; //set once decoded
+		std::vector<User> users;
+	};
+	typedef std::map<Key,Pending> PendingMap;
+
+	void OnDecoded(const Key &key, TextureBuilder *builder);
+
+	Renderer *m_renderer;
+	JobQueue *m_jobs;
+	Uint32 m_jobGroup;
+
+	PendingMap m_pending;
+	std::deque<Key> m_decoded; //in the order they finished
+};
+
+}
+
+#endif
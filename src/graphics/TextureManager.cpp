@@ -0,0 +1,111 @@
+// Copyright © 2008-2013 Pioneer Developers. See AUTHORS.txt for details
+// Licensed under the terms of the GPL v3. See licenses/GPL-3.txt
+
+#include "TextureManager.h"
+#include "TextureGL.h"
+#include "MemoryStats.h"
+#include <algorithm>
+
+namespace Graphics {
+
+// textures used this recently are never evicted, however far over budget,
+// or they'd just be loaded again straight away
+static const unsigned int MIN_UNUSED_FRAMES = 2;
+
+TextureManager::TextureManager()
+: m_budget(0)
+, m_frame(0)
+{
+}
+
+TextureManager::~TextureManager()
+{
+	// some textures may outlive the renderer
+	for (std::vector<TextureGL*>::iterator it = m_textures.begin(); it != m_textures.end(); ++it)
+		(*it)->m_manager = 0;
+}
+
+void TextureManager::Add(TextureGL *t)
+{
+	m_textures.push_back(t);
+	m_stats.textures++;
+	m_stats.totalBytes += t->m_byteSize;
+	m_stats.residentBytes += t->m_byteSize;
+	MemoryStats::Add(MemoryStats::TEXTURES, t->m_byteSize);
+}
+
+void TextureManager::Remove(TextureGL *t)
+{
+	std::vector<TextureGL*>::iterator it = std::find(m_textures.begin(), m_textures.end(), t);
+	assert(it != m_textures.end());
+	m_textures.erase(it);
+	m_sources.erase(t);
+
+	m_stats.textures--;
+	m_stats.totalBytes -= t->m_byteSize;
+	if (t->m_resident) {
+		m_stats.residentBytes -= t->m_byteSize;
+		MemoryStats::Remove(MemoryStats::TEXTURES, t->m_byteSize);
+	} else
+		m_stats.evicted--;
+}
+
+void TextureManager::SetSource(Texture *t, const TextureBuilder &source)
+{
+	TextureGL *tex = static_cast<TextureGL*>(t);
+	if (tex->m_manager != this) return;
+	m_sources.erase(tex);
+	m_sources.insert(std::make_pair(tex, source));
+}
+
+void TextureManager::Evict(TextureGL *t)
+{
+	assert(t->m_resident);
+	t->Release();
+	m_stats.residentBytes -= t->m_byteSize;
+	MemoryStats::Remove(MemoryStats::TEXTURES, t->m_byteSize);
+	m_stats.evicted++;
+	m_stats.evictions++;
+}
+
+void TextureManager::Reload(TextureGL *t)
+{
+	assert(!t->m_resident);
+	SourceMap::iterator it = m_sources.find(t);
+	assert(it != m_sources.end());
+
+	// a fresh copy each time, so the decoded image doesn't stay around
+	TextureBuilder builder(it->second);
+	builder.GetDescriptor();
+	t->Allocate();
+	builder.UpdateTexture(t);
+
+	m_stats.residentBytes += t->m_byteSize;
+	MemoryStats::Add(MemoryStats::TEXTURES, t->m_byteSize);
+	m_stats.evicted--;
+	m_stats.reloads++;
+}
+
+bool TextureManager::IsLessRecentlyUsed(const TextureGL *a, const TextureGL *b)
+{
+	return a->m_lastUsed < b->m_lastUsed;
+}
+
+void TextureManager::EndFrame()
+{
+	m_frame++;
+	if (!m_budget || m_stats.residentBytes <= m_budget) return;
+
+	std::vector<TextureGL*> candidates;
+	for (SourceMap::const_iterator it = m_sources.begin(); it != m_sources.end(); ++it) {
+		TextureGL *t = it->first;
+		if (t->m_resident && m_frame - t->m_lastUsed > MIN_UNUSED_FRAMES)
+			candidates.push_back(t);
+	}
+	std::sort(candidates.begin(), candidates.end(), IsLessRecentlyUsed);
+
+	for (std::vector<TextureGL*>::iterator it = candidates.begin(); it != candidates.end() && m_stats.residentBytes > m_budget; ++it)
+		Evict(*it);
+}
+
+}
@@ -0,0 +1,73 @@
+// Copyright © 2008-2013 Pioneer Developers. See AUTHORS.txt for details
+// Licensed under the terms of the GPL v3. See licenses/GPL-3.txt
+
+#ifndef _TEXTUREMANAGER_H
+#define _TEXTUREMANAGER_H
+/*
+ * Keeps track of how much video memory the textures of a renderer take, and
+ * keeps it within a budget if one is set. Textures that were loaded from a
+ * file (TextureBuilder tells the manager where from) can be evicted: when
+ * over budget at the end of a frame, the least recently used of them have
+ * their storage freed. An evicted texture is read back from its file the
+ * next time it's bound.
+ *
+ * Textures that can't be loaded again (render targets, fonts, generated
+ * ones) count towards the total but are never evicted.
+ */
+#include "libs.h"
+#include "TextureBuilder.h"
+
+namespace Graphics {
+
+class Texture;
+class TextureGL;
+
+class TextureManager {
+public:
+	TextureManager();
+	~TextureManager();
+
+	// bytes of texture memory to stay under, 0 for no limit
+	void SetBudget(size_t bytes) { m_budget = bytes; }
+	size_t GetBudget() const { return m_budget; }
+
+	// remember where the texture came from, so it can be evicted
+	void SetSource(Texture *t, const TextureBuilder &source);
+
+	// frames count the age of textures. evicts if over budget
+	void EndFrame();
+	unsigned int GetFrame() const { return m_frame; }
+
+	struct Stats {
+		Stats() : textures(0), totalBytes(0), residentBytes(0), evicted(0), evictions(0), reloads(0) {}
+		unsigned int textures;
+		size_t totalBytes; //with every texture loaded
+		size_t residentBytes;
+		unsigned int evicted; //right now
+		unsigned int evictions; //since the last ResetCounts
+		unsigned int reloads;
+	};
+	const Stats &GetStats() const { return m_stats; }
+	void ResetCounts() { m_stats.evictions = m_stats.reloads = 0; }
+
+private:
+	friend class TextureGL;
+	void Add(TextureGL *t);
+	void Remove(TextureGL *t);
+	void Reload(TextureGL *t);
+
+	void Evict(TextureGL *t);
+	static bool IsLessRecentlyUsed(const TextureGL *a, const TextureGL *b);
+
+	size_t m_budget;
+	unsigned int m_frame;
+	Stats m_stats;
+
+	std::vector<TextureGL*> m_textures;
+	typedef std::map<TextureGL*,TextureBuilder> SourceMap;
+	SourceMap m_sources;
+};
+
+}
+
+#endif
@@ -0,0 +1,116 @@
+// Copyright © 2008-2013 Pioneer Developers. See AUTHORS.txt for details
+// Licensed under the terms of the GPL v3. See licenses/GPL-3.txt
+
+#include "VertexBuffer.h"
+#include <cstring>
+
+namespace Graphics {
+
+// the order they are interleaved in
+static const VertexAttrib s_attribOrder[] = {
+	ATTRIB_POSITION,
+	ATTRIB_NORMAL,
+	ATTRIB_DIFFUSE,
+	ATTRIB_UV0
+};
+static const int NUM_ATTRIBS = COUNTOF(s_attribOrder);
+
+VertexBufferDesc::VertexBufferDesc()
+: attribs(0)
+, numVertices(0)
+, usage(BUFFER_USAGE_STATIC)
+{
+}
+
+unsigned int VertexBufferDesc::GetAttribSize(VertexAttrib attrib)
+{
+	switch (attrib) {
+		case ATTRIB_POSITION: return sizeof(vector3f);
+		case ATTRIB_NORMAL:   return sizeof(vector3f);
+		case ATTRIB_DIFFUSE:  return sizeof(Color);
+		case ATTRIB_UV0:      return sizeof(vector2f);
+		default:              return 0;
+	}
+}
+
+unsigned int VertexBufferDesc::GetStride() const
+{
+	unsigned int stride = 0;
+	for (int i = 0; i < NUM_ATTRIBS; i++)
+		if (attribs & s_attribOrder[i])
+			stride += GetAttribSize(s_attribOrder[i]);
+	return stride;
+}
+
+unsigned int VertexBufferDesc::GetOffset(VertexAttrib attrib) const
+{
+	assert(attribs & attrib);
+	unsigned int offset = 0;
+	for (int i = 0; i < NUM_ATTRIBS && s_attribOrder[i] != attrib; i++)
+		if (attribs & s_attribOrder[i])
+			offset += GetAttribSize(s_attribOrder[i]);
+	return offset;
+}
+
+void VertexBuffer::SetVertexCount(unsigned int count)
+{
+	assert(count <= m_desc.numVertices);
+	m_numVertices = count;
+}
+
+template <typename T>
+static void interleave(Uint8 *out, unsigned int stride, const std::vector<T> &in, unsigned int count)
+{
+	for (unsigned int i = 0; i < count; i++, out += stride)
+		memcpy(out, &in[i], sizeof(T));
+}
+
+bool VertexBuffer::Populate(const VertexArray &va)
+{
+	assert((va.GetAttributeSet() & m_desc.attribs) == m_desc.attribs);
+
+	const unsigned int count = va.GetNumVerts();
+	if (count > m_desc.numVertices)
+		return false;
+
+	const unsigned int stride = m_desc.GetStride();
+	Uint8 *data = static_cast<Uint8*>(Map());
+	if (!data) return false;
+
+	if (count > 0) {
+		if (m_desc.attribs & ATTRIB_POSITION)
+			interleave(data + m_desc.GetOffset(ATTRIB_POSITION), stride, va.position, count);
+		if (m_desc.attribs & ATTRIB_NORMAL)
+			interleave(data + m_desc.GetOffset(ATTRIB_NORMAL), stride, va.normal, count);
+		if (m_desc.attribs & ATTRIB_DIFFUSE)
+			interleave(data + m_desc.GetOffset(ATTRIB_DIFFUSE), stride, va.diffuse, count);
+		if (m_desc.attribs & ATTRIB_UV0)
+			interleave(data + m_desc.GetOffset(ATTRIB_UV0), stride, va.uv0, count);
+	}
+
+	Unmap();
+	m_numVertices = count;
+	return true;
+}
+
+void IndexBuffer::SetIndexCount(unsigned int count)
+{
+	assert(count <= m_size);
+	m_numIndices = count;
+}
+
+bool IndexBuffer::Populate(const Uint16 *indices, unsigned int count)
+{
+	if (count > m_size)
+		return false;
+
+	Uint16 *data = Map();
+	if (!data) return false;
+	memcpy(data, indices, count * sizeof(Uint16));
+	Unmap();
+
+	m_numIndices = count;
+	return true;
+}
+
+}
@@ -0,0 +1,94 @@
+// Copyright © 2008-2013 Pioneer Developers. See AUTHORS.txt for details
+// Licensed under the terms of the GPL v3. See licenses/GPL-3.txt
+
+#ifndef _VERTEXBUFFER_H
+#define _VERTEXBUFFER_H
+/*
+ * Vertex and index storage that lives with the renderer (in video memory,
+ * for GL) instead of being sent over for every draw like a VertexArray.
+ * Users request them with Renderer::CreateVertexBuffer/CreateIndexBuffer,
+ * fill them, and draw them with Renderer::DrawBuffer/DrawBufferIndexed as
+ * often as they like.
+ *
+ * Vertices are interleaved, attributes in this order: position, normal,
+ * diffuse, uv0. Positions and normals are three floats, diffuse is four
+ * and uv0 two.
+ */
+#include "libs.h"
+#include "Renderer.h"
+#include "VertexArray.h"
+#include <RefCounted.h>
+
+namespace Graphics {
+
+struct VertexBufferDesc {
+	VertexBufferDesc();
+
+	AttributeSet attribs;
+	unsigned int numVertices; //capacity
+	BufferUsage usage;
+
+	// bytes from one vertex to the next
+	unsigned int GetStride() const;
+	// bytes from the start of a vertex to the attribute
+	unsigned int GetOffset(VertexAttrib attrib) const;
+
+	static unsigned int GetAttribSize(VertexAttrib attrib);
+};
+
+class VertexBuffer : public RefCounted {
+public:
+	VertexBuffer(const VertexBufferDesc &desc) : m_desc(desc), m_numVertices(0) { }
+	virtual ~VertexBuffer() { }
+
+	const VertexBufferDesc &GetDesc() const { return m_desc; }
+
+	// the number of vertices that get drawn, from the start
+	unsigned int GetVertexCount() const { return m_numVertices; }
+	void SetVertexCount(unsigned int count);
+
+	// replace the contents with the vertices of the array and draw that
+	// many. the array needs at least the attributes of the buffer, others
+	// are ignored. returns false if they won't fit
+	bool Populate(const VertexArray &va);
+
+	// write access to the whole buffer, interleaved as above. the old
+	// contents are not kept
+	virtual void *Map() = 0;
+	virtual void Unmap() = 0;
+
+protected:
+	VertexBufferDesc m_desc;
+	unsigned int m_numVertices;
+};
+
+class IndexBuffer : public RefCounted {
+public:
+	IndexBuffer(unsigned int size, BufferUsage usage) : m_size(size), m_numIndices(0), m_usage(usage) { }
+	virtual ~IndexBuffer() { }
+
+	unsigned int GetSize() const { return m_size; }
+	BufferUsage GetUsage() const { return m_usage; }
+
+	// the number of indices that get drawn, from the start
+	unsigned int GetIndexCount() const { return m_numIndices; }
+	void SetIndexCount(unsigned int count);
+
+	// replace the contents and draw that many. returns false if they
+	// won't fit
+	bool Populate(const Uint16 *indices, unsigned int count);
+	bool Populate(const std::vector<Uint16> &indices) { return !indices.empty() && Populate(&indices[0], indices.size()); }
+
+	// write access to the whole buffer. the old contents are not kept
+	virtual Uint16 *Map() = 0;
+	virtual void Unmap() = 0;
+
+protected:
+	unsigned int m_size;
+	unsigned int m_numIndices;
+	BufferUsage m_usage;
+};
+
+}
+
+#endif
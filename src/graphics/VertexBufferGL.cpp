@@ -0,0 +1,185 @@
+// Copyright © 2008-2013 Pioneer Developers. See AUTHORS.txt for details
+// Licensed under the terms of the GPL v3. See licenses/GPL-3.txt
+
+#include "VertexBufferGL.h"
+#include "Stats.h"
+#include <cstring>
+
+namespace Graphics {
+
+// stream writes start on this boundary, enough for any attribute type
+static const unsigned int STREAM_ALIGNMENT = 16;
+
+static GLenum usage_hint(BufferUsage usage)
+{
+	switch (usage) {
+		case BUFFER_USAGE_DYNAMIC: return GL_DYNAMIC_DRAW_ARB;
+		case BUFFER_USAGE_STREAM:  return GL_STREAM_DRAW_ARB;
+		default:                   return GL_STATIC_DRAW_ARB;
+	}
+}
+
+VertexBufferGL::VertexBufferGL(const VertexBufferDesc &desc)
+: VertexBuffer(desc)
+, m_usageHint(usage_hint(desc.usage))
+{
+	glGenBuffersARB(1, &m_buffer);
+	glBindBufferARB(GL_ARRAY_BUFFER_ARB, m_buffer);
+	glBufferDataARB(GL_ARRAY_BUFFER_ARB, desc.GetStride() * desc.numVertices, 0, m_usageHint);
+	glBindBufferARB(GL_ARRAY_BUFFER_ARB, 0);
+}
+
+VertexBufferGL::~VertexBufferGL()
+{
+	glDeleteBuffersARB(1, &m_buffer);
+}
+
+void *VertexBufferGL::Map()
+{
+	glBindBufferARB(GL_ARRAY_BUFFER_ARB, m_buffer);
+	// orphan the old contents, so mapping doesn't wait for draws still
+	// using them
+	glBufferDataARB(GL_ARRAY_BUFFER_ARB, m_desc.GetStride() * m_desc.numVertices, 0, m_usageHint);
+	// everything mapped is taken to be written
+	Stats::Add(Stats::STAT_BUFFER_BYTES_UPLOADED, m_desc.GetStride() * m_desc.numVertices);
+	Stats::Add(Stats::STAT_VERTICES_UPLOADED, m_desc.numVertices);
+	return glMapBufferARB(GL_ARRAY_BUFFER_ARB, GL_WRITE_ONLY_ARB);
+}
+
+void VertexBufferGL::Unmap()
+{
+	glUnmapBufferARB(GL_ARRAY_BUFFER_ARB);
+	glBindBufferARB(GL_ARRAY_BUFFER_ARB, 0);
+}
+
+void VertexBufferGL::Bind()
+{
+	glBindBufferARB(GL_ARRAY_BUFFER_ARB, m_buffer);
+
+	const GLsizei stride = m_desc.GetStride();
+	if (m_desc.attribs & ATTRIB_POSITION) {
+		glEnableClientState(GL_VERTEX_ARRAY);
+		glVertexPointer(3, GL_FLOAT, stride, reinterpret_cast<const GLvoid *>(size_t(m_desc.GetOffset(ATTRIB_POSITION))));
+	}
+	if (m_desc.attribs & ATTRIB_NORMAL) {
+		glEnableClientState(GL_NORMAL_ARRAY);
+		glNormalPointer(GL_FLOAT, stride, reinterpret_cast<const GLvoid *>(size_t(m_desc.GetOffset(ATTRIB_NORMAL))));
+	}
+	if (m_desc.attribs & ATTRIB_DIFFUSE) {
+		glEnableClientState(GL_COLOR_ARRAY);
+		glColorPointer(4, GL_FLOAT, stride, reinterpret_cast<const GLvoid *>(size_t(m_desc.GetOffset(ATTRIB_DIFFUSE))));
+	}
+	if (m_desc.attribs & ATTRIB_UV0) {
+		glEnableClientState(GL_TEXTURE_COORD_ARRAY);
+		glTexCoordPointer(2, GL_FLOAT, stride, reinterpret_cast<const GLvoid *>(size_t(m_desc.GetOffset(ATTRIB_UV0))));
+	}
+}
+
+void VertexBufferGL::Unbind()
+{
+	if (m_desc.attribs & ATTRIB_POSITION)
+		glDisableClientState(GL_VERTEX_ARRAY);
+	if (m_desc.attribs & ATTRIB_NORMAL)
+		glDisableClientState(GL_NORMAL_ARRAY);
+	if (m_desc.attribs & ATTRIB_DIFFUSE)
+		glDisableClientState(GL_COLOR_ARRAY);
+	if (m_desc.attribs & ATTRIB_UV0)
+		glDisableClientState(GL_TEXTURE_COORD_ARRAY);
+	glBindBufferARB(GL_ARRAY_BUFFER_ARB, 0);
+}
+
+IndexBufferGL::IndexBufferGL(unsigned int size, BufferUsage usage)
+: IndexBuffer(size, usage)
+, m_usageHint(usage_hint(usage))
+{
+	glGenBuffersARB(1, &m_buffer);
+	glBindBufferARB(GL_ELEMENT_ARRAY_BUFFER_ARB, m_buffer);
+	glBufferDataARB(GL_ELEMENT_ARRAY_BUFFER_ARB, sizeof(Uint16) * size, 0, m_usageHint);
+	glBindBufferARB(GL_ELEMENT_ARRAY_BUFFER_ARB, 0);
+}
+
+IndexBufferGL::~IndexBufferGL()
+{
+	glDeleteBuffersARB(1, &m_buffer);
+}
+
+Uint16 *IndexBufferGL::Map()
+{
+	glBindBufferARB(GL_ELEMENT_ARRAY_BUFFER_ARB, m_buffer);
+	glBufferDataARB(GL_ELEMENT_ARRAY_BUFFER_ARB, sizeof(Uint16) * m_size, 0, m_usageHint);
+	Stats::Add(Stats::STAT_BUFFER_BYTES_UPLOADED, sizeof(Uint16) * m_size);
+	return static_cast<Uint16*>(glMapBufferARB(GL_ELEMENT_ARRAY_BUFFER_ARB, GL_WRITE_ONLY_ARB));
+}
+
+void IndexBufferGL::Unmap()
+{
+	glUnmapBufferARB(GL_ELEMENT_ARRAY_BUFFER_ARB);
+	glBindBufferARB(GL_ELEMENT_ARRAY_BUFFER_ARB, 0);
+}
+
+void IndexBufferGL::Bind()
+{
+	glBindBufferARB(GL_ELEMENT_ARRAY_BUFFER_ARB, m_buffer);
+}
+
+void IndexBufferGL::Unbind()
+{
+	glBindBufferARB(GL_ELEMENT_ARRAY_BUFFER_ARB, 0);
+}
+
+StreamBufferGL::StreamBufferGL(GLenum target, unsigned int size)
+: m_target(target)
+, m_size(size)
+, m_offset(0)
+, m_useMapRange(glewIsSupported("GL_ARB_map_buffer_range"))
+{
+	glGenBuffersARB(1, &m_buffer);
+	glBindBufferARB(m_target, m_buffer);
+	glBufferDataARB(m_target, m_size, 0, GL_STREAM_DRAW_ARB);
+	glBindBufferARB(m_target, 0);
+}
+
+StreamBufferGL::~StreamBufferGL()
+{
+	glDeleteBuffersARB(1, &m_buffer);
+}
+
+const GLvoid *StreamBufferGL::Write(const void *data, unsigned int size)
+{
+	const unsigned int alignedSize = (size + STREAM_ALIGNMENT - 1) & ~(STREAM_ALIGNMENT - 1);
+	// too big ones are still pulled over by the driver
+	Stats::Add(Stats::STAT_BUFFER_BYTES_UPLOADED, size);
+	if (alignedSize > m_size) {
+		glBindBufferARB(m_target, 0);
+		return data;
+	}
+
+	glBindBufferARB(m_target, m_buffer);
+
+	if (m_offset + alignedSize > m_size) {
+		glBufferDataARB(m_target, m_size, 0, GL_STREAM_DRAW_ARB);
+		m_offset = 0;
+	}
+
+	// nothing before the next orphaning is ever written twice, so there's
+	// nothing to synchronise with
+	void *p = 0;
+	if (m_useMapRange)
+		p = glMapBufferRange(m_target, m_offset, size, GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_RANGE_BIT | GL_MAP_UNSYNCHRONIZED_BIT);
+	if (p) {
+		memcpy(p, data, size);
+		glUnmapBufferARB(m_target);
+	} else
+		glBufferSubDataARB(m_target, m_offset, size, data);
+
+	const GLvoid *where = reinterpret_cast<const GLvoid *>(size_t(m_offset));
+	m_offset += alignedSize;
+	return where;
+}
+
+void StreamBufferGL::Unbind()
+{
+	glBindBufferARB(m_target, 0);
+}
+
+}
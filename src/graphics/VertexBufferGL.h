@@ -0,0 +1,79 @@
+// Copyright © 2008-2013 Pioneer Developers. See AUTHORS.txt for details
+// Licensed under the terms of the GPL v3. See licenses/GPL-3.txt
+
+#ifndef _VERTEXBUFFERGL_H
+#define _VERTEXBUFFERGL_H
+/*
+ * Buffer object backed VertexBuffer and IndexBuffer, plus the stream
+ * buffers the renderer sends transient arrays through.
+ * Used by both the Legacy and GL2 renderers
+ */
+#include "VertexBuffer.h"
+
+namespace Graphics {
+
+class VertexBufferGL : public VertexBuffer {
+public:
+	VertexBufferGL(const VertexBufferDesc &desc);
+	virtual ~VertexBufferGL();
+
+	virtual void *Map();
+	virtual void Unmap();
+
+	// bind, and point the enabled vertex arrays into the buffer
+	void Bind();
+	// disable the vertex arrays again
+	void Unbind();
+
+private:
+	GLuint m_buffer;
+	GLenum m_usageHint;
+};
+
+class IndexBufferGL : public IndexBuffer {
+public:
+	IndexBufferGL(unsigned int size, BufferUsage usage);
+	virtual ~IndexBufferGL();
+
+	virtual Uint16 *Map();
+	virtual void Unmap();
+
+	void Bind();
+	void Unbind();
+
+private:
+	GLuint m_buffer;
+	GLenum m_usageHint;
+};
+
+/*
+ * A ring of buffer storage that per-draw data is written into back to back.
+ * Each write goes to a part of the buffer the GPU isn't using, so it never
+ * has to wait: when the end is reached the storage is orphaned (the driver
+ * hands over a fresh block and frees the old one once the draws using it
+ * are done) and writing starts from the beginning again.
+ */
+class StreamBufferGL {
+public:
+	StreamBufferGL(GLenum target, unsigned int size);
+	~StreamBufferGL();
+
+	// copy the data in and leave the buffer bound. the returned pointer is
+	// for gl*Pointer or glDrawElements. data too big for the ring isn't
+	// copied; the buffer is unbound and the data pointer comes back, to be
+	// used as a plain client array
+	const GLvoid *Write(const void *data, unsigned int size);
+
+	void Unbind();
+
+private:
+	GLenum m_target;
+	GLuint m_buffer;
+	unsigned int m_size;
+	unsigned int m_offset;
+	bool m_useMapRange;
+};
+
+}
+
+#endif
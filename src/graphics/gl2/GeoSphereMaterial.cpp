@@ -59,6 +59,10 @@ Program *GeoSphereSurfaceMaterial::CreateProgram(const MaterialDescriptor &desc)
 		ss << "#define TERRAIN_WITH_LAVA\n";
 	if (desc.effect == EFFECT_GEOSPHERE_TERRAIN_WITH_WATER)
 		ss << "#define TERRAIN_WITH_WATER\n";
+	if (desc.packedNormals)
+		ss << "#define TERRAIN_PACKED_NORMALS\n";
+	if (desc.geomorph)
+		ss << "#define TERRAIN_GEOMORPH\n";
 	return new Graphics::GL2::GeoSphereProgram("geosphere_terrain", ss.str());
 }
 
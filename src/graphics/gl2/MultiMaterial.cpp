@@ -36,6 +36,11 @@ MultiProgram::MultiProgram(const MaterialDescriptor &desc, int lights)
 		ss << "#define MAP_EMISSIVE\n";
 	if (desc.usePatterns)
 		ss << "#define MAP_COLOR\n";
+	if (desc.instanced) {
+		ss << "#extension GL_ARB_draw_instanced : enable\n";
+		ss << "#define INSTANCED\n";
+		ss << stringf("#define MAX_INSTANCES %0{d}\n", int(MAX_INSTANCES));
+	}
 
 	m_name = "multi";
 	m_defines = ss.str();
@@ -44,8 +49,22 @@ MultiProgram::MultiProgram(const MaterialDescriptor &desc, int lights)
 	InitUniforms();
 }
 
+void MultiProgram::InitUniforms()
+{
+	Program::InitUniforms();
+	instanceTransforms.Init("instanceTransforms", m_program);
+}
+
+MultiMaterial::MultiMaterial()
+: m_instancedProgram(0)
+, m_activeProgram(0)
+, m_instanced(false)
+{
+}
+
 LitMultiMaterial::LitMultiMaterial()
 : m_programs()
+, m_instancedPrograms()
 , m_curNumLights(0)
 {
 }
@@ -67,9 +86,25 @@ void LitMultiMaterial::SetProgram(Program *p)
 	m_program = p;
 }
 
+Program *MultiMaterial::GetInstancedProgram()
+{
+	if (!m_instancedProgram)
+		m_instancedProgram = m_renderer->GetOrCreateInstancedProgram(this);
+	return m_instancedProgram;
+}
+
+Program *LitMultiMaterial::GetInstancedProgram()
+{
+	//one per light variation, same as the plain ones
+	if (!m_instancedPrograms[m_curNumLights])
+		m_instancedPrograms[m_curNumLights] = m_renderer->GetOrCreateInstancedProgram(this);
+	return m_instancedPrograms[m_curNumLights];
+}
+
 void MultiMaterial::Apply()
 {
-	MultiProgram *p = static_cast<MultiProgram*>(m_program);
+	m_activeProgram = m_instanced ? GetInstancedProgram() : m_program;
+	MultiProgram *p = static_cast<MultiProgram*>(m_activeProgram);
 	p->Use();
 	p->invLogZfarPlus1.Set(m_renderer->m_invLogZfarPlus1);
 
@@ -100,7 +135,7 @@ void LitMultiMaterial::Apply()
 
 	MultiMaterial::Apply();
 
-	MultiProgram *p = static_cast<MultiProgram*>(m_program);
+	MultiProgram *p = GetActiveProgram();
 	p->emission.Set(this->emissive);
 	p->specular.Set(this->specular);
 	p->shininess.Set(float(this->shininess));
@@ -113,24 +148,24 @@ void MultiMaterial::Unapply()
 	// Might not be necessary to unbind textures, but let's not old graphics code (eg, old-UI)
 	if (texture4) {
 		static_cast<TextureGL*>(texture4)->Unbind();
-		glActiveTexture(GL_TEXTURE3);
+		TextureGL::SetActiveUnit(3);
 	}
 	if (texture3) {
 		static_cast<TextureGL*>(texture3)->Unbind();
-		glActiveTexture(GL_TEXTURE2);
+		TextureGL::SetActiveUnit(2);
 	}
 	if (texture2) {
 		static_cast<TextureGL*>(texture2)->Unbind();
-		glActiveTexture(GL_TEXTURE1);
+		TextureGL::SetActiveUnit(1);
 	}
 	if (texture1) {
 		static_cast<TextureGL*>(texture1)->Unbind();
-		glActiveTexture(GL_TEXTURE0);
+		TextureGL::SetActiveUnit(0);
 	}
 	if (texture0) {
 		static_cast<TextureGL*>(texture0)->Unbind();
 	}
-	m_program->Unuse();
+	m_activeProgram->Unuse();
 }
 
 }
@@ -17,13 +17,34 @@ namespace Graphics {
 		class MultiProgram : public Program {
 		public:
 			MultiProgram(const MaterialDescriptor &, int lights=0);
+
+			// the instanced variant draws this many copies per call at most,
+			// each placed by one of instanceTransforms (modelview matrices)
+			static const int MAX_INSTANCES = 16;
+			Uniform instanceTransforms;
+
+		protected:
+			virtual void InitUniforms();
 		};
 
 		class MultiMaterial : public Material { //unlit
 		public:
+			MultiMaterial();
 			virtual Program *CreateProgram(const MaterialDescriptor &);
 			virtual void Apply();
 			virtual void Unapply();
+
+			// apply the instanced variant of the program from now on, which
+			// ignores the modelview matrix for the instanceTransforms
+			void SetInstanced(bool instanced) { m_instanced = instanced; }
+			// the program the last Apply used
+			MultiProgram *GetActiveProgram() const { return static_cast<MultiProgram*>(m_activeProgram); }
+
+		protected:
+			virtual Program *GetInstancedProgram();
+			Program *m_instancedProgram;
+			Program *m_activeProgram;
+			bool m_instanced;
 		};
 
 		/*
@@ -37,8 +58,12 @@ namespace Graphics {
 			virtual void SetProgram(Program *p);
 			virtual void Apply();
 
+		protected:
+			virtual Program *GetInstancedProgram();
+
 		private:
 			Program* m_programs[5];
+			Program* m_instancedPrograms[5];
 			int m_curNumLights;
 		};
 	}
@@ -7,6 +7,11 @@
 #include "StringF.h"
 #include "OS.h"
 #include "graphics/Graphics.h"
+#include "graphics/Stats.h"
+
+extern "C" {
+#include "jenkins/lookup3.h"
+}
 
 namespace Graphics {
 
@@ -62,16 +67,16 @@ static bool check_glsl_errors(const char *filename, GLuint obj)
 }
 
 struct Shader {
-	Shader(GLenum type, const std::string &filename, const std::string &defines) {
-		RefCountedPtr<FileSystem::FileData> code = FileSystem::gameDataFiles.ReadFile(filename);
+	Shader(GLenum type, const std::string &filename, const std::string &defines) : type(type), shader(0), filename(filename) {
+		code = FileSystem::gameDataFiles.ReadFile(filename);
 
 		if (!code)
 			OS::Error("Could not load %s", filename.c_str());
 
 		// Load some common code
-		RefCountedPtr<FileSystem::FileData> logzCode = FileSystem::gameDataFiles.ReadFile("shaders/gl2/logz.glsl");
+		logzCode = FileSystem::gameDataFiles.ReadFile("shaders/gl2/logz.glsl");
 		assert(logzCode);
-		RefCountedPtr<FileSystem::FileData> libsCode = FileSystem::gameDataFiles.ReadFile("shaders/gl2/lib.glsl");
+		libsCode = FileSystem::gameDataFiles.ReadFile("shaders/gl2/lib.glsl");
 		assert(libsCode);
 
 		AppendSource(s_glslVersion);
@@ -83,18 +88,30 @@ struct Shader {
 		AppendSource(logzCode->AsStringRange().StripUTF8BOM());
 		AppendSource(libsCode->AsStringRange().StripUTF8BOM());
 		AppendSource(code->AsStringRange().StripUTF8BOM());
+	};
+
+	~Shader() {
+		if (shader) glDeleteShader(shader);
+	}
+
+	// add the complete source to the running hash in a, b
+	void Hash(Uint32 &a, Uint32 &b) const {
+		for (unsigned int i = 0; i < blocks.size(); i++)
+			lookup3_hashlittle2(blocks[i], block_sizes[i], &a, &b);
+	}
+
+	void Compile() {
+		assert(blocks.size() == block_sizes.size());
 		shader = glCreateShader(type);
-		Compile(shader);
+		glShaderSource(shader, blocks.size(), &blocks[0], &block_sizes[0]);
+		glCompileShader(shader);
 
 		// CheckGLSL may use OS::Warning instead of OS::Error so the game may still (attempt to) run
 		if (!check_glsl_errors(filename.c_str(), shader))
 			throw ShaderException();
-	};
-
-	~Shader() {
-		glDeleteShader(shader);
 	}
 
+	GLenum type;
 	GLuint shader;
 
 private:
@@ -110,17 +127,136 @@ private:
 		block_sizes.push_back(str.Size());
 	}
 
-	void Compile(GLuint shader_id)
-	{
-		assert(blocks.size() == block_sizes.size());
-		glShaderSource(shader_id, blocks.size(), &blocks[0], &block_sizes[0]);
-		glCompileShader(shader_id);
-	}
-
+	std::string filename;
+	// the blocks point into these
+	RefCountedPtr<FileSystem::FileData> code, logzCode, libsCode;
 	std::vector<const char*> blocks;
 	std::vector<GLint> block_sizes;
 };
 
+// Linked programs can be kept in the user dir, so they don't have to be
+// compiled again next time. A binary is only good for the driver that made
+// it and for the exact same sources, so the header records both
+static const char CACHE_DIR_NAME[] = "shadercache";
+
+// bump this if the header layout changes
+static const Uint32 CACHE_VERSION = 1;
+
+struct BinaryHeader {
+	char magic[4];
+	Uint32 version;
+	Uint32 driverHashA;
+	Uint32 driverHashB;
+	Uint32 sourceHashA;
+	Uint32 sourceHashB;
+	Uint32 format;
+	Uint32 size;
+};
+
+static const char CACHE_MAGIC[4] = { 'P', 'S', 'P', 'B' };
+
+static bool s_binaryCache = false;
+
+void Program::SetBinaryCacheEnabled(bool enabled)
+{
+	s_binaryCache = enabled && glewIsSupported("GL_ARB_get_program_binary") &&
+		FileSystem::userFiles.MakeDirectory(CACHE_DIR_NAME);
+}
+
+bool Program::IsBinaryCacheEnabled()
+{
+	return s_binaryCache;
+}
+
+std::string Program::GetBinaryCachePath(const std::string &name)
+{
+	return FileSystem::JoinPathBelow(CACHE_DIR_NAME, name);
+}
+
+// the header that a binary of these shaders from this driver has to have
+static BinaryHeader MakeHeader(const Shader &vs, const Shader &fs)
+{
+	BinaryHeader header;
+	memcpy(header.magic, CACHE_MAGIC, sizeof(CACHE_MAGIC));
+	header.version = CACHE_VERSION;
+
+	header.driverHashA = header.driverHashB = 0;
+	const GLenum strings[] = { GL_VENDOR, GL_RENDERER, GL_VERSION };
+	for (unsigned int i = 0; i < COUNTOF(strings); i++) {
+		const char *str = reinterpret_cast<const char*>(glGetString(strings[i]));
+		if (str) lookup3_hashlittle2(str, std::strlen(str), &header.driverHashA, &header.driverHashB);
+	}
+
+	header.sourceHashA = header.sourceHashB = 0;
+	vs.Hash(header.sourceHashA, header.sourceHashB);
+	fs.Hash(header.sourceHashA, header.sourceHashB);
+
+	header.format = 0;
+	header.size = 0;
+	return header;
+}
+
+static std::string BinaryFileName(const BinaryHeader &header)
+{
+	char buf[32];
+	snprintf(buf, sizeof(buf), "%08x%08x", header.sourceHashA, header.sourceHashB);
+	return Program::GetBinaryCachePath(buf);
+}
+
+// link the program from the cached binary, if there's one that fits
+static bool LoadBinary(GLuint program, const BinaryHeader &want)
+{
+	FILE *f = FileSystem::userFiles.OpenReadStream(BinaryFileName(want));
+	if (!f) return false;
+
+	BinaryHeader header;
+	bool ok = (fread(&header, sizeof(header), 1, f) == 1) &&
+		(memcmp(header.magic, want.magic, sizeof(want.magic)) == 0) &&
+		header.version == want.version &&
+		header.driverHashA == want.driverHashA &&
+		header.driverHashB == want.driverHashB &&
+		header.sourceHashA == want.sourceHashA &&
+		header.sourceHashB == want.sourceHashB &&
+		header.size > 0;
+
+	std::vector<char> binary;
+	if (ok) {
+		binary.resize(header.size);
+		ok = fread(&binary[0], header.size, 1, f) == 1;
+	}
+	fclose(f);
+	if (!ok) return false;
+
+	// the driver may still turn it down, after an update that kept the
+	// version string for instance
+	glProgramBinary(program, header.format, &binary[0], header.size);
+	GLint status = GL_FALSE;
+	glGetProgramiv(program, GL_LINK_STATUS, &status);
+	return status == GL_TRUE;
+}
+
+static void SaveBinary(GLuint program, BinaryHeader header)
+{
+	GLint length = 0;
+	glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &length);
+	if (length <= 0) return;
+
+	std::vector<char> binary(length);
+	GLenum format = 0;
+	glGetProgramBinary(program, length, &length, &format, &binary[0]);
+	if (length <= 0) return;
+	header.format = format;
+	header.size = length;
+
+	// a short write leaves a file that fails the checks in LoadBinary, so
+	// the program just gets compiled again next time
+	FILE *f = FileSystem::userFiles.OpenWriteStream(BinaryFileName(header));
+	if (!f) return;
+	fwrite(&header, sizeof(header), 1, f);
+	fwrite(&binary[0], length, 1, f);
+	fclose(f);
+}
+
 Program::Program()
 : m_name("")
 , m_defines("")
@@ -153,6 +289,7 @@ void Program::Reload()
 void Program::Use()
 {
 	glUseProgram(m_program);
+	Stats::Add(Stats::STAT_PROGRAM_SWITCHES);
 }
 
 void Program::Unuse()
@@ -165,17 +302,34 @@ void Program::LoadShaders(const std::string &name, const std::string &defines)
 {
 	const std::string filename = std::string("shaders/gl2/") + name;
 
-	//load, create and compile shaders
+	//load shaders
 	Shader vs(GL_VERTEX_SHADER, filename + ".vert", defines);
 	Shader fs(GL_FRAGMENT_SHADER, filename + ".frag", defines);
 
-	//create program, attach shaders and link
 	m_program = glCreateProgram();
+
+	BinaryHeader header = {};
+	if (s_binaryCache) {
+		header = MakeHeader(vs, fs);
+		if (LoadBinary(m_program, header))
+			return;
+
+		// a failed glProgramBinary may leave the program in a state where
+		// linking it from the shaders is not allowed
+		glDeleteProgram(m_program);
+		m_program = glCreateProgram();
+		glProgramParameteri(m_program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+	}
+
+	//compile shaders, attach them and link
+	vs.Compile();
+	fs.Compile();
 	glAttachShader(m_program, vs.shader);
 	glAttachShader(m_program, fs.shader);
 	glLinkProgram(m_program);
 
-	check_glsl_errors(name.c_str(), m_program);
+	if (check_glsl_errors(name.c_str(), m_program) && s_binaryCache)
+		SaveBinary(m_program, header);
 
 	//shaders may now be deleted by Shader destructor
 }
@@ -40,6 +40,14 @@ namespace Graphics {
 
 			Uniform sceneAmbient;
 
+			// keep linked programs in the user dir and load them from there
+			// when the driver and the sources haven't changed. needs
+			// GL_ARB_get_program_binary, otherwise it stays off
+			static void SetBinaryCacheEnabled(bool enabled);
+			static bool IsBinaryCacheEnabled();
+			// a file in the cache dir
+			static std::string GetBinaryCachePath(const std::string &name);
+
 		protected:
 			void LoadShaders(const std::string&, const std::string &defines);
 			virtual void InitUniforms();
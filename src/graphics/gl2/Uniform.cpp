@@ -3,68 +3,90 @@
 
 #include "Uniform.h"
 #include "graphics/TextureGL.h"
+#include <cstring>
 
 namespace Graphics {
 namespace GL2 {
 
 Uniform::Uniform()
 : m_location(-1)
+, m_valueSize(0)
 {
 }
 
 void Uniform::Init(const char *name, GLuint program)
 {
 	m_location = glGetUniformLocation(program, name);
+	// a new (or relinked) program starts with its defaults
+	m_valueSize = 0;
+}
+
+bool Uniform::Changed(const void *value, unsigned int size)
+{
+	assert(size <= sizeof(m_value));
+	if (size == m_valueSize && memcmp(m_value, value, size) == 0)
+		return false;
+	memcpy(m_value, value, size);
+	m_valueSize = size;
+	return true;
 }
 
 void Uniform::Set(int i)
 {
-	if (m_location != -1)
+	if (m_location != -1 && Changed(&i, sizeof(i)))
 		glUniform1i(m_location, i);
 }
 
 void Uniform::Set(float f)
 {
-	if (m_location != -1)
+	if (m_location != -1 && Changed(&f, sizeof(f)))
 		glUniform1f(m_location, f);
 }
 
 void Uniform::Set(const vector3f &v)
 {
-	if (m_location != -1)
+	if (m_location != -1 && Changed(&v[0], sizeof(float)*3))
 		glUniform3f(m_location, v.x, v.y, v.z);
 }
 
 void Uniform::Set(const vector3d &v)
 {
-	if (m_location != -1)
-		glUniform3f(m_location, v.x, v.y, v.z); //yes, 3f
+	Set(vector3f(float(v.x), float(v.y), float(v.z))); //yes, 3f
 }
 
 void Uniform::Set(const Color4f &c)
 {
-	if (m_location != -1)
+	const float f[4] = { c.r, c.g, c.b, c.a };
+	if (m_location != -1 && Changed(f, sizeof(f)))
 		glUniform4f(m_location, c.r, c.g, c.b, c.a);
 }
 
 void Uniform::Set(const int v[3])
 {
-	if (m_location != -1)
+	if (m_location != -1 && Changed(v, sizeof(int)*3))
 		glUniform3i(m_location, v[0],v[1],v[2]);
 }
 
 void Uniform::Set(const float m[9])
 {
-	if (m_location != -1)
+	if (m_location != -1 && Changed(m, sizeof(float)*9))
 		glUniformMatrix3fv(m_location, 1, false, m);
 }
 
+void Uniform::Set(const matrix4x4f *m, int count)
+{
+	// too big to be worth comparing, and different nearly every time
+	m_valueSize = 0;
+	if (m_location != -1)
+		glUniformMatrix4fv(m_location, count, false, &m[0][0]);
+}
+
 void Uniform::Set(Texture *tex, unsigned int unit)
 {
 	if (m_location != -1 && tex) {
-		glActiveTexture(GL_TEXTURE0 + unit);
+		TextureGL::SetActiveUnit(unit);
 		static_cast<TextureGL*>(tex)->Bind();
-		glUniform1i(m_location, unit);
+		Set(int(unit));
 	}
 }
 
@@ -5,6 +5,8 @@
 #define _GL2_UNIFORM_H
 /*
  * Shader uniform
+ * Remembers the value last given to the program, so setting the same one
+ * again (every material Apply does that for most of them) skips the GL call
  */
 #include "libs.h"
 namespace Graphics {
@@ -23,10 +25,18 @@ namespace Graphics {
 			void Set(const Color4f&);
 			void Set(const int v[3]);
 			void Set(const float m[9]);
+			void Set(const matrix4x4f *m, int count); //mat4 array
 			void Set(Texture *t, unsigned int unit);
 
 		//private:
 			GLint m_location;
+
+		private:
+			// store the value and return true if it differs from the last one
+			bool Changed(const void *value, unsigned int size);
+
+			float m_value[9]; //largest cached is a mat3
+			unsigned int m_valueSize; //0: nothing set yet
 		};
 	}
 }
@@ -3,7 +3,9 @@
 
 #include "libs.h"
 #include "Gui.h"
+#include "Profiler.h"
 #include "graphics/Graphics.h"
+#include "graphics/Stats.h"
 
 namespace Gui {
 
@@ -72,6 +74,8 @@ sigc::connection AddTimer(Uint32 ms, sigc::slot<void> slot)
 
 void Draw()
 {
+	PROFILE_ZONE("Gui::Draw");
+
 	Uint32 t = SDL_GetTicks();
 	// also abused like an update() function...
 	for (std::list<TimerSignal*>::iterator i = g_timeSignals.begin(); i != g_timeSignals.end();) {
@@ -180,6 +184,7 @@ namespace Theme {
 		glEnableClientState(GL_VERTEX_ARRAY);
 		glVertexPointer(2, GL_FLOAT, 0, vertices);
 		glDrawElements(GL_QUADS, 16, GL_UNSIGNED_BYTE, indices);
+		Graphics::Stats::AddDraw(GL_QUADS, 16);
 		glDisableClientState(GL_VERTEX_ARRAY);
 	}
 
@@ -201,10 +206,13 @@ namespace Theme {
 		glVertexPointer(2, GL_FLOAT, 0, vertices);
 		glColor3fv(Colors::bgShadow);
 		glDrawElements(GL_QUADS, 8, GL_UNSIGNED_BYTE, indices);
+		Graphics::Stats::AddDraw(GL_QUADS, 8);
 		glColor3f(.6f,.6f,.6f);
 		glDrawElements(GL_QUADS, 8, GL_UNSIGNED_BYTE, indices+8);
+		Graphics::Stats::AddDraw(GL_QUADS, 8);
 		glColor3fv(Colors::bg);
 		glDrawElements(GL_QUADS, 4, GL_UNSIGNED_BYTE, indices+16);
+		Graphics::Stats::AddDraw(GL_QUADS, 4);
 		glDisableClientState(GL_VERTEX_ARRAY);
 	}
 
@@ -226,10 +234,13 @@ namespace Theme {
 		glVertexPointer(2, GL_FLOAT, 0, vertices);
 		glColor3f(.6f,.6f,.6f);
 		glDrawElements(GL_QUADS, 8, GL_UNSIGNED_BYTE, indices);
+		Graphics::Stats::AddDraw(GL_QUADS, 8);
 		glColor3fv(Colors::bgShadow);
 		glDrawElements(GL_QUADS, 8, GL_UNSIGNED_BYTE, indices+8);
+		Graphics::Stats::AddDraw(GL_QUADS, 8);
 		glColor3fv(Colors::bg);
 		glDrawElements(GL_QUADS, 4, GL_UNSIGNED_BYTE, indices+16);
+		Graphics::Stats::AddDraw(GL_QUADS, 4);
 		glDisableClientState(GL_VERTEX_ARRAY);
 	}
 }
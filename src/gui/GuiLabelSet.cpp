@@ -2,6 +2,7 @@
 // Licensed under the terms of the GPL v3. See licenses/GPL-3.txt
 
 #include "Gui.h"
+#include "graphics/Renderer.h"
 
 namespace Gui {
 
@@ -11,7 +12,17 @@ LabelSet::LabelSet() : Widget()
 	m_labelsVisible = true;
 	m_labelsClickable = true;
 	m_labelColor = Color::WHITE;
-	m_font = Screen::GetFont();
+	// as high as the current font, as they always have been
+	m_labelHeight = Screen::GetFontHeight();
+
+	m_labelFont = Text::DistanceFieldFont::GetLabelFont(Screen::GetRenderer());
+	m_vertices.Reset(m_labelFont->CreateVertexArray());
+
+	Graphics::MaterialDescriptor desc;
+	desc.textures = 1;
+	desc.alphaTest = true;
+	m_material.Reset(Screen::GetRenderer()->CreateMaterial(desc));
+	m_material->texture0 = m_labelFont->GetTexture();
 }
 
 bool LabelSet::OnMouseDown(Gui::MouseButtonEvent *e)
@@ -56,11 +67,34 @@ void LabelSet::Clear()
 	m_items.clear();
 }
 
+static inline bool same_color(const Color &a, const Color &b)
+{
+	return a.r == b.r && a.g == b.g && a.b == b.b && a.a == b.a;
+}
+
 void LabelSet::Draw()
 {
 	if (!m_labelsVisible) return;
-	for (std::vector<LabelSetItem>::iterator i = m_items.begin(); i != m_items.end(); ++i)
-		Gui::Screen::RenderString((*i).text, (*i).screenx, (*i).screeny - Gui::Screen::GetFontHeight()*0.5f, (*i).hasOwnColor ? (*i).color : m_labelColor, m_font.Get());
+
+	// there are only ever a few colours, so each one just goes through the
+	// whole list
+	std::vector<bool> drawn(m_items.size(), false);
+	for (std::size_t i = 0; i < m_items.size(); i++) {
+		if (drawn[i]) continue;
+		const Color color = m_items[i].hasOwnColor ? m_items[i].color : m_labelColor;
+
+		m_vertices->Clear();
+		for (std::size_t j = i; j < m_items.size(); j++) {
+			const LabelSetItem &item = m_items[j];
+			if (drawn[j] || !same_color(item.hasOwnColor ? item.color : m_labelColor, color)) continue;
+			m_labelFont->AddScreenText(*m_vertices, item.text, vector2f(item.screenx, item.screeny - m_labelHeight*0.5f), m_labelHeight);
+			drawn[j] = true;
+		}
+
+		if (!m_vertices->GetNumVerts()) continue;
+		m_material->diffuse = color;
+		Screen::GetRenderer()->DrawTriangles(m_vertices.Get(), m_material.Get());
+	}
 }
 
 void LabelSet::GetSizeRequested(float size[2])
@@ -5,11 +5,17 @@
 #define GUILABELSET_H
 
 #include "GuiWidget.h"
+#include "text/DistanceFieldFont.h"
+#include "graphics/Material.h"
+#include "graphics/VertexArray.h"
 #include <vector>
 
 /*
  * Collection of clickable labels. Used by the WorldView for clickable
  * bodies, and SystemView, SectorView etc.
+ *
+ * Labels are drawn with the shared distance field label font, all the
+ * labels of a colour in one go.
  */
 namespace Gui {
 class LabelSet: public Widget {
@@ -57,7 +63,11 @@ private:
 	bool m_labelsClickable;
 	Color m_labelColor;
 
-	RefCountedPtr<Text::TextureFont> m_font;
+	float m_labelHeight;
+
+	RefCountedPtr<Text::DistanceFieldFont> m_labelFont;
+	ScopedPtr<Graphics::VertexArray> m_vertices;
+	RefCountedPtr<Graphics::Material> m_material;
 };
 }
 
@@ -9,41 +9,15 @@ static const float PARAGRAPH_SPACING = 1.5f;
 
 namespace Gui {
 
-static double _clip[2][4];
-static vector3d _clipoffset;
-static bool _do_clip;
-
-static void init_clip_test()
-{
-	matrix4x4d m;
-	if (glIsEnabled(GL_CLIP_PLANE1)) {
-		glGetClipPlane(GL_CLIP_PLANE1, _clip[0]);
-		glGetClipPlane(GL_CLIP_PLANE3, _clip[1]);
-
-		glGetDoublev (GL_MODELVIEW_MATRIX, &m[0]);
-		_clipoffset.x = m[12];
-		_clipoffset.y = m[13];
-		_clipoffset.z = 0;
-
-		_do_clip = true;
-	} else {
-		_do_clip = false;
-	}
-}
-
-/* does a line of text pass top and bottom clip planes? */
-static bool line_clip_test(float topy, float bottomy)
+TextLayout::Geometry::Geometry() :
+	vertices(Graphics::ATTRIB_POSITION | Graphics::ATTRIB_DIFFUSE | Graphics::ATTRIB_UV0),
+	valid(false),
+	width(0.0f)
 {
-	if (!_do_clip) return true;
-	topy = _clipoffset.y + topy*Gui::Screen::GetCoords2Pixels()[1];
-	bottomy = _clipoffset.y + bottomy*Gui::Screen::GetCoords2Pixels()[1];
-
-	if ((bottomy*_clip[0][1] + _clip[0][3] > 0) &&
-	    (topy*_clip[1][1] + _clip[1][3] > 0)) return true;
-	return false;
 }
 
-TextLayout::TextLayout(const char *_str, RefCountedPtr<Text::TextureFont> font, ColourMarkupMode markup)
+TextLayout::TextLayout(const char *_str, RefCountedPtr<Text::TextureFont> font, ColourMarkupMode markup) :
+	m_lastGeometry(0)
 {
 	// XXX ColourMarkupSkip not correctly implemented yet
 	assert(markup != ColourMarkupSkip);
@@ -102,7 +76,12 @@ void TextLayout::MeasureSize(const float width, float outSize[2]) const
 	outSize[1] = ceil(outSize[1] * fontScale[1]);
 }
 
-void TextLayout::Render(const float width, const Color &color) const
+static bool same_color(const Color &a, const Color &b)
+{
+	return a.r == b.r && a.g == b.g && a.b == b.b && a.a == b.a;
+}
+
+void TextLayout::Render(const float width, const Color &color)
 {
 	float fontScale[2];
 	Gui::Screen::GetCoords2Pixels(fontScale);
@@ -115,16 +94,36 @@ void TextLayout::Render(const float width, const Color &color) const
 	glTranslatef(floor(x/fontScale[0])*fontScale[0],
 			floor(y/fontScale[1])*fontScale[1], 0);
 	glScalef(fontScale[0], fontScale[1], 1);
-	_RenderRaw(width / fontScale[0], color);
+
+	// use the geometry made for this width and colour, or replace the one
+	// that wasn't used last
+	const float layoutWidth = width / fontScale[0];
+	int g = m_lastGeometry;
+	if (!m_geometry[g].valid || m_geometry[g].width != layoutWidth || !same_color(m_geometry[g].color, color)) {
+		g = 1 - g;
+		if (!m_geometry[g].valid || m_geometry[g].width != layoutWidth || !same_color(m_geometry[g].color, color))
+			UpdateGeometry(m_geometry[g], layoutWidth, color);
+	}
+	m_lastGeometry = g;
+	m_font->RenderGeometry(m_geometry[g].vertices, m_geometry[g].buffer.Get());
+
 	glPopMatrix();
 }
 
-void TextLayout::_RenderRaw(float maxWidth, const Color &color) const
+void TextLayout::SetJustified(bool v)
 {
-	float py = 0;
-	init_clip_test();
+	m_justify = v;
+	m_geometry[0].valid = m_geometry[1].valid = false;
+}
 
-	glPushMatrix();
+void TextLayout::UpdateGeometry(Geometry &geom, float maxWidth, const Color &color)
+{
+	geom.vertices.Clear();
+	geom.valid = true;
+	geom.width = maxWidth;
+	geom.color = color;
+
+	float py = 0;
 
 	const float spaceWidth = m_font->GetGlyph(' ').advx;
 
@@ -164,24 +163,21 @@ void TextLayout::_RenderRaw(float maxWidth, const Color &color) const
 			_spaceWidth = spaceWidth;
 		}
 
-		if (line_clip_test(py, py+m_font->GetHeight()*2.0)) {
-			float px = 0;
-			for (int j=0; j<num; j++) {
-				if ((*wpos).word) {
-					if (m_colourMarkup == ColourMarkupUse)
-						c = m_font->RenderMarkup((*wpos).word, round(px), round(py), c);
-					else
-						m_font->RenderString((*wpos).word, round(px), round(py), c);
-				}
-				px += (*wpos).advx + _spaceWidth;
-				wpos++;
+		float px = 0;
+		for (int j=0; j<num; j++) {
+			if ((*wpos).word) {
+				if (m_colourMarkup == ColourMarkupUse)
+					c = m_font->CreateMarkupGeometry(geom.vertices, (*wpos).word, round(px), round(py), c);
+				else
+					m_font->CreateGeometry(geom.vertices, (*wpos).word, round(px), round(py), c);
 			}
-		} else {
-			for (int j=0; j<num; j++) wpos++;
+			px += (*wpos).advx + _spaceWidth;
+			wpos++;
 		}
 		py += m_font->GetHeight() * (explicit_newline ? PARAGRAPH_SPACING : 1.0f);
 	}
-	glPopMatrix();
+
+	geom.buffer.Reset(geom.vertices.GetNumVerts() ? m_font->CreateBuffer(geom.vertices) : 0);
 }
 
 void TextLayout::_MeasureSizeRaw(const float layoutWidth, float outSize[2]) const
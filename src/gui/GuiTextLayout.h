@@ -15,12 +15,13 @@ public:
 		ColourMarkupUse   // interprets markup tags
 	};
 	explicit TextLayout(const char *_str, RefCountedPtr<Text::TextureFont> font = RefCountedPtr<Text::TextureFont>(0), ColourMarkupMode markup = ColourMarkupUse);
-	void Render(float layoutWidth, const Color &color = Color::WHITE) const;
+	// the text's geometry is kept between frames, and only made again when
+	// the width or colour it's drawn with changes
+	void Render(float layoutWidth, const Color &color = Color::WHITE);
 	void MeasureSize(const float layoutWidth, float outSize[2]) const;
-	void _RenderRaw(float layoutWidth, const Color &color) const;
 	void _MeasureSizeRaw(const float layoutWidth, float outSize[2]) const;
 	~TextLayout() { free(str); }
-	void SetJustified(bool v) { m_justify = v; }
+	void SetJustified(bool v);
 private:
 	struct word_t {
 		char *word;
@@ -33,6 +34,21 @@ private:
 	ColourMarkupMode m_colourMarkup;
 
 	RefCountedPtr<Text::TextureFont> m_font;
+
+	// there are two, so a label drawn with a shadow doesn't make both
+	// again every frame
+	struct Geometry {
+		Geometry();
+		Graphics::VertexArray vertices;
+		RefCountedPtr<Graphics::VertexBuffer> buffer;
+		bool valid;
+		float width;
+		Color color;
+	};
+	Geometry m_geometry[2];
+	int m_lastGeometry;
+
+	void UpdateGeometry(Geometry &geom, float layoutWidth, const Color &color);
 };
 }
 
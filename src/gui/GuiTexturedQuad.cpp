@@ -12,13 +12,6 @@ namespace Gui {
 
 void TexturedQuad::Draw(Graphics::Renderer *renderer, const vector2f &pos, const vector2f &size, const vector2f &texPos, const vector2f &texSize, const Color &tint)
 {
-    Graphics::VertexArray va(ATTRIB_POSITION | ATTRIB_UV0);
-
-	va.Add(vector3f(pos.x,        pos.y,        0.0f), vector2f(texPos.x,           texPos.y));
-	va.Add(vector3f(pos.x,        pos.y+size.y, 0.0f), vector2f(texPos.x,           texPos.y+texSize.y));
-	va.Add(vector3f(pos.x+size.x, pos.y,        0.0f), vector2f(texPos.x+texSize.x, texPos.y));
-	va.Add(vector3f(pos.x+size.x, pos.y+size.y, 0.0f), vector2f(texPos.x+texSize.x, texPos.y+texSize.y));
-
 	// Create material on first use. Bit of a hack.
 	if (!m_material.Valid()) {
 		Graphics::MaterialDescriptor desc;
@@ -27,6 +20,40 @@ void TexturedQuad::Draw(Graphics::Renderer *renderer, const vector2f &pos, const
 		m_material->texture0 = m_texture.Get();
 	}
 	m_material->diffuse = tint;
+
+	const bool same = m_buffer.Valid() &&
+		pos.x == m_bufferPos.x && pos.y == m_bufferPos.y &&
+		size.x == m_bufferSize.x && size.y == m_bufferSize.y &&
+		texPos.x == m_bufferTexPos.x && texPos.y == m_bufferTexPos.y &&
+		texSize.x == m_bufferTexSize.x && texSize.y == m_bufferTexSize.y;
+	if (same) {
+		renderer->DrawBuffer(m_buffer.Get(), m_material.Get(), TRIANGLE_STRIP);
+		return;
+	}
+
+	Graphics::VertexArray va(ATTRIB_POSITION | ATTRIB_UV0);
+
+	va.Add(vector3f(pos.x,        pos.y,        0.0f), vector2f(texPos.x,           texPos.y));
+	va.Add(vector3f(pos.x,        pos.y+size.y, 0.0f), vector2f(texPos.x,           texPos.y+texSize.y));
+	va.Add(vector3f(pos.x+size.x, pos.y,        0.0f), vector2f(texPos.x+texSize.x, texPos.y));
+	va.Add(vector3f(pos.x+size.x, pos.y+size.y, 0.0f), vector2f(texPos.x+texSize.x, texPos.y+texSize.y));
+
+	if (!m_buffer.Valid()) {
+		Graphics::VertexBufferDesc desc;
+		desc.attribs = ATTRIB_POSITION | ATTRIB_UV0;
+		desc.numVertices = 4;
+		desc.usage = BUFFER_USAGE_DYNAMIC;
+		m_buffer.Reset(renderer->CreateVertexBuffer(desc));
+	}
+	if (m_buffer.Valid() && m_buffer->Populate(va)) {
+		m_bufferPos = pos;
+		m_bufferSize = size;
+		m_bufferTexPos = texPos;
+		m_bufferTexSize = texSize;
+	}
+	else
+		m_buffer.Reset(0);
+
 	renderer->DrawTriangles(&va, m_material.Get(), TRIANGLE_STRIP);
 }
 
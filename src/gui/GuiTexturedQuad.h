@@ -6,6 +6,7 @@
 
 #include "graphics/Texture.h"
 #include "graphics/Drawables.h"
+#include "graphics/VertexBuffer.h"
 #include "RefCounted.h"
 #include "Color.h"
 
@@ -32,6 +33,10 @@ public:
 private:
 	RefCountedPtr<Graphics::Texture> m_texture;
 	ScopedPtr<Graphics::Material> m_material;
+
+	// the quad last drawn, made again only when it moves or changes size
+	RefCountedPtr<Graphics::VertexBuffer> m_buffer;
+	vector2f m_bufferPos, m_bufferSize, m_bufferTexPos, m_bufferTexSize;
 };
 
 }
@@ -0,0 +1,148 @@
+// Copyright © 2008-2013 Pioneer Developers. See AUTHORS.txt for details
+// Licensed under the terms of the GPL v3. See licenses/GPL-3.txt
+
+// times the hashes and checksums the caches use over a buffer of random
+// bytes: CRC32 against the byte at a time way it used to be done (and
+// checks they agree), lookup3 and Hash64. every size is run a few times and
+// the best time kept
+//
+// hashbench [-seed n] [-size megabytes] [-runs n]
+
+#include "libs.h"
+#include "OS.h"
+#include "CRC32.h"
+#include "Hash.h"
+
+extern "C" {
+#include "jenkins/lookup3.h"
+}
+
+static const size_t SMALL_SIZES[] = { 16, 64, 256, 4096 };
+
+// the old CRC32::AddData, to check against and to beat
+class ByteCRC32 {
+public:
+	ByteCRC32() : m_checksum(0xffffffff) {
+		if (!s_tableGenerated) {
+			for (Uint32 i = 0; i <= 0xff; i++) {
+				Uint32 c = i;
+				for (int j = 0; j < 8; j++)
+					c = (c & 1) ? (c >> 1) ^ 0xedb88320 : c >> 1;
+				s_table[i] = c;
+			}
+			s_tableGenerated = true;
+		}
+	}
+
+	void AddData(const char *data, int length) {
+		const unsigned char *buf = reinterpret_cast<const unsigned char *>(data);
+		while (length--)
+			m_checksum = (m_checksum >> 8) ^ s_table[(m_checksum & 0xff) ^ *buf++];
+	}
+	Uint32 GetChecksum() const { return m_checksum; }
+
+private:
+	Uint32 m_checksum;
+	static bool s_tableGenerated;
+	static Uint32 s_table[256];
+};
+
+bool ByteCRC32::s_tableGenerated;
+Uint32 ByteCRC32::s_table[256];
+
+struct ByteCRCHash {
+	Uint64 operator()(const char *data, size_t length) const {
+		ByteCRC32 crc;
+		crc.AddData(data, int(length));
+		return crc.GetChecksum();
+	}
+};
+
+struct CRCHash {
+	Uint64 operator()(const char *data, size_t length) const {
+		CRC32 crc;
+		crc.AddData(data, int(length));
+		return crc.GetChecksum();
+	}
+};
+
+struct Lookup3Hash {
+	Uint64 operator()(const char *data, size_t length) const {
+		Uint32 a = 0, b = 0;
+		lookup3_hashlittle2(data, length, &a, &b);
+		return (Uint64(a) << 32) | b;
+	}
+};
+
+struct Hash64Hash {
+	Uint64 operator()(const char *data, size_t length) const {
+		return Hash64(data, length);
+	}
+};
+
+// hashes the buffer in pieces of the given size, returns the best MB/s
+template <typename H>
+static double bench(const H &hash, const std::vector<char> &buffer, size_t piece, int runs, Uint64 &result)
+{
+	const size_t pieces = buffer.size() / piece;
+	double best = 0.0;
+	for (int run = 0; run < runs; run++) {
+		Uint64 sum = 0;
+		const Uint64 start = OS::HFTimer();
+		for (size_t i = 0; i < pieces; i++)
+			sum += hash(&buffer[i * piece], piece);
+		const double elapsed = double(OS::HFTimer() - start) / double(OS::HFTimerFreq());
+		result = sum;
+		if (elapsed > 0.0)
+			best = std::max(best, double(pieces * piece) / (elapsed * 1024.0 * 1024.0));
+	}
+	return best;
+}
+
+static void bench_size(const std::vector<char> &buffer, size_t piece, int runs)
+{
+	Uint64 byteCRC, crc, lookup3, hash64;
+	const double byteSpeed = bench(ByteCRCHash(), buffer, piece, runs, byteCRC);
+	const double crcSpeed = bench(CRCHash(), buffer, piece, runs, crc);
+	const double lookup3Speed = bench(Lookup3Hash(), buffer, piece, runs, lookup3);
+	const double hash64Speed = bench(Hash64Hash(), buffer, piece, runs, hash64);
+
+	printf("  %9d bytes: crc32 bytewise %8.1f, crc32 %8.1f, lookup3 %8.1f, hash64 %8.1f MB/s%s\n",
+		int(piece), byteSpeed, crcSpeed, lookup3Speed, hash64Speed, crc == byteCRC ? "" : "  CRC32 MISMATCH");
+	if (crc != byteCRC) exit(1);
+}
+
+int main(int argc, char **argv)
+{
+	Uint32 seed = 0;
+	int sizeMB = 64;
+	int runs = 3;
+
+	for (int i = 1; i < argc; i++) {
+		const std::string arg(argv[i]);
+		if (i+1 >= argc) {
+			fprintf(stderr, "usage: hashbench [-seed n] [-size megabytes] [-runs n]\n");
+			return 1;
+		}
+		const int value = atoi(argv[++i]);
+		if (arg == "-seed") seed = value;
+		else if (arg == "-size") sizeMB = std::max(1, value);
+		else if (arg == "-runs") runs = std::max(1, value);
+		else {
+			fprintf(stderr, "hashbench: unknown option %s\n", arg.c_str());
+			return 1;
+		}
+	}
+
+	std::vector<char> buffer(size_t(sizeMB) * 1024 * 1024);
+	Random rng(seed);
+	for (size_t i = 0; i < buffer.size(); i++)
+		buffer[i] = char(rng.Int32() & 0xff);
+
+	printf("%d MB of random bytes, in pieces of:\n", sizeMB);
+	for (unsigned int i = 0; i < COUNTOF(SMALL_SIZES); i++)
+		bench_size(buffer, SMALL_SIZES[i], runs);
+	bench_size(buffer, buffer.size(), runs);
+
+	return 0;
+}
@@ -9,6 +9,10 @@
 enum RunMode {
 	MODE_GAME,
 	MODE_MODELVIEWER,
+	MODE_MODELCOMPILER,
+	MODE_MODELBENCHMARK,
+	MODE_BENCHMARK,
+	MODE_SAVEBENCHMARK,
 	MODE_VERSION,
 	MODE_USAGE,
 	MODE_USAGE_ERROR
@@ -37,6 +41,26 @@ int main(int argc, char** argv)
 			goto start;
 		}
 
+		if (modeopt == "modelcompiler" || modeopt == "mc") {
+			mode = MODE_MODELCOMPILER;
+			goto start;
+		}
+
+		if (modeopt == "modelbenchmark" || modeopt == "mb") {
+			mode = MODE_MODELBENCHMARK;
+			goto start;
+		}
+
+		if (modeopt == "benchmark" || modeopt == "b") {
+			mode = MODE_BENCHMARK;
+			goto start;
+		}
+
+		if (modeopt == "savebenchmark" || modeopt == "sb") {
+			mode = MODE_SAVEBENCHMARK;
+			goto start;
+		}
+
 		if (modeopt == "version" || modeopt == "v") {
 			mode = MODE_VERSION;
 			goto start;
@@ -66,6 +90,44 @@ start:
 			break;
 		}
 
+		case MODE_MODELCOMPILER: {
+			std::string modelName;
+			if (argc > 2)
+				modelName = argv[2];
+			return ModelViewer::Compile(modelName) ? 1 : 0;
+		}
+
+		case MODE_MODELBENCHMARK: {
+			const std::string report = argc > 2 ? argv[2] : "modelbench.csv";
+			std::vector<std::string> modelNames;
+			for (int i = 3; i < argc; i++)
+				modelNames.push_back(argv[i]);
+			return ModelViewer::Benchmark(report, modelNames) ? 1 : 0;
+		}
+
+		case MODE_BENCHMARK: {
+			const int ticks = argc > 2 ? atoi(argv[2]) : 6000;
+			const int timeAccel = argc > 3 ? atoi(argv[3]) : 1;
+			const std::string start = argc > 4 ? argv[4] : "0,0,0,0,0";
+			Pi::Init();
+			if (Pi::Benchmark(start, ticks, timeAccel) != 0)
+				return 1;
+			Pi::Quit();
+			break;
+		}
+
+		case MODE_SAVEBENCHMARK: {
+			const int ships = argc > 2 ? atoi(argv[2]) : 500;
+			const int missions = argc > 3 ? atoi(argv[3]) : 500;
+			const int logEntries = argc > 4 ? atoi(argv[4]) : 10000;
+			const std::string start = argc > 5 ? argv[5] : "0,0,0,0,0";
+			Pi::Init();
+			if (Pi::SaveBenchmark(start, ships, missions, logEntries) != 0)
+				return 1;
+			Pi::Quit();
+			break;
+		}
+
 		case MODE_VERSION: {
 			std::string version(PIONEER_VERSION);
 			if (strlen(PIONEER_EXTRAVERSION)) version += " (" PIONEER_EXTRAVERSION ")";
@@ -83,6 +145,13 @@ start:
 				"available modes:\n"
 				"    -game        [-g]     game (default)\n"
 				"    -modelviewer [-mv]    model viewer\n"
+				"    -modelcompiler [-mc]  compile models (all, or the one named)\n"
+				"    -modelbenchmark [-mb] draw models at each LOD and report what they cost\n"
+				"                          [report file] [models...]\n"
+				"    -benchmark   [-b]     run the game without drawing and time it\n"
+				"                          [ticks] [time accel] [save file or x,y,z,system,body]\n"
+				"    -savebenchmark [-sb]  time saving and loading a big game\n"
+				"                          [ships] [missions] [log entries] [save file or x,y,z,system,body]\n"
 				"    -version     [-v]     show version\n"
 				"    -help        [-h,-?]  this help\n"
 			);
@@ -9,10 +9,37 @@
 #include "vector3.h"
 #include "matrix3x3.h"
 
+#if defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+#define MATRIX4X4_USE_SSE
+#include <xmmintrin.h>
+#endif
+
 template <typename T>
 class matrix4x4 {
 	private:
 	T cell[16];
+	// matrix4x4f has SSE versions of these, which give the same results
+	static void Multiply(const matrix4x4 &a, const matrix4x4 &b, matrix4x4 &m) {
+		m.cell[0] = a.cell[0]*b.cell[0] + a.cell[4]*b.cell[1] + a.cell[8]*b.cell[2] + a.cell[12]*b.cell[3];
+		m.cell[1] = a.cell[1]*b.cell[0] + a.cell[5]*b.cell[1] + a.cell[9]*b.cell[2] + a.cell[13]*b.cell[3];
+		m.cell[2] = a.cell[2]*b.cell[0] + a.cell[6]*b.cell[1] + a.cell[10]*b.cell[2] + a.cell[14]*b.cell[3];
+		m.cell[3] = a.cell[3]*b.cell[0] + a.cell[7]*b.cell[1] + a.cell[11]*b.cell[2] + a.cell[15]*b.cell[3];
+
+		m.cell[4] = a.cell[0]*b.cell[4] + a.cell[4]*b.cell[5] + a.cell[8]*b.cell[6] + a.cell[12]*b.cell[7];
+		m.cell[5] = a.cell[1]*b.cell[4] + a.cell[5]*b.cell[5] + a.cell[9]*b.cell[6] + a.cell[13]*b.cell[7];
+		m.cell[6] = a.cell[2]*b.cell[4] + a.cell[6]*b.cell[5] + a.cell[10]*b.cell[6] + a.cell[14]*b.cell[7];
+		m.cell[7] = a.cell[3]*b.cell[4] + a.cell[7]*b.cell[5] + a.cell[11]*b.cell[6] + a.cell[15]*b.cell[7];
+
+		m.cell[8] = a.cell[0]*b.cell[8] + a.cell[4]*b.cell[9] + a.cell[8]*b.cell[10] + a.cell[12]*b.cell[11];
+		m.cell[9] = a.cell[1]*b.cell[8] + a.cell[5]*b.cell[9] + a.cell[9]*b.cell[10] + a.cell[13]*b.cell[11];
+		m.cell[10] = a.cell[2]*b.cell[8] + a.cell[6]*b.cell[9] + a.cell[10]*b.cell[10] + a.cell[14]*b.cell[11];
+		m.cell[11] = a.cell[3]*b.cell[8] + a.cell[7]*b.cell[9] + a.cell[11]*b.cell[10] + a.cell[15]*b.cell[11];
+
+		m.cell[12] = a.cell[0]*b.cell[12] + a.cell[4]*b.cell[13] + a.cell[8]*b.cell[14] + a.cell[12]*b.cell[15];
+		m.cell[13] = a.cell[1]*b.cell[12] + a.cell[5]*b.cell[13] + a.cell[9]*b.cell[14] + a.cell[13]*b.cell[15];
+		m.cell[14] = a.cell[2]*b.cell[12] + a.cell[6]*b.cell[13] + a.cell[10]*b.cell[14] + a.cell[14]*b.cell[15];
+		m.cell[15] = a.cell[3]*b.cell[12] + a.cell[7]*b.cell[13] + a.cell[11]*b.cell[14] + a.cell[15]*b.cell[15];
+	}
 	public:
 	matrix4x4 () {}
 	matrix4x4 (T val) {
@@ -258,25 +285,7 @@ class matrix4x4 {
 	}
 	friend matrix4x4 operator* (const matrix4x4 &a, const matrix4x4 &b) {
 		matrix4x4 m;
-		m.cell[0] = a.cell[0]*b.cell[0] + a.cell[4]*b.cell[1] + a.cell[8]*b.cell[2] + a.cell[12]*b.cell[3];
-		m.cell[1] = a.cell[1]*b.cell[0] + a.cell[5]*b.cell[1] + a.cell[9]*b.cell[2] + a.cell[13]*b.cell[3];
-		m.cell[2] = a.cell[2]*b.cell[0] + a.cell[6]*b.cell[1] + a.cell[10]*b.cell[2] + a.cell[14]*b.cell[3];
-		m.cell[3] = a.cell[3]*b.cell[0] + a.cell[7]*b.cell[1] + a.cell[11]*b.cell[2] + a.cell[15]*b.cell[3];
-
-		m.cell[4] = a.cell[0]*b.cell[4] + a.cell[4]*b.cell[5] + a.cell[8]*b.cell[6] + a.cell[12]*b.cell[7];
-		m.cell[5] = a.cell[1]*b.cell[4] + a.cell[5]*b.cell[5] + a.cell[9]*b.cell[6] + a.cell[13]*b.cell[7];
-		m.cell[6] = a.cell[2]*b.cell[4] + a.cell[6]*b.cell[5] + a.cell[10]*b.cell[6] + a.cell[14]*b.cell[7];
-		m.cell[7] = a.cell[3]*b.cell[4] + a.cell[7]*b.cell[5] + a.cell[11]*b.cell[6] + a.cell[15]*b.cell[7];
-
-		m.cell[8] = a.cell[0]*b.cell[8] + a.cell[4]*b.cell[9] + a.cell[8]*b.cell[10] + a.cell[12]*b.cell[11];
-		m.cell[9] = a.cell[1]*b.cell[8] + a.cell[5]*b.cell[9] + a.cell[9]*b.cell[10] + a.cell[13]*b.cell[11];
-		m.cell[10] = a.cell[2]*b.cell[8] + a.cell[6]*b.cell[9] + a.cell[10]*b.cell[10] + a.cell[14]*b.cell[11];
-		m.cell[11] = a.cell[3]*b.cell[8] + a.cell[7]*b.cell[9] + a.cell[11]*b.cell[10] + a.cell[15]*b.cell[11];
-
-		m.cell[12] = a.cell[0]*b.cell[12] + a.cell[4]*b.cell[13] + a.cell[8]*b.cell[14] + a.cell[12]*b.cell[15];
-		m.cell[13] = a.cell[1]*b.cell[12] + a.cell[5]*b.cell[13] + a.cell[9]*b.cell[14] + a.cell[13]*b.cell[15];
-		m.cell[14] = a.cell[2]*b.cell[12] + a.cell[6]*b.cell[13] + a.cell[10]*b.cell[14] + a.cell[14]*b.cell[15];
-		m.cell[15] = a.cell[3]*b.cell[12] + a.cell[7]*b.cell[13] + a.cell[11]*b.cell[14] + a.cell[15]*b.cell[15];
+		Multiply(a, b, m);
 		return m;
 	}
 	friend vector3<T> operator * (const matrix4x4 &a, const vector3<T> &v) {
@@ -366,6 +375,65 @@ class matrix4x4 {
 	}
 };
 
+// a * in[i] for every point. in and out can be the same array
+template <typename T>
+inline void TransformPoints(const matrix4x4<T> &a, const vector3<T> *in, vector3<T> *out, size_t count) {
+	for (size_t i = 0; i < count; i++)
+		out[i] = a * in[i];
+}
+
+#ifdef MATRIX4X4_USE_SSE
+// the sums are done in the same order as the scalar versions, so they come
+// out exactly the same. a column of the result at a time
+template <>
+inline void matrix4x4<float>::Multiply(const matrix4x4 &a, const matrix4x4 &b, matrix4x4 &m) {
+	const __m128 a0 = _mm_loadu_ps(a.cell), a1 = _mm_loadu_ps(a.cell+4), a2 = _mm_loadu_ps(a.cell+8), a3 = _mm_loadu_ps(a.cell+12);
+	for (int i=0; i<4; i++) {
+		const float *bc = b.cell + 4*i;
+		__m128 r = _mm_mul_ps(a0, _mm_set1_ps(bc[0]));
+		r = _mm_add_ps(r, _mm_mul_ps(a1, _mm_set1_ps(bc[1])));
+		r = _mm_add_ps(r, _mm_mul_ps(a2, _mm_set1_ps(bc[2])));
+		r = _mm_add_ps(r, _mm_mul_ps(a3, _mm_set1_ps(bc[3])));
+		_mm_storeu_ps(m.cell + 4*i, r);
+	}
+}
+
+template <>
+inline matrix4x4<float> matrix4x4<float>::InverseOf() const {
+	// still only rotation and translation. the transposed rotation is the
+	// first three columns, and also gives the translation column
+	__m128 r0 = _mm_loadu_ps(cell), r1 = _mm_loadu_ps(cell+4), r2 = _mm_loadu_ps(cell+8), r3 = _mm_setzero_ps();
+	_MM_TRANSPOSE4_PS(r0, r1, r2, r3);
+	__m128 t = _mm_mul_ps(r0, _mm_set1_ps(cell[12]));
+	t = _mm_add_ps(t, _mm_mul_ps(r1, _mm_set1_ps(cell[13])));
+	t = _mm_add_ps(t, _mm_mul_ps(r2, _mm_set1_ps(cell[14])));
+	t = _mm_sub_ps(_mm_setzero_ps(), t);
+
+	matrix4x4 m;
+	_mm_storeu_ps(m.cell, r0);
+	_mm_storeu_ps(m.cell+4, r1);
+	_mm_storeu_ps(m.cell+8, r2);
+	_mm_storeu_ps(m.cell+12, t);
+	m.cell[15] = 1.0f;
+	return m;
+}
+
+template <>
+inline void TransformPoints(const matrix4x4<float> &a, const vector3<float> *in, vector3<float> *out, size_t count) {
+	const float *c = a.Data();
+	const __m128 c0 = _mm_loadu_ps(c), c1 = _mm_loadu_ps(c+4), c2 = _mm_loadu_ps(c+8), c3 = _mm_loadu_ps(c+12);
+	float r[4];
+	for (size_t i = 0; i < count; i++) {
+		__m128 p = _mm_mul_ps(c0, _mm_set1_ps(in[i].x));
+		p = _mm_add_ps(p, _mm_mul_ps(c1, _mm_set1_ps(in[i].y)));
+		p = _mm_add_ps(p, _mm_mul_ps(c2, _mm_set1_ps(in[i].z)));
+		p = _mm_add_ps(p, c3);
+		_mm_storeu_ps(r, p);
+		out[i] = vector3<float>(r[0], r[1], r[2]);
+	}
+}
+#endif
+
 typedef matrix4x4<float> matrix4x4f;
 typedef matrix4x4<double> matrix4x4d;
 
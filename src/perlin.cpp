@@ -1,8 +1,14 @@
 // Copyright © 2008-2013 Pioneer Developers. See AUTHORS.txt for details
 // Licensed under the terms of the GPL v3. See licenses/GPL-3.txt
 
+#include "perlin.h"
 #include <math.h>
 
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define PERLIN_USE_SSE2
+#include <emmintrin.h>
+#endif
+
 /* Simplex.cpp
  *
  * Copyright 2007 Eliot Eshelman
@@ -217,3 +223,142 @@ int main()
 }
 
 #endif /* UNIT_TEST */
+
+// The same as four calls to noise(), bit for bit. The cell, simplex and
+// gradient lookups are done per point, everything else two points at a
+// time. Each step keeps the exact operation order of the scalar version so
+// the rounding is identical and planets don't change.
+#ifdef PERLIN_USE_SSE2
+
+static inline __m128i fastfloor2(const __m128d v)
+{
+	// int(x > 0 ? x : x - 1)
+	const __m128d positive = _mm_cmpgt_pd(v, _mm_setzero_pd());
+	const __m128d vm1 = _mm_sub_pd(v, _mm_set1_pd(1.0));
+	const __m128d sel = _mm_or_pd(_mm_and_pd(positive, v), _mm_andnot_pd(positive, vm1));
+	return _mm_cvttpd_epi32(sel);
+}
+
+static inline __m128d gradients(const unsigned char *gi, const int c)
+{
+	return _mm_set_pd(grad3[gi[1]][c], grad3[gi[0]][c]);
+}
+
+static inline __m128d cornerContribution(const __m128d x, const __m128d y, const __m128d z, const unsigned char *gi)
+{
+	const __m128d zero = _mm_setzero_pd();
+	const __m128d xx = _mm_mul_pd(x, x);
+	const __m128d yy = _mm_mul_pd(y, y);
+	const __m128d zz = _mm_mul_pd(z, z);
+	__m128d t = _mm_sub_pd(_mm_sub_pd(_mm_sub_pd(_mm_set1_pd(0.6), xx), yy), zz);
+	const __m128d outside = _mm_cmplt_pd(t, zero);
+	t = _mm_mul_pd(t, t);
+	const __m128d d = _mm_add_pd(_mm_add_pd(
+		_mm_mul_pd(gradients(gi, 0), x),
+		_mm_mul_pd(gradients(gi, 1), y)),
+		_mm_mul_pd(gradients(gi, 2), z));
+	const __m128d n = _mm_mul_pd(_mm_mul_pd(t, t), d);
+	return _mm_andnot_pd(outside, n);
+}
+
+static void noise2(const __m128d x, const __m128d y, const __m128d z, double *out)
+{
+	const double F3 = 1.0/3.0;
+	const double G3 = 1.0/6.0;
+	const __m128d one = _mm_set1_pd(1.0);
+
+	// skew to find the cell
+	const __m128d s = _mm_mul_pd(_mm_add_pd(_mm_add_pd(x, y), z), _mm_set1_pd(F3));
+	const __m128i ci = fastfloor2(_mm_add_pd(x, s));
+	const __m128i cj = fastfloor2(_mm_add_pd(y, s));
+	const __m128i ck = fastfloor2(_mm_add_pd(z, s));
+	const __m128d fi = _mm_cvtepi32_pd(ci);
+	const __m128d fj = _mm_cvtepi32_pd(cj);
+	const __m128d fk = _mm_cvtepi32_pd(ck);
+
+	// unskew the cell origin
+	const __m128d t = _mm_mul_pd(_mm_cvtepi32_pd(_mm_add_epi32(_mm_add_epi32(ci, cj), ck)), _mm_set1_pd(G3));
+	const __m128d x0 = _mm_sub_pd(x, _mm_sub_pd(fi, t));
+	const __m128d y0 = _mm_sub_pd(y, _mm_sub_pd(fj, t));
+	const __m128d z0 = _mm_sub_pd(z, _mm_sub_pd(fk, t));
+
+	// which simplex we're in. this is the scalar version's decision tree
+	// flattened out into masks
+	const __m128d xy = _mm_cmpge_pd(x0, y0);
+	const __m128d yz = _mm_cmpge_pd(y0, z0);
+	const __m128d xz = _mm_cmpge_pd(x0, z0);
+	const __m128d mi1 = _mm_and_pd(xy, xz);
+	const __m128d mj1 = _mm_andnot_pd(xy, yz);
+	const __m128d mk1 = _mm_cmpeq_pd(_mm_or_pd(mi1, mj1), _mm_setzero_pd());
+	const __m128d mi2 = _mm_or_pd(xy, xz);
+	const __m128d mj2 = _mm_or_pd(_mm_cmpeq_pd(xy, _mm_setzero_pd()), yz);
+	const __m128d mk2 = _mm_cmpeq_pd(_mm_and_pd(mi2, mj2), _mm_setzero_pd());
+
+	// hashed gradient indices of the four corners, per point
+	int cell[3][4];
+	_mm_storeu_si128(reinterpret_cast<__m128i*>(cell[0]), ci);
+	_mm_storeu_si128(reinterpret_cast<__m128i*>(cell[1]), cj);
+	_mm_storeu_si128(reinterpret_cast<__m128i*>(cell[2]), ck);
+	const int bi1 = _mm_movemask_pd(mi1), bj1 = _mm_movemask_pd(mj1), bk1 = _mm_movemask_pd(mk1);
+	const int bi2 = _mm_movemask_pd(mi2), bj2 = _mm_movemask_pd(mj2), bk2 = _mm_movemask_pd(mk2);
+	unsigned char gi[4][2];
+	for (int l=0; l<2; l++) {
+		const int ii = cell[0][l] & 255;
+		const int jj = cell[1][l] & 255;
+		const int kk = cell[2][l] & 255;
+		const int i1 = (bi1 >> l) & 1, j1 = (bj1 >> l) & 1, k1 = (bk1 >> l) & 1;
+		const int i2 = (bi2 >> l) & 1, j2 = (bj2 >> l) & 1, k2 = (bk2 >> l) & 1;
+		gi[0][l] = mod12[perm[ii+perm[jj+perm[kk]]]];
+		gi[1][l] = mod12[perm[ii+i1+perm[jj+j1+perm[kk+k1]]]];
+		gi[2][l] = mod12[perm[ii+i2+perm[jj+j2+perm[kk+k2]]]];
+		gi[3][l] = mod12[perm[ii+1+perm[jj+1+perm[kk+1]]]];
+	}
+
+	const __m128d g3 = _mm_set1_pd(G3);
+	const __m128d g3x2 = _mm_set1_pd(2.0*G3);
+	const __m128d g3x3 = _mm_set1_pd(3.0*G3);
+
+	const __m128d x1 = _mm_add_pd(_mm_sub_pd(x0, _mm_and_pd(mi1, one)), g3);
+	const __m128d y1 = _mm_add_pd(_mm_sub_pd(y0, _mm_and_pd(mj1, one)), g3);
+	const __m128d z1 = _mm_add_pd(_mm_sub_pd(z0, _mm_and_pd(mk1, one)), g3);
+	const __m128d x2 = _mm_add_pd(_mm_sub_pd(x0, _mm_and_pd(mi2, one)), g3x2);
+	const __m128d y2 = _mm_add_pd(_mm_sub_pd(y0, _mm_and_pd(mj2, one)), g3x2);
+	const __m128d z2 = _mm_add_pd(_mm_sub_pd(z0, _mm_and_pd(mk2, one)), g3x2);
+	const __m128d x3 = _mm_add_pd(_mm_sub_pd(x0, one), g3x3);
+	const __m128d y3 = _mm_add_pd(_mm_sub_pd(y0, one), g3x3);
+	const __m128d z3 = _mm_add_pd(_mm_sub_pd(z0, one), g3x3);
+
+	const __m128d n0 = cornerContribution(x0, y0, z0, gi[0]);
+	const __m128d n1 = cornerContribution(x1, y1, z1, gi[1]);
+	const __m128d n2 = cornerContribution(x2, y2, z2, gi[2]);
+	const __m128d n3 = cornerContribution(x3, y3, z3, gi[3]);
+
+	_mm_storeu_pd(out, _mm_mul_pd(_mm_set1_pd(32.0), _mm_add_pd(_mm_add_pd(_mm_add_pd(n0, n1), n2), n3)));
+}
+
+void noise4(const double *x, const double *y, const double *z, double *out)
+{
+	noise2(_mm_loadu_pd(&x[0]), _mm_loadu_pd(&y[0]), _mm_loadu_pd(&z[0]), &out[0]);
+	noise2(_mm_loadu_pd(&x[2]), _mm_loadu_pd(&y[2]), _mm_loadu_pd(&z[2]), &out[2]);
+}
+
+#else
+
+void noise4(const double *x, const double *y, const double *z, double *out)
+{
+	for (int i=0; i<4; i++)
+		out[i] = noise(x[i], y[i], z[i]);
+}
+
+#endif
+
+void noise4(const vector3d *p, double *out)
+{
+	double x[4], y[4], z[4];
+	for (int i=0; i<4; i++) {
+		x[i] = p[i].x;
+		y[i] = p[i].y;
+		z[i] = p[i].z;
+	}
+	noise4(x, y, z, out);
+}
@@ -8,6 +8,7 @@
 #include <cerrno>
 #include <sys/types.h>
 #include <sys/stat.h>
+#include <sys/mman.h>
 #include <dirent.h>
 #include <unistd.h>
 
@@ -104,6 +105,7 @@ namespace FileSystem {
 		const std::string fullpath = JoinPathBelow(GetRoot(), path);
 		struct stat statinfo;
 		FileInfo::FileType ty;
+		Sint64 modTime = 0;
 		if (stat(fullpath.c_str(), &statinfo) == 0) {
 			if (S_ISREG(statinfo.st_mode)) {
 				ty = FileInfo::FT_FILE;
@@ -112,12 +114,19 @@ namespace FileSystem {
 			} else {
 				ty = FileInfo::FT_SPECIAL;
 			}
+			modTime = statinfo.st_mtime;
 		} else {
 			ty = FileInfo::FT_NON_EXISTENT;
 		}
-		return MakeFileInfo(path, ty);
+		return MakeFileInfo(path, ty, modTime);
 	}
 
+	class FileDataMapped : public FileData {
+	public:
+		FileDataMapped(const FileInfo &info, size_t size, char *data): FileData(info, size, data) {}
+		virtual ~FileDataMapped() { munmap(m_data, m_size); }
+	};
+
 	RefCountedPtr<FileData> FileSourceFS::ReadFile(const std::string &path)
 	{
 		const std::string fullpath = JoinPathBelow(GetRoot(), path);
@@ -125,6 +134,17 @@ namespace FileSystem {
 		if (!fl) {
 			return RefCountedPtr<FileData>(0);
 		} else {
+			struct stat statinfo;
+			if (fstat(fileno(fl), &statinfo) == 0 && statinfo.st_size >= off_t(MAP_MIN_SIZE)) {
+				void *mapped = mmap(0, statinfo.st_size, PROT_READ, MAP_PRIVATE, fileno(fl), 0);
+				if (mapped != MAP_FAILED) {
+					// the mapping stays valid after the file is closed
+					fclose(fl);
+					return RefCountedPtr<FileData>(new FileDataMapped(MakeFileInfo(path, FileInfo::FT_FILE), statinfo.st_size, reinterpret_cast<char*>(mapped)));
+				}
+				// otherwise read it in as usual
+			}
+
 			fseek(fl, 0, SEEK_END);
 			long sz = ftell(fl);
 			fseek(fl, 0, SEEK_SET);
@@ -6,6 +6,7 @@
 #include "SDLWrappers.h"
 #include <SDL.h>
 #include <sys/time.h>
+#include <sys/resource.h>
 #include <fenv.h>
 #if defined(__APPLE__)
 #include <sys/param.h>
@@ -131,4 +132,17 @@ int GetNumCores()
 #endif
 }
 
+size_t GetPeakMemoryUsage()
+{
+	struct rusage usage;
+	if (getrusage(RUSAGE_SELF, &usage) != 0)
+		return 0;
+#if defined(__APPLE__)
+	return size_t(usage.ru_maxrss);
+#else
+	// kilobytes everywhere else
+	return size_t(usage.ru_maxrss) * 1024;
+#endif
+}
+
 } // namespace OS
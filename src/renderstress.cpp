@@ -0,0 +1,402 @@
+// Copyright © 2008-2013 Pioneer Developers. See AUTHORS.txt for details
+// Licensed under the terms of the GPL v3. See licenses/GPL-3.txt
+
+// draws a fixed load through Graphics::Renderer: static meshes, vertex array
+// lines and points, point sprites and flat UI style quads, each drawn with
+// a call per item the way the game does. reports the CPU time it takes to
+// submit a frame and, where the driver has timer queries, the GPU time the
+// frame took, for each renderer asked for. vsync is off
+//
+// renderstress [-renderer legacy|gl2|both] [-frames n] [-meshes n]
+//              [-lines n] [-points n] [-sprites n] [-quads n]
+
+#include <cstdlib>
+#include "SDL.h"
+#include "FileSystem.h"
+#include "OS.h"
+#include "graphics/Graphics.h"
+#include "graphics/Light.h"
+#include "graphics/Material.h"
+#include "graphics/Renderer.h"
+#include "graphics/RendererGL2.h"
+#include "graphics/RendererLegacy.h"
+#include "graphics/StaticMesh.h"
+#include "graphics/Surface.h"
+#include "graphics/TextureBuilder.h"
+#include "graphics/VertexArray.h"
+
+static const int WIDTH  = 1024;
+static const int HEIGHT = 768;
+
+// frames between issuing a timer query and reading it back, so reading it
+// never stalls
+static const int FRAMES_IN_FLIGHT = 4;
+
+struct Load {
+	int frames;
+	int meshes;
+	int lines;
+	int points;
+	int sprites;
+	int quads;
+};
+
+// what's drawn, made again for each renderer
+struct Scene {
+	Scene(Graphics::Renderer *r, const Load &load);
+
+	RefCountedPtr<Graphics::StaticMesh> mesh;
+	RefCountedPtr<Graphics::Material> meshMaterial;
+	ScopedPtr<Graphics::VertexArray> lines;
+	ScopedPtr<Graphics::VertexArray> points;
+	std::vector<vector3f> spritePositions;
+	ScopedPtr<Graphics::Material> spriteMaterial;
+	ScopedPtr<Graphics::Material> vtxColorMaterial;
+};
+
+static float frand(float lo, float hi)
+{
+	return lo + (hi - lo) * float(rand()) / float(RAND_MAX);
+}
+
+// a lat-long sphere about as big as a simple ship model
+static Graphics::Surface *make_sphere(RefCountedPtr<Graphics::Material> material)
+{
+	static const int STACKS = 24;
+	static const int SLICES = 32;
+
+	Graphics::VertexArray *va = new Graphics::VertexArray(Graphics::ATTRIB_POSITION | Graphics::ATTRIB_NORMAL | Graphics::ATTRIB_UV0);
+	for (int i = 0; i <= STACKS; i++) {
+		const float theta = float(M_PI) * float(i) / float(STACKS);
+		for (int j = 0; j <= SLICES; j++) {
+			const float phi = 2.f * float(M_PI) * float(j) / float(SLICES);
+			const vector3f n(sin(theta) * cos(phi), cos(theta), sin(theta) * sin(phi));
+			va->Add(n, n, vector2f(float(j) / float(SLICES), float(i) / float(STACKS)));
+		}
+	}
+
+	Graphics::Surface *s = new Graphics::Surface(Graphics::TRIANGLES, va, material);
+	std::vector<unsigned short> &indices = s->GetIndices();
+	for (int i = 0; i < STACKS; i++) {
+		for (int j = 0; j < SLICES; j++) {
+			const unsigned short a = i * (SLICES + 1) + j;
+			const unsigned short b = a + SLICES + 1;
+			indices.push_back(a); indices.push_back(b); indices.push_back(a + 1);
+			indices.push_back(b); indices.push_back(b + 1); indices.push_back(a + 1);
+		}
+	}
+	return s;
+}
+
+Scene::Scene(Graphics::Renderer *r, const Load &load)
+{
+	srand(0);
+
+	Graphics::MaterialDescriptor desc;
+	desc.lighting = true;
+	meshMaterial.Reset(r->CreateMaterial(desc));
+	meshMaterial->diffuse = Color(0.8f, 0.8f, 0.9f, 1.f);
+	mesh.Reset(new Graphics::StaticMesh(Graphics::TRIANGLES));
+	mesh->AddSurface(RefCountedPtr<Graphics::Surface>(make_sphere(meshMaterial)));
+
+	lines.Reset(new Graphics::VertexArray(Graphics::ATTRIB_POSITION | Graphics::ATTRIB_DIFFUSE, load.lines * 2));
+	for (int i = 0; i < load.lines; i++) {
+		const vector3f p(frand(-50.f, 50.f), frand(-40.f, 40.f), frand(-150.f, -50.f));
+		const Color c(frand(0.f, 1.f), frand(0.f, 1.f), frand(0.f, 1.f), 1.f);
+		lines->Add(p, c);
+		lines->Add(p + vector3f(frand(-5.f, 5.f), frand(-5.f, 5.f), frand(-5.f, 5.f)), c);
+	}
+
+	points.Reset(new Graphics::VertexArray(Graphics::ATTRIB_POSITION | Graphics::ATTRIB_DIFFUSE, load.points));
+	for (int i = 0; i < load.points; i++)
+		points->Add(vector3f(frand(-50.f, 50.f), frand(-40.f, 40.f), frand(-150.f, -50.f)), Color::WHITE);
+
+	for (int i = 0; i < load.sprites; i++)
+		spritePositions.push_back(vector3f(frand(-50.f, 50.f), frand(-40.f, 40.f), frand(-150.f, -50.f)));
+
+	Graphics::MaterialDescriptor spriteDesc;
+	spriteDesc.textures = 1;
+	spriteMaterial.Reset(r->CreateMaterial(spriteDesc));
+	spriteMaterial->texture0 = Graphics::TextureBuilder::Billboard("textures/smoke.png").GetOrCreateTexture(r, "billboard");
+
+	Graphics::MaterialDescriptor colorDesc;
+	colorDesc.vertexColors = true;
+	vtxColorMaterial.Reset(r->CreateMaterial(colorDesc));
+}
+
+// GL_TIME_ELAPSED over whole frames, read back FRAMES_IN_FLIGHT late
+class GpuTimer {
+public:
+	GpuTimer() : m_arb(glewIsSupported("GL_ARB_timer_query")), m_frame(0), m_total(0.0), m_frames(0) {
+		m_enabled = m_arb || glewIsSupported("GL_EXT_timer_query");
+		if (m_enabled) glGenQueries(FRAMES_IN_FLIGHT, m_queries);
+	}
+	~GpuTimer() {
+		if (m_enabled) glDeleteQueries(FRAMES_IN_FLIGHT, m_queries);
+	}
+
+	bool IsEnabled() const { return m_enabled; }
+
+	void Begin() {
+		if (!m_enabled) return;
+		// the query about to be reused was issued FRAMES_IN_FLIGHT ago
+		if (m_frame >= FRAMES_IN_FLIGHT) Collect(m_queries[m_frame % FRAMES_IN_FLIGHT]);
+		glBeginQuery(GL_TIME_ELAPSED_EXT, m_queries[m_frame % FRAMES_IN_FLIGHT]);
+	}
+
+	void End() {
+		if (!m_enabled) return;
+		glEndQuery(GL_TIME_ELAPSED_EXT);
+		m_frame++;
+	}
+
+	// milliseconds per frame over the frames that could be read back
+	double GetAverage() const { return m_frames ? m_total / double(m_frames) : 0.0; }
+	int GetFrames() const { return m_frames; }
+
+private:
+	void Collect(GLuint query) {
+		GLint available = 0;
+		glGetQueryObjectiv(query, GL_QUERY_RESULT_AVAILABLE, &available);
+		if (!available) return;
+		Uint64 ns;
+		if (m_arb) {
+			GLuint64 result = 0;
+			glGetQueryObjectui64v(query, GL_QUERY_RESULT, &result);
+			ns = result;
+		} else {
+			GLuint64EXT result = 0;
+			glGetQueryObjectui64vEXT(query, GL_QUERY_RESULT, &result);
+			ns = result;
+		}
+		m_total += double(ns) * 1e-6;
+		m_frames++;
+	}
+
+	bool m_enabled;
+	bool m_arb;
+	GLuint m_queries[FRAMES_IN_FLIGHT];
+	int m_frame;
+	double m_total;
+	int m_frames;
+};
+
+static double ms_since(Uint64 start)
+{
+	return double(OS::HFTimer() - start) * 1000.0 / double(OS::HFTimerFreq());
+}
+
+enum Section {
+	SECTION_MESHES,
+	SECTION_LINES,
+	SECTION_POINTS,
+	SECTION_SPRITES,
+	SECTION_QUADS,
+	SECTION_COUNT
+};
+
+static const char *s_sectionNames[SECTION_COUNT] = {
+	"meshes",
+	"lines",
+	"points",
+	"sprites",
+	"quads"
+};
+
+static void draw_frame(Graphics::Renderer *r, Scene &scene, const Load &load, int frame, double sectionMs[SECTION_COUNT])
+{
+	Uint64 t = OS::HFTimer();
+
+	r->SetPerspectiveProjection(60.f, float(WIDTH) / float(HEIGHT), 1.f, 10000.f);
+	r->SetDepthTest(true);
+	r->SetBlendMode(Graphics::BLEND_SOLID);
+
+	// a square grid of meshes, all turning
+	const int side = std::max(1, int(ceil(sqrt(double(load.meshes)))));
+	const matrix4x4f spin = matrix4x4f::RotateYMatrix(float(frame) * 0.01f);
+	for (int i = 0; i < load.meshes; i++) {
+		const float x = (float(i % side) - float(side) * 0.5f) * 3.f;
+		const float y = (float(i / side) - float(side) * 0.5f) * 3.f;
+		r->SetTransform(matrix4x4f::Translation(x, y, -float(side) * 3.f) * spin);
+		r->DrawStaticMesh(scene.mesh.Get());
+	}
+	sectionMs[SECTION_MESHES] += ms_since(t);
+
+	t = OS::HFTimer();
+	r->SetTransform(matrix4x4f::Identity());
+	if (load.lines) r->DrawTriangles(scene.lines.Get(), scene.vtxColorMaterial.Get(), Graphics::LINES);
+	sectionMs[SECTION_LINES] += ms_since(t);
+
+	t = OS::HFTimer();
+	if (load.points) r->DrawTriangles(scene.points.Get(), scene.vtxColorMaterial.Get(), Graphics::POINTS);
+	sectionMs[SECTION_POINTS] += ms_since(t);
+
+	t = OS::HFTimer();
+	r->SetDepthWrite(false);
+	r->SetBlendMode(Graphics::BLEND_ALPHA_ONE);
+	if (load.sprites) r->DrawPointSprites(scene.spritePositions.size(), &scene.spritePositions[0], scene.spriteMaterial.Get(), 2.f);
+	r->SetDepthWrite(true);
+	sectionMs[SECTION_SPRITES] += ms_since(t);
+
+	// one draw per quad, as the ui draws widget backgrounds
+	t = OS::HFTimer();
+	r->SetOrthographicProjection(0, WIDTH, HEIGHT, 0, -1, 1);
+	r->SetTransform(matrix4x4f::Identity());
+	r->SetDepthTest(false);
+	r->SetBlendMode(Graphics::BLEND_ALPHA);
+	Graphics::VertexArray quad(Graphics::ATTRIB_POSITION | Graphics::ATTRIB_DIFFUSE, 4);
+	for (int i = 0; i < load.quads; i++) {
+		const float x = float((i * 37) % (WIDTH - 32));
+		const float y = float((i * 53) % (HEIGHT - 16));
+		const Color c(0.2f, 0.3f, 0.6f, 0.5f);
+		quad.Clear();
+		quad.Add(vector3f(x, y, 0.f), c);
+		quad.Add(vector3f(x, y + 16.f, 0.f), c);
+		quad.Add(vector3f(x + 32.f, y, 0.f), c);
+		quad.Add(vector3f(x + 32.f, y + 16.f, 0.f), c);
+		r->DrawTriangles(&quad, scene.vtxColorMaterial.Get(), Graphics::TRIANGLE_STRIP);
+	}
+	sectionMs[SECTION_QUADS] += ms_since(t);
+}
+
+static void run(Graphics::Renderer *r, const Load &load)
+{
+	r->SetClearColor(Color::BLACK);
+	r->SetViewport(0, 0, WIDTH, HEIGHT);
+
+	// materials pick up the lights that are set when they are made
+	const Graphics::Light light(Graphics::Light::LIGHT_DIRECTIONAL, vector3f(0.f, 1.f, 1.f).Normalized(), Color::WHITE, Color::WHITE);
+	r->SetLights(1, &light);
+	r->SetAmbientColor(Color(0.1f));
+
+	Scene scene(r, load);
+	GpuTimer gpu;
+
+	// the first frames upload buffers and textures, so aren't counted
+	static const int WARMUP = 10;
+	double sectionMs[SECTION_COUNT];
+	double submitMs = 0.0, frameMs = 0.0;
+	for (int frame = -WARMUP; frame < load.frames; frame++) {
+		SDL_Event event;
+		while (SDL_PollEvent(&event)) {
+			if (event.type == SDL_QUIT || (event.type == SDL_KEYDOWN && event.key.keysym.sym == SDLK_ESCAPE)) {
+				SDL_Quit();
+				exit(0);
+			}
+		}
+
+		if (frame == 0) {
+			for (int i = 0; i < SECTION_COUNT; i++) sectionMs[i] = 0.0;
+			submitMs = frameMs = 0.0;
+		}
+
+		const Uint64 start = OS::HFTimer();
+		gpu.Begin();
+		r->BeginFrame();
+		draw_frame(r, scene, load, frame, sectionMs);
+		r->EndFrame();
+		gpu.End();
+		submitMs += ms_since(start);
+		r->SwapBuffers();
+		frameMs += ms_since(start);
+	}
+
+	const double frames = double(std::max(load.frames, 1));
+	printf("%s, %d frames:\n", r->GetName(), load.frames);
+	printf("  cpu submit %8.3f ms per frame\n", submitMs / frames);
+	for (int i = 0; i < SECTION_COUNT; i++)
+		printf("    %-8s %8.3f ms\n", s_sectionNames[i], sectionMs[i] / frames);
+	if (gpu.IsEnabled())
+		printf("  gpu        %8.3f ms per frame (%d frames read back)\n", gpu.GetAverage(), gpu.GetFrames());
+	else
+		printf("  gpu        no timer queries\n");
+	printf("  wall       %8.3f ms per frame, %.1f fps\n", frameMs / frames, frames * 1000.0 / std::max(frameMs, 1e-6));
+}
+
+int main(int argc, char **argv)
+{
+	std::string which = "both";
+	Load load;
+	load.frames = 500;
+	load.meshes = 200;
+	load.lines = 10000;
+	load.points = 10000;
+	load.sprites = 2000;
+	load.quads = 500;
+
+	for (int i = 1; i < argc; i++) {
+		const std::string arg(argv[i]);
+		if (i+1 >= argc) {
+			fprintf(stderr, "usage: renderstress [-renderer legacy|gl2|both] [-frames n] [-meshes n] [-lines n] [-points n] [-sprites n] [-quads n]\n");
+			return 1;
+		}
+		const char *value = argv[++i];
+		if (arg == "-renderer") which = value;
+		else if (arg == "-frames") load.frames = std::max(1, atoi(value));
+		else if (arg == "-meshes") load.meshes = std::max(0, atoi(value));
+		else if (arg == "-lines") load.lines = std::max(0, atoi(value));
+		else if (arg == "-points") load.points = std::max(0, atoi(value));
+		else if (arg == "-sprites") load.sprites = std::max(0, atoi(value));
+		else if (arg == "-quads") load.quads = std::max(0, atoi(value));
+		else {
+			fprintf(stderr, "renderstress: unknown option %s\n", arg.c_str());
+			return 1;
+		}
+	}
+
+	std::vector<bool> useShaders;
+	if (which == "legacy" || which == "both") useShaders.push_back(false);
+	if (which == "gl2" || which == "both") useShaders.push_back(true);
+	if (useShaders.empty()) {
+		fprintf(stderr, "renderstress: unknown renderer %s\n", which.c_str());
+		return 1;
+	}
+
+	FileSystem::Init();
+
+	if (SDL_Init(SDL_INIT_VIDEO) < 0) {
+		fprintf(stderr, "sdl init failed: %s\n", SDL_GetError());
+		exit(-1);
+	}
+
+	Graphics::Settings videoSettings;
+	videoSettings.width = WIDTH;
+	videoSettings.height = HEIGHT;
+	videoSettings.fullscreen = false;
+	videoSettings.shaders = useShaders.front();
+	videoSettings.shaderBinaryCache = false;
+	videoSettings.requestedSamples = 0;
+	videoSettings.vsync = false;
+	videoSettings.useTextureCompression = false;
+	videoSettings.textureCache = false;
+	Graphics::Renderer *r = Graphics::Init(videoSettings);
+
+	SDL_WM_SetCaption("renderstress", "renderstress");
+
+	// Graphics::Init makes the first renderer and the window, the others
+	// are made here on the same context once the one before has gone
+	for (unsigned int i = 0; i < useShaders.size(); i++) {
+		if (i > 0) {
+			delete r;
+			if (useShaders[i] && !Graphics::shadersAvailable) {
+				fprintf(stderr, "renderstress: no shaders, skipping the GL2 renderer\n");
+				r = 0;
+				break;
+			}
+			videoSettings.shaders = useShaders[i];
+			if (useShaders[i])
+				r = new Graphics::RendererGL2(videoSettings);
+			else
+				r = new Graphics::RendererLegacy(videoSettings);
+		}
+		if (useShaders[i] && !Graphics::AreShadersEnabled() && i == 0)
+			fprintf(stderr, "renderstress: no shaders, running the legacy renderer instead\n");
+		run(r, load);
+	}
+
+	delete r;
+
+	SDL_Quit();
+
+	exit(0);
+}
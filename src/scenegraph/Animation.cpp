@@ -2,6 +2,7 @@
 // Licensed under the terms of the GPL v3. See licenses/GPL-3.txt
 
 #include "Animation.h"
+#include "NodeVisitor.h"
 #include "scenegraph/Model.h"
 #include <iostream>
 
@@ -10,9 +11,35 @@ namespace SceneGraph {
 typedef std::vector<AnimationChannel> ChannelList;
 typedef ChannelList::iterator ChannelIterator;
 
+//the frame to interpolate from, searching on from the last one
+template <typename Key>
+static unsigned int find_frame(const std::vector<Key> &keys, double time, unsigned int &cursor)
+{
+	unsigned int frame = (cursor < keys.size() && keys[cursor].time <= time) ? cursor : 0;
+	while (frame + 1 < keys.size() && time >= keys[frame+1].time)
+		frame++;
+	cursor = frame;
+	return frame;
+}
+
+//named transforms in a graph, first found wins as with FindNode
+class TransformMapVisitor : public NodeVisitor {
+public:
+	TransformMapVisitor(std::map<std::string, MatrixTransform*> &transforms) : m_transforms(transforms) { }
+	virtual void ApplyMatrixTransform(MatrixTransform &m) {
+		if (!m.GetName().empty())
+			m_transforms.insert(std::make_pair(m.GetName(), &m));
+		m.Traverse(*this);
+	}
+
+private:
+	std::map<std::string, MatrixTransform*> &m_transforms;
+};
+
 Animation::Animation(const std::string &name, double duration)
 : m_duration(duration)
 , m_time(0.0)
+, m_interpolatedTime(-1.0)
 , m_name(name)
 {
 }
@@ -20,6 +47,7 @@ Animation::Animation(const std::string &name, double duration)
 Animation::Animation(const Animation &anim)
 : m_duration(anim.m_duration)
 , m_time(0.0)
+, m_interpolatedTime(-1.0)
 , m_name(anim.m_name)
 {
 	for(ChannelList::const_iterator chan = anim.m_channels.begin(); chan != anim.m_channels.end(); ++chan) {
@@ -29,16 +57,26 @@ Animation::Animation(const Animation &anim)
 
 void Animation::UpdateChannelTargets(Node *root)
 {
+	//one pass over the graph rather than a search per channel
+	std::map<std::string, MatrixTransform*> transforms;
+	TransformMapVisitor tv(transforms);
+	root->Accept(tv);
+
 	for(ChannelList::iterator chan = m_channels.begin(); chan != m_channels.end(); ++chan) {
 		//update channels to point to new node structure
-		MatrixTransform *trans = dynamic_cast<MatrixTransform*>(root->FindNode(chan->node->GetName()));
-		assert(trans);
-		chan->node = trans;
+		std::map<std::string, MatrixTransform*>::const_iterator trans = transforms.find(chan->node->GetName());
+		assert(trans != transforms.end());
+		chan->node = trans->second;
 	}
+	m_interpolatedTime = -1.0;
 }
 
 void Animation::Interpolate()
 {
+	//most of the time nothing is moving (gear up, doors shut)
+	if (is_equal_exact(m_time, m_interpolatedTime)) return;
+	m_interpolatedTime = m_time;
+
 	const double mtime = m_time;
 
 	//go through channels and calculate transforms
@@ -46,13 +84,7 @@ void Animation::Interpolate()
 		matrix4x4f trans = chan->node->GetTransform();
 
 		if (!chan->rotationKeys.empty()) {
-			//find a frame. To optimize, should begin search from previous frame (when mTime > previous mTime)
-			unsigned int frame = 0;
-			while (frame + 1 < chan->rotationKeys.size()) {
-				if (mtime < chan->rotationKeys[frame+1].time)
-					break;
-				frame++;
-			}
+			const unsigned int frame = find_frame(chan->rotationKeys, mtime, chan->rotationCursor);
 
 			const RotationKey &a = chan->rotationKeys[frame];
 			vector3f saved_position = trans.GetTranslate();
@@ -72,13 +104,7 @@ void Animation::Interpolate()
 		//continously scale the transform (would have to add originalTransform or
 		//something to MT)
 		if (!chan->scaleKeys.empty() && !chan->rotationKeys.empty()) {
-			//find a frame. To optimize, should begin search from previous frame (when mTime > previous mTime)
-			unsigned int frame = 0;
-			while (frame + 1 < chan->scaleKeys.size()) {
-				if (mtime < chan->scaleKeys[frame+1].time)
-					break;
-				frame++;
-			}
+			const unsigned int frame = find_frame(chan->scaleKeys, mtime, chan->scaleCursor);
 
 			const ScaleKey &a = chan->scaleKeys[frame];
 			vector3f out;
@@ -95,13 +121,7 @@ void Animation::Interpolate()
 		}
 
 		if (!chan->positionKeys.empty()) {
-			//find a frame. To optimize, should begin search from previous frame (when mTime > previous mTime)
-			unsigned int frame = 0;
-			while (frame + 1 < chan->positionKeys.size()) {
-				if (mtime < chan->positionKeys[frame+1].time)
-					break;
-				frame++;
-			}
+			const unsigned int frame = find_frame(chan->positionKeys, mtime, chan->positionCursor);
 
 			const PositionKey &a = chan->positionKeys[frame];
 			vector3f out;
@@ -22,14 +22,17 @@ public:
 	void UpdateChannelTargets(Node *root);
 	double GetDuration() const { return m_duration; }
 	const std::string &GetName() const { return m_name; }
+	const std::vector<AnimationChannel> &GetChannels() const { return m_channels; }
 	double GetProgress();
 	void SetProgress(double); //0.0 -- 1.0, overrides m_time
-	void Interpolate(); //update transforms according to m_time;
+	void Interpolate(); //update transforms according to m_time, if it has changed since
 
 private:
 	friend class Loader;
+	friend class BinaryConverter;
 	double m_duration;
 	double m_time;
+	double m_interpolatedTime; //time the transforms are at, negative when never interpolated
 	std::string m_name;
 	std::vector<AnimationChannel> m_channels;
 };
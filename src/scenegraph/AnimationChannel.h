@@ -12,11 +12,15 @@ namespace SceneGraph {
 
 class AnimationChannel {
 public:
-	AnimationChannel(MatrixTransform *t) : node(t) { }
+	AnimationChannel(MatrixTransform *t) : node(t), positionCursor(0), rotationCursor(0), scaleCursor(0) { }
 	std::vector<PositionKey> positionKeys;
 	std::vector<RotationKey> rotationKeys;
 	std::vector<ScaleKey> scaleKeys;
 	MatrixTransform *node;
+	//frames found last time, animations mostly play forward
+	unsigned int positionCursor;
+	unsigned int rotationCursor;
+	unsigned int scaleCursor;
 };
 
 }
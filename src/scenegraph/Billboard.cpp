@@ -9,12 +9,18 @@
 
 namespace SceneGraph {
 
+//billboards grow with distance between these, relative to their size
+static const float MIN_DISTANCE_SCALE = 0.25f;
+static const float MAX_DISTANCE_SCALE = 15.f;
+
 Billboard::Billboard(Graphics::Renderer *r, RefCountedPtr<Graphics::Material> mat, const vector3f &offset, float size)
 : Node(r, NODE_TRANSPARENT)
 , m_size(size)
 , m_material(mat)
 , m_offset(offset)
 {
+	//as large as it gets, it only shrinks on screen from there
+	SetBounds(m_offset, 0.71f * m_size * MAX_DISTANCE_SCALE);
 }
 
 Billboard::Billboard(const Billboard &billboard, NodeCopyCache *cache)
@@ -37,6 +43,9 @@ void Billboard::Accept(NodeVisitor &nv)
 
 void Billboard::Render(const matrix4x4f &trans, const RenderData *rd)
 {
+	const float fade = GetFade(trans, rd);
+	if (fade <= 0.f) return;
+
 	Graphics::Renderer *r = GetRenderer();
 
 	Graphics::VertexArray va(Graphics::ATTRIB_POSITION | Graphics::ATTRIB_UV0, 6);
@@ -44,7 +53,7 @@ void Billboard::Render(const matrix4x4f &trans, const RenderData *rd)
 	const matrix3x3f rot = trans.GetOrient().Transpose();
 
 	//some hand-tweaked scaling, to make the lights seem larger from distance
-	const float size = m_size * Graphics::GetFovFactor() * Clamp(trans.GetTranslate().Length() / 500.f, 0.25f, 15.f);
+	const float size = m_size * Graphics::GetFovFactor() * Clamp(trans.GetTranslate().Length() / 500.f, MIN_DISTANCE_SCALE, MAX_DISTANCE_SCALE);
 
 	const vector3f rotv1 = rot * vector3f(size/2.f, -size/2.f, 0.0f);
 	const vector3f rotv2 = rot * vector3f(size/2.f, size/2.f, 0.0f);
@@ -58,11 +67,8 @@ void Billboard::Render(const matrix4x4f &trans, const RenderData *rd)
 	va.Add(m_offset+rotv1, vector2f(1.f, 1.f)); //bottom right
 
 	r->SetTransform(trans);
-	r->SetBlendMode(Graphics::BLEND_ADDITIVE);
-	r->SetDepthWrite(false);
-	r->DrawTriangles(&va, m_material.Get());
-	r->SetBlendMode(Graphics::BLEND_SOLID);
-	r->SetDepthWrite(true);
+	//additive, so fading is darkening
+	r->DrawGlow(&va, m_material->texture0, m_material->diffuse * fade);
 }
 
 }
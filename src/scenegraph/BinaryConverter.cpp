@@ -0,0 +1,474 @@
+// Copyright © 2008-2013 Pioneer Developers. See AUTHORS.txt for details
+// Licensed under the terms of the GPL v3. See licenses/GPL-3.txt
+
+#include "BinaryConverter.h"
+#include "CollisionGeometry.h"
+#include "LOD.h"
+#include "Loader.h"
+#include "SceneGraph.h"
+#include "StringF.h"
+#include "graphics/Surface.h"
+#include "graphics/VertexArray.h"
+
+namespace SceneGraph {
+
+static const char SGM_MAGIC[] = "SGM";
+
+//the vertex attributes models have, interleaved in this order
+static const Graphics::AttributeSet MODEL_ATTRIBS =
+	Graphics::ATTRIB_POSITION | Graphics::ATTRIB_NORMAL | Graphics::ATTRIB_UV0;
+
+struct ModelVertex {
+	vector3f position;
+	vector3f normal;
+	vector2f uv0;
+};
+
+//arrays go in as strings, so they can be read without copying
+template <typename T>
+static void write_array(Serializer::Writer &wr, const T *data, size_t count)
+{
+	wr.String(std::string(reinterpret_cast<const char*>(data), count * sizeof(T)));
+}
+
+template <typename T>
+static void read_array(Serializer::Reader &rd, std::vector<T> &out)
+{
+	const StringRange blob = rd.StringView();
+	if (blob.Size() % sizeof(T)) throw SavedGameCorruptException();
+	out.resize(blob.Size() / sizeof(T));
+	if (!out.empty())
+		memcpy(static_cast<void*>(&out[0]), blob.begin, blob.Size());
+}
+
+static void write_color(Serializer::Writer &wr, const Color &c)
+{
+	wr.Float(c.r); wr.Float(c.g); wr.Float(c.b); wr.Float(c.a);
+}
+
+static Color read_color(Serializer::Reader &rd)
+{
+	Color c;
+	c.r = rd.Float(); c.g = rd.Float(); c.b = rd.Float(); c.a = rd.Float();
+	return c;
+}
+
+static void write_vector(Serializer::Writer &wr, const vector3f &v)
+{
+	wr.Float(v.x); wr.Float(v.y); wr.Float(v.z);
+}
+
+static vector3f read_vector(Serializer::Reader &rd)
+{
+	vector3f v;
+	v.x = rd.Float(); v.y = rd.Float(); v.z = rd.Float();
+	return v;
+}
+
+BinaryConverter::BinaryConverter(Loader &loader)
+: m_loader(loader)
+, m_model(0)
+{
+}
+
+std::string BinaryConverter::Save(Model *model, const ModelDefinition &def, const std::vector<std::string> &sources)
+{
+	m_model = model;
+	m_writtenNodes.clear();
+
+	Serializer::Writer wr;
+	wr.String(SGM_MAGIC);
+	wr.Int32(FORMAT_VERSION);
+
+	wr.Int32(sources.size());
+	for (std::vector<std::string>::const_iterator it = sources.begin(); it != sources.end(); ++it)
+		wr.String(*it);
+
+	wr.Int32(def.matDefs.size());
+	for (std::vector<MaterialDefinition>::const_iterator it = def.matDefs.begin(); it != def.matDefs.end(); ++it)
+		WriteMaterial(wr, *it);
+
+	//the root comes with the model, just its children are stored
+	WriteChildren(wr, model->GetRoot().Get());
+
+	WriteAnimations(wr);
+
+	wr.Int32(model->m_tags.size());
+	for (TagContainer::const_iterator it = model->m_tags.begin(); it != model->m_tags.end(); ++it)
+		wr.String((*it)->GetName());
+
+	m_model = 0;
+	return wr.GetData();
+}
+
+Model *BinaryConverter::Load(const std::string &name, const FileSystem::FileInfo &info)
+{
+	return Load(name, info, info.Read());
+}
+
+Model *BinaryConverter::Load(const std::string &name, const FileSystem::FileInfo &info, RefCountedPtr<FileSystem::FileData> data)
+{
+	if (!data) return 0;
+
+	m_readNodes.clear();
+	ScopedPtr<Model> model;
+	try {
+		Serializer::Reader rd(data);
+		if (rd.StringView() != SGM_MAGIC || rd.Int32() != FORMAT_VERSION)
+			return 0;
+
+		//sources edited since compiling win. times are only compared when
+		//both are known
+		const Sint64 compiled = info.GetModificationTime();
+		const Uint32 numSources = rd.Int32();
+		for (Uint32 i = 0; i < numSources; i++) {
+			const FileSystem::FileInfo src = FileSystem::gameDataFiles.Lookup(rd.String());
+			if (compiled && src.GetModificationTime() > compiled)
+				return 0;
+		}
+
+		std::vector<MaterialDefinition> matDefs;
+		const Uint32 numMaterials = rd.Int32();
+		for (Uint32 i = 0; i < numMaterials; i++)
+			matDefs.push_back(ReadMaterial(rd));
+
+		model.Reset(new Model(m_loader.m_renderer, name));
+		m_model = model.Get();
+		m_loader.m_model = m_model;
+		const bool patternsUsed = m_loader.CreateMaterials(matDefs);
+
+		ReadChildren(rd, m_model->GetRoot().Get());
+		ReadAnimations(rd);
+
+		const Uint32 numTags = rd.Int32();
+		for (Uint32 i = 0; i < numTags; i++) {
+			MatrixTransform *tag = dynamic_cast<MatrixTransform*>(m_model->GetRoot()->FindNode(rd.String()));
+			if (!tag) throw SavedGameCorruptException();
+			m_model->m_tags.push_back(tag);
+		}
+
+		m_loader.FinishModel(patternsUsed);
+	} catch (SavedGameCorruptException &) {
+		fprintf(stderr, "%s: broken compiled model, loading from sources\n", info.GetPath().c_str());
+		m_readNodes.clear();
+		m_model = 0;
+		return 0;
+	}
+
+	m_readNodes.clear();
+	m_model = 0;
+	return model.Release();
+}
+
+void BinaryConverter::WriteMaterial(Serializer::Writer &wr, const MaterialDefinition &def)
+{
+	wr.String(def.name);
+	wr.String(def.tex_diff);
+	wr.String(def.tex_spec);
+	wr.String(def.tex_glow);
+	write_color(wr, def.diffuse);
+	write_color(wr, def.specular);
+	write_color(wr, def.ambient);
+	write_color(wr, def.emissive);
+	wr.Int32(def.shininess);
+	wr.Int32(def.opacity);
+	wr.Bool(def.alpha_test);
+	wr.Bool(def.two_sided);
+	wr.Bool(def.unlit);
+	wr.Bool(def.use_pattern);
+}
+
+MaterialDefinition BinaryConverter::ReadMaterial(Serializer::Reader &rd)
+{
+	MaterialDefinition def(rd.String());
+	def.tex_diff = rd.String();
+	def.tex_spec = rd.String();
+	def.tex_glow = rd.String();
+	def.diffuse = read_color(rd);
+	def.specular = read_color(rd);
+	def.ambient = read_color(rd);
+	def.emissive = read_color(rd);
+	def.shininess = rd.Int32();
+	def.opacity = rd.Int32();
+	def.alpha_test = rd.Bool();
+	def.two_sided = rd.Bool();
+	def.unlit = rd.Bool();
+	def.use_pattern = rd.Bool();
+	return def;
+}
+
+void BinaryConverter::WriteNode(Serializer::Writer &wr, Node *node)
+{
+	std::map<Node*, Uint32>::const_iterator written = m_writtenNodes.find(node);
+	if (written != m_writtenNodes.end()) {
+		wr.String("Ref");
+		wr.Int32(written->second);
+		return;
+	}
+	const Uint32 id = m_writtenNodes.size();
+	m_writtenNodes[node] = id;
+
+	const std::string type = node->GetTypeName();
+	wr.String(type);
+	wr.String(node->GetName());
+	wr.Int32(node->GetNodeMask());
+
+	if (type == "Group") {
+		WriteChildren(wr, static_cast<Group*>(node));
+	} else if (type == "MatrixTransform") {
+		MatrixTransform *mt = static_cast<MatrixTransform*>(node);
+		for (int i = 0; i < 16; i++)
+			wr.Float(mt->GetTransform()[i]);
+		WriteChildren(wr, mt);
+	} else if (type == "LOD") {
+		LOD *lod = static_cast<LOD*>(node);
+		wr.Int32(lod->GetNumChildren());
+		for (unsigned int i = 0; i < lod->GetNumChildren(); i++) {
+			wr.Int32(lod->GetPixelSize(i));
+			WriteNode(wr, lod->GetChildAt(i));
+		}
+	} else if (type == "StaticGeometry") {
+		WriteStaticGeometry(wr, static_cast<StaticGeometry*>(node));
+	} else if (type == "CollisionGeometry") {
+		CollisionGeometry *cg = static_cast<CollisionGeometry*>(node);
+		wr.Int32(cg->GetTriFlag());
+		const std::vector<vector3f> &vertices = cg->GetVertices();
+		const std::vector<int> &indices = cg->GetIndices();
+		write_array(wr, vertices.empty() ? 0 : &vertices[0], vertices.size());
+		write_array(wr, indices.empty() ? 0 : &indices[0], indices.size());
+	} else if (type == "Thruster") {
+		Thruster *thruster = static_cast<Thruster*>(node);
+		wr.Bool(thruster->IsLinearOnly());
+		write_vector(wr, thruster->GetPosition());
+		write_vector(wr, thruster->GetDirection());
+	} else if (type == "Label3D") {
+		//the text is set per instance
+	} else
+		throw LoadingError(stringf("Can't compile %0 node %1", type, node->GetName()));
+}
+
+void BinaryConverter::WriteChildren(Serializer::Writer &wr, Group *group)
+{
+	wr.Int32(group->GetNumChildren());
+	for (unsigned int i = 0; i < group->GetNumChildren(); i++)
+		WriteNode(wr, group->GetChildAt(i));
+}
+
+void BinaryConverter::WriteStaticGeometry(Serializer::Writer &wr, StaticGeometry *geom)
+{
+	wr.Int32(geom->m_blendMode);
+	wr.Vector3d(geom->m_boundingBox.min);
+	wr.Vector3d(geom->m_boundingBox.max);
+
+	wr.Int32(geom->GetNumMeshes());
+	for (unsigned int i = 0; i < geom->GetNumMeshes(); i++) {
+		RefCountedPtr<Graphics::StaticMesh> mesh = geom->GetMesh(i);
+		wr.Int32(mesh->GetPrimtiveType());
+		wr.Int32(mesh->SurfacesEnd() - mesh->SurfacesBegin());
+		for (Graphics::StaticMesh::SurfaceIterator surf = mesh->SurfacesBegin(); surf != mesh->SurfacesEnd(); ++surf) {
+			wr.Int32((*surf)->GetPrimtiveType());
+
+			//model materials by index, decal materials by negative decal number
+			Graphics::Material *mat = (*surf)->GetMaterial().Get();
+			int matRef = 0;
+			for (unsigned int m = 0; m < m_model->m_materials.size(); m++)
+				if (m_model->m_materials[m].second.Get() == mat) matRef = m;
+			for (unsigned int d = 0; d < Model::MAX_DECAL_MATERIALS; d++)
+				if (m_model->m_decalMaterials[d].Get() == mat) matRef = -int(d + 1);
+			wr.Int32(matRef);
+
+			const Graphics::VertexArray *va = (*surf)->GetVertices();
+			if (va->GetAttributeSet() != MODEL_ATTRIBS)
+				throw LoadingError(stringf("Can't compile vertex format of %0", geom->GetName()));
+			std::vector<ModelVertex> verts(va->GetNumVerts());
+			for (unsigned int v = 0; v < verts.size(); v++) {
+				verts[v].position = va->position[v];
+				verts[v].normal = va->normal[v];
+				verts[v].uv0 = va->uv0[v];
+			}
+			write_array(wr, verts.empty() ? 0 : &verts[0], verts.size());
+
+			const std::vector<unsigned short> &indices = (*surf)->GetIndices();
+			write_array(wr, indices.empty() ? 0 : &indices[0], indices.size());
+		}
+	}
+}
+
+RefCountedPtr<Node> BinaryConverter::ReadNode(Serializer::Reader &rd)
+{
+	Graphics::Renderer *r = m_loader.m_renderer;
+
+	const std::string type = rd.String();
+	if (type == "Ref") {
+		const Uint32 id = rd.Int32();
+		if (id >= m_readNodes.size()) throw SavedGameCorruptException();
+		return m_readNodes[id];
+	}
+
+	const std::string name = rd.String();
+	const unsigned int nodeMask = rd.Int32();
+
+	RefCountedPtr<Node> node;
+	if (type == "Group") {
+		node.Reset(new Group(r));
+	} else if (type == "MatrixTransform") {
+		matrix4x4f m;
+		for (int i = 0; i < 16; i++)
+			m[i] = rd.Float();
+		node.Reset(new MatrixTransform(r, m));
+	} else if (type == "LOD") {
+		node.Reset(new LOD(r));
+	} else if (type == "StaticGeometry") {
+		node.Reset(new StaticGeometry(r));
+	} else if (type == "CollisionGeometry") {
+		const unsigned int flag = rd.Int32();
+		std::vector<vector3f> vertices;
+		std::vector<int> indices;
+		read_array(rd, vertices);
+		read_array(rd, indices);
+		const std::vector<unsigned short> shortIndices(indices.begin(), indices.end());
+		node.Reset(new CollisionGeometry(r, vertices, shortIndices, flag));
+	} else if (type == "Thruster") {
+		const bool linear = rd.Bool();
+		const vector3f pos = read_vector(rd);
+		const vector3f dir = read_vector(rd);
+		node.Reset(new Thruster(r, linear, pos, dir));
+	} else if (type == "Label3D") {
+		Label3D *label = new Label3D(r, m_loader.m_labelFont);
+		label->SetText("Bananas");
+		node.Reset(label);
+	} else
+		throw SavedGameCorruptException();
+
+	//registered before the children, the same order they were written in
+	m_readNodes.push_back(node);
+	node->SetName(name);
+	node->SetNodeMask(nodeMask);
+
+	if (type == "Group" || type == "MatrixTransform") {
+		ReadChildren(rd, static_cast<Group*>(node.Get()));
+	} else if (type == "LOD") {
+		LOD *lod = static_cast<LOD*>(node.Get());
+		const Uint32 numLevels = rd.Int32();
+		for (Uint32 i = 0; i < numLevels; i++) {
+			const float pixelSize = float(rd.Int32());
+			lod->AddLevel(pixelSize, ReadNode(rd).Get());
+		}
+	} else if (type == "StaticGeometry") {
+		ReadStaticGeometry(rd, static_cast<StaticGeometry*>(node.Get()));
+	}
+
+	return node;
+}
+
+void BinaryConverter::ReadChildren(Serializer::Reader &rd, Group *group)
+{
+	const Uint32 numChildren = rd.Int32();
+	for (Uint32 i = 0; i < numChildren; i++)
+		group->AddChild(ReadNode(rd).Get());
+}
+
+void BinaryConverter::ReadStaticGeometry(Serializer::Reader &rd, StaticGeometry *geom)
+{
+	geom->m_blendMode = Graphics::BlendMode(rd.Int32());
+	geom->m_boundingBox.Update(rd.Vector3d());
+	geom->m_boundingBox.Update(rd.Vector3d());
+
+	const Uint32 numMeshes = rd.Int32();
+	std::vector<ModelVertex> verts;
+	for (Uint32 i = 0; i < numMeshes; i++) {
+		RefCountedPtr<Graphics::StaticMesh> mesh(new Graphics::StaticMesh(Graphics::PrimitiveType(rd.Int32())));
+		const Uint32 numSurfaces = rd.Int32();
+		for (Uint32 s = 0; s < numSurfaces; s++) {
+			const Graphics::PrimitiveType primType = Graphics::PrimitiveType(rd.Int32());
+
+			const int matRef = rd.Int32();
+			RefCountedPtr<Graphics::Material> mat;
+			if (matRef < 0 && -matRef <= int(Model::MAX_DECAL_MATERIALS))
+				mat = m_loader.GetDecalMaterial(-matRef);
+			else if (matRef >= 0 && matRef < int(m_model->m_materials.size()))
+				mat = m_model->m_materials[matRef].second;
+			else
+				throw SavedGameCorruptException();
+
+			read_array(rd, verts);
+			Graphics::VertexArray *va = new Graphics::VertexArray(MODEL_ATTRIBS, verts.size());
+			for (unsigned int v = 0; v < verts.size(); v++)
+				va->Add(verts[v].position, verts[v].normal, verts[v].uv0);
+
+			RefCountedPtr<Graphics::Surface> surface(new Graphics::Surface(primType, va, mat));
+			read_array(rd, surface->GetIndices());
+			for (unsigned int n = 0; n < surface->GetIndices().size(); n++)
+				if (surface->GetIndices()[n] >= verts.size()) throw SavedGameCorruptException();
+			mesh->AddSurface(surface);
+		}
+		geom->AddMesh(mesh);
+	}
+}
+
+void BinaryConverter::WriteAnimations(Serializer::Writer &wr)
+{
+	const std::vector<Animation*> &anims = m_model->m_animations;
+	wr.Int32(anims.size());
+	for (std::vector<Animation*>::const_iterator it = anims.begin(); it != anims.end(); ++it) {
+		const Animation *anim = *it;
+		wr.String(anim->m_name);
+		wr.Double(anim->m_duration);
+		wr.Int32(anim->m_channels.size());
+		for (std::vector<AnimationChannel>::const_iterator chan = anim->m_channels.begin(); chan != anim->m_channels.end(); ++chan) {
+			wr.String(chan->node->GetName());
+			wr.Int32(chan->positionKeys.size());
+			for (std::vector<PositionKey>::const_iterator key = chan->positionKeys.begin(); key != chan->positionKeys.end(); ++key) {
+				wr.Double(key->time);
+				write_vector(wr, key->position);
+			}
+			wr.Int32(chan->rotationKeys.size());
+			for (std::vector<RotationKey>::const_iterator key = chan->rotationKeys.begin(); key != chan->rotationKeys.end(); ++key) {
+				wr.Double(key->time);
+				wr.WrQuaternionf(key->rotation);
+			}
+			wr.Int32(chan->scaleKeys.size());
+			for (std::vector<ScaleKey>::const_iterator key = chan->scaleKeys.begin(); key != chan->scaleKeys.end(); ++key) {
+				wr.Double(key->time);
+				write_vector(wr, key->scale);
+			}
+		}
+	}
+}
+
+void BinaryConverter::ReadAnimations(Serializer::Reader &rd)
+{
+	const Uint32 numAnims = rd.Int32();
+	for (Uint32 i = 0; i < numAnims; i++) {
+		const std::string name = rd.String();
+		const double duration = rd.Double();
+		Animation *anim = new Animation(name, duration);
+		m_model->m_animations.push_back(anim);
+
+		const Uint32 numChannels = rd.Int32();
+		for (Uint32 c = 0; c < numChannels; c++) {
+			MatrixTransform *target = dynamic_cast<MatrixTransform*>(m_model->GetRoot()->FindNode(rd.String()));
+			if (!target) throw SavedGameCorruptException();
+			anim->m_channels.push_back(AnimationChannel(target));
+			AnimationChannel &chan = anim->m_channels.back();
+
+			const Uint32 numPos = rd.Int32();
+			for (Uint32 k = 0; k < numPos; k++) {
+				const double t = rd.Double();
+				chan.positionKeys.push_back(PositionKey(t, read_vector(rd)));
+			}
+			const Uint32 numRot = rd.Int32();
+			for (Uint32 k = 0; k < numRot; k++) {
+				const double t = rd.Double();
+				chan.rotationKeys.push_back(RotationKey(t, rd.RdQuaternionf()));
+			}
+			const Uint32 numScale = rd.Int32();
+			for (Uint32 k = 0; k < numScale; k++) {
+				const double t = rd.Double();
+				chan.scaleKeys.push_back(ScaleKey(t, read_vector(rd)));
+			}
+		}
+	}
+}
+
+}
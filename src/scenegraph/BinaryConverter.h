@@ -0,0 +1,69 @@
+// Copyright © 2008-2013 Pioneer Developers. See AUTHORS.txt for details
+// Licensed under the terms of the GPL v3. See licenses/GPL-3.txt
+
+#ifndef _BINARYCONVERTER_H
+#define _BINARYCONVERTER_H
+/*
+ * Compiled models (.sgm). A model made by the Loader is written out whole:
+ * material definitions, the node graph with the vertex and index data of
+ * its meshes, animations and tags. Loading it back is a single file read
+ * and no assimp.
+ *
+ * The file names the sources it was made from and is ignored when any of
+ * them is newer, or when it is from another format version.
+ * Materials are made from their definitions again when loading, and the
+ * collision mesh is rebuilt from the collision geometry (the GeomTree comes
+ * from the tree cache, see CollisionVisitor)
+ */
+#include "libs.h"
+#include "FileSystem.h"
+#include "LoaderDefinitions.h"
+#include "Serializer.h"
+
+namespace SceneGraph {
+
+class Group;
+class Loader;
+class Model;
+class Node;
+class StaticGeometry;
+
+class BinaryConverter {
+public:
+	static const Uint32 FORMAT_VERSION = 1;
+
+	BinaryConverter(Loader &loader);
+
+	//serialise a model made from def. sources are the files it was made
+	//from. throws LoadingError for things that can't be compiled
+	std::string Save(Model *model, const ModelDefinition &def, const std::vector<std::string> &sources);
+
+	//the model in a compiled file, or 0 if the file is out of
+	//date, from another version or broken
+	Model *Load(const std::string &name, const FileSystem::FileInfo &info);
+	//the same, with the contents of the file read already
+	Model *Load(const std::string &name, const FileSystem::FileInfo &info, RefCountedPtr<FileSystem::FileData> data);
+
+private:
+	void WriteMaterial(Serializer::Writer &wr, const MaterialDefinition &def);
+	MaterialDefinition ReadMaterial(Serializer::Reader &rd);
+	void WriteNode(Serializer::Writer &wr, Node *node);
+	void WriteChildren(Serializer::Writer &wr, Group *group);
+	void WriteStaticGeometry(Serializer::Writer &wr, StaticGeometry *geom);
+	RefCountedPtr<Node> ReadNode(Serializer::Reader &rd);
+	void ReadChildren(Serializer::Reader &rd, Group *group);
+	void ReadStaticGeometry(Serializer::Reader &rd, StaticGeometry *geom);
+	void WriteAnimations(Serializer::Writer &wr);
+	void ReadAnimations(Serializer::Reader &rd);
+
+	Loader &m_loader;
+	Model *m_model;
+	//nodes attached in more than one place are written once, and then
+	//referred to by the order they were first written in
+	std::map<Node*, Uint32> m_writtenNodes;
+	std::vector<RefCountedPtr<Node> > m_readNodes;
+};
+
+}
+
+#endif
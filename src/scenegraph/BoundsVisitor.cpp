@@ -0,0 +1,100 @@
+// Copyright © 2008-2013 Pioneer Developers. See AUTHORS.txt for details
+// Licensed under the terms of the GPL v3. See licenses/GPL-3.txt
+
+#include "BoundsVisitor.h"
+#include "Group.h"
+#include "MatrixTransform.h"
+#include "StaticGeometry.h"
+
+namespace SceneGraph {
+
+BoundsVisitor::BoundsVisitor()
+: m_centre(0.f)
+, m_radius(-1.f)
+{
+}
+
+void BoundsVisitor::ApplyNode(Node &n)
+{
+	m_centre = n.GetBoundCentre();
+	m_radius = n.GetBoundRadius();
+}
+
+void BoundsVisitor::ApplyGroup(Group &g)
+{
+	EncloseChildren(g);
+	g.SetBounds(m_centre, m_radius);
+}
+
+void BoundsVisitor::ApplyMatrixTransform(MatrixTransform &m)
+{
+	EncloseChildren(m);
+	m.SetBounds(m_centre, m_radius);
+	if (m_radius > 0.f) {
+		m_centre = m.GetTransform() * m_centre;
+		m_radius *= Node::GetMaxScale(m.GetTransform());
+	}
+}
+
+void BoundsVisitor::ApplyStaticGeometry(StaticGeometry &g)
+{
+	const Aabb &bb = g.m_boundingBox;
+	if (bb.min.x > bb.max.x) {
+		m_centre = vector3f(0.f);
+		m_radius = -1.f;
+	} else {
+		m_centre = vector3f((bb.min + bb.max) * 0.5);
+		m_radius = float((bb.max - bb.min).Length() * 0.5);
+	}
+	g.SetBounds(m_centre, m_radius);
+}
+
+void BoundsVisitor::ApplyCollisionGeometry(CollisionGeometry &)
+{
+	//never drawn
+	m_centre = vector3f(0.f);
+	m_radius = 0.f;
+}
+
+void BoundsVisitor::EncloseChildren(Group &g)
+{
+	std::vector<vector3f> centres;
+	std::vector<float> radii;
+	bool unknown = false;
+	for (unsigned int i = 0; i < g.GetNumChildren(); i++) {
+		g.GetChildAt(i)->Accept(*this);
+		if (m_radius < 0.f)
+			unknown = true;
+		else if (m_radius > 0.f) {
+			centres.push_back(m_centre);
+			radii.push_back(m_radius);
+		}
+	}
+
+	if (unknown) {
+		m_centre = vector3f(0.f);
+		m_radius = -1.f;
+		return;
+	}
+	if (centres.empty()) {
+		m_centre = vector3f(0.f);
+		m_radius = 0.f;
+		return;
+	}
+
+	//centre on the box around the spheres, then grow to fit them all
+	vector3f min(centres[0] - vector3f(radii[0]));
+	vector3f max(centres[0] + vector3f(radii[0]));
+	for (unsigned int i = 1; i < centres.size(); i++) {
+		const vector3f lo = centres[i] - vector3f(radii[i]);
+		const vector3f hi = centres[i] + vector3f(radii[i]);
+		min.x = std::min(min.x, lo.x); min.y = std::min(min.y, lo.y); min.z = std::min(min.z, lo.z);
+		max.x = std::max(max.x, hi.x); max.y = std::max(max.y, hi.y); max.z = std::max(max.z, hi.z);
+	}
+	m_centre = (min + max) * 0.5f;
+	m_radius = 0.f;
+	for (unsigned int i = 0; i < centres.size(); i++)
+		m_radius = std::max(m_radius, (centres[i] - m_centre).Length() + radii[i]);
+}
+
+}
@@ -0,0 +1,42 @@
+// Copyright © 2008-2013 Pioneer Developers. See AUTHORS.txt for details
+// Licensed under the terms of the GPL v3. See licenses/GPL-3.txt
+
+#ifndef _BOUNDSVISITOR_H
+#define _BOUNDSVISITOR_H
+/*
+ * Updates the bounding spheres of groups and geometry (see Node::SetBounds)
+ * from the bottom up. Other nodes set their own bounds.
+ * The spheres of matrix transforms' parents are worked out with the
+ * transforms as they are now, so animations will make them a bit off.
+ */
+#include "NodeVisitor.h"
+#include "libs.h"
+
+namespace SceneGraph {
+
+class Group;
+class MatrixTransform;
+class StaticGeometry;
+
+class BoundsVisitor : public NodeVisitor
+{
+public:
+	BoundsVisitor();
+	virtual void ApplyNode(Node &);
+	virtual void ApplyGroup(Group &);
+	virtual void ApplyMatrixTransform(MatrixTransform &);
+	virtual void ApplyStaticGeometry(StaticGeometry &);
+	virtual void ApplyCollisionGeometry(CollisionGeometry &);
+
+private:
+	//sphere around all the children of the group, in the group's space
+	void EncloseChildren(Group &);
+
+	//bounds of the last node visited, in its parent's space
+	vector3f m_centre;
+	float m_radius;
+};
+
+}
+
+#endif
@@ -7,13 +7,77 @@
 #include "Group.h"
 #include "MatrixTransform.h"
 #include "StaticGeometry.h"
+#include "FileSystem.h"
 #include "graphics/StaticMesh.h"
 #include "graphics/Surface.h"
+#include "jenkins/lookup3.h"
 
 namespace SceneGraph {
 
 static bool properData = false;
 
+// merging duplicate vertices and building the trees takes a while for the
+// big station models, so built GeomTrees are kept in the user dir. files are
+// named by a hash of the mesh, so an edited model just gets a new one
+static const char GEOMTREE_CACHE_DIR[] = "collcache";
+
+// bump this when GeomTree, BVHTree or their file layout changes
+static const Uint32 GEOMTREE_CACHE_VERSION = 1;
+
+static const char GEOMTREE_CACHE_MAGIC[4] = { 'P', 'G', 'T', 'C' };
+
+struct GeomTreeCacheHeader {
+	char magic[4];
+	Uint32 version;
+	Uint32 numVerts;
+	Uint32 numTris;
+	Uint32 hash[2];
+};
+
+static GeomTree *CreateGeomTree(std::vector<vector3f> &vts, std::vector<int> &ind, std::vector<unsigned int> &flags)
+{
+	const int numVerts = vts.size();
+	const int numTris = ind.size()/3;
+	float *vertices = reinterpret_cast<float*>(&vts[0]);
+
+	// the hash has to be taken before GeomTree merges the indices
+	GeomTreeCacheHeader header;
+	memcpy(header.magic, GEOMTREE_CACHE_MAGIC, sizeof(GEOMTREE_CACHE_MAGIC));
+	header.version = GEOMTREE_CACHE_VERSION;
+	header.numVerts = numVerts;
+	header.numTris = numTris;
+	header.hash[0] = header.hash[1] = 0;
+	lookup3_hashlittle2(&vts[0], vts.size() * sizeof(vector3f), &header.hash[0], &header.hash[1]);
+	lookup3_hashlittle2(&ind[0], ind.size() * sizeof(int), &header.hash[0], &header.hash[1]);
+	lookup3_hashlittle2(&flags[0], flags.size() * sizeof(unsigned int), &header.hash[0], &header.hash[1]);
+
+	char name[32];
+	snprintf(name, sizeof(name), "%08x%08x", header.hash[0], header.hash[1]);
+	const std::string path = FileSystem::JoinPathBelow(GEOMTREE_CACHE_DIR, name);
+
+	if (FILE *f = FileSystem::userFiles.OpenReadStream(path)) {
+		GeomTreeCacheHeader fileHeader;
+		GeomTree *t = 0;
+		if (fread(&fileHeader, sizeof(fileHeader), 1, f) == 1 && memcmp(&fileHeader, &header, sizeof(header)) == 0)
+			t = GeomTree::Load(f, numVerts, numTris, vertices, &ind[0], &flags[0]);
+		fclose(f);
+		if (t) return t;
+	}
+
+	GeomTree *t = new GeomTree(numVerts, numTris, vertices, &ind[0], &flags[0]);
+
+	// a short write leaves a file that fails to load, so the tree just gets
+	// built again next time
+	if (FileSystem::userFiles.MakeDirectory(GEOMTREE_CACHE_DIR)) {
+		if (FILE *f = FileSystem::userFiles.OpenWriteStream(path)) {
+			fwrite(&header, sizeof(header), 1, f);
+			t->Save(f);
+			fclose(f);
+		}
+	}
+	return t;
+}
+
 CollisionVisitor::CollisionVisitor()
 {
 	properData = false;
@@ -53,9 +117,12 @@ void CollisionVisitor::ApplyCollisionGeometry(CollisionGeometry &cg)
 
 	//copy data (with index offset)
 	int idxOffset = m_collMesh->m_vertices.size();
-	for (vector<vector3f>::const_iterator it = cg.GetVertices().begin(); it != cg.GetVertices().end(); ++it) {
-		const vector3f pos = matrix * (*it);
-		m_collMesh->m_vertices.push_back(pos);
+	const vector<vector3f> &vertices = cg.GetVertices();
+	m_collMesh->m_vertices.resize(idxOffset + vertices.size());
+	if (!vertices.empty())
+		TransformPoints(matrix, &vertices[0], &m_collMesh->m_vertices[idxOffset], vertices.size());
+	for (unsigned int i = idxOffset; i < m_collMesh->m_vertices.size(); i++) {
+		const vector3f &pos = m_collMesh->m_vertices[i];
 		m_collMesh->GetAabb().Update(pos.x, pos.y, pos.z);
 	}
 
@@ -140,8 +207,7 @@ RefCountedPtr<CollMesh> CollisionVisitor::CreateCollisionMesh()
 	assert(m_collMesh->GetGeomTree() == 0);
 	assert(!vts.empty() && !ind.empty());
 
-	GeomTree *t = new GeomTree(
-		vts.size(), ind.size()/3, reinterpret_cast<float*>(&vts[0]), &ind[0], &m_collMesh->m_flags[0]);
+	GeomTree *t = CreateGeomTree(vts, ind, m_collMesh->m_flags);
 	m_collMesh->SetGeomTree(t);
 	m_boundingRadius = m_collMesh->GetAabb().GetRadius();
 
@@ -6,12 +6,28 @@
 
 namespace SceneGraph {
 
+static const char CACHE_TYPE[] = "colormap";
+
 ColorMap::ColorMap()
 : m_smooth(true)
+, m_renderer(0)
 {
 
 }
 
+ColorMap::~ColorMap()
+{
+	Release();
+}
+
+void ColorMap::Release()
+{
+	//the cache and this are the last users
+	if (m_texture.Valid() && m_texture->GetRefCount() == 2)
+		m_renderer->RemoveCachedTexture(CACHE_TYPE, m_cacheName);
+	m_texture.Reset();
+}
+
 Graphics::Texture *ColorMap::GetTexture()
 {
 	assert(m_texture.Valid());
@@ -29,6 +45,24 @@ void ColorMap::AddColor(int width, const Color4ub &c, std::vector<unsigned char>
 
 void ColorMap::Generate(Graphics::Renderer *r, const Color4ub &a, const Color4ub &b, const Color4ub &c)
 {
+	char name[32];
+	snprintf(name, sizeof(name), "%02x%02x%02x%02x%02x%02x%02x%02x%02x%s",
+		a.r, a.g, a.b, b.r, b.g, b.b, c.r, c.g, c.b, m_smooth ? "s" : "");
+	if (m_texture.Valid() && m_cacheName == name) return;
+
+	Release();
+	m_renderer = r;
+	m_colors[0] = a;
+	m_colors[1] = b;
+	m_colors[2] = c;
+	m_cacheName = name;
+
+	Graphics::Texture *texture = r->GetCachedTexture(CACHE_TYPE, m_cacheName);
+	if (texture) {
+		m_texture.Reset(texture);
+		return;
+	}
+
 	std::vector<unsigned char> colors;
 	const int w = 4;
 	AddColor(w, Color4ub(255, 255, 255), colors);
@@ -39,20 +73,19 @@ void ColorMap::Generate(Graphics::Renderer *r, const Color4ub &a, const Color4ub
 
 	const Graphics::TextureFormat format = Graphics::TEXTURE_RGB_888;
 
-	if (!m_texture.Valid()) {
-		const Graphics::TextureSampleMode sampleMode = m_smooth ? Graphics::LINEAR_CLAMP : Graphics::NEAREST_CLAMP;
-		m_texture.Reset(r->CreateTexture(Graphics::TextureDescriptor(Graphics::TEXTURE_RGB_888, size, sampleMode)));
-	}
-
+	const Graphics::TextureSampleMode sampleMode = m_smooth ? Graphics::LINEAR_CLAMP : Graphics::NEAREST_CLAMP;
+	m_texture.Reset(r->CreateTexture(Graphics::TextureDescriptor(Graphics::TEXTURE_RGB_888, size, sampleMode)));
 	m_texture->Update(&colors[0], size, format);
+	r->AddCachedTexture(CACHE_TYPE, m_cacheName, m_texture.Get());
 }
 
 void ColorMap::SetSmooth(bool smooth)
 {
+	if (smooth == m_smooth) return;
 	m_smooth = smooth;
-	if (m_texture.Valid()) {
-		m_texture->SetSampleMode(m_smooth ? Graphics::LINEAR_CLAMP : Graphics::NEAREST_CLAMP);
-	}
+	//shared textures can't change, get the one sampled this way instead
+	if (m_texture.Valid())
+		Generate(m_renderer, m_colors[0], m_colors[1], m_colors[2]);
 }
 
 }
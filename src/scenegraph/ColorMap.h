@@ -5,6 +5,8 @@
 #define _SCENEGRAPH_COLORMAP_H
 /*
  * Color look-up texture generator for newmodel pattern system
+ * Textures are shared by all color maps with the same colors, through the
+ * renderer's texture cache, and dropped from it when the last one goes.
  */
 #include "libs.h"
 #include "graphics/Texture.h"
@@ -16,14 +18,19 @@ namespace SceneGraph {
 class ColorMap {
 public:
 	ColorMap();
+	~ColorMap();
 	Graphics::Texture *GetTexture();
 	void Generate(Graphics::Renderer *r, const Color4ub &a, const Color4ub &b, const Color4ub &c);
 	void SetSmooth(bool);
 
 private:
 	void AddColor(int width, const Color4ub &c, std::vector<unsigned char> &out);
+	void Release();
 
 	bool m_smooth;
+	Graphics::Renderer *m_renderer;
+	Color4ub m_colors[3];
+	std::string m_cacheName;
 	RefCountedPtr<Graphics::Texture> m_texture;
 };
 
@@ -34,6 +34,7 @@ Group::Group(const Group &group, NodeCopyCache *cache)
 
 Node* Group::Clone(NodeCopyCache *cache)
 {
+	if (cache->IsShared(this)) return this;
 	return cache->Copy<Group>(this);
 }
 
@@ -41,6 +42,7 @@ void Group::AddChild(Node *child)
 {
 	child->IncRefCount();
 	m_children.push_back(child);
+	BoundsChanged();
 }
 
 bool Group::RemoveChild(Node *node)
@@ -53,6 +55,7 @@ bool Group::RemoveChild(Node *node)
 		if((*itr) == node) {
 			itr = m_children.erase(itr);
 			node->DecRefCount();
+			BoundsChanged();
 			return true;
 		}
 	}
@@ -65,6 +68,7 @@ bool Group::RemoveChildAt(unsigned int idx)
 	Node *node = m_children.at(idx);
 	node->DecRefCount();
 	m_children.erase(m_children.begin() + idx);
+	BoundsChanged();
 	return true;
 }
 
@@ -103,6 +107,7 @@ void Group::Traverse(NodeVisitor &nv)
 
 void Group::Render(const matrix4x4f &trans, const RenderData *rd)
 {
+	if (IsTooSmall(trans, rd)) return;
 	RenderChildren(trans, rd);
 }
 
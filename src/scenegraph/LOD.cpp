@@ -21,6 +21,7 @@ LOD::LOD(const LOD &lod, NodeCopyCache *cache)
 
 Node* LOD::Clone(NodeCopyCache *cache)
 {
+	if (cache->IsShared(this)) return this;
 	return cache->Copy<LOD>(this);
 }
 
@@ -40,6 +41,8 @@ void LOD::AddLevel(float pixelSize, Node *nod)
 
 void LOD::Render(const matrix4x4f &trans, const RenderData *rd)
 {
+	if (IsTooSmall(trans, rd)) return;
+
 	//figure out approximate pixel size of object's bounding radius
 	//on screen and pick a child to render
 	const vector3f cameraPos(-trans[12], -trans[13], -trans[14]);
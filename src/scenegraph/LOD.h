@@ -18,6 +18,7 @@ public:
 	virtual const char *GetTypeName() const { return "LOD"; }
 	virtual void Accept(NodeVisitor &v);
 	void AddLevel(float pixelRadius, Node *child);
+	unsigned int GetPixelSize(unsigned int level) const { return m_pixelSizes.at(level); }
 	virtual void Render(const matrix4x4f &trans, const RenderData *rd);
 
 protected:
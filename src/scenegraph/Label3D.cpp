@@ -22,6 +22,7 @@ Label3D::Label3D(Graphics::Renderer *r, RefCountedPtr<Text::DistanceFieldFont> f
 	m_material->diffuse = Color::WHITE;
 	m_material->emissive = Color(0.15f);
 	m_material->specular = Color::WHITE;
+	SetBounds(vector3f(0.f), 0.f); //no text yet
 }
 
 Label3D::Label3D(const Label3D &label, NodeCopyCache *cache)
@@ -30,6 +31,7 @@ Label3D::Label3D(const Label3D &label, NodeCopyCache *cache)
 , m_font(label.m_font)
 {
 	m_geometry.Reset(m_font->CreateVertexArray());
+	SetBounds(vector3f(0.f), 0.f);
 }
 
 Node* Label3D::Clone(NodeCopyCache *cache)
@@ -43,14 +45,33 @@ void Label3D::SetText(const std::string &text)
 	m_geometry->Clear();
 	if (!text.empty())
 		m_font->GetGeometry(*m_geometry.Get(), text, vector2f(0.f));
+
+	const std::vector<vector3f> &pos = m_geometry->position;
+	if (pos.empty()) {
+		SetBounds(vector3f(0.f), 0.f);
+	} else {
+		vector3f min(pos[0]), max(pos[0]);
+		for (unsigned int i = 1; i < pos.size(); i++) {
+			min.x = std::min(min.x, pos[i].x); min.y = std::min(min.y, pos[i].y); min.z = std::min(min.z, pos[i].z);
+			max.x = std::max(max.x, pos[i].x); max.y = std::max(max.y, pos[i].y); max.z = std::max(max.z, pos[i].z);
+		}
+		SetBounds((min + max) * 0.5f, (max - min).Length() * 0.5f);
+	}
+	BoundsChanged();
 }
 
 void Label3D::Render(const matrix4x4f &trans, const RenderData *rd)
 {
-	//needs alpha test
+	const float fade = GetFade(trans, rd);
+	if (fade <= 0.f) return;
+
+	//needs alpha test, so fading thins the letters out. the material is
+	//shared
 	Graphics::Renderer *r = GetRenderer();
 	r->SetTransform(trans);
+	m_material->diffuse.a = fade;
 	r->DrawTriangles(m_geometry.Get(), m_material.Get());
+	m_material->diffuse.a = 1.f;
 }
 
 void Label3D::Accept(NodeVisitor &nv)
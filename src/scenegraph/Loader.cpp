@@ -2,9 +2,11 @@
 // Licensed under the terms of the GPL v3. See licenses/GPL-3.txt
 
 #include "Loader.h"
+#include "BinaryConverter.h"
 #include "CollisionGeometry.h"
 #include "FileSystem.h"
 #include "LOD.h"
+#include "OptimizeVisitor.h"
 #include "Parser.h"
 #include "SceneGraph.h"
 #include "StaticGeometry.h"
@@ -114,18 +116,140 @@ namespace {
 		FileSystem::FileSource &m_fs;
 	};
 
+	const aiScene *import_mesh(Assimp::Importer &importer, const std::string &filename)
+	{
+		importer.SetIOHandler(new AssimpFileSystem(FileSystem::gameDataFiles));
+
+		//Removing components is suggested to optimize loading. We do not care about vtx colors now.
+		importer.SetPropertyInteger(AI_CONFIG_PP_RVC_FLAGS, aiComponent_COLORS);
+		importer.SetPropertyInteger(AI_CONFIG_PP_SLM_VERTEX_LIMIT, Graphics::StaticMesh::MAX_VERTICES);
+
+		//There are several optimizations assimp can do, intentionally skipping them now
+		return importer.ReadFile(
+			filename,
+			aiProcess_RemoveComponent	|
+			aiProcess_Triangulate		|
+			aiProcess_SortByPType		| //ignore point, line primitive types (collada dummy nodes seem to be fine)
+			aiProcess_GenUVCoords		|
+			aiProcess_FlipUVs			|
+			aiProcess_SplitLargeMeshes	|
+			aiProcess_GenSmoothNormals);  //only if normals not specified
+	}
+
+	const aiScene *import_collision(Assimp::Importer &importer, const std::string &filename)
+	{
+		importer.SetIOHandler(new AssimpFileSystem(FileSystem::gameDataFiles));
+
+		//discard extra data
+		importer.SetPropertyInteger(AI_CONFIG_PP_RVC_FLAGS,
+			aiComponent_COLORS    |
+			aiComponent_TEXCOORDS |
+			aiComponent_NORMALS   |
+			aiComponent_MATERIALS
+			);
+		return importer.ReadFile(
+			filename,
+			aiProcess_RemoveComponent |
+			aiProcess_Triangulate     |
+			aiProcess_PreTransformVertices //"bake" transformations so we can disregard the structure
+			);
+	}
+
 } // anonymous namespace
 
 namespace SceneGraph {
 
+static FileSystem::FileInfo find_model_file(const std::string &shortname, const std::string &basepath, std::string &curPath)
+{
+	for (FileSystem::FileEnumerator files(FileSystem::gameDataFiles, basepath, FileSystem::FileEnumerator::Recurse); !files.Finished(); files.Next())
+	{
+		const FileSystem::FileInfo &info = files.Current();
+		const std::string &fpath = info.GetPath();
+
+		//check it's the expected type
+		if (info.IsFile() && ends_with(fpath, ".model")) {
+			//check it's the wanted name
+			const std::string name = info.GetName();
+
+			if (shortname == name.substr(0, name.length()-6)) {
+				//curPath is used to find textures, patterns,
+				//possibly other data files for this model.
+				//Strip trailing slash
+				curPath = info.GetDir();
+				assert(!curPath.empty());
+				if (curPath[curPath.length()-1] == '/')
+					curPath = curPath.substr(0, curPath.length()-1);
+				return info;
+			}
+		}
+
+	}
+	throw (LoadingError("File not found"));
+}
+
+static void parse_model(const FileSystem::FileInfo &info, const std::string &curPath, ModelDefinition &def)
+{
+	try {
+		Parser p(FileSystem::gameDataFiles, info.GetPath(), curPath);
+		p.Parse(&def);
+	} catch (ParseError &err) {
+		fprintf(stderr, "%s\n", err.what());
+		throw LoadingError(err.what());
+	}
+}
+
+ModelFiles::ModelFiles(const std::string &name, const std::string &basepath)
+: m_name(name)
+, m_basepath(basepath)
+{
+}
+
+ModelFiles::~ModelFiles()
+{
+	for (SceneMap::iterator it = m_meshes.begin(); it != m_meshes.end(); ++it)
+		delete it->second;
+	for (SceneMap::iterator it = m_collisions.begin(); it != m_collisions.end(); ++it)
+		delete it->second;
+}
+
+void ModelFiles::Read()
+{
+	m_modelFile = find_model_file(m_name, m_basepath, m_curPath);
+	parse_model(m_modelFile, m_curPath, m_def);
+	m_def.name = m_name;
+
+	m_compiledFile = FileSystem::gameDataFiles.Lookup(FileSystem::JoinPath(m_curPath, m_name + ".sgm"));
+	if (m_compiledFile.IsFile())
+		m_compiled = m_compiledFile.Read();
+	if (m_compiled) return;
+
+	//import failures are left for the Loader to report, like it does
+	//for files it imports itself
+	for (std::vector<LodDefinition>::const_iterator lod = m_def.lodDefs.begin(); lod != m_def.lodDefs.end(); ++lod) {
+		for (std::vector<std::string>::const_iterator it = (*lod).meshNames.begin(); it != (*lod).meshNames.end(); ++it) {
+			if (m_meshes.count(*it)) continue;
+			Assimp::Importer *importer = new Assimp::Importer;
+			m_meshes[*it] = importer;
+			import_mesh(*importer, *it);
+		}
+	}
+	for (std::vector<std::string>::const_iterator it = m_def.collisionDefs.begin(); it != m_def.collisionDefs.end(); ++it) {
+		if (m_collisions.count(*it)) continue;
+		Assimp::Importer *importer = new Assimp::Importer;
+		m_collisions[*it] = importer;
+		import_collision(*importer, *it);
+	}
+}
+
 Loader::Loader(Graphics::Renderer *r, bool logWarnings)
 : m_renderer(r)
+, m_textureLoader(0)
 , m_model(0)
+, m_files(0)
 , m_doLog(logWarnings)
 , m_mostDetailedLod(false)
 {
-	Graphics::Texture *sdfTex = Graphics::TextureBuilder("fonts/label3d.png", Graphics::LINEAR_CLAMP, true, true, true).GetOrCreateTexture(r, "model");
-	m_labelFont.Reset(new Text::DistanceFieldFont("fonts/sdf_definition.txt", sdfTex));
+	m_labelFont = Text::DistanceFieldFont::GetLabelFont(r);
 }
 
 Loader::~Loader()
@@ -139,44 +263,66 @@ Model *Loader::LoadModel(const std::string &filename)
 }
 
 Model *Loader::LoadModel(const std::string &shortname, const std::string &basepath)
+{
+	ModelFiles files(shortname, basepath);
+	files.Read();
+	return LoadModel(files);
+}
+
+Model *Loader::LoadModel(const ModelFiles &files)
 {
 	m_logMessages.clear();
+	m_curPath = files.m_curPath;
 
-	FileSystem::FileSource &fileSource = FileSystem::gameDataFiles;
-	for (FileSystem::FileEnumerator files(fileSource, basepath, FileSystem::FileEnumerator::Recurse); !files.Finished(); files.Next())
-	{
-		const FileSystem::FileInfo &info = files.Current();
-		const std::string &fpath = info.GetPath();
+	//a compiled model, if there is an up to date one, spares assimp
+	if (files.m_compiled) {
+		Model *model = BinaryConverter(*this).Load(files.m_name, files.m_compiledFile, files.m_compiled);
+		if (model) return model;
+	}
 
-		//check it's the expected type
-		if (info.IsFile() && ends_with(fpath, ".model")) {
-			//check it's the wanted name & load it
-			const std::string name = info.GetName();
+	m_files = &files;
+	ModelDefinition modelDefinition = files.m_def;
+	Model *model = 0;
+	try {
+		model = CreateModel(modelDefinition);
+	} catch (LoadingError &) {
+		m_files = 0;
+		throw;
+	}
+	m_files = 0;
+	return model;
+}
 
-			if (shortname == name.substr(0, name.length()-6)) {
-				ModelDefinition modelDefinition;
-				try {
-					//curPath is used to find textures, patterns,
-					//possibly other data files for this model.
-					//Strip trailing slash
-					m_curPath = info.GetDir();
-					assert(!m_curPath.empty());
-					if (m_curPath[m_curPath.length()-1] == '/')
-						m_curPath = m_curPath.substr(0, m_curPath.length()-1);
-
-					Parser p(fileSource, fpath, m_curPath);
-					p.Parse(&modelDefinition);
-				} catch (ParseError &err) {
-					fprintf(stderr, "%s\n", err.what());
-					throw LoadingError(err.what());
-				}
-				modelDefinition.name = shortname;
-				return CreateModel(modelDefinition);
-			}
-		}
+std::string Loader::CompileModel(const std::string &shortname, const std::string &basepath)
+{
+	m_logMessages.clear();
 
-	}
-	throw (LoadingError("File not found"));
+	const FileSystem::FileInfo info = find_model_file(shortname, basepath, m_curPath);
+	ModelDefinition modelDefinition;
+	parse_model(info, m_curPath, modelDefinition);
+	modelDefinition.name = shortname;
+
+	ScopedPtr<Model> model(CreateModel(modelDefinition));
+	if (!model) throw LoadingError("Nothing to compile");
+
+	//everything the compiled model is made from, so it can tell when it's stale
+	std::vector<std::string> sources;
+	sources.push_back(info.GetPath());
+	for (std::vector<LodDefinition>::const_iterator lod = modelDefinition.lodDefs.begin();
+		lod != modelDefinition.lodDefs.end(); ++lod)
+		sources.insert(sources.end(), (*lod).meshNames.begin(), (*lod).meshNames.end());
+	sources.insert(sources.end(), modelDefinition.collisionDefs.begin(), modelDefinition.collisionDefs.end());
+
+	const std::string data = BinaryConverter(*this).Save(model.Get(), modelDefinition, sources);
+
+	const std::string outName = shortname + ".sgm";
+	FILE *f = FileSystem::FileSourceFS(info.GetAbsoluteDir()).OpenWriteStream(outName);
+	if (!f) throw LoadingError(stringf("Could not write %0", outName));
+	const size_t written = fwrite(data.data(), 1, data.size(), f);
+	fclose(f);
+	if (written != data.size()) throw LoadingError(stringf("Could not write %0", outName));
+
+	return FileSystem::JoinPath(m_curPath, outName);
 }
 
 Model *Loader::CreateModel(ModelDefinition &def)
@@ -187,62 +333,12 @@ Model *Loader::CreateModel(ModelDefinition &def)
 
 	Model *model = new Model(m_renderer, def.name);
 	m_model = model;
-	bool patternsUsed = false;
 
 	m_thrustersRoot.Reset(new Group(m_renderer));
 	m_billboardsRoot.Reset(new Group(m_renderer));
 
-	//create materials from definitions
-	for(std::vector<MaterialDefinition>::const_iterator it = def.matDefs.begin();
-		it != def.matDefs.end(); ++it)
-	{
-		//Build material descriptor
-		assert(!(*it).name.empty());
-		const std::string &diffTex = (*it).tex_diff;
-		const std::string &specTex = (*it).tex_spec;
-		const std::string &glowTex = (*it).tex_glow;
-
-		Graphics::MaterialDescriptor matDesc;
-		matDesc.lighting = !it->unlit;
-		matDesc.alphaTest = it->alpha_test;
-		matDesc.twoSided = it->two_sided;
-
-		if ((*it).use_pattern) {
-			patternsUsed = true;
-			matDesc.usePatterns = true;
-		}
-
-		//diffuse texture is a must. Will create a white dummy texture if one is not supplied
-		matDesc.textures = 1;
-		matDesc.specularMap = !specTex.empty();
-		matDesc.glowMap = !glowTex.empty();
-
-		//Create material and set parameters
-		RefCountedPtr<Material> mat(m_renderer->CreateMaterial(matDesc));
-		mat->diffuse = (*it).diffuse;
-		mat->specular = (*it).specular;
-		mat->emissive = (*it).emissive;
-		mat->shininess = (*it).shininess;
-
-		//semitransparent material
-		//the node must be marked transparent when using this material
-		//and should not be mixed with opaque materials
-		if ((*it).opacity < 100)
-			mat->diffuse.a = float((*it).opacity) / 100.f;
-
-		if (!diffTex.empty())
-			mat->texture0 = Graphics::TextureBuilder::Model(diffTex).GetOrCreateTexture(m_renderer, "model");
-		else
-			mat->texture0 = Graphics::TextureBuilder::GetWhiteTexture(m_renderer);
-		if (!specTex.empty())
-			mat->texture1 = Graphics::TextureBuilder::Model(specTex).GetOrCreateTexture(m_renderer, "model");
-		if (!glowTex.empty())
-			mat->texture2 = Graphics::TextureBuilder::Model(glowTex).GetOrCreateTexture(m_renderer, "model");
-		//texture3 is reserved for pattern
-		//texture4 is reserved for color gradient
+	const bool patternsUsed = CreateMaterials(def.matDefs);
 
-		model->m_materials.push_back(std::make_pair((*it).name, mat));
-	}
 	//printf("Loaded %d materials\n", int(model->m_materials.size()));
 
 	//load meshes
@@ -323,16 +419,97 @@ Model *Loader::CreateModel(ModelDefinition &def)
 		}
 	}
 
+	//pre-transform unanimated meshes, merge geometry and drop empty groups.
+	//the animated transforms have to stay
+	std::set<const Node*> animated;
+	for (AnimationContainer::const_iterator anim = model->m_animations.begin(); anim != model->m_animations.end(); ++anim) {
+		const std::vector<AnimationChannel> &channels = (*anim)->GetChannels();
+		for (std::vector<AnimationChannel>::const_iterator chan = channels.begin(); chan != channels.end(); ++chan)
+			animated.insert(chan->node);
+	}
+	OptimizeVisitor optimizer(animated);
+	model->GetRoot()->Accept(optimizer);
+	if (optimizer.GetNumRemoved() > 0)
+		AddLog(stringf("%0: removed %1{u} nodes", def.name, optimizer.GetNumRemoved()));
+
+	FinishModel(patternsUsed);
+
+	return model;
+}
+
+bool Loader::CreateMaterials(const std::vector<MaterialDefinition> &matDefs)
+{
+	using Graphics::Material;
+	bool patternsUsed = false;
+
+	for(std::vector<MaterialDefinition>::const_iterator it = matDefs.begin();
+		it != matDefs.end(); ++it)
+	{
+		//Build material descriptor
+		assert(!(*it).name.empty());
+		const std::string &diffTex = (*it).tex_diff;
+		const std::string &specTex = (*it).tex_spec;
+		const std::string &glowTex = (*it).tex_glow;
+
+		Graphics::MaterialDescriptor matDesc;
+		matDesc.lighting = !it->unlit;
+		matDesc.alphaTest = it->alpha_test;
+		matDesc.twoSided = it->two_sided;
+
+		if ((*it).use_pattern) {
+			patternsUsed = true;
+			matDesc.usePatterns = true;
+		}
+
+		//diffuse texture is a must. Will create a white dummy texture if one is not supplied
+		matDesc.textures = 1;
+		matDesc.specularMap = !specTex.empty();
+		matDesc.glowMap = !glowTex.empty();
+
+		//Create material and set parameters
+		RefCountedPtr<Material> mat(m_renderer->CreateMaterial(matDesc));
+		mat->diffuse = (*it).diffuse;
+		mat->specular = (*it).specular;
+		mat->emissive = (*it).emissive;
+		mat->shininess = (*it).shininess;
+
+		//semitransparent material
+		//the node must be marked transparent when using this material
+		//and should not be mixed with opaque materials
+		if ((*it).opacity < 100)
+			mat->diffuse.a = float((*it).opacity) / 100.f;
+
+		//while loading, maps show white for diffuse and nothing
+		//(transparent black) for specular and glow
+		if (!diffTex.empty())
+			LoadMaterialTexture(mat, &Material::texture0, diffTex, Graphics::TextureBuilder::GetWhiteTexture(m_renderer));
+		else
+			mat->texture0 = Graphics::TextureBuilder::GetWhiteTexture(m_renderer);
+		if (!specTex.empty())
+			LoadMaterialTexture(mat, &Material::texture1, specTex, Graphics::TextureBuilder::GetTransparentTexture(m_renderer));
+		if (!glowTex.empty())
+			LoadMaterialTexture(mat, &Material::texture2, glowTex, Graphics::TextureBuilder::GetTransparentTexture(m_renderer));
+		//texture3 is reserved for pattern
+		//texture4 is reserved for color gradient
+
+		m_model->m_materials.push_back(std::make_pair((*it).name, mat));
+	}
+
+	return patternsUsed;
+}
+
+void Loader::FinishModel(bool patternsUsed)
+{
 	// Run CollisionVisitor to create the initial CM and its GeomTree.
 	// If no collision mesh is defined, a simple bounding box will be generated
 	m_model->CreateCollisionMesh();
 
 	//find usable pattern textures from the model directory
 	if (patternsUsed) {
-		FindPatterns(model->m_patterns);
+		FindPatterns(m_model->m_patterns);
 
-		if (model->m_patterns.empty()) {
-			model->m_patterns.push_back(Pattern());
+		if (m_model->m_patterns.empty()) {
+			m_model->m_patterns.push_back(Pattern());
 			Pattern &dumpat = m_model->m_patterns.back();
 			dumpat.name = "Dummy";
 			dumpat.texture = RefCountedPtr<Graphics::Texture>(Graphics::TextureBuilder::GetWhiteTexture(m_renderer));
@@ -343,11 +520,9 @@ Model *Loader::CreateModel(ModelDefinition &def)
 		colors.push_back(Color4ub::RED);
 		colors.push_back(Color4ub::GREEN);
 		colors.push_back(Color4ub::BLUE);
-		model->SetColors(colors);
-		model->SetPattern(0);
+		m_model->SetColors(colors);
+		m_model->SetPattern(0);
 	}
-
-	return model;
 }
 
 void Loader::FindPatterns(PatternContainer &output)
@@ -368,23 +543,14 @@ RefCountedPtr<Node> Loader::LoadMesh(const std::string &filename, const AnimList
 	size_t slashpos = filename.rfind("/");
 	m_curMeshDef = filename.substr(slashpos+1, filename.length()-slashpos);
 
+	//imported ahead of time if it came with ModelFiles
 	Assimp::Importer importer;
-	importer.SetIOHandler(new AssimpFileSystem(FileSystem::gameDataFiles));
-
-	//Removing components is suggested to optimize loading. We do not care about vtx colors now.
-	importer.SetPropertyInteger(AI_CONFIG_PP_RVC_FLAGS, aiComponent_COLORS);
-	importer.SetPropertyInteger(AI_CONFIG_PP_SLM_VERTEX_LIMIT, Graphics::StaticMesh::MAX_VERTICES);
-
-	//There are several optimizations assimp can do, intentionally skipping them now
-	const aiScene *scene = importer.ReadFile(
-		filename,
-		aiProcess_RemoveComponent	|
-		aiProcess_Triangulate		|
-		aiProcess_SortByPType		| //ignore point, line primitive types (collada dummy nodes seem to be fine)
-		aiProcess_GenUVCoords		|
-		aiProcess_FlipUVs			|
-		aiProcess_SplitLargeMeshes	|
-		aiProcess_GenSmoothNormals);  //only if normals not specified
+	const aiScene *scene = 0;
+	ModelFiles::SceneMap::const_iterator imported;
+	if (m_files && (imported = m_files->m_meshes.find(filename)) != m_files->m_meshes.end())
+		scene = imported->second->GetScene();
+	else
+		scene = import_mesh(importer, filename);
 
 	if(!scene)
 		throw LoadingError("Couldn't load file");
@@ -848,6 +1014,15 @@ void Loader::ConvertNodes(aiNode *node, Group *_parent, std::vector<RefCountedPt
 	}
 }
 
+void Loader::LoadMaterialTexture(RefCountedPtr<Graphics::Material> mat, Graphics::TextureLoader::TextureSlot slot, const std::string &filename, Graphics::Texture *placeholder)
+{
+	Graphics::TextureBuilder builder = Graphics::TextureBuilder::Model(filename);
+	if (m_textureLoader)
+		m_textureLoader->Load(builder, "model", mat, slot, placeholder);
+	else
+		mat.Get()->*slot = builder.GetOrCreateTexture(m_renderer, "model");
+}
+
 void Loader::LoadCollision(const std::string &filename)
 {
 	//Convert all found aiMeshes into a geomtree. Materials,
@@ -855,21 +1030,12 @@ void Loader::LoadCollision(const std::string &filename)
 	assert(m_model);
 
 	Assimp::Importer importer;
-	importer.SetIOHandler(new AssimpFileSystem(FileSystem::gameDataFiles));
-
-	//discard extra data
-	importer.SetPropertyInteger(AI_CONFIG_PP_RVC_FLAGS,
-		aiComponent_COLORS    |
-		aiComponent_TEXCOORDS |
-		aiComponent_NORMALS   |
-		aiComponent_MATERIALS
-		);
-	const aiScene *scene = importer.ReadFile(
-		filename,
-		aiProcess_RemoveComponent |
-		aiProcess_Triangulate     |
-		aiProcess_PreTransformVertices //"bake" transformations so we can disregard the structure
-		);
+	const aiScene *scene = 0;
+	ModelFiles::SceneMap::const_iterator imported;
+	if (m_files && (imported = m_files->m_collisions.find(filename)) != m_files->m_collisions.end())
+		scene = imported->second->GetScene();
+	else
+		scene = import_collision(importer, filename);
 
 	if(!scene)
 		throw LoadingError("Could not load file");
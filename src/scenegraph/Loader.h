@@ -10,13 +10,16 @@
  *  then a scenegraph can be created with meshes loaded by assimp.
  */
 #include "libs.h"
+#include "FileSystem.h"
 #include "Model.h"
 #include "LoaderDefinitions.h"
 #include "graphics/Material.h"
 #include "graphics/Surface.h"
+#include "graphics/TextureLoader.h"
 #include "text/DistanceFieldFont.h"
 #include <assimp/types.h>
 
+namespace Assimp { class Importer; }
 struct aiNode;
 struct aiMesh;
 struct aiScene;
@@ -28,6 +31,35 @@ namespace SceneGraph {
 
 class StaticGeometry;
 
+//the part of loading a model that doesn't need the renderer: finding and
+//parsing the .model, and reading the compiled model or importing the mesh
+//files. safe to do on a job thread, then give it to Loader::LoadModel
+class ModelFiles {
+public:
+	ModelFiles(const std::string &name, const std::string &basepath = "models");
+	~ModelFiles();
+	void Read(); //throws LoadingError if the model can't be found or parsed
+	const std::string &GetName() const { return m_name; }
+
+private:
+	friend class Loader;
+	ModelFiles(const ModelFiles&);
+	ModelFiles &operator=(const ModelFiles&);
+
+	//importers keep their scenes
+	typedef std::map<std::string, Assimp::Importer*> SceneMap;
+
+	std::string m_name;
+	std::string m_basepath;
+	std::string m_curPath;
+	FileSystem::FileInfo m_modelFile;
+	ModelDefinition m_def;
+	FileSystem::FileInfo m_compiledFile;
+	RefCountedPtr<FileSystem::FileData> m_compiled;
+	SceneMap m_meshes;
+	SceneMap m_collisions;
+};
+
 class Loader {
 public:
 	Loader(Graphics::Renderer *r, bool logWarnings = false);
@@ -35,12 +67,25 @@ public:
 	//find & attempt to load a model, based on filename (without path or .model suffix)
 	Model *LoadModel(const std::string &name);
 	Model *LoadModel(const std::string &name, const std::string &basepath);
+	//make a model from files read before. main thread only
+	Model *LoadModel(const ModelFiles &files);
+	//load a model from its sources and write it out compiled (.sgm) next
+	//to the .model file. returns the path of the written file
+	std::string CompileModel(const std::string &name, const std::string &basepath = "models");
 
 	const std::vector<std::string> &GetLogMessages() const { return m_logMessages; }
 
+	//load material textures in the background, showing placeholders
+	//until they're ready. without one they're loaded right away
+	void SetTextureLoader(Graphics::TextureLoader *tl) { m_textureLoader = tl; }
+
 private:
+	friend class BinaryConverter;
+
 	Graphics::Renderer *m_renderer;
+	Graphics::TextureLoader *m_textureLoader;
 	Model *m_model;
+	const ModelFiles *m_files; //while loading from them
 	bool m_doLog;
 	bool m_mostDetailedLod;
 	RefCountedPtr<Text::DistanceFieldFont> m_labelFont;
@@ -54,6 +99,8 @@ private:
 	bool CheckKeysInRange(const aiNodeAnim *, double start, double end);
 	matrix4x4f ConvertMatrix(const aiMatrix4x4&) const;
 	Model *CreateModel(ModelDefinition &def);
+	bool CreateMaterials(const std::vector<MaterialDefinition> &matDefs); //true if patterns are used
+	void FinishModel(bool patternsUsed); //collision mesh, patterns & colours
 	RefCountedPtr<Graphics::Material> GetDecalMaterial(unsigned int index);
 	RefCountedPtr<Node> LoadMesh(const std::string &filename, const AnimList &animDefs); //load one mesh file so it can be added to the model scenegraph. Materials should be created before this!
 	void AddLog(const std::string&);
@@ -66,6 +113,7 @@ private:
 	void CreateNavlight(const std::string &name, const matrix4x4f& nodeTrans, const matrix4x4f &accum);
 	void FindPatterns(PatternContainer &output); //find pattern texture files from the model directory
 	void LoadCollision(const std::string &filename);
+	void LoadMaterialTexture(RefCountedPtr<Graphics::Material> mat, Graphics::TextureLoader::TextureSlot slot, const std::string &filename, Graphics::Texture *placeholder);
 
 	unsigned int GetGeomFlagForNodeName(const std::string&);
 };
@@ -21,6 +21,7 @@ MatrixTransform::MatrixTransform(const MatrixTransform &mt, NodeCopyCache *cache
 
 Node* MatrixTransform::Clone(NodeCopyCache *cache)
 {
+	if (cache->IsShared(this)) return this;
 	return cache->Copy<MatrixTransform>(this);
 }
 
@@ -32,6 +33,7 @@ void MatrixTransform::Accept(NodeVisitor &nv)
 void MatrixTransform::Render(const matrix4x4f &trans, const RenderData *rd)
 {
 	const matrix4x4f t = trans * m_transform;
+	if (IsTooSmall(t, rd)) return;
 	//renderer->SetTransform(t);
 	//DrawAxes();
 	RenderChildren(t, rd);
@@ -2,6 +2,8 @@
 // Licensed under the terms of the GPL v3. See licenses/GPL-3.txt
 
 #include "Model.h"
+#include "Billboard.h"
+#include "BoundsVisitor.h"
 #include "CollisionVisitor.h"
 #include "NodeCopyCache.h"
 #include "graphics/Renderer.h"
@@ -18,10 +20,38 @@ public:
 	std::string label;
 };
 
+//finds the nodes instances need their own copies of: the ones holding
+//per-instance state (labels, billboards, animated transforms, tags and
+//other attachment points) and every node above them
+class InstancedNodeVisitor : public NodeVisitor {
+public:
+	InstancedNodeVisitor(std::set<const Node*> &instanced) : m_instanced(instanced) { }
+
+	virtual void ApplyNode(Node &n) { Visit(n, m_instanced.count(&n) > 0); }
+	virtual void ApplyMatrixTransform(MatrixTransform &m) { Visit(m, m_instanced.count(&m) || m.GetNumChildren() == 0); }
+	virtual void ApplyLabel(Label3D &l) { Visit(l, true); }
+	virtual void ApplyBillboard(Billboard &b) { Visit(b, true); }
+
+private:
+	void Visit(Node &n, bool instanced) {
+		m_path.push_back(&n);
+		if (instanced) m_instanced.insert(m_path.begin(), m_path.end());
+		n.Traverse(*this);
+		m_path.pop_back();
+	}
+
+	std::set<const Node*> &m_instanced;
+	std::vector<const Node*> m_path;
+};
+
+float Model::s_minPixelSize = 0.f;
+
 Model::Model(Graphics::Renderer *r, const std::string &name)
 : m_boundingRadius(10.f)
 , m_renderer(r)
 , m_name(name)
+, m_boundsSerial(~0u)
+, m_instances(new RefCounted)
 , m_curPattern(0)
 {
 	m_root.Reset(new Group(m_renderer));
@@ -36,10 +66,25 @@ Model::Model(const Model &model)
 , m_collMesh(model.m_collMesh) //might have to make this per-instance at some point
 , m_renderer(model.m_renderer)
 , m_name(model.m_name)
+, m_boundsSerial(~0u)
+, m_instances(model.m_instances)
 , m_curPattern(model.m_curPattern)
 {
-	//selective copying of node structure
+	//selective copying of node structure: static parts of the graph are
+	//shared by all instances
 	NodeCopyCache cache;
+	std::set<const Node*> instanced;
+	instanced.insert(model.m_root.Get());
+	for (TagContainer::const_iterator it = model.m_tags.begin(); it != model.m_tags.end(); ++it)
+		instanced.insert(*it);
+	for (AnimationContainer::const_iterator it = model.m_animations.begin(); it != model.m_animations.end(); ++it) {
+		const std::vector<AnimationChannel> &channels = (*it)->GetChannels();
+		for (std::vector<AnimationChannel>::const_iterator chan = channels.begin(); chan != channels.end(); ++chan)
+			instanced.insert(chan->node);
+	}
+	InstancedNodeVisitor iv(instanced);
+	model.m_root->Accept(iv);
+	cache.SetInstanced(instanced);
 	m_root.Reset(dynamic_cast<Group*>(model.m_root->Clone(&cache)));
 
 	//materials are shared by meshes
@@ -103,6 +148,14 @@ void Model::Render(const matrix4x4f &trans, const RenderData *rd)
 
 	//Override renderdata if this model is called from ModelNode
 	RenderData params = (rd != 0) ? (*rd) : m_renderData;
+	if (!rd) params.minPixelSize = s_minPixelSize;
+
+	//nodes were added or changed since the bounds were last worked out
+	if (m_boundsSerial != Node::GetBoundsSerial()) {
+		BoundsVisitor bv;
+		m_root->Accept(bv);
+		m_boundsSerial = Node::GetBoundsSerial();
+	}
 
 	m_renderer->SetBlendMode(Graphics::BLEND_SOLID);
 	m_renderer->SetTransform(trans);
@@ -110,6 +163,10 @@ void Model::Render(const matrix4x4f &trans, const RenderData *rd)
 	//BR could also be a property of Node.
 	params.boundingRadius = GetDrawClipRadius();
 
+	//hold the meshes back so they can be drawn sorted by material. the
+	//materials get their textures set above, the queue keeps a copy
+	Graphics::Renderer::QueueTicket queue(m_renderer);
+
 	//render in two passes, if this is the top-level model
 	if (params.nodemask & MASK_IGNORE) {
 		m_root->Render(trans, &params);
@@ -35,8 +35,10 @@
  * to use Collada (.dae). The format needs to support node names since many
  * special features are based on that.
  *
- * Loading all the meshes can be quite slow, so there will be a system to
- * compile them into a more game-friendly binary format.
+ * Loading all the meshes can be quite slow, so models can be compiled into a
+ * binary .sgm file next to the .model (see BinaryConverter, and the
+ * -modelcompiler mode). The Loader prefers an up to date .sgm when there is one.
+ * Freshly loaded graphs are flattened by OptimizeVisitor.
  *
  * Animation: position/rotation/scale keyframe animation affecting MatrixTransforms,
  * and subsequently nodes attached to them. There is no animation blending, although
@@ -57,7 +59,6 @@
  *
  * Things to optimize:
  *  - model cache
- *  - removing unnecessary nodes from the scene graph: pre-translate unanimated meshes etc.
  */
 #include "libs.h"
 #include "Animation.h"
@@ -87,10 +88,17 @@ class Model
 {
 public:
 	friend class Loader;
+	friend class BinaryConverter;
 	Model(Graphics::Renderer *r, const std::string &name);
 	~Model();
 
+	//instances get their own copies of animated transforms, tags, labels
+	//and the nodes above them, the rest of the graph is shared. change
+	//other nodes of an instance and all of them change
 	Model *MakeInstance() const;
+	//the other models sharing this one's data: for the model instances
+	//are made from, the instances still around
+	unsigned int GetNumInstances() const { return m_instances->GetRefCount() - 1; }
 
 	const std::string& GetName() const { return m_name; }
 
@@ -136,6 +144,11 @@ public:
 	void Save(Serializer::Writer &wr) const;
 	void Load(Serializer::Reader &rd);
 
+	//parts of models smaller than this radius on screen are not drawn,
+	//0 (the default) draws everything
+	static void SetMinPixelSize(float pixels) { s_minPixelSize = pixels; }
+	static float GetMinPixelSize() { return s_minPixelSize; }
+
 private:
 	Model(const Model&);
 
@@ -152,6 +165,10 @@ private:
 	std::vector<Animation *> m_animations;
 	TagContainer m_tags; //named attachment points
 	RenderData m_renderData;
+	unsigned int m_boundsSerial; //Node::GetBoundsSerial() when the bounds were last updated
+	RefCountedPtr<RefCounted> m_instances; //held by every instance, to count them
+
+	static float s_minPixelSize;
 
 	//per-instance flavour data
 	Graphics::Texture *m_curPattern;
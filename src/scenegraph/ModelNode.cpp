@@ -10,6 +10,7 @@ ModelNode::ModelNode(Model *m)
 : Node(m->GetRenderer())
 , m_model(m)
 {
+	SetBounds(vector3f(0.f), m->GetDrawClipRadius());
 }
 
 ModelNode::ModelNode(const ModelNode &modelNode, NodeCopyCache *cache)
@@ -3,14 +3,22 @@
 
 #include "Node.h"
 #include "NodeVisitor.h"
+#include "graphics/Graphics.h"
 #include "graphics/Renderer.h"
 
 namespace SceneGraph {
 
+//fading starts at this many times the cull size
+static const float FADE_RANGE = 4.f;
+
+unsigned int Node::s_boundsSerial = 0;
+
 Node::Node(Graphics::Renderer *r)
 : m_name("")
 , m_nodeMask(NODE_SOLID)
 , m_renderer(r)
+, m_boundCentre(0.f)
+, m_boundRadius(-1.f)
 {
 }
 
@@ -18,6 +26,8 @@ Node::Node(Graphics::Renderer *r, unsigned int nodemask)
 : m_name("")
 , m_nodeMask(nodemask)
 , m_renderer(r)
+, m_boundCentre(0.f)
+, m_boundRadius(-1.f)
 {
 }
 
@@ -25,6 +35,8 @@ Node::Node(const Node &node, NodeCopyCache *cache)
 : m_name(node.m_name)
 , m_nodeMask(node.m_nodeMask)
 , m_renderer(node.m_renderer)
+, m_boundCentre(node.m_boundCentre)
+, m_boundRadius(node.m_boundRadius)
 {
 }
 
@@ -37,6 +49,40 @@ void Node::Traverse(NodeVisitor &v)
 {
 }
 
+float Node::GetMaxScale(const matrix4x4f &m)
+{
+	const float x = vector3f(m[0], m[1], m[2]).LengthSqr();
+	const float y = vector3f(m[4], m[5], m[6]).LengthSqr();
+	const float z = vector3f(m[8], m[9], m[10]).LengthSqr();
+	return sqrt(std::max(x, std::max(y, z)));
+}
+
+float Node::GetPixelRadius(const matrix4x4f &trans) const
+{
+	if (m_boundRadius < 0.f) return -1.f;
+	const float radius = m_boundRadius * GetMaxScale(trans);
+	const float dist = (trans * m_boundCentre).Length();
+	if (dist <= radius) return -1.f;
+	//same estimate as LOD. fov is vertical, so using screen height
+	return Graphics::GetScreenHeight() * radius / (dist * Graphics::GetFovFactor());
+}
+
+bool Node::IsTooSmall(const matrix4x4f &trans, const RenderData *rd) const
+{
+	if (rd->minPixelSize <= 0.f || m_boundRadius < 0.f) return false;
+	if (m_boundRadius <= 0.f) return true; //nothing to draw
+	const float pixrad = GetPixelRadius(trans);
+	return pixrad >= 0.f && pixrad < rd->minPixelSize;
+}
+
+float Node::GetFade(const matrix4x4f &trans, const RenderData *rd) const
+{
+	if (rd->minPixelSize <= 0.f) return 1.f;
+	const float pixrad = GetPixelRadius(trans);
+	if (pixrad < 0.f) return 1.f;
+	return Clamp((pixrad - rd->minPixelSize) / (rd->minPixelSize * (FADE_RANGE - 1.f)), 0.f, 1.f);
+}
+
 Node* Node::FindNode(const std::string &name)
 {
 	if (m_name == name)
@@ -31,12 +31,14 @@ struct RenderData
 
 	float boundingRadius;	//updated by model and passed to submodels
 	unsigned int nodemask;
+	float minPixelSize;		//nodes with a smaller radius on screen are skipped, 0 draws everything
 
 	RenderData()
 	: linthrust()
 	, angthrust()
 	, boundingRadius(0.f)
 	, nodemask(0x1) //draw solids
+	, minPixelSize(0.f)
 	{
 	}
 };
@@ -63,12 +65,42 @@ public:
 
 	Graphics::Renderer *GetRenderer() const { return m_renderer; }
 
+	//bounding sphere of what the node draws, in the space it draws in (for
+	//a MatrixTransform, the space of its children). groups are kept up to
+	//date by BoundsVisitor. a negative radius means not known, and the node
+	//is always drawn. zero means it draws nothing
+	void SetBounds(const vector3f &centre, float radius) { m_boundCentre = centre; m_boundRadius = radius; }
+	const vector3f &GetBoundCentre() const { return m_boundCentre; }
+	float GetBoundRadius() const { return m_boundRadius; }
+
+	//radius of the bounds on screen in pixels, drawn with trans. negative if
+	//not known or the camera is inside them
+	float GetPixelRadius(const matrix4x4f &trans) const;
+	//true if the node is smaller on screen than rd->minPixelSize
+	bool IsTooSmall(const matrix4x4f &trans, const RenderData *rd) const;
+	//1, going down to 0 as the node shrinks to the cull size. for fading
+	//out lights and labels instead of popping them
+	float GetFade(const matrix4x4f &trans, const RenderData *rd) const;
+
+	//largest scale factor of a transform, to scale bounding radii with
+	static float GetMaxScale(const matrix4x4f &trans);
+
+	//changes whenever some node's bounds may have changed, so models know
+	//to update theirs
+	static unsigned int GetBoundsSerial() { return s_boundsSerial; }
+
 protected:
 	//can only to be deleted using DecRefCount
 	virtual ~Node() { }
+	static void BoundsChanged() { s_boundsSerial++; }
 	std::string m_name;
 	unsigned int m_nodeMask;
 	Graphics::Renderer *m_renderer;
+	vector3f m_boundCentre;
+	float m_boundRadius;
+
+private:
+	static unsigned int s_boundsSerial;
 };
 
 }
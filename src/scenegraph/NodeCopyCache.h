@@ -6,6 +6,7 @@
 
 #include "RefCounted.h"
 #include <map>
+#include <set>
 
 namespace SceneGraph {
 
@@ -13,6 +14,13 @@ class Node;
 
 class NodeCopyCache {
 public:
+	NodeCopyCache() : m_shareUnlisted(false) { }
+
+	//nodes with per-instance state, or with such nodes below them. when
+	//given, all other nodes are shared by the copies instead of copied
+	void SetInstanced(const std::set<const Node*> &nodes) { m_instanced = nodes; m_shareUnlisted = true; }
+	bool IsShared(const Node *node) const { return m_shareUnlisted && !m_instanced.count(node); }
+
 	template <typename T> T *Copy(const T *origNode) {
 		const bool doCache = origNode->GetRefCount() > 1;
 		if (doCache) {
@@ -28,6 +36,8 @@ public:
 
 private:
 	std::map<const Node*,Node*> m_cache;
+	std::set<const Node*> m_instanced;
+	bool m_shareUnlisted;
 };
 
 }
@@ -0,0 +1,192 @@
+// Copyright © 2008-2013 Pioneer Developers. See AUTHORS.txt for details
+// Licensed under the terms of the GPL v3. See licenses/GPL-3.txt
+
+#include "OptimizeVisitor.h"
+#include "Group.h"
+#include "LOD.h"
+#include "MatrixTransform.h"
+#include "StaticGeometry.h"
+#include "graphics/StaticMesh.h"
+#include "graphics/Surface.h"
+
+namespace SceneGraph {
+
+//the only geometry that can be changed in place: one mesh with one
+//indexed surface, not attached anywhere else
+static Graphics::Surface *get_single_surface(StaticGeometry *geom)
+{
+	if (geom->GetNumMeshes() != 1) return 0;
+	Graphics::StaticMesh *mesh = geom->GetMesh(0).Get();
+	if (mesh->cached || mesh->GetRefCount() > 1) return 0;
+	if (mesh->SurfacesEnd() - mesh->SurfacesBegin() != 1) return 0;
+	Graphics::Surface *surf = mesh->GetSurface(0).Get();
+	if (!surf->IsIndexed() || !surf->GetVertices()) return 0;
+	return surf;
+}
+
+static bool has_uniform_scale(const matrix4x4f &m)
+{
+	const float x = m.Right().Length();
+	const float y = m.Up().Length();
+	const float z = m.Back().Length();
+	return fabs(x - y) < 1e-4f * x && fabs(x - z) < 1e-4f * x;
+}
+
+OptimizeVisitor::OptimizeVisitor(const std::set<const Node*> &animated)
+: m_animated(animated)
+, m_numRemoved(0)
+{
+}
+
+void OptimizeVisitor::ApplyGroup(Group &g)
+{
+	Optimize(g);
+}
+
+void OptimizeVisitor::ApplyMatrixTransform(MatrixTransform &m)
+{
+	Optimize(m);
+}
+
+void OptimizeVisitor::ApplyLOD(LOD &l)
+{
+	//the levels are matched to pixel sizes by position, leave them be
+	l.Traverse(*this);
+}
+
+void OptimizeVisitor::Optimize(Group &g)
+{
+	if (!m_done.insert(&g).second) return;
+
+	//bottom up, so chains of transforms collapse one level at a time
+	g.Traverse(*this);
+
+	std::vector<RefCountedPtr<Node> > children;
+	std::vector<bool> unique; //geometry attached only here
+	bool changed = false;
+	for (unsigned int i = 0; i < g.GetNumChildren(); i++) {
+		Node *child = g.GetChildAt(i);
+
+		MatrixTransform *mt = dynamic_cast<MatrixTransform*>(child);
+		if (mt && CanFlatten(mt)) {
+			for (unsigned int j = 0; j < mt->GetNumChildren(); j++) {
+				StaticGeometry *geom = static_cast<StaticGeometry*>(mt->GetChildAt(j));
+				PreTransform(geom, mt->GetTransform());
+				children.push_back(RefCountedPtr<Node>(geom));
+				unique.push_back(true);
+			}
+			m_numRemoved++;
+			changed = true;
+			continue;
+		}
+
+		Group *group = dynamic_cast<Group*>(child);
+		if (group && !mt && !dynamic_cast<LOD*>(child) && group->GetNumChildren() == 0) {
+			m_numRemoved++;
+			changed = true;
+			continue;
+		}
+
+		children.push_back(RefCountedPtr<Node>(child));
+		unique.push_back(child->GetRefCount() == 2);
+	}
+
+	//merge geometry of the same material. nodes drawn in order, so only
+	//with solids it would be safe to move things around much, but
+	//geometry sharing a material has the same blending anyway
+	for (unsigned int i = 0; i < children.size(); i++) {
+		StaticGeometry *a = dynamic_cast<StaticGeometry*>(children[i].Get());
+		if (!a || !unique[i]) continue;
+		for (unsigned int j = i + 1; j < children.size(); ) {
+			StaticGeometry *b = dynamic_cast<StaticGeometry*>(children[j].Get());
+			if (b && unique[j] && CanMerge(a, b)) {
+				Merge(a, b);
+				children.erase(children.begin() + j);
+				unique.erase(unique.begin() + j);
+				m_numRemoved++;
+				changed = true;
+			} else
+				++j;
+		}
+	}
+
+	if (!changed) return;
+	while (g.GetNumChildren() > 0)
+		g.RemoveChildAt(g.GetNumChildren() - 1);
+	for (std::vector<RefCountedPtr<Node> >::const_iterator it = children.begin(); it != children.end(); ++it)
+		g.AddChild(it->Get());
+}
+
+bool OptimizeVisitor::CanFlatten(MatrixTransform *mt) const
+{
+	if (m_animated.count(mt)) return false;
+	//only attached here, or the others would lose it
+	if (mt->GetRefCount() > 1) return false;
+	//leaf transforms are attachment points
+	if (mt->GetNumChildren() == 0) return false;
+	//normals are only rotated
+	if (!has_uniform_scale(mt->GetTransform())) return false;
+
+	for (unsigned int i = 0; i < mt->GetNumChildren(); i++) {
+		StaticGeometry *geom = dynamic_cast<StaticGeometry*>(mt->GetChildAt(i));
+		if (!geom || geom->GetRefCount() > 1 || !get_single_surface(geom))
+			return false;
+	}
+	return true;
+}
+
+void OptimizeVisitor::PreTransform(StaticGeometry *geom, const matrix4x4f &trans)
+{
+	const float scale = Node::GetMaxScale(trans);
+	Graphics::VertexArray *va = get_single_surface(geom)->GetVertices();
+	geom->m_boundingBox = Aabb();
+	if (!va->position.empty())
+		TransformPoints(trans, &va->position[0], &va->position[0], va->position.size());
+	for (unsigned int i = 0; i < va->position.size(); i++)
+		geom->m_boundingBox.Update(va->position[i].x, va->position[i].y, va->position[i].z);
+	for (unsigned int i = 0; i < va->normal.size(); i++)
+		va->normal[i] = trans.ApplyRotationOnly(va->normal[i]) / scale;
+}
+
+bool OptimizeVisitor::CanMerge(StaticGeometry *a, StaticGeometry *b) const
+{
+	if (a->GetNodeMask() != b->GetNodeMask() || a->m_blendMode != b->m_blendMode)
+		return false;
+	Graphics::Surface *sa = get_single_surface(a);
+	Graphics::Surface *sb = get_single_surface(b);
+	if (!sa || !sb) return false;
+	if (sa->GetMaterial() != sb->GetMaterial() || sa->GetPrimtiveType() != sb->GetPrimtiveType())
+		return false;
+	if (sa->GetVertices()->GetAttributeSet() != sb->GetVertices()->GetAttributeSet())
+		return false;
+	//indices are 16 bit
+	return sa->GetNumVerts() + sb->GetNumVerts() <= Graphics::StaticMesh::MAX_VERTICES;
+}
+
+void OptimizeVisitor::Merge(StaticGeometry *into, StaticGeometry *from)
+{
+	Graphics::Surface *dst = get_single_surface(into);
+	Graphics::Surface *src = get_single_surface(from);
+	Graphics::VertexArray *dva = dst->GetVertices();
+	const Graphics::VertexArray *sva = src->GetVertices();
+
+	const unsigned short offset = dst->GetNumVerts();
+	dva->position.insert(dva->position.end(), sva->position.begin(), sva->position.end());
+	dva->normal.insert(dva->normal.end(), sva->normal.begin(), sva->normal.end());
+	dva->diffuse.insert(dva->diffuse.end(), sva->diffuse.begin(), sva->diffuse.end());
+	dva->uv0.insert(dva->uv0.end(), sva->uv0.begin(), sva->uv0.end());
+
+	std::vector<unsigned short> &dstIdx = dst->GetIndices();
+	const std::vector<unsigned short> &srcIdx = src->GetIndices();
+	dstIdx.reserve(dstIdx.size() + srcIdx.size());
+	for (std::vector<unsigned short>::const_iterator it = srcIdx.begin(); it != srcIdx.end(); ++it)
+		dstIdx.push_back(*it + offset);
+
+	const Aabb &bb = from->m_boundingBox;
+	if (bb.min.x <= bb.max.x) {
+		into->m_boundingBox.Update(bb.min);
+		into->m_boundingBox.Update(bb.max);
+	}
+}
+
+}
@@ -0,0 +1,55 @@
+// Copyright © 2008-2013 Pioneer Developers. See AUTHORS.txt for details
+// Licensed under the terms of the GPL v3. See licenses/GPL-3.txt
+
+#ifndef _OPTIMIZEVISITOR_H
+#define _OPTIMIZEVISITOR_H
+/*
+ * Removes unnecessary nodes from a freshly loaded model (run it before
+ * anything is drawn, the meshes are changed in place):
+ *  - matrix transforms that only hold geometry are removed and the
+ *    geometry is pre-transformed into the parent space instead. Repeated
+ *    up the graph this collapses whole chains of transforms
+ *  - sibling geometry with the same material is merged into one mesh
+ *  - empty groups are removed
+ * Transforms that are animated, have other kinds of children (labels,
+ * thrusters) or none at all (attachment points) are left alone, as is
+ * geometry that is attached in more than one place.
+ */
+#include "NodeVisitor.h"
+#include "libs.h"
+#include <set>
+
+namespace SceneGraph {
+
+class Group;
+class LOD;
+class MatrixTransform;
+class StaticGeometry;
+
+class OptimizeVisitor : public NodeVisitor
+{
+public:
+	//animated are the transforms animation channels target
+	OptimizeVisitor(const std::set<const Node*> &animated);
+	virtual void ApplyGroup(Group &);
+	virtual void ApplyMatrixTransform(MatrixTransform &);
+	virtual void ApplyLOD(LOD &);
+
+	unsigned int GetNumRemoved() const { return m_numRemoved; }
+
+private:
+	void Optimize(Group &);
+	bool CanFlatten(MatrixTransform *) const;
+	void PreTransform(StaticGeometry *, const matrix4x4f &);
+	bool CanMerge(StaticGeometry *a, StaticGeometry *b) const;
+	void Merge(StaticGeometry *into, StaticGeometry *from);
+
+	const std::set<const Node*> &m_animated;
+	//groups can be reached through several parents (lods sharing a mesh)
+	std::set<Group*> m_done;
+	unsigned int m_numRemoved;
+};
+
+}
+
+#endif
@@ -40,6 +40,8 @@ void StaticGeometry::Accept(NodeVisitor &nv)
 
 void StaticGeometry::Render(const matrix4x4f &trans, const RenderData *rd)
 {
+	if (IsTooSmall(trans, rd)) return;
+
 	Graphics::Renderer *r = GetRenderer();
 	r->SetTransform(trans);
 	if (m_blendMode != Graphics::BLEND_SOLID)
@@ -29,6 +29,8 @@ Thruster::Thruster(Graphics::Renderer *r, bool _linear, const vector3f &_pos, co
 	m_tMat.Reset(r->CreateMaterial(desc));
 	m_tMat->texture0 = Graphics::TextureBuilder::Billboard(thrusterTextureFilename).GetOrCreateTexture(r, "model");
 	m_tMat->diffuse = baseColor;
+
+	SetBounds(vector3f(0.f, 0.f, 0.5f), 0.71f); //see CreateGeometry
 }
 
 Thruster::Thruster(const Thruster &thruster, NodeCopyCache *cache)
@@ -75,20 +77,17 @@ void Thruster::Render(const matrix4x4f &trans, const RenderData *rd)
 		}
 	}
 	if (power < 0.001f) return;
+	if (IsTooSmall(trans, rd)) return;
 
 	Graphics::Renderer *r = GetRenderer();
-	r->SetBlendMode(Graphics::BLEND_ADDITIVE);
-	r->SetDepthWrite(false);
 	r->SetTransform(trans);
 
-	m_tMat->diffuse = baseColor * power;
 	//directional fade
 	/*vector3f cdir(0.f, 0.f, -1.f);
 	vector3f vdir(-trans[2], -trans[6], -trans[10]);
-	m_tMat->diffuse.a = 1.f - Clamp(vdir.Dot(cdir), 0.f, 1.f);*/
-	r->DrawTriangles(m_tVerts.Get(), m_tMat.Get());
-	r->SetBlendMode(Graphics::BLEND_SOLID);
-	r->SetDepthWrite(true);
+	color.a = 1.f - Clamp(vdir.Dot(cdir), 0.f, 1.f);*/
+	//batched with the other glows, the power goes in the vertex colour
+	r->DrawGlow(m_tVerts.Get(), m_tMat->texture0, baseColor * power);
 }
 
 Graphics::VertexArray *Thruster::CreateGeometry()
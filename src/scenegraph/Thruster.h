@@ -25,6 +25,9 @@ public:
 	virtual void Accept(NodeVisitor &v);
 	virtual const char *GetTypeName() const { return "Thruster"; }
 	virtual void Render(const matrix4x4f &trans, const RenderData *rd);
+	bool IsLinearOnly() const { return linearOnly; }
+	const vector3f &GetPosition() const { return pos; }
+	const vector3f &GetDirection() const { return dir; }
 
 private:
 	static Graphics::VertexArray* CreateGeometry();
@@ -41,6 +41,9 @@ public:
 	inline const fracdef_t &GetFracDef(const unsigned int index) const { assert(index>=0 && index<MAX_FRACDEFS); return m_fracdef[index]; }
 
 	virtual double GetHeight(const vector3d &p) const = 0;
+	// heights for a whole run of points at once, so callers generating lots
+	// of vertices pay for one virtual call rather than one per point
+	virtual void GetHeights(const vector3d *vertexs, double *heightsOut, const int count) const = 0;
 	virtual vector3d GetColor(const vector3d &p, double height, const vector3d &norm) const = 0;
 
 	virtual const char *GetHeightFractalName() const = 0;
@@ -120,6 +123,7 @@ template <typename HeightFractal>
 class TerrainHeightFractal : virtual public Terrain {
 public:
 	virtual double GetHeight(const vector3d &p) const;
+	virtual void GetHeights(const vector3d *vertexs, double *heightsOut, const int count) const;
 	virtual const char *GetHeightFractalName() const;
 protected:
 	TerrainHeightFractal(const SystemBody *body);
@@ -127,6 +131,15 @@ private:
 	TerrainHeightFractal() {}
 };
 
+// the call to GetHeight is qualified so it's bound statically, keeping the
+// virtual dispatch out of the loop
+template <typename HeightFractal>
+void TerrainHeightFractal<HeightFractal>::GetHeights(const vector3d *vertexs, double *heightsOut, const int count) const
+{
+	for (int i=0; i<count; i++)
+		heightsOut[i] = TerrainHeightFractal<HeightFractal>::GetHeight(vertexs[i]);
+}
+
 template <typename ColorFractal>
 class TerrainColorFractal : virtual public Terrain {
 public:
@@ -9,40 +9,68 @@
 
 namespace TerrainNoise {
 
-	// octavenoise functions return range [0,1] if roughness = 0.5
-	inline double octavenoise(const fracdef_t &def, const double roughness, const vector3d &p) {
+	// the sum over the octaves of amplitude * noise(jizm*p), or its absolute
+	// value, with amplitude starting at roughness and jizm at frequency and
+	// scaled by roughness and lacunarity each octave. the octaves are worked
+	// out four at a time where there are enough of them left, and the
+	// samples summed in a fixed size block, so there's no branching per
+	// octave and the compiler can unroll the sums
+	template <bool Abs>
+	inline double octave_sum(const vector3d &p, double jizm, const double lacunarity, int octaves, const double roughness) {
 		double n = 0;
 		double octaveAmplitude = roughness;
-		double jizm = def.frequency;
-		for (int i=0; i<def.octaves; i++) {
-			n += octaveAmplitude * noise(jizm*p);
+		double values[4];
+		while (octaves >= 4) {
+			double x[4], y[4], z[4];
+			for (int i=0; i<4; i++) {
+				x[i] = jizm*p.x;
+				y[i] = jizm*p.y;
+				z[i] = jizm*p.z;
+				jizm *= lacunarity;
+			}
+			noise4(x, y, z, values);
+			for (int i=0; i<4; i++) {
+				n += octaveAmplitude * (Abs ? fabs(values[i]) : values[i]);
+				octaveAmplitude *= roughness;
+			}
+			octaves -= 4;
+		}
+		if (octaves == 3) {
+			// the fourth lane is thrown away, it's still cheaper than three
+			double x[4], y[4], z[4];
+			for (int i=0; i<4; i++) {
+				x[i] = jizm*p.x;
+				y[i] = jizm*p.y;
+				z[i] = jizm*p.z;
+				jizm *= lacunarity;
+			}
+			noise4(x, y, z, values);
+		} else {
+			for (int i=0; i<octaves; i++) {
+				values[i] = noise(jizm*p);
+				jizm *= lacunarity;
+			}
+		}
+		for (int i=0; i<octaves; i++) {
+			n += octaveAmplitude * (Abs ? fabs(values[i]) : values[i]);
 			octaveAmplitude *= roughness;
-			jizm *= def.lacunarity;
 		}
+		return n;
+	}
+
+	// octavenoise functions return range [0,1] if roughness = 0.5
+	inline double octavenoise(const fracdef_t &def, const double roughness, const vector3d &p) {
+		const double n = octave_sum<false>(p, def.frequency, def.lacunarity, def.octaves, roughness);
 		return (n+1.0)*0.5;
 	}
 
 	inline double river_octavenoise(const fracdef_t &def, const double roughness, const vector3d &p) {
-		double n = 0;
-		double octaveAmplitude = roughness;
-		double jizm = def.frequency;
-		for (int i=0; i<def.octaves; i++) {
-			n += octaveAmplitude * fabs(noise(jizm*p));
-			octaveAmplitude *= roughness;
-			jizm *= def.lacunarity;
-		}
+		const double n = octave_sum<true>(p, def.frequency, def.lacunarity, def.octaves, roughness);
 		return fabs(n);
 	}
 
 	inline double ridged_octavenoise(const fracdef_t &def, const double roughness, const vector3d &p) {
-		double n = 0;
-		double octaveAmplitude = roughness;
-		double jizm = def.frequency;
-		for (int i=0; i<def.octaves; i++) {
-			n += octaveAmplitude * noise(jizm*p);
-			octaveAmplitude *= roughness;
-			jizm *= def.lacunarity;
-		}
+		double n = octave_sum<false>(p, def.frequency, def.lacunarity, def.octaves, roughness);
 		n = 1.0 - fabs(n);
 		n *= n;
 		return n;
@@ -50,101 +78,44 @@ namespace TerrainNoise {
 	}
 
 	inline double billow_octavenoise(const fracdef_t &def, const double roughness, const vector3d &p) {
-		double n = 0;
-		double octaveAmplitude = roughness;
-		double jizm = def.frequency;
-		for (int i=0; i<def.octaves; i++) {
-			n += octaveAmplitude * noise(jizm*p);
-			octaveAmplitude *= roughness;
-			jizm *= def.lacunarity;
-		}
+		const double n = octave_sum<false>(p, def.frequency, def.lacunarity, def.octaves, roughness);
 		return (2.0 * fabs(n) - 1.0)+1.0;
 	}
 
 	inline double voronoiscam_octavenoise(const fracdef_t &def, const double roughness, const vector3d &p) {
-		double n = 0;
-		double octaveAmplitude = roughness;
-		double jizm = def.frequency;
-		for (int i=0; i<def.octaves; i++) {
-			n += octaveAmplitude * noise(jizm*p);
-			octaveAmplitude *= roughness;
-			jizm *= def.lacunarity;
-		}
+		const double n = octave_sum<false>(p, def.frequency, def.lacunarity, def.octaves, roughness);
 		return sqrt(10.0 * fabs(n));
 	}
 
 	inline double dunes_octavenoise(const fracdef_t &def, const double roughness, const vector3d &p) {
-		double n = 0;
-		double octaveAmplitude = roughness;
-		double jizm = def.frequency;
-		for (int i=0; i<3; i++) {
-			n += octaveAmplitude * noise(jizm*p);
-			octaveAmplitude *= roughness;
-			jizm *= def.lacunarity;
-		}
+		const double n = octave_sum<false>(p, def.frequency, def.lacunarity, 3, roughness);
 		return 1.0 - fabs(n);
 	}
 
 	// XXX merge these with their fracdef versions
 	inline double octavenoise(int octaves, const double roughness, const double lacunarity, const vector3d &p) {
-		double n = 0;
-		double octaveAmplitude = roughness;
-		double jizm = 1.0;
-		while (octaves--) {
-			n += octaveAmplitude * noise(jizm*p);
-			octaveAmplitude *= roughness;
-			jizm *= lacunarity;
-		}
+		const double n = octave_sum<false>(p, 1.0, lacunarity, octaves, roughness);
 		return (n+1.0)*0.5;
 	}
 
 	inline double river_octavenoise(int octaves, const double roughness, const double lacunarity, const vector3d &p) {
-		double n = 0;
-		double octaveAmplitude = roughness;
-		double jizm = 1.0;
-		while (octaves--) {
-			n += octaveAmplitude * fabs(noise(jizm*p));
-			octaveAmplitude *= roughness;
-			jizm *= lacunarity;
-		}
-		return n;
+		return octave_sum<true>(p, 1.0, lacunarity, octaves, roughness);
 	}
 
 	inline double ridged_octavenoise(int octaves, const double roughness, const double lacunarity, const vector3d &p) {
-		double n = 0;
-		double octaveAmplitude = roughness;
-		double jizm = 1.0;
-		while (octaves--) {
-			n += octaveAmplitude * noise(jizm*p);
-			octaveAmplitude *= roughness;
-			jizm *= lacunarity;
-		}
+		double n = octave_sum<false>(p, 1.0, lacunarity, octaves, roughness);
 		n = 1.0 - fabs(n);
 		n *= n;
 		return n;
 	}
 
 	inline double billow_octavenoise(int octaves, const double roughness, const double lacunarity, const vector3d &p) {
-		double n = 0;
-		double octaveAmplitude = roughness;
-		double jizm = 1.0;
-		while (octaves--) {
-			n += octaveAmplitude * noise(jizm*p);
-			octaveAmplitude *= roughness;
-			jizm *= lacunarity;
-		}
+		const double n = octave_sum<false>(p, 1.0, lacunarity, octaves, roughness);
 		return (2.0 * fabs(n) - 1.0)+1.0;
 	}
 
 	inline double voronoiscam_octavenoise(int octaves, const double roughness, const double lacunarity, const vector3d &p) {
-		double n = 0;
-		double octaveAmplitude = roughness;
-		double jizm = 1.0;
-		while (octaves--) {
-			n += octaveAmplitude * noise(jizm*p);
-			octaveAmplitude *= roughness;
-			jizm *= lacunarity;
-		}
+		const double n = octave_sum<false>(p, 1.0, lacunarity, octaves, roughness);
 		return sqrt(10.0 * fabs(n));
 	}
 
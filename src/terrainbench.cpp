@@ -0,0 +1,385 @@
+// Copyright © 2008-2013 Pioneer Developers. See AUTHORS.txt for details
+// Licensed under the terms of the GPL v3. See licenses/GPL-3.txt
+
+// times terrain generation outside the game. a body is found for every
+// height and colour fractal pair Terrain::InstanceTerrain can pick, and
+// patches are split at a few depths the way QuadPatchJob does it, first on
+// this thread and then across a JobQueue. the heights and colours are
+// hashed and checked against a reference file, so changes to the noise code
+// can be shown to make the same terrain. the reference is only good for the
+// machine and build it was written with
+//
+// terrainbench [-threads n] [-write] [reference file]
+
+#include "libs.h"
+#include "Pi.h"
+#include "OS.h"
+#include "JobQueue.h"
+#include "GeoPatchJobs.h"
+#include "terrain/Terrain.h"
+#include <map>
+
+extern "C" {
+#include "jenkins/lookup3.h"
+}
+
+// the largest patches the game makes (DetailPlanets 4)
+static const int EDGE_LEN = 55;
+static const int DEPTHS[] = { 0, 3, 6, 9, 12 };
+static const int NUM_FACES = 6;
+
+static const char DEFAULT_REFERENCE[] = "terrainbench.ref";
+
+// splits one patch into four, as QuadPatchJob does, but keeps the meshes to
+// itself and hashes them instead of handing them to a GeoSphere
+class BenchPatchJob : public BasePatchJob {
+public:
+	BenchPatchJob(const Terrain *terrain, const vector3d (&corners)[4], Uint32 *result) :
+		m_terrain(terrain), m_result(result)
+	{
+		const int numVerts = EDGE_LEN*EDGE_LEN;
+		const int numBorderedVerts = (EDGE_LEN+2)*(EDGE_LEN+2);
+		for (int i=0; i<4; i++) {
+			m_heights[i].resize(numVerts);
+			m_normals[i].resize(numVerts);
+			m_colors[i].resize(numVerts);
+			m_borderHeights[i].resize(numBorderedVerts);
+			m_borderVertexs[i].resize(numBorderedVerts);
+		}
+
+		const vector3d v01 = (corners[0]+corners[1]).Normalized();
+		const vector3d v12 = (corners[1]+corners[2]).Normalized();
+		const vector3d v23 = (corners[2]+corners[3]).Normalized();
+		const vector3d v30 = (corners[3]+corners[0]).Normalized();
+		const vector3d cn = (corners[0]+corners[1]+corners[2]+corners[3]).Normalized();
+
+		m_vecs[0][0] = corners[0];	m_vecs[0][1] = v01;			m_vecs[0][2] = cn;			m_vecs[0][3] = v30;
+		m_vecs[1][0] = v01;			m_vecs[1][1] = corners[1];	m_vecs[1][2] = v12;			m_vecs[1][3] = cn;
+		m_vecs[2][0] = cn;			m_vecs[2][1] = v12;			m_vecs[2][2] = corners[2];	m_vecs[2][3] = v23;
+		m_vecs[3][0] = v30;			m_vecs[3][1] = cn;			m_vecs[3][2] = v23;			m_vecs[3][3] = corners[3];
+
+		m_hash[0] = m_hash[1] = 0;
+	}
+
+	virtual const char *GetName() const { return "BenchPatchJob"; }
+
+	virtual void OnRun() {
+		const double fracStep = 1.0 / double(EDGE_LEN-1);
+		for (int i=0; i<4; i++) {
+			GenerateMesh(&m_heights[i][0], &m_normals[i][0], &m_colors[i][0], &m_borderHeights[i][0], &m_borderVertexs[i][0],
+				m_vecs[i][0], m_vecs[i][1], m_vecs[i][2], m_vecs[i][3], EDGE_LEN, fracStep, m_terrain);
+
+			lookup3_hashlittle2(&m_heights[i][0], m_heights[i].size()*sizeof(double), &m_hash[0], &m_hash[1]);
+			lookup3_hashlittle2(&m_colors[i][0], m_colors[i].size()*sizeof(Color3ub), &m_hash[0], &m_hash[1]);
+		}
+	}
+
+	virtual void OnFinish() {
+		m_result[0] = m_hash[0];
+		m_result[1] = m_hash[1];
+	}
+
+	static int GetNumVertices() { return 4*EDGE_LEN*EDGE_LEN; }
+
+private:
+	const Terrain *m_terrain;
+	Uint32 *m_result;
+	Uint32 m_hash[2];
+	vector3d m_vecs[4][4];
+
+	std::vector<double> m_heights[4];
+	std::vector<vector3f> m_normals[4];
+	std::vector<Color3ub> m_colors[4];
+	std::vector<double> m_borderHeights[4];
+	std::vector<vector3d> m_borderVertexs[4];
+};
+
+struct Preset {
+	RefCountedPtr<SystemBody> body;
+	ScopedPtr<Terrain> terrain;
+};
+
+// keyed on "height colour", so they're always run in the same order
+typedef std::map<std::string, Preset*> PresetMap;
+
+// life, gas, liquid, ices, volcanicity (all in hundredths) and temperature,
+// picked to reach each branch of InstanceTerrain's terrestrial planets
+static const int COMPOSITIONS[][6] = {
+	{ 80, 30, 50, 10, 30, 290 }, // earth-like
+	{ 80, 30, 50, 10, 30, 200 },
+	{ 50, 30, 50, 10, 30, 290 }, // harsh, habitable
+	{ 50, 30, 50, 10, 30, 200 },
+	{ 20, 15, 50, 10, 30, 290 }, // marginal
+	{ 20, 15, 50, 10, 30, 200 },
+	{  0, 30,  5,  0, 30, 290 }, // desert
+	{  0,  5, 50, 90, 30, 200 }, // frozen
+	{ 60,  5, 50,  0, 80, 290 }, // volcanic
+	{ 30,  5, 50,  0, 80, 290 },
+	{  0,  5, 50,  0, 80, 290 },
+	{ 30,  5, 50,  0, 30, 290 }, // alien life
+	{  0, 15, 50,  0, 30, 290 }, // rock
+	{  0,  0,  0,  0,  0, 290 }  // barren
+};
+
+static SystemBody *make_body(SystemBody::BodyType type, const int (&comp)[6], Uint32 seed)
+{
+	SystemBody *body = new SystemBody;
+	body->type = type;
+	body->seed = seed;
+	body->name = "terrainbench";
+	if (body->GetSuperType() <= SystemBody::SUPERTYPE_STAR) {
+		body->radius = fixed(1,1);
+		body->mass = fixed(1,1);
+	} else if (type == SystemBody::TYPE_PLANET_ASTEROID) {
+		body->radius = fixed(1,100);
+		body->mass = fixed(1,100000);
+	} else {
+		body->radius = fixed(1,1);
+		body->mass = fixed(1,1);
+	}
+	body->m_life = fixed(comp[0],100);
+	body->m_volatileGas = fixed(comp[1],100);
+	body->m_volatileLiquid = fixed(comp[2],100);
+	body->m_volatileIces = fixed(comp[3],100);
+	body->m_volcanicity = fixed(comp[4],100);
+	body->averageTemp = comp[5];
+	body->m_metallicity = fixed(1,2);
+	body->m_atmosOxidizing = fixed(1,2);
+	return body;
+}
+
+// try bodies of every type over a run of seeds, keeping the first one found
+// for each fractal pair. heightmapped bodies are left out, they need their
+// data files
+static void find_presets(PresetMap &presets)
+{
+	for (int type = SystemBody::TYPE_BROWN_DWARF; type <= SystemBody::TYPE_PLANET_TERRESTRIAL; type++) {
+		const int numComps = (type == SystemBody::TYPE_PLANET_TERRESTRIAL) ? COUNTOF(COMPOSITIONS) : 1;
+		for (int c = 0; c < numComps; c++) {
+			for (Uint32 seed = 0; seed < 64; seed++) {
+				RefCountedPtr<SystemBody> body(make_body(SystemBody::BodyType(type), COMPOSITIONS[c], seed));
+				Terrain *terrain = Terrain::InstanceTerrain(body.Get());
+				const std::string key = std::string(terrain->GetHeightFractalName()) + " " + terrain->GetColorFractalName();
+				if (presets.find(key) != presets.end()) {
+					delete terrain;
+					continue;
+				}
+				Preset *p = new Preset;
+				p->body = body;
+				p->terrain.Reset(terrain);
+				presets[key] = p;
+			}
+		}
+	}
+}
+
+// the corners of the patch reached by splitting a cube face depth times,
+// wandering across the face so that different depths see different ground
+static void patch_corners(int face, int depth, vector3d (&corners)[4])
+{
+	static const vector3d p1 = (vector3d( 1, 1, 1)).Normalized();
+	static const vector3d p2 = (vector3d(-1, 1, 1)).Normalized();
+	static const vector3d p3 = (vector3d(-1,-1, 1)).Normalized();
+	static const vector3d p4 = (vector3d( 1,-1, 1)).Normalized();
+	static const vector3d p5 = (vector3d( 1, 1,-1)).Normalized();
+	static const vector3d p6 = (vector3d(-1, 1,-1)).Normalized();
+	static const vector3d p7 = (vector3d(-1,-1,-1)).Normalized();
+	static const vector3d p8 = (vector3d( 1,-1,-1)).Normalized();
+	const vector3d faces[NUM_FACES][4] = {
+		{ p1, p2, p3, p4 },
+		{ p4, p3, p7, p8 },
+		{ p1, p4, p8, p5 },
+		{ p2, p1, p5, p6 },
+		{ p3, p2, p6, p7 },
+		{ p8, p7, p6, p5 }
+	};
+
+	for (int i=0; i<4; i++)
+		corners[i] = faces[face][i];
+
+	for (int d=0; d<depth; d++) {
+		// keep the corner the kid shares with its parent, and pull the
+		// others in to the edge midpoints and the centre
+		const int kid = (d + face) % 4;
+		const vector3d cn = (corners[0]+corners[1]+corners[2]+corners[3]).Normalized();
+		const vector3d prev = (corners[kid]+corners[(kid+3)%4]).Normalized();
+		const vector3d next = (corners[kid]+corners[(kid+1)%4]).Normalized();
+		corners[(kid+1)%4] = next;
+		corners[(kid+2)%4] = cn;
+		corners[(kid+3)%4] = prev;
+	}
+}
+
+static void queue_jobs(const Terrain *terrain, std::vector<Uint32> &results, std::vector<BenchPatchJob*> &jobs)
+{
+	results.resize(COUNTOF(DEPTHS)*NUM_FACES*2);
+	for (unsigned int d = 0; d < COUNTOF(DEPTHS); d++) {
+		for (int face = 0; face < NUM_FACES; face++) {
+			vector3d corners[4];
+			patch_corners(face, DEPTHS[d], corners);
+			jobs.push_back(new BenchPatchJob(terrain, corners, &results[(d*NUM_FACES + face)*2]));
+		}
+	}
+}
+
+static double seconds_since(Uint64 start)
+{
+	return double(OS::HFTimer() - start) / double(OS::HFTimerFreq());
+}
+
+// returns the time taken
+static double run_single(const Terrain *terrain, std::vector<Uint32> &results)
+{
+	std::vector<BenchPatchJob*> jobs;
+	queue_jobs(terrain, results, jobs);
+
+	const Uint64 start = OS::HFTimer();
+	for (std::vector<BenchPatchJob*>::iterator it = jobs.begin(); it != jobs.end(); ++it) {
+		(*it)->OnRun();
+		(*it)->OnFinish();
+	}
+	const double elapsed = seconds_since(start);
+
+	for (std::vector<BenchPatchJob*>::iterator it = jobs.begin(); it != jobs.end(); ++it)
+		delete *it;
+	return elapsed;
+}
+
+static double run_threaded(JobQueue *queue, const Terrain *terrain, std::vector<Uint32> &results)
+{
+	std::vector<BenchPatchJob*> jobs;
+	queue_jobs(terrain, results, jobs);
+
+	const Uint64 start = OS::HFTimer();
+	for (std::vector<BenchPatchJob*>::iterator it = jobs.begin(); it != jobs.end(); ++it)
+		queue->Queue(*it);
+
+	// the queue deletes the jobs as they're finished
+	Uint32 finished = 0;
+	while (finished < jobs.size()) {
+		finished += queue->FinishJobs();
+		if (finished < jobs.size())
+			SDL_Delay(0);
+	}
+	return seconds_since(start);
+}
+
+static void read_reference(const std::string &filename, std::map<std::string, std::string> &reference)
+{
+	FILE *f = fopen(filename.c_str(), "r");
+	if (!f) return;
+
+	char height[256], color[256], hash[256];
+	while (fscanf(f, "%255s %255s %255s", height, color, hash) == 3)
+		reference[std::string(height) + " " + color] = hash;
+	fclose(f);
+}
+
+int main(int argc, char **argv)
+{
+	int numThreads = OS::GetNumCores();
+	bool write = false;
+	std::string filename(DEFAULT_REFERENCE);
+
+	for (int i = 1; i < argc; i++) {
+		const std::string arg(argv[i]);
+		if (arg == "-threads" && i+1 < argc)
+			numThreads = std::max(1, atoi(argv[++i]));
+		else if (arg == "-write")
+			write = true;
+		else if (arg[0] != '-')
+			filename = arg;
+		else {
+			fprintf(stderr, "usage: terrainbench [-threads n] [-write] [reference file]\n");
+			return 1;
+		}
+	}
+
+	// the terrain the game makes with textures on at the middle fractal detail
+	Pi::detail.textures = 1;
+	Pi::detail.fracmult = 2;
+
+	PresetMap presets;
+	find_presets(presets);
+
+	std::map<std::string, std::string> reference;
+	if (!write)
+		read_reference(filename, reference);
+
+	FILE *out = 0;
+	if (write) {
+		out = fopen(filename.c_str(), "w");
+		if (!out) {
+			fprintf(stderr, "couldn't open '%s' for writing\n", filename.c_str());
+			return 1;
+		}
+	}
+
+	ScopedPtr<JobQueue> queue(new JobQueue(numThreads));
+
+	const double vertsPerRun = double(COUNTOF(DEPTHS)*NUM_FACES*BenchPatchJob::GetNumVertices());
+	double totalSingle = 0.0, totalThreaded = 0.0;
+	int mismatches = 0, missing = 0;
+
+	printf("%d presets, %d patch splits of %dx%d each, %d threads\n\n",
+		int(presets.size()), int(COUNTOF(DEPTHS)*NUM_FACES), EDGE_LEN, EDGE_LEN, numThreads);
+	printf("%-36s %-28s %10s %10s  %s\n", "height", "colour", "Mvert/s", "Mvert/s MT", "hash");
+
+	for (PresetMap::iterator it = presets.begin(); it != presets.end(); ++it) {
+		const Terrain *terrain = it->second->terrain.Get();
+
+		std::vector<Uint32> singleResults, threadedResults;
+		const double single = run_single(terrain, singleResults);
+		const double threaded = run_threaded(queue.Get(), terrain, threadedResults);
+		totalSingle += single;
+		totalThreaded += threaded;
+
+		Uint32 a = 0, b = 0;
+		lookup3_hashlittle2(&singleResults[0], singleResults.size()*sizeof(Uint32), &a, &b);
+		char hash[32];
+		snprintf(hash, sizeof(hash), "%08x%08x", a, b);
+
+		const char *status = "";
+		if (singleResults != threadedResults) {
+			status = "MISMATCH (threaded)";
+			mismatches++;
+		} else if (!write) {
+			std::map<std::string, std::string>::const_iterator ref = reference.find(it->first);
+			if (ref == reference.end()) {
+				status = "no reference";
+				missing++;
+			} else if (ref->second != hash) {
+				status = "MISMATCH";
+				mismatches++;
+			}
+		}
+
+		printf("%-36s %-28s %10.2f %10.2f  %s %s\n",
+			terrain->GetHeightFractalName(), terrain->GetColorFractalName(),
+			vertsPerRun / single * 1e-6, vertsPerRun / threaded * 1e-6, hash, status);
+
+		if (out)
+			fprintf(out, "%s %s\n", it->first.c_str(), hash);
+	}
+
+	const double totalVerts = vertsPerRun * double(presets.size());
+	printf("\ntotal: %.2f Mvert/s single threaded, %.2f Mvert/s on %d threads\n",
+		totalVerts / totalSingle * 1e-6, totalVerts / totalThreaded * 1e-6, numThreads);
+	printf("%s\n", queue->GetStatsReport().c_str());
+
+	if (out) {
+		fclose(out);
+		printf("wrote reference to '%s'\n", filename.c_str());
+	} else if (missing)
+		printf("%d presets not in '%s', run with -write to make it\n", missing, filename.c_str());
+
+	queue.Reset();
+	for (PresetMap::iterator it = presets.begin(); it != presets.end(); ++it)
+		delete it->second;
+
+	if (mismatches) {
+		printf("%d presets didn't match\n", mismatches);
+		return 1;
+	}
+	return 0;
+}
@@ -0,0 +1,53 @@
+// Copyright © 2008-2013 Pioneer Developers. See AUTHORS.txt for details
+// Licensed under the terms of the GPL v3. See licenses/GPL-3.txt
+
+#include <iostream>
+#include <string.h>
+#include "perlin.h"
+#include "Random.h"
+
+using namespace std;
+
+// Test suite for the perlin noise kernels
+void test_perlin() {
+
+	// noise4 must give exactly the same bits as noise, otherwise the same
+	// seeds would give different planets depending on the build
+
+	cout << "--------------------" << endl;
+	cout << "Running perlin tests" << endl;
+	cout << "--------------------" << endl;
+
+	Random rnd(0xbadf00d);
+
+	// across the range the terrain octaves cover, including negative
+	// coordinates and points on cell boundaries
+	const double scales[] = {1.0, 100.0, 1e5, 1e8};
+	const int numScales = sizeof(scales) / sizeof(scales[0]);
+
+	for (int s=0; s<numScales; s++) {
+		int mismatches = 0;
+		for (int i=0; i<10000; i++) {
+			vector3d p[4];
+			for (int j=0; j<4; j++) {
+				if (i < 16)
+					p[j] = vector3d(double(i-8), double(j-2), double(i+j-10));
+				else
+					p[j] = vector3d(rnd.Double(-1.0, 1.0), rnd.Double(-1.0, 1.0), rnd.Double(-1.0, 1.0)) * scales[s];
+			}
+
+			double out[4];
+			noise4(p, out);
+			for (int j=0; j<4; j++) {
+				const double ref = noise(p[j]);
+				if (memcmp(&ref, &out[j], sizeof(double)) != 0)
+					mismatches++;
+			}
+		}
+		cout << "scale " << scales[s] << ": " << (mismatches == 0 ? "pass" : "fail") << endl;
+	}
+
+	cout << "--------------------" << endl;
+	cout << "End of perlin tests." << endl;
+	cout << "--------------------" << endl;
+}
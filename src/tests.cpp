@@ -5,6 +5,7 @@ void test_frames();
 void test_stringf();
 void test_filesystem();
 void test_random();
+void test_perlin();
 
 int main(int argc, char *argv[])
 {
@@ -12,5 +13,6 @@ int main(int argc, char *argv[])
 	test_stringf();
 	test_filesystem();
 	test_random();
+	test_perlin();
 	return 0;
 }
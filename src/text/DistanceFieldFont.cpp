@@ -3,6 +3,7 @@
 
 #include "DistanceFieldFont.h"
 #include "graphics/Texture.h"
+#include "graphics/TextureBuilder.h"
 #include "graphics/VertexArray.h"
 #include "utils.h"
 #include "FileSystem.h"
@@ -66,6 +67,42 @@ void DistanceFieldFont::GetGeometry(Graphics::VertexArray &va, const std::string
 	}
 }
 
+void DistanceFieldFont::AddScreenText(Graphics::VertexArray &va, const std::string &text, const vector2f &pos, float size)
+{
+	assert(va.HasAttrib(Graphics::ATTRIB_NORMAL) && va.HasAttrib(Graphics::ATTRIB_UV0));
+
+	const unsigned int first = va.GetNumVerts();
+
+	vector2f cursor(0.f);
+	vector2f bounds(0.f);
+	for(unsigned int i=0; i<text.length(); i++) {
+		std::map<Uint32, Glyph>::const_iterator it = m_glyphs.find(Uint32(text.at(i)));
+		if (it != m_glyphs.end()) {
+			const Glyph &glyph = it->second;
+			AddGlyph(va, cursor + glyph.offset, glyph, bounds);
+			cursor.x += glyph.xAdvance;
+		}
+	}
+
+	//glyphs are made y up from the bottom of the line, one unit high
+	const float top = m_lineHeight / m_fontSize;
+	for (unsigned int i=first; i<va.position.size(); i++) {
+		vector3f &p = va.position[i];
+		p.x = pos.x + p.x * size;
+		p.y = pos.y + (top - p.y) * size;
+	}
+}
+
+RefCountedPtr<DistanceFieldFont> DistanceFieldFont::GetLabelFont(Graphics::Renderer *r)
+{
+	static RefCountedPtr<DistanceFieldFont> font;
+	if (!font) {
+		Graphics::Texture *tex = Graphics::TextureBuilder("fonts/label3d.png", Graphics::LINEAR_CLAMP, true, true, true).GetOrCreateTexture(r, "model");
+		font.Reset(new DistanceFieldFont("fonts/sdf_definition.txt", tex));
+	}
+	return font;
+}
+
 // create a preferred format vertex array
 Graphics::VertexArray *DistanceFieldFont::CreateVertexArray() const
 {
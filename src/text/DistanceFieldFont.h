@@ -26,6 +26,7 @@
 #include "StringRange.h"
 
 namespace Graphics {
+	class Renderer;
 	class Texture;
 	class VertexArray;
 }
@@ -36,9 +37,17 @@ class DistanceFieldFont : public RefCounted {
 public:
 	DistanceFieldFont(const std::string &definitionFileName, Graphics::Texture*);
 	void GetGeometry(Graphics::VertexArray&, const std::string&, const vector2f &offset);
+	// a line of text for the screen (y down), its top left at pos and size
+	// high. added to whatever is in the array already, so lots of text can
+	// be drawn at once, whatever size it is
+	void AddScreenText(Graphics::VertexArray&, const std::string&, const vector2f &pos, float size);
 	Graphics::Texture *GetTexture() const { return m_texture; }
 	Graphics::VertexArray *CreateVertexArray() const;
 
+	// the font for labels, in 3D and on the screen. one texture does for
+	// every size, so it's shared
+	static RefCountedPtr<DistanceFieldFont> GetLabelFont(Graphics::Renderer *r);
+
 private:
 	struct Glyph {
 		vector2f uv;
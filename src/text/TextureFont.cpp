@@ -76,6 +76,66 @@ void TextureFont::AddGlyphGeometry(Graphics::VertexArray *va, const glfglyph_t &
 	s_glyphCount++;
 }
 
+bool TextureFont::TextKey::operator<(const TextKey &b) const
+{
+	if (x != b.x) return x < b.x;
+	if (y != b.y) return y < b.y;
+	if (markup != b.markup) return markup < b.markup;
+	if (color.r != b.color.r) return color.r < b.color.r;
+	if (color.g != b.color.g) return color.g < b.color.g;
+	if (color.b != b.color.b) return color.b < b.color.b;
+	if (color.a != b.color.a) return color.a < b.color.a;
+	return str < b.str;
+}
+
+// the cached copy of the text, or 0 the first time it's drawn
+TextureFont::CachedText *TextureFont::LookupText(const TextKey &key)
+{
+	TextCacheMap::iterator i = m_textCache.find(key);
+	if (i != m_textCache.end()) {
+		m_textLRU.splice(m_textLRU.begin(), m_textLRU, i->second);
+		return &*(i->second);
+	}
+
+	m_textLRU.push_front(CachedText(key));
+	m_textCache.insert(std::make_pair(key, m_textLRU.begin()));
+	if (m_textLRU.size() > MAX_CACHED_TEXT) {
+		m_textCache.erase(m_textLRU.back().key);
+		m_textLRU.pop_back();
+	}
+	return 0;
+}
+
+// keep what's in m_vertices for the next time the text is drawn
+void TextureFont::CacheVertices(CachedText *text)
+{
+	if (!m_vertices.GetNumVerts()) return;
+	text->buffer.Reset(CreateBuffer(m_vertices));
+}
+
+Graphics::VertexBuffer *TextureFont::CreateBuffer(const Graphics::VertexArray &va)
+{
+	Graphics::VertexBufferDesc desc;
+	desc.attribs = Graphics::ATTRIB_POSITION | Graphics::ATTRIB_DIFFUSE | Graphics::ATTRIB_UV0;
+	desc.numVertices = va.GetNumVerts();
+	desc.usage = Graphics::BUFFER_USAGE_STATIC;
+	Graphics::VertexBuffer *buffer = m_renderer->CreateVertexBuffer(desc);
+	if (buffer && !buffer->Populate(va)) {
+		delete buffer;
+		return 0;
+	}
+	return buffer;
+}
+
+void TextureFont::RenderGeometry(const Graphics::VertexArray &va, Graphics::VertexBuffer *buffer)
+{
+	m_renderer->SetBlendMode(Graphics::BLEND_ALPHA_PREMULT);
+	if (buffer)
+		m_renderer->DrawBuffer(buffer, m_mat.Get());
+	else if (va.GetNumVerts())
+		m_renderer->DrawTriangles(&va, m_mat.Get());
+}
+
 void TextureFont::MeasureString(const char *str, float &w, float &h)
 {
 	w = h = 0.0f;
@@ -211,8 +271,43 @@ int TextureFont::PickCharacter(const char *str, float mouseX, float mouseY) cons
 void TextureFont::RenderString(const char *str, float x, float y, const Color &color)
 {
 	m_renderer->SetBlendMode(Graphics::BLEND_ALPHA_PREMULT);
+
+	CachedText *text = LookupText(TextKey(str, x, y, color, false));
+	if (text && text->buffer.Valid()) {
+		m_renderer->DrawBuffer(text->buffer.Get(), m_mat.Get());
+		return;
+	}
+
 	m_vertices.Clear();
+	CreateGeometry(m_vertices, str, x, y, color);
 
+	if (text) CacheVertices(text);
+	m_renderer->DrawTriangles(&m_vertices, m_mat.Get());
+}
+
+Color TextureFont::RenderMarkup(const char *str, float x, float y, const Color &color)
+{
+	m_renderer->SetBlendMode(Graphics::BLEND_ALPHA_PREMULT);
+
+	CachedText *text = LookupText(TextKey(str, x, y, color, true));
+	if (text && text->buffer.Valid()) {
+		m_renderer->DrawBuffer(text->buffer.Get(), m_mat.Get());
+		return text->endColor;
+	}
+
+	m_vertices.Clear();
+	const Color c = CreateMarkupGeometry(m_vertices, str, x, y, color);
+
+	if (text) {
+		CacheVertices(text);
+		text->endColor = c;
+	}
+	m_renderer->DrawTriangles(&m_vertices, m_mat.Get());
+	return c;
+}
+
+void TextureFont::CreateGeometry(Graphics::VertexArray &va, const char *str, float x, float y, const Color &color)
+{
 	const Color premult_color = Color(color.r * color.a, color.g * color.a, color.b * color.a, color.a);
 
 	float px = x;
@@ -233,7 +328,7 @@ void TextureFont::RenderString(const char *str, float x, float y, const Color &c
 			i += n;
 
 			const glfglyph_t &glyph = GetGlyph(chr);
-			AddGlyphGeometry(&m_vertices, glyph, roundf(px), py, premult_color);
+			AddGlyphGeometry(&va, glyph, roundf(px), py, premult_color);
 
 			if (str[i]) {
 				Uint32 chr2;
@@ -248,15 +343,10 @@ void TextureFont::RenderString(const char *str, float x, float y, const Color &c
 			px += glyph.advx;
 		}
 	}
-
-	m_renderer->DrawTriangles(&m_vertices, m_mat.Get());
 }
 
-Color TextureFont::RenderMarkup(const char *str, float x, float y, const Color &color)
+Color TextureFont::CreateMarkupGeometry(Graphics::VertexArray &va, const char *str, float x, float y, const Color &color)
 {
-	m_renderer->SetBlendMode(Graphics::BLEND_ALPHA_PREMULT);
-	m_vertices.Clear();
-
 	float px = x;
 	float py = y;
 
@@ -293,7 +383,7 @@ Color TextureFont::RenderMarkup(const char *str, float x, float y, const Color &
 			i += n;
 
 			const glfglyph_t &glyph = GetGlyph(chr);
-			AddGlyphGeometry(&m_vertices, glyph, roundf(px), py, premult_c);
+			AddGlyphGeometry(&va, glyph, roundf(px), py, premult_c);
 
 			// XXX kerning doesn't skip markup
 			if (str[i]) {
@@ -310,7 +400,6 @@ Color TextureFont::RenderMarkup(const char *str, float x, float y, const Color &
 		}
 	}
 
-	m_renderer->DrawTriangles(&m_vertices, m_mat.Get());
 	return c;
 }
 
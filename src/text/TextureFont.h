@@ -9,7 +9,9 @@
 #include "graphics/Texture.h"
 #include "graphics/Material.h"
 #include "graphics/VertexArray.h"
+#include "graphics/VertexBuffer.h"
 #include <map>
+#include <list>
 
 namespace Graphics {
 	class Material;
@@ -49,8 +51,14 @@ public:
 	static int GetGlyphCount() { return s_glyphCount; }
 	static void ClearGlyphCount() { s_glyphCount = 0; }
 
-	// fill a vertex array with single-colored text
+	// add single-colored text to a vertex array
 	void CreateGeometry(Graphics::VertexArray &, const char *str, float x, float y, const Color &color = Color::WHITE);
+	// add text with colour markup. returns the colour it ends with
+	Color CreateMarkupGeometry(Graphics::VertexArray &, const char *str, float x, float y, const Color &color = Color::WHITE);
+	// a static buffer holding the text in the array, or 0 if one can't be made
+	Graphics::VertexBuffer *CreateBuffer(const Graphics::VertexArray &);
+	// draw text made by the above, from the buffer if there is one
+	void RenderGeometry(const Graphics::VertexArray &, Graphics::VertexBuffer *buffer = 0);
 	RefCountedPtr<Graphics::Texture> GetTexture() { return m_texture; }
 
 private:
@@ -65,6 +73,35 @@ private:
 
 	static int s_glyphCount;
 
+	// text drawn the same way twice gets its geometry kept in a vertex
+	// buffer, so a label that doesn't change isn't laid out again every
+	// frame. the least recently drawn go once there are too many
+	enum { MAX_CACHED_TEXT = 128 };
+
+	struct TextKey {
+		TextKey(const char *s, float x_, float y_, const Color &c, bool m) : str(s), x(x_), y(y_), color(c), markup(m) {}
+		std::string str;
+		float x, y;
+		Color color;
+		bool markup;
+		bool operator<(const TextKey &b) const;
+	};
+
+	struct CachedText {
+		CachedText(const TextKey &k) : key(k) {}
+		TextKey key;
+		RefCountedPtr<Graphics::VertexBuffer> buffer; // empty until it's drawn again
+		Color endColor; // what RenderMarkup returns
+	};
+
+	typedef std::list<CachedText> TextLRU;
+	typedef std::map<TextKey,TextLRU::iterator> TextCacheMap;
+	TextLRU m_textLRU;
+	TextCacheMap m_textCache;
+
+	CachedText *LookupText(const TextKey &key);
+	void CacheVertices(CachedText *text);
+
 	std::vector<glfglyph_t> m_glyphsFast; // for fast lookup of low-index glyphs
 	std::map<Uint32,glfglyph_t> m_glyphs;
 
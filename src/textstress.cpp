@@ -53,9 +53,11 @@ int main(int argc, char **argv)
 	videoSettings.height = HEIGHT;
 	videoSettings.fullscreen = false;
 	videoSettings.shaders = false;
+	videoSettings.shaderBinaryCache = false;
 	videoSettings.requestedSamples = 0;
 	videoSettings.vsync = false;
 	videoSettings.useTextureCompression = false;
+	videoSettings.textureCache = false;
 	Graphics::Renderer *r = Graphics::Init(videoSettings);
 
 	r->SetOrthographicProjection(0, WIDTH, HEIGHT, 0, -1, 1);
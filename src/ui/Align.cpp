@@ -8,7 +8,7 @@ namespace UI {
 Point Align::PreferredSize()
 {
 	if (!GetInnerWidget()) return Point();
-	return GetInnerWidget()->PreferredSize();
+	return GetInnerWidget()->GetPreferredSize();
 }
 
 void Align::Layout()
@@ -13,6 +13,7 @@ namespace UI {
 class ColorBackground : public Single {
 public:
 	virtual void Draw();
+	virtual bool CanBatchDraw() const { return false; }
 
 	void SetColor(const Color &color) { m_material->diffuse = color; }
 
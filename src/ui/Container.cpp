@@ -47,7 +47,7 @@ void Container::AddWidget(Widget *widget)
 	widget->Attach(this);
 	m_widgets.push_back(RefCountedPtr<Widget>(widget));
 
-	GetContext()->RequestLayout();
+	GetContext()->RequestLayout(this);
 }
 
 void Container::RemoveWidget(Widget *widget)
@@ -63,7 +63,7 @@ void Container::RemoveWidget(Widget *widget)
 	widget->Detach();
 	m_widgets.erase(i);
 
-	GetContext()->RequestLayout();
+	GetContext()->RequestLayout(this);
 }
 
 void Container::RemoveAllWidgets()
@@ -74,7 +74,7 @@ void Container::RemoveAllWidgets()
 		i = m_widgets.erase(i);
 	}
 
-	GetContext()->RequestLayout();
+	GetContext()->RequestLayout(this);
 }
 
 void Container::Disable()
@@ -9,14 +9,16 @@
 
 // Container is the base class for all UI containers. Containers must
 // provide a Layout() method that implements its layout strategy. Layout()
-// will typically call PreferredSize() on its children to request their
+// will typically call GetPreferredSize() on its children to request their
 // desired sizings then call SetSize() on its children to set their sizes
 // appropriately. Containers should then call LayoutChildren() to make its
 // children do their layout.
 //
 // Containers don't have provide Update() or Draw(). If they do they should
 // make sure that they call the baseclass methods so that child widgets will
-// also receive these methods.
+// also receive these methods. Containers draw batchable by default, so one
+// that draws anything itself other than skin elements must override
+// CanBatchDraw() and return false.
 
 namespace UI {
 
@@ -34,6 +36,7 @@ public:
 	virtual void Draw();
 
 	virtual bool IsContainer() const { return true; }
+	virtual bool CanBatchDraw() const { return true; }
 
 	Widget *GetWidgetAtAbsolute(const Point &pos) { return GetWidgetAt(pos - GetAbsolutePosition()); }
 	virtual Widget *GetWidgetAt(const Point &pos);
@@ -34,6 +34,7 @@ Context::Context(LuaManager *lua, Graphics::Renderer *renderer, int width, int h
 	m_height(height),
 	m_scale(std::min(float(m_height)/SCALE_CUTOFF_HEIGHT, 1.0f)),
 	m_needsLayout(false),
+	m_layoutSerial(1),
 	m_float(new FloatContainer(this)),
 	m_eventDispatcher(this),
 	m_skin("ui/Skin.ini", renderer, GetScale()),
@@ -82,10 +83,28 @@ Widget *Context::GetWidgetAt(const Point &pos)
 	return w;
 }
 
+void Context::RequestLayout(Widget *widget)
+{
+	widget->m_layoutFlags |= LAYOUT_DIRTY;
+	widget->m_preferredSizeSerial = 0;
+
+	// everything above might get a different size too. the whole way up,
+	// even past ancestors that are already marked, as their sizes may have
+	// been asked for since
+	for (Widget *w = widget->GetContainer(); w; w = w->GetContainer()) {
+		w->m_layoutFlags |= LAYOUT_CHILD_DIRTY;
+		w->m_preferredSizeSerial = 0;
+	}
+}
+
 void Context::Layout()
 {
 	m_needsLayout = false;
 
+	m_layoutSerial++;
+	ClearLayoutFlags(m_float.Get());
+	ClearLayoutFlags(this);
+
 	m_float->Layout();
 	Single::Layout();
 
@@ -94,17 +113,101 @@ void Context::Layout()
 		Single::Layout();
 	}
 
+	// some widgets only know what size they want once they've been laid out
+	// (eg MultiLineText), and ask again
+	LayoutDirty();
+
 	m_needsLayout = false;
 
 	m_eventDispatcher.LayoutUpdated();
 }
 
+void Context::LayoutDirty()
+{
+	// twice, for the widgets that ask again while they're laid out
+	for (int pass = 0; pass < 2; pass++) {
+		if (m_float->m_layoutFlags & LAYOUT_DIRTY) {
+			ClearLayoutFlags(m_float.Get());
+			m_float->Layout();
+		}
+		else if (m_float->m_layoutFlags & LAYOUT_CHILD_DIRTY)
+			LayoutDirtyChildren(m_float.Get());
+
+		// the float container is attached to us but isn't one of our
+		// widgets, so it's done on its own above
+		if (m_layoutFlags & LAYOUT_DIRTY) {
+			ClearLayoutFlags(this);
+			Single::Layout();
+		}
+		else if (m_layoutFlags & LAYOUT_CHILD_DIRTY)
+			LayoutDirtyChildren(this);
+	}
+}
+
+// the container's own allocation hasn't changed. if none of its marked
+// children want a different size, their allocations haven't either and only
+// they need laying out again. otherwise the container has to share its
+// space out again
+void Context::LayoutDirtyChildren(Container *container)
+{
+	bool resized = false;
+	for (Container::WidgetIterator i = container->WidgetsBegin(); i != container->WidgetsEnd(); ++i) {
+		Widget *w = (*i).Get();
+		if (!w->m_layoutFlags) continue;
+		const Point oldSize(w->m_cachedPreferredSize);
+		if (w->GetPreferredSize() != oldSize)
+			resized = true;
+	}
+
+	if (resized) {
+		ClearLayoutFlags(container);
+		LayoutWidget(container);
+		return;
+	}
+
+	container->m_layoutFlags = 0;
+	for (Container::WidgetIterator i = container->WidgetsBegin(); i != container->WidgetsEnd(); ++i) {
+		Widget *w = (*i).Get();
+		if (w->m_layoutFlags & LAYOUT_DIRTY) {
+			ClearLayoutFlags(w);
+			w->Layout();
+		}
+		else if (w->m_layoutFlags & LAYOUT_CHILD_DIRTY)
+			LayoutDirtyChildren(static_cast<Container*>(w));
+	}
+}
+
+// our own Layout() is the full one
+void Context::LayoutWidget(Widget *widget)
+{
+	if (widget == this)
+		Single::Layout();
+	else
+		widget->Layout();
+}
+
+// a widget with no flags has none below it either
+void Context::ClearLayoutFlags(Widget *widget)
+{
+	if (!widget->m_layoutFlags) return;
+	widget->m_layoutFlags = 0;
+
+	if (!widget->IsContainer()) return;
+	Container *c = static_cast<Container*>(widget);
+	for (Container::WidgetIterator i = c->WidgetsBegin(); i != c->WidgetsEnd(); ++i)
+		ClearLayoutFlags((*i).Get());
+}
+
 void Context::Update()
 {
 	m_eventDispatcher.Update();
 
 	if (m_needsLayout)
 		Layout();
+	else if (m_layoutFlags || m_float->m_layoutFlags) {
+		LayoutDirty();
+		m_eventDispatcher.LayoutUpdated();
+	}
 
 	m_float->Update();
 	Single::Update();
@@ -123,6 +226,9 @@ void Context::Draw()
 	Single::Draw();
 	m_float->Draw();
 
+	m_skin.FlushBatch();
+	m_skin.SetBatchState(Skin::BatchState());
+
 	r->SetScissor(false);
 }
 
@@ -173,8 +279,21 @@ void Context::DrawWidget(Widget *w)
 
 	m_renderer->SetTransform(matrix4x4f::Translation(m_drawWidgetPosition.x, m_drawWidgetPosition.y, 0));
 
+	// skin elements go in the batch, clipped on the way in, so scissor
+	// changes don't split it. anyone drawing something else gets everything
+	// batched before them drawn first
+	const Skin::BatchState parentBatch(m_skin.GetBatchState());
+	if (w->CanBatchDraw())
+		m_skin.SetBatchState(Skin::BatchState(m_drawWidgetPosition, newScissorPos, newScissorSize));
+	else {
+		m_skin.FlushBatch();
+		m_skin.SetBatchState(Skin::BatchState());
+	}
+
 	w->Draw();
 
+	m_skin.SetBatchState(parentBatch);
+
 	m_scissorStack.pop();
 
 	m_drawWidgetPosition -= pos + drawOffset;
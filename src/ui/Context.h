@@ -120,7 +120,15 @@ public:
 	bool Dispatch(const Event &event) { return m_eventDispatcher.Dispatch(event); }
 	bool DispatchSDLEvent(const SDL_Event &event) { return m_eventDispatcher.DispatchSDLEvent(event); }
 
+	// lay everything out again
 	void RequestLayout() { m_needsLayout = true; }
+	// the widget's preferred size or layout has changed. it's laid out again
+	// along with whichever of its containers end up with a different
+	// allocation, and nothing else
+	void RequestLayout(Widget *widget);
+
+	// bumped by every full layout, making every widget measure itself again
+	Uint32 GetLayoutSerial() const { return m_layoutSerial; }
 
 	void SelectWidget(Widget *target) { m_eventDispatcher.SelectWidget(target); }
 	void DeselectWidget(Widget *target) { m_eventDispatcher.DeselectWidget(target); }
@@ -156,6 +164,13 @@ private:
 	float m_scale;
 
 	bool m_needsLayout;
+	Uint32 m_layoutSerial;
+
+	// the partial layout behind RequestLayout(Widget*)
+	void LayoutDirty();
+	void LayoutDirtyChildren(Container *container);
+	void LayoutWidget(Widget *widget);
+	static void ClearLayoutFlags(Widget *widget);
 
 	RefCountedPtr<FloatContainer> m_float;
 
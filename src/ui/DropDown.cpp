@@ -36,7 +36,7 @@ DropDown::DropDown(Context *context) : Container(context), m_popupActive(false)
 
 Point DropDown::PreferredSize()
 {
-	return m_container->PreferredSize();
+	return m_container->GetPreferredSize();
 }
 
 void DropDown::Layout()
@@ -81,7 +81,7 @@ void DropDown::TogglePopup()
 	else {
 		const Point pos(GetAbsolutePosition() + Point(0, GetSize().y));
 		m_popup->SetFont(GetFont());
-		c->AddFloatingWidget(m_popup.Get(), pos, m_popup->PreferredSize());
+		c->AddFloatingWidget(m_popup.Get(), pos, m_popup->GetPreferredSize());
 		m_popupActive = true;
 		m_icon->SetColor(activeColor);
 	}
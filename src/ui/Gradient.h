@@ -19,6 +19,7 @@ public:
 	};
 
 	virtual void Draw();
+	virtual bool CanBatchDraw() const { return false; }
 
 protected:
 	friend class Context;
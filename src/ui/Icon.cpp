@@ -4,17 +4,16 @@
 #include "Icon.h"
 #include "Context.h"
 #include "FileSystem.h"
-#include "graphics/TextureBuilder.h"
 
 static const char CONFIG_FILE[] = "ui/Icons.ini";
 static const char FALLBACK_ICON[] = "Blank";
 
 namespace UI {
 
+static const int ICON_SIZE = 48;
+
 IniConfig Icon::s_config;
-RefCountedPtr<Graphics::Texture> Icon::s_texture;
-vector2f Icon::s_texScale;
-RefCountedPtr<Graphics::Material> Icon::s_material;
+bool Icon::s_configLoaded = false;
 
 // XXX copypasta'd from Skin.cpp. this whole texture atlas and rectangles and
 // whatever should be abstracted out
@@ -42,18 +41,9 @@ static void SplitSpec(const std::string &spec, std::vector<int> &output)
 Icon::Icon(Context *context, const std::string &iconName): Widget(context),
 	m_color(Color::WHITE)
 {
-	if (!s_texture) {
+	if (!s_configLoaded) {
 		s_config.Read(FileSystem::gameDataFiles, CONFIG_FILE);
-
-		s_texture.Reset(Graphics::TextureBuilder::UI(s_config.String("TextureFile")).GetOrCreateTexture(GetContext()->GetRenderer(), "ui"));
-
-		const Graphics::TextureDescriptor &texDesc = s_texture->GetDescriptor();
-		s_texScale = vector2f(1.0f/texDesc.dataSize.x, 1.0f/texDesc.dataSize.y);
-
-		Graphics::MaterialDescriptor matDesc;
-		matDesc.textures = 1;
-		s_material.Reset(GetContext()->GetRenderer()->CreateMaterial(matDesc));
-		s_material->texture0 = s_texture.Get();
+		s_configLoaded = true;
 	}
 
 	std::string spec(s_config.String(iconName.c_str()));
@@ -63,35 +53,18 @@ Icon::Icon(Context *context, const std::string &iconName): Widget(context),
 
 	std::vector<int> v(2);
 	SplitSpec(spec, v);
-	m_texPos = Point(v[0], v[1]);
+	m_element = GetContext()->GetSkin().IconElement(Point(v[0], v[1]), Point(ICON_SIZE));
 }
 
 Point Icon::PreferredSize()
 {
 	SetSizeControlFlags(NO_HEIGHT | PRESERVE_ASPECT);
-	return Point(48);
+	return Point(ICON_SIZE);
 }
 
 void Icon::Draw()
 {
-	const Point &offset = GetActiveOffset();
-	const Point &area = GetActiveArea();
-
-	const float x = offset.x;
-	const float y = offset.y;
-	const float sx = area.x;
-	const float sy = area.y;
-
-	Graphics::VertexArray va(Graphics::ATTRIB_POSITION | Graphics::ATTRIB_UV0);
-	va.Add(vector3f(x,    y,    0.0f), vector2f(s_texScale.x*(m_texPos.x),    s_texScale.y*(m_texPos.y)));
-	va.Add(vector3f(x,    y+sy, 0.0f), vector2f(s_texScale.x*(m_texPos.x),    s_texScale.y*(m_texPos.y+48)));
-	va.Add(vector3f(x+sx, y,    0.0f), vector2f(s_texScale.x*(m_texPos.x+48), s_texScale.y*(m_texPos.y)));
-	va.Add(vector3f(x+sx, y+sy, 0.0f), vector2f(s_texScale.x*(m_texPos.x+48), s_texScale.y*(m_texPos.y+48)));
-
-	Graphics::Renderer *r = GetContext()->GetRenderer();
-	r->SetBlendMode(Graphics::BLEND_ALPHA);
-	s_material->diffuse = m_color;
-	r->DrawTriangles(&va, s_material.Get(), Graphics::TRIANGLE_STRIP);
+	GetContext()->GetSkin().DrawIcon(m_element, GetActiveOffset(), GetActiveArea(), m_color);
 }
 
 }
@@ -5,11 +5,8 @@
 #define UI_ICON_H
 
 #include "Widget.h"
+#include "Skin.h"
 #include "IniConfig.h"
-#include "SmartPtr.h"
-#include "vector2.h"
-#include "graphics/Material.h"
-#include "graphics/Texture.h"
 
 namespace UI {
 
@@ -18,6 +15,9 @@ public:
 	virtual Point PreferredSize();
 	virtual void Draw();
 
+	// the icons are in the skin texture
+	virtual bool CanBatchDraw() const { return true; }
+
 	Icon *SetColor(const Color &c) { m_color = c; return this; }
 
 protected:
@@ -25,14 +25,10 @@ protected:
 	Icon(Context *context, const std::string &iconName);
 
 private:
-	static IniConfig                         s_config;
-
-	static RefCountedPtr<Graphics::Texture>  s_texture;
-	static vector2f                          s_texScale;
-
-	static RefCountedPtr<Graphics::Material> s_material;
+	static IniConfig s_config;
+	static bool      s_configLoaded;
 
-	Point m_texPos;
+	Skin::RectElement m_element;
 	Color m_color;
 };
 
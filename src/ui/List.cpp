@@ -15,7 +15,7 @@ List::List(Context *context) : Container(context), m_selected(-1)
 }
 
 Point List::PreferredSize() {
-	return m_container->PreferredSize();
+	return m_container->GetPreferredSize();
 }
 
 void List::Layout() {
@@ -43,7 +43,7 @@ List *List::AddOption(const std::string &text)
 
 	m_optionBackgrounds.push_back(background);
 
-	GetContext()->RequestLayout();
+	GetContext()->RequestLayout(this);
 
 	return this;
 }
@@ -63,7 +63,7 @@ void List::Clear()
 	static_cast<VBox*>(m_container->GetInnerWidget())->Clear();
 	m_selected = -1;
 
-	GetContext()->RequestLayout();
+	GetContext()->RequestLayout(this);
 }
 
 bool List::HandleOptionMouseOver(int index)
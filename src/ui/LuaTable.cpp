@@ -36,13 +36,9 @@ public:
 		return 1;
 	}
 
-	static void _add_row(Table *t, lua_State *l, int idx) {
+	static void _get_row(UI::Context *c, lua_State *l, int idx, std::vector<UI::Widget*> &widgets) {
 		idx = lua_absindex(l, idx);
 
-		UI::Context *c = t->GetContext();
-
-		std::vector<UI::Widget*> widgets;
-
 		if (lua_istable(l, idx)) {
 			UI::Widget *w = UI::Lua::GetWidget(c, l, idx);
 			if (w)
@@ -56,7 +52,11 @@ public:
 		}
 		else
 			widgets.push_back(UI::Lua::CheckWidget(c, l, idx));
+	}
 
+	static void _add_row(Table *t, lua_State *l, int idx) {
+		std::vector<UI::Widget*> widgets;
+		_get_row(t->GetContext(), l, idx, widgets);
 		t->AddRow(WidgetSet(widgets));
 	}
 
@@ -82,6 +82,44 @@ public:
 		return 1;
 	}
 
+	// calls the lua function for each row, with the row number (from 1)
+	class LuaRowProvider {
+	public:
+		typedef WidgetSet result_type;
+
+		LuaRowProvider(UI::Context *c, const LuaRef &fn) : m_context(c), m_fn(fn) {}
+
+		WidgetSet operator()(unsigned int index) const {
+			lua_State *l = m_fn.GetLua();
+			LUA_DEBUG_START(l);
+
+			m_fn.PushCopyToStack();
+			lua_pushinteger(l, index+1);
+			pi_lua_protected_call(l, 1, 1);
+
+			std::vector<UI::Widget*> widgets;
+			_get_row(m_context, l, -1, widgets);
+			lua_pop(l, 1);
+
+			LUA_DEBUG_END(l, 0);
+			return WidgetSet(widgets);
+		}
+
+	private:
+		UI::Context *m_context;
+		LuaRef m_fn;
+	};
+
+	static int l_set_row_provider(lua_State *l) {
+		UI::Table *t = LuaObject<UI::Table>::CheckFromLua(1);
+		int numRows = luaL_checkinteger(l, 2);
+		int rowHeight = luaL_checkinteger(l, 3);
+		luaL_checktype(l, 4, LUA_TFUNCTION);
+		t->SetRowProvider(std::max(numRows, 0), rowHeight, LuaRowProvider(t->GetContext(), LuaRef(l, 4)));
+		lua_pushvalue(l, 1);
+		return 1;
+	}
+
 	static int l_set_row_spacing(lua_State *l) {
 		UI::Table *t = LuaObject<UI::Table>::CheckFromLua(1);
 		int spacing = luaL_checkinteger(l, 2);
@@ -122,6 +160,7 @@ template <> void LuaObject<UI::Table>::RegisterClass()
 		{ "SetHeadingRow",    UI::LuaTable::l_set_heading_row    },
 		{ "AddRow",           UI::LuaTable::l_add_row            },
 		{ "AddRows",          UI::LuaTable::l_add_rows           },
+		{ "SetRowProvider",   UI::LuaTable::l_set_row_provider   },
 		{ "SetRowSpacing",    UI::LuaTable::l_set_row_spacing    },
 		{ "SetColumnSpacing", UI::LuaTable::l_set_column_spacing },
 		{ "SetHeadingFont",   UI::LuaTable::l_set_heading_font   },
@@ -24,7 +24,7 @@ Point MultiLineText::PreferredSize()
 void MultiLineText::Layout()
 {
 	const Point newSize(m_layout->ComputeSize(GetSize()));
-	if (m_preferredSize != newSize) GetContext()->RequestLayout();
+	if (m_preferredSize != newSize) GetContext()->RequestLayout(this);
 	m_preferredSize = newSize;
 	SetActiveArea(m_preferredSize);
 }
@@ -44,13 +44,16 @@ MultiLineText *MultiLineText::SetText(const std::string &text)
 {
 	m_text = text;
 	m_layout.Reset(new TextLayout(GetContext()->GetFont(GetFont()), m_text));
-	GetContext()->RequestLayout();
+	GetContext()->RequestLayout(this);
 	return this;
 }
 
 MultiLineText *MultiLineText::AppendText(const std::string &text)
 {
-	return SetText(m_text + text);
+	m_text += text;
+	m_layout->AppendText(text);
+	GetContext()->RequestLayout(this);
+	return this;
 }
 
 }
@@ -8,11 +8,11 @@ namespace UI {
 
 Point Scroller::PreferredSize()
 {
-	const Point sliderSize = m_slider ? m_slider->PreferredSize() : Point(0);
+	const Point sliderSize = m_slider ? m_slider->GetPreferredSize() : Point(0);
 	if (!m_innerWidget)
 		return sliderSize;
 
-	const Point innerWidgetSize = m_innerWidget->PreferredSize();
+	const Point innerWidgetSize = m_innerWidget->GetPreferredSize();
 
 	return Point(SizeAdd(innerWidgetSize.x, sliderSize.x), innerWidgetSize.y);
 }
@@ -23,7 +23,7 @@ void Scroller::Layout()
 
 	const Point size(GetSize());
 
-	const Point childPreferredSize = m_innerWidget->PreferredSize();
+	const Point childPreferredSize = m_innerWidget->GetPreferredSize();
 
 	// if the child can fit then we don't need the slider
 	if (childPreferredSize.y <= size.y) {
@@ -44,12 +44,12 @@ void Scroller::Layout()
 			AddWidget(m_slider);
 		}
 
-		const Point sliderSize = m_slider->PreferredSize();
+		const Point sliderSize = m_slider->GetPreferredSize();
 
 		SetWidgetDimensions(m_slider, Point(size.x-sliderSize.x, 0), Point(sliderSize.x, size.y));
 		m_slider->Layout();
 
-		SetWidgetDimensions(m_innerWidget, Point(), Point(size.x-sliderSize.x, std::max(size.y, m_innerWidget->PreferredSize().y)));
+		SetWidgetDimensions(m_innerWidget, Point(), Point(size.x-sliderSize.x, std::max(size.y, m_innerWidget->GetPreferredSize().y)));
 		m_innerWidget->Layout();
 	}
 }
@@ -6,14 +6,42 @@
 #include "graphics/TextureBuilder.h"
 #include "graphics/VertexArray.h"
 #include "FileSystem.h"
+#include "SDLWrappers.h"
 
 namespace UI {
 
-static const float SKIN_SIZE = 512.0f;
+// the icon sheet is in here
+static const char ICONS_CONFIG_FILE[] = "ui/Icons.ini";
+
+// one image, the others stacked below it, so that everything they have can
+// be drawn from one texture. tops gets where each one went
+static SDLSurfacePtr stack_images(const std::vector<SDLSurfacePtr> &images, std::vector<int> &tops)
+{
+	int width = 0, height = 0;
+	for (std::vector<SDLSurfacePtr>::const_iterator i = images.begin(); i != images.end(); ++i) {
+		tops.push_back(height);
+		if (!*i) continue;
+		width = std::max(width, (*i)->w);
+		height += (*i)->h;
+	}
+
+	SDLSurfacePtr atlas = SDLSurfacePtr::WrapNew(SDL_CreateRGBSurface(SDL_SWSURFACE, width, height, 32, 0xff, 0xff00, 0xff0000, 0xff000000));
+	for (std::size_t i = 0; i < images.size(); i++) {
+		if (!images[i]) continue;
+		// copy the alpha rather than blending with it
+		SDL_SetAlpha(images[i].Get(), 0, 0);
+		SDL_Rect destrec = { 0, 0, 0, 0 };
+		destrec.y = tops[i];
+		SDL_BlitSurface(images[i].Get(), 0, atlas.Get(), &destrec);
+	}
+
+	return atlas;
+}
 
 Skin::Skin(const std::string &filename, Graphics::Renderer *renderer, float scale) :
 	m_renderer(renderer),
-	m_scale(scale)
+	m_scale(scale),
+	m_batchVertices(Graphics::ATTRIB_POSITION | Graphics::ATTRIB_UV0)
 {
 	IniConfig cfg;
 	// set defaults
@@ -24,7 +52,23 @@ Skin::Skin(const std::string &filename, Graphics::Renderer *renderer, float scal
 	// load
 	cfg.Read(FileSystem::gameDataFiles, filename);
 
-	m_texture.Reset(Graphics::TextureBuilder::UI(cfg.String("TextureFile")).GetOrCreateTexture(m_renderer, "ui"));
+	IniConfig iconCfg;
+	iconCfg.Read(FileSystem::gameDataFiles, ICONS_CONFIG_FILE);
+
+	// the skin and the icon sheet share a texture, so icons can go in the
+	// same batch as the skin elements around them
+	std::vector<SDLSurfacePtr> images;
+	images.push_back(LoadSurfaceFromFile(cfg.String("TextureFile")));
+	images.push_back(LoadSurfaceFromFile(iconCfg.String("TextureFile")));
+	std::vector<int> tops;
+	SDLSurfacePtr atlas = stack_images(images, tops);
+	m_iconTop = tops[1];
+
+	Graphics::TextureBuilder b(atlas, Graphics::LINEAR_CLAMP, false, true, true, false);
+	m_texture.Reset(b.CreateTexture(m_renderer));
+
+	const Graphics::TextureDescriptor &texDesc = b.GetDescriptor();
+	m_texScale = vector2f(1.0f/texDesc.dataSize.x, 1.0f/texDesc.dataSize.y);
 
 	Graphics::MaterialDescriptor desc;
 	desc.textures = 1;
@@ -76,105 +120,136 @@ Skin::Skin(const std::string &filename, Graphics::Renderer *renderer, float scal
 	m_listAlphaHover  = cfg.Float("ListAlphaHover");
 }
 
-static inline vector2f scaled(const vector2f &v)
+// texture coordinates are in atlas pixels
+static void add_quad(Graphics::VertexArray &va, const vector2f &texScale, float x0, float y0, float x1, float y1, float u0, float v0, float u1, float v1)
 {
-	return v * (1.0f / SKIN_SIZE);
+	const vector3f p0(x0, y0, 0.0f), p1(x0, y1, 0.0f), p2(x1, y0, 0.0f), p3(x1, y1, 0.0f);
+	u0 *= texScale.x; u1 *= texScale.x;
+	v0 *= texScale.y; v1 *= texScale.y;
+	const vector2f t0(u0, v0), t1(u0, v1), t2(u1, v0), t3(u1, v1);
+
+	va.Add(p0, t0);
+	va.Add(p1, t1);
+	va.Add(p2, t2);
+
+	va.Add(p2, t2);
+	va.Add(p1, t1);
+	va.Add(p3, t3);
 }
 
-void Skin::DrawRectElement(const RectElement &element, const Point &pos, const Point &size, Graphics::BlendMode blendMode) const
+// elements are drawn as a grid of quads, cut at xs and ys on the screen and
+// at the matching us and vs (in skin pixels) in the texture
+void Skin::DrawGrid(const float *xs, const float *us, int nx, const float *ys, const float *vs, int ny, Graphics::BlendMode blendMode) const
 {
-	Graphics::VertexArray va(Graphics::ATTRIB_POSITION | Graphics::ATTRIB_UV0);
+	if (m_batchState.open && blendMode == Graphics::BLEND_ALPHA) {
+		const float clipX0 = m_batchState.clipPos.x, clipX1 = clipX0 + m_batchState.clipSize.x;
+		const float clipY0 = m_batchState.clipPos.y, clipY1 = clipY0 + m_batchState.clipSize.y;
+
+		for (int j = 0; j < ny-1; j++) {
+			const float y0 = m_batchState.origin.y + ys[j], y1 = m_batchState.origin.y + ys[j+1];
+			const float top = std::max(y0, clipY0), bottom = std::min(y1, clipY1);
+			if (top >= bottom) continue;
+			// the texture is cut in the same proportion as the quad
+			const float vScale = (vs[j+1] - vs[j]) / (y1 - y0);
+
+			for (int i = 0; i < nx-1; i++) {
+				const float x0 = m_batchState.origin.x + xs[i], x1 = m_batchState.origin.x + xs[i+1];
+				const float left = std::max(x0, clipX0), right = std::min(x1, clipX1);
+				if (left >= right) continue;
+				const float uScale = (us[i+1] - us[i]) / (x1 - x0);
+
+				add_quad(m_batchVertices, m_texScale, left, top, right, bottom,
+					us[i] + (left-x0)*uScale, vs[j] + (top-y0)*vScale,
+					us[i] + (right-x0)*uScale, vs[j] + (bottom-y0)*vScale);
+			}
+		}
+		return;
+	}
 
-	va.Add(vector3f(pos.x,        pos.y,        0.0f), scaled(vector2f(element.pos.x,                element.pos.y)));
-	va.Add(vector3f(pos.x,        pos.y+size.y, 0.0f), scaled(vector2f(element.pos.x,                element.pos.y+element.size.y)));
-	va.Add(vector3f(pos.x+size.x, pos.y,        0.0f), scaled(vector2f(element.pos.x+element.size.x, element.pos.y)));
-	va.Add(vector3f(pos.x+size.x, pos.y+size.y, 0.0f), scaled(vector2f(element.pos.x+element.size.x, element.pos.y+element.size.y)));
+	Graphics::VertexArray va(Graphics::ATTRIB_POSITION | Graphics::ATTRIB_UV0);
+	for (int j = 0; j < ny-1; j++)
+		for (int i = 0; i < nx-1; i++)
+			add_quad(va, m_texScale, xs[i], ys[j], xs[i+1], ys[j+1], us[i], vs[j], us[i+1], vs[j+1]);
 
 	m_renderer->SetBlendMode(blendMode);
-	m_renderer->DrawTriangles(&va, m_material.Get(), Graphics::TRIANGLE_STRIP);
+	m_renderer->DrawTriangles(&va, m_material.Get());
 }
 
-void Skin::DrawBorderedRectElement(const BorderedRectElement &element, const Point &pos, const Point &size, Graphics::BlendMode blendMode) const
+void Skin::FlushBatch() const
 {
-	const float width = element.borderWidth;
+	if (!m_batchVertices.GetNumVerts()) return;
 
-	Graphics::VertexArray va(Graphics::ATTRIB_POSITION | Graphics::ATTRIB_UV0);
+	// the vertices are already where they go on the screen
+	Graphics::Renderer::StateTicket ticket(m_renderer);
+	m_renderer->SetTransform(matrix4x4f::Identity());
+	m_renderer->SetScissor(false);
+	m_renderer->SetBlendMode(Graphics::BLEND_ALPHA);
+	m_renderer->DrawTriangles(&m_batchVertices, m_material.Get());
 
-	va.Add(vector3f(pos.x,              pos.y,       0.0f), scaled(vector2f(element.pos.x,                      element.pos.y)));
-	va.Add(vector3f(pos.x,              pos.y+width, 0.0f), scaled(vector2f(element.pos.x,                      element.pos.y+width)));
-	va.Add(vector3f(pos.x+width,        pos.y,       0.0f), scaled(vector2f(element.pos.x+width,                element.pos.y)));
-	va.Add(vector3f(pos.x+width,        pos.y+width, 0.0f), scaled(vector2f(element.pos.x+width,                element.pos.y+width)));
-	va.Add(vector3f(pos.x+size.x-width, pos.y,       0.0f), scaled(vector2f(element.pos.x+element.size.x-width, element.pos.y)));
-	va.Add(vector3f(pos.x+size.x-width, pos.y+width, 0.0f), scaled(vector2f(element.pos.x+element.size.x-width, element.pos.y+width)));
-	va.Add(vector3f(pos.x+size.x,       pos.y,       0.0f), scaled(vector2f(element.pos.x+element.size.x,       element.pos.y)));
-	va.Add(vector3f(pos.x+size.x,       pos.y+width, 0.0f), scaled(vector2f(element.pos.x+element.size.x,       element.pos.y+width)));
-
-	// degenerate triangles to join rows
-	va.Add(vector3f(pos.x+size.x,       pos.y+width, 0.0f), scaled(vector2f(element.pos.x+element.size.x,       element.pos.y+width)));
-	va.Add(vector3f(pos.x,              pos.y+width,        0.0f), scaled(vector2f(element.pos.x,                      element.pos.y+width)));
-
-	va.Add(vector3f(pos.x,              pos.y+width,        0.0f), scaled(vector2f(element.pos.x,                      element.pos.y+width)));
-	va.Add(vector3f(pos.x,              pos.y+size.y-width, 0.0f), scaled(vector2f(element.pos.x,                      element.pos.y+element.size.y-width)));
-	va.Add(vector3f(pos.x+width,        pos.y+width,        0.0f), scaled(vector2f(element.pos.x+width,                element.pos.y+width)));
-	va.Add(vector3f(pos.x+width,        pos.y+size.y-width, 0.0f), scaled(vector2f(element.pos.x+width,                element.pos.y+element.size.y-width)));
-	va.Add(vector3f(pos.x+size.x-width, pos.y+width,        0.0f), scaled(vector2f(element.pos.x+element.size.x-width, element.pos.y+width)));
-	va.Add(vector3f(pos.x+size.x-width, pos.y+size.y-width, 0.0f), scaled(vector2f(element.pos.x+element.size.x-width, element.pos.y+element.size.y-width)));
-	va.Add(vector3f(pos.x+size.x,       pos.y+width,        0.0f), scaled(vector2f(element.pos.x+element.size.x,       element.pos.y+width)));
-	va.Add(vector3f(pos.x+size.x,       pos.y+size.y-width, 0.0f), scaled(vector2f(element.pos.x+element.size.x,       element.pos.y+element.size.y-width)));
-
-	// degenerate triangles to join rows
-	va.Add(vector3f(pos.x+size.x,       pos.y+size.y-width, 0.0f), scaled(vector2f(element.pos.x+element.size.x,       element.pos.y+element.size.y-width)));
-	va.Add(vector3f(pos.x,              pos.y+size.y-width, 0.0f), scaled(vector2f(element.pos.x,                      element.pos.y+element.size.y-width)));
-
-	va.Add(vector3f(pos.x,              pos.y+size.y-width, 0.0f), scaled(vector2f(element.pos.x,                      element.pos.y+element.size.y-width)));
-	va.Add(vector3f(pos.x,              pos.y+size.y,       0.0f), scaled(vector2f(element.pos.x,                      element.pos.y+element.size.y)));
-	va.Add(vector3f(pos.x+width,        pos.y+size.y-width, 0.0f), scaled(vector2f(element.pos.x+width,                element.pos.y+element.size.y-width)));
-	va.Add(vector3f(pos.x+width,        pos.y+size.y,       0.0f), scaled(vector2f(element.pos.x+width,                element.pos.y+element.size.y)));
-	va.Add(vector3f(pos.x+size.x-width, pos.y+size.y-width, 0.0f), scaled(vector2f(element.pos.x+element.size.x-width, element.pos.y+element.size.y-width)));
-	va.Add(vector3f(pos.x+size.x-width, pos.y+size.y,       0.0f), scaled(vector2f(element.pos.x+element.size.x-width, element.pos.y+element.size.y)));
-	va.Add(vector3f(pos.x+size.x,       pos.y+size.y-width, 0.0f), scaled(vector2f(element.pos.x+element.size.x,       element.pos.y+element.size.y-width)));
-	va.Add(vector3f(pos.x+size.x,       pos.y+size.y,       0.0f), scaled(vector2f(element.pos.x+element.size.x,       element.pos.y+element.size.y)));
+	m_batchVertices.Clear();
+}
 
-	m_renderer->SetBlendMode(blendMode);
-	m_renderer->DrawTriangles(&va, m_material.Get(), Graphics::TRIANGLE_STRIP);
+void Skin::DrawRectElement(const RectElement &element, const Point &pos, const Point &size, Graphics::BlendMode blendMode) const
+{
+	const float xs[] = { float(pos.x), float(pos.x+size.x) };
+	const float ys[] = { float(pos.y), float(pos.y+size.y) };
+	const float us[] = { float(element.pos.x), float(element.pos.x+element.size.x) };
+	const float vs[] = { float(element.pos.y), float(element.pos.y+element.size.y) };
+	DrawGrid(xs, us, 2, ys, vs, 2, blendMode);
 }
 
-void Skin::DrawVerticalEdgedRectElement(const EdgedRectElement &element, const Point &pos, const Point &size, Graphics::BlendMode blendMode) const
+Skin::RectElement Skin::IconElement(const Point &iconPos, const Point &iconSize) const
 {
-	const float height = element.edgeWidth;
+	return RectElement(iconPos.x, m_iconTop+iconPos.y, iconSize.x, iconSize.y);
+}
+
+void Skin::DrawIcon(const RectElement &element, const Point &pos, const Point &size, const Color &color) const
+{
+	if (color.r == 1.0f && color.g == 1.0f && color.b == 1.0f && color.a == 1.0f) {
+		DrawRectElement(element, pos, size);
+		return;
+	}
+
+	// the batch has no colours, so tinted icons are drawn on their own
+	FlushBatch();
 
 	Graphics::VertexArray va(Graphics::ATTRIB_POSITION | Graphics::ATTRIB_UV0);
+	add_quad(va, m_texScale, pos.x, pos.y, pos.x+size.x, pos.y+size.y, element.pos.x, element.pos.y, element.pos.x+element.size.x, element.pos.y+element.size.y);
 
-	va.Add(vector3f(pos.x+size.x, pos.y,               0.0f), scaled(vector2f(element.pos.x+element.size.x, element.pos.y)));
-	va.Add(vector3f(pos.x,        pos.y,               0.0f), scaled(vector2f(element.pos.x,                element.pos.y)));
-	va.Add(vector3f(pos.x+size.x, pos.y+height,        0.0f), scaled(vector2f(element.pos.x+element.size.x, element.pos.y+height)));
-	va.Add(vector3f(pos.x,        pos.y+height,        0.0f), scaled(vector2f(element.pos.x,                element.pos.y+height)));
-	va.Add(vector3f(pos.x+size.x, pos.y+size.y-height, 0.0f), scaled(vector2f(element.pos.x+element.size.x, element.pos.y+element.size.y-height)));
-	va.Add(vector3f(pos.x,        pos.y+size.y-height, 0.0f), scaled(vector2f(element.pos.x,                element.pos.y+element.size.y-height)));
-	va.Add(vector3f(pos.x+size.x, pos.y+size.y,        0.0f), scaled(vector2f(element.pos.x+element.size.x, element.pos.y+element.size.y)));
-	va.Add(vector3f(pos.x,        pos.y+size.y,        0.0f), scaled(vector2f(element.pos.x,                element.pos.y+element.size.y)));
+	m_renderer->SetBlendMode(Graphics::BLEND_ALPHA);
+	m_material->diffuse = color;
+	m_renderer->DrawTriangles(&va, m_material.Get());
+	m_material->diffuse = Color::WHITE;
+}
 
-	m_renderer->SetBlendMode(blendMode);
-	m_renderer->DrawTriangles(&va, m_material.Get(), Graphics::TRIANGLE_STRIP);
+void Skin::DrawBorderedRectElement(const BorderedRectElement &element, const Point &pos, const Point &size, Graphics::BlendMode blendMode) const
+{
+	const float width = element.borderWidth;
+	const float xs[] = { float(pos.x), pos.x+width, pos.x+size.x-width, float(pos.x+size.x) };
+	const float ys[] = { float(pos.y), pos.y+width, pos.y+size.y-width, float(pos.y+size.y) };
+	const float us[] = { float(element.pos.x), element.pos.x+width, element.pos.x+element.size.x-width, float(element.pos.x+element.size.x) };
+	const float vs[] = { float(element.pos.y), element.pos.y+width, element.pos.y+element.size.y-width, float(element.pos.y+element.size.y) };
+	DrawGrid(xs, us, 4, ys, vs, 4, blendMode);
+}
+
+void Skin::DrawVerticalEdgedRectElement(const EdgedRectElement &element, const Point &pos, const Point &size, Graphics::BlendMode blendMode) const
+{
+	const float height = element.edgeWidth;
+	const float xs[] = { float(pos.x), float(pos.x+size.x) };
+	const float ys[] = { float(pos.y), pos.y+height, pos.y+size.y-height, float(pos.y+size.y) };
+	const float us[] = { float(element.pos.x), float(element.pos.x+element.size.x) };
+	const float vs[] = { float(element.pos.y), element.pos.y+height, element.pos.y+element.size.y-height, float(element.pos.y+element.size.y) };
+	DrawGrid(xs, us, 2, ys, vs, 4, blendMode);
 }
 
 void Skin::DrawHorizontalEdgedRectElement(const EdgedRectElement &element, const Point &pos, const Point &size, Graphics::BlendMode blendMode) const
 {
 	const float width = element.edgeWidth;
-
-	Graphics::VertexArray va(Graphics::ATTRIB_POSITION | Graphics::ATTRIB_UV0);
-
-	va.Add(vector3f(pos.x,              pos.y,        0.0f), scaled(vector2f(element.pos.x,                      element.pos.y)));
-	va.Add(vector3f(pos.x,              pos.y+size.y, 0.0f), scaled(vector2f(element.pos.x,                      element.pos.y+element.size.y)));
-	va.Add(vector3f(pos.x+width,        pos.y,        0.0f), scaled(vector2f(element.pos.x+width,                element.pos.y)));
-	va.Add(vector3f(pos.x+width,        pos.y+size.y, 0.0f), scaled(vector2f(element.pos.x+width,                element.pos.y+element.size.y)));
-	va.Add(vector3f(pos.x+size.x-width, pos.y,        0.0f), scaled(vector2f(element.pos.x+element.size.x-width, element.pos.y)));
-	va.Add(vector3f(pos.x+size.x-width, pos.y+size.y, 0.0f), scaled(vector2f(element.pos.x+element.size.x-width, element.pos.y+element.size.y)));
-	va.Add(vector3f(pos.x+size.x,       pos.y,        0.0f), scaled(vector2f(element.pos.x+element.size.x,       element.pos.y)));
-	va.Add(vector3f(pos.x+size.x,       pos.y+size.y, 0.0f), scaled(vector2f(element.pos.x+element.size.x,       element.pos.y+element.size.y)));
-
-	m_renderer->SetBlendMode(blendMode);
-	m_renderer->DrawTriangles(&va, m_material.Get(), Graphics::TRIANGLE_STRIP);
+	const float xs[] = { float(pos.x), pos.x+width, pos.x+size.x-width, float(pos.x+size.x) };
+	const float ys[] = { float(pos.y), float(pos.y+size.y) };
+	const float us[] = { float(element.pos.x), element.pos.x+width, element.pos.x+element.size.x-width, float(element.pos.x+element.size.x) };
+	const float vs[] = { float(element.pos.y), float(element.pos.y+element.size.y) };
+	DrawGrid(xs, us, 4, ys, vs, 2, blendMode);
 }
 
 static void SplitSpec(const std::string &spec, std::vector<int> &output)
@@ -8,6 +8,7 @@
 #include "SmartPtr.h"
 #include "graphics/Renderer.h"
 #include "graphics/Material.h"
+#include "graphics/VertexArray.h"
 #include "Point.h"
 
 namespace UI {
@@ -175,6 +176,29 @@ public:
 	const RectElement &GaugeFillWarning()     const { return m_gaugeFillWarning; }
 	const RectElement &GaugeFillCritical()    const { return m_gaugeFillCritical; }
 
+	// every element is in the one skin texture, so they can be collected
+	// and drawn together. while a batch is open, elements drawn with the
+	// normal blend mode are moved to the origin, clipped to the clip
+	// rectangle (both in screen coordinates) and kept until FlushBatch
+	// draws the lot in one go. anything else has to flush first so that
+	// everything still lands in the order it was drawn
+	struct BatchState {
+		BatchState() : open(false) {}
+		BatchState(const Point &_origin, const Point &_clipPos, const Point &_clipSize) : open(true), origin(_origin), clipPos(_clipPos), clipSize(_clipSize) {}
+		bool open;
+		Point origin;
+		Point clipPos;
+		Point clipSize;
+	};
+	const BatchState &GetBatchState() const { return m_batchState; }
+	void SetBatchState(const BatchState &state) { m_batchState = state; }
+	void FlushBatch() const;
+
+	// the icon sheet (see Icon) is in the skin texture too, below the skin
+	// itself. IconElement finds an icon given where it is on the sheet
+	RectElement IconElement(const Point &iconPos, const Point &iconSize) const;
+	void DrawIcon(const RectElement &element, const Point &pos, const Point &size, const Color &color) const;
+
 	unsigned int ButtonMinInnerSize() const { return m_buttonMinInnerSize; }
 
 	float ListAlphaNormal() const { return m_listAlphaNormal; }
@@ -188,6 +212,13 @@ private:
 
 	RefCountedPtr<Graphics::Texture> m_texture;
 	RefCountedPtr<Graphics::Material> m_material;
+	vector2f m_texScale;
+	int m_iconTop;
+
+	BatchState m_batchState;
+	mutable Graphics::VertexArray m_batchVertices;
+
+	void DrawGrid(const float *xs, const float *us, int nx, const float *ys, const float *vs, int ny, Graphics::BlendMode blendMode) const;
 
 	void DrawRectElement(const RectElement &element, const Point &pos, const Point &size, Graphics::BlendMode blendMode = Graphics::BLEND_ALPHA) const;
 	void DrawBorderedRectElement(const BorderedRectElement &element, const Point &pos, const Point &size, Graphics::BlendMode blendMode = Graphics::BLEND_ALPHA) const;
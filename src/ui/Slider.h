@@ -13,6 +13,7 @@ public:
 	virtual Point PreferredSize();
 	virtual void Layout();
 	virtual void Draw();
+	virtual bool CanBatchDraw() const { return true; }
 
 	float GetValue() const { return m_value; }
 	void SetValue(float v);
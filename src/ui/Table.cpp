@@ -44,10 +44,18 @@ void Table::LayoutAccumulator::SetColumnSpacing(int spacing) {
 	}
 }
 
+// provided rows kept either side of the view, so that short scrolls don't
+// make and drop rows all the time
+static const unsigned int PROVIDED_ROW_MARGIN = 8;
+
 Table::Inner::Inner(Context *context, LayoutAccumulator &layout) : Container(context),
 	m_layout(layout),
 	m_rowSpacing(0),
-	m_dirty(false)
+	m_dirty(false),
+	m_provided(false),
+	m_numProvidedRows(0),
+	m_providedRowHeight(0),
+	m_firstRow(0)
 {
 }
 
@@ -66,6 +74,14 @@ Point Table::Inner::PreferredSize()
 	m_preferredSize.x = colLeft.back() + colWidth.back();
 	m_preferredSize.y = 0;
 
+	if (m_provided) {
+		// rows that haven't been made yet still take up room
+		const int numRows = m_numProvidedRows;
+		m_preferredSize.y = numRows*m_providedRowHeight + std::max(numRows-1, 0)*m_rowSpacing;
+		m_dirty = false;
+		return m_preferredSize;
+	}
+
 	m_rowHeight.resize(m_rows.size());
 
 	for (std::size_t i = 0; i < m_rows.size(); i++) {
@@ -96,15 +112,19 @@ void Table::Inner::Layout()
 	const std::vector<int> &colWidth = m_layout.ColumnWidth();
 	const std::vector<int> &colLeft = m_layout.ColumnLeft();
 
+	if (m_provided)
+		pos.y = m_firstRow*(m_providedRowHeight + m_rowSpacing);
+
 	for (std::size_t i = 0; i < m_rows.size(); i++) {
 		const std::vector<Widget*> &row = m_rows[i];
+		const int rowHeight = m_provided ? m_providedRowHeight : m_rowHeight[i];
 		for (std::size_t j = 0; j < row.size(); j++) {
 			Widget *w = row[j];
 			if (!w) continue;
 			pos.x = colLeft[j];
-			SetWidgetDimensions(w, pos, Point(colWidth[j], m_rowHeight[i]));
+			SetWidgetDimensions(w, pos, Point(colWidth[j], rowHeight));
 		}
-		pos.y += m_rowHeight[i] + m_rowSpacing;
+		pos.y += rowHeight + m_rowSpacing;
 	}
 
 	LayoutChildren();
@@ -125,19 +145,98 @@ void Table::Inner::AddRow(const std::vector<Widget*> &widgets)
 
 void Table::Inner::Clear()
 {
-	for (std::vector< std::vector<Widget*> >::const_iterator i = m_rows.begin(); i != m_rows.end(); ++i) {
-		for (std::size_t j = 0; j < (*i).size(); j++) {
-			if (!(*i)[j]) continue;
-			RemoveWidget((*i)[j]);
-		}
-	}
+	for (std::vector< std::vector<Widget*> >::const_iterator i = m_rows.begin(); i != m_rows.end(); ++i)
+		RemoveRow(*i);
 
 	m_rows.clear();
 	m_preferredSize = Point();
 
+	m_provided = false;
+	m_provider = RowProvider();
+	m_numProvidedRows = 0;
+	m_providedRowHeight = 0;
+	m_firstRow = 0;
+
 	m_dirty = false;
 }
 
+void Table::Inner::RemoveRow(const std::vector<Widget*> &widgets)
+{
+	for (std::size_t i = 0; i < widgets.size(); i++) {
+		if (!widgets[i]) continue;
+		RemoveWidget(widgets[i]);
+	}
+}
+
+std::vector<Widget*> Table::Inner::MakeRow(unsigned int index)
+{
+	const std::vector<Widget*> widgets(m_provider(index).widgets);
+	for (std::size_t i = 0; i < widgets.size(); i++) {
+		if (!widgets[i]) continue;
+		AddWidget(widgets[i]);
+	}
+	m_layout.AddRow(widgets);
+	return widgets;
+}
+
+void Table::Inner::SetRowProvider(unsigned int numRows, int rowHeight, const RowProvider &provider)
+{
+	Clear();
+
+	m_provided = true;
+	m_provider = provider;
+	m_numProvidedRows = numRows;
+	m_providedRowHeight = rowHeight;
+
+	// no height given, so every row is taken to be as high as the first
+	if (m_providedRowHeight <= 0 && numRows > 0) {
+		m_rows.push_back(MakeRow(0));
+		m_providedRowHeight = 0;
+		const std::vector<Widget*> &row = m_rows.back();
+		for (std::size_t i = 0; i < row.size(); i++) {
+			if (!row[i]) continue;
+			m_providedRowHeight = std::max(m_providedRowHeight, row[i]->CalcLayoutContribution().y);
+		}
+	}
+
+	m_dirty = true;
+}
+
+bool Table::Inner::SetVisibleArea(int top, int height)
+{
+	if (!m_provided || m_providedRowHeight <= 0)
+		return false;
+
+	const int step = m_providedRowHeight + m_rowSpacing;
+	const unsigned int end = std::min(unsigned(std::max(top+height, 0)/step) + 1 + PROVIDED_ROW_MARGIN, m_numProvidedRows);
+	const unsigned int first = std::min(unsigned(std::max(top/step - int(PROVIDED_ROW_MARGIN), 0)), end);
+
+	const unsigned int oldFirst = m_firstRow;
+	const unsigned int oldEnd = m_firstRow + m_rows.size();
+	if (first == oldFirst && end == oldEnd)
+		return false;
+
+	const std::vector<int> oldColumnWidth(m_layout.ColumnWidth());
+
+	// rows still in range are kept as they are
+	std::vector< std::vector<Widget*> > rows;
+	rows.reserve(end-first);
+	for (unsigned int i = first; i < end; i++) {
+		if (i >= oldFirst && i < oldEnd)
+			rows.push_back(m_rows[i-oldFirst]);
+		else
+			rows.push_back(MakeRow(i));
+	}
+	for (unsigned int i = oldFirst; i < oldEnd; i++)
+		if (i < first || i >= end)
+			RemoveRow(m_rows[i-oldFirst]);
+
+	m_rows.swap(rows);
+	m_firstRow = first;
+
+	return m_layout.ColumnWidth() != oldColumnWidth;
+}
+
 void Table::Inner::AccumulateLayout()
 {
 	for (std::vector< std::vector<Widget*> >::const_iterator i = m_rows.begin(); i != m_rows.end(); ++i)
@@ -177,10 +276,10 @@ Point Table::PreferredSize()
 		m_dirty = false;
 	}
 
-	const Point sliderSize = m_slider->PreferredSize();
+	const Point sliderSize = m_slider->GetPreferredSize();
 
-	const Point headerPreferredSize = m_header->PreferredSize();
-	const Point bodyPreferredSize = m_body->PreferredSize();
+	const Point headerPreferredSize = m_header->GetPreferredSize();
+	const Point bodyPreferredSize = m_body->GetPreferredSize();
 
 	return Point(std::max(headerPreferredSize.x,bodyPreferredSize.x)+sliderSize.x, headerPreferredSize.y+bodyPreferredSize.y);
 }
@@ -192,14 +291,14 @@ void Table::Layout()
 
 	Point size = GetSize();
 
-	Point preferredSize(m_header->PreferredSize());
+	Point preferredSize(m_header->GetPreferredSize());
 	SetWidgetDimensions(m_header.Get(), Point(), Point(size.x, preferredSize.y));
 	int top = preferredSize.y;
 	size.y -= top;
 
 	int sliderLeft = preferredSize.x;
 
-	preferredSize = m_body->PreferredSize();
+	preferredSize = m_body->GetPreferredSize();
 	if (preferredSize.y <= size.y) {
 		if (m_slider->GetContainer()) {
 			m_onMouseWheelConn.disconnect();
@@ -212,7 +311,7 @@ void Table::Layout()
 
 		sliderLeft = std::max(sliderLeft, preferredSize.x);
 
-		const Point sliderSize(m_slider->PreferredSize().x, size.y);
+		const Point sliderSize(m_slider->GetPreferredSize().x, size.y);
 		const Point sliderPos(std::min(sliderLeft,size.x-sliderSize.x), top);
 		SetWidgetDimensions(m_slider.Get(), sliderPos, sliderSize);
 
@@ -220,6 +319,7 @@ void Table::Layout()
 	}
 
 	SetWidgetDimensions(m_body.Get(), Point(0, top), size);
+	UpdateVisibleRows();
 
 	LayoutChildren();
 }
@@ -240,6 +340,16 @@ Table *Table::AddRow(const WidgetSet &set)
 
 }
 
+Table *Table::SetRowProvider(unsigned int numRows, int rowHeight, const RowProvider &provider)
+{
+	m_body->SetRowProvider(numRows, rowHeight, provider);
+	m_body->SetDrawOffset(Point());
+	m_slider->SetValue(0);
+	m_dirty = true;
+	GetContext()->RequestLayout(this);
+	return this;
+}
+
 Table *Table::SetRowSpacing(int spacing)
 {
 	m_body->SetRowSpacing(spacing);
@@ -263,9 +373,19 @@ Table *Table::SetHeadingFont(Font font)
 }
 
 
+void Table::UpdateVisibleRows()
+{
+	if (m_body->SetVisibleArea(-m_body->GetDrawOffset().y, m_body->GetSize().y)) {
+		// the new rows need wider columns
+		m_dirty = true;
+		GetContext()->RequestLayout(this);
+	}
+}
+
 void Table::OnScroll(float value)
 {
-	m_body->SetDrawOffset(Point(0, -float(m_body->PreferredSize().y-(GetSize().y-m_header->PreferredSize().y))*value));
+	m_body->SetDrawOffset(Point(0, -float(m_body->GetPreferredSize().y-(GetSize().y-m_header->GetPreferredSize().y))*value));
+	UpdateVisibleRows();
 }
 
 bool Table::OnMouseWheel(const MouseWheelEvent &event)
@@ -26,6 +26,14 @@ public:
 
 	Table *SetHeadingFont(Font font);
 
+	// rows made on demand, for tables too long to make every row up front.
+	// provider is called for a row (counting from 0) when it's scrolled
+	// near the view, and the row is dropped again once it's scrolled well
+	// away. all rows are rowHeight high, or as high as the first row if
+	// rowHeight is 0. replaces any rows already added
+	typedef sigc::slot<WidgetSet,unsigned int> RowProvider;
+	Table *SetRowProvider(unsigned int numRows, int rowHeight, const RowProvider &provider);
+
 private:
 
 	class LayoutAccumulator {
@@ -59,6 +67,11 @@ private:
 		void AddRow(const std::vector<Widget*> &widgets);
 		void Clear();
 
+		void SetRowProvider(unsigned int numRows, int rowHeight, const RowProvider &provider);
+		// make the provided rows in and near top..top+height and drop the
+		// rest. true if the new rows made the columns wider
+		bool SetVisibleArea(int top, int height);
+
 		void AccumulateLayout();
 
 		void SetRowSpacing(int spacing);
@@ -71,6 +84,16 @@ private:
 		Point m_preferredSize;
 		int m_rowSpacing;
 		bool m_dirty;
+
+		// with a provider, m_rows is just the rows made, from m_firstRow
+		bool m_provided;
+		RowProvider m_provider;
+		unsigned int m_numProvidedRows;
+		int m_providedRowHeight;
+		unsigned int m_firstRow;
+
+		std::vector<Widget*> MakeRow(unsigned int index);
+		void RemoveRow(const std::vector<Widget*> &widgets);
 	};
 
 	LayoutAccumulator m_layout;
@@ -83,6 +106,8 @@ private:
 
 	sigc::connection m_onMouseWheelConn;
 
+	void UpdateVisibleRows();
+
 	void OnScroll(float value);
 	bool OnMouseWheel(const MouseWheelEvent &event);
 };
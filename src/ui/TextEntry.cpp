@@ -17,7 +17,7 @@ TextEntry::TextEntry(Context *context, const std::string &text) : Container(cont
 
 Point TextEntry::PreferredSize()
 {
-	const Point labelPreferredSize(m_label->PreferredSize());
+	const Point labelPreferredSize(m_label->GetPreferredSize());
 	const Point borderSize(GetContext()->GetSkin().BackgroundNormal().borderWidth*2);
 	return SizeAdd(labelPreferredSize, borderSize);
 }
@@ -81,7 +81,7 @@ void TextEntry::Draw()
 TextEntry *TextEntry::SetText(const std::string &text)
 {
 	m_label->SetText(text);
-	GetContext()->RequestLayout();
+	GetContext()->RequestLayout(this);
 	return this;
 }
 
@@ -15,6 +15,7 @@ public:
 	virtual void Layout();
 	virtual void Update();
 	virtual void Draw();
+	virtual bool CanBatchDraw() const { return false; }
 
 	TextEntry *SetText(const std::string &text);
 	const std::string &GetText() const { return m_label->GetText(); }
@@ -10,11 +10,31 @@
 namespace UI {
 
 TextLayout::TextLayout(const RefCountedPtr<Text::TextureFont> &font, const std::string &text) :
+	m_openWord(false),
+	m_numLaidOut(0),
 	m_font(font)
 {
-	if (!text.size())
+	m_spaceWidth = ceilf(m_font->GetGlyph(' ').advx);
+	m_lineHeight = ceilf(m_font->GetHeight());
+
+	AppendText(text);
+}
+
+void TextLayout::AppendText(const std::string &_text)
+{
+	if (!_text.size())
 		return;
 
+	std::string text(_text);
+
+	// the last word isn't finished, so it's taken off and goes again
+	// with the new text
+	if (m_openWord) {
+		text = m_words.back().text + text;
+		m_words.pop_back();
+	}
+	m_numLaidOut = std::min(m_numLaidOut, m_words.size());
+
 	// split text on space/newline into words
 	const std::string delim(" \n");
 
@@ -42,36 +62,46 @@ TextLayout::TextLayout(const RefCountedPtr<Text::TextureFont> &font, const std::
 		// find the end - next delim or end of string
 		end = text.find_first_of(delim, start);
 
-		// extract the word and remember it
-		std::string word = text.substr(start, (end == std::string::npos) ? std::string::npos : end - start);
-		m_words.push_back(Word(word));
+		// extract the word, measure it and remember it
+		Word word(text.substr(start, (end == std::string::npos) ? std::string::npos : end - start));
+		vector2f wordSize;
+		m_font->MeasureString(word.text.c_str(), wordSize.x, wordSize.y);
+		word.size = Point(wordSize.x, wordSize.y);
+		m_words.push_back(word);
 	}
+
+	m_openWord = delim.find_first_of(text[text.size()-1]) == std::string::npos;
 }
 
 Point TextLayout::ComputeSize(const Point &layoutSize)
 {
 	if (layoutSize == Point()) return Point();
 
-	if (layoutSize == m_lastRequested)
+	// only the width matters to where words go
+	if (layoutSize.x != m_lastRequested.x)
+		m_numLaidOut = 0;
+	else if (m_numLaidOut == m_words.size())
 		return m_lastSize;
 
-	int spaceWidth = ceilf(m_font->GetGlyph(' ').advx);
-	int lineHeight = ceilf(m_font->GetHeight());
-
+	// carry on from the last word that's still laid out
 	Point pos;
 	Point bounds;
+	if (m_numLaidOut > 0) {
+		pos = m_words[m_numLaidOut-1].next;
+		bounds = m_words[m_numLaidOut-1].bounds;
+	}
 
-	for (std::vector<Word>::iterator i = m_words.begin(); i != m_words.end(); ++i) {
+	for (std::vector<Word>::iterator i = m_words.begin()+m_numLaidOut; i != m_words.end(); ++i) {
 
 		// newline. move to start of next line
 		if (!(*i).text.size()) {
-			pos = Point(0, std::max(bounds.y,pos.y+lineHeight));
+			pos = Point(0, std::max(bounds.y,pos.y+m_lineHeight));
+			(*i).pos = (*i).next = pos;
+			(*i).bounds = bounds;
 			continue;
 		}
 
-		vector2f _wordSize;
-		m_font->MeasureString((*i).text.c_str(), _wordSize.x, _wordSize.y);
-		Point wordSize(_wordSize.x, _wordSize.y);
+		const Point &wordSize = (*i).size;
 
 		// we add the word to this line if:
 		// - we're at the start of the line; OR
@@ -90,21 +120,30 @@ Point TextLayout::ComputeSize(const Point &layoutSize)
 
 			else
 				// retry at start of new line
-				pos = Point(0,std::max(bounds.y,pos.y+lineHeight));
+				pos = Point(0,std::max(bounds.y,pos.y+m_lineHeight));
 		}
 
 		// add a space at the end of each word. its only used to set the start
 		// point for the next word if there is one. if there's not then no
 		// words are added so it won't push the bounds out
-		pos.x += spaceWidth;
+		pos.x += m_spaceWidth;
+
+		(*i).next = pos;
+		(*i).bounds = bounds;
 	}
 
 	m_lastRequested = layoutSize;
 	m_lastSize = bounds;
+	m_numLaidOut = m_words.size();
 
 	return bounds;
 }
 
+bool TextLayout::WordAbove(const Word &word, int y)
+{
+	return word.pos.y < y;
+}
+
 void TextLayout::Draw(const Point &layoutSize, const Point &drawPos, const Point &drawSize)
 {
 	ComputeSize(layoutSize);
@@ -112,10 +151,10 @@ void TextLayout::Draw(const Point &layoutSize, const Point &drawPos, const Point
 	const int top = -drawPos.y - m_font->GetHeight();
 	const int bottom = -drawPos.y + drawSize.y;
 
-	for (std::vector<Word>::iterator i = m_words.begin(); i != m_words.end(); ++i) {
-		if ((*i).pos.y >= top && (*i).pos.y < bottom)
-			m_font->RenderString((*i).text.c_str(), (*i).pos.x, (*i).pos.y, Color::WHITE);
-	}
+	// words only ever go down the page, so the ones above the view can be
+	// skipped all at once
+	for (std::vector<Word>::iterator i = std::lower_bound(m_words.begin(), m_words.end(), top, WordAbove); i != m_words.end() && (*i).pos.y < bottom; ++i)
+		m_font->RenderString((*i).text.c_str(), (*i).pos.x, (*i).pos.y, Color::WHITE);
 }
 
 }
@@ -18,6 +18,10 @@ class TextLayout {
 public:
 	TextLayout(const RefCountedPtr<Text::TextureFont> &font, const std::string &text);
 
+	// add text to the end. only the new words are measured, and only they
+	// are laid out at the next ComputeSize if the layout size hasn't changed
+	void AppendText(const std::string &text);
+
 	Point ComputeSize(const Point &layoutSize);
 
 	void Draw(const Point &layoutSize, const Point &drawPos, const Point &drawSize);
@@ -26,12 +30,24 @@ private:
 	struct Word {
 		Word(const std::string &_text) : text(_text) {}
 		std::string text;
+		Point    size;       // measured when the word is added
 		Point    pos;
+		Point    next;       // where the word after goes, if it fits
+		Point    bounds;     // of everything up to and including this word
 	};
 	std::vector<Word> m_words;
+	static bool WordAbove(const Word &word, int y);
+
+	// the last word doesn't end in a space or newline, so appended text
+	// might carry it on
+	bool m_openWord;
 
 	Point m_lastRequested;   // the layout area we were asked to compute size for
 	Point m_lastSize;        // and the resulting size
+	std::size_t m_numLaidOut; // words laid out for that area so far
+
+	int m_spaceWidth;
+	int m_lineHeight;
 
 	RefCountedPtr<Text::TextureFont> m_font;
 };
@@ -20,7 +20,9 @@ Widget::Widget(Context *context) :
 	m_floating(false),
 	m_disabled(false),
 	m_mouseOver(false),
-	m_mouseActive(false)
+	m_mouseActive(false),
+	m_layoutFlags(0),
+	m_preferredSizeSerial(0)
 {
 	assert(m_context);
 }
@@ -78,9 +80,19 @@ Widget *Widget::SetFont(Font font)
 	return this;
 }
 
+Point Widget::GetPreferredSize()
+{
+	const Uint32 serial = GetContext()->GetLayoutSerial();
+	if (m_preferredSizeSerial != serial) {
+		m_cachedPreferredSize = PreferredSize();
+		m_preferredSizeSerial = serial;
+	}
+	return m_cachedPreferredSize;
+}
+
 Point Widget::CalcLayoutContribution()
 {
-	Point preferredSize = PreferredSize();
+	Point preferredSize = GetPreferredSize();
 	const Uint32 flags = GetSizeControlFlags();
 
 	if (flags & NO_WIDTH)
@@ -101,7 +113,7 @@ Point Widget::CalcSize(const Point &avail)
 	if (!(GetSizeControlFlags() & PRESERVE_ASPECT))
 		return avail;
 
-	const Point preferredSize = PreferredSize();
+	const Point preferredSize = GetPreferredSize();
 
 	float wantRatio = float(preferredSize.x) / float(preferredSize.y);
 
@@ -68,8 +68,9 @@
 //
 // Event handlers from user input are called before Layout(), which gives a
 // widget an opportunity to modify the layout based on input. If a widget
-// wants to change its size it must call GetContext()->RequestLayout() to
-// force a layout change to occur.
+// wants to change its size it must call GetContext()->RequestLayout(this) to
+// force a layout change to occur. Only the containers whose allocations
+// change as a result are laid out again.
 //
 // Event handlers are called against the "leaf" widgets first. Handlers return
 // a bool to indicate if the event was "handled" or not. If a widget has no
@@ -98,6 +99,11 @@ public:
 	virtual void Update() {}
 	virtual void Draw() = 0;
 
+	// PreferredSize(), remembered until the widget requests a layout or the
+	// whole context is laid out again. containers should ask their children
+	// for their size through this
+	Point GetPreferredSize();
+
 	// gui context
 	Context *GetContext() const { return m_context; }
 
@@ -154,6 +160,12 @@ public:
 	// fast way to determine if the widget is a container
 	virtual bool IsContainer() const { return false; }
 
+	// true if Draw() draws nothing but skin elements with the normal blend
+	// mode (and its children, through the context). the context can then
+	// batch its elements with everyone else's instead of drawing them
+	// one at a time
+	virtual bool CanBatchDraw() const { return false; }
+
 	// are we floating
 	bool IsFloating() const { return m_floating; }
 
@@ -367,6 +379,19 @@ private:
 	friend class Context;
 	void SetSize(const Point &size) { m_size = size; SetActiveArea(size); }
 
+	// set by Context::RequestLayout, cleared as the context lays things out
+	// again
+	enum LayoutFlags {
+		LAYOUT_DIRTY       = 0x1, // this widget asked for a layout
+		LAYOUT_CHILD_DIRTY = 0x2  // something below this widget did
+	};
+	Uint32 m_layoutFlags;
+
+	// m_cachedPreferredSize is current if m_preferredSizeSerial matches the
+	// context's layout serial
+	Point m_cachedPreferredSize;
+	Uint32 m_preferredSizeSerial;
+
 
 	// FloatContainer needs to change floating state
 	friend class FloatContainer;
@@ -103,10 +103,21 @@ namespace FileSystem {
 	{
 		const std::string fullpath = JoinPathBelow(GetRoot(), path);
 		const std::wstring wfullpath = transcode_utf8_to_utf16(fullpath);
-		DWORD attrs = GetFileAttributesW(wfullpath.c_str());
-		return MakeFileInfo(path, file_type_for_attributes(attrs));
+		WIN32_FILE_ATTRIBUTE_DATA data;
+		if (!GetFileAttributesExW(wfullpath.c_str(), GetFileExInfoStandard, &data))
+			return MakeFileInfo(path, file_type_for_attributes(INVALID_FILE_ATTRIBUTES));
+		// 100ns intervals since 1601
+		const Sint64 ticks = (Sint64(data.ftLastWriteTime.dwHighDateTime) << 32) | data.ftLastWriteTime.dwLowDateTime;
+		const Sint64 modTime = ticks / 10000000 - Sint64(11644473600);
+		return MakeFileInfo(path, file_type_for_attributes(data.dwFileAttributes), modTime);
 	}
 
+	class FileDataMapped : public FileData {
+	public:
+		FileDataMapped(const FileInfo &info, size_t size, char *data): FileData(info, size, data) {}
+		virtual ~FileDataMapped() { UnmapViewOfFile(m_data); }
+	};
+
 	RefCountedPtr<FileData> FileSourceFS::ReadFile(const std::string &path)
 	{
 		const std::string fullpath = JoinPathBelow(GetRoot(), path);
@@ -123,6 +134,18 @@ namespace FileSystem {
 			}
 			size_t size = size_t(large_size.QuadPart);
 
+			if (size >= MAP_MIN_SIZE) {
+				HANDLE mapping = CreateFileMappingW(filehandle, 0, PAGE_READONLY, 0, 0, 0);
+				void *mapped = mapping ? MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0) : 0;
+				// the view keeps the mapping and the file open
+				if (mapping) CloseHandle(mapping);
+				if (mapped) {
+					CloseHandle(filehandle);
+					return RefCountedPtr<FileData>(new FileDataMapped(MakeFileInfo(path, FileInfo::FT_FILE), size, reinterpret_cast<char*>(mapped)));
+				}
+				// otherwise read it in as usual
+			}
+
 			char *data = reinterpret_cast<char*>(std::malloc(size));
 			if (!data) {
 				// XXX handling memory allocation failure gracefully is too hard right now
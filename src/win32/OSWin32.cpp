@@ -11,6 +11,7 @@
 #include <stdio.h>
 #include <wchar.h>
 #include <windows.h>
+#include <psapi.h>
 
 namespace OS {
 
@@ -125,4 +126,25 @@ int GetNumCores()
 	return sysinfo.dwNumberOfProcessors;
 }
 
+size_t GetPeakMemoryUsage()
+{
+	// psapi is looked up at run time so nothing else has to link it
+	typedef BOOL (WINAPI *GetProcessMemoryInfoFn)(HANDLE, PROCESS_MEMORY_COUNTERS*, DWORD);
+	static GetProcessMemoryInfoFn getInfo = 0;
+	static bool looked = false;
+	if (!looked) {
+		looked = true;
+		HMODULE psapi = LoadLibraryA("psapi.dll");
+		if (psapi)
+			getInfo = reinterpret_cast<GetProcessMemoryInfoFn>(GetProcAddress(psapi, "GetProcessMemoryInfo"));
+	}
+	if (!getInfo)
+		return 0;
+
+	PROCESS_MEMORY_COUNTERS counters;
+	if (!getInfo(GetCurrentProcess(), &counters, sizeof(counters)))
+		return 0;
+	return counters.PeakWorkingSetSize;
+}
+
 } // namespace OS